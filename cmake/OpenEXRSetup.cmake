@@ -58,6 +58,9 @@ option(OPENEXR_ENABLE_LARGE_STACK "Enables code to take advantage of large stack
 # Whether to build & install the various command line utility programs
 option(OPENEXR_BUILD_TOOLS "Enables building of utility programs" ON)
 
+# Whether to build the benchmark programs next to the C++ library tests
+option(OPENEXR_BUILD_PERF_TESTS "Enables building of performance test programs" OFF)
+
 # This is a variable here for use in controlling where include files are 
 # installed. Care must be taken when changing this, as many things
 # probably assume this is OpenEXR
@@ -245,6 +248,27 @@ if(OPENEXR_FORCE_INTERNAL_ZLIB OR NOT TARGET ZLIB::ZLIB)
   endif()
 endif()
 
+#######################################
+# Optionally use libdeflate for deflate
+#######################################
+
+# libdeflate reads and writes the same zlib streams as zlib, but is
+# considerably faster, so it can be used in place of zlib for the
+# ZIP / ZIPS / PXR24 compression methods. zlib is still required for
+# the DWA methods and the compressed ID manifest.
+option(OPENEXR_USE_LIBDEFLATE "Use libdeflate instead of zlib for deflate based compression" OFF)
+if(OPENEXR_USE_LIBDEFLATE)
+  find_path(LIBDEFLATE_INCLUDE_DIR libdeflate.h)
+  find_library(LIBDEFLATE_LIBRARY NAMES deflate libdeflate)
+  mark_as_advanced(LIBDEFLATE_INCLUDE_DIR LIBDEFLATE_LIBRARY)
+  if(NOT LIBDEFLATE_INCLUDE_DIR OR NOT LIBDEFLATE_LIBRARY)
+    message(FATAL_ERROR "OPENEXR_USE_LIBDEFLATE is enabled, but libdeflate could not be found")
+  endif()
+  message(STATUS "Using libdeflate from ${LIBDEFLATE_LIBRARY}")
+  set(OPENEXR_IMF_HAVE_LIBDEFLATE TRUE)
+  set(OPENEXR_EXTRA_DEFLATE_LIB ${LIBDEFLATE_LIBRARY})
+endif()
+
 #######################################
 # Find or install Imath
 #######################################
@@ -14,7 +14,9 @@
 #include "IlmThreadPool.h"
 #include "Iex.h"
 
+#include <algorithm>
 #include <atomic>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <vector>
@@ -134,11 +136,34 @@ namespace {
 
 class DefaultWorkerThread;
 
+//
+// Each worker thread owns a queue of tasks. Tasks added from outside
+// of the pool are spread round robin across the queues, and tasks
+// added by a worker (i.e. nested tasks) go to its own queue. A worker
+// takes tasks from the front of its own queue, and once that is
+// empty, steals from the back of the other queues, so the workers
+// only contend with each other when they run out of work, instead of
+// on every task.
+//
+// The queues are allocated once, when the pool is created, and are
+// never reallocated, so addTask() can pick a queue without holding a
+// lock while setNumThreads() adds or removes threads. If there are
+// more threads than queues, some threads share a queue.
+//
+struct DefaultTaskQueue
+{
+    std::mutex   mutex;             // mutual exclusion for the tasks list
+    deque<Task*> tasks;             // the list of tasks to execute
+    char         pad[64];           // avoid false sharing between queues
+};
+
 struct DefaultWorkData
 {
     Semaphore taskSemaphore;        // threads wait on this for ready tasks
-    mutable std::mutex taskMutex;        // mutual exclusion for the tasks list
-    vector<Task*> tasks;            // the list of tasks to execute
+    vector<unique_ptr<DefaultTaskQueue>> queues; // fixed, see above
+    std::atomic<size_t> activeQueues; // queues that have a thread
+    std::atomic<size_t> nextQueue;  // round robin for outside tasks
+    std::atomic<int> pendingTasks;  // tasks in any queue
 
     Semaphore threadSemaphore;      // signaled when a thread starts executing
     mutable std::mutex threadMutex;      // mutual exclusion for threads list
@@ -147,6 +172,14 @@ struct DefaultWorkData
     std::atomic<bool> hasThreads;
     std::atomic<bool> stopping;
 
+    DefaultWorkData (size_t numQueues) : activeQueues (0), nextQueue (0),
+                                         pendingTasks (0), hasThreads (false),
+                                         stopping (false)
+    {
+        for (size_t i = 0; i < numQueues; ++i)
+            queues.emplace_back (new DefaultTaskQueue);
+    }
+
     inline bool stopped () const
     {
         return stopping.load( std::memory_order_relaxed );
@@ -156,8 +189,78 @@ struct DefaultWorkData
     {
         stopping = true;
     }
+
+    void  push (size_t q, Task* task);
+    Task* take (size_t q);
 };
 
+//
+// the worker (if any) running on the current thread, such that
+// nested tasks can be placed in the queue of that worker
+//
+thread_local DefaultWorkData* tlsWorkData = nullptr;
+thread_local size_t           tlsWorkQueue = 0;
+
+
+void
+DefaultWorkData::push (size_t q, Task* task)
+{
+    {
+        std::lock_guard<std::mutex> lk (queues[q]->mutex);
+        queues[q]->tasks.push_back (task);
+    }
+    pendingTasks.fetch_add (1, std::memory_order_release);
+}
+
+
+Task*
+DefaultWorkData::take (size_t q)
+{
+    //
+    // Our own queue first, in FIFO order
+    //
+
+    {
+        DefaultTaskQueue& own = *queues[q];
+        std::lock_guard<std::mutex> lk (own.mutex);
+        if (!own.tasks.empty())
+        {
+            Task* task = own.tasks.front();
+            own.tasks.pop_front();
+            pendingTasks.fetch_sub (1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+
+    //
+    // Then steal from the other queues, taking the most recently
+    // added task to stay out of the way of the owner
+    //
+
+    size_t n = queues.size();
+    for (size_t i = 1; i < n; ++i)
+    {
+        DefaultTaskQueue& other = *queues[(q + i) % n];
+        std::unique_lock<std::mutex> lk (other.mutex, std::try_to_lock);
+        if (!lk.owns_lock())
+        {
+            // someone else is busy with it, only wait if it may be
+            // the last place with work
+            if (pendingTasks.load (std::memory_order_acquire) == 0)
+                continue;
+            lk.lock();
+        }
+        if (!other.tasks.empty())
+        {
+            Task* task = other.tasks.back();
+            other.tasks.pop_back();
+            pendingTasks.fetch_sub (1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
 //
 // class WorkerThread
 //
@@ -165,18 +268,20 @@ class DefaultWorkerThread: public Thread
 {
   public:
 
-    DefaultWorkerThread (DefaultWorkData* data);
+    DefaultWorkerThread (DefaultWorkData* data, size_t queue);
 
     virtual void    run ();
     
   private:
 
     DefaultWorkData *  _data;
+    size_t             _queue;
 };
 
 
-DefaultWorkerThread::DefaultWorkerThread (DefaultWorkData* data):
-    _data (data)
+DefaultWorkerThread::DefaultWorkerThread (DefaultWorkData* data, size_t queue):
+    _data (data),
+    _queue (queue)
 {
     start();
 }
@@ -185,6 +290,9 @@ DefaultWorkerThread::DefaultWorkerThread (DefaultWorkData* data):
 void
 DefaultWorkerThread::run ()
 {
+    tlsWorkData = _data;
+    tlsWorkQueue = _queue;
+
     //
     // Signal that the thread has started executing
     //
@@ -199,33 +307,37 @@ DefaultWorkerThread::run ()
 
         _data->taskSemaphore.wait();
 
-        {
-            std::unique_lock<std::mutex> taskLock (_data->taskMutex);
-    
-            //
-            // If there is a task pending, pop off the next task in the FIFO
-            //
+        //
+        // Each post of the semaphore accounts for one task, but
+        // another worker may have stolen the task we were woken for
+        // and left us with one we have not found yet, so keep looking
+        // while there is work pending
+        //
 
-            if (!_data->tasks.empty())
-            {
-                Task* task = _data->tasks.back();
-                _data->tasks.pop_back();
-                // release the mutex while we process
-                taskLock.unlock();
+        Task* task = _data->take (_queue);
+        while (!task &&
+               _data->pendingTasks.load (std::memory_order_acquire) > 0)
+        {
+            std::this_thread::yield();
+            task = _data->take (_queue);
+        }
 
-                TaskGroup* taskGroup = task->group();
-                task->execute();
+        if (task)
+        {
+            TaskGroup* taskGroup = task->group();
+            task->execute();
 
-                delete task;
+            delete task;
 
-                taskGroup->_data->removeTask ();
-            }
-            else if (_data->stopped())
-            {
-                break;
-            }
+            taskGroup->_data->removeTask ();
+        }
+        else if (_data->stopped())
+        {
+            break;
         }
     }
+
+    tlsWorkData = nullptr;
 }
 
 
@@ -248,7 +360,21 @@ class DefaultThreadPoolProvider : public ThreadPoolProvider
     DefaultWorkData _data;
 };
 
+//
+// One queue per hardware thread, or per requested thread if more
+// threads are requested when the pool is created
+//
+size_t
+defaultNumQueues (int count)
+{
+    size_t numQueues = std::thread::hardware_concurrency ();
+    if (count > 0 && static_cast<size_t> (count) > numQueues)
+        numQueues = static_cast<size_t> (count);
+    return numQueues > 0 ? numQueues : 1;
+}
+
 DefaultThreadPoolProvider::DefaultThreadPoolProvider (int count)
+    : _data (defaultNumQueues (count))
 {
     setNumThreads(count);
 }
@@ -275,31 +401,28 @@ DefaultThreadPoolProvider::setNumThreads (int count)
     std::lock_guard<std::mutex> lock (_data.threadMutex);
 
     size_t desired = static_cast<size_t>(count);
-    if (desired > _data.threads.size())
-    {
-        //
-        // Add more threads
-        //
-
-        while (_data.threads.size() < desired)
-            _data.threads.push_back (new DefaultWorkerThread (&_data));
-    }
-    else if ((size_t)count < _data.threads.size())
+    if (desired < _data.threads.size())
     {
         //
         // Wait until all existing threads are finished processing,
         // then delete all threads.
         //
+
+        _data.activeQueues = 0;
         finish ();
+    }
 
-        //
-        // Add in new threads
-        //
+    //
+    // Add in new threads, thread i takes queue i, modulo the
+    // number of queues
+    //
 
-        while (_data.threads.size() < desired)
-            _data.threads.push_back (new DefaultWorkerThread (&_data));
-    }
+    size_t numQueues = _data.queues.size();
+    while (_data.threads.size() < desired)
+        _data.threads.push_back (new DefaultWorkerThread (
+            &_data, _data.threads.size() % numQueues));
 
+    _data.activeQueues = std::min (_data.threads.size(), numQueues);
     _data.hasThreads = !(_data.threads.empty());
 }
 
@@ -314,17 +437,24 @@ DefaultThreadPoolProvider::addTask (Task *task)
     if ( doPush )
     {
         //
-        // Get exclusive access to the tasks queue
+        // Nested tasks stay with the worker which created them,
+        // others are spread across all the queues
         //
 
+        size_t q = 0;
+        if (tlsWorkData == &_data)
         {
-            std::lock_guard<std::mutex> taskLock (_data.taskMutex);
-
-            //
-            // Push the new task into the FIFO
-            //
-            _data.tasks.push_back (task);
+            q = tlsWorkQueue;
+        }
+        else
+        {
+            size_t n = _data.activeQueues.load (std::memory_order_relaxed);
+            if (n > 0)
+                q = _data.nextQueue.fetch_add (1, std::memory_order_relaxed) %
+                    n;
         }
+
+        _data.push (q, task);
         
         //
         // Signal that we have a new task to process
@@ -378,11 +508,7 @@ DefaultThreadPoolProvider::finish ()
         delete _data.threads[i];
     }
 
-    std::lock_guard<std::mutex> lk( _data.taskMutex );
-
     _data.threads.clear();
-    _data.tasks.clear();
-
     _data.stopping = false;
 }
 
@@ -72,6 +72,8 @@
 #include "ImfChannelList.h"
 #include "ImfMisc.h"
 #include "ImfCheckedArithmetic.h"
+#include "ImfSimd.h"
+#include "ImfSystemSpecific.h"
 #include <ImathFun.h>
 #include <ImathBox.h>
 #include <Iex.h>
@@ -105,17 +107,17 @@ namespace {
 
 
 inline void
-convertFromLinear (unsigned short s[16])
+convertFromLinear (unsigned short *s, size_t n)
 {
-    for (int i = 0; i < 16; ++i)
+    for (size_t i = 0; i < n; ++i)
 	s[i] = expTable[s[i]];
 }
 
 
 inline void
-convertToLinear (unsigned short s[16])
+convertToLinear (unsigned short *s, size_t n)
 {
-    for (int i = 0; i < 16; ++i)
+    for (size_t i = 0; i < n; ++i)
 	s[i] = logTable[s[i]];
 }
 
@@ -421,9 +423,1157 @@ tooMuchData ()
 			 "(input data are longer than expected).");
 }
 
+
+//
+// The block kernels.  packBlocks compresses nBlocks 4x4 blocks whose
+// rows start at rows[0] ... rows[3], and returns the number of bytes
+// written.  unpackBlocks uncompresses nBlocks blocks into the rows,
+// and returns the number of bytes read, or -1 if the input is too
+// short.  The scalar versions, one block at a time using pack() and
+// unpack14() / unpack3() above, are the reference for the others:
+// SSE2 and NEON, chosen at compile time, transform one whole block
+// at a time, AVX2, chosen at runtime by initializeFuncs(), two blocks
+// at a time.  They all give exactly the same results.
+//
+
+inline unsigned int
+readBe24 (const unsigned char b[3])
+{
+    return (b[0] << 16) | (b[1] << 8) | b[2];
+}
+
+
+#if !defined(IMF_HAVE_SSE2) && !defined(IMF_HAVE_NEON)
+
+int
+packBlocks_scalar (const unsigned short * const rows[4],
+		   int nBlocks,
+		   unsigned char *out,
+		   bool optFlatFields,
+		   bool exactMax)
+{
+    unsigned char *outStart = out;
+
+    for (int i = 0; i < nBlocks; ++i)
+    {
+	unsigned short s[16];
+
+	for (int r = 0; r < 4; ++r)
+	    memcpy (&s[4 * r], rows[r] + 4 * i, 4 * sizeof (unsigned short));
+
+	out += pack (s, out, optFlatFields, exactMax);
+    }
+
+    return static_cast<int> (out - outStart);
+}
+
+
+int
+unpackBlocks_scalar (const unsigned char *in,
+		     int inSize,
+		     int nBlocks,
+		     unsigned short * const rows[4])
+{
+    const unsigned char *inStart = in;
+
+    for (int i = 0; i < nBlocks; ++i)
+    {
+	unsigned short s[16];
+
+	if (inSize < 3)
+	    return -1;
+
+	if (in[2] >= (13 << 2))
+	{
+	    unpack3 (in, s);
+	    in += 3;
+	    inSize -= 3;
+	}
+	else
+	{
+	    if (inSize < 14)
+		return -1;
+
+	    unpack14 (in, s);
+	    in += 14;
+	    inSize -= 14;
+	}
+
+	for (int r = 0; r < 4; ++r)
+	    memcpy (rows[r] + 4 * i, &s[4 * r], 4 * sizeof (unsigned short));
+    }
+
+    return static_cast<int> (in - inStart);
+}
+
+#endif
+
+
+//
+// The shared part of the vector versions.  A block is held as two
+// vectors, rows 0 and 1 in the first and rows 2 and 3 in the second,
+// so each row is one 64-bit lane.  The 6-bit fields of a packed block,
+// the shift and r[0] ... r[14], are stored in four big-endian groups
+// of 24 bits.  Field k of group j is the difference between pixels j
+// and j + 1 in row k - 1 for j > 0, and between rows k - 1 and k of
+// the first column for j == 0: the fields in row k, column j of a
+// block are the ones in group j, at bit 18 - 6 * k of the group.
+//
+
+#if defined(IMF_HAVE_SSE2)
+
+inline __m128i
+unsignedMax_sse2 (__m128i t0, __m128i t1)
+{
+    const __m128i sign = _mm_set1_epi16 ((short) 0x8000);
+    __m128i m = _mm_max_epi16 (_mm_xor_si128 (t0, sign),
+			       _mm_xor_si128 (t1, sign));
+
+    m = _mm_max_epi16 (m, _mm_shuffle_epi32 (m, _MM_SHUFFLE (1, 0, 3, 2)));
+    m = _mm_max_epi16 (m, _mm_shuffle_epi32 (m, _MM_SHUFFLE (2, 3, 0, 1)));
+    m = _mm_max_epi16 (m, _mm_shufflelo_epi16 (m, _MM_SHUFFLE (2, 3, 0, 1)));
+    m = _mm_shuffle_epi32 (_mm_shufflelo_epi16 (m, 0), 0);
+
+    return _mm_xor_si128 (m, sign);
+}
+
+
+//
+// Convert the pixels to the ordered integers t[] of pack()
+//
+
+inline __m128i
+orderedBits_sse2 (__m128i s)
+{
+    const __m128i sign = _mm_set1_epi16 ((short) 0x8000);
+    const __m128i expo = _mm_set1_epi16 (0x7c00);
+    __m128i t = _mm_xor_si128 (s, _mm_or_si128 (_mm_srai_epi16 (s, 15), sign));
+    __m128i infNan = _mm_cmpeq_epi16 (_mm_and_si128 (s, expo), expo);
+
+    return _mm_or_si128 (_mm_andnot_si128 (infNan, t),
+			 _mm_and_si128 (infNan, sign));
+}
+
+
+//
+// The inverse of orderedBits_sse2 (), without the NaN replacement
+//
+
+inline __m128i
+signMagnitude_sse2 (__m128i t)
+{
+    const __m128i sign = _mm_set1_epi16 ((short) 0x8000);
+    __m128i neg = _mm_srai_epi16 (t, 15);
+
+    return _mm_andnot_si128 (_mm_and_si128 (neg, sign),
+			     _mm_xor_si128 (t, _mm_xor_si128 (neg,
+					   _mm_set1_epi16 (-1))));
+}
+
+
+//
+// shiftAndRound() of the differences x, for shift > 0
+//
+
+inline __m128i
+shiftAndRound_sse2 (__m128i x, int shift)
+{
+    __m128i q = _mm_srl_epi16 (x, _mm_cvtsi32_si128 (shift));
+    __m128i rem = _mm_and_si128 (x, _mm_set1_epi16 ((short) ((1 << shift) - 1)));
+    __m128i odd = _mm_and_si128 (q, _mm_set1_epi16 (1));
+    __m128i up = _mm_cmpgt_epi16 (_mm_add_epi16 (rem, odd),
+				  _mm_set1_epi16 ((short) (1 << (shift - 1))));
+
+    return _mm_sub_epi16 (q, up);
+}
+
+
+//
+// The running differences of the rounded differences d, minus the
+// bias, in rows (h0, h1; lanes 0, 1 and 2 of each row are used) and
+// down the first column (v0, v1; lanes 0 and 4 of v0, lane 0 of v1)
+//
+
+inline void
+runningDiffs_sse2 (__m128i d0, __m128i d1,
+		   __m128i &h0, __m128i &h1, __m128i &v0, __m128i &v1)
+{
+    h0 = _mm_sub_epi16 (d0, _mm_srli_epi64 (d0, 16));
+    h1 = _mm_sub_epi16 (d1, _mm_srli_epi64 (d1, 16));
+    v0 = _mm_sub_epi16 (d0, _mm_or_si128 (_mm_srli_si128 (d0, 8),
+					  _mm_slli_si128 (d1, 8)));
+    v1 = _mm_sub_epi16 (d1, _mm_srli_si128 (d1, 8));
+}
+
+
+int
+pack_sse2 (__m128i s0, __m128i s1,
+	   unsigned char b[14],
+	   bool optFlatFields,
+	   bool exactMax)
+{
+    const __m128i bias  = _mm_set1_epi16 (0x20);
+    const __m128i rMax  = _mm_set1_epi16 (0x3f);
+    const __m128i maskH = _mm_set_epi16 (0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i maskV0 = _mm_set_epi16 (0, 0, 0, -1, 0, 0, 0, -1);
+    const __m128i maskV1 = _mm_set_epi16 (0, 0, 0, 0, 0, 0, 0, -1);
+
+    __m128i t0 = orderedBits_sse2 (s0);
+    __m128i t1 = orderedBits_sse2 (s1);
+    __m128i tMax = unsignedMax_sse2 (t0, t1);
+    __m128i x0 = _mm_sub_epi16 (tMax, t0);
+    __m128i x1 = _mm_sub_epi16 (tMax, t1);
+    __m128i d0, d1, h0, h1, v0, v1;
+    int shift = 0;
+
+    //
+    // Find the smallest shift where all differences are between
+    // -32 and +31; the biased differences are between 0 and 63 as
+    // unsigned values only then, as the differences of the shifted
+    // values, less than 0xf800 apart, cannot wrap around.
+    //
+
+    for (;; ++shift)
+    {
+	if (shift == 0)
+	{
+	    d0 = x0;
+	    d1 = x1;
+	}
+	else
+	{
+	    d0 = shiftAndRound_sse2 (x0, shift);
+	    d1 = shiftAndRound_sse2 (x1, shift);
+	}
+
+	runningDiffs_sse2 (d0, d1, h0, h1, v0, v1);
+
+	__m128i out =
+	    _mm_or_si128 (
+		_mm_or_si128 (
+		    _mm_and_si128 (_mm_subs_epu16 (_mm_add_epi16 (h0, bias), rMax), maskH),
+		    _mm_and_si128 (_mm_subs_epu16 (_mm_add_epi16 (h1, bias), rMax), maskH)),
+		_mm_or_si128 (
+		    _mm_and_si128 (_mm_subs_epu16 (_mm_add_epi16 (v0, bias), rMax), maskV0),
+		    _mm_and_si128 (_mm_subs_epu16 (_mm_add_epi16 (v1, bias), rMax), maskV1)));
+
+	if (_mm_movemask_epi8 (_mm_cmpeq_epi16 (out, _mm_setzero_si128 ())) == 0xffff)
+	    break;
+    }
+
+    unsigned short t = _mm_cvtsi128_si32 (t0);
+
+    if (optFlatFields)
+    {
+	__m128i nonZero =
+	    _mm_or_si128 (_mm_or_si128 (_mm_and_si128 (h0, maskH),
+					_mm_and_si128 (h1, maskH)),
+			  _mm_or_si128 (_mm_and_si128 (v0, maskV0),
+					_mm_and_si128 (v1, maskV1)));
+
+	if (_mm_movemask_epi8 (_mm_cmpeq_epi16 (nonZero, _mm_setzero_si128 ())) == 0xffff)
+	{
+	    b[0] = (t >> 8);
+	    b[1] = (unsigned char) t;
+	    b[2] = 0xfc;
+
+	    return 3;
+	}
+    }
+
+    if (exactMax)
+    {
+	t = (unsigned short) (_mm_cvtsi128_si32 (tMax) -
+			      ((_mm_cvtsi128_si32 (d0) & 0xffff) << shift));
+    }
+
+    //
+    // Gather the fields in the order they are stored, the rows of
+    // differences transposed, and pack them 4 to a 24-bit group.
+    //
+
+    h0 = _mm_add_epi16 (h0, bias);
+    h1 = _mm_add_epi16 (h1, bias);
+
+    __m128i a = _mm_unpacklo_epi16 (h0, h1);
+    __m128i c = _mm_unpackhi_epi16 (h0, h1);
+    __m128i f1 = _mm_unpacklo_epi16 (a, c);
+    __m128i f2 = _mm_unpackhi_epi16 (a, c);
+    __m128i f0 = _mm_set_epi16 (0, 0, 0, 0,
+				(short) (_mm_cvtsi128_si32 (v1) + 0x20),
+				(short) (_mm_extract_epi16 (v0, 4) + 0x20),
+				(short) (_mm_cvtsi128_si32 (v0) + 0x20),
+				(short) shift);
+
+    __m128i flo = _mm_unpacklo_epi64 (f0, f1);
+    __m128i fhi = _mm_unpackhi_epi64 (f1, _mm_slli_si128 (f2, 8));
+    __m128i k64 = _mm_set1_epi32 ((1 << 16) | 64);
+    __m128i pairs = _mm_packs_epi32 (_mm_madd_epi16 (flo, k64),
+				     _mm_madd_epi16 (fhi, k64));
+    __m128i groups = _mm_madd_epi16 (pairs, _mm_set1_epi32 ((1 << 16) | 4096));
+
+    unsigned int g[4];
+    _mm_storeu_si128 ((__m128i *) g, groups);
+
+    b[0] = (t >> 8);
+    b[1] = (unsigned char) t;
+
+    for (int j = 0; j < 4; ++j)
+    {
+	b[2 + 3 * j] = (unsigned char) (g[j] >> 16);
+	b[3 + 3 * j] = (unsigned char) (g[j] >> 8);
+	b[4 + 3 * j] = (unsigned char) g[j];
+    }
+
+    return 14;
+}
+
+
+//
+// Uncompress the 14-byte block b into rows 0 and 1 (s0) and rows 2
+// and 3 (s1), as sign-magnitude bit patterns
+//
+
+inline void
+unpack14_sse2 (const unsigned char b[14], __m128i &s0, __m128i &s1)
+{
+    const __m128i mask = _mm_set1_epi32 (0x3f);
+    const __m128i bias = _mm_set1_epi16 (0x20);
+
+    __m128i g = _mm_set_epi32 (readBe24 (b + 11), readBe24 (b + 8),
+			       readBe24 (b + 5), readBe24 (b + 2));
+    __m128i scale = _mm_set1_epi16 ((short) (1 << (b[2] >> 2)));
+
+    __m128i r0 = _mm_packs_epi32 (_mm_and_si128 (_mm_srli_epi32 (g, 18), mask),
+				  _mm_and_si128 (_mm_srli_epi32 (g, 12), mask));
+    __m128i r1 = _mm_packs_epi32 (_mm_and_si128 (_mm_srli_epi32 (g, 6), mask),
+				  _mm_and_si128 (g, mask));
+
+    r0 = _mm_mullo_epi16 (_mm_sub_epi16 (r0, bias), scale);
+    r1 = _mm_mullo_epi16 (_mm_sub_epi16 (r1, bias), scale);
+    r0 = _mm_insert_epi16 (r0, (b[0] << 8) | b[1], 0);
+
+    //
+    // Sum the differences along the rows, then add the first pixels
+    // of the rows above.
+    //
+
+    r0 = _mm_add_epi16 (r0, _mm_slli_epi64 (r0, 16));
+    r1 = _mm_add_epi16 (r1, _mm_slli_epi64 (r1, 16));
+    r0 = _mm_add_epi16 (r0, _mm_slli_epi64 (r0, 32));
+    r1 = _mm_add_epi16 (r1, _mm_slli_epi64 (r1, 32));
+
+    __m128i c0 = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (r0, 0), 0);
+    __m128i c1 = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (r1, 0), 0);
+    __m128i c01 = _mm_add_epi16 (c0, _mm_srli_si128 (c0, 8));
+
+    r0 = _mm_add_epi16 (r0, _mm_slli_si128 (c0, 8));
+    r1 = _mm_add_epi16 (r1, _mm_add_epi16 (_mm_unpacklo_epi64 (c01, c01),
+					   _mm_slli_si128 (c1, 8)));
+
+    s0 = signMagnitude_sse2 (r0);
+    s1 = signMagnitude_sse2 (r1);
+}
+
+
+inline void
+unpack3_sse2 (const unsigned char b[3], __m128i &s0, __m128i &s1)
+{
+    s0 = s1 = signMagnitude_sse2 (_mm_set1_epi16 ((short) ((b[0] << 8) | b[1])));
+}
+
+
+inline void
+storeBlock_sse2 (unsigned short * const rows[4], int i, __m128i s0, __m128i s1)
+{
+    _mm_storel_epi64 ((__m128i *) (rows[0] + 4 * i), s0);
+    _mm_storel_epi64 ((__m128i *) (rows[1] + 4 * i), _mm_srli_si128 (s0, 8));
+    _mm_storel_epi64 ((__m128i *) (rows[2] + 4 * i), s1);
+    _mm_storel_epi64 ((__m128i *) (rows[3] + 4 * i), _mm_srli_si128 (s1, 8));
+}
+
+
+int
+packBlocks_sse2 (const unsigned short * const rows[4],
+		 int nBlocks,
+		 unsigned char *out,
+		 bool optFlatFields,
+		 bool exactMax)
+{
+    unsigned char *outStart = out;
+
+    for (int i = 0; i < nBlocks; ++i)
+    {
+	__m128i s0 = _mm_unpacklo_epi64 (
+	    _mm_loadl_epi64 ((const __m128i *) (rows[0] + 4 * i)),
+	    _mm_loadl_epi64 ((const __m128i *) (rows[1] + 4 * i)));
+	__m128i s1 = _mm_unpacklo_epi64 (
+	    _mm_loadl_epi64 ((const __m128i *) (rows[2] + 4 * i)),
+	    _mm_loadl_epi64 ((const __m128i *) (rows[3] + 4 * i)));
+
+	out += pack_sse2 (s0, s1, out, optFlatFields, exactMax);
+    }
+
+    return static_cast<int> (out - outStart);
+}
+
+
+int
+unpackBlocks_sse2 (const unsigned char *in,
+		   int inSize,
+		   int nBlocks,
+		   unsigned short * const rows[4])
+{
+    const unsigned char *inStart = in;
+
+    for (int i = 0; i < nBlocks; ++i)
+    {
+	__m128i s0, s1;
+
+	if (inSize < 3)
+	    return -1;
+
+	if (in[2] >= (13 << 2))
+	{
+	    unpack3_sse2 (in, s0, s1);
+	    in += 3;
+	    inSize -= 3;
+	}
+	else
+	{
+	    if (inSize < 14)
+		return -1;
+
+	    unpack14_sse2 (in, s0, s1);
+	    in += 14;
+	    inSize -= 14;
+	}
+
+	storeBlock_sse2 (rows, i, s0, s1);
+    }
+
+    return static_cast<int> (in - inStart);
+}
+
+#endif // IMF_HAVE_SSE2
+
+
+#ifdef IMF_HAVE_AVX2_TARGET
+
+//
+// The AVX2 versions keep one block in each 128-bit lane, and apart
+// from the shift search, which has to be done separately for each
+// block, follow the SSE2 ones exactly.
+//
+
+IMF_TARGET_AVX2 inline __m256i
+combine_avx2 (__m128i lo, __m128i hi)
+{
+    return _mm256_inserti128_si256 (_mm256_castsi128_si256 (lo), hi, 1);
+}
+
+
+IMF_TARGET_AVX2 inline __m256i
+signMagnitude_avx2 (__m256i t)
+{
+    const __m256i sign = _mm256_set1_epi16 ((short) 0x8000);
+    __m256i neg = _mm256_srai_epi16 (t, 15);
+
+    return _mm256_andnot_si256 (_mm256_and_si256 (neg, sign),
+				_mm256_xor_si256 (t, _mm256_xor_si256 (neg,
+					_mm256_set1_epi16 (-1))));
+}
+
+
+IMF_TARGET_AVX2 inline __m256i
+orderedBits_avx2 (__m256i s)
+{
+    const __m256i sign = _mm256_set1_epi16 ((short) 0x8000);
+    const __m256i expo = _mm256_set1_epi16 (0x7c00);
+    __m256i t = _mm256_xor_si256 (s, _mm256_or_si256 (_mm256_srai_epi16 (s, 15), sign));
+    __m256i infNan = _mm256_cmpeq_epi16 (_mm256_and_si256 (s, expo), expo);
+
+    return _mm256_blendv_epi8 (t, sign, infNan);
+}
+
+
+IMF_TARGET_AVX2 inline void
+runningDiffs_avx2 (__m256i d0, __m256i d1,
+		   __m256i &h0, __m256i &h1, __m256i &v0, __m256i &v1)
+{
+    h0 = _mm256_sub_epi16 (d0, _mm256_srli_epi64 (d0, 16));
+    h1 = _mm256_sub_epi16 (d1, _mm256_srli_epi64 (d1, 16));
+    v0 = _mm256_sub_epi16 (d0, _mm256_or_si256 (_mm256_srli_si256 (d0, 8),
+						_mm256_slli_si256 (d1, 8)));
+    v1 = _mm256_sub_epi16 (d1, _mm256_srli_si256 (d1, 8));
+}
+
+
+IMF_TARGET_AVX2 int
+packBlocks_avx2 (const unsigned short * const rows[4],
+		 int nBlocks,
+		 unsigned char *out,
+		 bool optFlatFields,
+		 bool exactMax)
+{
+    const __m256i one   = _mm256_set1_epi16 (1);
+    const __m256i bias  = _mm256_set1_epi16 (0x20);
+    const __m256i rMax  = _mm256_set1_epi16 (0x3f);
+    const __m256i maskH = _mm256_set_epi16 (0, -1, -1, -1, 0, -1, -1, -1,
+					    0, -1, -1, -1, 0, -1, -1, -1);
+    const __m256i maskV0 = _mm256_set_epi16 (0, 0, 0, -1, 0, 0, 0, -1,
+					     0, 0, 0, -1, 0, 0, 0, -1);
+    const __m256i maskV1 = _mm256_set_epi16 (0, 0, 0, 0, 0, 0, 0, -1,
+					     0, 0, 0, 0, 0, 0, 0, -1);
+    const __m256i beBytes = _mm256_setr_epi8 (
+	2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+	2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    unsigned char *outStart = out;
+    int i = 0;
+
+    for (; i + 2 <= nBlocks; i += 2)
+    {
+	__m128i r0 = _mm_loadu_si128 ((const __m128i *) (rows[0] + 4 * i));
+	__m128i r1 = _mm_loadu_si128 ((const __m128i *) (rows[1] + 4 * i));
+	__m128i r2 = _mm_loadu_si128 ((const __m128i *) (rows[2] + 4 * i));
+	__m128i r3 = _mm_loadu_si128 ((const __m128i *) (rows[3] + 4 * i));
+
+	__m256i t0 = orderedBits_avx2 (
+	    combine_avx2 (_mm_unpacklo_epi64 (r0, r1),
+			       _mm_unpackhi_epi64 (r0, r1)));
+	__m256i t1 = orderedBits_avx2 (
+	    combine_avx2 (_mm_unpacklo_epi64 (r2, r3),
+			       _mm_unpackhi_epi64 (r2, r3)));
+
+	//
+	// Maximum of each block, in all lanes of its half
+	//
+
+	__m256i m = _mm256_max_epu16 (t0, t1);
+	m = _mm256_max_epu16 (m, _mm256_shuffle_epi32 (m, _MM_SHUFFLE (1, 0, 3, 2)));
+	m = _mm256_max_epu16 (m, _mm256_shuffle_epi32 (m, _MM_SHUFFLE (2, 3, 0, 1)));
+	m = _mm256_max_epu16 (m, _mm256_shufflelo_epi16 (m, _MM_SHUFFLE (2, 3, 0, 1)));
+	__m256i tMax = _mm256_shuffle_epi32 (_mm256_shufflelo_epi16 (m, 0), 0);
+
+	__m256i x0 = _mm256_sub_epi16 (tMax, t0);
+	__m256i x1 = _mm256_sub_epi16 (tMax, t1);
+
+	//
+	// Search the shifts of both blocks together, keeping the
+	// differences of a block once its shift has been found.
+	//
+
+	__m256i d0 = x0, d1 = x1, h0, h1, v0, v1;
+	int shift[2] = {0, 0};
+	int found = 0;
+
+	runningDiffs_avx2 (d0, d1, h0, h1, v0, v1);
+
+	for (;;)
+	{
+	    __m256i outOfRange = _mm256_or_si256 (
+		_mm256_or_si256 (
+		    _mm256_and_si256 (_mm256_subs_epu16 (_mm256_add_epi16 (h0, bias), rMax), maskH),
+		    _mm256_and_si256 (_mm256_subs_epu16 (_mm256_add_epi16 (h1, bias), rMax), maskH)),
+		_mm256_or_si256 (
+		    _mm256_and_si256 (_mm256_subs_epu16 (_mm256_add_epi16 (v0, bias), rMax), maskV0),
+		    _mm256_and_si256 (_mm256_subs_epu16 (_mm256_add_epi16 (v1, bias), rMax), maskV1)));
+
+	    unsigned int inRange = _mm256_movemask_epi8 (
+		_mm256_cmpeq_epi16 (outOfRange, _mm256_setzero_si256 ()));
+
+	    if ((inRange & 0xffff) == 0xffff)
+		found |= 1;
+
+	    if ((inRange >> 16) == 0xffff)
+		found |= 2;
+
+	    if (found == 3)
+		break;
+
+	    //
+	    // Next shift for the blocks still searching; the others
+	    // get recomputed with any valid shift and then discarded.
+	    //
+
+	    for (int b = 0; b < 2; ++b)
+		if (!(found & (1 << b)))
+		    ++shift[b];
+
+	    int s0 = shift[0] > 0 ? shift[0] : 1;
+	    int s1 = shift[1] > 0 ? shift[1] : 1;
+
+	    __m256i down = combine_avx2 (_mm_set1_epi16 ((short) (1 << (16 - s0))),
+					      _mm_set1_epi16 ((short) (1 << (16 - s1))));
+	    __m256i up = combine_avx2 (_mm_set1_epi16 ((short) (1 << s0)),
+					    _mm_set1_epi16 ((short) (1 << s1)));
+	    __m256i half = combine_avx2 (_mm_set1_epi16 ((short) (1 << (s0 - 1))),
+					      _mm_set1_epi16 ((short) (1 << (s1 - 1))));
+	    __m256i keep = combine_avx2 (_mm_set1_epi16 ((found & 1) ? -1 : 0),
+					      _mm_set1_epi16 ((found & 2) ? -1 : 0));
+
+	    __m256i q0 = _mm256_mulhi_epu16 (x0, down);
+	    __m256i q1 = _mm256_mulhi_epu16 (x1, down);
+	    __m256i n0 = _mm256_sub_epi16 (q0, _mm256_cmpgt_epi16 (
+		_mm256_add_epi16 (_mm256_sub_epi16 (x0, _mm256_mullo_epi16 (q0, up)),
+				  _mm256_and_si256 (q0, one)), half));
+	    __m256i n1 = _mm256_sub_epi16 (q1, _mm256_cmpgt_epi16 (
+		_mm256_add_epi16 (_mm256_sub_epi16 (x1, _mm256_mullo_epi16 (q1, up)),
+				  _mm256_and_si256 (q1, one)), half));
+
+	    d0 = _mm256_blendv_epi8 (n0, d0, keep);
+	    d1 = _mm256_blendv_epi8 (n1, d1, keep);
+
+	    runningDiffs_avx2 (d0, d1, h0, h1, v0, v1);
+	}
+
+	__m256i nonZero = _mm256_or_si256 (
+	    _mm256_or_si256 (_mm256_and_si256 (h0, maskH), _mm256_and_si256 (h1, maskH)),
+	    _mm256_or_si256 (_mm256_and_si256 (v0, maskV0), _mm256_and_si256 (v1, maskV1)));
+	unsigned int flat = _mm256_movemask_epi8 (
+	    _mm256_cmpeq_epi16 (nonZero, _mm256_setzero_si256 ()));
+
+	//
+	// Gather and pack the fields of both blocks as in pack_sse2()
+	//
+
+	h0 = _mm256_add_epi16 (h0, bias);
+	h1 = _mm256_add_epi16 (h1, bias);
+	v0 = _mm256_add_epi16 (v0, bias);
+	v1 = _mm256_add_epi16 (v1, bias);
+
+	__m256i a = _mm256_unpacklo_epi16 (h0, h1);
+	__m256i c = _mm256_unpackhi_epi16 (h0, h1);
+	__m256i f1 = _mm256_unpacklo_epi16 (a, c);
+	__m256i f2 = _mm256_unpackhi_epi16 (a, c);
+
+	//
+	// f0 = shift, v0[0], v0[4], v1[0] of each block
+	//
+
+	__m256i f0 = _mm256_blend_epi16 (
+	    _mm256_shufflelo_epi16 (_mm256_unpacklo_epi16 (v0, _mm256_srli_si256 (v0, 8)),
+				    _MM_SHUFFLE (3, 1, 0, 0)),
+	    _mm256_slli_si256 (v1, 6), 0x08);
+	f0 = _mm256_blend_epi16 (
+	    f0, combine_avx2 (_mm_cvtsi32_si128 (shift[0]),
+				   _mm_cvtsi32_si128 (shift[1])), 0x01);
+
+	__m256i flo = _mm256_unpacklo_epi64 (f0, f1);
+	__m256i fhi = _mm256_unpackhi_epi64 (f1, _mm256_slli_si256 (f2, 8));
+	__m256i k64 = _mm256_set1_epi32 ((1 << 16) | 64);
+	__m256i pairs = _mm256_packs_epi32 (_mm256_madd_epi16 (flo, k64),
+					    _mm256_madd_epi16 (fhi, k64));
+	__m256i bytes = _mm256_shuffle_epi8 (
+	    _mm256_madd_epi16 (pairs, _mm256_set1_epi32 ((1 << 16) | 4096)),
+	    beBytes);
+
+	for (int b = 0; b < 2; ++b)
+	{
+	    __m128i tb = b ? _mm256_extracti128_si256 (t0, 1)
+			   : _mm256_castsi256_si128 (t0);
+	    unsigned short t = _mm_cvtsi128_si32 (tb);
+
+	    if (optFlatFields && ((flat >> (16 * b)) & 0xffff) == 0xffff)
+	    {
+		out[0] = (t >> 8);
+		out[1] = (unsigned char) t;
+		out[2] = 0xfc;
+		out += 3;
+		continue;
+	    }
+
+	    if (exactMax)
+	    {
+		__m128i mb = b ? _mm256_extracti128_si256 (tMax, 1)
+			       : _mm256_castsi256_si128 (tMax);
+		__m128i db = b ? _mm256_extracti128_si256 (d0, 1)
+			       : _mm256_castsi256_si128 (d0);
+
+		t = (unsigned short) (_mm_cvtsi128_si32 (mb) -
+				      ((_mm_cvtsi128_si32 (db) & 0xffff) << shift[b]));
+	    }
+
+	    __m128i bb = b ? _mm256_extracti128_si256 (bytes, 1)
+			   : _mm256_castsi256_si128 (bytes);
+	    unsigned int last = _mm_cvtsi128_si32 (_mm_srli_si128 (bb, 8));
+
+	    out[0] = (t >> 8);
+	    out[1] = (unsigned char) t;
+	    _mm_storel_epi64 ((__m128i *) (out + 2), bb);
+	    memcpy (out + 10, &last, 4);
+	    out += 14;
+	}
+    }
+
+    if (i < nBlocks)
+    {
+	const unsigned short *tail[4] = {rows[0] + 4 * i, rows[1] + 4 * i,
+					 rows[2] + 4 * i, rows[3] + 4 * i};
+
+	out += packBlocks_sse2 (tail, nBlocks - i, out, optFlatFields, exactMax);
+    }
+
+    return static_cast<int> (out - outStart);
+}
+
+
+IMF_TARGET_AVX2 int
+unpackBlocks_avx2 (const unsigned char *in,
+		   int inSize,
+		   int nBlocks,
+		   unsigned short * const rows[4])
+{
+    const __m256i mask = _mm256_set1_epi32 (0x3f);
+    const __m256i bias = _mm256_set1_epi16 (0x20);
+
+    //
+    // The four 24-bit groups and the first pixel, from the first
+    // 16 bytes of a block
+    //
+
+    const __m256i groupBytes = _mm256_setr_epi8 (
+	4, 3, 2, -1, 7, 6, 5, -1, 10, 9, 8, -1, 13, 12, 11, -1,
+	4, 3, 2, -1, 7, 6, 5, -1, 10, 9, 8, -1, 13, 12, 11, -1);
+    const __m256i firstBytes = _mm256_setr_epi8 (
+	1, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	1, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    const unsigned char *inStart = in;
+    int i = 0;
+
+    while (i < nBlocks)
+    {
+	//
+	// Two 14-byte blocks, with the 16-byte loads inside the input
+	//
+
+	if (i + 2 > nBlocks || inSize < 30 ||
+	    in[2] >= (13 << 2) || in[16] >= (13 << 2))
+	{
+	    __m128i s0, s1;
+
+	    if (inSize < 3)
+		return -1;
+
+	    if (in[2] >= (13 << 2))
+	    {
+		unpack3_sse2 (in, s0, s1);
+		in += 3;
+		inSize -= 3;
+	    }
+	    else
+	    {
+		if (inSize < 14)
+		    return -1;
+
+		unpack14_sse2 (in, s0, s1);
+		in += 14;
+		inSize -= 14;
+	    }
+
+	    storeBlock_sse2 (rows, i, s0, s1);
+	    ++i;
+	    continue;
+	}
+
+	__m256i v = combine_avx2 (_mm_loadu_si128 ((const __m128i *) in),
+				       _mm_loadu_si128 ((const __m128i *) (in + 14)));
+	__m256i g = _mm256_shuffle_epi8 (v, groupBytes);
+	__m256i scale = combine_avx2 (_mm_set1_epi16 ((short) (1 << (in[2] >> 2))),
+					   _mm_set1_epi16 ((short) (1 << (in[16] >> 2))));
+
+	__m256i r0 = _mm256_packs_epi32 (_mm256_and_si256 (_mm256_srli_epi32 (g, 18), mask),
+					 _mm256_and_si256 (_mm256_srli_epi32 (g, 12), mask));
+	__m256i r1 = _mm256_packs_epi32 (_mm256_and_si256 (_mm256_srli_epi32 (g, 6), mask),
+					 _mm256_and_si256 (g, mask));
+
+	r0 = _mm256_mullo_epi16 (_mm256_sub_epi16 (r0, bias), scale);
+	r1 = _mm256_mullo_epi16 (_mm256_sub_epi16 (r1, bias), scale);
+	r0 = _mm256_blend_epi16 (r0, _mm256_shuffle_epi8 (v, firstBytes), 0x01);
+
+	r0 = _mm256_add_epi16 (r0, _mm256_slli_epi64 (r0, 16));
+	r1 = _mm256_add_epi16 (r1, _mm256_slli_epi64 (r1, 16));
+	r0 = _mm256_add_epi16 (r0, _mm256_slli_epi64 (r0, 32));
+	r1 = _mm256_add_epi16 (r1, _mm256_slli_epi64 (r1, 32));
+
+	__m256i c0 = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (r0, 0), 0);
+	__m256i c1 = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (r1, 0), 0);
+	__m256i c01 = _mm256_add_epi16 (c0, _mm256_srli_si256 (c0, 8));
+
+	r0 = _mm256_add_epi16 (r0, _mm256_slli_si256 (c0, 8));
+	r1 = _mm256_add_epi16 (r1, _mm256_add_epi16 (_mm256_unpacklo_epi64 (c01, c01),
+						      _mm256_slli_si256 (c1, 8)));
+
+	r0 = _mm256_permute4x64_epi64 (signMagnitude_avx2 (r0), _MM_SHUFFLE (3, 1, 2, 0));
+	r1 = _mm256_permute4x64_epi64 (signMagnitude_avx2 (r1), _MM_SHUFFLE (3, 1, 2, 0));
+
+	_mm_storeu_si128 ((__m128i *) (rows[0] + 4 * i), _mm256_castsi256_si128 (r0));
+	_mm_storeu_si128 ((__m128i *) (rows[1] + 4 * i), _mm256_extracti128_si256 (r0, 1));
+	_mm_storeu_si128 ((__m128i *) (rows[2] + 4 * i), _mm256_castsi256_si128 (r1));
+	_mm_storeu_si128 ((__m128i *) (rows[3] + 4 * i), _mm256_extracti128_si256 (r1, 1));
+
+	in += 28;
+	inSize -= 28;
+	i += 2;
+    }
+
+    return static_cast<int> (in - inStart);
+}
+
+#endif // IMF_HAVE_AVX2_TARGET
+
+
+#ifdef IMF_HAVE_NEON
+
+inline uint16x8_t
+orderedBits_neon (uint16x8_t s)
+{
+    const uint16x8_t sign = vdupq_n_u16 (0x8000);
+    const uint16x8_t expo = vdupq_n_u16 (0x7c00);
+    uint16x8_t neg = vreinterpretq_u16_s16 (vshrq_n_s16 (vreinterpretq_s16_u16 (s), 15));
+    uint16x8_t infNan = vceqq_u16 (vandq_u16 (s, expo), expo);
+
+    return vbslq_u16 (infNan, sign, veorq_u16 (s, vorrq_u16 (neg, sign)));
+}
+
+
+inline uint16x8_t
+signMagnitude_neon (uint16x8_t t)
+{
+    const uint16x8_t sign = vdupq_n_u16 (0x8000);
+    uint16x8_t neg = vreinterpretq_u16_s16 (vshrq_n_s16 (vreinterpretq_s16_u16 (t), 15));
+
+    return vbicq_u16 (veorq_u16 (t, vmvnq_u16 (neg)), vandq_u16 (neg, sign));
+}
+
+
+inline uint16x8_t
+prefixSumRows_neon (uint16x8_t x)
+{
+    x = vaddq_u16 (x, vreinterpretq_u16_u64 (vshlq_n_u64 (vreinterpretq_u64_u16 (x), 16)));
+    return vaddq_u16 (x, vreinterpretq_u16_u64 (vshlq_n_u64 (vreinterpretq_u64_u16 (x), 32)));
+}
+
+
+inline void
+runningDiffs_neon (uint16x8_t d0, uint16x8_t d1,
+		   uint16x8_t &h0, uint16x8_t &h1, uint16x8_t &v0, uint16x8_t &v1)
+{
+    const uint16x8_t zero = vdupq_n_u16 (0);
+
+    h0 = vsubq_u16 (d0, vreinterpretq_u16_u64 (vshrq_n_u64 (vreinterpretq_u64_u16 (d0), 16)));
+    h1 = vsubq_u16 (d1, vreinterpretq_u16_u64 (vshrq_n_u64 (vreinterpretq_u64_u16 (d1), 16)));
+    v0 = vsubq_u16 (d0, vextq_u16 (d0, d1, 4));
+    v1 = vsubq_u16 (d1, vextq_u16 (d1, zero, 4));
+}
+
+
+inline bool
+allZero_neon (uint16x8_t x)
+{
+    uint64x2_t x64 = vreinterpretq_u64_u16 (x);
+
+    return (vgetq_lane_u64 (x64, 0) | vgetq_lane_u64 (x64, 1)) == 0;
+}
+
+
+int
+pack_neon (uint16x8_t s0, uint16x8_t s1,
+	   unsigned char b[14],
+	   bool optFlatFields,
+	   bool exactMax)
+{
+    static const uint16_t maskHBits[8]  = {0xffff, 0xffff, 0xffff, 0, 0xffff, 0xffff, 0xffff, 0};
+    static const uint16_t maskV0Bits[8] = {0xffff, 0, 0, 0, 0xffff, 0, 0, 0};
+    static const uint16_t maskV1Bits[8] = {0xffff, 0, 0, 0, 0, 0, 0, 0};
+
+    const uint16x8_t bias   = vdupq_n_u16 (0x20);
+    const uint16x8_t rMax   = vdupq_n_u16 (0x3f);
+    const uint16x8_t maskH  = vld1q_u16 (maskHBits);
+    const uint16x8_t maskV0 = vld1q_u16 (maskV0Bits);
+    const uint16x8_t maskV1 = vld1q_u16 (maskV1Bits);
+
+    uint16x8_t t0 = orderedBits_neon (s0);
+    uint16x8_t t1 = orderedBits_neon (s1);
+
+    uint16x8_t m8 = vmaxq_u16 (t0, t1);
+    uint16x4_t m4 = vmax_u16 (vget_low_u16 (m8), vget_high_u16 (m8));
+    m4 = vpmax_u16 (m4, m4);
+    m4 = vpmax_u16 (m4, m4);
+
+    uint16x8_t tMax = vdupq_lane_u16 (m4, 0);
+    uint16x8_t x0 = vsubq_u16 (tMax, t0);
+    uint16x8_t x1 = vsubq_u16 (tMax, t1);
+    uint16x8_t d0, d1, h0, h1, v0, v1;
+    int shift = 0;
+
+    //
+    // See pack_sse2()
+    //
+
+    for (;; ++shift)
+    {
+	if (shift == 0)
+	{
+	    d0 = x0;
+	    d1 = x1;
+	}
+	else
+	{
+	    int16x8_t down = vdupq_n_s16 ((int16_t) -shift);
+	    uint16x8_t low = vdupq_n_u16 ((uint16_t) ((1 << shift) - 1));
+	    uint16x8_t half = vdupq_n_u16 ((uint16_t) (1 << (shift - 1)));
+	    uint16x8_t one = vdupq_n_u16 (1);
+	    uint16x8_t q0 = vshlq_u16 (x0, down);
+	    uint16x8_t q1 = vshlq_u16 (x1, down);
+
+	    d0 = vsubq_u16 (q0, vcgtq_u16 (vaddq_u16 (vandq_u16 (x0, low),
+						      vandq_u16 (q0, one)), half));
+	    d1 = vsubq_u16 (q1, vcgtq_u16 (vaddq_u16 (vandq_u16 (x1, low),
+						      vandq_u16 (q1, one)), half));
+	}
+
+	runningDiffs_neon (d0, d1, h0, h1, v0, v1);
+
+	uint16x8_t out =
+	    vorrq_u16 (
+		vorrq_u16 (
+		    vandq_u16 (vqsubq_u16 (vaddq_u16 (h0, bias), rMax), maskH),
+		    vandq_u16 (vqsubq_u16 (vaddq_u16 (h1, bias), rMax), maskH)),
+		vorrq_u16 (
+		    vandq_u16 (vqsubq_u16 (vaddq_u16 (v0, bias), rMax), maskV0),
+		    vandq_u16 (vqsubq_u16 (vaddq_u16 (v1, bias), rMax), maskV1)));
+
+	if (allZero_neon (out))
+	    break;
+    }
+
+    unsigned short t = vgetq_lane_u16 (t0, 0);
+
+    if (optFlatFields &&
+	allZero_neon (vorrq_u16 (vorrq_u16 (vandq_u16 (h0, maskH),
+					    vandq_u16 (h1, maskH)),
+				 vorrq_u16 (vandq_u16 (v0, maskV0),
+					    vandq_u16 (v1, maskV1)))))
+    {
+	b[0] = (t >> 8);
+	b[1] = (unsigned char) t;
+	b[2] = 0xfc;
+
+	return 3;
+    }
+
+    if (exactMax)
+	t = vgetq_lane_u16 (tMax, 0) - (vgetq_lane_u16 (d0, 0) << shift);
+
+    h0 = vaddq_u16 (h0, bias);
+    h1 = vaddq_u16 (h1, bias);
+
+    uint16x8x2_t ac = vzipq_u16 (h0, h1);
+    uint16x8x2_t f12 = vzipq_u16 (ac.val[0], ac.val[1]);
+
+    uint16_t f0Bits[4] = {(uint16_t) shift,
+			  (uint16_t) (vgetq_lane_u16 (v0, 0) + 0x20),
+			  (uint16_t) (vgetq_lane_u16 (v0, 4) + 0x20),
+			  (uint16_t) (vgetq_lane_u16 (v1, 0) + 0x20)};
+
+    uint16x8_t flo = vcombine_u16 (vld1_u16 (f0Bits), vget_low_u16 (f12.val[0]));
+    uint16x8_t fhi = vcombine_u16 (vget_high_u16 (f12.val[0]), vget_low_u16 (f12.val[1]));
+
+    uint16x8x2_t eo = vuzpq_u16 (flo, fhi);
+    uint16x8_t pairs = vmlaq_n_u16 (eo.val[1], eo.val[0], 64);
+    uint16x4x2_t peo = vuzp_u16 (vget_low_u16 (pairs), vget_high_u16 (pairs));
+    uint32x4_t groups = vmlal_n_u16 (vmovl_u16 (peo.val[1]), peo.val[0], 4096);
+
+    uint32_t g[4];
+    vst1q_u32 (g, groups);
+
+    b[0] = (t >> 8);
+    b[1] = (unsigned char) t;
+
+    for (int j = 0; j < 4; ++j)
+    {
+	b[2 + 3 * j] = (unsigned char) (g[j] >> 16);
+	b[3 + 3 * j] = (unsigned char) (g[j] >> 8);
+	b[4 + 3 * j] = (unsigned char) g[j];
+    }
+
+    return 14;
+}
+
+
+inline void
+unpack14_neon (const unsigned char b[14], uint16x8_t &s0, uint16x8_t &s1)
+{
+    const uint32x4_t mask = vdupq_n_u32 (0x3f);
+    const uint16x8_t bias = vdupq_n_u16 (0x20);
+    const uint16x8_t zero = vdupq_n_u16 (0);
+
+    uint32_t gBits[4] = {readBe24 (b + 2), readBe24 (b + 5),
+			 readBe24 (b + 8), readBe24 (b + 11)};
+    uint32x4_t g = vld1q_u32 (gBits);
+    uint16x8_t scale = vdupq_n_u16 ((uint16_t) (1 << (b[2] >> 2)));
+
+    uint16x8_t r0 = vcombine_u16 (vmovn_u32 (vandq_u32 (vshrq_n_u32 (g, 18), mask)),
+				  vmovn_u32 (vandq_u32 (vshrq_n_u32 (g, 12), mask)));
+    uint16x8_t r1 = vcombine_u16 (vmovn_u32 (vandq_u32 (vshrq_n_u32 (g, 6), mask)),
+				  vmovn_u32 (vandq_u32 (g, mask)));
+
+    r0 = vmulq_u16 (vsubq_u16 (r0, bias), scale);
+    r1 = vmulq_u16 (vsubq_u16 (r1, bias), scale);
+    r0 = vsetq_lane_u16 ((uint16_t) ((b[0] << 8) | b[1]), r0, 0);
+
+    r0 = prefixSumRows_neon (r0);
+    r1 = prefixSumRows_neon (r1);
+
+    uint16x8_t c0 = vcombine_u16 (vdup_lane_u16 (vget_low_u16 (r0), 0),
+				  vdup_lane_u16 (vget_high_u16 (r0), 0));
+    uint16x8_t c1 = vcombine_u16 (vdup_lane_u16 (vget_low_u16 (r1), 0),
+				  vdup_lane_u16 (vget_high_u16 (r1), 0));
+    uint16x4_t s4 = vget_low_u16 (vaddq_u16 (c0, vextq_u16 (c0, zero, 4)));
+
+    r0 = vaddq_u16 (r0, vextq_u16 (zero, c0, 4));
+    r1 = vaddq_u16 (r1, vaddq_u16 (vcombine_u16 (s4, s4), vextq_u16 (zero, c1, 4)));
+
+    s0 = signMagnitude_neon (r0);
+    s1 = signMagnitude_neon (r1);
+}
+
+
+int
+packBlocks_neon (const unsigned short * const rows[4],
+		 int nBlocks,
+		 unsigned char *out,
+		 bool optFlatFields,
+		 bool exactMax)
+{
+    unsigned char *outStart = out;
+
+    for (int i = 0; i < nBlocks; ++i)
+    {
+	uint16x8_t s0 = vcombine_u16 (vld1_u16 (rows[0] + 4 * i),
+				      vld1_u16 (rows[1] + 4 * i));
+	uint16x8_t s1 = vcombine_u16 (vld1_u16 (rows[2] + 4 * i),
+				      vld1_u16 (rows[3] + 4 * i));
+
+	out += pack_neon (s0, s1, out, optFlatFields, exactMax);
+    }
+
+    return static_cast<int> (out - outStart);
+}
+
+
+int
+unpackBlocks_neon (const unsigned char *in,
+		   int inSize,
+		   int nBlocks,
+		   unsigned short * const rows[4])
+{
+    const unsigned char *inStart = in;
+
+    for (int i = 0; i < nBlocks; ++i)
+    {
+	uint16x8_t s0, s1;
+
+	if (inSize < 3)
+	    return -1;
+
+	if (in[2] >= (13 << 2))
+	{
+	    s0 = s1 = signMagnitude_neon (vdupq_n_u16 ((uint16_t) ((in[0] << 8) | in[1])));
+	    in += 3;
+	    inSize -= 3;
+	}
+	else
+	{
+	    if (inSize < 14)
+		return -1;
+
+	    unpack14_neon (in, s0, s1);
+	    in += 14;
+	    inSize -= 14;
+	}
+
+	vst1_u16 (rows[0] + 4 * i, vget_low_u16 (s0));
+	vst1_u16 (rows[1] + 4 * i, vget_high_u16 (s0));
+	vst1_u16 (rows[2] + 4 * i, vget_low_u16 (s1));
+	vst1_u16 (rows[3] + 4 * i, vget_high_u16 (s1));
+    }
+
+    return static_cast<int> (in - inStart);
+}
+
+#endif // IMF_HAVE_NEON
+
+
+//
+// Function pointers for dispatching the kernels, defaulting to the
+// best compile time choice and upgraded by initializeFuncs()
+//
+
+typedef int (*PackBlocksFunc) (const unsigned short * const rows[4],
+			       int nBlocks,
+			       unsigned char *out,
+			       bool optFlatFields,
+			       bool exactMax);
+
+typedef int (*UnpackBlocksFunc) (const unsigned char *in,
+				 int inSize,
+				 int nBlocks,
+				 unsigned short * const rows[4]);
+
+#if defined(IMF_HAVE_SSE2)
+PackBlocksFunc packBlocksFunc = packBlocks_sse2;
+UnpackBlocksFunc unpackBlocksFunc = unpackBlocks_sse2;
+#elif defined(IMF_HAVE_NEON)
+PackBlocksFunc packBlocksFunc = packBlocks_neon;
+UnpackBlocksFunc unpackBlocksFunc = unpackBlocks_neon;
+#else
+PackBlocksFunc packBlocksFunc = packBlocks_scalar;
+UnpackBlocksFunc unpackBlocksFunc = unpackBlocks_scalar;
+#endif
+
 } // namespace
 
 
+int
+B44Compressor::packBlocks (const unsigned short * const rows[4],
+			   int nBlocks,
+			   unsigned char *out,
+			   bool optFlatFields,
+			   bool exactMax)
+{
+    return packBlocksFunc (rows, nBlocks, out, optFlatFields, exactMax);
+}
+
+
+int
+B44Compressor::unpackBlocks (const unsigned char *in,
+			     int inSize,
+			     int nBlocks,
+			     unsigned short * const rows[4])
+{
+    return unpackBlocksFunc (in, inSize, nBlocks, rows);
+}
+
+
+void
+B44Compressor::initializeFuncs ()
+{
+#ifdef IMF_HAVE_AVX2_TARGET
+    CpuId cpuId;
+
+    if (cpuId.avx2)
+    {
+	packBlocksFunc = packBlocks_avx2;
+	unpackBlocksFunc = unpackBlocks_avx2;
+    }
+#endif
+}
+
+
 struct B44Compressor::ChannelData
 {
     unsigned short *	start;
@@ -758,71 +1908,58 @@ B44Compressor::compress (const char *inPtr,
 	// HALF channel
 	//
 
+	if (cd.pLinear)
+	    convertFromLinear (cd.start, cd.nx * cd.ny);
+
 	for (int y = 0; y < cd.ny; y += 4)
 	{
 	    //
-	    // Copy the next 4x4 pixel block into array s.
-	    // If the width, cd.nx, or the height, cd.ny, of
-	    // the pixel data in _tmpBuffer is not divisible
-	    // by 4, then pad the data by repeating the
-	    // rightmost column and the bottom row.
+	    // Compress the next row of 4x4 pixel blocks and
+	    // append the results to the output buffer.  If the
+	    // width, cd.nx, or the height, cd.ny, of the pixel
+	    // data in _tmpBuffer is not divisible by 4, then pad
+	    // the data by repeating the rightmost column and the
+	    // bottom row.
 	    // 
 
-	    unsigned short *row0 = cd.start + y * cd.nx;
-	    unsigned short *row1 = row0 + cd.nx;
-	    unsigned short *row2 = row1 + cd.nx;
-	    unsigned short *row3 = row2 + cd.nx;
+	    const unsigned short *rows[4];
+
+	    rows[0] = cd.start + y * cd.nx;
+	    rows[1] = rows[0] + cd.nx;
+	    rows[2] = rows[1] + cd.nx;
+	    rows[3] = rows[2] + cd.nx;
 
 	    if (y + 3 >= cd.ny)
 	    {
 		if (y + 1 >= cd.ny)
-		    row1 = row0;
+		    rows[1] = rows[0];
 
 		if (y + 2 >= cd.ny)
-		    row2 = row1;
+		    rows[2] = rows[1];
 
-		row3 = row2;
+		rows[3] = rows[2];
 	    }
 
-	    for (int x = 0; x < cd.nx; x += 4)
+	    int nBlocks = cd.nx / 4;
+
+	    outEnd += packBlocksFunc (rows, nBlocks, (unsigned char *) outEnd,
+				      _optFlatFields, !cd.pLinear);
+
+	    if (int n = cd.nx - 4 * nBlocks)
 	    {
 		unsigned short s[16];
+		int x = 4 * nBlocks;
 
-		if (x + 3 >= cd.nx)
+		for (int i = 0; i < 4; ++i)
 		{
-		    int n = cd.nx - x;
-
-		    for (int i = 0; i < 4; ++i)
-		    {
-			int j = min (i, n - 1);
+		    int j = x + min (i, n - 1);
 
-			s[i +  0] = row0[j];
-			s[i +  4] = row1[j];
-			s[i +  8] = row2[j];
-			s[i + 12] = row3[j];
-		    }
-		}
-		else
-		{
-		    memcpy (&s[ 0], row0, 4 * sizeof (unsigned short));
-		    memcpy (&s[ 4], row1, 4 * sizeof (unsigned short));
-		    memcpy (&s[ 8], row2, 4 * sizeof (unsigned short));
-		    memcpy (&s[12], row3, 4 * sizeof (unsigned short));
+		    s[i +  0] = rows[0][j];
+		    s[i +  4] = rows[1][j];
+		    s[i +  8] = rows[2][j];
+		    s[i + 12] = rows[3][j];
 		}
 
-		row0 += 4;
-		row1 += 4;
-		row2 += 4;
-		row3 += 4;
-
-		//
-		// Compress the contents of array s and append the
-		// results to the output buffer.
-		//
-
-		if (cd.pLinear)
-		    convertFromLinear (s);
-
 		outEnd += pack (s, (unsigned char *) outEnd,
 				_optFlatFields, !cd.pLinear);
 	    }
@@ -907,68 +2044,62 @@ B44Compressor::uncompress (const char *inPtr,
 
 	for (int y = 0; y < cd.ny; y += 4)
 	{
-	    unsigned short *row0 = cd.start + y * cd.nx;
-	    unsigned short *row1 = row0 + cd.nx;
-	    unsigned short *row2 = row1 + cd.nx;
-	    unsigned short *row3 = row2 + cd.nx;
+	    unsigned short *rows[4];
+
+	    rows[0] = cd.start + y * cd.nx;
+	    rows[1] = rows[0] + cd.nx;
+	    rows[2] = rows[1] + cd.nx;
+	    rows[3] = rows[2] + cd.nx;
+
+	    //
+	    // Uncompress whole blocks directly into _tmpBuffer,
+	    // and blocks that extend past the right or the bottom
+	    // edge of the pixel data into array s first.
+	    //
 
-	    for (int x = 0; x < cd.nx; x += 4)
+	    int nBlocks = (y + 3 < cd.ny)? cd.nx / 4: 0;
+	    int nIn = unpackBlocksFunc ((const unsigned char *) inPtr, inSize,
+					nBlocks, rows);
+
+	    if (nIn < 0)
+		notEnoughData();
+
+	    inPtr += nIn;
+	    inSize -= nIn;
+
+	    for (int x = 4 * nBlocks; x < cd.nx; x += 4)
 	    {
 		unsigned short s[16]; 
+		unsigned short * const sRows[4] = {&s[0], &s[4], &s[8], &s[12]};
 
-		if (inSize < 3)
-		    notEnoughData();
+		nIn = unpackBlocksFunc ((const unsigned char *) inPtr, inSize,
+					1, sRows);
 
-                //
-                // If shift exponent is 63, call unpack14 (ignoring unused bits)
-                //
-		if (((const unsigned char *)inPtr)[2] >= (13<<2) )
-		{
-		    unpack3 ((const unsigned char *)inPtr, s);
-		    inPtr += 3;
-		    inSize -= 3;
-		}
-		else
-		{
-		    if (inSize < 14)
-			notEnoughData();
-
-		    unpack14 ((const unsigned char *)inPtr, s);
-		    inPtr += 14;
-		    inSize -= 14;
-		}
+		if (nIn < 0)
+		    notEnoughData();
 
-		if (cd.pLinear)
-		    convertToLinear (s);
+		inPtr += nIn;
+		inSize -= nIn;
 
 		int n = (x + 3 < cd.nx)?
 			    4 * sizeof (unsigned short) :
 			    (cd.nx - x) * sizeof (unsigned short);
 
-		if (y + 3 < cd.ny)
-		{
-		    memcpy (row0, &s[ 0], n);
-		    memcpy (row1, &s[ 4], n);
-		    memcpy (row2, &s[ 8], n);
-		    memcpy (row3, &s[12], n);
-		}
-		else
-		{
-		    memcpy (row0, &s[ 0], n);
+		memcpy (rows[0] + x, &s[ 0], n);
 
-		    if (y + 1 < cd.ny)
-			memcpy (row1, &s[ 4], n);
+		if (y + 1 < cd.ny)
+		    memcpy (rows[1] + x, &s[ 4], n);
 
-		    if (y + 2 < cd.ny)
-			memcpy (row2, &s[ 8], n);
-		}
+		if (y + 2 < cd.ny)
+		    memcpy (rows[2] + x, &s[ 8], n);
 
-		row0 += 4;
-		row1 += 4;
-		row2 += 4;
-		row3 += 4;
+		if (y + 3 < cd.ny)
+		    memcpy (rows[3] + x, &s[12], n);
 	    }
 	}
+
+	if (cd.pLinear)
+	    convertToLinear (cd.start, cd.nx * cd.ny);
     }
 
     char *outEnd = _outBuffer;
@@ -12,6 +12,7 @@
 //
 //-----------------------------------------------------------------------------
 
+#include "ImfExport.h"
 #include "ImfForward.h"
 
 #include "ImfCompressor.h"
@@ -58,6 +59,34 @@ class B44Compressor: public Compressor
 					int inSize,
 					IMATH_NAMESPACE::Box2i range,
 					const char *&outPtr);
+
+    //
+    // Compress and uncompress nBlocks consecutive 4x4 pixel blocks
+    // of a HALF channel, whose four rows start at rows[0] ... rows[3].
+    // packBlocks returns the number of bytes written to out, at most
+    // 14 per block.  unpackBlocks returns the number of bytes read
+    // from in, or -1 if inSize is too small to hold the blocks.
+    // Both use the fastest implementation the cpu supports.
+    //
+
+    IMF_EXPORT static int	packBlocks (const unsigned short * const rows[4],
+					    int nBlocks,
+					    unsigned char *out,
+					    bool optFlatFields,
+					    bool exactMax);
+
+    IMF_EXPORT static int	unpackBlocks (const unsigned char *in,
+					      int inSize,
+					      int nBlocks,
+					      unsigned short * const rows[4]);
+
+    //
+    // Select the SIMD implementations using CpuId, called from
+    // staticInitialize().
+    //
+
+    IMF_EXPORT static void	initializeFuncs ();
+
   private:
 
     struct ChannelData;
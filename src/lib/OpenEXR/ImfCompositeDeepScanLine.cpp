@@ -11,6 +11,7 @@
 #include "ImfFrameBuffer.h"
 #include "ImfDeepFrameBuffer.h"
 #include "ImfDeepCompositing.h"
+#include "ImfDeepCompositingPixels.h"
 #include "ImfPixelType.h"
 #include "IlmThreadPool.h"
 
@@ -269,7 +270,8 @@ class LineCompositeTask : public Task
                     int y,
                     int start,
                     vector<const char*>* names,
-                    vector<vector< vector<float *> > >* pointers,
+                    vector<vector<float> >* samples,
+                    vector<size_t>* line_offsets,
                     vector<unsigned int>* total_sizes,
                     vector<unsigned int>* num_sources
                   ) : Task(group) ,
@@ -277,7 +279,8 @@ class LineCompositeTask : public Task
                      _y(y),
                      _start(start),
                      _names(names),
-                     _pointers(pointers),
+                     _samples(samples),
+                     _line_offsets(line_offsets),
                      _total_sizes(total_sizes),
                      _num_sources(num_sources)
                      {}
@@ -289,7 +292,8 @@ class LineCompositeTask : public Task
     int                                  _y;
     int                                  _start;
     vector<const char *>*                _names;
-    vector<vector< vector<float *> > >*  _pointers;
+    vector<vector<float> >*              _samples;
+    vector<size_t>*                      _line_offsets;
     vector<unsigned int>*                _total_sizes;
     vector<unsigned int>*                _num_sources;
 
@@ -300,89 +304,83 @@ composite_line(int y,
                int start,
                CompositeDeepScanLine::Data * _Data,
                vector<const char *> & names,
-               const vector<vector< vector<float *> > >  & pointers,
+               const vector<vector<float> > & samples,
+               const vector<size_t> & line_offsets,
                const vector<unsigned int> & total_sizes,
                const vector<unsigned int> & num_sources
               )
 {
-    vector<float> output_pixel(names.size());    //the pixel we'll output to
-    vector<const float *> inputs(names.size());
-    DeepCompositing d; // fallback compositing engine
-    DeepCompositing * comp= _Data->_comp ? _Data->_comp : &d;
-
-    int pixel = (y-start)*(_Data->_dataWindow.max.x+1-_Data->_dataWindow.min.x);
-    
-     for(int x=_Data->_dataWindow.min.x;x<=_Data->_dataWindow.max.x;x++)
-     {
-           // set inputs[] to point to the first sample of the first part of each channel
-           // if there's a zback, set all channel independently...
-
-          if(_Data->_zback)
-          {
-
-              for(size_t channel=0;channel<names.size();channel++)
-              {
-                 inputs[channel]=pointers[0][channel][pixel];
-              }
-
-          }else{
-
-              // otherwise, set 0 and 1 to point to Z
-
-
-              inputs[0]=pointers[0][0][pixel];
-              inputs[1]=pointers[0][0][pixel];
-              for(size_t channel=2;channel<names.size();channel++)
-              {
-                  inputs[channel]=pointers[0][channel][pixel];
-              }
-
-          }
-          comp->composite_pixel(&output_pixel[0],
-                                &inputs[0],
-                                &names[0],
-                                static_cast<int>(names.size()),
-                                total_sizes[pixel],
-                                num_sources[pixel]
-                               );
-
+    int width = _Data->_dataWindow.max.x+1-_Data->_dataWindow.min.x;
+    size_t pixel = size_t(y-start)*width;
 
-           size_t channel_number=0;
+    //
+    // set inputs[] to point to the first sample of the first pixel on the row
+    // if there's no zback, set channel 1 to point to Z
+    //
 
+    vector<const float *> inputs(names.size());
+    for(size_t channel=0;channel<names.size();channel++)
+    {
+        size_t source = (channel==1 && !_Data->_zback) ? 0 : channel;
+        inputs[channel]=samples[source].data()+line_offsets[y-start];
+    }
 
-           //
-           // write out composited value into internal frame buffer
-           //
-           for(FrameBuffer::Iterator it = _Data->_outputFrameBuffer.begin();it !=_Data->_outputFrameBuffer.end();it++)
-           {
+    //
+    // composite the whole row: outputs[channel][x]
+    //
 
-               float value = output_pixel[ _Data->_bufferMap[channel_number] ]; // value to write
-               intptr_t base = reinterpret_cast<intptr_t>(it.slice().base);
+    vector<float> output_line(names.size()*width);
+    vector<float *> outputs(names.size());
+    for(size_t channel=0;channel<names.size();channel++)
+    {
+        outputs[channel]=&output_line[channel*width];
+    }
 
-                // cast to half float if necessary
-               if(it.slice().type==OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT)
-               {
-                   float* ptr = reinterpret_cast<float*>(base + y*it.slice().yStride + x*it.slice().xStride);
-                   *ptr  = value;
-               }
-               else if(it.slice().type==HALF)
-               {
-                   half* ptr =  reinterpret_cast<half*>(base + y*it.slice().yStride + x*it.slice().xStride);
-                   *ptr = half(value);
-               }
+    compositeDeepPixels(_Data->_comp,
+                        &outputs[0],
+                        &inputs[0],
+                        &names[0],
+                        static_cast<int>(names.size()),
+                        width,
+                        &total_sizes[pixel],
+                        &num_sources[pixel]
+                       );
 
-               channel_number++;
+    //
+    // write out composited values into internal frame buffer
+    //
 
-           }
+    size_t channel_number=0;
+    for(FrameBuffer::Iterator it = _Data->_outputFrameBuffer.begin();it !=_Data->_outputFrameBuffer.end();it++)
+    {
+        const float * values = outputs[ _Data->_bufferMap[channel_number] ]; // values to write
+        intptr_t base = reinterpret_cast<intptr_t>(it.slice().base) + y*it.slice().yStride;
 
-           pixel++;
+        // cast to half float if necessary
+        if(it.slice().type==OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT)
+        {
+            for(int x=_Data->_dataWindow.min.x;x<=_Data->_dataWindow.max.x;x++)
+            {
+                float* ptr = reinterpret_cast<float*>(base + x*it.slice().xStride);
+                *ptr  = values[x-_Data->_dataWindow.min.x];
+            }
+        }
+        else if(it.slice().type==HALF)
+        {
+            for(int x=_Data->_dataWindow.min.x;x<=_Data->_dataWindow.max.x;x++)
+            {
+                half* ptr =  reinterpret_cast<half*>(base + x*it.slice().xStride);
+                *ptr = half(values[x-_Data->_dataWindow.min.x]);
+            }
+        }
 
-       }// next pixel on row
+        channel_number++;
+    }
 }
 
 void LineCompositeTask::execute()
 {
-  composite_line(_y,_start,_Data,*_names,*_pointers,*_total_sizes,*_num_sources);
+  composite_line(_y,_start,_Data,*_names,*_samples,*_line_offsets,*_total_sizes,*_num_sources);
 }
 
 
@@ -449,6 +447,7 @@ CompositeDeepScanLine::readPixels(int start, int end)
    size_t total_pixels = total_width*(end-start+1);
    vector<unsigned int> total_sizes(total_pixels);
    vector<unsigned int> num_sources(total_pixels); //number of parts with non-zero sample count
+   vector<size_t> line_offsets(end-start+1);       //index of the first sample of each row
    
    size_t overall_sample_count=0; // sum of all samples in all images between start and end
    
@@ -458,6 +457,7 @@ CompositeDeepScanLine::readPixels(int start, int end)
    //
    for(size_t ptr=0;ptr<total_pixels;ptr++)
    {
+       if(ptr%total_width==0) line_offsets[ptr/total_width]=overall_sample_count;
        total_sizes[ptr]=0;
        num_sources[ptr]=0;
        for(size_t j=0;j<parts;j++)
@@ -552,7 +552,7 @@ CompositeDeepScanLine::readPixels(int start, int end)
    TaskGroup g;
    for(int y=start;y<=end;y++)
    {
-       ThreadPool::addGlobalTask(new LineCompositeTask(&g,_Data,y,start,&names,&pointers,&total_sizes,&num_sources));
+       ThreadPool::addGlobalTask(new LineCompositeTask(&g,_Data,y,start,&names,&samples,&line_offsets,&total_sizes,&num_sources));
    }//next row
 }  
 
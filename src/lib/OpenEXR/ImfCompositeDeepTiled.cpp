@@ -0,0 +1,653 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+
+#include "ImfCompositeDeepTiled.h"
+#include "ImfDeepTiledInputPart.h"
+#include "ImfDeepTiledInputFile.h"
+#include "ImfChannelList.h"
+#include "ImfHeader.h"
+#include "ImfFrameBuffer.h"
+#include "ImfDeepFrameBuffer.h"
+#include "ImfDeepCompositing.h"
+#include "ImfDeepCompositingPixels.h"
+#include "ImfPixelType.h"
+#include "ImfThreading.h"
+#include "IlmThreadPool.h"
+
+#include <Iex.h>
+#include <algorithm>
+#include <vector>
+#include <stddef.h>
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+using std::vector;
+using std::string;
+using IMATH_NAMESPACE::Box2i;
+using ILMTHREAD_NAMESPACE::Task;
+using ILMTHREAD_NAMESPACE::TaskGroup;
+using ILMTHREAD_NAMESPACE::ThreadPool;
+
+
+namespace
+{
+
+//
+// the samples of one tile, from all sources, ready for compositing
+//
+
+struct TileBuffer
+{
+    Box2i                   box;            // pixels in the tile
+    vector<vector<float> >  samples;        // samples[channel][sample]; pixel after pixel,
+                                            // the samples of all sources for each pixel
+    vector<size_t>          line_offsets;   // index of the first sample of each row
+    vector<unsigned int>    total_sizes;    // per-pixel sample counts of all sources
+    vector<unsigned int>    num_sources;    // per-pixel number of sources with samples
+};
+
+template <class T>
+bool
+validTile (const T * source, int dx, int dy, int lx, int ly)
+{
+    return source->isValidLevel(lx,ly) &&
+           dx>=0 && dx<source->numXTiles(lx) &&
+           dy>=0 && dy<source->numYTiles(ly);
+}
+
+}
+
+
+struct CompositeDeepTiled::Data{
+    public :
+    vector<DeepTiledInputFile *>        _file;   // array of files
+    vector<DeepTiledInputPart *>        _part;   // array of parts
+    FrameBuffer            _outputFrameBuffer;   // output frame buffer provided
+    bool                               _zback;   // true if we are using zback (otherwise channel 1 = channel 0)
+    Box2i                         _dataWindow;   // data window shared by all inputs
+    TileDescription                 _tileDesc;   // tile description shared by all inputs
+    DeepCompositing *                   _comp;   // user-provided compositor
+    vector<string>                  _channels;   // names of channels that will be composited
+    vector<int>                    _bufferMap;   // entry _outputFrameBuffer[n].name() == _channels[ _bufferMap[n] ].name()
+
+    void check_valid(const Header & header);     // check newly added part/file is OK; on first good call, set _zback/_dataWindow/_tileDesc
+
+    //
+    // tile geometry, from the first source
+    //
+
+    bool  isValidTile (int dx, int dy, int lx, int ly) const;
+    Box2i dataWindowForTile (int dx, int dy, int lx, int ly) const;
+
+    //
+    // set up the given deep frame buffer to contain the required channels
+    // resize counts and pointers to the size of box
+    //
+
+    void handleDeepFrameBuffer (DeepFrameBuffer & buf,
+                                vector<unsigned int> & counts,        //per-pixel counts
+                                vector< vector<float *> > & pointers, //per-channel-per-pixel pointers to data
+                                const Box2i & box);
+
+    //
+    // read and composite tiles dx1 to dx2 of tile row dy
+    //
+
+    void readTileRow (int dx1, int dx2, int dy, int lx, int ly,
+                      vector<const char *> & names);
+
+    Data();
+};
+
+CompositeDeepTiled::Data::Data() : _zback(false) , _comp(NULL) {}
+
+CompositeDeepTiled::CompositeDeepTiled() : _Data(new Data) {}
+
+CompositeDeepTiled::~CompositeDeepTiled()
+{
+   delete _Data;
+}
+
+void
+CompositeDeepTiled::addSource(DeepTiledInputPart* part)
+{
+  _Data->check_valid(part->header());
+  _Data->_part.push_back(part);
+}
+
+void
+CompositeDeepTiled::addSource(DeepTiledInputFile* file)
+{
+    _Data->check_valid(file->header());
+    _Data->_file.push_back(file);
+}
+
+int
+CompositeDeepTiled::sources() const
+{
+   return int(_Data->_part.size())+int(_Data->_file.size());
+}
+
+void
+CompositeDeepTiled::Data::check_valid(const Header & header)
+{
+
+    bool has_z=false;
+    bool has_alpha=false;
+    // check good channel names
+    for( ChannelList::ConstIterator i=header.channels().begin();i!=header.channels().end();++i)
+    {
+        std::string n(i.name());
+        if(n=="ZBack")
+        {
+            _zback=true;
+        }
+        else if(n=="Z")
+        {
+            has_z=true;
+        }
+        else if(n=="A")
+        {
+            has_alpha=true;
+        }
+    }
+
+    if(!has_z)
+    {
+        throw IEX_NAMESPACE::ArgExc("Deep data provided to CompositeDeepTiled is missing a Z channel");
+    }
+
+    if(!has_alpha)
+    {
+        throw IEX_NAMESPACE::ArgExc("Deep data provided to CompositeDeepTiled is missing an alpha channel");
+    }
+
+
+    if(_part.size()==0 && _file.size()==0)
+    {
+       // first in - update and return
+
+       _dataWindow = header.dataWindow();
+       _tileDesc = header.tileDescription();
+
+       return;
+    }
+
+
+    //
+    // tiles are composited with the corresponding tiles of the other
+    // sources, so all sources must be tiled in the same way
+    //
+
+    if(_dataWindow != header.dataWindow())
+    {
+        throw IEX_NAMESPACE::ArgExc("Deep data provided to CompositeDeepTiled has a different dataWindow to previously provided data");
+    }
+
+    if(!(_tileDesc == header.tileDescription()))
+    {
+        throw IEX_NAMESPACE::ArgExc("Deep data provided to CompositeDeepTiled has a different tile description to previously provided data");
+    }
+
+}
+
+bool
+CompositeDeepTiled::Data::isValidTile (int dx, int dy, int lx, int ly) const
+{
+    if(_part.size()>0)
+    {
+        return validTile(_part[0],dx,dy,lx,ly);
+    }
+
+    return validTile(_file[0],dx,dy,lx,ly);
+}
+
+Box2i
+CompositeDeepTiled::Data::dataWindowForTile (int dx, int dy, int lx, int ly) const
+{
+    if(_part.size()>0)
+    {
+        return _part[0]->dataWindowForTile(dx,dy,lx,ly);
+    }
+
+    return _file[0]->dataWindowForTile(dx,dy,lx,ly);
+}
+
+void
+CompositeDeepTiled::Data::handleDeepFrameBuffer (DeepFrameBuffer& buf,
+                                                 std::vector< unsigned int > & counts,
+                                                 vector< std::vector< float* > > & pointers,
+                                                 const Box2i & box)
+{
+    ptrdiff_t width=box.size().x+1;
+    size_t pixelcount = width * (box.size().y+1);
+    ptrdiff_t origin = box.min.x + box.min.y*width; // index of pixel (0,0)
+    pointers.resize(_channels.size());
+    counts.resize(pixelcount);
+    buf.insertSampleCountSlice (Slice (OPENEXR_IMF_INTERNAL_NAMESPACE::UINT,
+                                (char *) (&counts[0]-origin),
+                                sizeof(unsigned int),
+                                sizeof(unsigned int)*width));
+
+    pointers[0].resize(pixelcount);
+    buf.insert ("Z", DeepSlice (OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT,
+                                (char *)(&pointers[0][0]-origin),
+                                sizeof(float *),
+                                sizeof(float *)*width,
+                                sizeof(float) ));
+
+    if(_zback)
+    {
+        pointers[1].resize(pixelcount);
+        buf.insert ("ZBack", DeepSlice (OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT,
+                                        (char *)(&pointers[1][0]-origin),
+                                        sizeof(float *),
+                                        sizeof(float *)*width,
+                                        sizeof(float) ));
+    }
+
+    pointers[2].resize(pixelcount);
+    buf.insert ("A", DeepSlice (OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT,
+                                (char *)(&pointers[2][0]-origin),
+                                sizeof(float *),
+                                sizeof(float *)*width,
+                                sizeof(float) ));
+
+
+    size_t i =0;
+    for(FrameBuffer::ConstIterator qt  = _outputFrameBuffer.begin();
+                                   qt != _outputFrameBuffer.end();
+                                   qt++)
+    {
+        int channel_in_source = _bufferMap[i];
+        if(channel_in_source>2)
+        {
+            // not dealt with yet (0,1,2 previously inserted)
+            pointers[channel_in_source].resize(pixelcount);
+            buf.insert (qt.name(),
+                        DeepSlice (OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT,
+                                   (char *)(&pointers[channel_in_source][0]-origin),
+                                   sizeof(float *),
+                                   sizeof(float *)*width,
+                                   sizeof(float) ));
+        }
+
+        i++;
+    }
+
+}
+
+void
+CompositeDeepTiled::setCompositing(DeepCompositing* c)
+{
+  _Data->_comp=c;
+}
+
+const IMATH_NAMESPACE::Box2i& CompositeDeepTiled::dataWindow() const
+{
+  return  _Data->_dataWindow;
+}
+
+const TileDescription& CompositeDeepTiled::tileDescription() const
+{
+  return  _Data->_tileDesc;
+}
+
+
+void
+CompositeDeepTiled::setFrameBuffer(const FrameBuffer& fr)
+{
+
+    //
+    // count channels; build map between channels in frame buffer
+    // and channels in internal buffers
+    //
+
+    _Data->_channels.resize(3);
+    _Data->_channels[0]="Z";
+    _Data->_channels[1]=_Data->_zback ? "ZBack" : "Z";
+    _Data->_channels[2]="A";
+    _Data->_bufferMap.resize(0);
+
+    for(FrameBuffer::ConstIterator q=fr.begin();q!=fr.end();q++)
+    {
+        string name(q.name());
+        if(name=="ZBack")
+        {
+            _Data->_bufferMap.push_back(1);
+        }else if(name=="Z")
+        {
+            _Data->_bufferMap.push_back(0);
+        }else if(name=="A")
+        {
+            _Data->_bufferMap.push_back(2);
+        }else{
+            _Data->_bufferMap.push_back(static_cast<int>(_Data->_channels.size()));
+            _Data->_channels.push_back(name);
+        }
+    }
+
+  _Data->_outputFrameBuffer=fr;
+}
+
+const FrameBuffer&
+CompositeDeepTiled::frameBuffer() const
+{
+  return _Data->_outputFrameBuffer;
+}
+
+namespace
+{
+
+class TileCompositeTask : public Task
+{
+  public:
+
+    TileCompositeTask ( TaskGroup* group ,
+                        CompositeDeepTiled::Data * data,
+                        const TileBuffer * tile,
+                        vector<const char*>* names
+                      ) : Task(group) ,
+                         _Data(data),
+                         _tile(tile),
+                         _names(names)
+                         {}
+
+    virtual ~TileCompositeTask () {}
+
+    virtual void                execute ();
+    CompositeDeepTiled::Data*            _Data;
+    const TileBuffer*                    _tile;
+    vector<const char *>*                _names;
+
+};
+
+void
+composite_tile(CompositeDeepTiled::Data * _Data,
+               const TileBuffer & tile,
+               vector<const char *> & names
+              )
+{
+    int width = tile.box.max.x+1-tile.box.min.x;
+
+    //
+    // composited values of one row of the tile: outputs[channel][x]
+    //
+
+    vector<float> output_line(names.size()*width);
+    vector<float *> outputs(names.size());
+    for(size_t channel=0;channel<names.size();channel++)
+    {
+        outputs[channel]=&output_line[channel*width];
+    }
+
+    vector<const float *> inputs(names.size());
+
+    for(int y=tile.box.min.y;y<=tile.box.max.y;y++)
+    {
+        size_t row = y-tile.box.min.y;
+
+        //
+        // set inputs[] to point to the first sample of the row
+        // if there's no zback, set channel 1 to point to Z
+        //
+
+        for(size_t channel=0;channel<names.size();channel++)
+        {
+            size_t source = (channel==1 && !_Data->_zback) ? 0 : channel;
+            inputs[channel]=tile.samples[source].data()+tile.line_offsets[row];
+        }
+
+        compositeDeepPixels(_Data->_comp,
+                            &outputs[0],
+                            &inputs[0],
+                            &names[0],
+                            static_cast<int>(names.size()),
+                            width,
+                            &tile.total_sizes[row*width],
+                            &tile.num_sources[row*width]
+                           );
+
+        //
+        // write out composited values into internal frame buffer
+        //
+
+        size_t channel_number=0;
+        for(FrameBuffer::Iterator it = _Data->_outputFrameBuffer.begin();it !=_Data->_outputFrameBuffer.end();it++)
+        {
+            const float * values = outputs[ _Data->_bufferMap[channel_number] ]; // values to write
+            intptr_t base = reinterpret_cast<intptr_t>(it.slice().base) + y*it.slice().yStride;
+
+            // cast to half float if necessary
+            if(it.slice().type==OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT)
+            {
+                for(int x=tile.box.min.x;x<=tile.box.max.x;x++)
+                {
+                    float* ptr = reinterpret_cast<float*>(base + x*it.slice().xStride);
+                    *ptr  = values[x-tile.box.min.x];
+                }
+            }
+            else if(it.slice().type==HALF)
+            {
+                for(int x=tile.box.min.x;x<=tile.box.max.x;x++)
+                {
+                    half* ptr =  reinterpret_cast<half*>(base + x*it.slice().xStride);
+                    *ptr = half(values[x-tile.box.min.x]);
+                }
+            }
+
+            channel_number++;
+        }
+    }
+}
+
+void TileCompositeTask::execute()
+{
+  composite_tile(_Data,*_tile,*_names);
+}
+
+}
+
+void
+CompositeDeepTiled::Data::readTileRow (int dx1, int dx2, int dy, int lx, int ly,
+                                       vector<const char *> & names)
+{
+   size_t parts = _file.size() + _part.size(); // total of files+parts
+
+   //
+   // one frame buffer per source covers all the tiles
+   //
+
+   Box2i box = dataWindowForTile(dx1,dy,lx,ly);
+   box.extendBy(dataWindowForTile(dx2,dy,lx,ly));
+
+   vector<DeepFrameBuffer> framebuffers(parts);
+   vector< vector<unsigned int> > counts(parts);
+   vector<vector< vector<float *> > > pointers(parts);
+
+   for(size_t i=0;i<parts;i++)
+   {
+     handleDeepFrameBuffer(framebuffers[i],counts[i],pointers[i],box);
+   }
+
+   {
+       size_t i=0;
+       for(i=0;i<_file.size();i++)
+       {
+            _file[i]->setFrameBuffer(framebuffers[i]);
+            _file[i]->readPixelSampleCounts(dx1,dx2,dy,dy,lx,ly);
+       }
+       for(size_t j=0;j<_part.size();j++)
+       {
+           _part[j]->setFrameBuffer(framebuffers[i+j]);
+           _part[j]->readPixelSampleCounts(dx1,dx2,dy,dy,lx,ly);
+       }
+   }
+
+   //
+   // accumulate pixel counts for each tile, allocate the tile's
+   // sample arrays, and point the frame buffers into them
+   //
+
+   size_t box_width = box.size().x+1;
+   vector<TileBuffer> tiles(dx2-dx1+1);
+
+   for(int dx=dx1;dx<=dx2;dx++)
+   {
+       TileBuffer & tile = tiles[dx-dx1];
+       tile.box = dataWindowForTile(dx,dy,lx,ly);
+
+       size_t width = tile.box.size().x+1;
+       size_t height = tile.box.size().y+1;
+       tile.total_sizes.resize(width*height);
+       tile.num_sources.resize(width*height);
+       tile.line_offsets.resize(height);
+
+       size_t overall_sample_count=0;
+
+       for(size_t row=0;row<height;row++)
+       {
+           tile.line_offsets[row]=overall_sample_count;
+
+           for(size_t x=0;x<width;x++)
+           {
+               size_t ptr = row*width+x;
+               size_t box_ptr = (tile.box.min.y+row-box.min.y)*box_width+(tile.box.min.x+x-box.min.x);
+
+               tile.total_sizes[ptr]=0;
+               tile.num_sources[ptr]=0;
+               for(size_t j=0;j<parts;j++)
+               {
+                  tile.total_sizes[ptr]+=counts[j][box_ptr];
+                  if(counts[j][box_ptr]>0) tile.num_sources[ptr]++;
+               }
+               overall_sample_count+=tile.total_sizes[ptr];
+           }
+       }
+
+       tile.samples.resize(_channels.size());
+
+       for(size_t channel=0;channel<_channels.size();channel++)
+       {
+           if( channel!=1 || _zback)
+           {
+              tile.samples[channel].resize(overall_sample_count);
+
+              size_t offset=0;
+
+              for(size_t row=0;row<height;row++)
+              {
+                  for(size_t x=0;x<width;x++)
+                  {
+                      size_t box_ptr = (tile.box.min.y+row-box.min.y)*box_width+(tile.box.min.x+x-box.min.x);
+
+                      for(size_t part=0;part<parts;part++)
+                      {
+                          pointers[part][channel][box_ptr]=tile.samples[channel].data()+offset;
+                          offset+=counts[part][box_ptr];
+                      }
+                  }
+              }
+           }
+       }
+   }
+
+   //
+   // read data; each source decodes its tiles concurrently
+   //
+
+   for(size_t i=0;i<_file.size();i++)
+   {
+       _file[i]->readTiles(dx1,dx2,dy,dy,lx,ly);
+   }
+   for(size_t j=0;j<_part.size();j++)
+   {
+       _part[j]->readTiles(dx1,dx2,dy,dy,lx,ly);
+   }
+
+   //
+   // composite tiles and write back to framebuffer
+   //
+
+   TaskGroup g;
+   for(size_t t=0;t<tiles.size();t++)
+   {
+       ThreadPool::addGlobalTask(new TileCompositeTask(&g,this,&tiles[t],&names));
+   }
+}
+
+void
+CompositeDeepTiled::readTile(int dx, int dy, int l)
+{
+    readTiles(dx,dx,dy,dy,l,l);
+}
+
+void
+CompositeDeepTiled::readTile(int dx, int dy, int lx, int ly)
+{
+    readTiles(dx,dx,dy,dy,lx,ly);
+}
+
+void
+CompositeDeepTiled::readTiles(int dx1, int dx2, int dy1, int dy2, int l)
+{
+    readTiles(dx1,dx2,dy1,dy2,l,l);
+}
+
+void
+CompositeDeepTiled::readTiles(int dx1, int dx2, int dy1, int dy2, int lx, int ly)
+{
+   if(sources()==0)
+   {
+       throw IEX_NAMESPACE::ArgExc("No sources provided to CompositeDeepTiled");
+   }
+
+   if (dx1 > dx2)
+       std::swap (dx1, dx2);
+
+   if (dy1 > dy2)
+       std::swap (dy1, dy2);
+
+   if(!_Data->isValidTile(dx1,dy1,lx,ly) || !_Data->isValidTile(dx2,dy2,lx,ly))
+   {
+       THROW (IEX_NAMESPACE::ArgExc,
+              "Tile (" << dx1 << ", " << dy1 << ", " << lx << "," << ly << ") - "
+              "(" << dx2 << ", " << dy2 << ", " << lx << "," << ly << ") "
+              "is not a valid range of tiles.");
+   }
+
+   if(_Data->_channels.size()==0)
+   {
+       // no frame buffer set: composite Z, ZBack and A only
+       setFrameBuffer(FrameBuffer());
+   }
+
+   // turn vector of strings into array of char *
+   // and make sure 'ZBack' channel is correct
+   vector<const char *> names(_Data->_channels.size());
+   for(size_t i=0;i<names.size();i++)
+   {
+       names[i]=_Data->_channels[i].c_str();
+   }
+
+   if(!_Data->_zback) names[1]=names[0]; // no zback channel, so make it point to z
+
+   //
+   // read at most about one tile per thread at once, so that memory use
+   // does not grow with the number of tiles requested
+   //
+
+   int batch = std::max(1,globalThreadCount());
+
+   for(int dy=dy1;dy<=dy2;dy++)
+   {
+       for(int dx=dx1;dx<=dx2;dx+=batch)
+       {
+           _Data->readTileRow(dx,std::min(dx2,dx+batch-1),dy,lx,ly,names);
+       }
+   }
+}
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
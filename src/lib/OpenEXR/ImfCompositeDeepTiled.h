@@ -0,0 +1,146 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef INCLUDED_IMF_COMPOSITEDEEPTILED_H
+#define INCLUDED_IMF_COMPOSITEDEEPTILED_H
+
+//-----------------------------------------------------------------------------
+//
+//	Class to composite deep tiles into a frame buffer
+//      Tiled counterpart of CompositeDeepScanLine: composites deep samples
+//      from one or more DeepTiledInputParts or DeepTiledInputFiles, one
+//      tile at a time.
+//
+//      Restrictions - source file(s) must contain at least Z and alpha channels
+//                   - if multiple files/parts are provided, their data windows
+//                     and tile descriptions must match
+//                   - all requested channels will be composited as premultiplied
+//                   - only half and float channels can be requested
+//
+//      The tiles are composited in parallel on the global thread pool. Only
+//      the samples of a few tiles - about one per thread - are held in
+//      memory at any time, regardless of the number of tiles read at once.
+//
+//      This object should not be considered threadsafe
+//
+//      As with CompositeDeepScanLine, you may derive from DeepCompositing,
+//      override sort() and composite_pixel(), and pass an instance to
+//      setCompositing().
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfForward.h"
+#include "ImfTileDescription.h"
+
+#include <ImathBox.h>
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+class IMF_EXPORT_TYPE CompositeDeepTiled
+{
+    public:
+        IMF_EXPORT
+        CompositeDeepTiled();
+        IMF_EXPORT
+        virtual ~CompositeDeepTiled();
+
+        /// set the source data as a part
+        ///@note all parts must remain valid until after last interaction with CompositeDeepTiled
+        IMF_EXPORT
+        void addSource(DeepTiledInputPart * part);
+
+        /// set the source data as a file
+        ///@note all files must remain valid until after last interaction with CompositeDeepTiled
+        IMF_EXPORT
+        void addSource(DeepTiledInputFile * file);
+
+
+        /////////////////////////////////////////
+        //
+        // set the frame buffer for output values
+        // the buffers specified must be large enough
+        // to handle the data window of the levels
+        // that will be read, in the same pixel
+        // coordinates as for TiledInputFile
+        //
+        /////////////////////////////////////////
+        IMF_EXPORT
+        void setFrameBuffer(const FrameBuffer & fr);
+
+
+        /////////////////////////////////////////
+        //
+        // retrieve frameBuffer
+        //
+        ////////////////////////////////////////
+        IMF_EXPORT
+        const FrameBuffer & frameBuffer() const;
+
+
+        //////////////////////////////////////////////////
+        //
+        // read tiles from the source(s), and store the
+        // composited pixels in the frame buffer provided
+        //
+        // readTile(dx, dy, lx, ly) reads the tile with tile
+        // coordinates (dx, dy) and level number (lx, ly);
+        // readTiles(dx1, dx2, dy1, dy2, lx, ly) reads all tiles
+        // from (dx1, dy1) to (dx2, dy2), and composites them
+        // concurrently. The versions with a single level
+        // number are for ONE_LEVEL and MIPMAP_LEVELS files.
+        //
+        // Attempting to read a tile that does not exist throws
+        // an IEX_NAMESPACE::ArgExc exception.
+        //
+        //////////////////////////////////////////////////
+
+        IMF_EXPORT
+        void readTile(int dx, int dy, int l = 0);
+        IMF_EXPORT
+        void readTile(int dx, int dy, int lx, int ly);
+
+        IMF_EXPORT
+        void readTiles(int dx1, int dx2, int dy1, int dy2, int l = 0);
+        IMF_EXPORT
+        void readTiles(int dx1, int dx2, int dy1, int dy2, int lx, int ly);
+
+        IMF_EXPORT
+        int sources() const; // return number of sources
+
+        /////////////////////////////////////////////////
+        //
+        // retrieve the data window and the tile
+        // description, which all sources share
+        //
+        ////////////////////////////////////////////////
+
+        IMF_EXPORT
+        const IMATH_NAMESPACE::Box2i & dataWindow() const;
+
+        IMF_EXPORT
+        const TileDescription & tileDescription() const;
+
+
+        //
+        // override default sorting/compositing operation
+        // (otherwise an instance of the base class will be used)
+        //
+
+        IMF_EXPORT
+        void setCompositing(DeepCompositing *);
+
+      struct IMF_HIDDEN Data;
+    private :
+      struct Data *_Data;
+
+    CompositeDeepTiled(const CompositeDeepTiled &) = delete;
+    CompositeDeepTiled & operator=(const CompositeDeepTiled &) = delete;
+    CompositeDeepTiled(CompositeDeepTiled &&) = delete;
+    CompositeDeepTiled & operator=(CompositeDeepTiled &&) = delete;
+};
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
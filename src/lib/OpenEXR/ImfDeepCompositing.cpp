@@ -4,9 +4,15 @@
 //
 
 #include "ImfDeepCompositing.h"
+#include "ImfDeepCompositingPixels.h"
 
 #include "ImfNamespace.h"
+#include "ImfSimd.h"
 #include <algorithm>
+#include <limits>
+#include <stdint.h>
+#include <string.h>
+#include <typeinfo>
 #include <vector>
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
@@ -79,4 +85,427 @@ DeepCompositing::sort(int order[], const float* inputs[], const char* channel_na
 }
 
 
+namespace
+{
+
+//
+// sort key for one sample: Z in the upper and ZBack in the lower 32 bits
+// of depth, each converted so that unsigned integer order is float order.
+// The sample index breaks ties, so keys are unique, and sorting them gives
+// the same order as sort_helper, as long as no depth is a NaN. -0.0 is
+// converted like 0.0, because the two compare equal.
+//
+
+struct sample_key
+{
+    uint64_t depth;
+    int      index;
+
+    bool operator< (const sample_key & other) const
+    {
+        return depth < other.depth ||
+               (depth == other.depth && index < other.index);
+    }
+};
+
+inline uint32_t
+depth_key (float f)
+{
+    uint32_t u;
+    memcpy (&u, &f, sizeof (u));
+
+    if (u == 0x80000000) u = 0;
+
+    return (u & 0x80000000) ? ~u : (u | 0x80000000);
+}
+
+//
+// up to this many samples per pixel, rank_sort() finds the depth order;
+// for more samples, std::sort sorts precomputed keys
+//
+
+const int RANK_SORT_MAX = 64;
+
+//
+// rank_sort() places each sample at its rank, the number of samples that
+// sort_helper puts in front of it. The comparisons are done without
+// branches, for four samples at a time. z[] and zback[] must be padded
+// to a multiple of four with NaNs, which compare false with everything;
+// they must not contain any other NaNs, or the ranks may collide.
+//
+
+void
+rank_sort (int order[], const float z[], const float zback[], int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+#if defined(IMF_HAVE_SSE2)
+        __m128  zi    = _mm_set1_ps (z[i]);
+        __m128  zbi   = _mm_set1_ps (zback[i]);
+        __m128i ii    = _mm_set1_epi32 (i);
+        __m128i jj    = _mm_setr_epi32 (0, 1, 2, 3);
+        __m128i count = _mm_setzero_si128 ();
+
+        for (int j = 0; j < n; j += 4)
+        {
+            __m128 zj  = _mm_loadu_ps (z + j);
+            __m128 zbj = _mm_loadu_ps (zback + j);
+
+            __m128 tie = _mm_and_ps (_mm_cmpeq_ps (zbj, zbi),
+                                     _mm_castsi128_ps (_mm_cmplt_epi32 (jj, ii)));
+            __m128 back = _mm_or_ps (_mm_cmplt_ps (zbj, zbi), tie);
+            __m128 before = _mm_or_ps (_mm_cmplt_ps (zj, zi),
+                                       _mm_and_ps (_mm_cmpeq_ps (zj, zi), back));
+
+            count = _mm_sub_epi32 (count, _mm_castps_si128 (before));
+            jj    = _mm_add_epi32 (jj, _mm_set1_epi32 (4));
+        }
+
+        count = _mm_add_epi32 (count, _mm_shuffle_epi32 (count, _MM_SHUFFLE (1, 0, 3, 2)));
+        count = _mm_add_epi32 (count, _mm_shuffle_epi32 (count, _MM_SHUFFLE (2, 3, 0, 1)));
+        int rank = _mm_cvtsi128_si32 (count);
+#elif defined(IMF_HAVE_NEON)
+        float32x4_t zi    = vdupq_n_f32 (z[i]);
+        float32x4_t zbi   = vdupq_n_f32 (zback[i]);
+        int32x4_t   ii    = vdupq_n_s32 (i);
+        const int   first_j[4] = {0, 1, 2, 3};
+        int32x4_t   jj    = vld1q_s32 (first_j);
+        uint32x4_t  count = vdupq_n_u32 (0);
+
+        for (int j = 0; j < n; j += 4)
+        {
+            float32x4_t zj  = vld1q_f32 (z + j);
+            float32x4_t zbj = vld1q_f32 (zback + j);
+
+            uint32x4_t tie = vandq_u32 (vceqq_f32 (zbj, zbi), vcltq_s32 (jj, ii));
+            uint32x4_t back = vorrq_u32 (vcltq_f32 (zbj, zbi), tie);
+            uint32x4_t before = vorrq_u32 (vcltq_f32 (zj, zi),
+                                           vandq_u32 (vceqq_f32 (zj, zi), back));
+
+            count = vsubq_u32 (count, before);
+            jj    = vaddq_s32 (jj, vdupq_n_s32 (4));
+        }
+
+        int rank = vgetq_lane_u32 (count, 0) + vgetq_lane_u32 (count, 1) +
+                   vgetq_lane_u32 (count, 2) + vgetq_lane_u32 (count, 3);
+#else
+        int rank = 0;
+
+        for (int j = 0; j < n; j++)
+        {
+            rank += (z[j] < z[i]) |
+                    ((z[j] == z[i]) & ((zback[j] < zback[i]) |
+                                       ((zback[j] == zback[i]) & (j < i))));
+        }
+#endif
+        order[rank] = i;
+    }
+}
+
+//
+// scratch memory for composite_run(), reused from pixel to pixel
+//
+
+struct scratch
+{
+    int                capacity;  // samples per pixel that fit
+    vector<int>        identity;  // 0, 1, 2, ...
+    vector<int>        orders;    // one depth order per lane
+    vector<float>      z;         // padded copies of Z and ZBack
+    vector<float>      zback;
+    vector<sample_key> keys;
+
+    scratch () : capacity (0) {}
+
+    void reserve (int n)
+    {
+        if (n <= capacity) return;
+
+        capacity = n;
+        identity.resize (n);
+        orders.resize (4 * static_cast<size_t> (n));
+        z.resize (n + 3);
+        zback.resize (n + 3);
+        keys.resize (n);
+
+        for (int i = 0; i < n; i++)
+            identity[i] = i;
+    }
+};
+
+//
+// find the depth order of the n samples of a pixel, like DeepCompositing::sort()
+//
+
+void
+find_order (int order[], const float z[], const float zback[], int n, scratch & s)
+{
+    bool has_nan = false;
+
+    for (int i = 0; i < n; i++)
+    {
+        s.z[i]     = z[i];
+        s.zback[i] = zback[i];
+        has_nan |= (z[i] != z[i]) | (zback[i] != zback[i]);
+    }
+
+    if (has_nan)
+    {
+        //
+        // sort_helper is not a strict weak ordering for NaNs;
+        // sort exactly as DeepCompositing::sort() does
+        //
+
+        const float * inputs[2] = {z, zback};
+
+        for (int i = 0; i < n; i++)
+            order[i] = i;
+
+        std::sort (order, order + n, sort_helper (inputs));
+    }
+    else if (n <= RANK_SORT_MAX)
+    {
+        for (int i = n; i < ((n + 3) & ~3); i++)
+        {
+            s.z[i]     = std::numeric_limits<float>::quiet_NaN ();
+            s.zback[i] = std::numeric_limits<float>::quiet_NaN ();
+        }
+
+        rank_sort (order, &s.z[0], &s.zback[0], n);
+    }
+    else
+    {
+        for (int i = 0; i < n; i++)
+        {
+            s.keys[i].depth = (uint64_t (depth_key (z[i])) << 32) |
+                              depth_key (zback[i]);
+            s.keys[i].index = i;
+        }
+
+        std::sort (&s.keys[0], &s.keys[0] + n);
+
+        for (int i = 0; i < n; i++)
+            order[i] = s.keys[i].index;
+    }
+}
+
+//
+// composite four pixels at once, one per lane: acc[4*c + lane] is
+// channel c of pixel lane. Compositing a sample depends on the alpha
+// accumulated in front of it; with four independent pixels, the SIMD
+// units stay busy while each of them waits for that. The multiply and
+// the add are rounded separately, as in composite_pixel(), so that the
+// results are the same. Lanes that are out of samples, or opaque, are
+// left unchanged, even if their next sample is infinite or a NaN.
+//
+
+void
+composite_lanes (float acc[],
+                 const float * inputs[],
+                 int num_channels,
+                 const int n[4],
+                 const size_t first[4],
+                 const int * order[4])
+{
+    for (int i = 0; i < 4 * num_channels; i++)
+        acc[i] = 0.0f;
+
+    int max_n = std::max (std::max (n[0], n[1]), std::max (n[2], n[3]));
+
+#if defined(IMF_HAVE_SSE2)
+    const __m128  one = _mm_set1_ps (1.0f);
+    const __m128i nn  = _mm_setr_epi32 (n[0], n[1], n[2], n[3]);
+#elif defined(IMF_HAVE_NEON)
+    const float32x4_t one = vdupq_n_f32 (1.0f);
+    const int32x4_t   nn  = vld1q_s32 (n);
+#endif
+
+    for (int i = 0; i < max_n; i++)
+    {
+        //
+        // index of each lane's next sample; a lane that is out of
+        // samples reads its last one, which is then ignored
+        //
+
+        size_t s[4];
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+            s[lane] = first[lane] +
+                      (n[lane] == 0 ? 0 : order[lane][std::min (i, n[lane] - 1)]);
+        }
+
+#if defined(IMF_HAVE_SSE2)
+        __m128 alpha = _mm_loadu_ps (acc + 8);
+        __m128 on    = _mm_andnot_ps (_mm_cmpge_ps (alpha, one),
+                                      _mm_castsi128_ps (_mm_cmplt_epi32 (_mm_set1_epi32 (i), nn)));
+
+        //
+        // all four pixels are out of samples, or opaque
+        //
+
+        if (_mm_movemask_ps (on) == 0) break;
+
+        __m128 w = _mm_sub_ps (one, alpha);
+
+        for (int c = 0; c < num_channels; c++)
+        {
+            const float * in = inputs[c];
+            __m128 x = _mm_setr_ps (in[s[0]], in[s[1]], in[s[2]], in[s[3]]);
+            __m128 a = _mm_loadu_ps (acc + 4 * c);
+            __m128 r = _mm_add_ps (a, _mm_mul_ps (w, x));
+            _mm_storeu_ps (acc + 4 * c, _mm_or_ps (_mm_and_ps (on, r), _mm_andnot_ps (on, a)));
+        }
+#elif defined(IMF_HAVE_NEON)
+        float32x4_t alpha = vld1q_f32 (acc + 8);
+        uint32x4_t  on    = vbicq_u32 (vcltq_s32 (vdupq_n_s32 (i), nn),
+                                       vcgeq_f32 (alpha, one));
+
+        if ((vgetq_lane_u32 (on, 0) | vgetq_lane_u32 (on, 1) |
+             vgetq_lane_u32 (on, 2) | vgetq_lane_u32 (on, 3)) == 0)
+            break;
+
+        float32x4_t w = vsubq_f32 (one, alpha);
+
+        for (int c = 0; c < num_channels; c++)
+        {
+            const float * in = inputs[c];
+            float32x4_t x = vdupq_n_f32 (in[s[0]]);
+            x = vsetq_lane_f32 (in[s[1]], x, 1);
+            x = vsetq_lane_f32 (in[s[2]], x, 2);
+            x = vsetq_lane_f32 (in[s[3]], x, 3);
+            float32x4_t a = vld1q_f32 (acc + 4 * c);
+            float32x4_t r = vaddq_f32 (a, vmulq_f32 (w, x));
+            vst1q_f32 (acc + 4 * c, vbslq_f32 (on, r, a));
+        }
+#else
+        bool  on[4];
+        float w[4];
+        bool  any = false;
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+            float alpha = acc[8 + lane];
+            on[lane] = i < n[lane] && !(alpha >= 1.0f);
+            w[lane]  = 1.0f - alpha;
+            any |= on[lane];
+        }
+
+        if (!any) break;
+
+        for (int c = 0; c < num_channels; c++)
+            for (int lane = 0; lane < 4; lane++)
+                if (on[lane]) acc[4 * c + lane] += w[lane] * inputs[c][s[lane]];
+#endif
+    }
+}
+
+//
+// the compositing of DeepCompositing itself, for a run of pixels
+//
+
+void
+composite_run (float* outputs[],
+               const float* inputs[],
+               int num_channels,
+               int num_pixels,
+               const unsigned int num_samples[],
+               const unsigned int sources[])
+{
+    scratch       s;
+    vector<float> acc (4 * num_channels);
+    size_t        next = 0; // index of the next pixel's first sample
+
+    for (int p = 0; p < num_pixels; p += 4)
+    {
+        int          lanes = std::min (4, num_pixels - p);
+        int          n[4];
+        size_t       first[4];
+        const int *  order[4];
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+            n[lane]     = lane < lanes ? num_samples[p + lane] : 0;
+            first[lane] = next;
+            next += n[lane];
+        }
+
+        s.reserve (std::max (std::max (n[0], n[1]), std::max (n[2], n[3])));
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+            if (lane < lanes && sources[p + lane] > 1 && n[lane] > 1)
+            {
+                int * o = &s.orders[lane * static_cast<size_t> (s.capacity)];
+
+                find_order (o,
+                            inputs[0] + first[lane],
+                            inputs[1] + first[lane],
+                            n[lane],
+                            s);
+                order[lane] = o;
+            }
+            else
+            {
+                order[lane] = s.identity.empty () ? 0 : &s.identity[0];
+            }
+        }
+
+        composite_lanes (&acc[0], inputs, num_channels, n, first, order);
+
+        for (int lane = 0; lane < lanes; lane++)
+            for (int c = 0; c < num_channels; c++)
+                outputs[c][p + lane] = acc[4 * c + lane];
+    }
+}
+
+} // namespace
+
+
+void
+compositeDeepPixels (DeepCompositing * comp,
+                     float* outputs[],
+                     const float* inputs[],
+                     const char* channel_names[],
+                     int num_channels,
+                     int num_pixels,
+                     const unsigned int num_samples[],
+                     const unsigned int sources[])
+{
+    if (comp == 0 || typeid (*comp) == typeid (DeepCompositing))
+    {
+        composite_run (outputs, inputs, num_channels,
+                       num_pixels, num_samples, sources);
+        return;
+    }
+
+    //
+    // a derived class may have overridden composite_pixel() or sort():
+    // composite each pixel separately
+    //
+
+    vector<float>        output_pixel (num_channels);
+    vector<const float*> pixel_inputs (num_channels);
+    size_t               first = 0;
+
+    for (int p = 0; p < num_pixels; p++)
+    {
+        for (int c = 0; c < num_channels; c++)
+            pixel_inputs[c] = inputs[c] + first;
+
+        comp->composite_pixel (&output_pixel[0],
+                               &pixel_inputs[0],
+                               channel_names,
+                               num_channels,
+                               num_samples[p],
+                               sources[p]);
+
+        for (int c = 0; c < num_channels; c++)
+            outputs[c][p] = output_pixel[c];
+
+        first += num_samples[p];
+    }
+}
+
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -0,0 +1,55 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+
+#ifndef INCLUDED_IMF_DEEP_COMPOSITING_PIXELS_H
+#define INCLUDED_IMF_DEEP_COMPOSITING_PIXELS_H
+
+//-----------------------------------------------------------------------------
+//
+//	Batched compositing of deep samples, as done by DeepCompositing
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfForward.h"
+
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+
+//
+// Composite a run of pixels, typically one scan line, with the
+// given compositing engine, or with a default DeepCompositing if
+// comp is null.
+//
+// outputs[c][p] receives channel c of pixel p.  The channel layout
+// of inputs is the same as for DeepCompositing::composite_pixel(),
+// but the samples of each pixel directly follow those of the
+// previous pixel: pixel p has num_samples[p] samples, starting at
+// the sum of num_samples[0] to num_samples[p-1], and sources[p]
+// gives its number of sources.
+//
+// An instance of DeepCompositing itself composites the whole run
+// at once, with results identical to composite_pixel().  For an
+// instance of a derived class, comp->composite_pixel() is called
+// for each pixel, so that its overrides are honoured.
+//
+// Multiple threads may call compositeDeepPixels() at once.
+//
+
+IMF_EXPORT
+void	compositeDeepPixels (DeepCompositing * comp,
+			     float * outputs[],
+			     const float * inputs[],
+			     const char * channel_names[],
+			     int num_channels,
+			     int num_pixels,
+			     const unsigned int num_samples[],
+			     const unsigned int sources[]);
+
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
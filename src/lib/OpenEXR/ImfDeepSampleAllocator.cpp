@@ -0,0 +1,24 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+//-----------------------------------------------------------------------------
+//
+//	class DeepSampleAllocator
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfDeepSampleAllocator.h"
+#include "ImfNamespace.h"
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+
+DeepSampleAllocator::~DeepSampleAllocator ()
+{
+    // empty
+}
+
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
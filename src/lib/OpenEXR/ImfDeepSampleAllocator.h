@@ -0,0 +1,44 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef INCLUDED_IMF_DEEP_SAMPLE_ALLOCATOR_H
+#define INCLUDED_IMF_DEEP_SAMPLE_ALLOCATOR_H
+
+//-----------------------------------------------------------------------------
+//
+//	class DeepSampleAllocator
+//
+//	Interface to allocate the samples of a deep frame buffer while
+//	a deep scan line file is being read, see the single-pass
+//	DeepScanLineInputFile::readPixels(s1,s2,allocator).
+//
+//	allocate(fb,y1,y2) is called when the sample counts of scan
+//	lines y1 to y2 have been stored in the sample count slice of
+//	frame buffer fb.  It must set the sample pointers of those scan
+//	lines, in all slices of fb, before it returns.
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfForward.h"
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+
+class IMF_EXPORT_TYPE DeepSampleAllocator
+{
+  public:
+
+    IMF_EXPORT
+    virtual ~DeepSampleAllocator ();
+
+    virtual void	allocate (const DeepFrameBuffer &frameBuffer,
+                                  int scanLine1,
+                                  int scanLine2) = 0;
+};
+
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
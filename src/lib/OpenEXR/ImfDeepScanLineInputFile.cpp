@@ -21,6 +21,7 @@
 #include <ImfVersion.h>
 #include "ImfMultiPartInputFile.h"
 #include "ImfDeepFrameBuffer.h"
+#include "ImfDeepSampleAllocator.h"
 #include "ImfInputStreamMutex.h"
 #include "ImfInputPartData.h"
 
@@ -127,6 +128,11 @@ struct LineBuffer
     bool                hasException;
     string              exception;
 
+    const char *        sampleCountTable;     // set by single-pass reads only
+    uint64_t            sampleCountTableSize;
+    char *              sampleCountTableBuffer;
+    Compressor *        sampleCountTableComp;
+
     LineBuffer ();
     ~LineBuffer ();
 
@@ -148,6 +154,10 @@ LineBuffer::LineBuffer ():
     number (-1),
     hasException (false),
     exception (),
+    sampleCountTable (0),
+    sampleCountTableSize (0),
+    sampleCountTableBuffer (0),
+    sampleCountTableComp (0),
     _sem (1)
 {
     // empty
@@ -158,6 +168,11 @@ LineBuffer::~LineBuffer ()
 {
     if (compressor != 0)
         delete compressor;
+
+    if (sampleCountTableComp != 0)
+        delete sampleCountTableComp;
+
+    delete [] sampleCountTableBuffer;
 }
 
 } // namespace
@@ -391,7 +406,8 @@ readPixelData (InputStreamMutex *streamData,
                int minY,
                char *&buffer,
                uint64_t &packedDataSize,
-               uint64_t &unpackedDataSize)
+               uint64_t &unpackedDataSize,
+               LineBuffer *sampleCountDest)
 {
     //
     // Read a single line buffer from the input file.
@@ -401,6 +417,11 @@ readPixelData (InputStreamMutex *streamData,
     // then we change where buffer points to instead of writing into the
     // array (hence buffer needs to be a reference to a char *).
     //
+    // Normally the pixel sample count table has already been read by
+    // readPixelSampleCounts(), and is skipped.  If sampleCountDest is
+    // not null, the table is read too, and stored in sampleCountDest,
+    // so that the whole chunk is fetched from the file only once.
+    //
 
     int lineBufferNumber = (minY - ifd->minY) / ifd->linesInBuffer;
 
@@ -481,11 +502,47 @@ readPixelData (InputStreamMutex *streamData,
               << " file packed size   :" << packedDataSize << ".\n");
     }
 
-    //
-    // Skip the pixel sample count table because we have read this data.
-    //
+    if (sampleCountDest == 0)
+    {
+        //
+        // Skip the pixel sample count table because we have read this data.
+        //
+
+        Xdr::skip <StreamIO> (*streamData->is, static_cast<int>(sampleCountTableSize));
+    }
+    else
+    {
+        if (sampleCountTableSize > uint64_t(ifd->maxSampleCountTableSize))
+        {
+            THROW (IEX_NAMESPACE::ArgExc, "Bad sampleCountTableDataSize read "
+                   "from chunk " << lineBufferNumber << ": expected " <<
+                   ifd->maxSampleCountTableSize << " or less, got " <<
+                   sampleCountTableSize);
+        }
 
-    Xdr::skip <StreamIO> (*streamData->is, static_cast<int>(sampleCountTableSize));
+        sampleCountDest->sampleCountTableSize = sampleCountTableSize;
+
+        if (streamData->is->isMemoryMapped ())
+        {
+            sampleCountDest->sampleCountTable =
+                streamData->is->readMemoryMapped
+                    (static_cast<int>(sampleCountTableSize));
+        }
+        else
+        {
+            if (sampleCountDest->sampleCountTableBuffer == 0)
+            {
+                sampleCountDest->sampleCountTableBuffer =
+                    new char[ifd->maxSampleCountTableSize];
+            }
+
+            streamData->is->read (sampleCountDest->sampleCountTableBuffer,
+                                  static_cast<int>(sampleCountTableSize));
+
+            sampleCountDest->sampleCountTable =
+                sampleCountDest->sampleCountTableBuffer;
+        }
+    }
 
     //
     // Read the pixel data.
@@ -514,6 +571,143 @@ readPixelData (InputStreamMutex *streamData,
         ifd->nextLineBufferMinY = minY - ifd->linesInBuffer;
 }
 
+//
+// Decode the pixel sample count table of line buffer lineBlockId,
+// which holds scan lines minY to maxY.  The counts of all scan lines
+// in the line buffer are stored in data's sample count cache; the
+// counts of the scan lines from scanLineMin to scanLineMax are also
+// stored in the frame buffer's sample count slice.
+//
+
+void
+readSampleCountTable (DeepScanLineInputFile::Data *data,
+                      Compressor *compressor,
+                      int lineBlockId,
+                      const char *table,
+                      uint64_t tableSize,
+                      uint64_t unpackedDataSize,
+                      int scanLineMin,
+                      int scanLineMax)
+{
+    int minY = data->minY + lineBlockId * data->linesInBuffer;
+    int maxY = min (minY + data->linesInBuffer - 1, data->maxY);
+
+    const char* readPtr;
+
+    //
+    // If the sample count table is compressed, we'll uncompress it.
+    // The writer stores the table uncompressed if compression would
+    // not make it smaller.
+    //
+
+    uint64_t rawTableSize = uint64_t (maxY - minY + 1) *
+                            uint64_t (data->maxX - data->minX + 1) *
+                            Xdr::size <unsigned int> ();
+
+    if (tableSize < rawTableSize)
+    {
+        if(!compressor)
+        {
+            THROW(IEX_NAMESPACE::ArgExc,"Deep scanline data corrupt at chunk " << lineBlockId << " (sampleCountTableDataSize error)");
+        }
+        compressor->uncompress(table,
+                               static_cast<int>(tableSize),
+                               minY,
+                               readPtr);
+    }
+    else readPtr = table;
+
+    char* base = data->sampleCountSliceBase;
+    int xStride = data->sampleCountXStride;
+    int yStride = data->sampleCountYStride;
+
+    // total number of samples in block: used to check samplecount table doesn't
+    // reference more data than exists
+    
+    size_t cumulative_total_samples=0;
+    
+    for (int y = minY; y <= maxY; y++)
+    {
+        int yInDataWindow = y - data->minY;
+        data->lineSampleCount[yInDataWindow] = 0;
+
+        bool inFrameBuffer = (y >= scanLineMin && y <= scanLineMax);
+
+        int lastAccumulatedCount = 0;
+        for (int x = data->minX; x <= data->maxX; x++)
+        {
+            int accumulatedCount, count;
+
+            //
+            // Read the sample count for pixel (x, y).
+            //
+
+            Xdr::read <CharPtrIO> (readPtr, accumulatedCount);
+            
+            // sample count table should always contain monotonically
+            // increasing values.
+            if (accumulatedCount < lastAccumulatedCount)
+            {
+                THROW(IEX_NAMESPACE::ArgExc,"Deep scanline sampleCount data corrupt at chunk " << lineBlockId << " (negative sample count detected)");
+            }
+
+            count = accumulatedCount - lastAccumulatedCount;
+            lastAccumulatedCount = accumulatedCount;
+
+            //
+            // Store the data in both internal and external data structure.
+            //
+
+            data->sampleCount[yInDataWindow][x - data->minX] = count;
+            data->lineSampleCount[yInDataWindow] += count;
+
+            if (inFrameBuffer)
+                sampleCount(base, xStride, yStride, x, y) = count;
+        }
+        cumulative_total_samples+=data->lineSampleCount[yInDataWindow];
+        if(cumulative_total_samples*data->combinedSampleSize > unpackedDataSize)
+        {
+            THROW(IEX_NAMESPACE::ArgExc,"Deep scanline sampleCount data corrupt at chunk " << lineBlockId << ": pixel data only contains " << unpackedDataSize 
+            << " bytes of data but table references at least " << cumulative_total_samples*data->combinedSampleSize << " bytes of sample data" );            
+        }
+        data->gotSampleCount[y - data->minY] = true;
+    }
+}
+
+
+//
+// Compute bytesPerLine and offsetInLineBuffer for scan lines
+// minY to maxY, which make up one line buffer, from the cached
+// sample counts.
+//
+
+void
+lineBufferOffsets (DeepScanLineInputFile::Data *data, int minY, int maxY)
+{
+    for (int y = minY; y <= maxY; ++y)
+        data->bytesPerLine[y - data->minY] = 0;
+
+    int width = data->maxX - data->minX + 1;
+
+    ptrdiff_t base = reinterpret_cast<ptrdiff_t>(&data->sampleCount[0][0]);
+    base -= sizeof(unsigned int)*data->minX;
+    base -= sizeof(unsigned int)*static_cast<ptrdiff_t>(data->minY) * static_cast<ptrdiff_t>(width);
+
+    bytesPerDeepLineTable (data->header,
+                           minY, maxY,
+                           reinterpret_cast<char*>(base),
+                           sizeof(unsigned int) * 1,
+                           sizeof(unsigned int) * width,
+                           data->bytesPerLine);
+
+    offsetInLineBufferTable (data->bytesPerLine,
+                             minY - data->minY,
+                             maxY - data->minY,
+                             data->linesInBuffer,
+                             data->offsetInLineBuffer);
+}
+
+
 //
 // A LineBufferTask encapsulates the task uncompressing a set of
 // scanlines (line buffer) and copying them into the frame buffer.
@@ -527,7 +721,8 @@ class LineBufferTask : public Task
                     DeepScanLineInputFile::Data *ifd,
                     LineBuffer *lineBuffer,
                     int scanLineMin,
-                    int scanLineMax);
+                    int scanLineMax,
+                    DeepSampleAllocator *allocator);
 
     virtual ~LineBufferTask ();
 
@@ -539,6 +734,7 @@ class LineBufferTask : public Task
     LineBuffer *                _lineBuffer;
     int                         _scanLineMin;
     int                         _scanLineMax;
+    DeepSampleAllocator *       _allocator;
 };
 
 
@@ -547,13 +743,15 @@ LineBufferTask::LineBufferTask
      DeepScanLineInputFile::Data *ifd,
      LineBuffer *lineBuffer,
      int scanLineMin,
-     int scanLineMax)
+     int scanLineMax,
+     DeepSampleAllocator *allocator)
 :
     Task (group),
     _ifd (ifd),
     _lineBuffer (lineBuffer),
     _scanLineMin (scanLineMin),
-    _scanLineMax (scanLineMax)
+    _scanLineMax (scanLineMax),
+    _allocator (allocator)
 {
     // empty
 }
@@ -574,6 +772,48 @@ LineBufferTask::execute ()
 {
     try
     {
+        if (_allocator)
+        {
+            //
+            // Single-pass read: the line buffer also holds the pixel
+            // sample count table.  Decode the sample counts, and let
+            // the caller allocate the samples before they are read.
+            //
+
+            if (_lineBuffer->sampleCountTableComp == 0)
+            {
+                _lineBuffer->sampleCountTableComp =
+                    newCompressor (_ifd->header.compression(),
+                                   _ifd->maxSampleCountTableSize,
+                                   _ifd->header);
+            }
+
+            int lineBlockId = (_lineBuffer->minY - _ifd->minY) /
+                              _ifd->linesInBuffer;
+
+            readSampleCountTable (_ifd,
+                                  _lineBuffer->sampleCountTableComp,
+                                  lineBlockId,
+                                  _lineBuffer->sampleCountTable,
+                                  _lineBuffer->sampleCountTableSize,
+                                  _lineBuffer->unpackedDataSize,
+                                  _scanLineMin,
+                                  _scanLineMax);
+
+            lineBufferOffsets (_ifd,
+                               _lineBuffer->minY,
+                               min (_lineBuffer->maxY, _ifd->maxY));
+
+            {
+#if ILMTHREAD_THREADING_ENABLED
+                std::lock_guard<std::mutex> lock (*_ifd);
+#endif
+                _allocator->allocate (_ifd->frameBuffer,
+                                      _scanLineMin,
+                                      _scanLineMax);
+            }
+        }
+
         //
         // Uncompress the data, if necessary
         //
@@ -753,7 +993,8 @@ newLineBufferTask
      DeepScanLineInputFile::Data *ifd,
      int number,
      int scanLineMin,
-     int scanLineMax)
+     int scanLineMax,
+     DeepSampleAllocator *allocator)
 {
     //
     // Wait for a line buffer to become available, fill the line
@@ -769,7 +1010,12 @@ newLineBufferTask
     {
         lineBuffer->wait ();
 
-        if (lineBuffer->number != number)
+        //
+        // A single-pass read must always fetch the chunk, because
+        // it needs the chunk's sample count table.
+        //
+
+        if (lineBuffer->number != number || allocator)
         {
             lineBuffer->minY = ifd->minY + number * ifd->linesInBuffer;
             lineBuffer->maxY = lineBuffer->minY + ifd->linesInBuffer - 1;
@@ -780,7 +1026,8 @@ newLineBufferTask
             readPixelData (ifd->_streamData, ifd, lineBuffer->minY,
                            lineBuffer->buffer,
                            lineBuffer->packedDataSize,
-                           lineBuffer->unpackedDataSize);
+                           lineBuffer->unpackedDataSize,
+                           allocator? lineBuffer: 0);
         }
     }
     catch (std::exception &e)
@@ -813,7 +1060,109 @@ newLineBufferTask
     scanLineMax = min (lineBuffer->maxY, scanLineMax);
 
     return new LineBufferTask (group, ifd, lineBuffer,
-                               scanLineMin, scanLineMax);
+                               scanLineMin, scanLineMax, allocator);
+}
+
+
+//
+// Read, uncompress and store scan lines scanLineMin to scanLineMax
+// in the frame buffer, one LineBufferTask per line buffer.  If
+// allocator is not null, the tasks also read the sample counts,
+// and call the allocator before they store the samples.
+//
+
+void
+readLineBuffers (DeepScanLineInputFile::Data *data,
+                 int scanLineMin,
+                 int scanLineMax,
+                 DeepSampleAllocator *allocator)
+{
+    //
+    // We impose a numbering scheme on the lineBuffers where the first
+    // scanline is contained in lineBuffer 1.
+    //
+    // Determine the first and last lineBuffer numbers in this scanline
+    // range. We always attempt to read the scanlines in the order that
+    // they are stored in the file.
+    //
+
+    int start, stop, dl;
+
+    if (data->lineOrder == INCREASING_Y)
+    {
+        start = (scanLineMin - data->minY) / data->linesInBuffer;
+        stop  = (scanLineMax - data->minY) / data->linesInBuffer + 1;
+        dl = 1;
+    }
+    else
+    {
+        start = (scanLineMax - data->minY) / data->linesInBuffer;
+        stop  = (scanLineMin - data->minY) / data->linesInBuffer - 1;
+        dl = -1;
+    }
+
+    //
+    // Create a task group for all line buffer tasks.  When the
+    // task group goes out of scope, the destructor waits until
+    // all tasks are complete.
+    //
+
+    {
+        TaskGroup taskGroup;
+
+        //
+        // Add the line buffer tasks.
+        //
+        // The tasks will execute in the order that they are created
+        // because we lock the line buffers during construction and the
+        // constructors are called by the main thread.  Hence, in order
+        // for a successive task to execute the previous task which
+        // used that line buffer must have completed already.
+        //
+
+        for (int l = start; l != stop; l += dl)
+        {
+            ThreadPool::addGlobalTask (newLineBufferTask (&taskGroup,
+                                                          data, l,
+                                                          scanLineMin,
+                                                          scanLineMax,
+                                                          allocator));
+        }
+
+        //
+        // finish all tasks
+        //
+    }
+
+    //
+    // Exeption handling:
+    //
+    // LineBufferTask::execute() may have encountered exceptions, but
+    // those exceptions occurred in another thread, not in the thread
+    // that is executing this call to DeepScanLineInputFile::readPixels().
+    // LineBufferTask::execute() has caught all exceptions and stored
+    // the exceptions' what() strings in the line buffers.
+    // Now we check if any line buffer contains a stored exception; if
+    // this is the case then we re-throw the exception in this thread.
+    // (It is possible that multiple line buffers contain stored
+    // exceptions.  We re-throw the first exception we find and
+    // ignore all others.)
+    //
+
+    const string *exception = 0;
+
+    for (size_t i = 0; i < data->lineBuffers.size(); ++i)
+    {
+        LineBuffer *lineBuffer = data->lineBuffers[i];
+
+        if (lineBuffer->hasException && !exception)
+            exception = &lineBuffer->exception;
+
+        lineBuffer->hasException = false;
+    }
+
+    if (exception)
+        throw IEX_NAMESPACE::IoExc (*exception);
 }
 
 } // namespace
@@ -890,6 +1239,7 @@ void DeepScanLineInputFile::initialize(const Header& header)
                                                     _data->header);
 
         _data->bytesPerLine.resize (_data->maxY - _data->minY + 1);
+        _data->offsetInLineBuffer.resize (_data->maxY - _data->minY + 1);
         
         const ChannelList & c=header.channels();
         
@@ -1396,92 +1746,7 @@ DeepScanLineInputFile::readPixels (int scanLine1, int scanLine2)
                                    "read the sample counts first.");
         }
 
- 
-        //
-        // We impose a numbering scheme on the lineBuffers where the first
-        // scanline is contained in lineBuffer 1.
-        //
-        // Determine the first and last lineBuffer numbers in this scanline
-        // range. We always attempt to read the scanlines in the order that
-        // they are stored in the file.
-        //
-
-        int start, stop, dl;
-
-        if (_data->lineOrder == INCREASING_Y)
-        {
-            start = (scanLineMin - _data->minY) / _data->linesInBuffer;
-            stop  = (scanLineMax - _data->minY) / _data->linesInBuffer + 1;
-            dl = 1;
-        }
-        else
-        {
-            start = (scanLineMax - _data->minY) / _data->linesInBuffer;
-            stop  = (scanLineMin - _data->minY) / _data->linesInBuffer - 1;
-            dl = -1;
-        }
-
-        //
-        // Create a task group for all line buffer tasks.  When the
-        // task group goes out of scope, the destructor waits until
-        // all tasks are complete.
-        //
-
-        {
-            TaskGroup taskGroup;
-
-            //
-            // Add the line buffer tasks.
-            //
-            // The tasks will execute in the order that they are created
-            // because we lock the line buffers during construction and the
-            // constructors are called by the main thread.  Hence, in order
-            // for a successive task to execute the previous task which
-            // used that line buffer must have completed already.
-            //
-
-            for (int l = start; l != stop; l += dl)
-            {
-                ThreadPool::addGlobalTask (newLineBufferTask (&taskGroup,
-                                                              _data, l,
-                                                              scanLineMin,
-                                                              scanLineMax));
-            }
-
-            //
-            // finish all tasks
-            //
-        }
-
-        //
-        // Exeption handling:
-        //
-        // LineBufferTask::execute() may have encountered exceptions, but
-        // those exceptions occurred in another thread, not in the thread
-        // that is executing this call to ScanLineInputFile::readPixels().
-        // LineBufferTask::execute() has caught all exceptions and stored
-        // the exceptions' what() strings in the line buffers.
-        // Now we check if any line buffer contains a stored exception; if
-        // this is the case then we re-throw the exception in this thread.
-        // (It is possible that multiple line buffers contain stored
-        // exceptions.  We re-throw the first exception we find and
-        // ignore all others.)
-        //
-
-        const string *exception = 0;
-
-        for (size_t i = 0; i < _data->lineBuffers.size(); ++i)
-        {
-            LineBuffer *lineBuffer = _data->lineBuffers[i];
-
-            if (lineBuffer->hasException && !exception)
-                exception = &lineBuffer->exception;
-
-            lineBuffer->hasException = false;
-        }
-
-        if (exception)
-            throw IEX_NAMESPACE::IoExc (*exception);
+        readLineBuffers (_data, scanLineMin, scanLineMax, 0);
     }
     catch (IEX_NAMESPACE::BaseExc &e)
     {
@@ -1499,6 +1764,39 @@ DeepScanLineInputFile::readPixels (int scanLine)
 }
 
 
+void
+DeepScanLineInputFile::readPixels (int scanLine1,
+                                   int scanLine2,
+                                   DeepSampleAllocator &allocator)
+{
+    if(!_data->frameBufferValid)
+    {
+        throw IEX_NAMESPACE::ArgExc("readPixels called with no valid frame buffer");
+    }
+
+    try
+    {
+#if ILMTHREAD_THREADING_ENABLED
+        std::lock_guard<std::mutex> lock (*_data->_streamData);
+#endif
+        int scanLineMin = min (scanLine1, scanLine2);
+        int scanLineMax = max (scanLine1, scanLine2);
+
+        if (scanLineMin < _data->minY || scanLineMax > _data->maxY)
+            throw IEX_NAMESPACE::ArgExc ("Tried to read scan line outside "
+                               "the image file's data window.");
+
+        readLineBuffers (_data, scanLineMin, scanLineMax, &allocator);
+    }
+    catch (IEX_NAMESPACE::BaseExc &e)
+    {
+        REPLACE_EXC (e, "Error reading pixel data from image "
+                     "file \"" << fileName() << "\". " << e.what());
+        throw;
+    }
+}
+
+
 namespace
 {
 struct I64Bytes
@@ -1970,78 +2268,14 @@ readSampleCountForLineBlock(InputStreamMutex* streamData,
               << " file table size    :" << sampleCountTableDataSize << ".\n");
     }
     streamData->is->read(data->sampleCountTableBuffer, static_cast<int>(sampleCountTableDataSize));
-    
-    const char* readPtr;
-
-    //
-    // If the sample count table is compressed, we'll uncompress it.
-    //
 
-
-    if (sampleCountTableDataSize < static_cast<uint64_t>(data->maxSampleCountTableSize))
-    {
-        if(!data->sampleCountTableComp)
-        {
-            THROW(IEX_NAMESPACE::ArgExc,"Deep scanline data corrupt at chunk " << lineBlockId << " (sampleCountTableDataSize error)");
-        }
-        data->sampleCountTableComp->uncompress(data->sampleCountTableBuffer,
-                                               static_cast<int>(sampleCountTableDataSize),
-                                               minY,
-                                               readPtr);
-    }
-    else readPtr = data->sampleCountTableBuffer;
-
-    char* base = data->sampleCountSliceBase;
-    int xStride = data->sampleCountXStride;
-    int yStride = data->sampleCountYStride;
-
-    // total number of samples in block: used to check samplecount table doesn't
-    // reference more data than exists
-    
-    size_t cumulative_total_samples=0;
-    
-    for (int y = minY; y <= maxY; y++)
-    {
-        int yInDataWindow = y - data->minY;
-        data->lineSampleCount[yInDataWindow] = 0;
-
-        int lastAccumulatedCount = 0;
-        for (int x = data->minX; x <= data->maxX; x++)
-        {
-            int accumulatedCount, count;
-
-            //
-            // Read the sample count for pixel (x, y).
-            //
-
-            Xdr::read <CharPtrIO> (readPtr, accumulatedCount);
-            
-            // sample count table should always contain monotonically
-            // increasing values.
-            if (accumulatedCount < lastAccumulatedCount)
-            {
-                THROW(IEX_NAMESPACE::ArgExc,"Deep scanline sampleCount data corrupt at chunk " << lineBlockId << " (negative sample count detected)");
-            }
-
-            count = accumulatedCount - lastAccumulatedCount;
-            lastAccumulatedCount = accumulatedCount;
-
-            //
-            // Store the data in both internal and external data structure.
-            //
-
-            data->sampleCount[yInDataWindow][x - data->minX] = count;
-            data->lineSampleCount[yInDataWindow] += count;
-            sampleCount(base, xStride, yStride, x, y) = count;
-        }
-        cumulative_total_samples+=data->lineSampleCount[yInDataWindow];
-        if(cumulative_total_samples*data->combinedSampleSize > unpackedDataSize)
-        {
-            THROW(IEX_NAMESPACE::ArgExc,"Deep scanline sampleCount data corrupt at chunk " << lineBlockId << ": pixel data only contains " << unpackedDataSize 
-            << " bytes of data but table references at least " << cumulative_total_samples*data->combinedSampleSize << " bytes of sample data" );            
-        }
-        data->gotSampleCount[y - data->minY] = true;
-    }
+    readSampleCountTable (data,
+                          data->sampleCountTableComp,
+                          lineBlockId,
+                          data->sampleCountTableBuffer,
+                          sampleCountTableDataSize,
+                          unpackedDataSize,
+                          minY, maxY);
 }
 
 
@@ -2106,26 +2340,11 @@ DeepScanLineInputFile::readPixelSampleCounts (int scanline1, int scanline2)
                 int maxYInLineBuffer = min ( minYInLineBuffer + _data->linesInBuffer - 1, _data->maxY );
 
                 //
-                // For each line within the block, get the count of bytes.
-                //
-
-                bytesPerDeepLineTable ( _data->header,
-                                        minYInLineBuffer,
-                                        maxYInLineBuffer,
-                                        _data->sampleCountSliceBase,
-                                        _data->sampleCountXStride,
-                                        _data->sampleCountYStride,
-                                        _data->bytesPerLine );
-
-                //
-                // For each scanline within the block, get the offset.
+                // For each line within the block, get the count of bytes
+                // and the offset.
                 //
 
-                offsetInLineBufferTable ( _data->bytesPerLine,
-                                          minYInLineBuffer - _data->minY,
-                                          maxYInLineBuffer - _data->minY,
-                                          _data->linesInBuffer,
-                                          _data->offsetInLineBuffer );
+                lineBufferOffsets ( _data, minYInLineBuffer, maxYInLineBuffer );
             }
         }
 
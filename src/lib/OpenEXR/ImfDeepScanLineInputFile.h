@@ -144,6 +144,40 @@ class IMF_EXPORT_TYPE DeepScanLineInputFile : public GenericInputFile
     IMF_EXPORT
     void                readPixels (int scanLine);
 
+
+    //---------------------------------------------------------------
+    // Read sample counts and pixel data in a single pass:
+    //
+    // readPixels(s1,s2,allocator) reads the pixel sample counts and
+    // the pixel data of all scan lines with y coordinates in the
+    // interval [min (s1, s2), max (s1, s2)], and stores them in the
+    // current frame buffer.  It has the same effect as
+    //
+    //     readPixelSampleCounts (s1, s2);
+    //     (allocate the samples)
+    //     readPixels (s1, s2);
+    //
+    // but each chunk of the file is read only once, and the sample
+    // counts are decoded together with the pixel data, in one task
+    // per chunk.
+    //
+    // Once the sample counts of a chunk have been stored in the
+    // frame buffer's sample count slice, allocator.allocate(fb,y1,y2)
+    // is called, where fb is the current frame buffer and [y1, y2]
+    // are the scan lines of the chunk that are being read (see
+    // ImfDeepSampleAllocator.h).
+    //
+    // If threading is enabled, allocate() may be called by different
+    // threads, and not in scan line order, but never by two threads
+    // at the same time.  allocate() must not call other methods of
+    // this file.
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    void                readPixels (int scanLine1,
+                                    int scanLine2,
+                                    DeepSampleAllocator &allocator);
+
     
   
     //---------------------------------------------------------------
@@ -73,6 +73,14 @@ DeepScanLineInputPart::readPixels (int scanLine)
 }
 
 
+void
+DeepScanLineInputPart::readPixels (int scanLine1, int scanLine2,
+                                   DeepSampleAllocator &allocator)
+{
+    file->readPixels(scanLine1, scanLine2, allocator);
+}
+
+
 void
 DeepScanLineInputPart::rawPixelData (int firstScanLine,
                                      char *pixelData,
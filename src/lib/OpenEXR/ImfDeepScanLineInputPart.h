@@ -109,6 +109,15 @@ class IMF_EXPORT_TYPE DeepScanLineInputPart
     void                readPixels (const char * rawPixelData,const DeepFrameBuffer & frameBuffer,
                                     int scanLine1,int scanLine2) const;
 
+    //---------------------------------------------------------------
+    // Read sample counts and pixel data in a single pass -- see
+    // DeepScanLineInputFile::readPixels(s1,s2,allocator).
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    void                readPixels (int scanLine1, int scanLine2,
+                                    DeepSampleAllocator &allocator);
+
     //----------------------------------------------
     // Read a block of raw pixel data from the file,
     // without uncompressing it (this function is
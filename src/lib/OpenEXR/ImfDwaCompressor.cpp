@@ -145,7 +145,11 @@
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
 
-#include "dwaLookups.h"
+//
+// The lookup tables are shared with the DWA compressor in OpenEXRCore.
+//
+
+#include "../OpenEXRCore/dwaLookups.h"
 
 namespace {
 
@@ -177,6 +181,292 @@ namespace {
     void (*dctInverse8x8_5)(float*) = dctInverse8x8_scalar<5>;
     void (*dctInverse8x8_6)(float*) = dctInverse8x8_scalar<6>;
     void (*dctInverse8x8_7)(float*) = dctInverse8x8_scalar<7>;
+
+    //
+    // Dispatch the forward DCT, defaulting to the best compile
+    // time choice and upgraded by DwaCompressor::initializeFuncs()
+    //
+
+#if defined(IMF_HAVE_SSE2)
+    void (*dctForward8x8)(float*) = dctForward8x8_sse2;
+#elif defined(IMF_HAVE_NEON)
+    void (*dctForward8x8)(float*) = dctForward8x8_neon;
+#else
+    void (*dctForward8x8)(float*) = dctForward8x8_scalar;
+#endif
+
+    //
+    // Precomputing the bit count runs faster than using
+    // the builtin instruction, at least in one case..
+    //
+    // Precomputing 8-bits is no slower than 16-bits,
+    // and saves a fair bit of overhead..
+    //
+
+    inline int
+    countSetBits (unsigned short src)
+    {
+        static const unsigned short numBitsSet[256] =
+        {
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
+            1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
+            2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
+            1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
+            2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
+            2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
+            3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
+            1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
+            2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
+            2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
+            3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
+            2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
+            3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
+            3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
+            4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8
+        };
+
+        return numBitsSet[src & 0xff] + numBitsSet[src >> 8];
+    }
+
+    //
+    // Take a DCT coefficient, as well as an acceptable error. Search
+    // nearby values within the error tolerance, that have fewer 
+    // bits set.
+    //
+    // The list of candidates has been pre-computed and sorted 
+    // in order of increasing numbers of bits set. This way, we
+    // can stop searching as soon as we find a candidate that
+    // is within the error tolerance.
+    //
+    // The first candidate is always 0, and most high frequency
+    // components land within the tolerance of it, so check for
+    // that before looking at the list.
+    //
+
+    unsigned short
+    quantize (unsigned short src, float errorTolerance)
+    {
+        half            tmp;
+        float           srcFloat;
+
+        tmp.setBits (src);
+        srcFloat = (float)tmp;
+
+        if (fabs (srcFloat) < errorTolerance)
+            return 0;
+
+        int             numSetBits    = countSetBits(src);
+        const unsigned short *closest = closestData + closestDataOffset[src];
+
+        for (int targetNumSetBits = numSetBits - 1;
+             targetNumSetBits >= 0;
+             --targetNumSetBits)
+        {
+            tmp.setBits (*closest);
+
+            if (fabs ((float)tmp - srcFloat) < errorTolerance)
+                return tmp.bits();
+
+            closest++;
+        }
+
+        return src;
+    }
+
+    //
+    // Quantize a block of 64 DCT coefficients in place. The
+    // coefficients have already been converted to half, and
+    // errorTolerance holds the acceptable error for each of them.
+    //
+
+    void
+    quantizeCoeffs_scalar (unsigned short *halfCoef,
+                           const float *errorTolerance)
+    {
+        for (int i = 0; i < 64; ++i)
+            halfCoef[i] = quantize (halfCoef[i], errorTolerance[i]);
+    }
+
+    //
+    // The SIMD versions below test the candidate list 8 (or 4) at a
+    // time, using the same float math as quantize(), so the results
+    // are identical. They always load 16 candidates, the longest list
+    // there is, so fall back to quantize() for the few lists too close
+    // to the end of the table.
+    //
+
+    const unsigned int closestDataSafeEnd =
+        sizeof (closestData) / sizeof (closestData[0]) - 16;
+
+#ifdef IMF_HAVE_AVX2_TARGET
+
+    IMF_TARGET_AVX2_F16C unsigned short
+    quantizeSearch_avx2 (unsigned short src, float srcFloat,
+                         float errorTolerance)
+    {
+        const __m256 absMask  = _mm256_castsi256_ps (
+                                    _mm256_set1_epi32 (0x7fffffff));
+        const __m256 srcVec   = _mm256_set1_ps (srcFloat);
+        const __m256 errorVec = _mm256_set1_ps (errorTolerance);
+
+        int                   numSetBits = countSetBits (src);
+        const unsigned short *closest    =
+            closestData + closestDataOffset[src];
+
+        for (int i = 0; i < numSetBits; i += 8)
+        {
+            __m256 candidates = _mm256_cvtph_ps (
+                _mm_loadu_si128 ((const __m128i *)(closest + i)));
+
+            int within = _mm256_movemask_ps (
+                _mm256_cmp_ps (
+                    _mm256_and_ps (_mm256_sub_ps (candidates, srcVec),
+                                   absMask),
+                    errorVec,
+                    _CMP_LT_OQ));
+
+            if (numSetBits - i < 8)
+                within &= (1 << (numSetBits - i)) - 1;
+
+            if (within)
+                return closest[i + __builtin_ctz (within)];
+        }
+
+        return src;
+    }
+
+    IMF_TARGET_AVX2_F16C void
+    quantizeCoeffs_avx2 (unsigned short *halfCoef,
+                         const float *errorTolerance)
+    {
+        const __m256 absMask = _mm256_castsi256_ps (
+                                   _mm256_set1_epi32 (0x7fffffff));
+        float        srcFloat[8];
+
+        for (int i = 0; i < 64; i += 8)
+        {
+            __m256 srcVec = _mm256_cvtph_ps (
+                _mm_load_si128 ((const __m128i *)(halfCoef + i)));
+
+            //
+            // Everything within the tolerance of 0 goes to 0
+            //
+
+            int nonZero = ~_mm256_movemask_ps (
+                _mm256_cmp_ps (_mm256_and_ps (srcVec, absMask),
+                               _mm256_loadu_ps (errorTolerance + i),
+                               _CMP_LT_OQ)) & 0xff;
+
+            if (!nonZero)
+            {
+                _mm_store_si128 ((__m128i *)(halfCoef + i),
+                                 _mm_setzero_si128 ());
+                continue;
+            }
+
+            _mm256_storeu_ps (srcFloat, srcVec);
+
+            for (int j = 0; j < 8; ++j)
+            {
+                unsigned short src = halfCoef[i + j];
+
+                if (!(nonZero & (1 << j)))
+                    halfCoef[i + j] = 0;
+                else if (closestDataOffset[src] <= closestDataSafeEnd)
+                    halfCoef[i + j] = quantizeSearch_avx2
+                        (src, srcFloat[j], errorTolerance[i + j]);
+                else
+                    halfCoef[i + j] = quantize (src, errorTolerance[i + j]);
+            }
+        }
+    }
+
+#endif /* IMF_HAVE_AVX2_TARGET */
+
+#ifdef IMF_HAVE_NEON_AARCH64
+
+    unsigned short
+    quantizeSearch_neon (unsigned short src, float srcFloat,
+                         float errorTolerance)
+    {
+        const float32x4_t srcVec   = vdupq_n_f32 (srcFloat);
+        const float32x4_t errorVec = vdupq_n_f32 (errorTolerance);
+
+        int                   numSetBits = countSetBits (src);
+        const unsigned short *closest    =
+            closestData + closestDataOffset[src];
+        uint32_t              within[4];
+
+        for (int i = 0; i < numSetBits; i += 4)
+        {
+            float32x4_t candidates = vcvt_f32_f16 (
+                vreinterpret_f16_u16 (vld1_u16 (closest + i)));
+
+            vst1q_u32 (within,
+                       vcltq_f32 (vabsq_f32 (vsubq_f32 (candidates, srcVec)),
+                                  errorVec));
+
+            for (int j = 0; j < 4 && i + j < numSetBits; ++j)
+            {
+                if (within[j])
+                    return closest[i + j];
+            }
+        }
+
+        return src;
+    }
+
+    void
+    quantizeCoeffs_neon (unsigned short *halfCoef,
+                         const float *errorTolerance)
+    {
+        float    srcFloat[4];
+        uint32_t isZero[4];
+
+        for (int i = 0; i < 64; i += 4)
+        {
+            float32x4_t srcVec = vcvt_f32_f16 (
+                vreinterpret_f16_u16 (vld1_u16 (halfCoef + i)));
+
+            //
+            // Everything within the tolerance of 0 goes to 0
+            //
+
+            vst1q_u32 (isZero,
+                       vcltq_f32 (vabsq_f32 (srcVec),
+                                  vld1q_f32 (errorTolerance + i)));
+            vst1q_f32 (srcFloat, srcVec);
+
+            for (int j = 0; j < 4; ++j)
+            {
+                unsigned short src = halfCoef[i + j];
+
+                if (isZero[j])
+                    halfCoef[i + j] = 0;
+                else if (closestDataOffset[src] <= closestDataSafeEnd)
+                    halfCoef[i + j] = quantizeSearch_neon
+                        (src, srcFloat[j], errorTolerance[i + j]);
+                else
+                    halfCoef[i + j] = quantize (src, errorTolerance[i + j]);
+            }
+        }
+    }
+
+#endif /* IMF_HAVE_NEON_AARCH64 */
+
+    //
+    // Dispatch the quantizer, defaulting to the best compile
+    // time choice and upgraded by DwaCompressor::initializeFuncs()
+    //
+
+#ifdef IMF_HAVE_NEON_AARCH64
+    void (*quantizeCoeffs)(unsigned short*, const float*) =
+        quantizeCoeffs_neon;
+#else
+    void (*quantizeCoeffs)(unsigned short*, const float*) =
+        quantizeCoeffs_scalar;
+#endif
     
 } // namespace
 
@@ -537,9 +827,6 @@ class DwaCompressor::LossyDctEncoderBase
 
   protected:
 
-    void    toZigZag (half *dst, half *src);
-    int     countSetBits (unsigned short src);
-    half    quantize (half src, float errorTolerance);
     void    rleAc (half *block, unsigned short *&acPtr);
 
     float                      _quantBaseError;
@@ -575,6 +862,14 @@ class DwaCompressor::LossyDctEncoderBase
 
     float                      _quantTableY[64];
     float                      _quantTableCbCr[64];
+
+    //
+    // The acceptable error for each component, which is the base
+    // error scaled by the quantization tables above
+    //
+
+    float                      _toleranceY[64];
+    float                      _toleranceCbCr[64];
 };
 
 
@@ -1334,6 +1629,12 @@ DwaCompressor::LossyDctEncoderBase::LossyDctEncoderBase
     
     if (_quantBaseError < 0)
         quantBaseError = 0;
+
+    for (int idx = 0; idx < 64; ++idx)
+    {
+        _toleranceY[idx]    = _quantBaseError * _quantTableY[idx];
+        _toleranceCbCr[idx] = _quantBaseError * _quantTableCbCr[idx];
+    }
 }
 
 
@@ -1357,8 +1658,31 @@ DwaCompressor::LossyDctEncoderBase::execute ()
     int  numBlocksX   = (int)ceil ((float)_width / 8.0f);
     int  numBlocksY   = (int)ceil ((float)_height/ 8.0f);
 
-    half halfZigCoef[64]; 
-    half halfCoef[64];
+    half                  halfZigCoef[64]; 
+    SimdAlignedBuffer64us halfCoef;
+
+    //
+    // Map from zig-zag order to normal ordering
+    //
+
+    static const int zigZag[64] =
+    {
+         0, 
+         1,  8,
+        16,  9,  2,
+         3, 10, 17, 24,
+        32, 25, 18, 11, 4,
+         5, 12, 19, 26, 33, 40,
+        48, 41, 34, 27, 20, 13, 6,
+         7, 14, 21, 28, 35, 42, 49, 56,
+            57, 50, 43, 36, 29, 22, 15,
+                23, 30, 37, 44, 51, 58,
+                    59, 52, 45, 38, 31,
+                        39, 46, 53, 60,
+                            61, 54, 47,
+                                55, 62,
+                                    63
+    };
 
     std::vector<unsigned short *> currDcComp (_rowPtrs.size());
     unsigned short               *currAcComp = (unsigned short *)_packedAc;
@@ -1443,11 +1767,34 @@ DwaCompressor::LossyDctEncoderBase::execute ()
 
     for (int blocky = 0; blocky < numBlocksY; ++blocky)
     {
+        int vy[8];
+
+        for (int y = 0; y < 8; ++y)
+        {
+            vy[y] = 8 * blocky + y;
+
+            if (vy[y] >= _height)
+                vy[y] = _height - (vy[y] - (_height - 1));
+
+            if (vy[y] < 0) vy[y] = _height-1;
+        }
+
         for (int blockx = 0; blockx < numBlocksX; ++blockx)
         {
             half           h;
             unsigned short tmpShortXdr, tmpShortNative;
             char          *tmpCharPtr;
+            int            vx[8];
+
+            for (int x = 0; x < 8; ++x)
+            {
+                vx[x] = 8 * blockx + x;
+
+                if (vx[x] >= _width)
+                    vx[x] = _width - (vx[x] - (_width - 1));
+
+                if (vx[x] < 0) vx[x] = _width-1;
+            }
 
             for (unsigned int chan = 0; chan < _rowPtrs.size(); ++chan)
             {
@@ -1466,23 +1813,12 @@ DwaCompressor::LossyDctEncoderBase::execute ()
 
                 for (int y = 0; y < 8; ++y)
                 {
+                    const unsigned short *srcRow =
+                        (const unsigned short *)(_rowPtrs[chan])[vy[y]];
+
                     for (int x = 0; x < 8; ++x)
                     {
-                        int vx = 8 * blockx + x;
-                        int vy = 8 * blocky + y;
-
-                        if (vx >= _width)
-                            vx = _width - (vx - (_width - 1));
-                        
-                        if (vx < 0) vx = _width-1;
-
-                        if (vy >=_height)
-                            vy = _height - (vy - (_height - 1));
-
-                        if (vy < 0) vy = _height-1;
-                    
-                        tmpShortXdr =
-                            ((const unsigned short *)(_rowPtrs[chan])[vy])[vx];
+                        tmpShortXdr = srcRow[vx[x]];
 
                         if (_toNonlinear)
                         {
@@ -1524,38 +1860,25 @@ DwaCompressor::LossyDctEncoderBase::execute ()
                 dctForward8x8(_dctData[chan]._buffer);
 
                 //
-                // Quantize to half, and zigzag
+                // Quantize to half
                 //
 
-                if (chan == 0)
-                {
-                    for (int i = 0; i < 64; ++i)
-                    {
-                        halfCoef[i] =
-                            quantize ((half)_dctData[chan]._buffer[i],
-                                      _quantBaseError*_quantTableY[i]);
-                    }
-                }
-                else
-                {
-                    for (int i = 0; i < 64; ++i)
-                    {
-                        halfCoef[i] =
-                            quantize ((half)_dctData[chan]._buffer[i],
-                                      _quantBaseError*_quantTableCbCr[i]);
-                    }
-                }
+                (*convertFloatToHalf64) (halfCoef._buffer,
+                                         _dctData[chan]._buffer);
+
+                (*quantizeCoeffs) (halfCoef._buffer,
+                                   (chan == 0)? _toleranceY: _toleranceCbCr);
 
-                toZigZag (halfZigCoef, halfCoef);
-                
                 //
-                // Convert from NATIVE back to XDR, before we write out
+                // Zigzag, converting from NATIVE back to XDR
+                // before we write out
                 //
 
                 for (int i = 0; i < 64; ++i)
                 {
                     tmpCharPtr = (char *)&tmpShortXdr;
-                    Xdr::write<CharPtrIO>(tmpCharPtr, halfZigCoef[i].bits());
+                    Xdr::write<CharPtrIO>
+                        (tmpCharPtr, halfCoef._buffer[zigZag[i]]);
                     halfZigCoef[i].setBits(tmpShortXdr);
                 }
 
@@ -1579,107 +1902,6 @@ DwaCompressor::LossyDctEncoderBase::execute ()
 }
 
 
-// 
-// Reorder from zig-zag order to normal ordering
-//
-
-void 
-DwaCompressor::LossyDctEncoderBase::toZigZag (half *dst, half *src) 
-{
-    const int remap[] =
-    {
-         0, 
-         1,  8,
-        16,  9,  2,
-         3, 10, 17, 24,
-        32, 25, 18, 11, 4,
-         5, 12, 19, 26, 33, 40,
-        48, 41, 34, 27, 20, 13, 6,
-         7, 14, 21, 28, 35, 42, 49, 56,
-            57, 50, 43, 36, 29, 22, 15,
-                23, 30, 37, 44, 51, 58,
-                    59, 52, 45, 38, 31,
-                        39, 46, 53, 60,
-                            61, 54, 47,
-                                55, 62,
-                                    63
-    };
-
-    for (int i=0; i<64; ++i)
-        dst[i] = src[remap[i]];
-}
-
-
-//
-// Precomputing the bit count runs faster than using
-// the builtin instruction, at least in one case..
-//
-// Precomputing 8-bits is no slower than 16-bits,
-// and saves a fair bit of overhead..
-//
-
-int
-DwaCompressor::LossyDctEncoderBase::countSetBits (unsigned short src)
-{
-    static const unsigned short numBitsSet[256] =
-    {
-        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
-        1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-        1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-        2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-        1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-        2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-        2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-        3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-        1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-        2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-        2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-        3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-        2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-        3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-        3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-        4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8
-    };
-
-    return numBitsSet[src & 0xff] + numBitsSet[src >> 8];
-}
-
-
-//
-// Take a DCT coefficient, as well as an acceptable error. Search
-// nearby values within the error tolerance, that have fewer 
-// bits set.
-//
-// The list of candidates has been pre-computed and sorted 
-// in order of increasing numbers of bits set. This way, we
-// can stop searching as soon as we find a candidate that
-// is within the error tolerance.
-//
-
-half
-DwaCompressor::LossyDctEncoderBase::quantize (half src, float errorTolerance)
-{
-    half            tmp;
-    float           srcFloat      = (float)src;
-    int             numSetBits    = countSetBits(src.bits());
-    const unsigned short *closest = closestData + closestDataOffset[src.bits()];
-
-    for (int targetNumSetBits = numSetBits - 1;
-         targetNumSetBits >= 0;
-         --targetNumSetBits)
-    {
-        tmp.setBits (*closest);
-
-        if (fabs ((float)tmp - srcFloat) < errorTolerance)
-            return tmp;
-
-        closest++;
-    }
-
-    return src;
-}
-
-
 //
 // RLE the zig-zag of the AC components + copy over 
 // into another tmp buffer
@@ -1895,7 +2117,7 @@ DwaCompressor::compressTile
 int 
 DwaCompressor::compress
     (const char             *inPtr,
-     int                    inSize,
+     int                    /*inSize*/,
      IMATH_NAMESPACE::Box2i range,
      const char             *&outPtr)
 {
@@ -2883,6 +3105,11 @@ DwaCompressor::initializeFuncs()
         convertFloatToHalf64 = convertFloatToHalf64_f16c;
         fromHalfZigZag       = fromHalfZigZag_f16c;
     } 
+    else if (cpuId.neon)
+    {
+        convertFloatToHalf64 = convertFloatToHalf64_neon;
+        fromHalfZigZag       = fromHalfZigZag_neon;
+    }
 
     //
     // Setup inverse DCT implementations
@@ -2919,6 +3146,35 @@ DwaCompressor::initializeFuncs()
         dctInverse8x8_6 = dctInverse8x8_sse2<6>;
         dctInverse8x8_7 = dctInverse8x8_sse2<7>;
     }
+    else if (cpuId.neon)
+    {
+        dctInverse8x8_0 = dctInverse8x8_neon<0>;
+        dctInverse8x8_1 = dctInverse8x8_neon<1>;
+        dctInverse8x8_2 = dctInverse8x8_neon<2>;
+        dctInverse8x8_3 = dctInverse8x8_neon<3>;
+        dctInverse8x8_4 = dctInverse8x8_neon<4>;
+        dctInverse8x8_5 = dctInverse8x8_neon<5>;
+        dctInverse8x8_6 = dctInverse8x8_neon<6>;
+        dctInverse8x8_7 = dctInverse8x8_neon<7>;
+    }
+
+    //
+    // Setup forward DCT implementation
+    //
+
+#ifdef IMF_HAVE_AVX2_TARGET
+    if (cpuId.avx2)
+        dctForward8x8 = dctForward8x8_avx;
+#endif
+
+    //
+    // Setup quantization implementation
+    //
+
+#ifdef IMF_HAVE_AVX2_TARGET
+    if (cpuId.avx2 && cpuId.f16c)
+        quantizeCoeffs = quantizeCoeffs_avx2;
+#endif
 }
 
 
@@ -23,6 +23,7 @@
 
 #include <half.h>
 #include <assert.h>
+#include <math.h>
 
 #include <algorithm>
 
@@ -139,7 +140,7 @@ csc709Inverse (float &comp0, float &comp1, float &comp2)
     comp2 = src[0] + 1.8556f * src[1];
 }
 
-#ifndef IMF_HAVE_SSE2
+#if !defined(IMF_HAVE_SSE2) && !defined(IMF_HAVE_NEON)
 
 
 //
@@ -154,6 +155,40 @@ csc709Inverse64 (float *comp0, float *comp1, float *comp2)
         csc709Inverse (comp0[i], comp1[i], comp2[i]);
 }
 
+#elif defined(IMF_HAVE_NEON)
+
+//
+// NEON color space conversion, laid out as the SSE2 version
+//
+
+void
+csc709Inverse64 (float *comp0, float *comp1, float *comp2)
+{
+    const float32x4_t c0 = vdupq_n_f32 ( 1.5747f);
+    const float32x4_t c1 = vdupq_n_f32 ( 1.8556f);
+    const float32x4_t c2 = vdupq_n_f32 (-0.1873f);
+    const float32x4_t c3 = vdupq_n_f32 (-0.4682f);
+
+    for (int i = 0; i < 64; i += 4)
+    {
+        float32x4_t src0 = vld1q_f32 (comp0 + i);
+        float32x4_t src1 = vld1q_f32 (comp1 + i);
+        float32x4_t src2 = vld1q_f32 (comp2 + i);
+
+        float32x4_t r = vaddq_f32 (src0, vmulq_f32 (src2, c0));
+
+        float32x4_t g = vmulq_f32 (src1, c2);
+        g = vaddq_f32 (g, src0);
+        g = vaddq_f32 (g, vmulq_f32 (src2, c3));
+
+        float32x4_t b = vaddq_f32 (vmulq_f32 (c1, src1), src0);
+
+        vst1q_f32 (comp0 + i, r);
+        vst1q_f32 (comp1 + i, g);
+        vst1q_f32 (comp2 + i, b);
+    }
+}
+
 #else /* IMF_HAVE_SSE2 */
 
 //
@@ -214,6 +249,95 @@ csc709Inverse64 (float *comp0, float *comp1, float *comp2)
 
 //
 // Color space conversion, Forward 709 CSC, R'G'B' -> Y'CbCr
+//
+
+#if defined IMF_HAVE_SSE2
+
+//
+// SSE2 color space conversion. The products are summed in the
+// same order as the scalar version, so the results are identical.
+//
+
+void
+csc709Forward64 (float *comp0, float *comp1, float *comp2)
+{
+    __m128 c00 = _mm_set1_ps ( 0.2126f);
+    __m128 c01 = _mm_set1_ps ( 0.7152f);
+    __m128 c02 = _mm_set1_ps ( 0.0722f);
+    __m128 c10 = _mm_set1_ps (-0.1146f);
+    __m128 c11 = _mm_set1_ps ( 0.3854f);
+    __m128 c12 = _mm_set1_ps ( 0.5000f);
+    __m128 c20 = _mm_set1_ps ( 0.5000f);
+    __m128 c21 = _mm_set1_ps ( 0.4542f);
+    __m128 c22 = _mm_set1_ps ( 0.0458f);
+
+    __m128 *r = (__m128 *)comp0;
+    __m128 *g = (__m128 *)comp1;
+    __m128 *b = (__m128 *)comp2;
+    __m128 src[3];
+
+    for (int i = 0; i < 16; ++i)
+    {
+        src[0] = r[i];
+        src[1] = g[i];
+        src[2] = b[i];
+
+        r[i] = _mm_add_ps (_mm_add_ps (_mm_mul_ps (c00, src[0]),
+                                       _mm_mul_ps (c01, src[1])),
+                           _mm_mul_ps (c02, src[2]));
+        g[i] = _mm_add_ps (_mm_sub_ps (_mm_mul_ps (c10, src[0]),
+                                       _mm_mul_ps (c11, src[1])),
+                           _mm_mul_ps (c12, src[2]));
+        b[i] = _mm_sub_ps (_mm_sub_ps (_mm_mul_ps (c20, src[0]),
+                                       _mm_mul_ps (c21, src[1])),
+                           _mm_mul_ps (c22, src[2]));
+    }
+}
+
+#elif defined IMF_HAVE_NEON
+
+//
+// NEON color space conversion, laid out as the SSE2 version
+//
+
+void
+csc709Forward64 (float *comp0, float *comp1, float *comp2)
+{
+    const float32x4_t c00 = vdupq_n_f32 ( 0.2126f);
+    const float32x4_t c01 = vdupq_n_f32 ( 0.7152f);
+    const float32x4_t c02 = vdupq_n_f32 ( 0.0722f);
+    const float32x4_t c10 = vdupq_n_f32 (-0.1146f);
+    const float32x4_t c11 = vdupq_n_f32 ( 0.3854f);
+    const float32x4_t c12 = vdupq_n_f32 ( 0.5000f);
+    const float32x4_t c20 = vdupq_n_f32 ( 0.5000f);
+    const float32x4_t c21 = vdupq_n_f32 ( 0.4542f);
+    const float32x4_t c22 = vdupq_n_f32 ( 0.0458f);
+
+    float32x4_t src[3];
+
+    for (int i = 0; i < 64; i += 4)
+    {
+        src[0] = vld1q_f32 (comp0 + i);
+        src[1] = vld1q_f32 (comp1 + i);
+        src[2] = vld1q_f32 (comp2 + i);
+
+        vst1q_f32 (comp0 + i,
+                   vaddq_f32 (vaddq_f32 (vmulq_f32 (c00, src[0]),
+                                         vmulq_f32 (c01, src[1])),
+                              vmulq_f32 (c02, src[2])));
+        vst1q_f32 (comp1 + i,
+                   vaddq_f32 (vsubq_f32 (vmulq_f32 (c10, src[0]),
+                                         vmulq_f32 (c11, src[1])),
+                              vmulq_f32 (c12, src[2])));
+        vst1q_f32 (comp2 + i,
+                   vsubq_f32 (vsubq_f32 (vmulq_f32 (c20, src[0]),
+                                         vmulq_f32 (c21, src[1])),
+                              vmulq_f32 (c22, src[2])));
+    }
+}
+
+#else
+
 //
 // Simple FPU color space conversion. Based on the 709
 // primary chromaticies, with no scaling or offsets.
@@ -236,6 +360,8 @@ csc709Forward64 (float *comp0, float *comp1, float *comp2)
     }
 }
 
+#endif /* IMF_HAVE_SSE2 */
+
 
 //
 // Byte interleaving of 2 byte arrays:
@@ -246,7 +372,7 @@ csc709Forward64 (float *comp0, float *comp1, float *comp2)
 // numBytes is the size of each of the source buffers
 //
 
-#ifndef IMF_HAVE_SSE2 
+#if !defined(IMF_HAVE_SSE2) && !defined(IMF_HAVE_NEON)
 
 // 
 // Scalar default implementation 
@@ -262,6 +388,42 @@ interleaveByte2 (char *dst, char *src0, char *src1, int numBytes)
     }
 }
 
+#elif defined(IMF_HAVE_NEON)
+
+//
+// NEON byte interleaving. The interleaving store does all the work,
+// and NEON loads and stores don't care about alignment.
+//
+
+void
+interleaveByte2 (char *dst, char *src0, char *src1, int numBytes)
+{
+    uint8_t       *dst_u8  = (uint8_t *)dst;
+    const uint8_t *src0_u8 = (const uint8_t *)src0;
+    const uint8_t *src1_u8 = (const uint8_t *)src1;
+    int neonWidth = numBytes / 16;
+
+    for (int x = 0; x < neonWidth; ++x)
+    {
+        uint8x16x2_t tmp;
+
+        tmp.val[0] = vld1q_u8 (src0_u8 + 16 * x);
+        tmp.val[1] = vld1q_u8 (src1_u8 + 16 * x);
+
+        vst2q_u8 (dst_u8 + 32 * x, tmp);
+    }
+
+    //
+    // Then do run the leftovers one at a time
+    //
+
+    for (int x = 16 * neonWidth; x < numBytes; ++x)
+    {
+        dst[2 * x]     = src0[x];
+        dst[2 * x + 1] = src1[x];
+    }
+}
+
 #else  /* IMF_HAVE_SSE2 */
 
 // 
@@ -468,6 +630,28 @@ convertFloatToHalf64_f16c (unsigned short *dst, float *src)
 }
 
 
+//
+// NEON conversion, AArch64 has float <-> half conversions on
+// vectors as part of the base instruction set
+//
+
+void
+convertFloatToHalf64_neon (unsigned short *dst, float *src)
+{
+    #ifdef IMF_HAVE_NEON_AARCH64
+        for (int i = 0; i < 64; i += 8)
+        {
+            float16x4_t lo = vcvt_f16_f32 (vld1q_f32 (src + i));
+            float16x8_t h  = vcvt_high_f16_f32 (lo, vld1q_f32 (src + i + 4));
+
+            vst1q_u16 (dst + i, vreinterpretq_u16_f16 (h));
+        }
+    #else
+        convertFloatToHalf64_scalar (dst, src);
+    #endif /* IMF_HAVE_NEON_AARCH64 */
+}
+
+
 //
 // Convert an 8x8 block of HALF from zig-zag order to
 // FLOAT in normal order. The order we want is:
@@ -797,12 +981,74 @@ fromHalfZigZag_f16c (unsigned short *src, float *dst)
 }
 
 
+//
+// With NEON, the reordering is a byte table lookup. TBL can only
+// index 64 bytes of table at once, so each row is looked up in the
+// first 32 halfs, and then TBX fills in the lanes from the last 32
+// (indices that are out of range leave the lane alone for TBX, and
+// zero it for TBL).
+//
+// zigZagBytes holds the byte offsets into src for each row of dst.
+//
+
+void
+fromHalfZigZag_neon (unsigned short *src, float *dst)
+{
+    #ifdef IMF_HAVE_NEON_AARCH64
+        static const uint8_t zigZagBytes[128] =
+        {
+              0,   1,   2,   3,  10,  11,  12,  13,
+             28,  29,  30,  31,  54,  55,  56,  57,
+              4,   5,   8,   9,  14,  15,  26,  27,
+             32,  33,  52,  53,  58,  59,  84,  85,
+              6,   7,  16,  17,  24,  25,  34,  35,
+             50,  51,  60,  61,  82,  83,  86,  87,
+             18,  19,  22,  23,  36,  37,  48,  49,
+             62,  63,  80,  81,  88,  89, 106, 107,
+             20,  21,  38,  39,  46,  47,  64,  65,
+             78,  79,  90,  91, 104, 105, 108, 109,
+             40,  41,  44,  45,  66,  67,  76,  77,
+             92,  93, 102, 103, 110, 111, 120, 121,
+             42,  43,  68,  69,  74,  75,  94,  95,
+            100, 101, 112, 113, 118, 119, 122, 123,
+             70,  71,  72,  73,  96,  97,  98,  99,
+            114, 115, 116, 117, 124, 125, 126, 127
+        };
+
+        const uint8_t *srcBytes = (const uint8_t *)src;
+        const uint8x16_t hiOffset = vdupq_n_u8 (64);
+        uint8x16x4_t srcLo, srcHi;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            srcLo.val[i] = vld1q_u8 (srcBytes + 16 * i);
+            srcHi.val[i] = vld1q_u8 (srcBytes + 64 + 16 * i);
+        }
+
+        for (int row = 0; row < 8; ++row)
+        {
+            uint8x16_t idx = vld1q_u8 (zigZagBytes + 16 * row);
+            uint8x16_t rowBytes = vqtbl4q_u8 (srcLo, idx);
+
+            rowBytes = vqtbx4q_u8 (rowBytes, srcHi, vsubq_u8 (idx, hiOffset));
+
+            float16x8_t rowHalf = vreinterpretq_f16_u8 (rowBytes);
+
+            vst1q_f32 (dst + 8 * row,     vcvt_f32_f16 (vget_low_f16 (rowHalf)));
+            vst1q_f32 (dst + 8 * row + 4, vcvt_high_f32_f16 (rowHalf));
+        }
+    #else
+        fromHalfZigZag_scalar(src, dst);
+    #endif /* IMF_HAVE_NEON_AARCH64 */
+}
+
+
 //
 // Inverse 8x8 DCT, only inverting the DC. This assumes that
 // all AC frequencies are 0.
 //
 
-#ifndef IMF_HAVE_SSE2
+#if !defined(IMF_HAVE_SSE2) && !defined(IMF_HAVE_NEON)
 
 void 
 dctInverse8x8DcOnly (float *data)
@@ -813,6 +1059,17 @@ dctInverse8x8DcOnly (float *data)
         data[i] = val;
 }
 
+#elif defined(IMF_HAVE_NEON)
+
+void
+dctInverse8x8DcOnly (float *data)
+{
+    float32x4_t src = vdupq_n_f32 (data[0] * 3.535536e-01f * 3.535536e-01f);
+
+    for (int i = 0; i < 16; ++i)
+        vst1q_f32 (data + 4 * i, src);
+}
+
 #else  /* IMF_HAVE_SSE2 */
 
 void
@@ -1239,6 +1496,158 @@ dctInverse8x8_sse2 (float *data)
 }
 
 
+//
+// NEON Implementation
+//
+// The same as the SSE2 version, but broadcasting the row components
+// comes for free by multiplying by a lane.
+//
+
+template <int zeroedRows>
+void
+dctInverse8x8_neon (float *data)
+{
+    #ifdef IMF_HAVE_NEON
+        static const float cols[8][4] =
+        {
+            {3.535536e-01f, 3.535536e-01f, 3.535536e-01f, 3.535536e-01f},
+            {4.619398e-01f, 1.913422e-01f,-1.913422e-01f,-4.619398e-01f},
+            {3.535536e-01f,-3.535536e-01f,-3.535536e-01f, 3.535536e-01f},
+            {1.913422e-01f,-4.619398e-01f, 4.619398e-01f,-1.913422e-01f},
+
+            {4.903927e-01f, 4.157349e-01f, 2.777855e-01f, 9.754573e-02f},
+            {4.157349e-01f,-9.754573e-02f,-4.903927e-01f,-2.777855e-01f},
+            {2.777855e-01f,-4.903927e-01f, 9.754573e-02f, 4.157349e-01f},
+            {9.754573e-02f,-2.777855e-01f, 4.157349e-01f,-4.903927e-01f}
+        };
+
+        const float32x4_t a = vdupq_n_f32 (3.535536e-01f);
+        const float32x4_t b = vdupq_n_f32 (4.903927e-01f);
+        const float32x4_t c = vdupq_n_f32 (4.619398e-01f);
+        const float32x4_t d = vdupq_n_f32 (4.157349e-01f);
+        const float32x4_t e = vdupq_n_f32 (2.777855e-01f);
+        const float32x4_t f = vdupq_n_f32 (1.913422e-01f);
+        const float32x4_t g = vdupq_n_f32 (9.754573e-02f);
+
+        const float32x4_t c0 = vld1q_f32 (cols[0]);
+        const float32x4_t c1 = vld1q_f32 (cols[1]);
+        const float32x4_t c2 = vld1q_f32 (cols[2]);
+        const float32x4_t c3 = vld1q_f32 (cols[3]);
+        const float32x4_t c4 = vld1q_f32 (cols[4]);
+        const float32x4_t c5 = vld1q_f32 (cols[5]);
+        const float32x4_t c6 = vld1q_f32 (cols[6]);
+        const float32x4_t c7 = vld1q_f32 (cols[7]);
+
+        float32x4_t srcVec[16];
+        float32x4_t x[8], evenSum, oddSum;
+        float32x4_t in[8], alpha[4], beta[4], theta[4], gamma[4];
+
+        for (int i = 0; i < 16; ++i)
+            srcVec[i] = vld1q_f32 (data + 4 * i);
+
+        //
+        // Rows - see the SSE2 version. x[i] is the i-th component of
+        // the row times the i-th column of the matrix.
+        //
+
+        for (int i = 0; i < 8 - zeroedRows; ++i)
+        {
+            float32x2_t row01 = vget_low_f32  (srcVec[2 * i]);
+            float32x2_t row23 = vget_high_f32 (srcVec[2 * i]);
+            float32x2_t row45 = vget_low_f32  (srcVec[2 * i + 1]);
+            float32x2_t row67 = vget_high_f32 (srcVec[2 * i + 1]);
+
+            x[0] = vmulq_lane_f32 (c0, row01, 0);
+            x[2] = vmulq_lane_f32 (c1, row23, 0);
+            x[4] = vmulq_lane_f32 (c2, row45, 0);
+            x[6] = vmulq_lane_f32 (c3, row67, 0);
+
+            x[1] = vmulq_lane_f32 (c4, row01, 1);
+            x[3] = vmulq_lane_f32 (c5, row23, 1);
+            x[5] = vmulq_lane_f32 (c6, row45, 1);
+            x[7] = vmulq_lane_f32 (c7, row67, 1);
+
+            evenSum = vaddq_f32 (vaddq_f32 (x[0], x[2]), vaddq_f32 (x[4], x[6]));
+            oddSum  = vaddq_f32 (vaddq_f32 (x[1], x[3]), vaddq_f32 (x[5], x[7]));
+
+            //
+            //    out [0, 1, 2, 3] = evenSum + oddSum
+            //    out [7, 6, 5, 4] = evenSum - oddSum
+            //
+
+            srcVec[2 * i]     = vaddq_f32 (evenSum, oddSum);
+            srcVec[2 * i + 1] = vrev64q_f32 (vsubq_f32 (evenSum, oddSum));
+            srcVec[2 * i + 1] = vextq_f32 (srcVec[2 * i + 1],
+                                           srcVec[2 * i + 1], 2);
+        }
+
+        //
+        // Columns - 4 at a time, in two batches
+        //
+
+        for (int col = 0; col < 2; ++col)
+        {
+            for (int i = 0; i < 8; ++i)
+                in[i] = srcVec[2 * i + col];
+
+            alpha[0] = vmulq_f32 (c, in[2]);
+            alpha[1] = vmulq_f32 (f, in[2]);
+            alpha[2] = vmulq_f32 (c, in[6]);
+            alpha[3] = vmulq_f32 (f, in[6]);
+
+            beta[0] = vaddq_f32 (vaddq_f32 (vmulq_f32 (in[1], b),
+                                            vmulq_f32 (in[3], d)),
+                                 vaddq_f32 (vmulq_f32 (in[5], e),
+                                            vmulq_f32 (in[7], g)));
+
+            beta[1] = vsubq_f32 (vsubq_f32 (vmulq_f32 (in[1], d),
+                                            vmulq_f32 (in[3], g)),
+                                 vaddq_f32 (vmulq_f32 (in[5], b),
+                                            vmulq_f32 (in[7], e)));
+
+            beta[2] = vaddq_f32 (vsubq_f32 (vmulq_f32 (in[1], e),
+                                            vmulq_f32 (in[3], b)),
+                                 vaddq_f32 (vmulq_f32 (in[5], g),
+                                            vmulq_f32 (in[7], d)));
+
+            beta[3] = vaddq_f32 (vsubq_f32 (vmulq_f32 (in[1], g),
+                                            vmulq_f32 (in[3], e)),
+                                 vsubq_f32 (vmulq_f32 (in[5], d),
+                                            vmulq_f32 (in[7], b)));
+
+            theta[0] = vmulq_f32 (a, vaddq_f32 (in[0], in[4]));
+            theta[3] = vmulq_f32 (a, vsubq_f32 (in[0], in[4]));
+
+            theta[1] = vaddq_f32 (alpha[0], alpha[3]);
+            theta[2] = vsubq_f32 (alpha[1], alpha[2]);
+
+            gamma[0] = vaddq_f32 (theta[0], theta[1]);
+            gamma[1] = vaddq_f32 (theta[3], theta[2]);
+            gamma[2] = vsubq_f32 (theta[3], theta[2]);
+            gamma[3] = vsubq_f32 (theta[0], theta[1]);
+
+            srcVec[  col] = vaddq_f32 (gamma[0], beta[0]);
+            srcVec[2+col] = vaddq_f32 (gamma[1], beta[1]);
+            srcVec[4+col] = vaddq_f32 (gamma[2], beta[2]);
+            srcVec[6+col] = vaddq_f32 (gamma[3], beta[3]);
+
+            srcVec[ 8+col] = vsubq_f32 (gamma[3], beta[3]);
+            srcVec[10+col] = vsubq_f32 (gamma[2], beta[2]);
+            srcVec[12+col] = vsubq_f32 (gamma[1], beta[1]);
+            srcVec[14+col] = vsubq_f32 (gamma[0], beta[0]);
+        }
+
+        for (int i = 0; i < 16; ++i)
+            vst1q_f32 (data + 4 * i, srcVec[i]);
+
+    #else /* IMF_HAVE_NEON */
+
+        dctInverse8x8_scalar<zeroedRows> (data);
+
+    #endif /* IMF_HAVE_NEON */
+}
+
+
 //
 // AVX Implementation
 //
@@ -1737,14 +2146,12 @@ dctInverse8x8_avx (float *data)
 // and be done with it.
 //
 
-#ifndef IMF_HAVE_SSE2
-
 //
 // Default implementation
 //
 
 void 
-dctForward8x8 (float *data)
+dctForward8x8_scalar (float *data)
 {
     float A0, A1, A2, A3, A4, A5, A6, A7;
     float K0, K1, rot_x, rot_y;
@@ -1915,8 +2322,6 @@ dctForward8x8 (float *data)
     }
 }
 
-#else  /* IMF_HAVE_SSE2 */
-
 //
 // SSE2 implementation
 //
@@ -1926,8 +2331,9 @@ dctForward8x8 (float *data)
 //
 
 void 
-dctForward8x8 (float *data)
+dctForward8x8_sse2 (float *data)
 {
+#ifdef IMF_HAVE_SSE2
     __m128 *srcVec = (__m128 *)data;
     __m128  a0Vec, a1Vec, a2Vec, a3Vec, a4Vec, a5Vec, a6Vec, a7Vec;
     __m128  k0Vec, k1Vec, rotXVec, rotYVec;
@@ -2120,9 +2526,325 @@ dctForward8x8 (float *data)
         srcVec[3] = _mm_shuffle_ps (transTmp2[0], transTmp2[1], 0xDD);
         srcVec[7] = _mm_shuffle_ps (transTmp2[2], transTmp2[3], 0xDD);
     }
+#else  /* IMF_HAVE_SSE2 */
+    dctForward8x8_scalar (data);
+#endif /* IMF_HAVE_SSE2 */
 }
 
-#endif /* IMF_HAVE_SSE2 */
+#ifdef IMF_HAVE_AVX2_TARGET
+
+//
+// Transpose an 8x8 block of floats, held in 8 row registers.
+// Interleave pairs of rows, then pairs of pairs, which leaves each
+// 128-bit lane holding a transposed 4x4 block, and finally swap the
+// lanes between the top and bottom halves.
+//
+
+IMF_TARGET_AVX2 inline void
+transpose8x8_avx (__m256 &row0, __m256 &row1, __m256 &row2, __m256 &row3,
+                  __m256 &row4, __m256 &row5, __m256 &row6, __m256 &row7)
+{
+    __m256 tmp0 = _mm256_unpacklo_ps (row0, row1);
+    __m256 tmp1 = _mm256_unpackhi_ps (row0, row1);
+    __m256 tmp2 = _mm256_unpacklo_ps (row2, row3);
+    __m256 tmp3 = _mm256_unpackhi_ps (row2, row3);
+    __m256 tmp4 = _mm256_unpacklo_ps (row4, row5);
+    __m256 tmp5 = _mm256_unpackhi_ps (row4, row5);
+    __m256 tmp6 = _mm256_unpacklo_ps (row6, row7);
+    __m256 tmp7 = _mm256_unpackhi_ps (row6, row7);
+
+    __m256 quad0 = _mm256_shuffle_ps (tmp0, tmp2, 0x44);
+    __m256 quad1 = _mm256_shuffle_ps (tmp0, tmp2, 0xEE);
+    __m256 quad2 = _mm256_shuffle_ps (tmp1, tmp3, 0x44);
+    __m256 quad3 = _mm256_shuffle_ps (tmp1, tmp3, 0xEE);
+    __m256 quad4 = _mm256_shuffle_ps (tmp4, tmp6, 0x44);
+    __m256 quad5 = _mm256_shuffle_ps (tmp4, tmp6, 0xEE);
+    __m256 quad6 = _mm256_shuffle_ps (tmp5, tmp7, 0x44);
+    __m256 quad7 = _mm256_shuffle_ps (tmp5, tmp7, 0xEE);
+
+    row0 = _mm256_permute2f128_ps (quad0, quad4, 0x20);
+    row1 = _mm256_permute2f128_ps (quad1, quad5, 0x20);
+    row2 = _mm256_permute2f128_ps (quad2, quad6, 0x20);
+    row3 = _mm256_permute2f128_ps (quad3, quad7, 0x20);
+    row4 = _mm256_permute2f128_ps (quad0, quad4, 0x31);
+    row5 = _mm256_permute2f128_ps (quad1, quad5, 0x31);
+    row6 = _mm256_permute2f128_ps (quad2, quad6, 0x31);
+    row7 = _mm256_permute2f128_ps (quad3, quad7, 0x31);
+}
+
+//
+// AVX implementation
+//
+// The same column-wise passes as the SSE2 version, but with a whole
+// row in each register so all 8 columns are done at once. The
+// arithmetic happens in the same order as the SSE2 version, so the
+// results match it exactly.
+//
+
+IMF_TARGET_AVX2 void
+dctForward8x8_avx (float *data)
+{
+    __m256 a0Vec, a1Vec, a2Vec, a3Vec, a4Vec, a5Vec, a6Vec, a7Vec;
+    __m256 k0Vec, k1Vec, rotXVec, rotYVec;
+
+    const __m256 c4Vec     = _mm256_set1_ps ( .70710678f);
+    const __m256 c4NegVec  = _mm256_set1_ps (-.70710678f);
+
+    const __m256 c1HalfVec = _mm256_set1_ps (.490392640f);
+    const __m256 c2HalfVec = _mm256_set1_ps (.461939770f);
+    const __m256 c3HalfVec = _mm256_set1_ps (.415734810f);
+    const __m256 c5HalfVec = _mm256_set1_ps (.277785120f);
+    const __m256 c6HalfVec = _mm256_set1_ps (.191341720f);
+    const __m256 c7HalfVec = _mm256_set1_ps (.097545161f);
+
+    const __m256 halfVec   = _mm256_set1_ps (.5f);
+
+    __m256 row0 = _mm256_load_ps (data);
+    __m256 row1 = _mm256_load_ps (data +  8);
+    __m256 row2 = _mm256_load_ps (data + 16);
+    __m256 row3 = _mm256_load_ps (data + 24);
+    __m256 row4 = _mm256_load_ps (data + 32);
+    __m256 row5 = _mm256_load_ps (data + 40);
+    __m256 row6 = _mm256_load_ps (data + 48);
+    __m256 row7 = _mm256_load_ps (data + 56);
+
+    for (int iter = 0; iter < 2; ++iter)
+    {
+        a0Vec = _mm256_add_ps (row0, row7);
+        a1Vec = _mm256_add_ps (row1, row2);
+        a3Vec = _mm256_add_ps (row3, row4);
+        a5Vec = _mm256_add_ps (row5, row6);
+
+        a7Vec = _mm256_sub_ps (row0, row7);
+        a2Vec = _mm256_sub_ps (row1, row2);
+        a4Vec = _mm256_sub_ps (row3, row4);
+        a6Vec = _mm256_sub_ps (row5, row6);
+
+        //
+        // First stage; Compute out_0 and out_4
+        //
+
+        k0Vec = _mm256_mul_ps (c4Vec, _mm256_add_ps (a0Vec, a3Vec));
+        k1Vec = _mm256_mul_ps (c4Vec, _mm256_add_ps (a1Vec, a5Vec));
+
+        row0 = _mm256_mul_ps (_mm256_add_ps (k0Vec, k1Vec), halfVec);
+        row4 = _mm256_mul_ps (_mm256_sub_ps (k0Vec, k1Vec), halfVec);
+
+        //
+        // Second stage; Compute out_2 and out_6
+        //
+
+        k0Vec = _mm256_sub_ps (a2Vec, a6Vec);
+        k1Vec = _mm256_sub_ps (a0Vec, a3Vec);
+
+        row2 = _mm256_add_ps (_mm256_mul_ps (c6HalfVec, k0Vec),
+                              _mm256_mul_ps (c2HalfVec, k1Vec));
+
+        row6 = _mm256_sub_ps (_mm256_mul_ps (c6HalfVec, k1Vec),
+                              _mm256_mul_ps (c2HalfVec, k0Vec));
+
+        //
+        // Precompute K0 and K1 for the remaining stages
+        //
+
+        k0Vec = _mm256_mul_ps (_mm256_sub_ps (a1Vec, a5Vec), c4Vec);
+        k1Vec = _mm256_mul_ps (_mm256_add_ps (a2Vec, a6Vec), c4NegVec);
+
+        //
+        // Third Stage, compute out_3 and out_5
+        //
+
+        rotXVec = _mm256_sub_ps (a7Vec, k0Vec);
+        rotYVec = _mm256_add_ps (a4Vec, k1Vec);
+
+        row3 = _mm256_sub_ps (_mm256_mul_ps (c3HalfVec, rotXVec),
+                              _mm256_mul_ps (c5HalfVec, rotYVec));
+
+        row5 = _mm256_add_ps (_mm256_mul_ps (c5HalfVec, rotXVec),
+                              _mm256_mul_ps (c3HalfVec, rotYVec));
+
+        //
+        // Fourth Stage, compute out_1 and out_7
+        //
+
+        rotXVec = _mm256_add_ps (a7Vec, k0Vec);
+        rotYVec = _mm256_sub_ps (k1Vec, a4Vec);
+
+        row1 = _mm256_sub_ps (_mm256_mul_ps (c1HalfVec, rotXVec),
+                              _mm256_mul_ps (c7HalfVec, rotYVec));
+
+        row7 = _mm256_add_ps (_mm256_mul_ps (c7HalfVec, rotXVec),
+                              _mm256_mul_ps (c1HalfVec, rotYVec));
+
+        transpose8x8_avx (row0, row1, row2, row3, row4, row5, row6, row7);
+    }
+
+    _mm256_store_ps (data,      row0);
+    _mm256_store_ps (data +  8, row1);
+    _mm256_store_ps (data + 16, row2);
+    _mm256_store_ps (data + 24, row3);
+    _mm256_store_ps (data + 32, row4);
+    _mm256_store_ps (data + 40, row5);
+    _mm256_store_ps (data + 48, row6);
+    _mm256_store_ps (data + 56, row7);
+}
+
+#endif /* IMF_HAVE_AVX2_TARGET */
+
+#ifdef IMF_HAVE_NEON
+
+//
+// Transpose a 4x4 block of floats, held in 4 row registers
+//
+
+inline void
+transpose4x4_neon (float32x4_t &row0, float32x4_t &row1,
+                   float32x4_t &row2, float32x4_t &row3)
+{
+    float32x4x2_t row01 = vtrnq_f32 (row0, row1);
+    float32x4x2_t row23 = vtrnq_f32 (row2, row3);
+
+    row0 = vcombine_f32 (vget_low_f32  (row01.val[0]),
+                         vget_low_f32  (row23.val[0]));
+    row1 = vcombine_f32 (vget_low_f32  (row01.val[1]),
+                         vget_low_f32  (row23.val[1]));
+    row2 = vcombine_f32 (vget_high_f32 (row01.val[0]),
+                         vget_high_f32 (row23.val[0]));
+    row3 = vcombine_f32 (vget_high_f32 (row01.val[1]),
+                         vget_high_f32 (row23.val[1]));
+}
+
+#endif /* IMF_HAVE_NEON */
+
+//
+// NEON implementation
+//
+// Laid out the same as the SSE2 version: 4 columns at a time in
+// two passes, followed by a transpose of the 4x4 blocks.
+//
+
+void
+dctForward8x8_neon (float *data)
+{
+#ifdef IMF_HAVE_NEON
+    float32x4_t srcVec[16];
+    float32x4_t a0Vec, a1Vec, a2Vec, a3Vec, a4Vec, a5Vec, a6Vec, a7Vec;
+    float32x4_t k0Vec, k1Vec, rotXVec, rotYVec, swapVec;
+
+    const float32x4_t c4Vec     = vdupq_n_f32 ( .70710678f);
+    const float32x4_t c4NegVec  = vdupq_n_f32 (-.70710678f);
+
+    const float32x4_t c1HalfVec = vdupq_n_f32 (.490392640f);
+    const float32x4_t c2HalfVec = vdupq_n_f32 (.461939770f);
+    const float32x4_t c3HalfVec = vdupq_n_f32 (.415734810f);
+    const float32x4_t c5HalfVec = vdupq_n_f32 (.277785120f);
+    const float32x4_t c6HalfVec = vdupq_n_f32 (.191341720f);
+    const float32x4_t c7HalfVec = vdupq_n_f32 (.097545161f);
+
+    const float32x4_t halfVec   = vdupq_n_f32 (.5f);
+
+    for (int i = 0; i < 16; ++i)
+        srcVec[i] = vld1q_f32 (data + 4 * i);
+
+    for (int iter = 0; iter < 2; ++iter)
+    {
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            a0Vec = vaddq_f32 (srcVec[ 0 + pass], srcVec[14 + pass]);
+            a1Vec = vaddq_f32 (srcVec[ 2 + pass], srcVec[ 4 + pass]);
+            a3Vec = vaddq_f32 (srcVec[ 6 + pass], srcVec[ 8 + pass]);
+            a5Vec = vaddq_f32 (srcVec[10 + pass], srcVec[12 + pass]);
+
+            a7Vec = vsubq_f32 (srcVec[ 0 + pass], srcVec[14 + pass]);
+            a2Vec = vsubq_f32 (srcVec[ 2 + pass], srcVec[ 4 + pass]);
+            a4Vec = vsubq_f32 (srcVec[ 6 + pass], srcVec[ 8 + pass]);
+            a6Vec = vsubq_f32 (srcVec[10 + pass], srcVec[12 + pass]);
+
+            //
+            // First stage; Compute out_0 and out_4
+            //
+
+            k0Vec = vmulq_f32 (c4Vec, vaddq_f32 (a0Vec, a3Vec));
+            k1Vec = vmulq_f32 (c4Vec, vaddq_f32 (a1Vec, a5Vec));
+
+            srcVec[0 + pass] = vmulq_f32 (vaddq_f32 (k0Vec, k1Vec), halfVec);
+            srcVec[8 + pass] = vmulq_f32 (vsubq_f32 (k0Vec, k1Vec), halfVec);
+
+            //
+            // Second stage; Compute out_2 and out_6
+            //
+
+            k0Vec = vsubq_f32 (a2Vec, a6Vec);
+            k1Vec = vsubq_f32 (a0Vec, a3Vec);
+
+            srcVec[ 4 + pass] = vaddq_f32 (vmulq_f32 (c6HalfVec, k0Vec),
+                                           vmulq_f32 (c2HalfVec, k1Vec));
+
+            srcVec[12 + pass] = vsubq_f32 (vmulq_f32 (c6HalfVec, k1Vec),
+                                           vmulq_f32 (c2HalfVec, k0Vec));
+
+            //
+            // Precompute K0 and K1 for the remaining stages
+            //
+
+            k0Vec = vmulq_f32 (vsubq_f32 (a1Vec, a5Vec), c4Vec);
+            k1Vec = vmulq_f32 (vaddq_f32 (a2Vec, a6Vec), c4NegVec);
+
+            //
+            // Third Stage, compute out_3 and out_5
+            //
+
+            rotXVec = vsubq_f32 (a7Vec, k0Vec);
+            rotYVec = vaddq_f32 (a4Vec, k1Vec);
+
+            srcVec[ 6 + pass] = vsubq_f32 (vmulq_f32 (c3HalfVec, rotXVec),
+                                           vmulq_f32 (c5HalfVec, rotYVec));
+
+            srcVec[10 + pass] = vaddq_f32 (vmulq_f32 (c5HalfVec, rotXVec),
+                                           vmulq_f32 (c3HalfVec, rotYVec));
+
+            //
+            // Fourth Stage, compute out_1 and out_7
+            //
+
+            rotXVec = vaddq_f32 (a7Vec, k0Vec);
+            rotYVec = vsubq_f32 (k1Vec, a4Vec);
+
+            srcVec[ 2 + pass] = vsubq_f32 (vmulq_f32 (c1HalfVec, rotXVec),
+                                           vmulq_f32 (c7HalfVec, rotYVec));
+
+            srcVec[14 + pass] = vaddq_f32 (vmulq_f32 (c7HalfVec, rotXVec),
+                                           vmulq_f32 (c1HalfVec, rotYVec));
+        }
+
+        //
+        // Transpose each of the 4x4 blocks in place, then swap
+        // M1 and M2:
+        //
+        //         M0 | M1         M0t | M2t
+        //        ----+---   -->  -----+------
+        //         M2 | M3         M1t | M3t
+        //
+
+        transpose4x4_neon (srcVec[ 0], srcVec[ 2], srcVec[ 4], srcVec[ 6]);
+        transpose4x4_neon (srcVec[ 1], srcVec[ 3], srcVec[ 5], srcVec[ 7]);
+        transpose4x4_neon (srcVec[ 8], srcVec[10], srcVec[12], srcVec[14]);
+        transpose4x4_neon (srcVec[ 9], srcVec[11], srcVec[13], srcVec[15]);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            swapVec           = srcVec[2 * i + 1];
+            srcVec[2 * i + 1] = srcVec[2 * i + 8];
+            srcVec[2 * i + 8] = swapVec;
+        }
+    }
+
+    for (int i = 0; i < 16; ++i)
+        vst1q_f32 (data + 4 * i, srcVec[i]);
+#else  /* IMF_HAVE_NEON */
+    dctForward8x8_scalar (data);
+#endif /* IMF_HAVE_NEON */
+}
 
 } // namespace
 
@@ -45,6 +45,7 @@ class IMF_EXPORT_TYPE AcesOutputFile;
 class IMF_EXPORT_TYPE TiledInputPart;
 class IMF_EXPORT_TYPE TiledInputFile;
 class IMF_EXPORT_TYPE TileOffsets;
+class IMF_EXPORT_TYPE TileCache;
 
 // multipart file handling
 class IMF_EXPORT_TYPE GenericInputFile;
@@ -75,10 +76,12 @@ struct InputStreamMutex;
 class  IMF_EXPORT_TYPE FrameBuffer;
 class  IMF_EXPORT_TYPE DeepFrameBuffer;
 struct IMF_EXPORT_TYPE DeepSlice;
+class  IMF_EXPORT_TYPE DeepSampleAllocator;
 
 // compositing
 class IMF_EXPORT_TYPE DeepCompositing;
 class IMF_EXPORT_TYPE CompositeDeepScanLine;
+class IMF_EXPORT_TYPE CompositeDeepTiled;
 
 // preview image
 class IMF_EXPORT_TYPE PreviewImage;
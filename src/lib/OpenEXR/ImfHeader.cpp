@@ -15,6 +15,7 @@
 #include <ImfVersion.h>
 #include <ImfCompressor.h>
 #include <ImfMisc.h>
+#include <ImfB44Compressor.h>
 #include <ImfBoxAttribute.h>
 #include <ImfChannelListAttribute.h>
 #include <ImfChromaticitiesAttribute.h>
@@ -37,6 +38,7 @@
 #include <ImfTileDescriptionAttribute.h>
 #include <ImfTimeCodeAttribute.h>
 #include <ImfVecAttribute.h>
+#include <ImfZip.h>
 #include <ImfPartType.h>
 #include <ImfIDManifestAttribute.h>
 #include <IlmThreadConfig.h>
@@ -1293,6 +1295,8 @@ staticInitialize ()
 	V3fAttribute::registerAttributeType();
 	V3iAttribute::registerAttributeType();
 	DwaCompressor::initializeFuncs();
+	Zip::initializeFuncs();
+	B44Compressor::initializeFuncs();
     IDManifestAttribute::registerAttributeType();
 
 
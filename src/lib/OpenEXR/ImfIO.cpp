@@ -57,6 +57,21 @@ IStream::fileName () const
 }
 
 
+bool
+IStream::supportsReadAt () const
+{
+    return false;
+}
+
+
+void
+IStream::readAt (uint64_t /*p*/, char /*c*/[/*n*/], int /*n*/)
+{
+    throw IEX_NAMESPACE::InputExc ("Attempt to perform a positional read "
+			 "on a stream that does not support it.");
+}
+
+
 OStream::OStream (const char fileName[]): _fileName (fileName)
 {
     // empty
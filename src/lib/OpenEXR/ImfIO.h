@@ -103,6 +103,38 @@ class IMF_EXPORT_TYPE IStream
 
     IMF_EXPORT const char *	fileName () const;
 
+
+    //---------------------------------------------------------
+    // Does this input stream support positional reads?
+    // (Declared after the other virtual functions, so that
+    // the existing vtable entries keep their positions.)
+    //
+    // Positional reads do not depend on the current reading
+    // position, so several threads can read different parts
+    // of the file at the same time, without locking the
+    // stream around each seekg() and read().
+    //---------------------------------------------------------
+
+    IMF_EXPORT virtual bool	supportsReadAt () const;
+
+
+    //---------------------------------------------------------
+    // Positional read:
+    //
+    // readAt(p,c,n) reads n bytes, starting p bytes from the
+    // beginning of the file, and stores them in array c.  It
+    // neither uses nor changes the current reading position.
+    // If the file contains less than p+n bytes, or if an I/O
+    // error occurs, readAt(p,c,n) throws an exception.
+    //
+    // readAt() must be safe to call from several threads at
+    // once, concurrently with each other and with the other
+    // methods of the stream.  If the stream does not support
+    // positional reads, readAt() throws an exception.
+    //---------------------------------------------------------
+
+    IMF_EXPORT virtual void	readAt (uint64_t p, char c[/*n*/], int n);
+
   protected:
 
     IMF_EXPORT IStream (const char fileName[]);
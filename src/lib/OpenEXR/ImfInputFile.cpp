@@ -413,7 +413,11 @@ InputFile::InputFile (const char fileName[], int numThreads):
     OPENEXR_IMF_INTERNAL_NAMESPACE::IStream* is = 0;
     try
     {
+#ifndef _WIN32
+        is = new PosixIFStream (fileName);
+#else
         is = new StdIFStream (fileName);
+#endif
         readMagicNumberAndVersionField(*is, _data->version);
 
         //
@@ -104,7 +104,11 @@ MultiPartInputFile::MultiPartInputFile(const char fileName[],
 {
     try
     {
+#ifndef _WIN32
+        _data->is = new PosixIFStream (fileName);
+#else
         _data->is = new StdIFStream (fileName);
+#endif
         initialize();
     }
     catch (IEX_NAMESPACE::BaseExc &e)
@@ -26,6 +26,7 @@
 #include "ImfPartType.h"
 #include "IlmThreadPool.h"
 #include "ImfOutputStreamMutex.h"
+#include "ImfWriteBehindQueue.h"
 #include "IlmThreadSemaphore.h"
 #include "Iex.h"
 #include "ImfInputPart.h"
@@ -143,6 +144,9 @@ LineBuffer::~LineBuffer ()
 } // namespace
 
 struct OutputFile::Data
+#if ILMTHREAD_THREADING_ENABLED
+    : public std::mutex
+#endif
 {
     Header		 header;		// the image header
     bool                 multiPart;		// is the file multipart?
@@ -175,6 +179,9 @@ struct OutputFile::Data
     int                  partNumber;            // the output part number
     OutputStreamMutex *  _streamData;         
     bool                 _deleteStream;
+
+    WriteBehindQueue     writeBehind;           // compressed line buffers
+                                                // not yet in the file
      Data (int numThreads);
     ~Data ();
 
@@ -246,6 +253,14 @@ writePixelData (OutputStreamMutex *filedata,
     // to keep track of the current writing position the file
     // without calling tellp() (tellp() can be fairly expensive).
     //
+    // The stream may be shared with the other parts of a multi-part
+    // file, and with this part's write-behind task, so it is locked
+    // only while the block is written.
+    //
+
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*filedata);
+#endif
 
     uint64_t currentPosition = filedata->currentPosition;
     filedata->currentPosition = 0;
@@ -253,7 +268,7 @@ writePixelData (OutputStreamMutex *filedata,
     if (currentPosition == 0)
         currentPosition = filedata->os->tellp();
 
-    partdata->lineOffsets[(partdata->currentScanLine - partdata->minY) / partdata->linesInBuffer] =
+    partdata->lineOffsets[(lineBufferMinY - partdata->minY) / partdata->linesInBuffer] =
         currentPosition;
 
     #ifdef DEBUG
@@ -297,6 +312,51 @@ writePixelData (OutputStreamMutex* filedata,
 }
 
 
+//
+// A copy of a compressed line buffer, waiting in
+// the write-behind queue to be stored in the file.
+//
+
+struct LineBufferChunk: public WriteBehindQueue::Chunk
+{
+    OutputFile::Data *	partdata;
+    int			minY;
+
+    LineBufferChunk (OutputFile::Data *partdata,
+		     const LineBuffer *lineBuffer)
+    :
+	partdata (partdata),
+	minY (lineBuffer->minY)
+    {
+	data.assign (lineBuffer->dataPtr,
+		     lineBuffer->dataPtr + lineBuffer->dataSize);
+    }
+
+    virtual void
+    write ()
+    {
+	writePixelData (partdata->_streamData, partdata,
+			minY, data.data(), int (data.size()));
+    }
+};
+
+
+void
+writeLineBuffer (OutputFile::Data *partdata, const LineBuffer *lineBuffer)
+{
+    //
+    // Store a compressed line buffer in the file, or if write-behind
+    // is on, queue a copy of it, so that the line buffer can be reused
+    // before the data are in the file.
+    //
+
+    if (partdata->writeBehind.maxBytes() > 0)
+	partdata->writeBehind.push (new LineBufferChunk (partdata, lineBuffer));
+    else
+	writePixelData (partdata->_streamData, partdata, lineBuffer);
+}
+
+
 void
 convertToXdr (OutputFile::Data *ofd,
               Array<char> &lineBuffer,
@@ -829,6 +889,17 @@ OutputFile::~OutputFile ()
 {
     if (_data)
     {
+        try
+        {
+            _data->writeBehind.flush();
+        }
+        catch (...) //NOSONAR - suppress vulnerability reports from SonarCloud.
+        {
+            //
+            // We cannot safely throw any exceptions from here.
+            //
+        }
+
         {
 #if ILMTHREAD_THREADING_ENABLED
             std::lock_guard<std::mutex> lock(*_data->_streamData);
@@ -889,7 +960,7 @@ void
 OutputFile::setFrameBuffer (const FrameBuffer &frameBuffer)
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_data->_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
     //
     // Check if the new frame buffer descriptor
@@ -982,7 +1053,7 @@ const FrameBuffer &
 OutputFile::frameBuffer () const
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_data->_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
     return _data->frameBuffer;
 }
@@ -994,7 +1065,7 @@ OutputFile::writePixels (int numScanLines)
     try
     {
 #if ILMTHREAD_THREADING_ENABLED
-        std::lock_guard<std::mutex> lock (*_data->_streamData);
+        std::lock_guard<std::mutex> lock (*_data);
 #endif
         if (_data->slices.size() == 0)
             throw IEX_NAMESPACE::ArgExc (
@@ -1116,10 +1187,21 @@ OutputFile::writePixels (int numScanLines)
                 }
     
 		//
-                // Write the line buffer
+                // Write the line buffer.  If that fails, release the
+		// line buffer anyway, so that a later call to writePixels()
+		// reports the error instead of waiting for the buffer.
 		//
 
-                writePixelData (_data->_streamData, _data, writeBuffer);
+                try
+                {
+                    writeLineBuffer (_data, writeBuffer);
+                }
+                catch (...)
+                {
+                    writeBuffer->post();
+                    throw;
+                }
+
                 nextWriteBuffer += step;
 
                 _data->currentScanLine = _data->currentScanLine +
@@ -1218,17 +1300,63 @@ int
 OutputFile::currentScanLine () const
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_data->_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
     return _data->currentScanLine;
 }
 
 
+void
+OutputFile::setWriteBehind (size_t maxBytes)
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    if (maxBytes == 0)
+        _data->writeBehind.flush();
+
+    _data->writeBehind.setMaxBytes (maxBytes);
+}
+
+
+size_t
+OutputFile::writeBehind () const
+{
+    return _data->writeBehind.maxBytes();
+}
+
+
+void
+OutputFile::flush ()
+{
+    try
+    {
+#if ILMTHREAD_THREADING_ENABLED
+        std::lock_guard<std::mutex> lock (*_data);
+#endif
+        _data->writeBehind.flush();
+    }
+    catch (IEX_NAMESPACE::BaseExc &e)
+    {
+	REPLACE_EXC (e, "Failed to write pixel data to image "
+                 "file \"" << fileName() << "\". " << e.what());
+	throw;
+    }
+}
+
+
+size_t
+OutputFile::pendingWriteBytes () const
+{
+    return _data->writeBehind.pendingBytes();
+}
+
+
 void	
 OutputFile::copyPixels (InputFile &in)
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_data->_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
     //
     // Check if this file's and and the InputFile's
@@ -1319,7 +1447,7 @@ void
 OutputFile::updatePreviewImage (const PreviewRgba newPixels[])
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_data->_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
     if (_data->previewPosition <= 0)
 	THROW (IEX_NAMESPACE::LogicExc, "Cannot update preview image pixels. "
@@ -1346,6 +1474,9 @@ OutputFile::updatePreviewImage (const PreviewRgba newPixels[])
     // preview image, and jump back to the saved file position.
     //
 
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> streamLock (*_data->_streamData);
+#endif
     uint64_t savedPosition = _data->_streamData->os->tellp();
 
     try
@@ -1367,7 +1498,12 @@ void
 OutputFile::breakScanLine  (int y, int offset, int length, char c)
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_data->_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    _data->writeBehind.flush();
+
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> streamLock (*_data->_streamData);
 #endif
     uint64_t position = 
 	_data->lineOffsets[(y - _data->minY) / _data->linesInBuffer];
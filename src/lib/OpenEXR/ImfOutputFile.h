@@ -18,6 +18,8 @@
 #include "ImfGenericOutputFile.h"
 #include "ImfThreading.h"
 
+#include <cstddef>
+
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
 
@@ -152,6 +154,46 @@ class IMF_EXPORT_TYPE OutputFile : public GenericOutputFile
     int			currentScanLine () const;
 
 
+    //------------------------------------------------------------------
+    // Write-behind:
+    //
+    // By default, writePixels() stores the compressed scan lines in
+    // the file before it returns.  After setWriteBehind(n) with n > 0,
+    // writePixels() returns as soon as the scan lines have been
+    // compressed; the compressed data are queued, and a thread pool
+    // task writes them to the file while the caller produces the next
+    // scan lines.  At most n bytes of compressed data are queued at
+    // any time; if the queue is full, writePixels() waits until enough
+    // data have been written.  setWriteBehind(0) waits until the queue
+    // is empty and turns write-behind off.
+    //
+    // writeBehind() returns the current limit, 0 if write-behind is off.
+    //
+    // flush() waits until all queued data have been written.  If
+    // writing any of the queued data failed, flush() throws an
+    // IEX_NAMESPACE::IoExc; so does every subsequent call to
+    // writePixels() or flush().
+    //
+    // pendingWriteBytes() returns the number of bytes that have been
+    // queued, but not yet written; 0 means that all pixel data handed
+    // to writePixels() are in the file.
+    //
+    // The destructor flushes the queue.
+    //------------------------------------------------------------------
+
+    IMF_EXPORT
+    void		setWriteBehind (size_t maxBytes);
+
+    IMF_EXPORT
+    size_t		writeBehind () const;
+
+    IMF_EXPORT
+    void		flush ();
+
+    IMF_EXPORT
+    size_t		pendingWriteBytes () const;
+
+
     //--------------------------------------------------------------
     // Shortcut to copy all pixels from an InputFile into this file,
     // without uncompressing and then recompressing the pixel data.
@@ -51,6 +51,30 @@ OutputPart::currentScanLine () const
     return file->currentScanLine();
 }
 
+void
+OutputPart::setWriteBehind (size_t maxBytes)
+{
+    file->setWriteBehind(maxBytes);
+}
+
+size_t
+OutputPart::writeBehind () const
+{
+    return file->writeBehind();
+}
+
+void
+OutputPart::flush ()
+{
+    file->flush();
+}
+
+size_t
+OutputPart::pendingWriteBytes () const
+{
+    return file->pendingWriteBytes();
+}
+
 void
 OutputPart::copyPixels (InputFile &in)
 {
@@ -8,6 +8,8 @@
 
 #include "ImfForward.h"
 
+#include <cstddef>
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
 
 
@@ -36,6 +38,14 @@ class IMF_EXPORT_TYPE OutputPart
         IMF_EXPORT
         int                 currentScanLine () const;
         IMF_EXPORT
+        void                setWriteBehind (size_t maxBytes);
+        IMF_EXPORT
+        size_t              writeBehind () const;
+        IMF_EXPORT
+        void                flush ();
+        IMF_EXPORT
+        size_t              pendingWriteBytes () const;
+        IMF_EXPORT
         void                copyPixels (InputFile &in);
         IMF_EXPORT
         void                copyPixels (InputPart &in);
@@ -41,12 +41,14 @@
 #include "ImfMisc.h"
 #include "ImfCheckedArithmetic.h"
 #include "ImfNamespace.h"
+#include "ImfStandardAttributes.h"
+#include "ImfZip.h"
+#include "ImfSimd.h"
 
 #include <ImathFun.h>
 #include <Iex.h>
 
 #include <half.h>
-#include <zlib.h>
 #include <assert.h>
 #include <algorithm>
 
@@ -148,6 +150,616 @@ tooMuchData ()
 			 "(input data are longer than expected).");
 }
 
+
+//
+// Split one row of a channel into byte planes (compress) and merge
+// them back (uncompress).  The loops at the end of each function are
+// the reference versions and handle the pixels left over by the SSE2
+// or NEON kernels, which are chosen at compile time.  The NEON kernels
+// load and store the pixels as vectors of 16 or 32-bit words, so they
+// are restricted to little-endian AArch64.
+//
+
+#if defined(IMF_HAVE_SSE2)
+
+//
+// floatToFloat24() for four floats at a time.  The finite and infinite
+// cases share the rounded and truncated values, a NAN needs the one
+// extra bit if its 15 leftmost significand bits are all zero.
+//
+
+inline __m128i
+floatToFloat24_sse2 (__m128i f)
+{
+    __m128i em = _mm_and_si128 (f, _mm_set1_epi32 (0x7fffffff));
+    __m128i t = _mm_srli_epi32 (em, 8);
+
+    __m128i r = _mm_srli_epi32 (_mm_add_epi32
+				    (em, _mm_and_si128 (em, _mm_set1_epi32 (0x80))),
+				8);
+
+    __m128i overflow = _mm_cmpgt_epi32 (r, _mm_set1_epi32 (0x7f7fff));
+
+    r = _mm_or_si128 (_mm_and_si128 (overflow, t),
+		      _mm_andnot_si128 (overflow, r));
+
+    __m128i nan = _mm_and_si128
+		      (_mm_cmpgt_epi32 (em, _mm_set1_epi32 (0x7f800000)),
+		       _mm_cmplt_epi32 (em, _mm_set1_epi32 (0x7f800100)));
+
+    r = _mm_or_si128 (r, _mm_and_si128 (nan, _mm_set1_epi32 (1)));
+
+    return _mm_or_si128 (r, _mm_srli_epi32 (_mm_andnot_si128
+						(_mm_set1_epi32 (0x7fffffff), f),
+					    8));
+}
+
+
+//
+// Bits [shift, shift + 8) of sixteen 32-bit differences
+//
+
+inline __m128i
+bytePlane_sse2 (const __m128i d[4], int shift)
+{
+    const __m128i mask = _mm_set1_epi32 (0xff);
+
+    __m128i a = _mm_packs_epi32 (_mm_and_si128 (_mm_srli_epi32 (d[0], shift), mask),
+				 _mm_and_si128 (_mm_srli_epi32 (d[1], shift), mask));
+
+    __m128i b = _mm_packs_epi32 (_mm_and_si128 (_mm_srli_epi32 (d[2], shift), mask),
+				 _mm_and_si128 (_mm_srli_epi32 (d[3], shift), mask));
+
+    return _mm_packus_epi16 (a, b);
+}
+
+
+//
+// Differences between four 32-bit values and their left neighbors,
+// the last value of the previous four being the neighbor of the first
+//
+
+inline __m128i
+delta32_sse2 (__m128i p, __m128i previous)
+{
+    return _mm_sub_epi32 (p, _mm_or_si128 (_mm_slli_si128 (p, 4),
+					   _mm_srli_si128 (previous, 12)));
+}
+
+
+//
+// Running sum of four 32-bit differences, starting at the last
+// lane of carry
+//
+
+inline __m128i
+prefixSum32_sse2 (__m128i d, __m128i carry)
+{
+    d = _mm_add_epi32 (d, _mm_slli_si128 (d, 4));
+    d = _mm_add_epi32 (d, _mm_slli_si128 (d, 8));
+    return _mm_add_epi32 (d, _mm_shuffle_epi32 (carry, _MM_SHUFFLE (3, 3, 3, 3)));
+}
+
+
+//
+// Merges the high and low halves of eight 32-bit values, rebuilds the
+// values and stores them to out
+//
+
+inline __m128i
+mergeWords_sse2 (__m128i hi, __m128i lo, __m128i carry, char *out)
+{
+    __m128i x0 = prefixSum32_sse2 (_mm_unpacklo_epi16 (lo, hi), carry);
+    __m128i x1 = prefixSum32_sse2 (_mm_unpackhi_epi16 (lo, hi), x0);
+
+    _mm_storeu_si128 ((__m128i *) out, x0);
+    _mm_storeu_si128 ((__m128i *) (out + 16), x1);
+    return x1;
+}
+
+#endif // IMF_HAVE_SSE2
+
+
+#if defined(IMF_HAVE_NEON_AARCH64)
+
+inline uint32x4_t
+floatToFloat24_neon (uint32x4_t f)
+{
+    uint32x4_t em = vandq_u32 (f, vdupq_n_u32 (0x7fffffff));
+    uint32x4_t t = vshrq_n_u32 (em, 8);
+
+    uint32x4_t r = vshrq_n_u32 (vaddq_u32 (em, vandq_u32 (em, vdupq_n_u32 (0x80))),
+				8);
+
+    r = vbslq_u32 (vcgtq_u32 (r, vdupq_n_u32 (0x7f7fff)), t, r);
+
+    uint32x4_t nan = vandq_u32 (vcgtq_u32 (em, vdupq_n_u32 (0x7f800000)),
+				vcltq_u32 (em, vdupq_n_u32 (0x7f800100)));
+
+    r = vorrq_u32 (r, vandq_u32 (nan, vdupq_n_u32 (1)));
+
+    return vorrq_u32 (r, vshrq_n_u32 (vandq_u32 (f, vdupq_n_u32 (0x80000000)), 8));
+}
+
+
+inline uint8x8_t
+bytePlane_neon (uint32x4_t d0, uint32x4_t d1, int shift)
+{
+    int32x4_t s = vdupq_n_s32 (-shift);
+
+    return vmovn_u16 (vcombine_u16 (vmovn_u32 (vshlq_u32 (d0, s)),
+				    vmovn_u32 (vshlq_u32 (d1, s))));
+}
+
+
+inline uint32x4_t
+prefixSum32_neon (uint32x4_t d, uint32x4_t carry)
+{
+    const uint32x4_t zero = vdupq_n_u32 (0);
+
+    d = vaddq_u32 (d, vextq_u32 (zero, d, 3));
+    d = vaddq_u32 (d, vextq_u32 (zero, d, 2));
+    return vaddq_u32 (d, vdupq_laneq_u32 (carry, 3));
+}
+
+
+inline uint32x4_t
+mergeWords_neon (uint16x8_t hi, uint16x8_t lo, uint32x4_t carry, char *out)
+{
+    uint32x4_t x0 = prefixSum32_neon
+			(vorrq_u32 (vshll_n_u16 (vget_low_u16 (hi), 16),
+				    vmovl_u16 (vget_low_u16 (lo))),
+			 carry);
+
+    uint32x4_t x1 = prefixSum32_neon
+			(vorrq_u32 (vshll_n_u16 (vget_high_u16 (hi), 16),
+				    vmovl_u16 (vget_high_u16 (lo))),
+			 x0);
+
+    vst1q_u8 ((uint8_t *) out, vreinterpretq_u8_u32 (x0));
+    vst1q_u8 ((uint8_t *) (out + 16), vreinterpretq_u8_u32 (x1));
+    return x1;
+}
+
+#endif // IMF_HAVE_NEON_AARCH64
+
+
+void
+splitUInt (const char *in, int n, unsigned char *out)
+{
+    unsigned char *ptr[4];
+    unsigned int previousPixel = 0;
+    int j = 0;
+
+    ptr[0] = out;
+    ptr[1] = ptr[0] + n;
+    ptr[2] = ptr[1] + n;
+    ptr[3] = ptr[2] + n;
+
+#if defined(IMF_HAVE_SSE2)
+
+    __m128i previous = _mm_setzero_si128 ();
+
+    for (; j + 16 <= n; j += 16, in += 64)
+    {
+	__m128i d[4];
+
+	for (int k = 0; k < 4; ++k)
+	{
+	    __m128i p = _mm_loadu_si128 ((const __m128i *) in + k);
+	    d[k] = delta32_sse2 (p, previous);
+	    previous = p;
+	}
+
+	_mm_storeu_si128 ((__m128i *) (ptr[0] + j), bytePlane_sse2 (d, 24));
+	_mm_storeu_si128 ((__m128i *) (ptr[1] + j), bytePlane_sse2 (d, 16));
+	_mm_storeu_si128 ((__m128i *) (ptr[2] + j), bytePlane_sse2 (d, 8));
+	_mm_storeu_si128 ((__m128i *) (ptr[3] + j), bytePlane_sse2 (d, 0));
+    }
+
+    previousPixel = _mm_cvtsi128_si32 (_mm_srli_si128 (previous, 12));
+
+#elif defined(IMF_HAVE_NEON_AARCH64)
+
+    uint32x4_t previous = vdupq_n_u32 (0);
+
+    for (; j + 8 <= n; j += 8, in += 32)
+    {
+	uint32x4_t p0 = vreinterpretq_u32_u8 (vld1q_u8 ((const uint8_t *) in));
+	uint32x4_t p1 = vreinterpretq_u32_u8 (vld1q_u8 ((const uint8_t *) in + 16));
+	uint32x4_t d0 = vsubq_u32 (p0, vextq_u32 (previous, p0, 3));
+	uint32x4_t d1 = vsubq_u32 (p1, vextq_u32 (p0, p1, 3));
+	previous = p1;
+
+	vst1_u8 (ptr[0] + j, bytePlane_neon (d0, d1, 24));
+	vst1_u8 (ptr[1] + j, bytePlane_neon (d0, d1, 16));
+	vst1_u8 (ptr[2] + j, bytePlane_neon (d0, d1, 8));
+	vst1_u8 (ptr[3] + j, bytePlane_neon (d0, d1, 0));
+    }
+
+    previousPixel = vgetq_lane_u32 (previous, 3);
+
+#endif
+
+    for (; j < n; ++j)
+    {
+	unsigned int pixel;
+	char *pPtr = (char *) &pixel;
+
+	for (size_t k = 0; k < sizeof (pixel); ++k)
+	    *pPtr++ = *in++;
+
+	unsigned int diff = pixel - previousPixel;
+	previousPixel = pixel;
+
+	ptr[0][j] = diff >> 24;
+	ptr[1][j] = diff >> 16;
+	ptr[2][j] = diff >> 8;
+	ptr[3][j] = diff;
+    }
+}
+
+
+void
+splitHalf (const char *in, int n, unsigned char *out)
+{
+    unsigned char *ptr[2];
+    unsigned int previousPixel = 0;
+    int j = 0;
+
+    ptr[0] = out;
+    ptr[1] = ptr[0] + n;
+
+#if defined(IMF_HAVE_SSE2)
+
+    const __m128i mask = _mm_set1_epi16 (0xff);
+    __m128i previous = _mm_setzero_si128 ();
+
+    for (; j + 16 <= n; j += 16, in += 32)
+    {
+	__m128i p0 = _mm_loadu_si128 ((const __m128i *) in);
+	__m128i p1 = _mm_loadu_si128 ((const __m128i *) in + 1);
+
+	__m128i d0 = _mm_sub_epi16 (p0, _mm_or_si128 (_mm_slli_si128 (p0, 2),
+						      _mm_srli_si128 (previous, 14)));
+
+	__m128i d1 = _mm_sub_epi16 (p1, _mm_or_si128 (_mm_slli_si128 (p1, 2),
+						      _mm_srli_si128 (p0, 14)));
+	previous = p1;
+
+	_mm_storeu_si128 ((__m128i *) (ptr[0] + j),
+			  _mm_packus_epi16 (_mm_srli_epi16 (d0, 8),
+					    _mm_srli_epi16 (d1, 8)));
+
+	_mm_storeu_si128 ((__m128i *) (ptr[1] + j),
+			  _mm_packus_epi16 (_mm_and_si128 (d0, mask),
+					    _mm_and_si128 (d1, mask)));
+    }
+
+    previousPixel = _mm_extract_epi16 (previous, 7);
+
+#elif defined(IMF_HAVE_NEON_AARCH64)
+
+    uint16x8_t previous = vdupq_n_u16 (0);
+
+    for (; j + 8 <= n; j += 8, in += 16)
+    {
+	uint16x8_t p = vreinterpretq_u16_u8 (vld1q_u8 ((const uint8_t *) in));
+	uint16x8_t d = vsubq_u16 (p, vextq_u16 (previous, p, 7));
+	previous = p;
+
+	vst1_u8 (ptr[0] + j, vshrn_n_u16 (d, 8));
+	vst1_u8 (ptr[1] + j, vmovn_u16 (d));
+    }
+
+    previousPixel = vgetq_lane_u16 (previous, 7);
+
+#endif
+
+    for (; j < n; ++j)
+    {
+	half pixel;
+
+	pixel = *(const half *) in;
+	in += sizeof (half);
+
+	unsigned int diff = pixel.bits() - previousPixel;
+	previousPixel = pixel.bits();
+
+	ptr[0][j] = diff >> 8;
+	ptr[1][j] = diff;
+    }
+}
+
+
+void
+splitFloat (const char *in, int n, unsigned char *out)
+{
+    unsigned char *ptr[3];
+    unsigned int previousPixel = 0;
+    int j = 0;
+
+    ptr[0] = out;
+    ptr[1] = ptr[0] + n;
+    ptr[2] = ptr[1] + n;
+
+#if defined(IMF_HAVE_SSE2)
+
+    __m128i previous = _mm_setzero_si128 ();
+
+    for (; j + 16 <= n; j += 16, in += 64)
+    {
+	__m128i d[4];
+
+	for (int k = 0; k < 4; ++k)
+	{
+	    __m128i p = floatToFloat24_sse2
+			    (_mm_loadu_si128 ((const __m128i *) in + k));
+
+	    d[k] = delta32_sse2 (p, previous);
+	    previous = p;
+	}
+
+	_mm_storeu_si128 ((__m128i *) (ptr[0] + j), bytePlane_sse2 (d, 16));
+	_mm_storeu_si128 ((__m128i *) (ptr[1] + j), bytePlane_sse2 (d, 8));
+	_mm_storeu_si128 ((__m128i *) (ptr[2] + j), bytePlane_sse2 (d, 0));
+    }
+
+    previousPixel = _mm_cvtsi128_si32 (_mm_srli_si128 (previous, 12));
+
+#elif defined(IMF_HAVE_NEON_AARCH64)
+
+    uint32x4_t previous = vdupq_n_u32 (0);
+
+    for (; j + 8 <= n; j += 8, in += 32)
+    {
+	uint32x4_t p0 = floatToFloat24_neon
+			    (vreinterpretq_u32_u8 (vld1q_u8 ((const uint8_t *) in)));
+
+	uint32x4_t p1 = floatToFloat24_neon
+			    (vreinterpretq_u32_u8 (vld1q_u8 ((const uint8_t *) in + 16)));
+
+	uint32x4_t d0 = vsubq_u32 (p0, vextq_u32 (previous, p0, 3));
+	uint32x4_t d1 = vsubq_u32 (p1, vextq_u32 (p0, p1, 3));
+	previous = p1;
+
+	vst1_u8 (ptr[0] + j, bytePlane_neon (d0, d1, 16));
+	vst1_u8 (ptr[1] + j, bytePlane_neon (d0, d1, 8));
+	vst1_u8 (ptr[2] + j, bytePlane_neon (d0, d1, 0));
+    }
+
+    previousPixel = vgetq_lane_u32 (previous, 3);
+
+#endif
+
+    for (; j < n; ++j)
+    {
+	float pixel;
+	char *pPtr = (char *) &pixel;
+
+	for (size_t k = 0; k < sizeof (pixel); ++k)
+	    *pPtr++ = *in++;
+
+	unsigned int pixel24 = floatToFloat24 (pixel);
+	unsigned int diff = pixel24 - previousPixel;
+	previousPixel = pixel24;
+
+	ptr[0][j] = diff >> 16;
+	ptr[1][j] = diff >> 8;
+	ptr[2][j] = diff;
+    }
+}
+
+
+void
+mergeUInt (const unsigned char *in, int n, char *out)
+{
+    const unsigned char *ptr[4];
+    unsigned int pixel = 0;
+    int j = 0;
+
+    ptr[0] = in;
+    ptr[1] = ptr[0] + n;
+    ptr[2] = ptr[1] + n;
+    ptr[3] = ptr[2] + n;
+
+#if defined(IMF_HAVE_SSE2)
+
+    __m128i carry = _mm_setzero_si128 ();
+
+    for (; j + 16 <= n; j += 16, out += 64)
+    {
+	__m128i b0 = _mm_loadu_si128 ((const __m128i *) (ptr[0] + j));
+	__m128i b1 = _mm_loadu_si128 ((const __m128i *) (ptr[1] + j));
+	__m128i b2 = _mm_loadu_si128 ((const __m128i *) (ptr[2] + j));
+	__m128i b3 = _mm_loadu_si128 ((const __m128i *) (ptr[3] + j));
+
+	carry = mergeWords_sse2 (_mm_unpacklo_epi8 (b1, b0),
+				 _mm_unpacklo_epi8 (b3, b2),
+				 carry, out);
+
+	carry = mergeWords_sse2 (_mm_unpackhi_epi8 (b1, b0),
+				 _mm_unpackhi_epi8 (b3, b2),
+				 carry, out + 32);
+    }
+
+    pixel = _mm_cvtsi128_si32 (_mm_srli_si128 (carry, 12));
+
+#elif defined(IMF_HAVE_NEON_AARCH64)
+
+    uint32x4_t carry = vdupq_n_u32 (0);
+
+    for (; j + 8 <= n; j += 8, out += 32)
+    {
+	uint16x8_t hi = vorrq_u16 (vshll_n_u8 (vld1_u8 (ptr[0] + j), 8),
+				   vmovl_u8 (vld1_u8 (ptr[1] + j)));
+
+	uint16x8_t lo = vorrq_u16 (vshll_n_u8 (vld1_u8 (ptr[2] + j), 8),
+				   vmovl_u8 (vld1_u8 (ptr[3] + j)));
+
+	carry = mergeWords_neon (hi, lo, carry, out);
+    }
+
+    pixel = vgetq_lane_u32 (carry, 3);
+
+#endif
+
+    for (; j < n; ++j)
+    {
+	unsigned int diff = (ptr[0][j] << 24) |
+			    (ptr[1][j] << 16) |
+			    (ptr[2][j] <<  8) |
+			     ptr[3][j];
+
+	pixel += diff;
+
+	char *pPtr = (char *) &pixel;
+
+	for (size_t k = 0; k < sizeof (pixel); ++k)
+	    *out++ = *pPtr++;
+    }
+}
+
+
+void
+mergeHalf (const unsigned char *in, int n, char *out)
+{
+    const unsigned char *ptr[2];
+    unsigned int pixel = 0;
+    int j = 0;
+
+    ptr[0] = in;
+    ptr[1] = ptr[0] + n;
+
+#if defined(IMF_HAVE_SSE2)
+
+    __m128i carry = _mm_setzero_si128 ();
+
+    for (; j + 16 <= n; j += 16, out += 32)
+    {
+	__m128i b0 = _mm_loadu_si128 ((const __m128i *) (ptr[0] + j));
+	__m128i b1 = _mm_loadu_si128 ((const __m128i *) (ptr[1] + j));
+	__m128i x[2] = {_mm_unpacklo_epi8 (b1, b0), _mm_unpackhi_epi8 (b1, b0)};
+
+	for (int k = 0; k < 2; ++k)
+	{
+	    __m128i d = x[k];
+	    d = _mm_add_epi16 (d, _mm_slli_si128 (d, 2));
+	    d = _mm_add_epi16 (d, _mm_slli_si128 (d, 4));
+	    d = _mm_add_epi16 (d, _mm_slli_si128 (d, 8));
+	    d = _mm_add_epi16 (d, carry);
+
+	    _mm_storeu_si128 ((__m128i *) out + k, d);
+
+	    carry = _mm_shufflehi_epi16 (d, _MM_SHUFFLE (3, 3, 3, 3));
+	    carry = _mm_unpackhi_epi64 (carry, carry);
+	}
+    }
+
+    pixel = _mm_extract_epi16 (carry, 7);
+
+#elif defined(IMF_HAVE_NEON_AARCH64)
+
+    const uint16x8_t zero = vdupq_n_u16 (0);
+    uint16x8_t carry = zero;
+
+    for (; j + 8 <= n; j += 8, out += 16)
+    {
+	uint16x8_t d = vorrq_u16 (vshll_n_u8 (vld1_u8 (ptr[0] + j), 8),
+				  vmovl_u8 (vld1_u8 (ptr[1] + j)));
+
+	d = vaddq_u16 (d, vextq_u16 (zero, d, 7));
+	d = vaddq_u16 (d, vextq_u16 (zero, d, 6));
+	d = vaddq_u16 (d, vextq_u16 (zero, d, 4));
+	d = vaddq_u16 (d, carry);
+
+	vst1q_u8 ((uint8_t *) out, vreinterpretq_u8_u16 (d));
+	carry = vdupq_laneq_u16 (d, 7);
+    }
+
+    pixel = vgetq_lane_u16 (carry, 7);
+
+#endif
+
+    for (; j < n; ++j)
+    {
+	unsigned int diff = (ptr[0][j] << 8) |
+			     ptr[1][j];
+
+	pixel += diff;
+
+	half * hPtr = (half *) out;
+	hPtr->setBits ((unsigned short) pixel);
+	out += sizeof (half);
+    }
+}
+
+
+void
+mergeFloat (const unsigned char *in, int n, char *out)
+{
+    const unsigned char *ptr[3];
+    unsigned int pixel = 0;
+    int j = 0;
+
+    ptr[0] = in;
+    ptr[1] = ptr[0] + n;
+    ptr[2] = ptr[1] + n;
+
+#if defined(IMF_HAVE_SSE2)
+
+    const __m128i zero = _mm_setzero_si128 ();
+    __m128i carry = zero;
+
+    for (; j + 16 <= n; j += 16, out += 64)
+    {
+	__m128i b0 = _mm_loadu_si128 ((const __m128i *) (ptr[0] + j));
+	__m128i b1 = _mm_loadu_si128 ((const __m128i *) (ptr[1] + j));
+	__m128i b2 = _mm_loadu_si128 ((const __m128i *) (ptr[2] + j));
+
+	carry = mergeWords_sse2 (_mm_unpacklo_epi8 (b1, b0),
+				 _mm_unpacklo_epi8 (zero, b2),
+				 carry, out);
+
+	carry = mergeWords_sse2 (_mm_unpackhi_epi8 (b1, b0),
+				 _mm_unpackhi_epi8 (zero, b2),
+				 carry, out + 32);
+    }
+
+    pixel = _mm_cvtsi128_si32 (_mm_srli_si128 (carry, 12));
+
+#elif defined(IMF_HAVE_NEON_AARCH64)
+
+    uint32x4_t carry = vdupq_n_u32 (0);
+
+    for (; j + 8 <= n; j += 8, out += 32)
+    {
+	uint16x8_t hi = vorrq_u16 (vshll_n_u8 (vld1_u8 (ptr[0] + j), 8),
+				   vmovl_u8 (vld1_u8 (ptr[1] + j)));
+
+	uint16x8_t lo = vshll_n_u8 (vld1_u8 (ptr[2] + j), 8);
+
+	carry = mergeWords_neon (hi, lo, carry, out);
+    }
+
+    pixel = vgetq_lane_u32 (carry, 3);
+
+#endif
+
+    for (; j < n; ++j)
+    {
+	unsigned int diff = (ptr[0][j] << 24) |
+			    (ptr[1][j] << 16) |
+			    (ptr[2][j] <<  8);
+	pixel += diff;
+
+	char *pPtr = (char *) &pixel;
+
+	for (size_t k = 0; k < sizeof (pixel); ++k)
+	    *out++ = *pPtr++;
+    }
+}
+
 } // namespace
 
 
@@ -160,7 +772,8 @@ Pxr24Compressor::Pxr24Compressor (const Header &hdr,
     _numScanLines (numScanLines),
     _tmpBuffer (0),
     _outBuffer (0),
-    _channels (hdr.channels())
+    _channels (hdr.channels()),
+    _zipLevel (Zip::headerLevel (hdr))
 {
     size_t maxInBytes =
         uiMult (maxScanLineSize, numScanLines);
@@ -282,84 +895,27 @@ Pxr24Compressor::compress (const char *inPtr,
 
 	    int n = numSamples (c.xSampling, minX, maxX);
 
-	    unsigned char *ptr[4];
-	    unsigned int previousPixel = 0;
-
 	    switch (c.type)
 	    {
 	      case OPENEXR_IMF_INTERNAL_NAMESPACE::UINT:
 
-		ptr[0] = tmpBufferEnd;
-		ptr[1] = ptr[0] + n;
-		ptr[2] = ptr[1] + n;
-		ptr[3] = ptr[2] + n;
-		tmpBufferEnd = ptr[3] + n;
-
-		for (int j = 0; j < n; ++j)
-		{
-		    unsigned int pixel;
-		    char *pPtr = (char *) &pixel;
-
-		    for (size_t k = 0; k < sizeof (pixel); ++k)
-			*pPtr++ = *inPtr++;
-
-		    unsigned int diff = pixel - previousPixel;
-		    previousPixel = pixel;
-
-		    *(ptr[0]++) = diff >> 24;
-		    *(ptr[1]++) = diff >> 16;
-		    *(ptr[2]++) = diff >> 8;
-		    *(ptr[3]++) = diff;
-		}
-
+		splitUInt (inPtr, n, tmpBufferEnd);
+		inPtr += n * sizeof (unsigned int);
+		tmpBufferEnd += n * 4;
 		break;
 
 	      case OPENEXR_IMF_INTERNAL_NAMESPACE::HALF:
 
-		ptr[0] = tmpBufferEnd;
-		ptr[1] = ptr[0] + n;
-		tmpBufferEnd = ptr[1] + n;
-
-		for (int j = 0; j < n; ++j)
-		{
-		    half pixel;
-
-		    pixel = *(const half *) inPtr;
-		    inPtr += sizeof (half);
-
-		    unsigned int diff = pixel.bits() - previousPixel;
-		    previousPixel = pixel.bits();
-
-		    *(ptr[0]++) = diff >> 8;
-		    *(ptr[1]++) = diff;
-		}
-
+		splitHalf (inPtr, n, tmpBufferEnd);
+		inPtr += n * sizeof (half);
+		tmpBufferEnd += n * 2;
 		break;
 
 	      case OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT:
 
-		ptr[0] = tmpBufferEnd;
-		ptr[1] = ptr[0] + n;
-		ptr[2] = ptr[1] + n;
-		tmpBufferEnd = ptr[2] + n;
-
-		for (int j = 0; j < n; ++j)
-		{
-		    float pixel;
-		    char *pPtr = (char *) &pixel;
-
-		    for (size_t k = 0; k < sizeof (pixel); ++k)
-			*pPtr++ = *inPtr++;
-
-		    unsigned int pixel24 = floatToFloat24 (pixel);
-		    unsigned int diff = pixel24 - previousPixel;
-		    previousPixel = pixel24;
-
-		    *(ptr[0]++) = diff >> 16;
-		    *(ptr[1]++) = diff >> 8;
-		    *(ptr[2]++) = diff;
-		}
-
+		splitFloat (inPtr, n, tmpBufferEnd);
+		inPtr += n * sizeof (float);
+		tmpBufferEnd += n * 3;
 		break;
 
 	      default:
@@ -369,15 +925,13 @@ Pxr24Compressor::compress (const char *inPtr,
 	}
     }
 
-    uLongf outSize = int (ceil ((tmpBufferEnd - _tmpBuffer) * 1.01)) + 100;
+    size_t outSize = int (ceil ((tmpBufferEnd - _tmpBuffer) * 1.01)) + 100;
 
-    if (Z_OK != ::compress ((Bytef *) _outBuffer,
-			    &outSize,
-			    (const Bytef *) _tmpBuffer,
-			    tmpBufferEnd - _tmpBuffer))
-    {
-	throw IEX_NAMESPACE::BaseExc ("Data compression (zlib) failed.");
-    }
+    outSize = Zip::deflateBuffer (_zipLevel,
+				  (const char *) _tmpBuffer,
+				  tmpBufferEnd - _tmpBuffer,
+				  _outBuffer,
+				  outSize);
 
     outPtr = _outBuffer;
     return outSize;
@@ -396,15 +950,10 @@ Pxr24Compressor::uncompress (const char *inPtr,
 	return 0;
     }
 
-    uLongf tmpSize = _maxScanLineSize * _numScanLines;
-
-    if (Z_OK != ::uncompress ((Bytef *)_tmpBuffer,
-			      &tmpSize,
-			      (const Bytef *) inPtr,
-			      inSize))
-    {
-	throw IEX_NAMESPACE::InputExc ("Data decompression (zlib) failed.");
-    }
+    size_t tmpSize = Zip::inflateBuffer (inPtr,
+					 inSize,
+					 (char *) _tmpBuffer,
+					 _maxScanLineSize * _numScanLines);
 
     int minX = range.min.x;
     int maxX = min (range.max.x, _maxX);
@@ -427,85 +976,41 @@ Pxr24Compressor::uncompress (const char *inPtr,
 
 	    int n = numSamples (c.xSampling, minX, maxX);
 
-	    const unsigned char *ptr[4];
-	    unsigned int pixel = 0;
+	    const unsigned char *planes = tmpBufferEnd;
 
 	    switch (c.type)
 	    {
 	      case OPENEXR_IMF_INTERNAL_NAMESPACE::UINT:
 
-		ptr[0] = tmpBufferEnd;
-		ptr[1] = ptr[0] + n;
-		ptr[2] = ptr[1] + n;
-		ptr[3] = ptr[2] + n;
-		tmpBufferEnd = ptr[3] + n;
+		tmpBufferEnd += n * 4;
 
-		if ( (uLongf)(tmpBufferEnd - _tmpBuffer) > tmpSize)
+		if ( (size_t)(tmpBufferEnd - _tmpBuffer) > tmpSize)
 		    notEnoughData();
 
-		for (int j = 0; j < n; ++j)
-		{
-		    unsigned int diff = (*(ptr[0]++) << 24) |
-					(*(ptr[1]++) << 16) |
-					(*(ptr[2]++) <<  8) |
-					 *(ptr[3]++);
-
-		    pixel += diff;
-
-		    char *pPtr = (char *) &pixel;
-
-		    for (size_t k = 0; k < sizeof (pixel); ++k)
-			*writePtr++ = *pPtr++;
-		}
-
+		mergeUInt (planes, n, writePtr);
+		writePtr += n * sizeof (unsigned int);
 		break;
 
 	      case OPENEXR_IMF_INTERNAL_NAMESPACE::HALF:
 
-		ptr[0] = tmpBufferEnd;
-		ptr[1] = ptr[0] + n;
-		tmpBufferEnd = ptr[1] + n;
+		tmpBufferEnd += n * 2;
 
-        if ( (uLongf)(tmpBufferEnd - _tmpBuffer) > tmpSize)
+		if ( (size_t)(tmpBufferEnd - _tmpBuffer) > tmpSize)
 		    notEnoughData();
 
-		for (int j = 0; j < n; ++j)
-		{
-		    unsigned int diff = (*(ptr[0]++) << 8) |
-					 *(ptr[1]++);
-
-		    pixel += diff;
-
-		    half * hPtr = (half *) writePtr;
-		    hPtr->setBits ((unsigned short) pixel);
-		    writePtr += sizeof (half);
-		}
-
+		mergeHalf (planes, n, writePtr);
+		writePtr += n * sizeof (half);
 		break;
 
 	      case OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT:
 
-		ptr[0] = tmpBufferEnd;
-		ptr[1] = ptr[0] + n;
-		ptr[2] = ptr[1] + n;
-		tmpBufferEnd = ptr[2] + n;
+		tmpBufferEnd += n * 3;
 
-        if ( (uLongf) (tmpBufferEnd - _tmpBuffer) > tmpSize)
+		if ( (size_t)(tmpBufferEnd - _tmpBuffer) > tmpSize)
 		    notEnoughData();
 
-		for (int j = 0; j < n; ++j)
-		{
-		    unsigned int diff = (*(ptr[0]++) << 24) |
-					(*(ptr[1]++) << 16) |
-					(*(ptr[2]++) <<  8);
-		    pixel += diff;
-
-		    char *pPtr = (char *) &pixel;
-
-		    for (size_t k = 0; k < sizeof (pixel); ++k)
-			*writePtr++ = *pPtr++;
-		}
-
+		mergeFloat (planes, n, writePtr);
+		writePtr += n * sizeof (float);
 		break;
 
 	      default:
@@ -515,11 +1020,43 @@ Pxr24Compressor::uncompress (const char *inPtr,
 	}
     }
 
-    if ((uLongf) (tmpBufferEnd - _tmpBuffer) < tmpSize)
+    if ((size_t) (tmpBufferEnd - _tmpBuffer) < tmpSize)
 	tooMuchData();
 
     outPtr = _outBuffer;
     return writePtr - _outBuffer;
 }
 
+
+void
+Pxr24Compressor::splitPlanes (PixelType type,
+			      const char *in,
+			      int n,
+			      unsigned char *out)
+{
+    switch (type)
+    {
+      case OPENEXR_IMF_INTERNAL_NAMESPACE::UINT:  splitUInt (in, n, out);  break;
+      case OPENEXR_IMF_INTERNAL_NAMESPACE::HALF:  splitHalf (in, n, out);  break;
+      case OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT: splitFloat (in, n, out); break;
+      default: assert (false);
+    }
+}
+
+
+void
+Pxr24Compressor::mergePlanes (PixelType type,
+			      const unsigned char *in,
+			      int n,
+			      char *out)
+{
+    switch (type)
+    {
+      case OPENEXR_IMF_INTERNAL_NAMESPACE::UINT:  mergeUInt (in, n, out);  break;
+      case OPENEXR_IMF_INTERNAL_NAMESPACE::HALF:  mergeHalf (in, n, out);  break;
+      case OPENEXR_IMF_INTERNAL_NAMESPACE::FLOAT: mergeFloat (in, n, out); break;
+      default: assert (false);
+    }
+}
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
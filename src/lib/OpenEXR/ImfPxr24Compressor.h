@@ -13,6 +13,8 @@
 //
 //-----------------------------------------------------------------------------
 
+#include "ImfExport.h"
+#include "ImfPixelType.h"
 #include "ImfCompressor.h"
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
@@ -56,6 +58,27 @@ class Pxr24Compressor: public Compressor
 					int inSize,
 					IMATH_NAMESPACE::Box2i range,
 					const char *&outPtr);
+
+    //
+    // The preprocessing of one row of n samples of a channel of the
+    // given type.  splitPlanes reads n values from in, replaces them
+    // with the difference to their left neighbor and writes the bytes
+    // of the differences to out, as 2 (HALF), 3 (FLOAT) or 4 (UINT)
+    // planes of n bytes each, most significant byte first.  FLOAT
+    // values are rounded to 24 bits first.  mergePlanes is the inverse
+    // and writes n values to out.
+    //
+
+    IMF_EXPORT static void	splitPlanes (PixelType type,
+					     const char *in,
+					     int n,
+					     unsigned char *out);
+
+    IMF_EXPORT static void	mergePlanes (PixelType type,
+					     const unsigned char *in,
+					     int n,
+					     char *out);
+
   private:
 
     int			compress (const char *inPtr,
@@ -73,6 +96,7 @@ class Pxr24Compressor: public Compressor
     unsigned char *	_tmpBuffer;
     char *		_outBuffer;
     const ChannelList &	_channels;
+    int			_zipLevel;
     int			_minX;
     int			_maxX;
     int			_maxY;
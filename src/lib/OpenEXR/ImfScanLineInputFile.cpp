@@ -343,6 +343,53 @@ readLineOffsets (OPENEXR_IMF_INTERNAL_NAMESPACE::IStream &is,
 }
 
 
+void
+readPixelDataAt (InputStreamMutex *streamData,
+                 ScanLineInputFile::Data *ifd,
+                 int minY,
+                 uint64_t lineOffset,
+                 char *buffer,
+                 int &dataSize)
+{
+    //
+    // Read a single line buffer with positional reads, which
+    // need no lock on the stream: first the data block's
+    // header, then the pixel data that follow it.
+    //
+
+    char header[3 * sizeof (int32_t)];
+    int headerSize = (isMultiPart (ifd->version)? 3: 2) * Xdr::size<int>();
+
+    streamData->is->readAt (lineOffset, header, headerSize);
+
+    const char *readPtr = header;
+    int yInFile;
+
+    if (isMultiPart (ifd->version))
+    {
+        int partNumber;
+        Xdr::read <CharPtrIO> (readPtr, partNumber);
+
+        if (partNumber != ifd->partNumber)
+        {
+            THROW (IEX_NAMESPACE::ArgExc, "Unexpected part number " << partNumber
+                   << ", should be " << ifd->partNumber << ".");
+        }
+    }
+
+    Xdr::read <CharPtrIO> (readPtr, yInFile);
+    Xdr::read <CharPtrIO> (readPtr, dataSize);
+
+    if (yInFile != minY)
+        throw IEX_NAMESPACE::InputExc ("Unexpected data block y coordinate.");
+
+    if (dataSize < 0 || dataSize > static_cast<int>(ifd->lineBufferSize) )
+        throw IEX_NAMESPACE::InputExc ("Unexpected data block length.");
+
+    streamData->is->readAt (lineOffset + headerSize, buffer, dataSize);
+}
+
+
 void
 readPixelData (InputStreamMutex *streamData,
                ScanLineInputFile::Data *ifd,
@@ -368,6 +415,28 @@ readPixelData (InputStreamMutex *streamData,
     if (lineOffset == 0)
 	THROW (IEX_NAMESPACE::InputExc, "Scan line " << minY << " is missing.");
 
+    //
+    // If the stream supports positional reads, the line
+    // buffer can be read without locking the stream.
+    //
+
+    if (streamData->is->supportsReadAt() && !streamData->is->isMemoryMapped())
+    {
+        readPixelDataAt (streamData, ifd, minY, lineOffset, buffer, dataSize);
+        return;
+    }
+
+    //
+    // The stream may be shared with the other parts of a multi-part
+    // file, so it is locked only while the line buffer is read;
+    // uncompressing the data and storing the pixels in the frame
+    // buffer need only the lock on this part's own data.
+    //
+
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*streamData);
+#endif
+
     //
     // Seek to the start of the scan line in the file,
     // if necessary.
@@ -1396,7 +1465,7 @@ void
 ScanLineInputFile::setFrameBuffer (const FrameBuffer &frameBuffer)
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
 
     const ChannelList &channels = _data->header.channels();
@@ -1602,7 +1671,7 @@ const FrameBuffer &
 ScanLineInputFile::frameBuffer () const
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
     return _data->frameBuffer;
 }
@@ -1630,7 +1699,7 @@ ScanLineInputFile::readPixels (int scanLine1, int scanLine2)
     try
     {
 #if ILMTHREAD_THREADING_ENABLED
-        std::lock_guard<std::mutex> lock (*_streamData);
+        std::lock_guard<std::mutex> lock (*_data);
 #endif
         if (_data->slices.size() == 0)
             throw IEX_NAMESPACE::ArgExc (
@@ -1755,7 +1824,7 @@ ScanLineInputFile::rawPixelData (int firstScanLine,
     try
     {
 #if ILMTHREAD_THREADING_ENABLED
-        std::lock_guard<std::mutex> lock (*_streamData);
+        std::lock_guard<std::mutex> lock (*_data);
 #endif
 	if (firstScanLine < _data->minY || firstScanLine > _data->maxY)
 	{
@@ -1793,7 +1862,7 @@ void ScanLineInputFile::rawPixelDataToBuffer(int scanLine,
   try 
   {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
     if (scanLine < _data->minY || scanLine > _data->maxY) 
     {
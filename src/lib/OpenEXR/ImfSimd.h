@@ -10,6 +10,16 @@
 // Compile time SSE detection:
 //    IMF_HAVE_SSE2 - Defined if it's safe to compile SSE2 optimizations
 //    IMF_HAVE_SSE4_1 - Defined if it's safe to compile SSE4.1 optimizations
+//    IMF_HAVE_NEON - Defined if it's safe to compile NEON optimizations
+//    IMF_HAVE_NEON_AARCH64 - Defined if it's safe to compile the AArch64
+//                            NEON optimizations, which includes the
+//                            half <-> float conversions and table lookups
+//
+// Per function targets, for kernels that are only called after checking
+// CpuId at runtime:
+//    IMF_HAVE_AVX2_TARGET - Defined if functions marked IMF_TARGET_AVX2
+//                           may use AVX2 intrinsics, and functions marked
+//                           IMF_TARGET_AVX2_F16C may also use F16C
 //
 
 
@@ -43,6 +53,21 @@
     #define IMF_HAVE_F16C 1
 #endif
 
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(__e2k__)
+    #define IMF_HAVE_NEON 1
+#endif
+
+#if defined(IMF_HAVE_NEON) && defined(__aarch64__) && !defined(__ARM_BIG_ENDIAN)
+    #define IMF_HAVE_NEON_AARCH64 1
+#endif
+
+#if defined(IMF_HAVE_SSE2) && defined(__GNUC__) && defined(__x86_64__) && \
+    !defined(__e2k__)
+    #define IMF_HAVE_AVX2_TARGET 1
+    #define IMF_TARGET_AVX2 __attribute__ ((target ("avx2")))
+    #define IMF_TARGET_AVX2_F16C __attribute__ ((target ("avx2,f16c")))
+#endif
+
 extern "C"
 {
 #ifdef IMF_HAVE_SSE2
@@ -55,4 +80,12 @@ extern "C"
 #endif
 }
 
+#ifdef IMF_HAVE_AVX2_TARGET
+    #include <immintrin.h>
+#endif
+
+#ifdef IMF_HAVE_NEON
+    #include <arm_neon.h>
+#endif
+
 #endif
@@ -30,6 +30,7 @@
 #include "ImfEnvmapAttribute.h"
 #include "ImfDeepImageStateAttribute.h"
 #include "ImfFloatAttribute.h"
+#include "ImfIntAttribute.h"
 #include "ImfKeyCodeAttribute.h"
 #include "ImfMatrixAttribute.h"
 #include "ImfRationalAttribute.h"
@@ -353,6 +354,15 @@ IMF_STD_ATTRIBUTE_DEF
 
 IMF_STD_ATTRIBUTE_DEF (dwaCompressionLevel, DwaCompressionLevel, float)
 
+
+//
+// zipCompressionLevel -- sets the zlib compression level (0 to 9, or -1
+// for the zlib default) used when writing images compressed with the
+// ZIP, ZIPS or PXR24 method. Lower levels trade file size for speed.
+//
+
+IMF_STD_ATTRIBUTE_DEF (zipCompressionLevel, ZipCompressionLevel, int)
+
 //
 // ID Manifest
 //
@@ -6,13 +6,20 @@
 //-----------------------------------------------------------------------------
 //
 //	Low-level file input and output for OpenEXR
-//	based on C++ standard iostreams.
+//	based on C++ standard iostreams, and on POSIX
+//	file descriptors.
 //
 //-----------------------------------------------------------------------------
 
 #include <ImfStdIO.h>
 #include "Iex.h"
 #include <errno.h>
+#ifndef _WIN32
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/stat.h>
+# include <limits>
+#endif
 #ifdef _WIN32
 # define VC_EXTRALEAN
 # include <windows.h>
@@ -198,6 +205,87 @@ checkError (ostream &os)
     }
 }
 
+
+#ifndef _WIN32
+
+//
+// Use the 64-bit file interface where the C library has one, so that
+// files larger than 2 GB can be read even if off_t has only 32 bits.
+//
+
+#if defined __USE_LARGEFILE64
+typedef off64_t FileOffset;
+typedef struct stat64 FileStat;
+# define OPENEXR_PREAD ::pread64
+# define OPENEXR_FSTAT ::fstat64
+#else
+typedef off_t FileOffset;
+typedef struct stat FileStat;
+# define OPENEXR_PREAD ::pread
+# define OPENEXR_FSTAT ::fstat
+#endif
+
+
+int
+openForReading (const char fileName[])
+{
+    //
+    // Keep the file descriptor out of child processes
+    // started with fork() and exec().
+    //
+
+#ifdef O_CLOEXEC
+    return ::open (fileName, O_RDONLY | O_CLOEXEC);
+#else
+    return ::open (fileName, O_RDONLY);
+#endif
+}
+
+
+void
+positionalRead (int fd, uint64_t p, char c[/*n*/], int n)
+{
+    const uint64_t maxOffset = uint64_t (numeric_limits<FileOffset>::max());
+
+    if (p > maxOffset || uint64_t (n) > maxOffset - p)
+    {
+	THROW (IEX_NAMESPACE::InputExc, "Cannot read " << n << " bytes at "
+	       "file offset " << p << ", the offset is too large for "
+	       "this platform.");
+    }
+
+    //
+    // pread() may return fewer bytes than requested,
+    // so keep reading until all n bytes have arrived.
+    //
+
+    int done = 0;
+
+    while (done < n)
+    {
+	ssize_t r = OPENEXR_PREAD (fd, c + done, n - done,
+				   FileOffset (p + done));
+
+	if (r < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+
+	    IEX_NAMESPACE::throwErrnoExc();
+	}
+
+	if (r == 0)
+	{
+	    THROW (IEX_NAMESPACE::InputExc, "Early end of file: read " << done
+		   << " out of " << n << " requested bytes.");
+	}
+
+	done += int (r);
+    }
+}
+
+#endif
+
 } // namespace
 
 
@@ -321,6 +409,103 @@ StdISStream::str (const std::string &s)
 }
 
 
+#ifndef _WIN32
+
+PosixIFStream::PosixIFStream (const char fileName[]):
+    OPENEXR_IMF_INTERNAL_NAMESPACE::IStream (fileName),
+    _fd (openForReading (fileName)),
+    _closeFd (true),
+    _pos (0),
+    _size (0)
+{
+    if (_fd < 0)
+	IEX_NAMESPACE::throwErrnoExc();
+
+    init();
+}
+
+
+PosixIFStream::PosixIFStream (int fd, const char fileName[]):
+    OPENEXR_IMF_INTERNAL_NAMESPACE::IStream (fileName),
+    _fd (fd),
+    _closeFd (false),
+    _pos (0),
+    _size (0)
+{
+    init();
+}
+
+
+void
+PosixIFStream::init ()
+{
+    //
+    // With a 32-bit off_t and no 64-bit file interface, fstat()
+    // fails with EOVERFLOW for files larger than 2 GB.
+    //
+
+    FileStat st;
+
+    if (OPENEXR_FSTAT (_fd, &st) != 0)
+    {
+	int e = errno;
+
+	if (_closeFd)
+	    ::close (_fd);
+
+	IEX_NAMESPACE::throwErrnoExc ("%T.", e);
+    }
+
+    _size = uint64_t (st.st_size);
+}
+
+
+PosixIFStream::~PosixIFStream ()
+{
+    if (_closeFd)
+	::close (_fd);
+}
+
+
+bool
+PosixIFStream::read (char c[/*n*/], int n)
+{
+    positionalRead (_fd, _pos, c, n);
+    _pos += n;
+    return _pos < _size;
+}
+
+
+uint64_t
+PosixIFStream::tellg ()
+{
+    return _pos;
+}
+
+
+void
+PosixIFStream::seekg (uint64_t pos)
+{
+    _pos = pos;
+}
+
+
+bool
+PosixIFStream::supportsReadAt () const
+{
+    return true;
+}
+
+
+void
+PosixIFStream::readAt (uint64_t p, char c[/*n*/], int n)
+{
+    positionalRead (_fd, p, c, n);
+}
+
+#endif
+
+
 
 StdOFStream::StdOFStream (const char fileName[])
     : OPENEXR_IMF_INTERNAL_NAMESPACE::OStream (fileName)
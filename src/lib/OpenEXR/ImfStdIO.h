@@ -9,7 +9,8 @@
 //-----------------------------------------------------------------------------
 //
 //	Low-level file input and output for OpenEXR
-//	based on C++ standard iostreams.
+//	based on C++ standard iostreams, and on POSIX
+//	file descriptors.
 //
 //-----------------------------------------------------------------------------
 
@@ -99,6 +100,64 @@ class IMF_EXPORT_TYPE StdISStream: public OPENEXR_IMF_INTERNAL_NAMESPACE::IStrea
 };
 
 
+#ifndef _WIN32
+
+//-------------------------------------------------------------
+// class PosixIFStream -- an implementation of class
+// OPENEXR_IMF_INTERNAL_NAMESPACE::IStream based on a POSIX file
+// descriptor.  Every read is a positional read (pread()), so
+// threads that call readAt() never wait for each other.
+//
+// InputFile, TiledInputFile and MultiPartInputFile read files
+// that are opened by name through a PosixIFStream.
+//-------------------------------------------------------------
+
+class IMF_EXPORT_TYPE PosixIFStream: public OPENEXR_IMF_INTERNAL_NAMESPACE::IStream
+{
+  public:
+
+    //-------------------------------------------------------
+    // A constructor that opens the file with the given name.
+    // The destructor will close the file.
+    //-------------------------------------------------------
+
+    IMF_EXPORT PosixIFStream (const char fileName[]);
+
+
+    //---------------------------------------------------------
+    // A constructor that uses a file descriptor that has been
+    // opened by the caller.  The PosixIFStream's destructor
+    // will not close the file descriptor.
+    //---------------------------------------------------------
+
+    IMF_EXPORT PosixIFStream (int fd, const char fileName[]);
+
+
+    IMF_EXPORT virtual ~PosixIFStream ();
+    PosixIFStream (const PosixIFStream &) = delete;
+    PosixIFStream (PosixIFStream &&) = delete;
+    PosixIFStream &operator=(const PosixIFStream &) = delete;
+    PosixIFStream &operator=(PosixIFStream &&) = delete;
+
+    IMF_EXPORT virtual bool     read (char c[/*n*/], int n);
+    IMF_EXPORT virtual uint64_t tellg ();
+    IMF_EXPORT virtual void     seekg (uint64_t pos);
+    IMF_EXPORT virtual bool     supportsReadAt () const;
+    IMF_EXPORT virtual void     readAt (uint64_t p, char c[/*n*/], int n);
+
+  private:
+
+    void		init ();
+
+    int			_fd;
+    bool		_closeFd;
+    uint64_t		_pos;
+    uint64_t		_size;
+};
+
+#endif
+
+
 
 //-------------------------------------------
 // class StdOFStream -- an implementation of
@@ -9,6 +9,13 @@
 #include "OpenEXRConfig.h"
 #include "OpenEXRConfigInternal.h"
 
+#if defined(IMF_HAVE_NEON) && defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_ASIMD
+#define HWCAP_ASIMD (1 << 1)
+#endif
+#endif
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
 
 namespace {
@@ -24,6 +31,16 @@ namespace {
             : /* Clobber */);
     }
 
+    // Leaves with sub-leaves, i.e. the extended features in leaf 7
+    void cpuid(int n, int sub, int &eax, int &ebx, int &ecx, int &edx)
+    {
+        __asm__ __volatile__ (
+            "cpuid"
+            : /* Output  */ "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+            : /* Input   */ "a"(n), "c"(sub)
+            : /* Clobber */);
+    }
+
 #else // IMF_HAVE_SSE2 && __GNUC__ && !__e2k__
 
     // Helper functions for generic compiler - all disabled
@@ -32,6 +49,11 @@ namespace {
         eax = ebx = ecx = edx = 0;
     }
 
+    void cpuid(int n, int sub, int &eax, int &ebx, int &ecx, int &edx)
+    {
+        eax = ebx = ecx = edx = 0;
+    }
+
 #endif // IMF_HAVE_SSE2 && __GNUC__ && !__e2k__
 
 
@@ -64,7 +86,9 @@ CpuId::CpuId():
     sse4_1(false), 
     sse4_2(false), 
     avx(false), 
-    f16c(false)
+    avx2(false),
+    f16c(false),
+    neon(false)
 {
 #if defined(__e2k__) // e2k - MCST Elbrus 2000 architecture
     // Use IMF_HAVE definitions to determine e2k CPU features
@@ -120,8 +144,33 @@ CpuId::CpuId():
                 avx = f16c = false;
             }
         }
+
+        //
+        // AVX2 is in the extended features leaf, and needs the same
+        // OS support as AVX.
+        //
+
+        if (avx && max >= 7)
+        {
+            cpuid(7, 0, eax, ebx, ecx, edx);
+            avx2 = ( ebx & (1<< 5) );
+        }
     }
 #endif
+
+#if defined(IMF_HAVE_NEON)
+    //
+    // NEON is part of the base AArch64 instruction set, and elsewhere
+    // we were compiled to require it. Where the OS reports the
+    // hardware capabilities, ask anyway.
+    //
+
+#   if defined(__aarch64__) && defined(__linux__)
+        neon = ( getauxval (AT_HWCAP) & HWCAP_ASIMD ) != 0;
+#   else
+        neon = true;
+#   endif
+#endif
 }
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -100,7 +100,9 @@ class IMF_EXPORT_TYPE CpuId
         bool sse4_1;
         bool sse4_2;
         bool avx;
+        bool avx2;
         bool f16c;
+        bool neon;
 };
 
 
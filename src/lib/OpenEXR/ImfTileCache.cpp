@@ -0,0 +1,305 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+//-----------------------------------------------------------------------------
+//
+//	class TileCache
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfTileCache.h"
+#include "IlmThreadConfig.h"
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+#if ILMTHREAD_THREADING_ENABLED
+#include <mutex>
+#endif
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+using std::list;
+using std::pair;
+using std::shared_ptr;
+using std::unordered_map;
+
+
+namespace {
+
+struct TileKey
+{
+    const void *	file;
+    int			partNumber;
+    int			dx;
+    int			dy;
+    int			lx;
+    int			ly;
+
+    bool
+    operator == (const TileKey &other) const
+    {
+	return file == other.file && partNumber == other.partNumber &&
+	       dx == other.dx && dy == other.dy &&
+	       lx == other.lx && ly == other.ly;
+    }
+};
+
+
+struct TileKeyHash
+{
+    size_t
+    operator () (const TileKey &k) const
+    {
+	size_t h = std::hash<const void *> () (k.file);
+	int v[5] = {k.partNumber, k.dx, k.dy, k.lx, k.ly};
+
+	for (int i = 0; i < 5; ++i)
+	    h = h * 1000003 ^ std::hash<int> () (v[i]);
+
+	return h;
+    }
+};
+
+} // namespace
+
+
+//
+// The tiles are kept in a list, most recently used first, and
+// found through a hash table of iterators into the list.
+//
+
+struct TileCache::Data
+#if ILMTHREAD_THREADING_ENABLED
+    : public std::mutex
+#endif
+{
+    typedef pair<TileKey, shared_ptr<const DecodedTile> >	Entry;
+    typedef list<Entry>						EntryList;
+
+    EntryList		entries;
+    unordered_map<TileKey, EntryList::iterator, TileKeyHash> index;
+
+    size_t		maxBytes;
+    size_t		bytes;
+    uint64_t		hits;
+    uint64_t		misses;
+    uint64_t		evictions;
+
+    Data (size_t maxBytes);
+
+    void		remove (EntryList::iterator i);
+    void		evict (size_t limit);
+};
+
+
+TileCache::Data::Data (size_t maxBytes):
+    maxBytes (maxBytes),
+    bytes (0),
+    hits (0),
+    misses (0),
+    evictions (0)
+{
+    // empty
+}
+
+
+void
+TileCache::Data::remove (EntryList::iterator i)
+{
+    bytes -= i->second->pixels.size();
+    index.erase (i->first);
+    entries.erase (i);
+}
+
+
+void
+TileCache::Data::evict (size_t limit)
+{
+    //
+    // Remove the least recently used tiles until
+    // the cached pixel data take at most limit bytes.
+    //
+
+    while (bytes > limit && !entries.empty())
+    {
+	remove (--entries.end());
+	++evictions;
+    }
+}
+
+
+TileCache::TileCache (size_t maxBytes):
+    _data (new Data (maxBytes))
+{
+    // empty
+}
+
+
+TileCache::~TileCache ()
+{
+    delete _data;
+}
+
+
+void
+TileCache::setMaxBytes (size_t maxBytes)
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    _data->maxBytes = maxBytes;
+    _data->evict (maxBytes);
+}
+
+
+size_t
+TileCache::maxBytes () const
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    return _data->maxBytes;
+}
+
+
+void
+TileCache::clear ()
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    _data->index.clear();
+    _data->entries.clear();
+    _data->bytes = 0;
+}
+
+
+TileCache::Statistics
+TileCache::statistics () const
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    Statistics s;
+    s.hits = _data->hits;
+    s.misses = _data->misses;
+    s.evictions = _data->evictions;
+    s.numTiles = _data->entries.size();
+    s.bytes = _data->bytes;
+    return s;
+}
+
+
+void
+TileCache::resetStatistics ()
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    _data->hits = 0;
+    _data->misses = 0;
+    _data->evictions = 0;
+}
+
+
+shared_ptr<const TileCache::DecodedTile>
+TileCache::find (const void *file,
+		 int partNumber,
+		 int dx, int dy,
+		 int lx, int ly)
+{
+    TileKey key = {file, partNumber, dx, dy, lx, ly};
+
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    auto i = _data->index.find (key);
+
+    if (i == _data->index.end())
+    {
+	++_data->misses;
+	return shared_ptr<const DecodedTile> ();
+    }
+
+    //
+    // Move the tile to the front of the list.
+    //
+
+    _data->entries.splice (_data->entries.begin(), _data->entries, i->second);
+    ++_data->hits;
+    return i->second->second;
+}
+
+
+void
+TileCache::insert (const void *file,
+		   int partNumber,
+		   int dx, int dy,
+		   int lx, int ly,
+		   const char *pixels,
+		   size_t size,
+		   bool xdr)
+{
+    TileKey key = {file, partNumber, dx, dy, lx, ly};
+
+    //
+    // Copy the pixels before taking the lock, so
+    // that other readers are not held up by it.
+    //
+
+    {
+#if ILMTHREAD_THREADING_ENABLED
+	std::lock_guard<std::mutex> lock (*_data);
+#endif
+	if (size > _data->maxBytes || _data->index.count (key))
+	    return;
+    }
+
+    shared_ptr<DecodedTile> tile = std::make_shared<DecodedTile> ();
+    tile->pixels.assign (pixels, pixels + size);
+    tile->xdr = xdr;
+
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+
+    //
+    // The budget may have changed, or another thread may
+    // have cached the same tile, while we were copying.
+    //
+
+    if (size > _data->maxBytes || _data->index.count (key))
+	return;
+
+    _data->evict (_data->maxBytes - size);
+    _data->entries.push_front (Data::Entry (key, tile));
+    _data->index[key] = _data->entries.begin();
+    _data->bytes += size;
+}
+
+
+void
+TileCache::erase (const void *file, int partNumber)
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    for (auto i = _data->entries.begin(); i != _data->entries.end();)
+    {
+	auto next = i;
+	++next;
+
+	if (i->first.file == file && i->first.partNumber == partNumber)
+	    _data->remove (i);
+
+	i = next;
+    }
+}
+
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
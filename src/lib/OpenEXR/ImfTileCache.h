@@ -0,0 +1,158 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef INCLUDED_IMF_TILE_CACHE_H
+#define INCLUDED_IMF_TILE_CACHE_H
+
+//-----------------------------------------------------------------------------
+//
+//	class TileCache -- a thread-safe cache of decoded tiles, with
+//	a limit on the memory it uses, which can be shared by any number
+//	of TiledInputFiles and TiledInputParts.
+//
+//	When a file has a tile cache (see TiledInputFile::setTileCache()),
+//	readTile() and readTiles() keep the uncompressed pixel data of
+//	every tile they read in the cache, keyed by file, part, level
+//	and tile coordinates.  Reading a tile that is in the cache then
+//	only converts the cached pixels into the frame buffer; the tile
+//	is neither read from the file nor uncompressed again.  The least
+//	recently used tiles are evicted to keep the total size of the
+//	cached pixel data within the cache's budget.
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfForward.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+
+class IMF_EXPORT_TYPE TileCache
+{
+  public:
+
+    //---------------------------------------------------------------
+    // Constructor -- maxBytes is the budget for the pixel data of all
+    // cached tiles.  Tiles larger than the budget are never cached.
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    TileCache (size_t maxBytes);
+
+    //-------------------------------------------------------------
+    // Destructor -- the cache must not be destroyed while any file
+    // still uses it.
+    //-------------------------------------------------------------
+
+    IMF_EXPORT
+    ~TileCache ();
+
+    TileCache (const TileCache& other) = delete;
+    TileCache& operator = (const TileCache& other) = delete;
+    TileCache (TileCache&& other) = delete;
+    TileCache& operator = (TileCache&& other) = delete;
+
+
+    //--------------------------------------------------------------
+    // Change the budget; lowering it evicts the least recently used
+    // tiles until the cached data fits.
+    //--------------------------------------------------------------
+
+    IMF_EXPORT
+    void		setMaxBytes (size_t maxBytes);
+
+    IMF_EXPORT
+    size_t		maxBytes () const;
+
+
+    //--------------------------------
+    // Remove all tiles from the cache
+    //--------------------------------
+
+    IMF_EXPORT
+    void		clear ();
+
+
+    //----------------------------------------------------------------
+    // Statistics:
+    //
+    // hits and misses count the tiles that readTile() and readTiles()
+    // found and did not find in the cache, evictions counts the tiles
+    // removed to stay within the budget.  numTiles and bytes describe
+    // the current contents of the cache.  resetStatistics() sets the
+    // hit, miss and eviction counts back to zero.
+    //----------------------------------------------------------------
+
+    struct Statistics
+    {
+	uint64_t	hits;
+	uint64_t	misses;
+	uint64_t	evictions;
+	size_t		numTiles;
+	size_t		bytes;
+    };
+
+    IMF_EXPORT
+    Statistics		statistics () const;
+
+    IMF_EXPORT
+    void		resetStatistics ();
+
+
+    //----------------------------------------------------------------
+    // The pixel data of a tile, in the layout it has after the tile's
+    // compressor has uncompressed it, and whether that data is in Xdr
+    // or in the machine's native format.  Entries are shared, so that
+    // evicting a tile does not pull it out from under a concurrent
+    // reader.
+    //----------------------------------------------------------------
+
+    struct DecodedTile
+    {
+	std::vector<char>	pixels;
+	bool			xdr;
+    };
+
+
+    //---------------------------------------------------------------
+    // Internal -- used by TiledInputFile to look up, add and remove
+    // tiles.  A file is identified by an address that is unique while
+    // the file is open, and the file erases all of its tiles from the
+    // cache before it goes away.
+    //---------------------------------------------------------------
+
+    IMF_EXPORT
+    std::shared_ptr<const DecodedTile>	find (const void *file,
+					      int partNumber,
+					      int dx, int dy,
+					      int lx, int ly);
+
+    IMF_EXPORT
+    void		insert (const void *file,
+				int partNumber,
+				int dx, int dy,
+				int lx, int ly,
+				const char *pixels,
+				size_t size,
+				bool xdr);
+
+    IMF_EXPORT
+    void		erase (const void *file, int partNumber);
+
+    struct IMF_HIDDEN Data;
+
+  private:
+
+    Data *		_data;
+};
+
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
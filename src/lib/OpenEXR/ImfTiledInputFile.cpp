@@ -23,6 +23,7 @@
 #include "ImfConvert.h"
 #include "ImfVersion.h"
 #include "ImfTileOffsets.h"
+#include "ImfTileCache.h"
 #include "ImfThreading.h"
 #include "ImfPartType.h"
 #include "ImfMultiPartInputFile.h"
@@ -117,6 +118,10 @@ struct TileBuffer
     bool		hasException;
     string		exception;
 
+    std::shared_ptr<const TileCache::DecodedTile> cachedTile;
+					// the tile's pixels, if they
+					// came from the tile cache
+
      TileBuffer (Compressor * const comp);
     ~TileBuffer ();
 
@@ -216,6 +221,9 @@ struct TiledInputFile::Data
 
     bool            memoryMapped;                   // if the stream is memory mapped
 
+    TileCache *     tileCache;                      // shared cache of decoded
+                                                    // tiles, or 0
+
     InputStreamMutex * _streamData;
     bool                _deleteStream;
 
@@ -246,6 +254,7 @@ TiledInputFile::Data::Data (int numThreads):
     numThreads(numThreads),
     multiPartFile(nullptr),
     memoryMapped(false),
+    tileCache(nullptr),
     _streamData(NULL),
     _deleteStream(false)
 {
@@ -332,6 +341,84 @@ TiledInputFile::Data::validateStreamSize()
 
 namespace {
 
+void
+checkTileHeader (const TiledInputFile::Data *ifd,
+                 int dx, int dy,
+                 int lx, int ly,
+                 int tileXCoord, int tileYCoord,
+                 int levelX, int levelY,
+                 int dataSize)
+{
+    //
+    // Verify that the tile coordinates, the level number
+    // and the size of a tile block's header are correct.
+    //
+
+    if (tileXCoord != dx)
+        throw IEX_NAMESPACE::InputExc ("Unexpected tile x coordinate.");
+
+    if (tileYCoord != dy)
+        throw IEX_NAMESPACE::InputExc ("Unexpected tile y coordinate.");
+
+    if (levelX != lx)
+        throw IEX_NAMESPACE::InputExc ("Unexpected tile x level number coordinate.");
+
+    if (levelY != ly)
+        throw IEX_NAMESPACE::InputExc ("Unexpected tile y level number coordinate.");
+
+    if (dataSize < 0 || dataSize > static_cast<int>(ifd->tileBufferSize) )
+        throw IEX_NAMESPACE::InputExc ("Unexpected tile block length.");
+}
+
+
+void
+readTileDataAt (InputStreamMutex *streamData,
+                TiledInputFile::Data *ifd,
+                int dx, int dy,
+                int lx, int ly,
+                uint64_t tileOffset,
+                char *buffer,
+                int &dataSize)
+{
+    //
+    // Read a single tile block with positional reads, which
+    // need no lock on the stream: first the tile's header,
+    // then the pixel data that follow it.
+    //
+
+    char header[6 * sizeof (int32_t)];
+    int headerSize = (isMultiPart (ifd->version)? 6: 5) * Xdr::size<int>();
+
+    streamData->is->readAt (tileOffset, header, headerSize);
+
+    const char *readPtr = header;
+    int tileXCoord, tileYCoord, levelX, levelY;
+
+    if (isMultiPart (ifd->version))
+    {
+        int partNumber;
+        Xdr::read <CharPtrIO> (readPtr, partNumber);
+
+        if (partNumber != ifd->partNumber)
+        {
+            THROW (IEX_NAMESPACE::ArgExc, "Unexpected part number " << partNumber
+                   << ", should be " << ifd->partNumber << ".");
+        }
+    }
+
+    Xdr::read <CharPtrIO> (readPtr, tileXCoord);
+    Xdr::read <CharPtrIO> (readPtr, tileYCoord);
+    Xdr::read <CharPtrIO> (readPtr, levelX);
+    Xdr::read <CharPtrIO> (readPtr, levelY);
+    Xdr::read <CharPtrIO> (readPtr, dataSize);
+
+    checkTileHeader (ifd, dx, dy, lx, ly,
+                     tileXCoord, tileYCoord, levelX, levelY, dataSize);
+
+    streamData->is->readAt (tileOffset + headerSize, buffer, dataSize);
+}
+
+
 void
 readTileData (InputStreamMutex *streamData,
               TiledInputFile::Data *ifd,
@@ -360,6 +447,29 @@ readTileData (InputStreamMutex *streamData,
 			      lx << ", " << ly << ") is missing.");
     }
 
+    //
+    // If the stream supports positional reads, the tile
+    // can be read without locking the stream.
+    //
+
+    if (streamData->is->supportsReadAt() && !streamData->is->isMemoryMapped())
+    {
+        readTileDataAt (streamData, ifd, dx, dy, lx, ly,
+                        tileOffset, buffer, dataSize);
+        return;
+    }
+
+    //
+    // The stream may be shared with the other parts of a multi-part
+    // file, so it is locked only while the tile is read; uncompressing
+    // the tile and storing the pixels in the frame buffer need only
+    // the lock on this part's own data.
+    //
+
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*streamData);
+#endif
+
 
     //
     // In a multi-part file, the next chunk does not need to
@@ -407,20 +517,8 @@ readTileData (InputStreamMutex *streamData,
     OPENEXR_IMF_INTERNAL_NAMESPACE::Xdr::read <OPENEXR_IMF_INTERNAL_NAMESPACE::StreamIO> (*streamData->is, levelY);
     OPENEXR_IMF_INTERNAL_NAMESPACE::Xdr::read <OPENEXR_IMF_INTERNAL_NAMESPACE::StreamIO> (*streamData->is, dataSize);
 
-    if (tileXCoord != dx)
-        throw IEX_NAMESPACE::InputExc ("Unexpected tile x coordinate.");
-
-    if (tileYCoord != dy)
-        throw IEX_NAMESPACE::InputExc ("Unexpected tile y coordinate.");
-
-    if (levelX != lx)
-        throw IEX_NAMESPACE::InputExc ("Unexpected tile x level number coordinate.");
-
-    if (levelY != ly)
-        throw IEX_NAMESPACE::InputExc ("Unexpected tile y level number coordinate.");
-
-    if (dataSize < 0 || dataSize > static_cast<int>(ifd->tileBufferSize) )
-        throw IEX_NAMESPACE::InputExc ("Unexpected tile block length.");
+    checkTileHeader (ifd, dx, dy, lx, ly,
+                     tileXCoord, tileYCoord, levelX, levelY, dataSize);
 
     //
     // Read the pixel data.
@@ -532,9 +630,11 @@ TileBufferTask::TileBufferTask
 TileBufferTask::~TileBufferTask ()
 {
     //
-    // Signal that the tile buffer is now free
+    // Release the cached tile, if any, and signal
+    // that the tile buffer is now free
     //
 
+    _tileBuffer->cachedTile.reset();
     _tileBuffer->post ();
 }
 
@@ -569,7 +669,15 @@ TileBufferTask::execute ()
         // Uncompress the data, if necessary
         //
     
-        if (_tileBuffer->compressor && _tileBuffer->dataSize < sizeOfTile)
+        if (_tileBuffer->cachedTile)
+        {
+            const TileCache::DecodedTile &tile = *_tileBuffer->cachedTile;
+
+            _tileBuffer->format = tile.xdr? Compressor::XDR: Compressor::NATIVE;
+            _tileBuffer->uncompressedData = tile.pixels.data();
+            _tileBuffer->dataSize = static_cast<int> (tile.pixels.size());
+        }
+        else if (_tileBuffer->compressor && _tileBuffer->dataSize < sizeOfTile)
         {
             _tileBuffer->format = _tileBuffer->compressor->format();
 
@@ -587,6 +695,20 @@ TileBufferTask::execute ()
             _tileBuffer->format = Compressor::XDR;
             _tileBuffer->uncompressedData = _tileBuffer->buffer;
         }
+
+        //
+        // Keep the uncompressed pixels in the tile cache, if any.
+        //
+
+        if (_ifd->tileCache && !_tileBuffer->cachedTile)
+        {
+            _ifd->tileCache->insert (_ifd->_streamData, _ifd->partNumber,
+                                     _tileBuffer->dx, _tileBuffer->dy,
+                                     _tileBuffer->lx, _tileBuffer->ly,
+                                     _tileBuffer->uncompressedData,
+                                     _tileBuffer->dataSize,
+                                     _tileBuffer->format == Compressor::XDR);
+        }
     
         //
         // Convert the tile of pixel data back from the machine-independent
@@ -708,9 +830,23 @@ newTileBufferTask
 
 	tileBuffer->uncompressedData = 0;
 
-	readTileData (streamData, ifd, dx, dy, lx, ly,
-		      tileBuffer->buffer,
-		      tileBuffer->dataSize);
+	//
+	// If the tile is in the tile cache, the task only
+	// has to copy the cached pixels into the frame buffer.
+	//
+
+	if (ifd->tileCache)
+	{
+	    tileBuffer->cachedTile = ifd->tileCache->find
+		(streamData, ifd->partNumber, dx, dy, lx, ly);
+	}
+
+	if (!tileBuffer->cachedTile)
+	{
+	    readTileData (streamData, ifd, dx, dy, lx, ly,
+			  tileBuffer->buffer,
+			  tileBuffer->dataSize);
+	}
     }
     catch (...)
     {
@@ -720,6 +856,7 @@ newTileBufferTask
 	// re-throw the exception.
 	//
 
+	tileBuffer->cachedTile.reset();
 	tileBuffer->post();
 	throw;
     }
@@ -748,7 +885,11 @@ TiledInputFile::TiledInputFile (const char fileName[], int numThreads):
     {
         try
         {
+#ifndef _WIN32
+            is = new PosixIFStream (fileName);
+#else
             is = new StdIFStream (fileName);
+#endif
             readMagicNumberAndVersionField(*is, _data->version);
 
             //
@@ -1080,6 +1221,9 @@ TiledInputFile::initialize ()
 
 TiledInputFile::~TiledInputFile ()
 {
+    if (_data->tileCache)
+        _data->tileCache->erase (_data->_streamData, _data->partNumber);
+
     if (!_data->memoryMapped)
         for (size_t i = 0; i < _data->tileBuffers.size(); i++)
             delete [] _data->tileBuffers[i]->buffer;
@@ -1119,7 +1263,7 @@ void
 TiledInputFile::setFrameBuffer (const FrameBuffer &frameBuffer)
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_data->_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
     //
     // Set the frame buffer
@@ -1239,7 +1383,7 @@ const FrameBuffer &
 TiledInputFile::frameBuffer () const
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_data->_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
     return _data->frameBuffer;
 }
@@ -1252,6 +1396,33 @@ TiledInputFile::isComplete () const
 }
 
 
+void
+TiledInputFile::setTileCache (TileCache *cache)
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+
+    if (cache == _data->tileCache)
+        return;
+
+    if (_data->tileCache)
+        _data->tileCache->erase (_data->_streamData, _data->partNumber);
+
+    _data->tileCache = cache;
+}
+
+
+TileCache *
+TiledInputFile::tileCache () const
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    return _data->tileCache;
+}
+
+
 void
 TiledInputFile::readTiles (int dx1, int dx2, int dy1, int dy2, int lx, int ly)
 {
@@ -1262,7 +1433,7 @@ TiledInputFile::readTiles (int dx1, int dx2, int dy1, int dy2, int lx, int ly)
     try
     {
 #if ILMTHREAD_THREADING_ENABLED
-        std::lock_guard<std::mutex> lock (*_data->_streamData);
+        std::lock_guard<std::mutex> lock (*_data);
 #endif
         if (_data->slices.size() == 0)
             throw IEX_NAMESPACE::ArgExc ("No frame buffer specified "
@@ -1399,7 +1570,7 @@ TiledInputFile::rawTileData (int &dx, int &dy,
     try
     {
 #if ILMTHREAD_THREADING_ENABLED
-        std::lock_guard<std::mutex> lock (*_data->_streamData);
+        std::lock_guard<std::mutex> lock (*_data);
 #endif
         if (!isValidTile (dx, dy, lx, ly))
             throw IEX_NAMESPACE::ArgExc ("Tried to read a tile outside "
@@ -1415,13 +1586,19 @@ TiledInputFile::rawTileData (int &dx, int &dy,
         int old_dy=dy;
         int old_lx=lx;
         int old_ly=ly;
-        if(isMultiPart(version()))
+
         {
-            _data->_streamData->is->seekg(_data->tileOffsets(dx,dy,lx,ly));
+#if ILMTHREAD_THREADING_ENABLED
+            std::lock_guard<std::mutex> streamLock (*_data->_streamData);
+#endif
+            if(isMultiPart(version()))
+            {
+                _data->_streamData->is->seekg(_data->tileOffsets(dx,dy,lx,ly));
+            }
+            readNextTileData (_data->_streamData, _data, dx, dy, lx, ly,
+                              tileBuffer->buffer,
+                              pixelDataSize);
         }
-        readNextTileData (_data->_streamData, _data, dx, dy, lx, ly,
-			  tileBuffer->buffer,
-                          pixelDataSize);
 
         if ( !isValidLevel(lx,ly) || !isValidTile (dx, dy, lx, ly) )
             throw IEX_NAMESPACE::ArgExc ("File contains an invalid tile");
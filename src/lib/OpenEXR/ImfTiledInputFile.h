@@ -128,6 +128,28 @@ class IMF_EXPORT_TYPE TiledInputFile : public GenericInputFile
     bool		isComplete () const;
 
 
+    //------------------------------------------------------------
+    // Tile cache:
+    //
+    // setTileCache(c) makes readTile() and readTiles() keep the
+    // decoded pixel data of the tiles they read in TileCache c,
+    // and take tiles that are already in c from there, instead
+    // of reading and uncompressing them again.  One cache can be
+    // shared by any number of files and threads.  The cache must
+    // outlive the file; the file's tiles are removed from the
+    // cache when the file is destroyed, or when a different cache
+    // is set.  setTileCache(0) turns caching off.
+    //
+    // tileCache() returns the current tile cache, or 0.
+    //------------------------------------------------------------
+
+    IMF_EXPORT
+    void		setTileCache (TileCache *cache);
+
+    IMF_EXPORT
+    TileCache *		tileCache () const;
+
+
     //--------------------------------------------------
     // Utility functions:
     //--------------------------------------------------
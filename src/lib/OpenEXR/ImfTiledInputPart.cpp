@@ -51,6 +51,18 @@ TiledInputPart::isComplete () const
     return file->isComplete();
 }
 
+void
+TiledInputPart::setTileCache (TileCache *cache)
+{
+    file->setTileCache (cache);
+}
+
+TileCache *
+TiledInputPart::tileCache () const
+{
+    return file->tileCache();
+}
+
 unsigned int
 TiledInputPart::tileXSize () const
 {
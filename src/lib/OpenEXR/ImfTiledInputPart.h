@@ -38,6 +38,10 @@ class IMF_EXPORT_TYPE TiledInputPart
         IMF_EXPORT
         bool                isComplete () const;
         IMF_EXPORT
+        void                setTileCache (TileCache *cache);
+        IMF_EXPORT
+        TileCache *         tileCache () const;
+        IMF_EXPORT
         unsigned int        tileXSize () const;
         IMF_EXPORT
         unsigned int        tileYSize () const;
@@ -34,6 +34,7 @@
 #include "IlmThreadSemaphore.h"
 #include "ImfOutputStreamMutex.h"
 #include "ImfOutputPartData.h"
+#include "ImfWriteBehindQueue.h"
 #include "Iex.h"
 #include <string>
 #include <vector>
@@ -215,6 +216,9 @@ TileBuffer::~TileBuffer ()
 
 
 struct TiledOutputFile::Data
+#if ILMTHREAD_THREADING_ENABLED
+    : public std::mutex
+#endif
 {
     Header		header;			// the image header
     int			version;		// file format version
@@ -253,6 +257,9 @@ struct TiledOutputFile::Data
 
     int                 partNumber;             // the output part number
 
+    WriteBehindQueue    writeBehind;            // compressed tiles not
+                                                // yet in the file
+
      Data (int numThreads);
     ~Data ();
     
@@ -430,6 +437,14 @@ writeTileData (OutputStreamMutex *streamData,
     // to keep track of the current writing position the file,
     // without calling tellp() (tellp() can be fairly expensive).
     //
+    // The stream may be shared with the other parts of a multi-part
+    // file, and with this part's write-behind task, so it is locked
+    // only while the block is written.
+    //
+
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*streamData);
+#endif
 
     uint64_t currentPosition = streamData->currentPosition;
     streamData->currentPosition = 0;
@@ -476,6 +491,85 @@ writeTileData (OutputStreamMutex *streamData,
 
 
 
+//
+// A copy of a compressed tile, waiting in the
+// write-behind queue to be stored in the file.
+//
+
+struct TileChunk: public WriteBehindQueue::Chunk
+{
+    OutputStreamMutex *		streamData;
+    TiledOutputFile::Data *	ofd;
+    int				dx;
+    int				dy;
+    int				lx;
+    int				ly;
+
+    TileChunk (OutputStreamMutex *streamData,
+	       TiledOutputFile::Data *ofd,
+	       int dx, int dy,
+	       int lx, int ly,
+	       const char pixelData[],
+	       int pixelDataSize)
+    :
+	streamData (streamData),
+	ofd (ofd),
+	dx (dx), dy (dy),
+	lx (lx), ly (ly)
+    {
+	data.assign (pixelData, pixelData + pixelDataSize);
+    }
+
+    virtual void
+    write ()
+    {
+	writeTileData (streamData, ofd, dx, dy, lx, ly,
+		       data.data(), int (data.size()));
+    }
+};
+
+
+//
+// The offset of a tile that has been queued, but not yet written,
+// so that attempts to write the tile again are detected.
+//
+
+const uint64_t QUEUED_TILE_OFFSET = ~uint64_t (0);
+
+
+void
+storeTile (OutputStreamMutex *streamData,
+	   TiledOutputFile::Data *ofd,
+	   int dx, int dy,
+	   int lx, int ly,
+	   const char pixelData[],
+	   int pixelDataSize)
+{
+    //
+    // Store a compressed tile in the file, or if write-behind is
+    // on, queue a copy of it, so that the tile buffer can be reused
+    // before the data are in the file.
+    //
+
+    if (ofd->writeBehind.maxBytes() == 0)
+    {
+	writeTileData (streamData, ofd, dx, dy, lx, ly,
+		       pixelData, pixelDataSize);
+	return;
+    }
+
+    {
+#if ILMTHREAD_THREADING_ENABLED
+	std::lock_guard<std::mutex> lock (*streamData);
+#endif
+	ofd->tileOffsets (dx, dy, lx, ly) = QUEUED_TILE_OFFSET;
+    }
+
+    ofd->writeBehind.push (new TileChunk (streamData, ofd, dx, dy, lx, ly,
+					  pixelData, pixelDataSize));
+}
+
+
 void
 bufferedTileWrite (OutputStreamMutex *streamData,
                    TiledOutputFile::Data *ofd,
@@ -485,15 +579,22 @@ bufferedTileWrite (OutputStreamMutex *streamData,
                    int pixelDataSize)
 {
     //
-    // Check if a tile with coordinates (dx,dy,lx,ly) has already been written.
+    // Check if a tile with coordinates (dx,dy,lx,ly) has already been
+    // written or queued.  The write-behind task sets the offsets of the
+    // tiles that it writes while holding the lock on the stream.
     //
 
-    if (ofd->tileOffsets (dx, dy, lx, ly))
     {
-	THROW (IEX_NAMESPACE::ArgExc,
-	       "Attempt to write tile "
-	       "(" << dx << ", " << dy << ", " << lx << ", " << ly << ") "
-	       "more than once.");
+#if ILMTHREAD_THREADING_ENABLED
+	std::lock_guard<std::mutex> lock (*streamData);
+#endif
+	if (ofd->tileOffsets (dx, dy, lx, ly))
+	{
+	    THROW (IEX_NAMESPACE::ArgExc,
+		   "Attempt to write tile "
+		   "(" << dx << ", " << dy << ", " << lx << ", " << ly << ") "
+		   "more than once.");
+	}
     }
 
     //
@@ -502,7 +603,7 @@ bufferedTileWrite (OutputStreamMutex *streamData,
     
     if (ofd->lineOrder == RANDOM_Y)
     {
-        writeTileData (streamData, ofd, dx, dy, lx, ly, pixelData, pixelDataSize);
+        storeTile (streamData, ofd, dx, dy, lx, ly, pixelData, pixelDataSize);
         return;
     }
     
@@ -531,7 +632,7 @@ bufferedTileWrite (OutputStreamMutex *streamData,
     
     if (ofd->nextTileToWrite == currentTile)
     {
-        writeTileData (streamData, ofd, dx, dy, lx, ly, pixelData, pixelDataSize);
+        storeTile (streamData, ofd, dx, dy, lx, ly, pixelData, pixelDataSize);
         ofd->nextTileToWrite = ofd->nextTileCoord (ofd->nextTileToWrite);
 
         TileMap::iterator i = ofd->tileMap.find (ofd->nextTileToWrite);
@@ -547,12 +648,12 @@ bufferedTileWrite (OutputStreamMutex *streamData,
             // Write the tile, and then delete the tile's buffered data
             //
 
-            writeTileData (streamData,
-                           ofd,
-			   i->first.dx, i->first.dy,
-			   i->first.lx, i->first.ly,
-			   i->second->pixelData,
-			   i->second->pixelDataSize);
+            storeTile (streamData,
+                       ofd,
+                       i->first.dx, i->first.dy,
+                       i->first.lx, i->first.ly,
+                       i->second->pixelData,
+                       i->second->pixelDataSize);
 
             delete i->second;
             ofd->tileMap.erase (i);
@@ -1049,6 +1150,17 @@ TiledOutputFile::~TiledOutputFile ()
 {
     if (_data)
     {
+        try
+        {
+            _data->writeBehind.flush();
+        }
+        catch (...) //NOSONAR - suppress vulnerability reports from SonarCloud.
+        {
+            //
+            // We cannot safely throw any exceptions from here.
+            //
+        }
+
         {
 #if ILMTHREAD_THREADING_ENABLED
             std::lock_guard<std::mutex> lock(*_streamData);
@@ -1108,7 +1220,7 @@ void
 TiledOutputFile::setFrameBuffer (const FrameBuffer &frameBuffer)
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
     //
     // Check if the new frame buffer descriptor
@@ -1191,7 +1303,7 @@ const FrameBuffer &
 TiledOutputFile::frameBuffer () const
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
     return _data->frameBuffer;
 }
@@ -1204,7 +1316,7 @@ TiledOutputFile::writeTiles (int dx1, int dx2, int dy1, int dy2,
     try
     {
 #if ILMTHREAD_THREADING_ENABLED
-        std::lock_guard<std::mutex> lock (*_streamData);
+        std::lock_guard<std::mutex> lock (*_data);
 #endif
         if (_data->slices.size() == 0)
 	    throw IEX_NAMESPACE::ArgExc ("No frame buffer specified "
@@ -1295,12 +1407,23 @@ TiledOutputFile::writeTiles (int dx1, int dx2, int dy1, int dy2,
                 writeBuffer->wait();
     
 		//
-                // Write the tilebuffer
+                // Write the tilebuffer.  If that fails, release the
+		// tile buffer anyway, so that a later call to writeTiles()
+		// reports the error instead of waiting for the buffer.
 		//
 
-                bufferedTileWrite (_streamData, _data, dxWrite, dyWrite, lx, ly,
-                                   writeBuffer->dataPtr,
-                                   writeBuffer->dataSize);
+                try
+                {
+                    bufferedTileWrite (_streamData, _data, dxWrite, dyWrite,
+                                       lx, ly,
+                                       writeBuffer->dataPtr,
+                                       writeBuffer->dataSize);
+                }
+                catch (...)
+                {
+                    writeBuffer->post();
+                    throw;
+                }
                 
 		//
                 // Release the lock on nextWriteBuffer
@@ -1412,12 +1535,60 @@ TiledOutputFile::writeTile (int dx, int dy, int l)
 }
 
 
+void
+TiledOutputFile::setWriteBehind (size_t maxBytes)
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    if (maxBytes == 0)
+        _data->writeBehind.flush();
+
+    _data->writeBehind.setMaxBytes (maxBytes);
+}
+
+
+size_t
+TiledOutputFile::writeBehind () const
+{
+    return _data->writeBehind.maxBytes();
+}
+
+
+void
+TiledOutputFile::flush ()
+{
+    try
+    {
+#if ILMTHREAD_THREADING_ENABLED
+        std::lock_guard<std::mutex> lock (*_data);
+#endif
+        _data->writeBehind.flush();
+    }
+    catch (IEX_NAMESPACE::BaseExc &e)
+    {
+        REPLACE_EXC (e, "Failed to write pixel data to image "
+                     "file \"" << fileName() << "\". " << e.what());
+        throw;
+    }
+}
+
+
+size_t
+TiledOutputFile::pendingWriteBytes () const
+{
+    return _data->writeBehind.pendingBytes();
+}
+
+
 void	
 TiledOutputFile::copyPixels (TiledInputFile &in)
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
+    _data->writeBehind.flush();
+
     //
     // Check if this file's and and the InputFile's
     // headers are compatible.
@@ -1772,7 +1943,7 @@ void
 TiledOutputFile::updatePreviewImage (const PreviewRgba newPixels[])
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
 #endif
     if (_data->previewPosition <= 0)
 	THROW (IEX_NAMESPACE::LogicExc, "Cannot update preview image pixels. "
@@ -1799,6 +1970,9 @@ TiledOutputFile::updatePreviewImage (const PreviewRgba newPixels[])
     // preview image, and jump back to the saved file position.
     //
 
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> streamLock (*_streamData);
+#endif
     uint64_t savedPosition = _streamData->os->tellp();
 
     try
@@ -1825,7 +1999,12 @@ TiledOutputFile::breakTile
      char c)
 {
 #if ILMTHREAD_THREADING_ENABLED
-    std::lock_guard<std::mutex> lock (*_streamData);
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    _data->writeBehind.flush();
+
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> streamLock (*_streamData);
 #endif
     uint64_t position = _data->tileOffsets (dx, dy, lx, ly);
 
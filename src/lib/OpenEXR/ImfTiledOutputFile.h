@@ -386,6 +386,47 @@ class IMF_EXPORT_TYPE TiledOutputFile : public GenericOutputFile
                                     int l = 0);
 
 
+    //------------------------------------------------------------------
+    // Write-behind:
+    //
+    // By default, writeTile() and writeTiles() store the compressed
+    // tiles in the file before they return.  After setWriteBehind(n)
+    // with n > 0, they return as soon as the tiles have been compressed;
+    // the compressed data are queued, and a thread pool task writes them
+    // to the file while the caller produces the next tiles.  At most
+    // n bytes of compressed data are queued at any time; if the queue
+    // is full, writeTiles() waits until enough data have been written.
+    // setWriteBehind(0) waits until the queue is empty and turns
+    // write-behind off.
+    //
+    // writeBehind() returns the current limit, 0 if write-behind is off.
+    //
+    // flush() waits until all queued data have been written.  If
+    // writing any of the queued data failed, flush() throws an
+    // IEX_NAMESPACE::IoExc; so does every subsequent call to
+    // writeTile(), writeTiles() or flush().
+    //
+    // pendingWriteBytes() returns the number of bytes that have been
+    // queued, but not yet written.  Tiles that are held back because
+    // the file's line order requires them to be stored after tiles
+    // that have not been written yet are not counted.
+    //
+    // The destructor flushes the queue.
+    //------------------------------------------------------------------
+
+    IMF_EXPORT
+    void		setWriteBehind (size_t maxBytes);
+
+    IMF_EXPORT
+    size_t		writeBehind () const;
+
+    IMF_EXPORT
+    void		flush ();
+
+    IMF_EXPORT
+    size_t		pendingWriteBytes () const;
+
+
     //------------------------------------------------------------------
     // Shortcut to copy all pixels from a TiledInputFile into this file,
     // without uncompressing and then recompressing the pixel data.
@@ -159,6 +159,30 @@ TiledOutputPart::writeTiles (int dx1, int dx2, int dy1, int dy2, int l)
     file->writeTiles(dx1, dx2, dy1, dy2, l);
 }
 
+void
+TiledOutputPart::setWriteBehind (size_t maxBytes)
+{
+    file->setWriteBehind(maxBytes);
+}
+
+size_t
+TiledOutputPart::writeBehind () const
+{
+    return file->writeBehind();
+}
+
+void
+TiledOutputPart::flush ()
+{
+    file->flush();
+}
+
+size_t
+TiledOutputPart::pendingWriteBytes () const
+{
+    return file->pendingWriteBytes();
+}
+
 void
 TiledOutputPart::copyPixels (TiledInputFile &in)
 {
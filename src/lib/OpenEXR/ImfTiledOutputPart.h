@@ -79,6 +79,14 @@ class TiledOutputPart
         void                writeTiles (int dx1, int dx2, int dy1, int dy2,
                                         int l = 0);
         IMF_EXPORT
+        void                setWriteBehind (size_t maxBytes);
+        IMF_EXPORT
+        size_t              writeBehind () const;
+        IMF_EXPORT
+        void                flush ();
+        IMF_EXPORT
+        size_t              pendingWriteBytes () const;
+        IMF_EXPORT
         void                copyPixels (TiledInputFile &in);
         IMF_EXPORT
         void                copyPixels (InputFile &in);
@@ -17,6 +17,7 @@
 
 #include <ImfWav.h>
 #include "ImfNamespace.h"
+#include "ImfSimd.h"
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
 namespace {
@@ -104,6 +105,406 @@ wdec16 (unsigned short  l, unsigned short  h,
     a = aa;
 }
 
+
+//
+// One level of the transform on a 2x2 block, whose top left value is
+// at t[0] and bottom left value at b[0], with the right column s
+// values further along the rows.
+//
+
+inline void
+wenc2x2 (unsigned short *t, unsigned short *b, int s, bool w14)
+{
+    unsigned short i00,i01,i10,i11;
+
+    if (w14)
+    {
+	wenc14 (t[0], t[s], i00, i01);
+	wenc14 (b[0], b[s], i10, i11);
+	wenc14 (i00, i10, t[0], b[0]);
+	wenc14 (i01, i11, t[s], b[s]);
+    }
+    else
+    {
+	wenc16 (t[0], t[s], i00, i01);
+	wenc16 (b[0], b[s], i10, i11);
+	wenc16 (i00, i10, t[0], b[0]);
+	wenc16 (i01, i11, t[s], b[s]);
+    }
+}
+
+
+inline void
+wdec2x2 (unsigned short *t, unsigned short *b, int s, bool w14)
+{
+    unsigned short i00,i01,i10,i11;
+
+    if (w14)
+    {
+	wdec14 (t[0], b[0], i00, i10);
+	wdec14 (t[s], b[s], i01, i11);
+	wdec14 (i00, i01, t[0], t[s]);
+	wdec14 (i10, i11, b[0], b[s]);
+    }
+    else
+    {
+	wdec16 (t[0], b[0], i00, i10);
+	wdec16 (t[s], b[s], i01, i11);
+	wdec16 (i00, i01, t[0], t[s]);
+	wdec16 (i10, i11, b[0], b[s]);
+    }
+}
+
+
+#if defined(IMF_HAVE_SSE2) || defined(IMF_HAVE_NEON)
+#define IMF_WAV_SIMD 1
+
+//
+// SIMD versions of the basis functions, on 8 values at a time. They
+// give exactly the same results as the scalar ones: all the math is
+// modulo 2^16, and the averages are taken without overflowing.
+//
+// When the blocks of a row are next to each other (s is 1 or 2),
+// 16 values of a row are split into a vector of the left and a
+// vector of the right columns of the blocks, so that the horizontal
+// and the vertical steps each handle several blocks at once. With
+// s == 2 only every other value is part of the transform, the ones in
+// between are put back unchanged.
+//
+
+#if defined(IMF_HAVE_SSE2)
+
+typedef __m128i WavVec;
+
+inline WavVec
+wavConst (unsigned short v)
+{
+    return _mm_set1_epi16 ((short) v);
+}
+
+inline void
+wenc14 (WavVec a, WavVec b, WavVec &l, WavVec &h)
+{
+    WavVec one = wavConst (1);
+
+    l = _mm_add_epi16 (_mm_add_epi16 (_mm_srai_epi16 (a, 1),
+				      _mm_srai_epi16 (b, 1)),
+		       _mm_and_si128 (_mm_and_si128 (a, b), one));
+    h = _mm_sub_epi16 (a, b);
+}
+
+inline void
+wdec14 (WavVec l, WavVec h, WavVec &a, WavVec &b)
+{
+    WavVec one = wavConst (1);
+    WavVec ai  = _mm_add_epi16 (_mm_add_epi16 (l, _mm_and_si128 (h, one)),
+				_mm_srai_epi16 (h, 1));
+
+    a = ai;
+    b = _mm_sub_epi16 (ai, h);
+}
+
+inline void
+wenc16 (WavVec a, WavVec b, WavVec &l, WavVec &h)
+{
+    WavVec one  = wavConst (1);
+    WavVec sign = wavConst (0x8000);
+    WavVec ao   = _mm_xor_si128 (a, sign);
+    WavVec m    = _mm_add_epi16 (_mm_add_epi16 (_mm_srli_epi16 (ao, 1),
+						_mm_srli_epi16 (b, 1)),
+				 _mm_and_si128 (_mm_and_si128 (ao, b), one));
+
+    // ao < b as unsigned values
+    WavVec neg = _mm_cmplt_epi16 (a, _mm_xor_si128 (b, sign));
+
+    l = _mm_xor_si128 (m, _mm_and_si128 (neg, sign));
+    h = _mm_sub_epi16 (ao, b);
+}
+
+inline void
+wdec16 (WavVec m, WavVec d, WavVec &a, WavVec &b)
+{
+    WavVec bb = _mm_sub_epi16 (m, _mm_srli_epi16 (d, 1));
+
+    a = _mm_xor_si128 (_mm_add_epi16 (d, bb), wavConst (0x8000));
+    b = bb;
+}
+
+inline void
+wavSplit (const unsigned short *p, int s, WavVec &l, WavVec &r)
+{
+    WavVec v0 = _mm_loadu_si128 ((const __m128i *) p);
+    WavVec v1 = _mm_loadu_si128 ((const __m128i *) (p + 8));
+
+    if (s == 1)
+    {
+	l = _mm_packs_epi32 (_mm_srai_epi32 (_mm_slli_epi32 (v0, 16), 16),
+			     _mm_srai_epi32 (_mm_slli_epi32 (v1, 16), 16));
+	r = _mm_packs_epi32 (_mm_srai_epi32 (v0, 16),
+			     _mm_srai_epi32 (v1, 16));
+    }
+    else
+    {
+	v0 = _mm_shuffle_epi32 (v0, _MM_SHUFFLE (3, 1, 2, 0));
+	v1 = _mm_shuffle_epi32 (v1, _MM_SHUFFLE (3, 1, 2, 0));
+	l  = _mm_unpacklo_epi64 (v0, v1);
+	r  = _mm_unpackhi_epi64 (v0, v1);
+    }
+}
+
+inline void
+wavMerge (unsigned short *p, int s, WavVec l, WavVec r)
+{
+    WavVec v0, v1;
+
+    if (s == 1)
+    {
+	v0 = _mm_unpacklo_epi16 (l, r);
+	v1 = _mm_unpackhi_epi16 (l, r);
+    }
+    else
+    {
+	WavVec lo = _mm_set1_epi32 (0xffff);
+
+	v0 = _mm_unpacklo_epi32 (l, r);
+	v1 = _mm_unpackhi_epi32 (l, r);
+	v0 = _mm_or_si128 (_mm_and_si128 (v0, lo),
+			   _mm_andnot_si128 (lo, _mm_loadu_si128 ((const __m128i *) p)));
+	v1 = _mm_or_si128 (_mm_and_si128 (v1, lo),
+			   _mm_andnot_si128 (lo, _mm_loadu_si128 ((const __m128i *) (p + 8))));
+    }
+
+    _mm_storeu_si128 ((__m128i *) p, v0);
+    _mm_storeu_si128 ((__m128i *) (p + 8), v1);
+}
+
+#else // IMF_HAVE_NEON
+
+typedef uint16x8_t WavVec;
+
+inline WavVec
+wavConst (unsigned short v)
+{
+    return vdupq_n_u16 (v);
+}
+
+inline void
+wenc14 (WavVec a, WavVec b, WavVec &l, WavVec &h)
+{
+    l = vreinterpretq_u16_s16 (vhaddq_s16 (vreinterpretq_s16_u16 (a),
+					   vreinterpretq_s16_u16 (b)));
+    h = vsubq_u16 (a, b);
+}
+
+inline void
+wdec14 (WavVec l, WavVec h, WavVec &a, WavVec &b)
+{
+    WavVec hh = vreinterpretq_u16_s16 (vshrq_n_s16 (vreinterpretq_s16_u16 (h), 1));
+    WavVec ai = vaddq_u16 (vaddq_u16 (l, vandq_u16 (h, wavConst (1))), hh);
+
+    a = ai;
+    b = vsubq_u16 (ai, h);
+}
+
+inline void
+wenc16 (WavVec a, WavVec b, WavVec &l, WavVec &h)
+{
+    WavVec sign = wavConst (0x8000);
+    WavVec ao   = veorq_u16 (a, sign);
+    WavVec m    = vhaddq_u16 (ao, b);
+
+    l = veorq_u16 (m, vandq_u16 (vcltq_u16 (ao, b), sign));
+    h = vsubq_u16 (ao, b);
+}
+
+inline void
+wdec16 (WavVec m, WavVec d, WavVec &a, WavVec &b)
+{
+    WavVec bb = vsubq_u16 (m, vshrq_n_u16 (d, 1));
+
+    a = veorq_u16 (vaddq_u16 (d, bb), wavConst (0x8000));
+    b = bb;
+}
+
+inline void
+wavSplit (const unsigned short *p, int s, WavVec &l, WavVec &r)
+{
+    WavVec v0 = vld1q_u16 (p);
+    WavVec v1 = vld1q_u16 (p + 8);
+
+    if (s == 1)
+    {
+	uint16x8x2_t u = vuzpq_u16 (v0, v1);
+	l = u.val[0];
+	r = u.val[1];
+    }
+    else
+    {
+	uint32x4x2_t u = vuzpq_u32 (vreinterpretq_u32_u16 (v0),
+				    vreinterpretq_u32_u16 (v1));
+	l = vreinterpretq_u16_u32 (u.val[0]);
+	r = vreinterpretq_u16_u32 (u.val[1]);
+    }
+}
+
+inline void
+wavMerge (unsigned short *p, int s, WavVec l, WavVec r)
+{
+    WavVec v0, v1;
+
+    if (s == 1)
+    {
+	uint16x8x2_t z = vzipq_u16 (l, r);
+	v0 = z.val[0];
+	v1 = z.val[1];
+    }
+    else
+    {
+	uint32x4x2_t z = vzipq_u32 (vreinterpretq_u32_u16 (l),
+				    vreinterpretq_u32_u16 (r));
+	WavVec lo = vreinterpretq_u16_u32 (vdupq_n_u32 (0xffff));
+
+	v0 = vbslq_u16 (lo, vreinterpretq_u16_u32 (z.val[0]), vld1q_u16 (p));
+	v1 = vbslq_u16 (lo, vreinterpretq_u16_u32 (z.val[1]), vld1q_u16 (p + 8));
+    }
+
+    vst1q_u16 (p, v0);
+    vst1q_u16 (p + 8, v1);
+}
+
+#endif
+
+
+//
+// Number of blocks at the start of the rows the SIMD code can do:
+// the 16 values it loads from a row must not go past the right value
+// of the last block, which is one short of the end of the blocks
+// when s == 2.
+//
+
+inline int
+wavSimdBlocks (int s, int nb)
+{
+    if (s > 2)
+	return 0;
+
+    return ((2 * s * nb - s + 1) / 16) * (8 / s);
+}
+
+
+int
+wencRowsSimd (unsigned short *t, unsigned short *b, int s, int nb, bool w14)
+{
+    int n = wavSimdBlocks (s, nb);
+
+    for (int k = 0; k < n; k += 8 / s)
+    {
+	unsigned short *tk = t + 2 * s * k;
+	unsigned short *bk = b + 2 * s * k;
+	WavVec t0, t1, b0, b1, i00, i01, i10, i11;
+
+	wavSplit (tk, s, t0, t1);
+	wavSplit (bk, s, b0, b1);
+
+	if (w14)
+	{
+	    wenc14 (t0, t1, i00, i01);
+	    wenc14 (b0, b1, i10, i11);
+	    wenc14 (i00, i10, t0, b0);
+	    wenc14 (i01, i11, t1, b1);
+	}
+	else
+	{
+	    wenc16 (t0, t1, i00, i01);
+	    wenc16 (b0, b1, i10, i11);
+	    wenc16 (i00, i10, t0, b0);
+	    wenc16 (i01, i11, t1, b1);
+	}
+
+	wavMerge (tk, s, t0, t1);
+	wavMerge (bk, s, b0, b1);
+    }
+
+    return n;
+}
+
+
+int
+wdecRowsSimd (unsigned short *t, unsigned short *b, int s, int nb, bool w14)
+{
+    int n = wavSimdBlocks (s, nb);
+
+    for (int k = 0; k < n; k += 8 / s)
+    {
+	unsigned short *tk = t + 2 * s * k;
+	unsigned short *bk = b + 2 * s * k;
+	WavVec t0, t1, b0, b1, i00, i01, i10, i11;
+
+	wavSplit (tk, s, t0, t1);
+	wavSplit (bk, s, b0, b1);
+
+	if (w14)
+	{
+	    wdec14 (t0, b0, i00, i10);
+	    wdec14 (t1, b1, i01, i11);
+	    wdec14 (i00, i01, t0, t1);
+	    wdec14 (i10, i11, b0, b1);
+	}
+	else
+	{
+	    wdec16 (t0, b0, i00, i10);
+	    wdec16 (t1, b1, i01, i11);
+	    wdec16 (i00, i01, t0, t1);
+	    wdec16 (i10, i11, b0, b1);
+	}
+
+	wavMerge (tk, s, t0, t1);
+	wavMerge (bk, s, b0, b1);
+    }
+
+    return n;
+}
+
+#endif
+
+
+//
+// One level of the transform on the nb blocks of a pair of rows.
+// The SIMD code needs the rows not to overlap, and the blocks to be
+// at most 2 values apart.
+//
+
+void
+wencRows (unsigned short *t, unsigned short *b, int s, int nb, bool w14,
+	  bool simd)
+{
+    int k = 0;
+
+#ifdef IMF_WAV_SIMD
+    if (simd)
+	k = wencRowsSimd (t, b, s, nb, w14);
+#endif
+
+    for (; k < nb; ++k)
+	wenc2x2 (t + 2 * s * k, b + 2 * s * k, s, w14);
+}
+
+
+void
+wdecRows (unsigned short *t, unsigned short *b, int s, int nb, bool w14,
+	  bool simd)
+{
+    int k = 0;
+
+#ifdef IMF_WAV_SIMD
+    if (simd)
+	k = wdecRowsSimd (t, b, s, nb, w14);
+#endif
+
+    for (; k < nb; ++k)
+	wdec2x2 (t + 2 * s * k, b + 2 * s * k, s, w14);
+}
+
 } // namespace
 
 
@@ -121,6 +522,7 @@ wav2Encode
      unsigned short	mx)	// i : maximum in[x][y] value
 {
     bool w14 = (mx < (1 << 14));
+    bool simd = (ox == 1 || ox == 2) && oy >= nx * ox;
     int	n  = (nx > ny)? ny: nx;
     int	p  = 1;			// == 1 <<  level
     int p2 = 2;			// == 1 << (level+1)
@@ -137,7 +539,8 @@ wav2Encode
 	int oy2 = oy * p2;
 	int ox1 = ox * p;
 	int ox2 = ox * p2;
-	unsigned short i00,i01,i10,i11;
+	int nb  = nx / p2;
+	unsigned short i00;
 
 	//
 	// Y loop
@@ -146,37 +549,13 @@ wav2Encode
 	for (; py <= ey; py += oy2)
 	{
 	    unsigned short *px = py;
-	    unsigned short *ex = py + ox * (nx - p2);
 
 	    //
-	    // X loop
+	    // X loop, all the blocks of this pair of rows
 	    //
 
-	    for (; px <= ex; px += ox2)
-	    {
-		unsigned short *p01 = px  + ox1;
-		unsigned short *p10 = px  + oy1;
-		unsigned short *p11 = p10 + ox1;
-
-		//
-		// 2D wavelet encoding
-		//
-
-		if (w14)
-		{
-		    wenc14 (*px,  *p01, i00, i01);
-		    wenc14 (*p10, *p11, i10, i11);
-		    wenc14 (i00, i10, *px,  *p10);
-		    wenc14 (i01, i11, *p01, *p11);
-		}
-		else
-		{
-		    wenc16 (*px,  *p01, i00, i01);
-		    wenc16 (*p10, *p11, i10, i11);
-		    wenc16 (i00, i10, *px,  *p10);
-		    wenc16 (i01, i11, *p01, *p11);
-		}
-	    }
+	    wencRows (px, px + oy1, ox1, nb, w14, simd);
+	    px += ox2 * nb;
 
 	    //
 	    // Encode (1D) odd column (still in Y loop)
@@ -241,6 +620,7 @@ wav2Decode
      unsigned short	mx)	// i : maximum in[x][y] value
 {
     bool w14 = (mx < (1 << 14));
+    bool simd = (ox == 1 || ox == 2) && oy >= nx * ox;
     int	n = (nx > ny)? ny: nx;
     int	p = 1;
     int p2;
@@ -268,7 +648,8 @@ wav2Decode
 	int oy2 = oy * p2;
 	int ox1 = ox * p;
 	int ox2 = ox * p2;
-	unsigned short i00,i01,i10,i11;
+	int nb  = nx / p2;
+	unsigned short i00;
 
 	//
 	// Y loop
@@ -277,37 +658,13 @@ wav2Decode
 	for (; py <= ey; py += oy2)
 	{
 	    unsigned short *px = py;
-	    unsigned short *ex = py + ox * (nx - p2);
 
 	    //
-	    // X loop
+	    // X loop, all the blocks of this pair of rows
 	    //
 
-	    for (; px <= ex; px += ox2)
-	    {
-		unsigned short *p01 = px  + ox1;
-		unsigned short *p10 = px  + oy1;
-		unsigned short *p11 = p10 + ox1;
-
-		//
-		// 2D wavelet decoding
-		//
-
-		if (w14)
-		{
-		    wdec14 (*px,  *p10, i00, i10);
-		    wdec14 (*p01, *p11, i01, i11);
-		    wdec14 (i00, i01, *px,  *p01);
-		    wdec14 (i10, i11, *p10, *p11);
-		}
-		else
-		{
-		    wdec16 (*px,  *p10, i00, i10);
-		    wdec16 (*p01, *p11, i01, i11);
-		    wdec16 (i00, i01, *px,  *p01);
-		    wdec16 (i10, i11, *p10, *p11);
-		}
-	    }
+	    wdecRows (px, px + oy1, ox1, nb, w14, simd);
+	    px += ox2 * nb;
 
 	    //
 	    // Decode (1D) odd column (still in Y loop)
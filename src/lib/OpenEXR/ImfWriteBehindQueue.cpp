@@ -0,0 +1,319 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+//-----------------------------------------------------------------------------
+//
+//	class WriteBehindQueue
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfWriteBehindQueue.h"
+#include "IlmThreadPool.h"
+#include "Iex.h"
+
+#include <deque>
+#include <string>
+
+#if ILMTHREAD_THREADING_ENABLED
+#include <condition_variable>
+#include <mutex>
+#endif
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+using ILMTHREAD_NAMESPACE::Task;
+using ILMTHREAD_NAMESPACE::TaskGroup;
+using ILMTHREAD_NAMESPACE::ThreadPool;
+using std::deque;
+using std::string;
+
+
+struct WriteBehindQueue::Data
+#if ILMTHREAD_THREADING_ENABLED
+    : public std::mutex
+#endif
+{
+    deque<Chunk *>	chunks;		// queued chunks, oldest first
+    size_t		maxBytes;	// limit for the size of the queue
+    size_t		pendingBytes;	// size of the queued chunks
+    bool		writing;	// a WriteBehindTask is running
+    bool		hasException;	// writing a chunk failed
+    string		exception;	// what() of the first failure
+
+#if ILMTHREAD_THREADING_ENABLED
+    std::condition_variable	changed;	// a chunk was written, or
+						// the task finished
+#endif
+
+    //
+    // The task group must be destroyed before any other member,
+    // because its destructor waits until the WriteBehindTask has
+    // finished using the queue.
+    //
+
+    TaskGroup		taskGroup;
+
+    Data (size_t maxBytes);
+    ~Data ();
+
+    void		storeException (const char *what);
+};
+
+
+WriteBehindQueue::Data::Data (size_t maxBytes):
+    maxBytes (maxBytes),
+    pendingBytes (0),
+    writing (false),
+    hasException (false)
+{
+    // empty
+}
+
+
+WriteBehindQueue::Data::~Data ()
+{
+    for (size_t i = 0; i < chunks.size(); ++i)
+	delete chunks[i];
+}
+
+
+void
+WriteBehindQueue::Data::storeException (const char *what)
+{
+    if (!hasException)
+    {
+	exception = what;
+	hasException = true;
+    }
+}
+
+
+WriteBehindQueue::Chunk::~Chunk ()
+{
+    // empty
+}
+
+
+namespace {
+
+//
+// A WriteBehindTask writes chunks until the queue is empty.  At most
+// one WriteBehindTask per queue runs at any time, so that the chunks
+// are written in the order in which they were queued.
+//
+
+class WriteBehindTask: public Task
+{
+  public:
+
+    WriteBehindTask (WriteBehindQueue::Data *data):
+	Task (&data->taskGroup),
+	_data (data)
+    {
+	// empty
+    }
+
+    virtual void	execute ();
+
+  private:
+
+    WriteBehindQueue::Data *	_data;
+};
+
+
+void
+WriteBehindTask::execute ()
+{
+    while (true)
+    {
+	WriteBehindQueue::Chunk *chunk;
+	bool discard;
+
+	{
+#if ILMTHREAD_THREADING_ENABLED
+	    std::lock_guard<std::mutex> lock (*_data);
+#endif
+	    if (_data->chunks.empty())
+	    {
+		_data->writing = false;
+#if ILMTHREAD_THREADING_ENABLED
+		_data->changed.notify_all();
+#endif
+		return;
+	    }
+
+	    chunk = _data->chunks.front();
+	    discard = _data->hasException;
+	}
+
+	//
+	// Write the chunk without holding the lock on the queue, so
+	// that push() can add more chunks in the meantime.  Once a write
+	// has failed, the file cannot be completed, and the remaining
+	// chunks are discarded.
+	//
+
+	string exception;
+	bool failed = false;
+
+	if (!discard)
+	{
+	    try
+	    {
+		chunk->write();
+	    }
+	    catch (std::exception &e)
+	    {
+		exception = e.what();
+		failed = true;
+	    }
+	    catch (...)
+	    {
+		exception = "unrecognized exception";
+		failed = true;
+	    }
+	}
+
+	{
+#if ILMTHREAD_THREADING_ENABLED
+	    std::lock_guard<std::mutex> lock (*_data);
+#endif
+	    _data->chunks.pop_front();
+	    _data->pendingBytes -= chunk->data.size();
+
+	    if (failed)
+		_data->storeException (exception.c_str());
+
+#if ILMTHREAD_THREADING_ENABLED
+	    _data->changed.notify_all();
+#endif
+	}
+
+	delete chunk;
+    }
+}
+
+} // namespace
+
+
+WriteBehindQueue::WriteBehindQueue (size_t maxBytes):
+    _data (new Data (maxBytes))
+{
+    // empty
+}
+
+
+WriteBehindQueue::~WriteBehindQueue ()
+{
+    try
+    {
+	flush();
+    }
+    catch (...) //NOSONAR - suppress vulnerability reports from SonarCloud.
+    {
+	//
+	// We cannot safely throw any exceptions from here.
+	//
+    }
+
+    delete _data;
+}
+
+
+void
+WriteBehindQueue::setMaxBytes (size_t maxBytes)
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    _data->maxBytes = maxBytes;
+}
+
+
+size_t
+WriteBehindQueue::maxBytes () const
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    return _data->maxBytes;
+}
+
+
+void
+WriteBehindQueue::push (Chunk *chunk)
+{
+    size_t size = chunk->data.size();
+    bool startTask = false;
+
+    {
+#if ILMTHREAD_THREADING_ENABLED
+	std::unique_lock<std::mutex> lock (*_data);
+
+	//
+	// Wait for room in the queue.  A chunk that is bigger than
+	// the limit is queued as soon as the queue is empty.
+	//
+
+	while (!_data->hasException &&
+	       _data->pendingBytes > 0 &&
+	       _data->pendingBytes + size > _data->maxBytes)
+	{
+	    _data->changed.wait (lock);
+	}
+#endif
+	if (_data->hasException)
+	{
+	    delete chunk;
+	    throw IEX_NAMESPACE::IoExc (_data->exception);
+	}
+
+	_data->chunks.push_back (chunk);
+	_data->pendingBytes += size;
+
+	if (!_data->writing)
+	{
+	    _data->writing = true;
+	    startTask = true;
+	}
+    }
+
+    //
+    // Without worker threads, the thread pool executes the
+    // task right away, and the chunk is written before push()
+    // returns.
+    //
+
+    if (startTask)
+	ThreadPool::addGlobalTask (new WriteBehindTask (_data));
+}
+
+
+void
+WriteBehindQueue::flush ()
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::unique_lock<std::mutex> lock (*_data);
+
+    while (_data->writing)
+	_data->changed.wait (lock);
+#endif
+
+    if (_data->hasException)
+	throw IEX_NAMESPACE::IoExc (_data->exception);
+}
+
+
+size_t
+WriteBehindQueue::pendingBytes () const
+{
+#if ILMTHREAD_THREADING_ENABLED
+    std::lock_guard<std::mutex> lock (*_data);
+#endif
+    return _data->pendingBytes;
+}
+
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -0,0 +1,118 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef INCLUDED_IMF_WRITE_BEHIND_QUEUE_H
+#define INCLUDED_IMF_WRITE_BEHIND_QUEUE_H
+
+//-----------------------------------------------------------------------------
+//
+//	class WriteBehindQueue -- a queue of compressed chunks that have
+//	been handed over by OutputFile::writePixels() or by
+//	TiledOutputFile::writeTiles(), but that have not yet been stored
+//	in the file.
+//
+//	A task on the global thread pool takes the chunks off the queue
+//	and writes them, in the order in which they were queued, while
+//	the caller goes on producing pixels.  The total size of the queued
+//	chunks is limited; push() waits until the queue has room.
+//
+//	The queue is internal to the library.
+//
+//-----------------------------------------------------------------------------
+
+#include "ImfNamespace.h"
+
+#include <cstddef>
+#include <vector>
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+
+class WriteBehindQueue
+{
+  public:
+
+    //-------------------------------------------------------------
+    // A chunk of pixel data; write() stores data in the file.
+    // write() runs on a thread pool thread, and it must lock the
+    // file's output stream itself.
+    //-------------------------------------------------------------
+
+    struct Chunk
+    {
+	std::vector<char>	data;
+
+	virtual ~Chunk ();
+	virtual void		write () = 0;
+    };
+
+
+    //-----------------------------------------------------------
+    // Constructor -- maxBytes is the limit for the size of the
+    // queued data.  A chunk that is bigger than the limit is
+    // queued as soon as the queue is empty.
+    //-----------------------------------------------------------
+
+    WriteBehindQueue (size_t maxBytes = 0);
+
+    //---------------------------------------------------------
+    // Destructor -- waits until all queued chunks are written,
+    // ignoring errors.
+    //---------------------------------------------------------
+
+    ~WriteBehindQueue ();
+
+    WriteBehindQueue (const WriteBehindQueue& other) = delete;
+    WriteBehindQueue& operator = (const WriteBehindQueue& other) = delete;
+    WriteBehindQueue (WriteBehindQueue&& other) = delete;
+    WriteBehindQueue& operator = (WriteBehindQueue&& other) = delete;
+
+
+    //--------------------------------------------------------------
+    // Change the limit.  Lowering the limit does not wait for the
+    // queue to drain, but subsequent push() calls respect it.
+    //--------------------------------------------------------------
+
+    void		setMaxBytes (size_t maxBytes);
+    size_t		maxBytes () const;
+
+
+    //----------------------------------------------------------------
+    // Queue a chunk, and take ownership of it.  If adding the chunk
+    // would exceed the limit, push() first waits until enough of the
+    // queued chunks have been written.  If writing an earlier chunk
+    // failed, push() deletes the chunk and throws IEX_NAMESPACE::IoExc.
+    //----------------------------------------------------------------
+
+    void		push (Chunk *chunk);
+
+
+    //--------------------------------------------------------------
+    // Wait until all queued chunks have been written.  If writing
+    // any of them failed, flush() throws IEX_NAMESPACE::IoExc.
+    // Once a write has failed, the remaining chunks are discarded,
+    // and push() and flush() keep throwing.
+    //--------------------------------------------------------------
+
+    void		flush ();
+
+
+    //------------------------------------------------------------
+    // The size of the chunks that are queued but not yet written
+    //------------------------------------------------------------
+
+    size_t		pendingBytes () const;
+
+    struct Data;
+
+  private:
+
+    Data *		_data;
+};
+
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
@@ -5,26 +5,87 @@
 
 #include "ImfZip.h"
 #include "ImfCheckedArithmetic.h"
+#include "ImfStandardAttributes.h"
 #include "ImfNamespace.h"
 #include "ImfSimd.h"
+#include "ImfSystemSpecific.h"
 #include "Iex.h"
+#include "OpenEXRConfigInternal.h"
 
 #include <math.h>
 #include <zlib.h>
 
+#ifdef OPENEXR_IMF_HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
 
-Zip::Zip(size_t maxRawSize):
+namespace {
+
+void
+checkLevel (int level)
+{
+    if (level < -1 || level > 9)
+    {
+        THROW (IEX_NAMESPACE::ArgExc,
+               "Invalid zip compression level " << level << ", "
+               "expected a value from 0 to 9, or -1 for the default.");
+    }
+}
+
+#ifdef OPENEXR_IMF_HAVE_LIBDEFLATE
+
+//
+// libdeflate (de)compressors are comparatively expensive to create,
+// so keep one per level per thread rather than one per call
+//
+
+struct DeflateState
+{
+    DeflateState ()
+    {
+        for (int i = 0; i < 10; ++i)
+            compressors[i] = 0;
+        decompressor = 0;
+    }
+
+    ~DeflateState ()
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            if (compressors[i])
+                libdeflate_free_compressor (compressors[i]);
+        }
+        if (decompressor)
+            libdeflate_free_decompressor (decompressor);
+    }
+
+    libdeflate_compressor   *compressors[10];
+    libdeflate_decompressor *decompressor;
+};
+
+thread_local DeflateState deflateState;
+
+#endif
+
+} // namespace
+
+Zip::Zip(size_t maxRawSize, int level):
     _maxRawSize(maxRawSize),
-    _tmpBuffer(0)
+    _tmpBuffer(0),
+    _level(level)
 {
+    checkLevel (level);
     _tmpBuffer = new char[_maxRawSize];
 }
 
-Zip::Zip(size_t maxScanLineSize, size_t numScanLines):
+Zip::Zip(size_t maxScanLineSize, size_t numScanLines, int level):
     _maxRawSize(0),
-    _tmpBuffer(0)
+    _tmpBuffer(0),
+    _level(level)
 {
+    checkLevel (level);
     _maxRawSize = uiMult (maxScanLineSize, numScanLines);
     _tmpBuffer  = new char[_maxRawSize];
 }
@@ -34,6 +95,16 @@ Zip::~Zip()
     if (_tmpBuffer) delete[] _tmpBuffer;
 }
 
+int
+Zip::headerLevel(const Header &hdr)
+{
+    if (!hasZipCompressionLevel (hdr))
+        return -1;
+
+    int level = zipCompressionLevel (hdr);
+    return (level >= -1 && level <= 9) ? level : -1;
+}
+
 size_t
 Zip::maxRawSize()
 {
@@ -52,184 +123,516 @@ int
 Zip::compress(const char *raw, int rawSize, char *compressed)
 {
     //
-    // Reorder the pixel data.
+    // Reorder the pixel data and apply the predictor.
     //
 
-    {
-        char *t1 = _tmpBuffer;
-        char *t2 = _tmpBuffer + (rawSize + 1) / 2;
-        const char *stop = raw + rawSize;
+    reorderAndPredict (raw, rawSize, _tmpBuffer);
 
-        while (true)
-        {
-            if (raw < stop)
-            *(t1++) = *(raw++);
-            else
-            break;
-
-            if (raw < stop)
-            *(t2++) = *(raw++);
-            else
-            break;
-        }
-    }
+    //
+    // Compress the data using zlib
+    //
+
+    return deflateBuffer (_level, _tmpBuffer, rawSize, compressed,
+                          int(ceil(rawSize * 1.01)) + 100);
+}
 
+size_t
+Zip::deflateBuffer(int level,
+                   const char *in, size_t inSize,
+                   char *out, size_t outSize)
+{
+#ifdef OPENEXR_IMF_HAVE_LIBDEFLATE
     //
-    // Predictor.
+    // libdeflate has no "default" level, 6 matches zlib's
     //
 
+    if (level < 0)
+        level = 6;
+
+    libdeflate_compressor *&comp = deflateState.compressors[level];
+
+    if (!comp)
     {
-        unsigned char *t    = (unsigned char *) _tmpBuffer + 1;
-        unsigned char *stop = (unsigned char *) _tmpBuffer + rawSize;
-        int p = t[-1];
+        comp = libdeflate_alloc_compressor (level);
+        if (!comp)
+            throw IEX_NAMESPACE::BaseExc ("Data compression (libdeflate) failed.");
+    }
 
-        while (t < stop)
-        {
-            int d = int (t[0]) - p + (128 + 256);
-            p = t[0];
-            t[0] = d;
-            ++t;
-        }
+    size_t n = libdeflate_zlib_compress (comp, in, inSize, out, outSize);
+
+    if (n == 0)
+        throw IEX_NAMESPACE::BaseExc ("Data compression (libdeflate) failed.");
+
+    return n;
+#else
+    uLongf n = outSize;
+
+    if (Z_OK != ::compress2 ((Bytef *)out, &n,
+                             (const Bytef *) in, inSize, level))
+    {
+        throw IEX_NAMESPACE::BaseExc ("Data compression (zlib) failed.");
+    }
+
+    return n;
+#endif
+}
+
+size_t
+Zip::inflateBuffer(const char *in, size_t inSize,
+                   char *out, size_t outSize)
+{
+#ifdef OPENEXR_IMF_HAVE_LIBDEFLATE
+    libdeflate_decompressor *&decomp = deflateState.decompressor;
+
+    if (!decomp)
+    {
+        decomp = libdeflate_alloc_decompressor ();
+        if (!decomp)
+            throw IEX_NAMESPACE::InputExc ("Data decompression (libdeflate) failed.");
+    }
+
+    size_t n = 0;
+
+    if (LIBDEFLATE_SUCCESS != libdeflate_zlib_decompress (decomp,
+                                                          in, inSize,
+                                                          out, outSize,
+                                                          &n))
+    {
+        throw IEX_NAMESPACE::InputExc ("Data decompression (libdeflate) failed.");
+    }
+
+    return n;
+#else
+    uLongf n = outSize;
+
+    if (Z_OK != ::uncompress ((Bytef *)out, &n,
+                              (const Bytef *) in, inSize))
+    {
+        throw IEX_NAMESPACE::InputExc ("Data decompression (zlib) failed.");
+    }
+
+    return n;
+#endif
+}
+
+//
+// The reordering and predictor kernels.  The scalar tails double as
+// the reference implementation; SSE2 and NEON are chosen at compile
+// time, AVX2 at runtime by Zip::initializeFuncs().
+//
+
+namespace {
+
+inline void
+splitBytesTail (unsigned char *t1, unsigned char *t2,
+                const unsigned char *in, size_t k, size_t count)
+{
+    size_t pairs = count / 2;
+
+    for (; k < pairs; ++k)
+    {
+        t1[k] = in[2 * k];
+        t2[k] = in[2 * k + 1];
+    }
+
+    if (count & 1)
+        t1[pairs] = in[count - 1];
+}
+
+// encodes buf[start, count) back to front, start >= 1
+inline void
+deltaEncodeTail (unsigned char *buf, size_t start, size_t count)
+{
+    for (size_t i = count; i-- > start;)
+        buf[i] = (unsigned char) (int (buf[i]) - int (buf[i - 1]) + (128 + 256));
+}
+
+// decodes buf[start, count), start >= 1
+inline void
+deltaDecodeTail (unsigned char *buf, size_t start, size_t count)
+{
+    for (size_t i = start; i < count; ++i)
+        buf[i] = (unsigned char) (int (buf[i - 1]) + int (buf[i]) - 128);
+}
+
+inline void
+interleaveTail (unsigned char *out, const unsigned char *t1,
+                const unsigned char *t2, size_t k, size_t count)
+{
+    size_t pairs = count / 2;
+
+    for (; k < pairs; ++k)
+    {
+        out[2 * k]     = t1[k];
+        out[2 * k + 1] = t2[k];
+    }
+
+    if (count & 1)
+        out[count - 1] = t1[pairs];
+}
+
+#if !defined(IMF_HAVE_SSE2) && !defined(IMF_HAVE_NEON)
+
+void
+reorderAndPredict_scalar (const unsigned char *in, size_t count,
+                          unsigned char *out)
+{
+    splitBytesTail (out, out + (count + 1) / 2, in, 0, count);
+    deltaEncodeTail (out, 1, count);
+}
+
+void
+reconstructAndInterleave_scalar (unsigned char *tmp, size_t count,
+                                 unsigned char *out)
+{
+    deltaDecodeTail (tmp, 1, count);
+    interleaveTail (out, tmp, tmp + (count + 1) / 2, 0, count);
+}
+
+#endif
+
+#ifdef IMF_HAVE_SSE2
+
+void
+reorderAndPredict_sse2 (const unsigned char *in, size_t count,
+                        unsigned char *out)
+{
+    unsigned char *t1    = out;
+    unsigned char *t2    = out + (count + 1) / 2;
+    size_t         pairs = count / 2;
+    size_t         nb    = (count - 1) / 16;
+    size_t         k     = 0;
+
+    const __m128i lomask = _mm_set1_epi16 (0x00ff);
+    const __m128i bias   = _mm_set1_epi8 ((char) 0x80);
+
+    for (; k + 16 <= pairs; k += 16)
+    {
+        __m128i a = _mm_loadu_si128 ((const __m128i *) (in + 2 * k));
+        __m128i b = _mm_loadu_si128 ((const __m128i *) (in + 2 * k + 16));
+
+        _mm_storeu_si128 ((__m128i *) (t1 + k),
+                          _mm_packus_epi16 (_mm_and_si128 (a, lomask),
+                                            _mm_and_si128 (b, lomask)));
+        _mm_storeu_si128 ((__m128i *) (t2 + k),
+                          _mm_packus_epi16 (_mm_srli_epi16 (a, 8),
+                                            _mm_srli_epi16 (b, 8)));
     }
 
+    splitBytesTail (t1, t2, in, k, count);
+
     //
-    // Compress the data using zlib
+    // Back to front, so the previous byte is still the original.
     //
 
-    uLongf outSize = int(ceil(rawSize * 1.01)) + 100;
+    deltaEncodeTail (out, 1 + nb * 16, count);
 
-    if (Z_OK != ::compress ((Bytef *)compressed, &outSize,
-                (const Bytef *) _tmpBuffer, rawSize))
+    while (nb-- > 0)
     {
-        throw IEX_NAMESPACE::BaseExc ("Data compression (zlib) failed.");
+        unsigned char *p = out + 1 + nb * 16;
+        __m128i cur = _mm_loadu_si128 ((const __m128i *) p);
+        __m128i prv = _mm_loadu_si128 ((const __m128i *) (p - 1));
+
+        _mm_storeu_si128 ((__m128i *) p,
+                          _mm_add_epi8 (_mm_sub_epi8 (cur, prv), bias));
     }
+}
 
-    return outSize;
+void
+reconstructAndInterleave_sse2 (unsigned char *tmp, size_t count,
+                               unsigned char *out)
+{
+    const unsigned char *t1    = tmp;
+    const unsigned char *t2    = tmp + (count + 1) / 2;
+    size_t               pairs = count / 2;
+    size_t               nb    = (count - 1) / 16;
+    unsigned char       *p     = tmp + 1;
+
+    const __m128i bias = _mm_set1_epi8 ((char) 0x80);
+    __m128i       prev = _mm_set1_epi8 ((char) tmp[0]);
+
+    for (size_t b = 0; b < nb; ++b, p += 16)
+    {
+        __m128i d = _mm_add_epi8 (_mm_loadu_si128 ((const __m128i *) p), bias);
+
+        // Compute the prefix sum of elements, then add the carry in.
+        d = _mm_add_epi8 (d, _mm_slli_si128 (d, 1));
+        d = _mm_add_epi8 (d, _mm_slli_si128 (d, 2));
+        d = _mm_add_epi8 (d, _mm_slli_si128 (d, 4));
+        d = _mm_add_epi8 (d, _mm_slli_si128 (d, 8));
+        d = _mm_add_epi8 (d, prev);
+
+        _mm_storeu_si128 ((__m128i *) p, d);
+
+        // Broadcast the high byte for the next iteration, without
+        // SSSE3's byte shuffle.
+        prev = _mm_unpackhi_epi8 (d, d);
+        prev = _mm_shufflehi_epi16 (prev, 0xff);
+        prev = _mm_shuffle_epi32 (prev, 0xff);
+    }
+
+    deltaDecodeTail (tmp, 1 + nb * 16, count);
+
+    size_t k = 0;
+
+    for (; k + 16 <= pairs; k += 16)
+    {
+        __m128i a = _mm_loadu_si128 ((const __m128i *) (t1 + k));
+        __m128i b = _mm_loadu_si128 ((const __m128i *) (t2 + k));
+
+        _mm_storeu_si128 ((__m128i *) (out + 2 * k),
+                          _mm_unpacklo_epi8 (a, b));
+        _mm_storeu_si128 ((__m128i *) (out + 2 * k + 16),
+                          _mm_unpackhi_epi8 (a, b));
+    }
+
+    interleaveTail (out, t1, t2, k, count);
 }
 
-#ifdef IMF_HAVE_SSE4_1
+#endif // IMF_HAVE_SSE2
+
+#ifdef IMF_HAVE_AVX2_TARGET
 
-static void
-reconstruct_sse41(char *buf, size_t outSize)
+IMF_TARGET_AVX2 void
+reorderAndPredict_avx2 (const unsigned char *in, size_t count,
+                        unsigned char *out)
 {
-    static const size_t bytesPerChunk = sizeof(__m128i);
-    const size_t vOutSize = outSize / bytesPerChunk;
+    unsigned char *t1    = out;
+    unsigned char *t2    = out + (count + 1) / 2;
+    size_t         pairs = count / 2;
+    size_t         nb    = (count - 1) / 32;
+    size_t         k     = 0;
+
+    const __m256i lomask = _mm256_set1_epi16 (0x00ff);
+    const __m256i bias   = _mm256_set1_epi8 ((char) 0x80);
+
+    for (; k + 32 <= pairs; k += 32)
+    {
+        __m256i a = _mm256_loadu_si256 ((const __m256i *) (in + 2 * k));
+        __m256i b = _mm256_loadu_si256 ((const __m256i *) (in + 2 * k + 32));
+
+        __m256i e = _mm256_packus_epi16 (_mm256_and_si256 (a, lomask),
+                                         _mm256_and_si256 (b, lomask));
+        __m256i o = _mm256_packus_epi16 (_mm256_srli_epi16 (a, 8),
+                                         _mm256_srli_epi16 (b, 8));
+
+        // packus works per 128 bit lane, restore the quadword order
+        _mm256_storeu_si256 ((__m256i *) (t1 + k),
+                             _mm256_permute4x64_epi64 (e, 0xd8));
+        _mm256_storeu_si256 ((__m256i *) (t2 + k),
+                             _mm256_permute4x64_epi64 (o, 0xd8));
+    }
+
+    splitBytesTail (t1, t2, in, k, count);
+
+    deltaEncodeTail (out, 1 + nb * 32, count);
+
+    while (nb-- > 0)
+    {
+        unsigned char *p = out + 1 + nb * 32;
+        __m256i cur = _mm256_loadu_si256 ((const __m256i *) p);
+        __m256i prv = _mm256_loadu_si256 ((const __m256i *) (p - 1));
+
+        _mm256_storeu_si256 ((__m256i *) p,
+                             _mm256_add_epi8 (_mm256_sub_epi8 (cur, prv), bias));
+    }
+}
 
-    const __m128i c = _mm_set1_epi8(-128);
-    const __m128i shuffleMask = _mm_set1_epi8(15);
+IMF_TARGET_AVX2 void
+reconstructAndInterleave_avx2 (unsigned char *tmp, size_t count,
+                               unsigned char *out)
+{
+    const unsigned char *t1    = tmp;
+    const unsigned char *t2    = tmp + (count + 1) / 2;
+    size_t               pairs = count / 2;
+    size_t               nb    = (count - 1) / 32;
+    unsigned char       *p     = tmp + 1;
 
-    // The first element doesn't have its high bit flipped during compression,
-    // so it must not be flipped here.  To make the SIMD loop nice and
-    // uniform, we pre-flip the bit so that the loop will unflip it again.
-    buf[0] += -128;
+    const __m256i bias = _mm256_set1_epi8 ((char) 0x80);
+    const __m256i last = _mm256_set1_epi8 (15);
+    __m256i       prev = _mm256_set1_epi8 ((char) tmp[0]);
 
-    __m128i *vBuf = reinterpret_cast<__m128i *>(buf);
-    __m128i vPrev = _mm_setzero_si128();
-    for (size_t i=0; i<vOutSize; ++i)
+    for (size_t b = 0; b < nb; ++b, p += 32)
     {
-        __m128i d = _mm_add_epi8(_mm_loadu_si128(vBuf), c);
+        __m256i d = _mm256_add_epi8 (
+            _mm256_loadu_si256 ((const __m256i *) p), bias);
 
-        // Compute the prefix sum of elements.
-        d = _mm_add_epi8(d, _mm_slli_si128(d, 1));
-        d = _mm_add_epi8(d, _mm_slli_si128(d, 2));
-        d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
-        d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
-        d = _mm_add_epi8(d, vPrev);
+        d = _mm256_add_epi8 (d, _mm256_slli_si256 (d, 1));
+        d = _mm256_add_epi8 (d, _mm256_slli_si256 (d, 2));
+        d = _mm256_add_epi8 (d, _mm256_slli_si256 (d, 4));
+        d = _mm256_add_epi8 (d, _mm256_slli_si256 (d, 8));
 
-        _mm_storeu_si128(vBuf++, d);
+        // Carry the total of the low lane into the high lane.
+        __m256i c = _mm256_shuffle_epi8 (d, last);
+        d = _mm256_add_epi8 (d, _mm256_permute2x128_si256 (c, c, 0x08));
+        d = _mm256_add_epi8 (d, prev);
 
-        // Broadcast the high byte in our result to all lanes of the prev
-        // value for the next iteration.
-        vPrev = _mm_shuffle_epi8(d, shuffleMask);
+        _mm256_storeu_si256 ((__m256i *) p, d);
+
+        c    = _mm256_shuffle_epi8 (d, last);
+        prev = _mm256_permute2x128_si256 (c, c, 0x11);
     }
 
-    unsigned char prev = _mm_extract_epi8(vPrev, 15);
-    for (size_t i=vOutSize*bytesPerChunk; i<outSize; ++i)
+    deltaDecodeTail (tmp, 1 + nb * 32, count);
+
+    size_t k = 0;
+
+    for (; k + 32 <= pairs; k += 32)
     {
-        unsigned char d = prev + buf[i] - 128;
-        buf[i] = d;
-        prev = d;
+        __m256i a  = _mm256_loadu_si256 ((const __m256i *) (t1 + k));
+        __m256i b  = _mm256_loadu_si256 ((const __m256i *) (t2 + k));
+        __m256i lo = _mm256_unpacklo_epi8 (a, b);
+        __m256i hi = _mm256_unpackhi_epi8 (a, b);
+
+        _mm256_storeu_si256 ((__m256i *) (out + 2 * k),
+                             _mm256_permute2x128_si256 (lo, hi, 0x20));
+        _mm256_storeu_si256 ((__m256i *) (out + 2 * k + 32),
+                             _mm256_permute2x128_si256 (lo, hi, 0x31));
     }
+
+    interleaveTail (out, t1, t2, k, count);
 }
 
-#else
+#endif // IMF_HAVE_AVX2_TARGET
+
+#ifdef IMF_HAVE_NEON
 
-static void
-reconstruct_scalar(char *buf, size_t outSize)
+void
+reorderAndPredict_neon (const unsigned char *in, size_t count,
+                        unsigned char *out)
 {
-    unsigned char *t    = (unsigned char *) buf + 1;
-    unsigned char *stop = (unsigned char *) buf + outSize;
+    unsigned char *t1    = out;
+    unsigned char *t2    = out + (count + 1) / 2;
+    size_t         pairs = count / 2;
+    size_t         nb    = (count - 1) / 16;
+    size_t         k     = 0;
 
-    while (t < stop)
+    const uint8x16_t bias = vdupq_n_u8 (0x80);
+
+    for (; k + 16 <= pairs; k += 16)
     {
-        int d = int (t[-1]) + int (t[0]) - 128;
-        t[0] = d;
-        ++t;
+        uint8x16x2_t v = vld2q_u8 (in + 2 * k);
+        vst1q_u8 (t1 + k, v.val[0]);
+        vst1q_u8 (t2 + k, v.val[1]);
     }
-}
 
-#endif
+    splitBytesTail (t1, t2, in, k, count);
 
+    deltaEncodeTail (out, 1 + nb * 16, count);
 
-#ifdef IMF_HAVE_SSE2
+    while (nb-- > 0)
+    {
+        unsigned char *p = out + 1 + nb * 16;
+        uint8x16_t cur = vld1q_u8 (p);
+        uint8x16_t prv = vld1q_u8 (p - 1);
+
+        vst1q_u8 (p, vaddq_u8 (vsubq_u8 (cur, prv), bias));
+    }
+}
 
-static void
-interleave_sse2(const char *source, size_t outSize, char *out)
+void
+reconstructAndInterleave_neon (unsigned char *tmp, size_t count,
+                               unsigned char *out)
 {
-    static const size_t bytesPerChunk = 2*sizeof(__m128i);
+    const unsigned char *t1    = tmp;
+    const unsigned char *t2    = tmp + (count + 1) / 2;
+    size_t               pairs = count / 2;
+    size_t               nb    = (count - 1) / 16;
+    unsigned char       *p     = tmp + 1;
 
-    const size_t vOutSize = outSize / bytesPerChunk;
+    const uint8x16_t zero = vdupq_n_u8 (0);
+    const uint8x16_t bias = vdupq_n_u8 (0x80);
+    uint8x16_t       prev = vdupq_n_u8 (tmp[0]);
 
-    const __m128i *v1 = reinterpret_cast<const __m128i *>(source);
-    const __m128i *v2 = reinterpret_cast<const __m128i *>(source + (outSize + 1) / 2);
-    __m128i *vOut = reinterpret_cast<__m128i *>(out);
+    for (size_t b = 0; b < nb; ++b, p += 16)
+    {
+        uint8x16_t d = vaddq_u8 (vld1q_u8 (p), bias);
 
-    for (size_t i=0; i<vOutSize; ++i) {
-        __m128i a = _mm_loadu_si128(v1++);
-        __m128i b = _mm_loadu_si128(v2++);
+        d = vaddq_u8 (d, vextq_u8 (zero, d, 15));
+        d = vaddq_u8 (d, vextq_u8 (zero, d, 14));
+        d = vaddq_u8 (d, vextq_u8 (zero, d, 12));
+        d = vaddq_u8 (d, vextq_u8 (zero, d, 8));
+        d = vaddq_u8 (d, prev);
 
-        __m128i lo = _mm_unpacklo_epi8(a, b);
-        __m128i hi = _mm_unpackhi_epi8(a, b);
+        vst1q_u8 (p, d);
 
-        _mm_storeu_si128(vOut++, lo);
-        _mm_storeu_si128(vOut++, hi);
+        prev = vdupq_n_u8 (vgetq_lane_u8 (d, 15));
     }
 
-    const char *t1 = reinterpret_cast<const char *>(v1);
-    const char *t2 = reinterpret_cast<const char *>(v2);
-    char *sOut = reinterpret_cast<char *>(vOut);
+    deltaDecodeTail (tmp, 1 + nb * 16, count);
 
-    for (size_t i=vOutSize*bytesPerChunk; i<outSize; ++i)
+    size_t k = 0;
+
+    for (; k + 16 <= pairs; k += 16)
     {
-        *(sOut++) = (i%2==0) ? *(t1++) : *(t2++);
+        uint8x16x2_t v;
+        v.val[0] = vld1q_u8 (t1 + k);
+        v.val[1] = vld1q_u8 (t2 + k);
+        vst2q_u8 (out + 2 * k, v);
     }
+
+    interleaveTail (out, t1, t2, k, count);
 }
 
+#endif // IMF_HAVE_NEON
+
+//
+// Function pointers for dispatching the kernels, defaulting to the
+// best compile time choice and upgraded by Zip::initializeFuncs()
+//
+
+#if defined(IMF_HAVE_SSE2)
+void (*reorderAndPredictFunc) (const unsigned char *, size_t, unsigned char *) =
+    reorderAndPredict_sse2;
+void (*reconstructAndInterleaveFunc) (unsigned char *, size_t, unsigned char *) =
+    reconstructAndInterleave_sse2;
+#elif defined(IMF_HAVE_NEON)
+void (*reorderAndPredictFunc) (const unsigned char *, size_t, unsigned char *) =
+    reorderAndPredict_neon;
+void (*reconstructAndInterleaveFunc) (unsigned char *, size_t, unsigned char *) =
+    reconstructAndInterleave_neon;
 #else
+void (*reorderAndPredictFunc) (const unsigned char *, size_t, unsigned char *) =
+    reorderAndPredict_scalar;
+void (*reconstructAndInterleaveFunc) (unsigned char *, size_t, unsigned char *) =
+    reconstructAndInterleave_scalar;
+#endif
+
+} // namespace
 
-static void
-interleave_scalar(const char *source, size_t outSize, char *out)
+void
+Zip::reorderAndPredict (const char *raw, size_t size, char *out)
 {
-    const char *t1 = source;
-    const char *t2 = source + (outSize + 1) / 2;
-    char *s = out;
-    char *const stop = s + outSize;
+    if (size == 0)
+        return;
 
-    while (true)
-    {
-        if (s < stop)
-            *(s++) = *(t1++);
-        else
-            break;
-
-        if (s < stop)
-            *(s++) = *(t2++);
-        else
-            break;
-    }
+    reorderAndPredictFunc ((const unsigned char *) raw, size,
+                           (unsigned char *) out);
+}
+
+void
+Zip::reconstructAndInterleave (char *tmp, size_t size, char *raw)
+{
+    if (size == 0)
+        return;
+
+    reconstructAndInterleaveFunc ((unsigned char *) tmp, size,
+                                  (unsigned char *) raw);
 }
 
+void
+Zip::initializeFuncs ()
+{
+#ifdef IMF_HAVE_AVX2_TARGET
+    CpuId cpuId;
+
+    if (cpuId.avx2)
+    {
+        reorderAndPredictFunc        = reorderAndPredict_avx2;
+        reconstructAndInterleaveFunc = reconstructAndInterleave_avx2;
+    }
 #endif
+}
 
 int
 Zip::uncompress(const char *compressed, int compressedSize,
@@ -239,13 +642,8 @@ Zip::uncompress(const char *compressed, int compressedSize,
     // Decompress the data using zlib
     //
 
-    uLongf outSize = _maxRawSize;
-
-    if (Z_OK != ::uncompress ((Bytef *)_tmpBuffer, &outSize,
-                     (const Bytef *) compressed, compressedSize))
-    {
-        throw IEX_NAMESPACE::InputExc ("Data decompression (zlib) failed.");
-    }
+    size_t outSize = inflateBuffer (compressed, compressedSize,
+                                    _tmpBuffer, _maxRawSize);
 
     if (outSize == 0)
     {
@@ -253,22 +651,10 @@ Zip::uncompress(const char *compressed, int compressedSize,
     }
 
     //
-    // Predictor.
+    // Predictor and reorder the pixel data.
     //
-#ifdef IMF_HAVE_SSE4_1
-    reconstruct_sse41(_tmpBuffer, outSize);
-#else
-    reconstruct_scalar(_tmpBuffer, outSize);
-#endif
 
-    //
-    // Reorder the pixel data.
-    //
-#ifdef IMF_HAVE_SSE2
-    interleave_sse2(_tmpBuffer, outSize, raw);
-#else
-    interleave_scalar(_tmpBuffer, outSize, raw);
-#endif
+    reconstructAndInterleave (_tmpBuffer, outSize, raw);
 
     return outSize;
 }
@@ -7,6 +7,7 @@
 #define INCLUDED_IMF_ZIP_H
 
 #include "ImfNamespace.h"
+#include "ImfForward.h"
 #include "ImfExport.h"
 
 #include <cstddef>
@@ -16,8 +17,12 @@ OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
 class Zip
 {
     public:
-        explicit Zip(size_t rawMaxSize);
-        Zip(size_t maxScanlineSize, size_t numScanLines);
+        //
+        // level is the zlib compression level used by compress(),
+        // 0 to 9, or -1 for the default level.
+        //
+        explicit Zip(size_t rawMaxSize, int level = -1);
+        Zip(size_t maxScanlineSize, size_t numScanLines, int level = -1);
         ~Zip();
 
         Zip (const Zip& other) = delete;
@@ -41,9 +46,54 @@ class Zip
         int uncompress(const char *compressed, int compressedSize,
                                                  char *raw);
 
+        //
+        // The zlib compression level requested by a file header: the
+        // value of its zipCompressionLevel attribute, or -1 if there
+        // is none.  Out of range values are ignored, like in Core, so
+        // that files which carry one can still be read.
+        //
+        static int headerLevel(const Header &hdr);
+
+        //
+        // Deflate / inflate a buffer to / from the zlib stream format,
+        // without any reordering or prediction, using the deflate
+        // implementation the library was built with (zlib, or
+        // libdeflate if OPENEXR_USE_LIBDEFLATE was enabled). Both
+        // return the number of bytes written to out, and throw if out
+        // is too small or the compressed data is corrupt.
+        //
+        static size_t deflateBuffer(int level,
+                                    const char *in, size_t inSize,
+                                    char *out, size_t outSize);
+
+        static size_t inflateBuffer(const char *in, size_t inSize,
+                                    char *out, size_t outSize);
+
+        //
+        // The byte reordering and delta predictor applied before
+        // deflate, shared with the RLE compressor.  reorderAndPredict
+        // splits the even and odd bytes of raw into the two halves of
+        // out, and replaces each byte by its difference to the
+        // previous one.  reconstructAndInterleave undoes this,
+        // modifying tmp in place.  Both use the fastest implementation
+        // the cpu supports.
+        //
+        IMF_EXPORT static void reorderAndPredict(const char *raw, size_t size,
+                                                 char *out);
+
+        IMF_EXPORT static void reconstructAndInterleave(char *tmp, size_t size,
+                                                        char *raw);
+
+        //
+        // Select the SIMD implementations using CpuId, called from
+        // staticInitialize().
+        //
+        IMF_EXPORT static void initializeFuncs();
+
     private:
         size_t _maxRawSize;
         char  *_tmpBuffer;
+        int    _level;
 };
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
@@ -47,6 +47,40 @@ atomic_compare_exchange_strong (
 
 /**************************************/
 
+/* When the file is memory mapped, let the OS know how the chunks are
+ * laid out: if they are stored in increasing order, reading the image
+ * walks the file front to back, so read ahead is beneficial,
+ * otherwise, avoid faulting in pages that won't be needed yet */
+static void
+advise_chunk_access (
+    const struct _internal_exr_context* ctxt,
+    const struct _internal_exr_part*    part,
+    const uint64_t*                     ctable)
+{
+    uint64_t minoff = UINT64_MAX;
+    int      sorted = 1;
+
+    for (int c = 0; c < part->chunk_count; ++c)
+    {
+        uint64_t off = ctable[c];
+        if (off < minoff) minoff = off;
+        if (c > 0 && off < ctable[c - 1]) sorted = 0;
+    }
+
+    if (minoff >= ctxt->mapped_size) return;
+
+    /* the last chunk runs until the end of the chunk data, which is
+     * not known without reading the chunk, so include the rest of
+     * the file */
+    ctxt->advise_fn (
+        ctxt,
+        minoff,
+        ctxt->mapped_size - minoff,
+        sorted ? EXR_ACCESS_SEQUENTIAL : EXR_ACCESS_RANDOM);
+}
+
+/**************************************/
+
 static exr_result_t
 extract_chunk_table (
     const struct _internal_exr_context* ctxt,
@@ -83,6 +117,8 @@ extract_chunk_table (
         }
         priv_to_native64 (ctable, part->chunk_count);
 
+        if (ctxt->advise_fn) advise_chunk_access (ctxt, part, ctable);
+
         //EXR_GETFILE(f)->report_error( ctxt, EXR_ERR_UNKNOWN, "TODO: implement reconstructLineOffsets and similar" );
         nptr = (uintptr_t) ctable;
         // see if we win or not
@@ -860,21 +896,12 @@ exr_read_tile_chunk_info (
 }
 
 exr_result_t
-exr_read_chunk (
-    exr_const_context_t     ctxt,
-    int                     part_index,
-    const exr_chunk_info_t* cinfo,
-    void*                   packed_data)
+internal_validate_chunk_read (
+    const struct _internal_exr_context* pctxt,
+    const struct _internal_exr_part*    part,
+    const exr_chunk_info_t*             cinfo)
 {
-    exr_result_t                 rv;
-    uint64_t                     dataoffset, toread;
-    int64_t                      nread;
-    enum _INTERNAL_EXR_READ_MODE rmode = EXR_MUST_READ_ALL;
-    EXR_PROMOTE_READ_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
-
-    if (!cinfo) return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
-    if (cinfo->packed_size > 0 && !packed_data)
-        return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
+    uint64_t dataoffset;
 
     if (cinfo->idx < 0 || cinfo->idx >= part->chunk_count)
         return pctxt->print_error (
@@ -904,6 +931,33 @@ exr_read_chunk (
             dataoffset,
             pctxt->file_size);
 
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+exr_result_t
+exr_read_chunk (
+    exr_const_context_t     ctxt,
+    int                     part_index,
+    const exr_chunk_info_t* cinfo,
+    void*                   packed_data)
+{
+    exr_result_t                 rv;
+    uint64_t                     dataoffset, toread;
+    int64_t                      nread;
+    enum _INTERNAL_EXR_READ_MODE rmode = EXR_MUST_READ_ALL;
+    EXR_PROMOTE_READ_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
+
+    if (!cinfo) return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
+    if (cinfo->packed_size > 0 && !packed_data)
+        return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
+
+    rv = internal_validate_chunk_read (pctxt, part, cinfo);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    dataoffset = cinfo->data_offset;
+
     /* allow a short read if uncompressed */
     if (part->comp_type == EXR_COMPRESSION_NONE) rmode = EXR_ALLOW_SHORT_READ;
 
@@ -928,6 +982,205 @@ exr_read_chunk (
 
 /**************************************/
 
+exr_result_t
+exr_read_chunk_mapped (
+    exr_const_context_t     ctxt,
+    int                     part_index,
+    const exr_chunk_info_t* cinfo,
+    const void**            packed_data)
+{
+    exr_result_t rv;
+    EXR_PROMOTE_READ_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
+
+    if (!cinfo || !packed_data)
+        return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
+
+    *packed_data = NULL;
+    if (!pctxt->mapped_data)
+        return pctxt->report_error (
+            pctxt, EXR_ERR_NOT_OPEN_READ, "File is not memory mapped");
+
+    rv = internal_validate_chunk_read (pctxt, part, cinfo);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    /* unlike a normal read, a truncated chunk can not be zero filled */
+    if (cinfo->data_offset > pctxt->mapped_size ||
+        cinfo->packed_size > pctxt->mapped_size - cinfo->data_offset)
+        return pctxt->print_error (
+            pctxt,
+            EXR_ERR_READ_IO,
+            "chunk data (%" PRIu64 " bytes at offset %" PRIu64
+            ") extends past end of file (%" PRIu64 ")",
+            cinfo->packed_size,
+            cinfo->data_offset,
+            pctxt->mapped_size);
+
+    *packed_data = pctxt->mapped_data + cinfo->data_offset;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+/* chunks whose data is separated by no more than this many bytes
+ * (i.e. the chunk leader) are merged into a single read */
+#define EXR_READ_CHUNKS_MAX_GAP 4096
+/* upper bound on the size of a merged read */
+#define EXR_READ_CHUNKS_MAX_SPAN (16 * 1024 * 1024)
+
+typedef struct
+{
+    uint64_t offset;
+    uint64_t size;
+    int      idx;
+} chunk_read_range_t;
+
+exr_result_t
+exr_read_chunks (
+    exr_const_context_t     ctxt,
+    int                     part_index,
+    int                     count,
+    const exr_chunk_info_t* cinfos,
+    void* const*            packed_data)
+{
+    exr_result_t        rv = EXR_ERR_SUCCESS;
+    chunk_read_range_t* ranges;
+    uint8_t*            tmpbuf  = NULL;
+    uint64_t            tmpsz   = 0;
+    int                 nranges = 0;
+    EXR_PROMOTE_READ_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
+
+    if (count < 0 || (count > 0 && (!cinfos || !packed_data)))
+        return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (cinfos[i].packed_size > 0 && !packed_data[i])
+            return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
+
+        rv = internal_validate_chunk_read (pctxt, part, cinfos + i);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+    }
+
+    /* memory mapped reads are already just a copy, nothing to merge */
+    if (pctxt->mapped_data)
+    {
+        for (int i = 0; rv == EXR_ERR_SUCCESS && i < count; ++i)
+            rv = exr_read_chunk (ctxt, part_index, cinfos + i, packed_data[i]);
+        return rv;
+    }
+
+    ranges = (chunk_read_range_t*) pctxt->alloc_fn (
+        sizeof (chunk_read_range_t) * (size_t) (count > 0 ? count : 1));
+    if (!ranges) return pctxt->standard_error (pctxt, EXR_ERR_OUT_OF_MEMORY);
+
+    /* sort by file offset. Requests are typically already in (or close
+     * to) file order, where an insertion sort is linear */
+    for (int i = 0; i < count; ++i)
+    {
+        chunk_read_range_t cur;
+        int                j;
+
+        if (cinfos[i].packed_size == 0) continue;
+
+        cur.offset = cinfos[i].data_offset;
+        cur.size   = cinfos[i].packed_size;
+        cur.idx    = i;
+
+        j = nranges - 1;
+        while (j >= 0 && ranges[j].offset > cur.offset)
+        {
+            ranges[j + 1] = ranges[j];
+            --j;
+        }
+        ranges[j + 1] = cur;
+        ++nranges;
+    }
+
+    for (int r = 0; rv == EXR_ERR_SUCCESS && r < nranges;)
+    {
+        uint64_t start = ranges[r].offset;
+        uint64_t end   = start + ranges[r].size;
+        uint64_t dataoffset, span;
+        int64_t  nread = 0;
+        int      last  = r + 1;
+
+        while (last < nranges && ranges[last].offset >= end &&
+               (ranges[last].offset - end) <= EXR_READ_CHUNKS_MAX_GAP &&
+               (ranges[last].offset + ranges[last].size - start) <=
+                   EXR_READ_CHUNKS_MAX_SPAN)
+        {
+            end = ranges[last].offset + ranges[last].size;
+            ++last;
+        }
+
+        if (last == r + 1)
+        {
+            /* nothing adjacent, read straight into the destination */
+            rv = exr_read_chunk (
+                ctxt,
+                part_index,
+                cinfos + ranges[r].idx,
+                packed_data[ranges[r].idx]);
+            r = last;
+            continue;
+        }
+
+        span = end - start;
+        if (span > tmpsz)
+        {
+            if (tmpbuf) pctxt->free_fn (tmpbuf);
+            tmpbuf = (uint8_t*) pctxt->alloc_fn ((size_t) span);
+            tmpsz  = span;
+            if (!tmpbuf)
+            {
+                tmpsz = 0;
+                rv    = pctxt->standard_error (pctxt, EXR_ERR_OUT_OF_MEMORY);
+                break;
+            }
+        }
+
+        /* the tail of the file may be truncated, which is handled per
+         * chunk below */
+        dataoffset = start;
+        rv         = pctxt->do_read (
+            pctxt, tmpbuf, span, &dataoffset, &nread, EXR_ALLOW_SHORT_READ);
+        if (rv != EXR_ERR_SUCCESS) break;
+
+        for (; r < last; ++r)
+        {
+            uint64_t rel   = ranges[r].offset - start;
+            uint64_t avail = 0;
+            uint8_t* dst   = (uint8_t*) packed_data[ranges[r].idx];
+
+            if ((uint64_t) nread > rel) avail = (uint64_t) nread - rel;
+            if (avail > ranges[r].size) avail = ranges[r].size;
+
+            if (avail < ranges[r].size)
+            {
+                /* allow a short read if uncompressed, same as exr_read_chunk */
+                if (part->comp_type != EXR_COMPRESSION_NONE)
+                {
+                    rv = pctxt->print_error (
+                        pctxt,
+                        EXR_ERR_READ_IO,
+                        "Unable to read %" PRIu64 " bytes for chunk %d",
+                        ranges[r].size,
+                        cinfos[ranges[r].idx].idx);
+                    break;
+                }
+                memset (dst + avail, 0, ranges[r].size - avail);
+            }
+            if (avail > 0) memcpy (dst, tmpbuf + rel, avail);
+        }
+    }
+
+    if (tmpbuf) pctxt->free_fn (tmpbuf);
+    pctxt->free_fn (ranges);
+    return rv;
+}
+
+/**************************************/
+
 exr_result_t
 exr_read_deep_chunk (
     exr_const_context_t     ctxt,
@@ -154,7 +154,7 @@ internal_encode_free_buffer (
                 EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (
                     encode->context, encode->part_index);
 
-                pctxt->free_fn (curbuf);
+                internal_exr_pool_release (pctxt, curbuf, cursz);
             }
         }
         *buf = NULL;
@@ -195,7 +195,7 @@ internal_encode_alloc_buffer (
             EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (
                 encode->context, encode->part_index);
 
-            curbuf = pctxt->alloc_fn (newsz);
+            curbuf = internal_exr_pool_acquire (pctxt, newsz, &newsz);
         }
 
         if (curbuf == NULL)
@@ -236,7 +236,7 @@ internal_decode_free_buffer (
                 EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (
                     decode->context, decode->part_index);
 
-                pctxt->free_fn (curbuf);
+                internal_exr_pool_release (pctxt, curbuf, cursz);
             }
         }
         *buf = NULL;
@@ -265,7 +265,7 @@ internal_decode_alloc_buffer (
             EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (
                 decode->context, decode->part_index);
 
-            curbuf = pctxt->alloc_fn (newsz);
+            curbuf = internal_exr_pool_acquire (pctxt, newsz, &newsz);
         }
 
         if (curbuf == NULL)
@@ -395,6 +395,32 @@ exr_get_user_data (exr_const_context_t ctxt, void** userdata)
 
 /**************************************/
 
+exr_result_t
+exr_get_buffer_pool_stats (
+    exr_const_context_t ctxt, exr_buffer_pool_stats_t* stats)
+{
+    INTERN_EXR_PROMOTE_CONST_CONTEXT_OR_ERROR (ctxt);
+
+    if (!stats) return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
+
+    /* the pool has its own lock, the context one is not needed */
+    internal_exr_pool_stats (pctxt, stats);
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+exr_result_t
+exr_trim_buffer_pool (exr_const_context_t ctxt)
+{
+    INTERN_EXR_PROMOTE_CONST_CONTEXT_OR_ERROR (ctxt);
+
+    internal_exr_pool_trim (pctxt);
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
 exr_result_t
 exr_register_attr_type_handler (
     exr_context_t ctxt,
@@ -184,6 +184,27 @@ default_read_chunk (exr_decode_pipeline_t* decode)
                 decode->packed_sample_count_table);
         }
     }
+    else if (
+        pctxt->mapped_data &&
+        decode->chunk.data_offset <= pctxt->mapped_size &&
+        decode->chunk.packed_size <=
+            pctxt->mapped_size - decode->chunk.data_offset)
+    {
+        const void* mapped = NULL;
+
+        /* point straight at the file data, avoiding the copy. A
+         * truncated chunk takes the path below, which may zero fill */
+        rv = exr_read_chunk_mapped (
+            decode->context, decode->part_index, &(decode->chunk), &mapped);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+
+        internal_decode_free_buffer (
+            decode,
+            EXR_TRANSCODE_BUFFER_PACKED,
+            &(decode->packed_buffer),
+            &(decode->packed_alloc_size));
+        decode->packed_buffer = EXR_CONST_CAST (void*, mapped);
+    }
     else
     {
         rv = internal_decode_alloc_buffer (
@@ -203,6 +224,19 @@ default_read_chunk (exr_decode_pipeline_t* decode)
     return rv;
 }
 
+/* the maximum number of reads exr_decoding_read_chunks_async will
+ * have outstanding at any one time */
+#define EXR_ASYNC_READ_QUEUE_DEPTH 32
+
+/* the packed data has already been read ahead of running the pipeline */
+static exr_result_t
+preloaded_read_chunk (exr_decode_pipeline_t* decode)
+{
+    /* any subsequent chunk needs to be read as normal */
+    decode->read_fn = &default_read_chunk;
+    return EXR_ERR_SUCCESS;
+}
+
 static exr_result_t
 decompress_data (
     const struct _internal_exr_context* pctxt,
@@ -613,6 +647,289 @@ exr_decoding_update (
         decode->channels, decode->channel_count, cinfo, pctxt, part);
     decode->chunk = *cinfo;
 
+    /* any data read ahead was for the previous chunk */
+    if (decode->read_fn == &preloaded_read_chunk)
+        decode->read_fn = &default_read_chunk;
+
+    return rv;
+}
+
+/**************************************/
+
+static exr_result_t
+validate_decoder_set (
+    const struct _internal_exr_context* pctxt,
+    exr_const_context_t                 ctxt,
+    int                                 part_index,
+    int                                 count,
+    exr_decode_pipeline_t* const*       decoders)
+{
+    if (count < 0 || (count > 0 && !decoders))
+        return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
+
+    for (int i = 0; i < count; ++i)
+    {
+        const exr_decode_pipeline_t* decode = decoders[i];
+        if (!decode || decode->context != ctxt ||
+            decode->part_index != part_index)
+            return pctxt->report_error (
+                pctxt,
+                EXR_ERR_INVALID_ARGUMENT,
+                "Invalid request for decoding read from different context / part");
+    }
+    return EXR_ERR_SUCCESS;
+}
+
+/* deep chunks also need their sample tables, and reads from a memory
+ * mapped file are already zero copy, so leave those to the normal
+ * read path */
+static int
+can_preload_part (
+    const struct _internal_exr_context* pctxt,
+    const struct _internal_exr_part*    part)
+{
+    return !pctxt->mapped_data &&
+           part->storage_mode != EXR_STORAGE_DEEP_SCANLINE &&
+           part->storage_mode != EXR_STORAGE_DEEP_TILED;
+}
+
+/* only pipelines using the default read routine can have their data
+ * read on their behalf */
+static int
+can_preload_chunk (const exr_decode_pipeline_t* decode)
+{
+    return decode->read_fn == &default_read_chunk &&
+           decode->chunk.packed_size > 0;
+}
+
+static exr_result_t
+alloc_preload_buffer (exr_decode_pipeline_t* decode)
+{
+    if (decode->unpacked_buffer == decode->packed_buffer &&
+        decode->unpacked_alloc_size == 0)
+        decode->unpacked_buffer = NULL;
+
+    return internal_decode_alloc_buffer (
+        decode,
+        EXR_TRANSCODE_BUFFER_PACKED,
+        &(decode->packed_buffer),
+        &(decode->packed_alloc_size),
+        decode->chunk.packed_size);
+}
+
+/**************************************/
+
+exr_result_t
+exr_decoding_read_chunks (
+    exr_const_context_t           ctxt,
+    int                           part_index,
+    int                           count,
+    exr_decode_pipeline_t* const* decoders)
+{
+    exr_result_t      rv;
+    exr_chunk_info_t* cinfos;
+    void**            bufs;
+    int*              which;
+    int               n = 0;
+    EXR_PROMOTE_READ_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
+
+    rv = validate_decoder_set (pctxt, ctxt, part_index, count, decoders);
+    if (rv != EXR_ERR_SUCCESS || count == 0 || !can_preload_part (pctxt, part))
+        return rv;
+
+    cinfos = (exr_chunk_info_t*) pctxt->alloc_fn (
+        (size_t) count *
+        (sizeof (exr_chunk_info_t) + sizeof (void*) + sizeof (int)));
+    if (!cinfos) return pctxt->standard_error (pctxt, EXR_ERR_OUT_OF_MEMORY);
+    bufs  = (void**) (cinfos + count);
+    which = (int*) (bufs + count);
+
+    for (int i = 0; i < count; ++i)
+    {
+        exr_decode_pipeline_t* decode = decoders[i];
+
+        if (!can_preload_chunk (decode)) continue;
+
+        rv = alloc_preload_buffer (decode);
+        if (rv != EXR_ERR_SUCCESS) break;
+
+        cinfos[n] = decode->chunk;
+        bufs[n]   = decode->packed_buffer;
+        which[n]  = i;
+        ++n;
+    }
+
+    if (rv == EXR_ERR_SUCCESS)
+        rv = exr_read_chunks (ctxt, part_index, n, cinfos, bufs);
+
+    if (rv == EXR_ERR_SUCCESS)
+    {
+        for (int i = 0; i < n; ++i)
+            decoders[which[i]]->read_fn = &preloaded_read_chunk;
+    }
+
+    pctxt->free_fn (cinfos);
+    return rv;
+}
+
+/**************************************/
+
+/* submits the read of the packed data for a pipeline, if the
+ * provider is not able to queue the request, queued is left 0 and the
+ * pipeline will just read the data when it is run */
+static exr_result_t
+submit_async_read (
+    const struct _internal_exr_context* pctxt,
+    const struct _internal_exr_part*    part,
+    exr_decode_pipeline_t*              decode,
+    exr_async_read_request_t*           req,
+    int*                                queued)
+{
+    exr_result_t rv;
+
+    *queued = 0;
+    rv      = alloc_preload_buffer (decode);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    rv = internal_validate_chunk_read (pctxt, part, &(decode->chunk));
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    req->buffer        = decode->packed_buffer;
+    req->size          = decode->chunk.packed_size;
+    req->offset        = decode->chunk.data_offset;
+    req->nread         = -1;
+    req->provider_data = NULL;
+
+    rv = pctxt->read_async_fn (
+        (exr_const_context_t) pctxt,
+        pctxt->user_data,
+        req,
+        (exr_stream_error_func_ptr_t) pctxt->print_error);
+    if (rv == EXR_ERR_SUCCESS) *queued = 1;
+
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+complete_async_read (
+    const struct _internal_exr_context* pctxt,
+    const struct _internal_exr_part*    part,
+    exr_decode_pipeline_t*              decode,
+    const exr_async_read_request_t*     req)
+{
+    if (req->nread != (int64_t) req->size)
+    {
+        /* allow a short read if uncompressed, as exr_read_chunk does */
+        if (part->comp_type != EXR_COMPRESSION_NONE || req->nread < 0)
+            return pctxt->print_error (
+                pctxt,
+                EXR_ERR_READ_IO,
+                "Unable to read chunk %d (%" PRIu64 " bytes at offset %" PRIu64
+                ")",
+                decode->chunk.idx,
+                req->size,
+                req->offset);
+
+        memset (
+            ((uint8_t*) req->buffer) + req->nread,
+            0,
+            req->size - (uint64_t) req->nread);
+    }
+
+    decode->read_fn = &preloaded_read_chunk;
+    return EXR_ERR_SUCCESS;
+}
+
+exr_result_t
+exr_decoding_read_chunks_async (
+    exr_const_context_t           ctxt,
+    int                           part_index,
+    int                           count,
+    exr_decode_pipeline_t* const* decoders,
+    exr_decoding_ready_func_ptr_t ready_fn,
+    void*                         ready_userdata)
+{
+    exr_result_t              rv, crv;
+    exr_async_read_request_t  slots[EXR_ASYNC_READ_QUEUE_DEPTH];
+    exr_async_read_request_t* freeslots[EXR_ASYNC_READ_QUEUE_DEPTH];
+    exr_async_read_request_t* pending[EXR_ASYNC_READ_QUEUE_DEPTH];
+    int                       which[EXR_ASYNC_READ_QUEUE_DEPTH];
+    int                       nfree = 0, npending = 0, next = 0;
+    int                       async, queued, done;
+    EXR_PROMOTE_READ_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
+
+    if (!ready_fn)
+        return pctxt->standard_error (pctxt, EXR_ERR_INVALID_ARGUMENT);
+    rv = validate_decoder_set (pctxt, ctxt, part_index, count, decoders);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    async = pctxt->read_async_fn && pctxt->wait_async_fn &&
+            can_preload_part (pctxt, part);
+
+    for (int i = 0; i < EXR_ASYNC_READ_QUEUE_DEPTH; ++i)
+        freeslots[nfree++] = slots + i;
+
+    while (npending > 0 || (rv == EXR_ERR_SUCCESS && next < count))
+    {
+        /* keep the queue full, handing off anything which will read
+         * its own data immediately */
+        while (rv == EXR_ERR_SUCCESS && next < count && nfree > 0)
+        {
+            exr_decode_pipeline_t* decode = decoders[next++];
+
+            queued = 0;
+            crv    = EXR_ERR_SUCCESS;
+            if (async && can_preload_chunk (decode))
+                crv = submit_async_read (
+                    pctxt, part, decode, freeslots[nfree - 1], &queued);
+
+            if (queued)
+            {
+                pending[npending] = freeslots[--nfree];
+                which[npending]   = next - 1;
+                ++npending;
+            }
+            else
+                rv = ready_fn (decode, crv, ready_userdata);
+        }
+
+        if (npending == 0) continue;
+
+        crv = pctxt->wait_async_fn (
+            ctxt,
+            pctxt->user_data,
+            pending,
+            npending,
+            &done,
+            (exr_stream_error_func_ptr_t) pctxt->print_error);
+        if (crv == EXR_ERR_SUCCESS && (done < 0 || done >= npending))
+            crv = pctxt->report_error (
+                pctxt,
+                EXR_ERR_READ_IO,
+                "Invalid completion index from asynchronous read");
+        if (crv != EXR_ERR_SUCCESS)
+        {
+            /* the provider is responsible for any outstanding requests */
+            if (rv == EXR_ERR_SUCCESS) rv = crv;
+            break;
+        }
+
+        {
+            exr_decode_pipeline_t* decode = decoders[which[done]];
+
+            crv = complete_async_read (pctxt, part, decode, pending[done]);
+
+            freeslots[nfree++] = pending[done];
+            --npending;
+            pending[done] = pending[npending];
+            which[done]   = which[npending];
+
+            /* once an error has been returned, only drain the queue */
+            if (rv == EXR_ERR_SUCCESS)
+                rv = ready_fn (decode, crv, ready_userdata);
+        }
+    }
+
     return rv;
 }
 
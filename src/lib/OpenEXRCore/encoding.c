@@ -190,7 +190,10 @@ exr_result_t
 exr_encoding_choose_default_routines (
     exr_const_context_t ctxt, int part_index, exr_encode_pipeline_t* encode)
 {
-    int32_t isdeep = 0;
+    int32_t isdeep = 0, chanstopack = 0, sametype = -2, sameintype = -2,
+            samebpc = 0, sameinbpc = 0, hassampling = 0, hastypechange = 0,
+            simpinterleave = 0, simpinterleaverev = 0, sameininc = 0;
+    const uint8_t* interleaveptr = NULL;
     EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR (ctxt, part_index);
     if (!encode)
         return EXR_UNLOCK_WRITE_AND_RETURN_PCTXT (
@@ -207,7 +210,90 @@ exr_encoding_choose_default_routines (
                  ? 1
                  : 0;
 
-    encode->convert_and_pack_fn = internal_exr_match_encode (encode, isdeep);
+    /*
+     * the layout of the source pointers is only inspected here, the
+     * same as for decoding, so later chunks are expected to provide
+     * their data with the same layout
+     */
+    for (int c = 0; c < encode->channel_count; ++c)
+    {
+        const exr_coding_channel_info_t* encc = (encode->channels + c);
+
+        if (encc->height == 0 || !encc->encode_from_ptr) continue;
+
+        if (sametype == -2)
+            sametype = (int32_t) encc->data_type;
+        else if (sametype != (int32_t) encc->data_type)
+            sametype = -1;
+
+        if (sameintype == -2)
+            sameintype = (int32_t) encc->user_data_type;
+        else if (sameintype != (int32_t) encc->user_data_type)
+            sameintype = -1;
+
+        if (samebpc == 0)
+            samebpc = encc->bytes_per_element;
+        else if (samebpc != encc->bytes_per_element)
+            samebpc = -1;
+
+        if (sameinbpc == 0)
+            sameinbpc = encc->user_bytes_per_element;
+        else if (sameinbpc != encc->user_bytes_per_element)
+            sameinbpc = -1;
+
+        if (encc->x_samples != 1 || encc->y_samples != 1) hassampling = 1;
+
+        ++chanstopack;
+        if (encc->user_data_type != encc->data_type) ++hastypechange;
+
+        if (simpinterleave == 0)
+        {
+            interleaveptr     = encc->encode_from_ptr;
+            simpinterleave    = encc->user_pixel_stride;
+            simpinterleaverev = encc->user_pixel_stride;
+        }
+        else
+        {
+            if (simpinterleave > 0 &&
+                encc->encode_from_ptr !=
+                    (interleaveptr + c * encc->user_bytes_per_element))
+            {
+                simpinterleave = -1;
+            }
+            if (simpinterleaverev > 0 &&
+                encc->encode_from_ptr !=
+                    (interleaveptr - c * encc->user_bytes_per_element))
+            {
+                simpinterleaverev = -1;
+            }
+            if (simpinterleave < 0 && simpinterleaverev < 0)
+                interleaveptr = NULL;
+        }
+
+        if (sameininc == 0)
+            sameininc = encc->user_pixel_stride;
+        else if (sameininc != encc->user_pixel_stride)
+            sameininc = -1;
+    }
+
+    if (simpinterleave != sameinbpc * encode->channel_count)
+        simpinterleave = -1;
+    if (simpinterleaverev != sameinbpc * encode->channel_count)
+        simpinterleaverev = -1;
+
+    encode->convert_and_pack_fn = internal_exr_match_encode (
+        encode,
+        isdeep,
+        chanstopack,
+        sametype,
+        sameintype,
+        samebpc,
+        sameinbpc,
+        hassampling,
+        hastypechange,
+        sameininc,
+        simpinterleave,
+        simpinterleaverev);
     if (part->comp_type != EXR_COMPRESSION_NONE)
         encode->compress_fn = &default_compress_chunk;
     encode->yield_until_ready_fn = &default_yield;
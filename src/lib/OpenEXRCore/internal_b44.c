@@ -7,6 +7,7 @@
 #include "internal_decompress.h"
 
 #include "internal_coding.h"
+#include "internal_cpuid.h"
 #include "internal_xdr.h"
 
 #include <string.h>
@@ -17,16 +18,16 @@ extern const uint16_t* exrcore_expTable;
 extern const uint16_t* exrcore_logTable;
 
 static inline void
-convertFromLinear (uint16_t s[16])
+convertFromLinear (uint16_t* s, uint64_t n)
 {
-    for (int i = 0; i < 16; ++i)
+    for (uint64_t i = 0; i < n; ++i)
         s[i] = exrcore_expTable[s[i]];
 }
 
 static inline void
-convertToLinear (uint16_t s[16])
+convertToLinear (uint16_t* s, uint64_t n)
 {
-    for (int i = 0; i < 16; ++i)
+    for (uint64_t i = 0; i < n; ++i)
         s[i] = exrcore_logTable[s[i]];
 }
 
@@ -298,6 +299,1071 @@ unpack3 (const uint8_t b[3], uint16_t s[16])
 
 /**************************************/
 
+/*
+ * The block kernels. pack_blocks compresses nblocks 4x4 blocks whose
+ * rows start at rows[0] ... rows[3], and returns the number of bytes
+ * written. unpack_blocks uncompresses nblocks blocks into the rows,
+ * and returns the number of bytes read, or -1 if the input is too
+ * short. The scalar versions, built from pack, unpack14 and unpack3
+ * above, are the reference: SSE2 and NEON are chosen at compile time
+ * and transform one whole block at a time, AVX2 is chosen at runtime
+ * (see internal_cpuid.h) and does two blocks at a time. They all give
+ * exactly the same results.
+ *
+ * The vector versions hold rows 0 and 1 of a block in one vector and
+ * rows 2 and 3 in another, one row per 64-bit lane. The fields of a
+ * packed block, the shift and r[0] ... r[14], are stored as four
+ * big-endian groups of 24 bits, where group j holds the differences
+ * for column j of the block: the one down the first column (or the
+ * shift) at bit 18, then the ones along rows 0 to 3.
+ */
+
+static inline uint32_t
+read_be24 (const uint8_t* b)
+{
+    return ((uint32_t) b[0] << 16) | ((uint32_t) b[1] << 8) | (uint32_t) b[2];
+}
+
+#if !defined(IMF_HAVE_SSE2) && !defined(IMF_HAVE_NEON)
+
+static int
+pack_blocks_scalar (
+    const uint16_t* const rows[4],
+    int                   nblocks,
+    uint8_t*              out,
+    int                   flatfields,
+    int                   exactmax)
+{
+    uint8_t* start = out;
+    uint16_t s[16];
+
+    for (int i = 0; i < nblocks; ++i)
+    {
+        for (int r = 0; r < 4; ++r)
+            memcpy (&s[4 * r], rows[r] + 4 * i, 4 * sizeof (uint16_t));
+
+        out += pack (s, out, flatfields, exactmax);
+    }
+    return (int) (out - start);
+}
+
+static int
+unpack_blocks_scalar (
+    const uint8_t* in, uint64_t insize, int nblocks, uint16_t* const rows[4])
+{
+    const uint8_t* start = in;
+    uint16_t       s[16];
+
+    for (int i = 0; i < nblocks; ++i)
+    {
+        if (insize < 3) return -1;
+
+        if (in[2] >= (13 << 2))
+        {
+            unpack3 (in, s);
+            in += 3;
+            insize -= 3;
+        }
+        else
+        {
+            if (insize < 14) return -1;
+            unpack14 (in, s);
+            in += 14;
+            insize -= 14;
+        }
+
+        for (int r = 0; r < 4; ++r)
+            memcpy (rows[r] + 4 * i, &s[4 * r], 4 * sizeof (uint16_t));
+    }
+    return (int) (in - start);
+}
+
+#endif
+
+/**************************************/
+
+#if defined(IMF_HAVE_SSE2)
+
+static inline __m128i
+unsigned_max_sse2 (__m128i t0, __m128i t1)
+{
+    const __m128i sign = _mm_set1_epi16 ((short) 0x8000);
+    __m128i       m =
+        _mm_max_epi16 (_mm_xor_si128 (t0, sign), _mm_xor_si128 (t1, sign));
+
+    m = _mm_max_epi16 (m, _mm_shuffle_epi32 (m, _MM_SHUFFLE (1, 0, 3, 2)));
+    m = _mm_max_epi16 (m, _mm_shuffle_epi32 (m, _MM_SHUFFLE (2, 3, 0, 1)));
+    m = _mm_max_epi16 (m, _mm_shufflelo_epi16 (m, _MM_SHUFFLE (2, 3, 0, 1)));
+    m = _mm_shuffle_epi32 (_mm_shufflelo_epi16 (m, 0), 0);
+    return _mm_xor_si128 (m, sign);
+}
+
+/* the t[] of pack, ordered integers with NaNs and infinities as 0 */
+static inline __m128i
+ordered_bits_sse2 (__m128i s)
+{
+    const __m128i sign = _mm_set1_epi16 ((short) 0x8000);
+    const __m128i expo = _mm_set1_epi16 (0x7c00);
+    __m128i t = _mm_xor_si128 (s, _mm_or_si128 (_mm_srai_epi16 (s, 15), sign));
+    __m128i infnan = _mm_cmpeq_epi16 (_mm_and_si128 (s, expo), expo);
+
+    return _mm_or_si128 (
+        _mm_andnot_si128 (infnan, t), _mm_and_si128 (infnan, sign));
+}
+
+/* back from ordered integers to the sign-magnitude bit patterns */
+static inline __m128i
+sign_magnitude_sse2 (__m128i t)
+{
+    const __m128i sign = _mm_set1_epi16 ((short) 0x8000);
+    __m128i       neg  = _mm_srai_epi16 (t, 15);
+
+    return _mm_andnot_si128 (
+        _mm_and_si128 (neg, sign),
+        _mm_xor_si128 (t, _mm_xor_si128 (neg, _mm_set1_epi16 (-1))));
+}
+
+/* shiftAndRound of all the differences x, shift > 0 */
+static inline __m128i
+shift_and_round_sse2 (__m128i x, int shift)
+{
+    __m128i q   = _mm_srl_epi16 (x, _mm_cvtsi32_si128 (shift));
+    __m128i rem = _mm_and_si128 (x, _mm_set1_epi16 ((short) ((1 << shift) - 1)));
+    __m128i odd = _mm_and_si128 (q, _mm_set1_epi16 (1));
+    __m128i up  = _mm_cmpgt_epi16 (
+        _mm_add_epi16 (rem, odd), _mm_set1_epi16 ((short) (1 << (shift - 1))));
+
+    return _mm_sub_epi16 (q, up);
+}
+
+/*
+ * The running differences, unbiased: along the rows in r[0] and r[1]
+ * (lanes 0, 1, 2 of each row), down the first column in r[2] (lanes
+ * 0 and 4) and r[3] (lane 0)
+ */
+static inline void
+running_diffs_sse2 (__m128i d0, __m128i d1, __m128i r[4])
+{
+    r[0] = _mm_sub_epi16 (d0, _mm_srli_epi64 (d0, 16));
+    r[1] = _mm_sub_epi16 (d1, _mm_srli_epi64 (d1, 16));
+    r[2] = _mm_sub_epi16 (
+        d0, _mm_or_si128 (_mm_srli_si128 (d0, 8), _mm_slli_si128 (d1, 8)));
+    r[3] = _mm_sub_epi16 (d1, _mm_srli_si128 (d1, 8));
+}
+
+static int
+pack_sse2 (__m128i s0, __m128i s1, uint8_t b[14], int flatfields, int exactmax)
+{
+    const __m128i bias   = _mm_set1_epi16 (0x20);
+    const __m128i rmax   = _mm_set1_epi16 (0x3f);
+    const __m128i zero   = _mm_setzero_si128 ();
+    const __m128i mask[4] = {
+        _mm_set_epi16 (0, -1, -1, -1, 0, -1, -1, -1),
+        _mm_set_epi16 (0, -1, -1, -1, 0, -1, -1, -1),
+        _mm_set_epi16 (0, 0, 0, -1, 0, 0, 0, -1),
+        _mm_set_epi16 (0, 0, 0, 0, 0, 0, 0, -1)};
+
+    __m128i  t0   = ordered_bits_sse2 (s0);
+    __m128i  t1   = ordered_bits_sse2 (s1);
+    __m128i  tmax = unsigned_max_sse2 (t0, t1);
+    __m128i  x0   = _mm_sub_epi16 (tmax, t0);
+    __m128i  x1   = _mm_sub_epi16 (tmax, t1);
+    __m128i  d0, d1, r[4], outside, nonzero, a, c, f0, f1, f2, pairs, groups;
+    __m128i  k64 = _mm_set1_epi32 ((1 << 16) | 64);
+    uint32_t g[4];
+    uint16_t t;
+    int      shift = 0;
+
+    /*
+     * Find the smallest shift where all differences are between -32
+     * and +31, which is when the biased differences are between 0 and
+     * 63 as unsigned 16-bit values: the differences of the shifted
+     * values, less than 0xf800 apart, cannot wrap around.
+     */
+    for (;; ++shift)
+    {
+        if (shift == 0)
+        {
+            d0 = x0;
+            d1 = x1;
+        }
+        else
+        {
+            d0 = shift_and_round_sse2 (x0, shift);
+            d1 = shift_and_round_sse2 (x1, shift);
+        }
+        running_diffs_sse2 (d0, d1, r);
+
+        outside = zero;
+        for (int k = 0; k < 4; ++k)
+            outside = _mm_or_si128 (
+                outside,
+                _mm_and_si128 (
+                    _mm_subs_epu16 (_mm_add_epi16 (r[k], bias), rmax),
+                    mask[k]));
+
+        if (_mm_movemask_epi8 (_mm_cmpeq_epi16 (outside, zero)) == 0xffff)
+            break;
+    }
+
+    t = (uint16_t) _mm_cvtsi128_si32 (t0);
+
+    if (flatfields)
+    {
+        nonzero = zero;
+        for (int k = 0; k < 4; ++k)
+            nonzero = _mm_or_si128 (nonzero, _mm_and_si128 (r[k], mask[k]));
+
+        if (_mm_movemask_epi8 (_mm_cmpeq_epi16 (nonzero, zero)) == 0xffff)
+        {
+            b[0] = (uint8_t) (t >> 8);
+            b[1] = (uint8_t) t;
+            b[2] = 0xfc;
+            return 3;
+        }
+    }
+
+    if (exactmax)
+        t = (uint16_t) (_mm_cvtsi128_si32 (tmax) -
+                        ((_mm_cvtsi128_si32 (d0) & 0xffff) << shift));
+
+    /*
+     * Gather the fields in the order they are stored, the row
+     * differences transposed, and pack them 4 to a 24-bit group
+     */
+    r[0] = _mm_add_epi16 (r[0], bias);
+    r[1] = _mm_add_epi16 (r[1], bias);
+
+    a  = _mm_unpacklo_epi16 (r[0], r[1]);
+    c  = _mm_unpackhi_epi16 (r[0], r[1]);
+    f1 = _mm_unpacklo_epi16 (a, c);
+    f2 = _mm_unpackhi_epi16 (a, c);
+    f0 = _mm_set_epi16 (
+        0,
+        0,
+        0,
+        0,
+        (short) (_mm_cvtsi128_si32 (r[3]) + 0x20),
+        (short) (_mm_extract_epi16 (r[2], 4) + 0x20),
+        (short) (_mm_cvtsi128_si32 (r[2]) + 0x20),
+        (short) shift);
+
+    pairs = _mm_packs_epi32 (
+        _mm_madd_epi16 (_mm_unpacklo_epi64 (f0, f1), k64),
+        _mm_madd_epi16 (
+            _mm_unpackhi_epi64 (f1, _mm_slli_si128 (f2, 8)), k64));
+    groups = _mm_madd_epi16 (pairs, _mm_set1_epi32 ((1 << 16) | 4096));
+    _mm_storeu_si128 ((__m128i*) g, groups);
+
+    b[0] = (uint8_t) (t >> 8);
+    b[1] = (uint8_t) t;
+    for (int j = 0; j < 4; ++j)
+    {
+        b[2 + 3 * j] = (uint8_t) (g[j] >> 16);
+        b[3 + 3 * j] = (uint8_t) (g[j] >> 8);
+        b[4 + 3 * j] = (uint8_t) g[j];
+    }
+    return 14;
+}
+
+static inline void
+unpack14_sse2 (const uint8_t b[14], __m128i* s0, __m128i* s1)
+{
+    const __m128i mask = _mm_set1_epi32 (0x3f);
+    const __m128i bias = _mm_set1_epi16 (0x20);
+    __m128i       g    = _mm_set_epi32 (
+        (int) read_be24 (b + 11),
+        (int) read_be24 (b + 8),
+        (int) read_be24 (b + 5),
+        (int) read_be24 (b + 2));
+    __m128i scale = _mm_set1_epi16 ((short) (1 << (b[2] >> 2)));
+    __m128i r0, r1, c0, c1, c01;
+
+    r0 = _mm_packs_epi32 (
+        _mm_and_si128 (_mm_srli_epi32 (g, 18), mask),
+        _mm_and_si128 (_mm_srli_epi32 (g, 12), mask));
+    r1 = _mm_packs_epi32 (
+        _mm_and_si128 (_mm_srli_epi32 (g, 6), mask), _mm_and_si128 (g, mask));
+
+    r0 = _mm_mullo_epi16 (_mm_sub_epi16 (r0, bias), scale);
+    r1 = _mm_mullo_epi16 (_mm_sub_epi16 (r1, bias), scale);
+    r0 = _mm_insert_epi16 (r0, (b[0] << 8) | b[1], 0);
+
+    /* sum along the rows, then add the first pixels of the rows above */
+    r0 = _mm_add_epi16 (r0, _mm_slli_epi64 (r0, 16));
+    r1 = _mm_add_epi16 (r1, _mm_slli_epi64 (r1, 16));
+    r0 = _mm_add_epi16 (r0, _mm_slli_epi64 (r0, 32));
+    r1 = _mm_add_epi16 (r1, _mm_slli_epi64 (r1, 32));
+
+    c0  = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (r0, 0), 0);
+    c1  = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (r1, 0), 0);
+    c01 = _mm_add_epi16 (c0, _mm_srli_si128 (c0, 8));
+
+    r0 = _mm_add_epi16 (r0, _mm_slli_si128 (c0, 8));
+    r1 = _mm_add_epi16 (
+        r1,
+        _mm_add_epi16 (_mm_unpacklo_epi64 (c01, c01), _mm_slli_si128 (c1, 8)));
+
+    *s0 = sign_magnitude_sse2 (r0);
+    *s1 = sign_magnitude_sse2 (r1);
+}
+
+static inline void
+store_block_sse2 (uint16_t* const rows[4], int i, __m128i s0, __m128i s1)
+{
+    _mm_storel_epi64 ((__m128i*) (rows[0] + 4 * i), s0);
+    _mm_storel_epi64 ((__m128i*) (rows[1] + 4 * i), _mm_srli_si128 (s0, 8));
+    _mm_storel_epi64 ((__m128i*) (rows[2] + 4 * i), s1);
+    _mm_storel_epi64 ((__m128i*) (rows[3] + 4 * i), _mm_srli_si128 (s1, 8));
+}
+
+/* one block, at in[0], returns the size or -1 */
+static inline int
+unpack_block_sse2 (const uint8_t* in, uint64_t insize, __m128i* s0, __m128i* s1)
+{
+    if (insize < 3) return -1;
+
+    if (in[2] >= (13 << 2))
+    {
+        *s0 = *s1 = sign_magnitude_sse2 (
+            _mm_set1_epi16 ((short) ((in[0] << 8) | in[1])));
+        return 3;
+    }
+
+    if (insize < 14) return -1;
+    unpack14_sse2 (in, s0, s1);
+    return 14;
+}
+
+static int
+pack_blocks_sse2 (
+    const uint16_t* const rows[4],
+    int                   nblocks,
+    uint8_t*              out,
+    int                   flatfields,
+    int                   exactmax)
+{
+    uint8_t* start = out;
+
+    for (int i = 0; i < nblocks; ++i)
+    {
+        __m128i s0 = _mm_unpacklo_epi64 (
+            _mm_loadl_epi64 ((const __m128i*) (rows[0] + 4 * i)),
+            _mm_loadl_epi64 ((const __m128i*) (rows[1] + 4 * i)));
+        __m128i s1 = _mm_unpacklo_epi64 (
+            _mm_loadl_epi64 ((const __m128i*) (rows[2] + 4 * i)),
+            _mm_loadl_epi64 ((const __m128i*) (rows[3] + 4 * i)));
+
+        out += pack_sse2 (s0, s1, out, flatfields, exactmax);
+    }
+    return (int) (out - start);
+}
+
+static int
+unpack_blocks_sse2 (
+    const uint8_t* in, uint64_t insize, int nblocks, uint16_t* const rows[4])
+{
+    const uint8_t* start = in;
+    __m128i        s0, s1;
+
+    for (int i = 0; i < nblocks; ++i)
+    {
+        int n = unpack_block_sse2 (in, insize, &s0, &s1);
+        if (n < 0) return -1;
+
+        store_block_sse2 (rows, i, s0, s1);
+        in += n;
+        insize -= (uint64_t) n;
+    }
+    return (int) (in - start);
+}
+
+#endif /* IMF_HAVE_SSE2 */
+
+/**************************************/
+
+#if defined(EXR_HAVE_AVX2_TARGET)
+
+/*
+ * One block in each 128-bit lane, the same operations as the SSE2
+ * version, but for the shift search, which is separate for each block
+ */
+
+EXR_TARGET_AVX2 static inline __m256i
+combine_avx2 (__m128i lo, __m128i hi)
+{
+    return _mm256_inserti128_si256 (_mm256_castsi128_si256 (lo), hi, 1);
+}
+
+EXR_TARGET_AVX2 static inline __m128i
+half_avx2 (__m256i v, int b)
+{
+    return b ? _mm256_extracti128_si256 (v, 1) : _mm256_castsi256_si128 (v);
+}
+
+EXR_TARGET_AVX2 static inline __m256i
+ordered_bits_avx2 (__m256i s)
+{
+    const __m256i sign = _mm256_set1_epi16 ((short) 0x8000);
+    const __m256i expo = _mm256_set1_epi16 (0x7c00);
+    __m256i       t    = _mm256_xor_si256 (
+        s, _mm256_or_si256 (_mm256_srai_epi16 (s, 15), sign));
+    __m256i infnan = _mm256_cmpeq_epi16 (_mm256_and_si256 (s, expo), expo);
+
+    return _mm256_blendv_epi8 (t, sign, infnan);
+}
+
+EXR_TARGET_AVX2 static inline __m256i
+sign_magnitude_avx2 (__m256i t)
+{
+    const __m256i sign = _mm256_set1_epi16 ((short) 0x8000);
+    __m256i       neg  = _mm256_srai_epi16 (t, 15);
+
+    return _mm256_andnot_si256 (
+        _mm256_and_si256 (neg, sign),
+        _mm256_xor_si256 (t, _mm256_xor_si256 (neg, _mm256_set1_epi16 (-1))));
+}
+
+EXR_TARGET_AVX2 static inline void
+running_diffs_avx2 (__m256i d0, __m256i d1, __m256i r[4])
+{
+    r[0] = _mm256_sub_epi16 (d0, _mm256_srli_epi64 (d0, 16));
+    r[1] = _mm256_sub_epi16 (d1, _mm256_srli_epi64 (d1, 16));
+    r[2] = _mm256_sub_epi16 (
+        d0,
+        _mm256_or_si256 (_mm256_srli_si256 (d0, 8), _mm256_slli_si256 (d1, 8)));
+    r[3] = _mm256_sub_epi16 (d1, _mm256_srli_si256 (d1, 8));
+}
+
+/* shiftAndRound of the differences x with a shift > 0 per lane */
+EXR_TARGET_AVX2 static inline __m256i
+shift_and_round_avx2 (__m256i x, __m256i down, __m256i up, __m256i half)
+{
+    __m256i q = _mm256_mulhi_epu16 (x, down);
+    __m256i rem = _mm256_sub_epi16 (x, _mm256_mullo_epi16 (q, up));
+
+    return _mm256_sub_epi16 (
+        q,
+        _mm256_cmpgt_epi16 (
+            _mm256_add_epi16 (
+                rem, _mm256_and_si256 (q, _mm256_set1_epi16 (1))),
+            half));
+}
+
+EXR_TARGET_AVX2 static int
+pack_blocks_avx2 (
+    const uint16_t* const rows[4],
+    int                   nblocks,
+    uint8_t*              out,
+    int                   flatfields,
+    int                   exactmax)
+{
+    const __m256i bias = _mm256_set1_epi16 (0x20);
+    const __m256i rmax = _mm256_set1_epi16 (0x3f);
+    const __m256i zero = _mm256_setzero_si256 ();
+    const __m256i mask[4] = {
+        _mm256_set_epi16 (
+            0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1),
+        _mm256_set_epi16 (
+            0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1),
+        _mm256_set_epi16 (0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1),
+        _mm256_set_epi16 (0, 0, 0, 0, 0, 0, 0, -1, 0, 0, 0, 0, 0, 0, 0, -1)};
+    const __m256i be_bytes = _mm256_setr_epi8 (
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i k64 = _mm256_set1_epi32 ((1 << 16) | 64);
+
+    uint8_t* start = out;
+    int      i     = 0;
+
+    for (; i + 2 <= nblocks; i += 2)
+    {
+        __m128i  r0 = _mm_loadu_si128 ((const __m128i*) (rows[0] + 4 * i));
+        __m128i  r1 = _mm_loadu_si128 ((const __m128i*) (rows[1] + 4 * i));
+        __m128i  r2 = _mm_loadu_si128 ((const __m128i*) (rows[2] + 4 * i));
+        __m128i  r3 = _mm_loadu_si128 ((const __m128i*) (rows[3] + 4 * i));
+        __m256i  t0, t1, m, tmax, x0, x1, d0, d1, r[4], outside, nonzero;
+        __m256i  a, c, f0, f1, f2, pairs, bytes;
+        int      shift[2] = {0, 0};
+        int      found    = 0;
+        unsigned inside, flat;
+
+        t0 = ordered_bits_avx2 (combine_avx2 (
+            _mm_unpacklo_epi64 (r0, r1), _mm_unpackhi_epi64 (r0, r1)));
+        t1 = ordered_bits_avx2 (combine_avx2 (
+            _mm_unpacklo_epi64 (r2, r3), _mm_unpackhi_epi64 (r2, r3)));
+
+        /* the maximum of each block, in all lanes of its half */
+        m = _mm256_max_epu16 (t0, t1);
+        m = _mm256_max_epu16 (
+            m, _mm256_shuffle_epi32 (m, _MM_SHUFFLE (1, 0, 3, 2)));
+        m = _mm256_max_epu16 (
+            m, _mm256_shuffle_epi32 (m, _MM_SHUFFLE (2, 3, 0, 1)));
+        m = _mm256_max_epu16 (
+            m, _mm256_shufflelo_epi16 (m, _MM_SHUFFLE (2, 3, 0, 1)));
+        tmax = _mm256_shuffle_epi32 (_mm256_shufflelo_epi16 (m, 0), 0);
+
+        x0 = _mm256_sub_epi16 (tmax, t0);
+        x1 = _mm256_sub_epi16 (tmax, t1);
+        d0 = x0;
+        d1 = x1;
+        running_diffs_avx2 (d0, d1, r);
+
+        /*
+         * Search the shifts of both blocks together, keeping the
+         * differences of a block once its shift is found
+         */
+        for (;;)
+        {
+            __m256i down, up, half, keep;
+            int     s0, s1;
+
+            outside = zero;
+            for (int k = 0; k < 4; ++k)
+                outside = _mm256_or_si256 (
+                    outside,
+                    _mm256_and_si256 (
+                        _mm256_subs_epu16 (_mm256_add_epi16 (r[k], bias), rmax),
+                        mask[k]));
+
+            inside = (unsigned) _mm256_movemask_epi8 (
+                _mm256_cmpeq_epi16 (outside, zero));
+            if ((inside & 0xffff) == 0xffff) found |= 1;
+            if ((inside >> 16) == 0xffff) found |= 2;
+            if (found == 3) break;
+
+            for (int b = 0; b < 2; ++b)
+                if (!(found & (1 << b))) ++shift[b];
+
+            /* blocks already done get any valid shift, then discarded */
+            s0   = shift[0] > 0 ? shift[0] : 1;
+            s1   = shift[1] > 0 ? shift[1] : 1;
+            down = combine_avx2 (
+                _mm_set1_epi16 ((short) (1 << (16 - s0))),
+                _mm_set1_epi16 ((short) (1 << (16 - s1))));
+            up = combine_avx2 (
+                _mm_set1_epi16 ((short) (1 << s0)),
+                _mm_set1_epi16 ((short) (1 << s1)));
+            half = combine_avx2 (
+                _mm_set1_epi16 ((short) (1 << (s0 - 1))),
+                _mm_set1_epi16 ((short) (1 << (s1 - 1))));
+            keep = combine_avx2 (
+                _mm_set1_epi16 ((found & 1) ? -1 : 0),
+                _mm_set1_epi16 ((found & 2) ? -1 : 0));
+
+            d0 = _mm256_blendv_epi8 (
+                shift_and_round_avx2 (x0, down, up, half), d0, keep);
+            d1 = _mm256_blendv_epi8 (
+                shift_and_round_avx2 (x1, down, up, half), d1, keep);
+            running_diffs_avx2 (d0, d1, r);
+        }
+
+        nonzero = zero;
+        for (int k = 0; k < 4; ++k)
+        {
+            nonzero = _mm256_or_si256 (nonzero, _mm256_and_si256 (r[k], mask[k]));
+            r[k]    = _mm256_add_epi16 (r[k], bias);
+        }
+        flat = (unsigned) _mm256_movemask_epi8 (
+            _mm256_cmpeq_epi16 (nonzero, zero));
+
+        /* gather and pack the fields of both blocks as in pack_sse2 */
+        a  = _mm256_unpacklo_epi16 (r[0], r[1]);
+        c  = _mm256_unpackhi_epi16 (r[0], r[1]);
+        f1 = _mm256_unpacklo_epi16 (a, c);
+        f2 = _mm256_unpackhi_epi16 (a, c);
+
+        /* shift, then the column differences r[2][0], r[2][4], r[3][0] */
+        f0 = _mm256_blend_epi16 (
+            _mm256_shufflelo_epi16 (
+                _mm256_unpacklo_epi16 (r[2], _mm256_srli_si256 (r[2], 8)),
+                _MM_SHUFFLE (3, 1, 0, 0)),
+            _mm256_slli_si256 (r[3], 6),
+            0x08);
+        f0 = _mm256_blend_epi16 (
+            f0,
+            combine_avx2 (
+                _mm_cvtsi32_si128 (shift[0]), _mm_cvtsi32_si128 (shift[1])),
+            0x01);
+
+        pairs = _mm256_packs_epi32 (
+            _mm256_madd_epi16 (_mm256_unpacklo_epi64 (f0, f1), k64),
+            _mm256_madd_epi16 (
+                _mm256_unpackhi_epi64 (f1, _mm256_slli_si256 (f2, 8)), k64));
+        bytes = _mm256_shuffle_epi8 (
+            _mm256_madd_epi16 (pairs, _mm256_set1_epi32 ((1 << 16) | 4096)),
+            be_bytes);
+
+        for (int b = 0; b < 2; ++b)
+        {
+            uint16_t t = (uint16_t) _mm_cvtsi128_si32 (half_avx2 (t0, b));
+            __m128i  bb;
+            uint32_t last;
+
+            if (flatfields && ((flat >> (16 * b)) & 0xffff) == 0xffff)
+            {
+                out[0] = (uint8_t) (t >> 8);
+                out[1] = (uint8_t) t;
+                out[2] = 0xfc;
+                out += 3;
+                continue;
+            }
+
+            if (exactmax)
+                t = (uint16_t) (_mm_cvtsi128_si32 (half_avx2 (tmax, b)) -
+                                ((_mm_cvtsi128_si32 (half_avx2 (d0, b)) &
+                                  0xffff)
+                                 << shift[b]));
+
+            bb   = half_avx2 (bytes, b);
+            last = (uint32_t) _mm_cvtsi128_si32 (_mm_srli_si128 (bb, 8));
+
+            out[0] = (uint8_t) (t >> 8);
+            out[1] = (uint8_t) t;
+            _mm_storel_epi64 ((__m128i*) (out + 2), bb);
+            memcpy (out + 10, &last, 4);
+            out += 14;
+        }
+    }
+
+    if (i < nblocks)
+    {
+        const uint16_t* const tail[4] = {
+            rows[0] + 4 * i, rows[1] + 4 * i, rows[2] + 4 * i, rows[3] + 4 * i};
+
+        out += pack_blocks_sse2 (tail, nblocks - i, out, flatfields, exactmax);
+    }
+    return (int) (out - start);
+}
+
+EXR_TARGET_AVX2 static int
+unpack_blocks_avx2 (
+    const uint8_t* in, uint64_t insize, int nblocks, uint16_t* const rows[4])
+{
+    const __m256i mask = _mm256_set1_epi32 (0x3f);
+    const __m256i bias = _mm256_set1_epi16 (0x20);
+
+    /* the four 24-bit groups and the first pixel, from 16 bytes */
+    const __m256i group_bytes = _mm256_setr_epi8 (
+        4, 3, 2, -1, 7, 6, 5, -1, 10, 9, 8, -1, 13, 12, 11, -1,
+        4, 3, 2, -1, 7, 6, 5, -1, 10, 9, 8, -1, 13, 12, 11, -1);
+    const __m256i first_bytes = _mm256_setr_epi8 (
+        1, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        1, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    const uint8_t* start = in;
+    int            i     = 0;
+
+    while (i < nblocks)
+    {
+        __m256i v, g, scale, r0, r1, c0, c1, c01;
+
+        /* two 14-byte blocks, with both 16-byte loads inside the input */
+        if (i + 2 > nblocks || insize < 30 || in[2] >= (13 << 2) ||
+            in[16] >= (13 << 2))
+        {
+            __m128i s0, s1;
+            int     n = unpack_block_sse2 (in, insize, &s0, &s1);
+            if (n < 0) return -1;
+
+            store_block_sse2 (rows, i, s0, s1);
+            in += n;
+            insize -= (uint64_t) n;
+            ++i;
+            continue;
+        }
+
+        v = combine_avx2 (
+            _mm_loadu_si128 ((const __m128i*) in),
+            _mm_loadu_si128 ((const __m128i*) (in + 14)));
+        g     = _mm256_shuffle_epi8 (v, group_bytes);
+        scale = combine_avx2 (
+            _mm_set1_epi16 ((short) (1 << (in[2] >> 2))),
+            _mm_set1_epi16 ((short) (1 << (in[16] >> 2))));
+
+        r0 = _mm256_packs_epi32 (
+            _mm256_and_si256 (_mm256_srli_epi32 (g, 18), mask),
+            _mm256_and_si256 (_mm256_srli_epi32 (g, 12), mask));
+        r1 = _mm256_packs_epi32 (
+            _mm256_and_si256 (_mm256_srli_epi32 (g, 6), mask),
+            _mm256_and_si256 (g, mask));
+
+        r0 = _mm256_mullo_epi16 (_mm256_sub_epi16 (r0, bias), scale);
+        r1 = _mm256_mullo_epi16 (_mm256_sub_epi16 (r1, bias), scale);
+        r0 = _mm256_blend_epi16 (r0, _mm256_shuffle_epi8 (v, first_bytes), 0x01);
+
+        r0 = _mm256_add_epi16 (r0, _mm256_slli_epi64 (r0, 16));
+        r1 = _mm256_add_epi16 (r1, _mm256_slli_epi64 (r1, 16));
+        r0 = _mm256_add_epi16 (r0, _mm256_slli_epi64 (r0, 32));
+        r1 = _mm256_add_epi16 (r1, _mm256_slli_epi64 (r1, 32));
+
+        c0  = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (r0, 0), 0);
+        c1  = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (r1, 0), 0);
+        c01 = _mm256_add_epi16 (c0, _mm256_srli_si256 (c0, 8));
+
+        r0 = _mm256_add_epi16 (r0, _mm256_slli_si256 (c0, 8));
+        r1 = _mm256_add_epi16 (
+            r1,
+            _mm256_add_epi16 (
+                _mm256_unpacklo_epi64 (c01, c01), _mm256_slli_si256 (c1, 8)));
+
+        r0 = _mm256_permute4x64_epi64 (
+            sign_magnitude_avx2 (r0), _MM_SHUFFLE (3, 1, 2, 0));
+        r1 = _mm256_permute4x64_epi64 (
+            sign_magnitude_avx2 (r1), _MM_SHUFFLE (3, 1, 2, 0));
+
+        _mm_storeu_si128 ((__m128i*) (rows[0] + 4 * i), half_avx2 (r0, 0));
+        _mm_storeu_si128 ((__m128i*) (rows[1] + 4 * i), half_avx2 (r0, 1));
+        _mm_storeu_si128 ((__m128i*) (rows[2] + 4 * i), half_avx2 (r1, 0));
+        _mm_storeu_si128 ((__m128i*) (rows[3] + 4 * i), half_avx2 (r1, 1));
+
+        in += 28;
+        insize -= 28;
+        i += 2;
+    }
+    return (int) (in - start);
+}
+
+/*
+ * Only ever transitions from -1 to the same answer, so racing threads
+ * are harmless.
+ */
+static int
+has_avx2 (void)
+{
+    static int avx2 = -1;
+    if (avx2 < 0) avx2 = check_for_x86_avx2 ();
+    return avx2;
+}
+
+#endif /* EXR_HAVE_AVX2_TARGET */
+
+/**************************************/
+
+#if defined(IMF_HAVE_NEON)
+
+static inline uint16x8_t
+ordered_bits_neon (uint16x8_t s)
+{
+    const uint16x8_t sign = vdupq_n_u16 (0x8000);
+    const uint16x8_t expo = vdupq_n_u16 (0x7c00);
+    uint16x8_t       neg =
+        vreinterpretq_u16_s16 (vshrq_n_s16 (vreinterpretq_s16_u16 (s), 15));
+    uint16x8_t infnan = vceqq_u16 (vandq_u16 (s, expo), expo);
+
+    return vbslq_u16 (infnan, sign, veorq_u16 (s, vorrq_u16 (neg, sign)));
+}
+
+static inline uint16x8_t
+sign_magnitude_neon (uint16x8_t t)
+{
+    const uint16x8_t sign = vdupq_n_u16 (0x8000);
+    uint16x8_t       neg =
+        vreinterpretq_u16_s16 (vshrq_n_s16 (vreinterpretq_s16_u16 (t), 15));
+
+    return vbicq_u16 (veorq_u16 (t, vmvnq_u16 (neg)), vandq_u16 (neg, sign));
+}
+
+static inline uint16x8_t
+prefix_sum_rows_neon (uint16x8_t x)
+{
+    x = vaddq_u16 (
+        x,
+        vreinterpretq_u16_u64 (vshlq_n_u64 (vreinterpretq_u64_u16 (x), 16)));
+    return vaddq_u16 (
+        x,
+        vreinterpretq_u16_u64 (vshlq_n_u64 (vreinterpretq_u64_u16 (x), 32)));
+}
+
+static inline void
+running_diffs_neon (uint16x8_t d0, uint16x8_t d1, uint16x8_t r[4])
+{
+    const uint16x8_t zero = vdupq_n_u16 (0);
+
+    r[0] = vsubq_u16 (
+        d0,
+        vreinterpretq_u16_u64 (vshrq_n_u64 (vreinterpretq_u64_u16 (d0), 16)));
+    r[1] = vsubq_u16 (
+        d1,
+        vreinterpretq_u16_u64 (vshrq_n_u64 (vreinterpretq_u64_u16 (d1), 16)));
+    r[2] = vsubq_u16 (d0, vextq_u16 (d0, d1, 4));
+    r[3] = vsubq_u16 (d1, vextq_u16 (d1, zero, 4));
+}
+
+static inline int
+all_zero_neon (uint16x8_t x)
+{
+    uint64x2_t x64 = vreinterpretq_u64_u16 (x);
+    return (vgetq_lane_u64 (x64, 0) | vgetq_lane_u64 (x64, 1)) == 0;
+}
+
+static int
+pack_neon (
+    uint16x8_t s0, uint16x8_t s1, uint8_t b[14], int flatfields, int exactmax)
+{
+    static const uint16_t mask_bits[4][8] = {
+        {0xffff, 0xffff, 0xffff, 0, 0xffff, 0xffff, 0xffff, 0},
+        {0xffff, 0xffff, 0xffff, 0, 0xffff, 0xffff, 0xffff, 0},
+        {0xffff, 0, 0, 0, 0xffff, 0, 0, 0},
+        {0xffff, 0, 0, 0, 0, 0, 0, 0}};
+
+    const uint16x8_t bias = vdupq_n_u16 (0x20);
+    const uint16x8_t rmax = vdupq_n_u16 (0x3f);
+    const uint16x8_t one  = vdupq_n_u16 (1);
+    uint16x8_t       mask[4];
+    uint16x8_t       t0, t1, tmax, x0, x1, d0, d1, r[4], outside, nonzero;
+    uint16x8_t       flo, fhi, pairs;
+    uint16x8x2_t     ac, f12, eo;
+    uint16x4x2_t     peo;
+    uint16x4_t       m4;
+    uint32_t         g[4];
+    uint16_t         f0[4];
+    uint16_t         t;
+    int              shift = 0;
+
+    for (int k = 0; k < 4; ++k)
+        mask[k] = vld1q_u16 (mask_bits[k]);
+
+    t0 = ordered_bits_neon (s0);
+    t1 = ordered_bits_neon (s1);
+
+    tmax = vmaxq_u16 (t0, t1);
+    m4   = vmax_u16 (vget_low_u16 (tmax), vget_high_u16 (tmax));
+    m4   = vpmax_u16 (m4, m4);
+    m4   = vpmax_u16 (m4, m4);
+    tmax = vdupq_lane_u16 (m4, 0);
+
+    x0 = vsubq_u16 (tmax, t0);
+    x1 = vsubq_u16 (tmax, t1);
+
+    /* see pack_sse2 */
+    for (;; ++shift)
+    {
+        if (shift == 0)
+        {
+            d0 = x0;
+            d1 = x1;
+        }
+        else
+        {
+            int16x8_t  down = vdupq_n_s16 ((int16_t) -shift);
+            uint16x8_t low  = vdupq_n_u16 ((uint16_t) ((1 << shift) - 1));
+            uint16x8_t half = vdupq_n_u16 ((uint16_t) (1 << (shift - 1)));
+            uint16x8_t q0   = vshlq_u16 (x0, down);
+            uint16x8_t q1   = vshlq_u16 (x1, down);
+
+            d0 = vsubq_u16 (
+                q0,
+                vcgtq_u16 (
+                    vaddq_u16 (vandq_u16 (x0, low), vandq_u16 (q0, one)),
+                    half));
+            d1 = vsubq_u16 (
+                q1,
+                vcgtq_u16 (
+                    vaddq_u16 (vandq_u16 (x1, low), vandq_u16 (q1, one)),
+                    half));
+        }
+        running_diffs_neon (d0, d1, r);
+
+        outside = vdupq_n_u16 (0);
+        for (int k = 0; k < 4; ++k)
+            outside = vorrq_u16 (
+                outside,
+                vandq_u16 (vqsubq_u16 (vaddq_u16 (r[k], bias), rmax), mask[k]));
+
+        if (all_zero_neon (outside)) break;
+    }
+
+    t = vgetq_lane_u16 (t0, 0);
+
+    if (flatfields)
+    {
+        nonzero = vdupq_n_u16 (0);
+        for (int k = 0; k < 4; ++k)
+            nonzero = vorrq_u16 (nonzero, vandq_u16 (r[k], mask[k]));
+
+        if (all_zero_neon (nonzero))
+        {
+            b[0] = (uint8_t) (t >> 8);
+            b[1] = (uint8_t) t;
+            b[2] = 0xfc;
+            return 3;
+        }
+    }
+
+    if (exactmax)
+        t = (uint16_t) (vgetq_lane_u16 (tmax, 0) -
+                        (vgetq_lane_u16 (d0, 0) << shift));
+
+    ac  = vzipq_u16 (vaddq_u16 (r[0], bias), vaddq_u16 (r[1], bias));
+    f12 = vzipq_u16 (ac.val[0], ac.val[1]);
+
+    f0[0] = (uint16_t) shift;
+    f0[1] = (uint16_t) (vgetq_lane_u16 (r[2], 0) + 0x20);
+    f0[2] = (uint16_t) (vgetq_lane_u16 (r[2], 4) + 0x20);
+    f0[3] = (uint16_t) (vgetq_lane_u16 (r[3], 0) + 0x20);
+
+    flo = vcombine_u16 (vld1_u16 (f0), vget_low_u16 (f12.val[0]));
+    fhi = vcombine_u16 (vget_high_u16 (f12.val[0]), vget_low_u16 (f12.val[1]));
+
+    eo    = vuzpq_u16 (flo, fhi);
+    pairs = vmlaq_n_u16 (eo.val[1], eo.val[0], 64);
+    peo   = vuzp_u16 (vget_low_u16 (pairs), vget_high_u16 (pairs));
+    vst1q_u32 (g, vmlal_n_u16 (vmovl_u16 (peo.val[1]), peo.val[0], 4096));
+
+    b[0] = (uint8_t) (t >> 8);
+    b[1] = (uint8_t) t;
+    for (int j = 0; j < 4; ++j)
+    {
+        b[2 + 3 * j] = (uint8_t) (g[j] >> 16);
+        b[3 + 3 * j] = (uint8_t) (g[j] >> 8);
+        b[4 + 3 * j] = (uint8_t) g[j];
+    }
+    return 14;
+}
+
+static inline void
+unpack14_neon (const uint8_t b[14], uint16x8_t* s0, uint16x8_t* s1)
+{
+    const uint32x4_t mask = vdupq_n_u32 (0x3f);
+    const uint16x8_t bias = vdupq_n_u16 (0x20);
+    const uint16x8_t zero = vdupq_n_u16 (0);
+    uint32_t         gbits[4] = {
+        read_be24 (b + 2), read_be24 (b + 5), read_be24 (b + 8), read_be24 (b + 11)};
+    uint32x4_t g     = vld1q_u32 (gbits);
+    uint16x8_t scale = vdupq_n_u16 ((uint16_t) (1 << (b[2] >> 2)));
+    uint16x8_t r0, r1, c0, c1;
+    uint16x4_t s4;
+
+    r0 = vcombine_u16 (
+        vmovn_u32 (vandq_u32 (vshrq_n_u32 (g, 18), mask)),
+        vmovn_u32 (vandq_u32 (vshrq_n_u32 (g, 12), mask)));
+    r1 = vcombine_u16 (
+        vmovn_u32 (vandq_u32 (vshrq_n_u32 (g, 6), mask)),
+        vmovn_u32 (vandq_u32 (g, mask)));
+
+    r0 = vmulq_u16 (vsubq_u16 (r0, bias), scale);
+    r1 = vmulq_u16 (vsubq_u16 (r1, bias), scale);
+    r0 = vsetq_lane_u16 ((uint16_t) ((b[0] << 8) | b[1]), r0, 0);
+
+    r0 = prefix_sum_rows_neon (r0);
+    r1 = prefix_sum_rows_neon (r1);
+
+    c0 = vcombine_u16 (
+        vdup_lane_u16 (vget_low_u16 (r0), 0),
+        vdup_lane_u16 (vget_high_u16 (r0), 0));
+    c1 = vcombine_u16 (
+        vdup_lane_u16 (vget_low_u16 (r1), 0),
+        vdup_lane_u16 (vget_high_u16 (r1), 0));
+    s4 = vget_low_u16 (vaddq_u16 (c0, vextq_u16 (c0, zero, 4)));
+
+    r0 = vaddq_u16 (r0, vextq_u16 (zero, c0, 4));
+    r1 = vaddq_u16 (
+        r1, vaddq_u16 (vcombine_u16 (s4, s4), vextq_u16 (zero, c1, 4)));
+
+    *s0 = sign_magnitude_neon (r0);
+    *s1 = sign_magnitude_neon (r1);
+}
+
+static int
+pack_blocks_neon (
+    const uint16_t* const rows[4],
+    int                   nblocks,
+    uint8_t*              out,
+    int                   flatfields,
+    int                   exactmax)
+{
+    uint8_t* start = out;
+
+    for (int i = 0; i < nblocks; ++i)
+    {
+        uint16x8_t s0 = vcombine_u16 (
+            vld1_u16 (rows[0] + 4 * i), vld1_u16 (rows[1] + 4 * i));
+        uint16x8_t s1 = vcombine_u16 (
+            vld1_u16 (rows[2] + 4 * i), vld1_u16 (rows[3] + 4 * i));
+
+        out += pack_neon (s0, s1, out, flatfields, exactmax);
+    }
+    return (int) (out - start);
+}
+
+static int
+unpack_blocks_neon (
+    const uint8_t* in, uint64_t insize, int nblocks, uint16_t* const rows[4])
+{
+    const uint8_t* start = in;
+    uint16x8_t     s0, s1;
+
+    for (int i = 0; i < nblocks; ++i)
+    {
+        if (insize < 3) return -1;
+
+        if (in[2] >= (13 << 2))
+        {
+            s0 = s1 = sign_magnitude_neon (
+                vdupq_n_u16 ((uint16_t) ((in[0] << 8) | in[1])));
+            in += 3;
+            insize -= 3;
+        }
+        else
+        {
+            if (insize < 14) return -1;
+            unpack14_neon (in, &s0, &s1);
+            in += 14;
+            insize -= 14;
+        }
+
+        vst1_u16 (rows[0] + 4 * i, vget_low_u16 (s0));
+        vst1_u16 (rows[1] + 4 * i, vget_high_u16 (s0));
+        vst1_u16 (rows[2] + 4 * i, vget_low_u16 (s1));
+        vst1_u16 (rows[3] + 4 * i, vget_high_u16 (s1));
+    }
+    return (int) (in - start);
+}
+
+#endif /* IMF_HAVE_NEON */
+
+/**************************************/
+
+static int
+pack_blocks (
+    const uint16_t* const rows[4],
+    int                   nblocks,
+    uint8_t*              out,
+    int                   flatfields,
+    int                   exactmax)
+{
+#if defined(EXR_HAVE_AVX2_TARGET)
+    if (has_avx2 ())
+        return pack_blocks_avx2 (rows, nblocks, out, flatfields, exactmax);
+#endif
+#if defined(IMF_HAVE_SSE2)
+    return pack_blocks_sse2 (rows, nblocks, out, flatfields, exactmax);
+#elif defined(IMF_HAVE_NEON)
+    return pack_blocks_neon (rows, nblocks, out, flatfields, exactmax);
+#else
+    return pack_blocks_scalar (rows, nblocks, out, flatfields, exactmax);
+#endif
+}
+
+static int
+unpack_blocks (
+    const uint8_t* in, uint64_t insize, int nblocks, uint16_t* const rows[4])
+{
+#if defined(EXR_HAVE_AVX2_TARGET)
+    if (has_avx2 ()) return unpack_blocks_avx2 (in, insize, nblocks, rows);
+#endif
+#if defined(IMF_HAVE_SSE2)
+    return unpack_blocks_sse2 (in, insize, nblocks, rows);
+#elif defined(IMF_HAVE_NEON)
+    return unpack_blocks_neon (in, insize, nblocks, rows);
+#else
+    return unpack_blocks_scalar (in, insize, nblocks, rows);
+#endif
+}
+
+/**************************************/
+
 static exr_result_t
 compress_b44_impl (exr_encode_pipeline_t* encode, int flat_field)
 {
@@ -381,68 +1447,75 @@ compress_b44_impl (exr_encode_pipeline_t* encode, int flat_field)
             continue;
         }
 
+        if (curc->p_linear)
+            convertFromLinear ((uint16_t*) scratch, (uint64_t) nx * (uint64_t) ny);
+
         for (int y = 0; y < ny; y += 4)
         {
             //
-            // Copy the next 4x4 pixel block into array s.
-            // If the width, cd.nx, or the height, cd.ny, of
-            // the pixel data in _tmpBuffer is not divisible
-            // by 4, then pad the data by repeating the
-            // rightmost column and the bottom row.
+            // Compress the next row of 4x4 pixel blocks. If the
+            // width, nx, or the height, ny, of the pixel data in
+            // scratch is not divisible by 4, then pad the data by
+            // repeating the rightmost column and the bottom row.
             //
 
-            uint16_t* row0 = (uint16_t*) scratch;
-            row0 += y * nx;
-            uint16_t* row1 = row0 + nx;
-            uint16_t* row2 = row1 + nx;
-            uint16_t* row3 = row2 + nx;
+            const uint16_t* rows[4];
+            int             nblocks = nx / 4;
+            int             n       = nx - 4 * nblocks;
+
+            rows[0] = (const uint16_t*) scratch + (uint64_t) y * (uint64_t) nx;
+            rows[1] = rows[0] + nx;
+            rows[2] = rows[1] + nx;
+            rows[3] = rows[2] + nx;
 
             if (y + 3 >= ny)
             {
-                if (y + 1 >= ny) row1 = row0;
-                if (y + 2 >= ny) row2 = row1;
+                if (y + 1 >= ny) rows[1] = rows[0];
+                if (y + 2 >= ny) rows[2] = rows[1];
 
-                row3 = row2;
+                rows[3] = rows[2];
             }
 
-            for (int x = 0; x < nx; x += 4)
+            if (nOut + 14 * ((uint64_t) nblocks + 1) <=
+                encode->compressed_alloc_size)
             {
-                uint16_t s[16];
-
-                if (x + 3 >= nx)
-                {
-                    int n = nx - x;
-
-                    for (int i = 0; i < 4; ++i)
-                    {
-                        int j = i;
-                        if (j > n - 1) j = n - 1;
-
-                        s[i + 0]  = row0[j];
-                        s[i + 4]  = row1[j];
-                        s[i + 8]  = row2[j];
-                        s[i + 12] = row3[j];
-                    }
-                }
-                else
+                wcount = pack_blocks (
+                    rows, nblocks, out, flat_field, !(curc->p_linear));
+                out += wcount;
+                nOut += (uint64_t) wcount;
+            }
+            else
+            {
+                /* close to the end of the buffer, one block at a time */
+                for (int x = 0; x < nx - n; x += 4)
                 {
-                    memcpy (&s[0], row0, 4 * sizeof (uint16_t));
-                    memcpy (&s[4], row1, 4 * sizeof (uint16_t));
-                    memcpy (&s[8], row2, 4 * sizeof (uint16_t));
-                    memcpy (&s[12], row3, 4 * sizeof (uint16_t));
+                    const uint16_t* const block[4] = {
+                        rows[0] + x, rows[1] + x, rows[2] + x, rows[3] + x};
+
+                    wcount = pack_blocks (
+                        block, 1, out, flat_field, !(curc->p_linear));
+                    out += wcount;
+                    nOut += (uint64_t) wcount;
+                    if (nOut + 14 > encode->compressed_alloc_size)
+                        return EXR_ERR_OUT_OF_MEMORY;
                 }
+            }
 
-                row0 += 4;
-                row1 += 4;
-                row2 += 4;
-                row3 += 4;
+            if (n > 0)
+            {
+                uint16_t s[16];
+                int      x = 4 * nblocks;
 
-                //
-                // Compress the contents of array s and append the
-                // results to the output buffer.
-                //
+                for (int i = 0; i < 4; ++i)
+                {
+                    int j = i;
+                    if (j > n - 1) j = n - 1;
 
-                if (curc->p_linear) convertFromLinear (s);
+                    s[i + 0]  = rows[0][x + j];
+                    s[i + 4]  = rows[1][x + j];
+                    s[i + 8]  = rows[2][x + j];
+                    s[i + 12] = rows[3][x + j];
+                }
 
                 wcount = pack (s, out, flat_field, !(curc->p_linear));
                 out += wcount;
@@ -484,7 +1557,6 @@ uncompress_b44_impl (
     uint8_t*       out     = uncompressed_data;
     uint8_t*       scratch = decode->scratch_buffer_1;
     uint8_t*       tmp;
-    uint16_t *     row0, *row1, *row2, *row3;
     uint64_t       n, nBytes, bpl = 0, bIn = 0;
     int            nx, ny;
     uint16_t       s[16];
@@ -511,55 +1583,48 @@ uncompress_b44_impl (
 
         for (int y = 0; y < ny; y += 4)
         {
-            row0 = (uint16_t*) scratch;
-            row0 += y * nx;
-            row1 = row0 + nx;
-            row2 = row1 + nx;
-            row3 = row2 + nx;
-            for (int x = 0; x < nx; x += 4)
+            uint16_t* rows[4];
+            int       nblocks = (y + 3 < ny) ? nx / 4 : 0;
+            int       nin;
+
+            rows[0] = (uint16_t*) scratch + (uint64_t) y * (uint64_t) nx;
+            rows[1] = rows[0] + nx;
+            rows[2] = rows[1] + nx;
+            rows[3] = rows[2] + nx;
+
+            /*
+             * Whole blocks go straight to scratch, the ones past the
+             * right or the bottom edge through array s.
+             */
+            nin = unpack_blocks (in, comp_buf_size - bIn, nblocks, rows);
+            if (nin < 0) return EXR_ERR_OUT_OF_MEMORY;
+            in += nin;
+            bIn += (uint64_t) nin;
+
+            for (int x = 4 * nblocks; x < nx; x += 4)
             {
-                if (bIn + 3 > comp_buf_size) return EXR_ERR_OUT_OF_MEMORY;
-
-                /* check if 3-byte encoded flat field */
-                if (in[2] >= (13 << 2))
-                {
-                    unpack3 (in, s);
-                    in += 3;
-                    bIn += 3;
-                }
-                else
-                {
-                    if (bIn + 14 > comp_buf_size) return EXR_ERR_OUT_OF_MEMORY;
-                    unpack14 (in, s);
-                    in += 14;
-                    bIn += 14;
-                }
+                uint16_t* const srows[4] = {&s[0], &s[4], &s[8], &s[12]};
 
-                if (curc->p_linear) convertToLinear (s);
-
-                priv_from_native16 (s, 16);
+                nin = unpack_blocks (in, comp_buf_size - bIn, 1, srows);
+                if (nin < 0) return EXR_ERR_OUT_OF_MEMORY;
+                in += nin;
+                bIn += (uint64_t) nin;
 
                 n = (x + 3 < nx) ? 4 * sizeof (uint16_t)
                                  : (uint64_t) (nx - x) * sizeof (uint16_t);
-                if (y + 3 < ny)
-                {
-                    memcpy (row0, &s[0], n);
-                    memcpy (row1, &s[4], n);
-                    memcpy (row2, &s[8], n);
-                    memcpy (row3, &s[12], n);
-                }
-                else
-                {
-                    memcpy (row0, &s[0], n);
-                    if (y + 1 < ny) memcpy (row1, &s[4], n);
-                    if (y + 2 < ny) memcpy (row2, &s[8], n);
-                }
-                row0 += 4;
-                row1 += 4;
-                row2 += 4;
-                row3 += 4;
+
+                memcpy (rows[0] + x, &s[0], n);
+                if (y + 1 < ny) memcpy (rows[1] + x, &s[4], n);
+                if (y + 2 < ny) memcpy (rows[2] + x, &s[8], n);
+                if (y + 3 < ny) memcpy (rows[3] + x, &s[12], n);
             }
         }
+
+        if (curc->p_linear)
+            convertToLinear ((uint16_t*) scratch, (uint64_t) nx * (uint64_t) ny);
+
+        priv_from_native16 (scratch, nx * ny);
+
         scratch += nBytes;
     }
 
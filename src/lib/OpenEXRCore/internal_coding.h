@@ -57,8 +57,19 @@ internal_exr_unpack_fn internal_exr_match_decode (
 
 typedef exr_result_t (*internal_exr_pack_fn) (exr_encode_pipeline_t*);
 
-internal_exr_pack_fn
-internal_exr_match_encode (exr_encode_pipeline_t* encode, int isdeep);
+internal_exr_pack_fn internal_exr_match_encode (
+    exr_encode_pipeline_t* encode,
+    int                    isdeep,
+    int                    chanstopack,
+    int                    sametype,
+    int                    sameintype,
+    int                    samebpc,
+    int                    sameinbpc,
+    int                    hassampling,
+    int                    hastypechange,
+    int                    sameininc,
+    int                    simpinterleave,
+    int                    simpinterleaverev);
 
 exr_result_t internal_coding_fill_channel_info (
     exr_coding_channel_info_t**         channels,
@@ -80,6 +91,11 @@ exr_result_t internal_validate_next_chunk (
     const struct _internal_exr_context* pctxt,
     const struct _internal_exr_part*    part);
 
+exr_result_t internal_validate_chunk_read (
+    const struct _internal_exr_context* pctxt,
+    const struct _internal_exr_part*    part,
+    const exr_chunk_info_t*             cinfo);
+
 /**************************************/
 
 exr_result_t internal_encode_free_buffer (
@@ -11,6 +11,52 @@
 uint64_t internal_rle_compress (
     void* out, uint64_t outbytes, const void* src, uint64_t srcbytes);
 
+/*
+ * zlib stream deflate, using libdeflate when the library is built with
+ * OPENEXR_USE_LIBDEFLATE and zlib otherwise. level is a zlib level,
+ * or -1 for the default. libdeflate compressors are cached in ctxt,
+ * which may be NULL.
+ */
+exr_result_t internal_exr_deflate (
+    exr_const_context_t ctxt,
+    int                 level,
+    void*               out,
+    uint64_t            outbytes,
+    const void*         src,
+    uint64_t            srcbytes,
+    uint64_t*           actual_out);
+
+/*
+ * the zlib level requested for a part via the zipCompressionLevel
+ * attribute, or -1 when not set
+ */
+exr_result_t internal_exr_zip_compression_level (
+    exr_const_context_t ctxt, int part_index, int* level);
+
+/*
+ * byte reorder + delta predictor + deflate, as used by the ZIP
+ * compressors, exposed for re-use by other codecs. Unlike
+ * internal_exr_apply_zip, does not fall back to the raw data when
+ * the result is larger.
+ */
+exr_result_t internal_zip_compress (
+    exr_const_context_t ctxt,
+    uint64_t*           compressed_size,
+    void*               compressed_data,
+    uint64_t            comp_buf_size,
+    const void*         raw_data,
+    uint64_t            raw_size,
+    void*               scratch_data,
+    uint64_t            scratch_size,
+    int                 level);
+
+/*
+ * splits the even and odd bytes of source into the two halves of
+ * scratch and applies the delta predictor, shared by ZIP and RLE
+ */
+void internal_zip_deconstruct_bytes (
+    uint8_t* scratch, const uint8_t* source, uint64_t count);
+
 exr_result_t internal_exr_apply_rle (exr_encode_pipeline_t* encode);
 
 exr_result_t internal_exr_apply_zip (exr_encode_pipeline_t* encode);
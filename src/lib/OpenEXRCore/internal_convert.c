@@ -0,0 +1,399 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#include "internal_convert.h"
+
+#include "internal_coding.h"
+#include "internal_cpuid.h"
+
+#include <math.h>
+#include <string.h>
+
+/**************************************/
+
+/*
+ * Scalar versions. The 32 bit values go through memcpy as they may
+ * not be aligned inside the packed buffers.
+ */
+
+static void
+half_to_float_scalar (float* out, const uint16_t* in, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        float f = half_to_float (in[i]);
+        memcpy (out + i, &f, sizeof (float));
+    }
+}
+
+static void
+float_to_half_scalar (uint16_t* out, const float* in, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        float f;
+        memcpy (&f, in + i, sizeof (float));
+        out[i] = float_to_half (f);
+    }
+}
+
+static void
+half_to_uint_scalar (uint32_t* out, const uint16_t* in, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint32_t u = half_to_uint (in[i]);
+        memcpy (out + i, &u, sizeof (uint32_t));
+    }
+}
+
+static void
+uint_to_half_scalar (uint16_t* out, const uint32_t* in, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint32_t u;
+        memcpy (&u, in + i, sizeof (uint32_t));
+        out[i] = uint_to_half (u);
+    }
+}
+
+/**************************************/
+
+#if defined(EXR_HAVE_AVX2_TARGET)
+
+/*
+ * The hardware rounds to nearest even, same as float_to_half, and
+ * only differs in how NaN payloads are quieted, so those lanes are
+ * redone with the scalar conversion to stay bit exact.
+ */
+static void
+fix_nans (uint16_t* out, const float* in, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        float f;
+        memcpy (&f, in + i, sizeof (float));
+        if (isnan (f)) out[i] = float_to_half (f);
+    }
+}
+
+/* and the other way, where the hardware sets the quiet bit */
+static void
+fix_half_nans (float* out, const uint16_t* in, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        if ((in[i] & 0x7fff) > 0x7c00)
+        {
+            float f = half_to_float (in[i]);
+            memcpy (out + i, &f, sizeof (float));
+        }
+    }
+}
+
+/*
+ * F16C (which needs AVX for the 8 wide forms). Partial blocks are
+ * converted through a small zero padded buffer so every value goes
+ * through the same instruction.
+ */
+
+EXR_TARGET_F16C static void
+half_to_float_f16c (float* out, const uint16_t* in, uint64_t count)
+{
+    const __m128i absmask = _mm_set1_epi16 (0x7fff);
+    const __m128i expmask = _mm_set1_epi16 (0x7c00);
+    uint64_t      i       = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i h = _mm_loadu_si128 ((const __m128i*) (in + i));
+
+        _mm256_storeu_ps (out + i, _mm256_cvtph_ps (h));
+        if (_mm_movemask_epi8 (
+                _mm_cmpgt_epi16 (_mm_and_si128 (h, absmask), expmask)))
+            fix_half_nans (out + i, in + i, 8);
+    }
+
+    if (i < count)
+    {
+        uint16_t tin[8] = { 0 };
+        float    tout[8];
+
+        memcpy (tin, in + i, (count - i) * sizeof (uint16_t));
+        half_to_float_f16c (tout, tin, 8);
+        memcpy (out + i, tout, (count - i) * sizeof (float));
+    }
+}
+
+EXR_TARGET_F16C static void
+float_to_half_f16c (uint16_t* out, const float* in, uint64_t count)
+{
+    uint64_t i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps (in + i);
+
+        _mm_storeu_si128 (
+            (__m128i*) (out + i),
+            _mm256_cvtps_ph (v, _MM_FROUND_TO_NEAREST_INT));
+        if (_mm256_movemask_ps (_mm256_cmp_ps (v, v, _CMP_UNORD_Q)))
+            fix_nans (out + i, in + i, 8);
+    }
+
+    if (i < count)
+    {
+        float    tin[8] = { 0.f };
+        uint16_t tout[8];
+
+        memcpy (tin, in + i, (count - i) * sizeof (float));
+        float_to_half_f16c (tout, tin, 8);
+        memcpy (out + i, tout, (count - i) * sizeof (uint16_t));
+    }
+}
+
+/*
+ * max against zero sends negative values and NaN (max returns the
+ * second operand when unordered) to 0, the remaining finite values
+ * fit in an int, and +inf saturates.
+ */
+EXR_TARGET_F16C static void
+half_to_uint_f16c (uint32_t* out, const uint16_t* in, uint64_t count)
+{
+    const __m256 zero = _mm256_setzero_ps ();
+    const __m256 inf  = _mm256_set1_ps (INFINITY);
+    uint64_t     i    = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 f = _mm256_max_ps (
+            _mm256_cvtph_ps (_mm_loadu_si128 ((const __m128i*) (in + i))),
+            zero);
+        __m256 r = _mm256_castsi256_ps (_mm256_cvttps_epi32 (f));
+
+        r = _mm256_or_ps (r, _mm256_cmp_ps (f, inf, _CMP_EQ_OQ));
+        _mm256_storeu_ps ((float*) (out + i), r);
+    }
+
+    if (i < count)
+    {
+        uint16_t tin[8] = { 0 };
+        uint32_t tout[8];
+
+        memcpy (tin, in + i, (count - i) * sizeof (uint16_t));
+        half_to_uint_f16c (tout, tin, 8);
+        memcpy (out + i, tout, (count - i) * sizeof (uint32_t));
+    }
+}
+
+/*
+ * anything above the largest half becomes inf, clamp so the value is
+ * exact as a float, then push the clamped lanes out of half range.
+ */
+EXR_TARGET_F16C static void
+uint_to_half_f16c (uint16_t* out, const uint32_t* in, uint64_t count)
+{
+    const __m128i lim  = _mm_set1_epi32 (65505);
+    const __m256  hmax = _mm256_set1_ps (65504.f);
+    const __m256  big  = _mm256_set1_ps (65536.f);
+    uint64_t      i    = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i a = _mm_loadu_si128 ((const __m128i*) (in + i));
+        __m128i b = _mm_loadu_si128 ((const __m128i*) (in + i + 4));
+        __m256  f;
+
+        a = _mm_min_epu32 (a, lim);
+        b = _mm_min_epu32 (b, lim);
+        f = _mm256_cvtepi32_ps (
+            _mm256_insertf128_si256 (_mm256_castsi128_si256 (a), b, 1));
+
+        f = _mm256_blendv_ps (f, big, _mm256_cmp_ps (f, hmax, _CMP_GT_OQ));
+        _mm_storeu_si128 (
+            (__m128i*) (out + i),
+            _mm256_cvtps_ph (f, _MM_FROUND_TO_NEAREST_INT));
+    }
+
+    if (i < count)
+    {
+        uint32_t tin[8] = { 0 };
+        uint16_t tout[8];
+
+        memcpy (tin, in + i, (count - i) * sizeof (uint32_t));
+        uint_to_half_f16c (tout, tin, 8);
+        memcpy (out + i, tout, (count - i) * sizeof (uint16_t));
+    }
+}
+
+/**************************************/
+
+/*
+ * AVX-512 foundation has the 16 wide conversions, the remainder goes
+ * through the F16C versions (AVX-512F implies F16C).
+ */
+
+EXR_TARGET_AVX512 static void
+half_to_float_avx512 (float* out, const uint16_t* in, uint64_t count)
+{
+    const __m512i absmask = _mm512_set1_epi32 (0x7fff);
+    const __m512i expmask = _mm512_set1_epi32 (0x7c00);
+    uint64_t      i       = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i h = _mm256_loadu_si256 ((const __m256i*) (in + i));
+
+        _mm512_storeu_ps (out + i, _mm512_cvtph_ps (h));
+        if (_mm512_cmpgt_epi32_mask (
+                _mm512_and_si512 (_mm512_cvtepu16_epi32 (h), absmask),
+                expmask))
+            fix_half_nans (out + i, in + i, 16);
+    }
+    if (i < count) half_to_float_f16c (out + i, in + i, count - i);
+}
+
+EXR_TARGET_AVX512 static void
+float_to_half_avx512 (uint16_t* out, const float* in, uint64_t count)
+{
+    uint64_t i = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512 v = _mm512_loadu_ps (in + i);
+
+        _mm256_storeu_si256 (
+            (__m256i*) (out + i),
+            _mm512_cvtps_ph (v, _MM_FROUND_TO_NEAREST_INT));
+        if (_mm512_cmp_ps_mask (v, v, _CMP_UNORD_Q))
+            fix_nans (out + i, in + i, 16);
+    }
+    if (i < count) float_to_half_f16c (out + i, in + i, count - i);
+}
+
+EXR_TARGET_AVX512 static void
+half_to_uint_avx512 (uint32_t* out, const uint16_t* in, uint64_t count)
+{
+    const __m512  zero = _mm512_setzero_ps ();
+    const __m512  inf  = _mm512_set1_ps (INFINITY);
+    const __m512i ones = _mm512_set1_epi32 (-1);
+    uint64_t      i    = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512 f = _mm512_max_ps (
+            _mm512_cvtph_ps (_mm256_loadu_si256 ((const __m256i*) (in + i))),
+            zero);
+
+        _mm512_storeu_si512 (
+            out + i,
+            _mm512_mask_mov_epi32 (
+                _mm512_cvttps_epi32 (f),
+                _mm512_cmp_ps_mask (f, inf, _CMP_EQ_OQ),
+                ones));
+    }
+    if (i < count) half_to_uint_f16c (out + i, in + i, count - i);
+}
+
+EXR_TARGET_AVX512 static void
+uint_to_half_avx512 (uint16_t* out, const uint32_t* in, uint64_t count)
+{
+    const __m512i lim  = _mm512_set1_epi32 (65505);
+    const __m512i hmax = _mm512_set1_epi32 (65504);
+    const __m512  big  = _mm512_set1_ps (65536.f);
+    uint64_t      i    = 0;
+
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512i v = _mm512_min_epu32 (_mm512_loadu_si512 (in + i), lim);
+        __m512  f = _mm512_mask_mov_ps (
+            _mm512_cvtepi32_ps (v), _mm512_cmpgt_epu32_mask (v, hmax), big);
+
+        _mm256_storeu_si256 (
+            (__m256i*) (out + i),
+            _mm512_cvtps_ph (f, _MM_FROUND_TO_NEAREST_INT));
+    }
+    if (i < count) uint_to_half_f16c (out + i, in + i, count - i);
+}
+
+#endif /* EXR_HAVE_AVX2_TARGET */
+
+/**************************************/
+
+static void (*half_to_float_func) (float*, const uint16_t*, uint64_t) =
+    &half_to_float_scalar;
+static void (*float_to_half_func) (uint16_t*, const float*, uint64_t) =
+    &float_to_half_scalar;
+static void (*half_to_uint_func) (uint32_t*, const uint16_t*, uint64_t) =
+    &half_to_uint_scalar;
+static void (*uint_to_half_func) (uint16_t*, const uint32_t*, uint64_t) =
+    &uint_to_half_scalar;
+
+/*
+ * Only ever transitions to the same answer, so racing threads are
+ * harmless.
+ */
+void
+internal_exr_init_convert_funcs (void)
+{
+    static int init_cpu_check = 1;
+
+    if (!init_cpu_check) return;
+
+#if defined(EXR_HAVE_AVX2_TARGET)
+    {
+        int f16c, avx, sse2;
+
+        check_for_x86_simd (&f16c, &avx, &sse2);
+        if (check_for_x86_avx512f ())
+        {
+            half_to_float_func = &half_to_float_avx512;
+            float_to_half_func = &float_to_half_avx512;
+            half_to_uint_func  = &half_to_uint_avx512;
+            uint_to_half_func  = &uint_to_half_avx512;
+        }
+        else if (avx && f16c)
+        {
+            half_to_float_func = &half_to_float_f16c;
+            float_to_half_func = &float_to_half_f16c;
+            half_to_uint_func  = &half_to_uint_f16c;
+            uint_to_half_func  = &uint_to_half_f16c;
+        }
+    }
+#endif
+
+    init_cpu_check = 0;
+}
+
+/**************************************/
+
+void
+internal_exr_half_to_float_buffer (
+    float* out, const uint16_t* in, uint64_t count)
+{
+    half_to_float_func (out, in, count);
+}
+
+void
+internal_exr_float_to_half_buffer (
+    uint16_t* out, const float* in, uint64_t count)
+{
+    float_to_half_func (out, in, count);
+}
+
+void
+internal_exr_half_to_uint_buffer (
+    uint32_t* out, const uint16_t* in, uint64_t count)
+{
+    half_to_uint_func (out, in, count);
+}
+
+void
+internal_exr_uint_to_half_buffer (
+    uint16_t* out, const uint32_t* in, uint64_t count)
+{
+    uint_to_half_func (out, in, count);
+}
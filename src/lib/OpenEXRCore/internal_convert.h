@@ -0,0 +1,42 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#ifndef OPENEXR_CORE_CONVERT_H
+#define OPENEXR_CORE_CONVERT_H
+
+#include <stdint.h>
+
+/*
+ * Bulk conversions between the pixel types used by the pack and
+ * unpack routines. These produce exactly the same values as the
+ * per value half_to_float, float_to_half, half_to_uint and
+ * uint_to_half in internal_coding.h, but pick F16C or AVX-512 kernels
+ * at runtime when the cpu has them.
+ *
+ * All values are in native byte order. The 32 bit side only needs to
+ * be 2 byte aligned, so these may be pointed directly into the packed
+ * buffers.
+ */
+
+void internal_exr_half_to_float_buffer (
+    float* out, const uint16_t* in, uint64_t count);
+
+void internal_exr_float_to_half_buffer (
+    uint16_t* out, const float* in, uint64_t count);
+
+void internal_exr_half_to_uint_buffer (
+    uint32_t* out, const uint16_t* in, uint64_t count);
+
+void internal_exr_uint_to_half_buffer (
+    uint16_t* out, const uint32_t* in, uint64_t count);
+
+/*
+ * selects the implementations for the running cpu, safe to call
+ * repeatedly (and from multiple threads). Until called, the scalar
+ * versions are used.
+ */
+void internal_exr_init_convert_funcs (void);
+
+#endif /* OPENEXR_CORE_CONVERT_H */
@@ -0,0 +1,221 @@
+/*
+** SPDX-License-Identifier: BSD-3-Clause
+** Copyright Contributors to the OpenEXR Project.
+*/
+
+#ifndef OPENEXR_PRIVATE_CPUID_H
+#define OPENEXR_PRIVATE_CPUID_H
+
+/*
+ * Compile time and runtime detection of the SIMD instruction sets the
+ * codecs have kernels for, mirroring Imf::CpuId and ImfSimd.h.
+ *
+ * SSE2 (x86-64) and NEON (arm) kernels are chosen at compile
+ * time, or by check_for_arm_neon where there are both NEON and scalar
+ * versions to pick between. Kernels for newer x86 extensions are compiled with per
+ * function target attributes (EXR_TARGET_AVX2, EXR_TARGET_F16C,
+ * EXR_TARGET_AVX512) and only called when the runtime checks below
+ * say the cpu and OS support them.
+ */
+
+#include <OpenEXRConfigInternal.h>
+
+#if defined __SSE2__ || (_MSC_VER >= 1300 && !_M_CEE_PURE)
+#    define IMF_HAVE_SSE2 1
+#    include <emmintrin.h>
+#    include <mmintrin.h>
+#endif
+
+#if defined(OPENEXR_IMF_HAVE_GCC_INLINE_ASM_AVX) &&                          \
+    (defined(_M_X64) || defined(__x86_64__))
+#    define IMF_HAVE_GCC_INLINEASM_X86
+#    ifdef __LP64__
+#        define IMF_HAVE_GCC_INLINEASM_X86_64
+#    endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    define IMF_HAVE_NEON 1
+#    include <arm_neon.h>
+#endif
+
+/* AArch64 adds the half <-> float conversions and wide table lookups */
+#if defined(IMF_HAVE_NEON) && defined(__aarch64__) &&                        \
+    !defined(__ARM_BIG_ENDIAN)
+#    define IMF_HAVE_NEON_AARCH64 1
+#endif
+
+#if defined(IMF_HAVE_NEON) && defined(__aarch64__) && defined(__linux__)
+#    include <sys/auxv.h>
+#    ifndef HWCAP_ASIMD
+#        define HWCAP_ASIMD (1 << 1)
+#    endif
+#endif
+
+#if defined(IMF_HAVE_SSE2) && defined(IMF_HAVE_GCC_INLINEASM_X86) &&         \
+    !defined(__e2k__)
+#    define EXR_HAVE_AVX2_TARGET 1
+#    define EXR_TARGET_AVX2 __attribute__ ((target ("avx2")))
+#    define EXR_TARGET_F16C __attribute__ ((target ("avx,f16c")))
+#    define EXR_TARGET_AVX512 __attribute__ ((target ("avx512f")))
+#    include <immintrin.h>
+#endif
+
+/**************************************/
+
+/*
+ * Runtime detection of the cpu features the DWA kernels care about,
+ * in the same manner as Imf::CpuId
+ */
+
+static inline void
+check_for_x86_simd (int* f16c, int* avx, int* sse2)
+{
+#if defined(IMF_HAVE_SSE2) && defined(__GNUC__) && !defined(__e2k__) &&      \
+    defined(IMF_HAVE_GCC_INLINEASM_X86)
+    int max = 0;
+    int eax, ebx, ecx, edx;
+
+    __asm__ __volatile__("cpuid"
+                         : "=a"(max), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                         : "a"(0)
+                         :);
+
+    *f16c = 0;
+    *avx  = 0;
+    *sse2 = 0;
+    if (max > 0)
+    {
+        int osxsave;
+
+        __asm__ __volatile__("cpuid"
+                             : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                             : "a"(1)
+                             :);
+
+        *sse2   = (edx & (1 << 26)) ? 1 : 0;
+        osxsave = (ecx & (1 << 27)) ? 1 : 0;
+        *avx    = (ecx & (1 << 28)) ? 1 : 0;
+        *f16c   = (ecx & (1 << 29)) ? 1 : 0;
+
+        if (!osxsave) { *avx = *f16c = 0; }
+        else
+        {
+            __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0) :);
+            /* eax bit 1 - SSE managed, bit 2 - AVX managed */
+            if ((eax & 6) != 6) { *avx = *f16c = 0; }
+        }
+    }
+#elif defined(IMF_HAVE_SSE2) && defined(__e2k__)
+    *f16c = 0;
+    *avx  = 0;
+    *sse2 = 1;
+#else
+    *f16c = 0;
+    *avx  = 0;
+    *sse2 = 0;
+#endif
+}
+
+/**************************************/
+
+/*
+ * AVX2 additionally needs the extended feature leaf, as well as the
+ * OS saving the AVX state
+ */
+
+static inline int
+check_for_x86_avx2 (void)
+{
+#ifdef EXR_HAVE_AVX2_TARGET
+    int max = 0;
+    int eax, ebx, ecx, edx;
+
+    __asm__ __volatile__("cpuid"
+                         : "=a"(max), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                         : "a"(0)
+                         :);
+    if (max < 7) return 0;
+
+    __asm__ __volatile__("cpuid"
+                         : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                         : "a"(1)
+                         :);
+    /* osxsave + avx */
+    if ((ecx & ((1 << 27) | (1 << 28))) != ((1 << 27) | (1 << 28))) return 0;
+
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0) :);
+    if ((eax & 6) != 6) return 0;
+
+    __asm__ __volatile__("cpuid"
+                         : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                         : "a"(7), "c"(0)
+                         :);
+    return (ebx & (1 << 5)) ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+/**************************************/
+
+/*
+ * AVX-512 foundation, which needs the OS to save the opmask and upper
+ * zmm state on top of the AVX state
+ */
+
+static inline int
+check_for_x86_avx512f (void)
+{
+#ifdef EXR_HAVE_AVX2_TARGET
+    int max = 0;
+    int eax, ebx, ecx, edx;
+
+    __asm__ __volatile__("cpuid"
+                         : "=a"(max), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                         : "a"(0)
+                         :);
+    if (max < 7) return 0;
+
+    __asm__ __volatile__("cpuid"
+                         : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                         : "a"(1)
+                         :);
+    /* osxsave */
+    if (!(ecx & (1 << 27))) return 0;
+
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0) :);
+    /* sse, avx, opmask, zmm0-15 upper halves, zmm16-31 */
+    if ((eax & 0xe6) != 0xe6) return 0;
+
+    __asm__ __volatile__("cpuid"
+                         : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                         : "a"(7), "c"(0)
+                         :);
+    return (ebx & (1 << 16)) ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+/**************************************/
+
+/*
+ * NEON is part of the base AArch64 instruction set, and elsewhere
+ * we were compiled to require it, but ask the OS where it reports
+ * the hardware capabilities, in the same manner as Imf::CpuId
+ */
+
+static inline int
+check_for_arm_neon (void)
+{
+#if defined(IMF_HAVE_NEON) && defined(__aarch64__) && defined(__linux__)
+    return (getauxval (AT_HWCAP) & HWCAP_ASIMD) ? 1 : 0;
+#elif defined(IMF_HAVE_NEON)
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+#endif /* OPENEXR_PRIVATE_CPUID_H */
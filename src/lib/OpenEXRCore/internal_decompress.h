@@ -24,6 +24,38 @@ exr_result_t internal_exr_undo_rle (
     void*                  uncompressed_data,
     uint64_t               uncompressed_size);
 
+/*
+ * zlib stream inflate counterpart of internal_exr_deflate, actual_out
+ * receives the number of bytes decoded
+ */
+exr_result_t internal_exr_inflate (
+    exr_const_context_t ctxt,
+    void*               out,
+    uint64_t            outbytes,
+    const void*         src,
+    uint64_t            srcbytes,
+    uint64_t*           actual_out);
+
+/*
+ * inflate + undo predictor / reorder of internal_zip_compress, the
+ * result must be exactly uncompressed_size bytes
+ */
+exr_result_t internal_zip_decompress (
+    exr_const_context_t ctxt,
+    const void*         compressed_data,
+    uint64_t            comp_buf_size,
+    void*               uncompressed_data,
+    uint64_t            uncompressed_size,
+    void*               scratch_data,
+    uint64_t            scratch_size);
+
+/*
+ * inverse of internal_zip_deconstruct_bytes, scratch is modified in
+ * place before being interleaved into out
+ */
+void internal_zip_reconstruct_bytes (
+    uint8_t* out, uint8_t* scratch, uint64_t count);
+
 exr_result_t internal_exr_undo_zip (
     exr_decode_pipeline_t* decode,
     const void*            compressed_data,
@@ -6,22 +6,2541 @@
 #include "internal_compress.h"
 #include "internal_decompress.h"
 
-#include "internal_xdr.h"
+#include "internal_attr.h"
+#include "internal_coding.h"
+#include "internal_huf.h"
 #include "internal_structs.h"
+#include "internal_xdr.h"
 
+#include "internal_dwa_simd.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
+#include <zlib.h>
+
+/*
+ * Lookup tables, also used by the C++ DwaCompressor:
+ *   dwaCompressorNoOp[]        - identity (half -> half)
+ *   dwaCompressorToLinear[]    - nonlinear -> linear (half -> half)
+ *   dwaCompressorToNonlinear[] - linear -> nonlinear (half -> half)
+ *   closestDataOffset[], closestData[] - candidate values with fewer
+ *                                bits set, used for quantization
+ */
+#include "dwaLookups.h"
+
+/*
+ * This is a port of the DWAA / DWAB lossy compressor from the C++
+ * library (ImfDwaCompressor.cpp). It produces byte-identical output,
+ * and decodes identically, given the same runtime cpu dispatch of
+ * the kernels in internal_dwa_simd.h.
+ *
+ * Channels are classified into one of three schemes based on the
+ * suffix of the channel name (after the last '.'), and the pixel type:
+ *
+ *   LOSSY_DCT - 8x8 DCT, quantized and entropy coded. Sets of
+ *               R,G,B channels sharing a prefix are converted to
+ *               Y'CbCr first.
+ *   RLE       - byte planes, RLE'd and then deflated (alpha)
+ *   UNKNOWN   - deflated losslessly (everything else)
+ *
+ * The compressed chunk is laid out as:
+ *
+ *   NUM_SIZES_SINGLE uint64_t counters (XDR)
+ *   channel classification rules (version >= 2)
+ *   UNKNOWN data (deflate)
+ *   AC coefficients (static huffman or deflate)
+ *   DC coefficients (zip)
+ *   RLE data (rle + deflate)
+ */
+
+/**************************************/
+
+enum CompressorScheme
+{
+    UNKNOWN = 0,
+    LOSSY_DCT,
+    RLE,
+
+    NUM_COMPRESSOR_SCHEMES
+};
+
+enum AcCompression
+{
+    STATIC_HUFFMAN = 0,
+    DEFLATE
+};
+
+/*
+ * Per-chunk data header, stored as uint64_t XDR values
+ */
+enum DataSizesSingle
+{
+    VERSION = 0,
+    UNKNOWN_UNCOMPRESSED_SIZE,
+    UNKNOWN_COMPRESSED_SIZE,
+    AC_COMPRESSED_SIZE,
+    DC_COMPRESSED_SIZE,
+    RLE_COMPRESSED_SIZE,
+    RLE_UNCOMPRESSED_SIZE,
+    RLE_RAW_SIZE,
+
+    AC_UNCOMPRESSED_COUNT,
+    DC_UNCOMPRESSED_COUNT,
+
+    AC_COMPRESSION,
+
+    NUM_SIZES_SINGLE
+};
+
+#define DWA_HEADER_BYTES (NUM_SIZES_SINGLE * sizeof (uint64_t))
+
+/* the largest half value, used to clamp FLOAT data prior to encoding */
+#define DWA_HALF_MAX 65504.0f
+
+/**************************************/
+
+typedef struct _Classifier
+{
+    const char*      suffix;
+    int              scheme;
+    exr_pixel_type_t type;
+    int              cscIdx;
+    int              caseInsensitive;
+} Classifier;
+
+/*
+ * Channel classification rules to use when writing files
+ */
+static const Classifier sDefaultChannelRules[] = {
+    { "R", LOSSY_DCT, EXR_PIXEL_HALF, 0, 0 },
+    { "R", LOSSY_DCT, EXR_PIXEL_FLOAT, 0, 0 },
+    { "G", LOSSY_DCT, EXR_PIXEL_HALF, 1, 0 },
+    { "G", LOSSY_DCT, EXR_PIXEL_FLOAT, 1, 0 },
+    { "B", LOSSY_DCT, EXR_PIXEL_HALF, 2, 0 },
+    { "B", LOSSY_DCT, EXR_PIXEL_FLOAT, 2, 0 },
+
+    { "Y", LOSSY_DCT, EXR_PIXEL_HALF, -1, 0 },
+    { "Y", LOSSY_DCT, EXR_PIXEL_FLOAT, -1, 0 },
+    { "BY", LOSSY_DCT, EXR_PIXEL_HALF, -1, 0 },
+    { "BY", LOSSY_DCT, EXR_PIXEL_FLOAT, -1, 0 },
+    { "RY", LOSSY_DCT, EXR_PIXEL_HALF, -1, 0 },
+    { "RY", LOSSY_DCT, EXR_PIXEL_FLOAT, -1, 0 },
+
+    { "A", RLE, EXR_PIXEL_UINT, -1, 0 },
+    { "A", RLE, EXR_PIXEL_HALF, -1, 0 },
+    { "A", RLE, EXR_PIXEL_FLOAT, -1, 0 }
+};
+
+/*
+ * Channel classification rules used when reading files with VERSION < 2
+ */
+static const Classifier sLegacyChannelRules[] = {
+    { "r", LOSSY_DCT, EXR_PIXEL_HALF, 0, 1 },
+    { "r", LOSSY_DCT, EXR_PIXEL_FLOAT, 0, 1 },
+    { "red", LOSSY_DCT, EXR_PIXEL_HALF, 0, 1 },
+    { "red", LOSSY_DCT, EXR_PIXEL_FLOAT, 0, 1 },
+    { "g", LOSSY_DCT, EXR_PIXEL_HALF, 1, 1 },
+    { "g", LOSSY_DCT, EXR_PIXEL_FLOAT, 1, 1 },
+    { "grn", LOSSY_DCT, EXR_PIXEL_HALF, 1, 1 },
+    { "grn", LOSSY_DCT, EXR_PIXEL_FLOAT, 1, 1 },
+    { "green", LOSSY_DCT, EXR_PIXEL_HALF, 1, 1 },
+    { "green", LOSSY_DCT, EXR_PIXEL_FLOAT, 1, 1 },
+    { "b", LOSSY_DCT, EXR_PIXEL_HALF, 2, 1 },
+    { "b", LOSSY_DCT, EXR_PIXEL_FLOAT, 2, 1 },
+    { "blu", LOSSY_DCT, EXR_PIXEL_HALF, 2, 1 },
+    { "blu", LOSSY_DCT, EXR_PIXEL_FLOAT, 2, 1 },
+    { "blue", LOSSY_DCT, EXR_PIXEL_HALF, 2, 1 },
+    { "blue", LOSSY_DCT, EXR_PIXEL_FLOAT, 2, 1 },
+
+    { "y", LOSSY_DCT, EXR_PIXEL_HALF, -1, 1 },
+    { "y", LOSSY_DCT, EXR_PIXEL_FLOAT, -1, 1 },
+    { "by", LOSSY_DCT, EXR_PIXEL_HALF, -1, 1 },
+    { "by", LOSSY_DCT, EXR_PIXEL_FLOAT, -1, 1 },
+    { "ry", LOSSY_DCT, EXR_PIXEL_HALF, -1, 1 },
+    { "ry", LOSSY_DCT, EXR_PIXEL_FLOAT, -1, 1 },
+    { "a", RLE, EXR_PIXEL_UINT, -1, 1 },
+    { "a", RLE, EXR_PIXEL_HALF, -1, 1 },
+    { "a", RLE, EXR_PIXEL_FLOAT, -1, 1 }
+};
+
+#define NUM_DEFAULT_RULES                                                      \
+    (int) (sizeof (sDefaultChannelRules) / sizeof (Classifier))
+#define NUM_LEGACY_RULES                                                       \
+    (int) (sizeof (sLegacyChannelRules) / sizeof (Classifier))
+
+/**************************************/
+
+static int
+Classifier_match (
+    const Classifier* me, const char* suffix, exr_pixel_type_t type)
+{
+    if (me->type != type) return 0;
+
+    if (me->caseInsensitive)
+    {
+        const char* a = suffix;
+        const char* b = me->suffix;
+
+        while (*a && *b)
+        {
+            if (tolower ((unsigned char) *a) != (unsigned char) *b) return 0;
+            ++a;
+            ++b;
+        }
+        return *a == *b;
+    }
+
+    return strcmp (suffix, me->suffix) == 0;
+}
+
+static uint64_t
+Classifier_size (const Classifier* me)
+{
+    /* string length + \0, 1 byte for scheme / cscIdx / caseInsensitive,
+     * and 1 byte for type */
+    return strlen (me->suffix) + 1 + 2;
+}
+
+static void
+Classifier_write (const Classifier* me, uint8_t** ptr)
+{
+    uint8_t* out = *ptr;
+    size_t   len = strlen (me->suffix) + 1;
+    uint8_t  value;
+
+    memcpy (out, me->suffix, len);
+    out += len;
+
+    /* Encode cscIdx (-1-3) in the upper 4 bits,
+     *        scheme (0-2)  in the next 2 bits
+     *        caseInsen     in the bottom bit */
+    value = (uint8_t) ((((uint8_t) (me->cscIdx + 1)) & 15) << 4);
+    value |= (uint8_t) ((((uint8_t) me->scheme) & 3) << 2);
+    value |= (uint8_t) (((uint8_t) me->caseInsensitive) & 1);
+
+    *out++ = value;
+    *out++ = (uint8_t) me->type;
+    *ptr   = out;
+}
+
+static exr_result_t
+Classifier_read (Classifier* me, const uint8_t** ptr, uint64_t size)
+{
+    const uint8_t* in = *ptr;
+    uint64_t       maxlen, len;
+    uint8_t        value;
+    int            cscIdx, scheme;
+
+    if (size == 0) return EXR_ERR_CORRUPT_CHUNK;
+
+    /* maximum length of string plus one byte for terminating NULL */
+    maxlen = (size < 256) ? size : 256;
+    for (len = 0; len < maxlen; ++len)
+        if (in[len] == 0) break;
+    if (len == maxlen) return EXR_ERR_CORRUPT_CHUNK;
+
+    if (size < len + 1 + 2) return EXR_ERR_CORRUPT_CHUNK;
+
+    me->suffix = (const char*) in;
+    in += len + 1;
+
+    value  = *in++;
+    cscIdx = (int) (value >> 4) - 1;
+    if (cscIdx < -1 || cscIdx >= 3) return EXR_ERR_CORRUPT_CHUNK;
+
+    scheme = (value >> 2) & 3;
+    if (scheme >= NUM_COMPRESSOR_SCHEMES) return EXR_ERR_CORRUPT_CHUNK;
+
+    me->cscIdx          = cscIdx;
+    me->scheme          = scheme;
+    me->caseInsensitive = (value & 1) ? 1 : 0;
+
+    value = *in++;
+    if (value >= (uint8_t) EXR_PIXEL_LAST_TYPE) return EXR_ERR_CORRUPT_CHUNK;
+    me->type = (exr_pixel_type_t) value;
+
+    *ptr = in;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+typedef struct _ChannelData
+{
+    const exr_coding_channel_info_t* chan;
+
+    int compression;
+
+    int width;
+    int height;
+
+    /* row pointers into the packed (encode) or unpacked (decode) data */
+    uint8_t** rows;
+    uint8_t** rowsEnd;
+
+    /*
+     * Incoming and outgoing data is scanline interleaved, and it's
+     * much easier to operate on contiguous data.  Assuming the planar
+     * unc buffer is to hold RLE data, we need to rearrange to make
+     * bytes adjacent.
+     */
+    uint8_t* planarUncBuffer;
+    uint8_t* planarUncBufferEnd;
+
+    uint8_t* planarUncRle[4];
+    uint8_t* planarUncRleEnd[4];
+
+    uint64_t planarUncSize;
+} ChannelData;
+
+typedef struct _CscChannelSet
+{
+    int idx[3];
+} CscChannelSet;
+
+typedef struct _CscPrefixMapItem
+{
+    const char*   name;
+    size_t        prefix_len;
+    CscChannelSet set;
+} CscPrefixMapItem;
+
+/**************************************/
+
+typedef struct _DwaSimdFuncs
+{
+    void (*convertFloatToHalf64) (uint16_t*, const float*);
+    void (*fromHalfZigZag) (const uint16_t*, float*);
+    void (*dctInverse8x8) (float*, int);
+} DwaSimdFuncs;
+
+/*
+ * Pick the kernels to use at runtime, matching
+ * DwaCompressor::initializeFuncs
+ */
+static void
+initializeFuncs (DwaSimdFuncs* funcs)
+{
+    int f16c, avx, sse2, neon;
+
+    check_for_x86_simd (&f16c, &avx, &sse2);
+    neon = check_for_arm_neon ();
+
+    funcs->convertFloatToHalf64 = convertFloatToHalf64_scalar;
+    funcs->fromHalfZigZag       = fromHalfZigZag_scalar;
+
+    if (avx && f16c)
+    {
+        funcs->convertFloatToHalf64 = convertFloatToHalf64_f16c;
+        funcs->fromHalfZigZag       = fromHalfZigZag_f16c;
+    }
+    else if (neon)
+    {
+        funcs->convertFloatToHalf64 = convertFloatToHalf64_neon;
+        funcs->fromHalfZigZag       = fromHalfZigZag_neon;
+    }
+
+    funcs->dctInverse8x8 = dctInverse8x8_scalar;
+    if (avx)
+        funcs->dctInverse8x8 = dctInverse8x8_avx;
+    else if (sse2)
+        funcs->dctInverse8x8 = dctInverse8x8_sse2;
+    else if (neon)
+        funcs->dctInverse8x8 = dctInverse8x8_neon;
+}
+
+/**************************************/
+
+typedef struct _DwaCompressor
+{
+    exr_encode_pipeline_t* _encode;
+    exr_decode_pipeline_t* _decode;
+
+    int   _acCompression;
+    float _dwaCompressionLevel;
+
+    int               _numChannels;
+    ChannelData*      _channelData;
+    int               _numCscSets;
+    CscChannelSet*    _cscSets;
+    int               _numChannelRules;
+    const Classifier* _channelRules;
+    Classifier*       _parsedRules;
+    CscPrefixMapItem* _prefixMap;
+    uint8_t**         _rowPtrs;
+
+    int      _min[2];
+    int      _max[2];
+    int      _numScanLines;
+
+    uint8_t* _packedAcBuffer;
+    uint64_t _packedAcBufferSize;
+    uint8_t* _packedDcBuffer;
+    uint64_t _packedDcBufferSize;
+    uint8_t* _rleBuffer;
+    uint64_t _rleBufferSize;
+    uint8_t* _zipScratch;
+    uint64_t _zipScratchSize;
+    uint8_t* _planarUncBuffer[NUM_COMPRESSOR_SCHEMES];
+    uint64_t _planarUncBufferSize[NUM_COMPRESSOR_SCHEMES];
+
+    /* aligned working blocks for the lossy dct */
+    float*    _dctData;
+    uint16_t* _halfZigData;
+    uint16_t* _rowBlock;
+    uint16_t* _tmpHalfBuffer;
+    uint64_t  _tmpHalfBufferSize;
+
+    void*    _hufSpare;
+    uint64_t _hufSpareSize;
+
+    DwaSimdFuncs _funcs;
+} DwaCompressor;
+
+/**************************************/
+
+static inline uint64_t
+align_size (uint64_t sz)
+{
+    return (sz + (uint64_t) _SSE_ALIGNMENT - 1) &
+           ~((uint64_t) _SSE_ALIGNMENT - 1);
+}
+
+static inline uint8_t*
+carve_buffer (uint8_t** cur, uint64_t bytes)
+{
+    uint8_t* ret = *cur;
+    *cur += align_size (bytes);
+    return ret;
+}
+
+static inline uint8_t*
+align_ptr (void* p)
+{
+    return (uint8_t*) (((uintptr_t) p + (uintptr_t) (_SSE_ALIGNMENT - 1)) &
+                       ~((uintptr_t) (_SSE_ALIGNMENT - 1)));
+}
+
+static inline int
+num_blocks (int n)
+{
+    return (n + 7) / 8;
+}
+
+/**************************************/
+
+/*
+ * Take our initial list of channels, and cache the contents.
+ *
+ * Determine appropriate compression schemes for each channel,
+ * and figure out which sets should potentially be CSC'ed
+ * prior to lossy compression.
+ */
+
+static void
+DwaCompressor_classifyChannels (DwaCompressor* me)
+{
+    int numPrefix = 0;
+
+    me->_numCscSets = 0;
+
+    for (int c = 0; c < me->_numChannels; ++c)
+    {
+        ChannelData*      cd      = me->_channelData + c;
+        const char*       name    = cd->chan->channel_name;
+        const char*       lastDot = strrchr (name, '.');
+        const char*       suffix  = name;
+        size_t            plen    = 0;
+        CscPrefixMapItem* theSet  = NULL;
+
+        if (lastDot)
+        {
+            plen   = (size_t) (lastDot - name);
+            suffix = lastDot + 1;
+        }
+
+        /*
+         * Make sure we have an entry in our CSC set map
+         */
+        for (int p = 0; p < numPrefix; ++p)
+        {
+            CscPrefixMapItem* cur = me->_prefixMap + p;
+            if (cur->prefix_len == plen &&
+                (plen == 0 || 0 == memcmp (cur->name, name, plen)))
+            {
+                theSet = cur;
+                break;
+            }
+        }
+        if (!theSet)
+        {
+            theSet             = me->_prefixMap + numPrefix++;
+            theSet->name       = name;
+            theSet->prefix_len = plen;
+            theSet->set.idx[0] = -1;
+            theSet->set.idx[1] = -1;
+            theSet->set.idx[2] = -1;
+        }
+
+        /*
+         * Check the suffix against the list of classifications
+         * we defined previously. If the cscIdx is not negative,
+         * it indicates that we should be part of a CSC group.
+         */
+        cd->compression = UNKNOWN;
+        for (int r = 0; r < me->_numChannelRules; ++r)
+        {
+            const Classifier* rule = me->_channelRules + r;
+
+            if (Classifier_match (
+                    rule, suffix, (exr_pixel_type_t) cd->chan->data_type))
+            {
+                cd->compression = rule->scheme;
+
+                if (rule->cscIdx >= 0) theSet->set.idx[rule->cscIdx] = c;
+            }
+        }
+    }
+
+    /*
+     * Sort the prefixes the same way a std::map<std::string> would,
+     * so CSC sets are processed in the same order as the C++ library
+     */
+    for (int p = 1; p < numPrefix; ++p)
+    {
+        CscPrefixMapItem tmp = me->_prefixMap[p];
+        int              q   = p - 1;
+
+        while (q >= 0)
+        {
+            const CscPrefixMapItem* cur = me->_prefixMap + q;
+            size_t minlen = cur->prefix_len < tmp.prefix_len ? cur->prefix_len
+                                                             : tmp.prefix_len;
+            int    cmp = minlen > 0 ? memcmp (cur->name, tmp.name, minlen) : 0;
+
+            if (cmp < 0 || (cmp == 0 && cur->prefix_len <= tmp.prefix_len))
+                break;
+            me->_prefixMap[q + 1] = me->_prefixMap[q];
+            --q;
+        }
+        me->_prefixMap[q + 1] = tmp;
+    }
+
+    /*
+     * Finally, try and find RGB sets of channels which
+     * can be CSC'ed to a Y'CbCr space prior to loss, for
+     * better compression.
+     *
+     * Walk over our set of candidates, and see who has
+     * all three channels defined (and has common sampling
+     * patterns, etc).
+     */
+    for (int p = 0; p < numPrefix; ++p)
+    {
+        const CscChannelSet*             s = &(me->_prefixMap[p].set);
+        const exr_coding_channel_info_t *red, *grn, *blu;
+
+        if (s->idx[0] < 0 || s->idx[1] < 0 || s->idx[2] < 0) continue;
+
+        red = me->_channelData[s->idx[0]].chan;
+        grn = me->_channelData[s->idx[1]].chan;
+        blu = me->_channelData[s->idx[2]].chan;
+
+        if (red->x_samples != grn->x_samples ||
+            red->x_samples != blu->x_samples ||
+            grn->x_samples != blu->x_samples ||
+            red->y_samples != grn->y_samples ||
+            red->y_samples != blu->y_samples ||
+            grn->y_samples != blu->y_samples)
+        {
+            continue;
+        }
+
+        me->_cscSets[me->_numCscSets++] = *s;
+    }
+}
+
+/**************************************/
+
+/*
+ * Given a set of rules and ChannelData, figure out which rules apply
+ */
+
+static int
+DwaCompressor_relevantChannelRules (DwaCompressor* me, Classifier* rules)
+{
+    int count = 0;
+
+    for (int r = 0; r < me->_numChannelRules; ++r)
+    {
+        for (int c = 0; c < me->_numChannels; ++c)
+        {
+            const exr_coding_channel_info_t* chan = me->_channelData[c].chan;
+            const char* suffix  = chan->channel_name;
+            const char* lastDot = strrchr (suffix, '.');
+
+            if (lastDot) suffix = lastDot + 1;
+
+            if (Classifier_match (
+                    me->_channelRules + r,
+                    suffix,
+                    (exr_pixel_type_t) chan->data_type))
+            {
+                rules[count++] = me->_channelRules[r];
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+/**************************************/
+
+/*
+ * Compute the size of, and setup the pointers into, the per-chunk
+ * metadata: channel data, csc sets, and the row pointers. This is
+ * placed in scratch buffer 2.
+ */
+
+static exr_result_t
+DwaCompressor_initializeChannels (DwaCompressor* me, uint64_t numParsedRules)
+{
+    exr_result_t                     rv;
+    const exr_coding_channel_info_t* chans;
+    const exr_chunk_info_t*          cinfo;
+    uint64_t                         totalRows = 0;
+    uint64_t                         metasz;
+    uint8_t*                         cur;
+    void**                           buf;
+    size_t*                          bufsz;
+
+    if (me->_encode)
+    {
+        chans            = me->_encode->channels;
+        cinfo            = &(me->_encode->chunk);
+        me->_numChannels = me->_encode->channel_count;
+        buf              = &(me->_encode->scratch_buffer_2);
+        bufsz            = &(me->_encode->scratch_alloc_size_2);
+    }
+    else
+    {
+        chans            = me->_decode->channels;
+        cinfo            = &(me->_decode->chunk);
+        me->_numChannels = me->_decode->channel_count;
+        buf              = &(me->_decode->scratch_buffer_2);
+        bufsz            = &(me->_decode->scratch_alloc_size_2);
+    }
+
+    me->_min[0]       = cinfo->start_x;
+    me->_min[1]       = cinfo->start_y;
+    me->_max[0]       = cinfo->start_x + cinfo->width - 1;
+    me->_max[1]       = cinfo->start_y + cinfo->height - 1;
+    me->_numScanLines = cinfo->height;
+
+    for (int c = 0; c < me->_numChannels; ++c)
+    {
+        int ys = chans[c].y_samples;
+        for (int y = me->_min[1]; y <= me->_max[1]; ++y)
+        {
+            if (ys > 1 && (y % ys) != 0) continue;
+            ++totalRows;
+        }
+    }
+
+    metasz = align_size (sizeof (ChannelData) * (uint64_t) me->_numChannels);
+    metasz += align_size (sizeof (CscChannelSet) * (uint64_t) me->_numChannels);
+    metasz +=
+        align_size (sizeof (CscPrefixMapItem) * (uint64_t) me->_numChannels);
+    metasz += align_size (sizeof (Classifier) * (numParsedRules + 1));
+    metasz += align_size (sizeof (uint8_t*) * (totalRows + 1));
+    metasz += _SSE_ALIGNMENT;
+
+    if (me->_encode)
+        rv = internal_encode_alloc_buffer (
+            me->_encode, EXR_TRANSCODE_BUFFER_SCRATCH2, buf, bufsz, metasz);
+    else
+        rv = internal_decode_alloc_buffer (
+            me->_decode, EXR_TRANSCODE_BUFFER_SCRATCH2, buf, bufsz, metasz);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    cur              = align_ptr (*buf);
+    me->_channelData = (ChannelData*) carve_buffer (
+        &cur, sizeof (ChannelData) * (uint64_t) me->_numChannels);
+    me->_cscSets = (CscChannelSet*) carve_buffer (
+        &cur, sizeof (CscChannelSet) * (uint64_t) me->_numChannels);
+    me->_prefixMap = (CscPrefixMapItem*) carve_buffer (
+        &cur, sizeof (CscPrefixMapItem) * (uint64_t) me->_numChannels);
+    me->_parsedRules = (Classifier*) carve_buffer (
+        &cur, sizeof (Classifier) * (numParsedRules + 1));
+    me->_rowPtrs =
+        (uint8_t**) carve_buffer (&cur, sizeof (uint8_t*) * (totalRows + 1));
+
+    for (int c = 0; c < me->_numChannels; ++c)
+    {
+        ChannelData* cd = me->_channelData + c;
+
+        memset (cd, 0, sizeof (ChannelData));
+        cd->chan  = chans + c;
+        cd->width = chans[c].width;
+    }
+
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+/*
+ * Handle buffer allocation once we know how to classify channels.
+ * All the working buffers are carved out of scratch buffer 1.
+ */
+
+static exr_result_t
+DwaCompressor_initializeBuffers (DwaCompressor* me, uint64_t* outBufferSize)
+{
+    exr_result_t rv;
+    uint64_t     maxOutBufferSize  = 0;
+    uint64_t     numLossyDctChans  = 0;
+    uint64_t     unknownBufferSize = 0;
+    uint64_t     rleBufferSize     = 0;
+    uint64_t     maxBlocksX        = 0;
+    uint64_t     packedAcSize      = 0;
+    uint64_t     packedDcSize      = 0;
+    uint64_t     tmpHalfSize       = 0;
+    uint64_t     scratchsz;
+    uint8_t*     cur;
+    void**       buf;
+    size_t*      bufsz;
+    uint8_t**    rowp = me->_rowPtrs;
+
+    DwaCompressor_classifyChannels (me);
+
+    for (int c = 0; c < me->_numChannels; ++c)
+    {
+        ChannelData* cd  = me->_channelData + c;
+        int          ys  = cd->chan->y_samples;
+        uint64_t     bpe = (uint64_t) cd->chan->bytes_per_element;
+        uint64_t     pixelCount;
+
+        cd->height = 0;
+        cd->rows   = rowp;
+        for (int y = me->_min[1]; y <= me->_max[1]; ++y)
+        {
+            if (ys > 1 && (y % ys) != 0) continue;
+            ++cd->height;
+        }
+        rowp += cd->height;
+
+        pixelCount = (uint64_t) cd->width * (uint64_t) cd->height;
+
+        cd->planarUncSize = pixelCount * bpe;
+
+        switch (cd->compression)
+        {
+            case LOSSY_DCT: {
+                uint64_t nblocks = (uint64_t) num_blocks (cd->width) *
+                                   (uint64_t) num_blocks (cd->height);
+                uint64_t maxAc = nblocks * 63 * sizeof (uint16_t);
+                uint64_t bound = (uint64_t) compressBound ((uLong) maxAc);
+
+                /*
+                 * This is the size of the number of packed
+                 * components, plus the requirements for
+                 * maximum Huffman encoding size (for STATIC_HUFFMAN)
+                 * or for zlib compression (for DEFLATE)
+                 */
+                maxOutBufferSize +=
+                    (2 * maxAc + 65536) > bound ? (2 * maxAc + 65536) : bound;
+                packedAcSize += maxAc;
+                packedDcSize += nblocks * sizeof (uint16_t);
+                ++numLossyDctChans;
+
+                if ((uint64_t) num_blocks (cd->width) > maxBlocksX)
+                    maxBlocksX = (uint64_t) num_blocks (cd->width);
+
+                if (cd->chan->data_type == EXR_PIXEL_FLOAT)
+                    tmpHalfSize += pixelCount;
+                break;
+            }
+            case RLE:
+                /*
+                 * RLE, if gone horribly wrong, could double the size
+                 * of the source data.
+                 */
+                rleBufferSize += 2 * pixelCount * bpe;
+                me->_planarUncBufferSize[RLE] += pixelCount * bpe;
+                break;
+
+            case UNKNOWN:
+                unknownBufferSize += pixelCount * bpe;
+                me->_planarUncBufferSize[UNKNOWN] += pixelCount * bpe;
+                break;
+
+            default: return EXR_ERR_INVALID_ARGUMENT;
+        }
+    }
+
+    /*
+     * Also, since the results of the RLE are packed into
+     * the output buffer, we need the extra room there. But
+     * we're going to zlib compress() the data we pack,
+     * which could take slightly more space. And the same
+     * goes for the UNKNOWN data, and the DC data.
+     */
+    maxOutBufferSize += (uint64_t) compressBound ((uLong) rleBufferSize);
+    maxOutBufferSize += (uint64_t) compressBound ((uLong) unknownBufferSize);
+    maxOutBufferSize += (uint64_t) compressBound ((uLong) packedDcSize);
+    maxOutBufferSize += DWA_HEADER_BYTES;
+
+    *outBufferSize = maxOutBufferSize;
+
+    me->_packedAcBufferSize = packedAcSize;
+    me->_packedDcBufferSize = packedDcSize;
+    me->_rleBufferSize      = rleBufferSize;
+    me->_zipScratchSize     = packedDcSize;
+    me->_tmpHalfBufferSize  = tmpHalfSize;
+
+    me->_hufSpareSize = 0;
+    if (numLossyDctChans > 0 && me->_acCompression == STATIC_HUFFMAN)
+    {
+        me->_hufSpareSize = me->_encode
+                                ? internal_exr_huf_compress_spare_bytes ()
+                                : internal_exr_huf_decompress_spare_bytes ();
+    }
+
+    scratchsz = _SSE_ALIGNMENT;
+    scratchsz += align_size (packedAcSize);
+    scratchsz += align_size (packedDcSize);
+    scratchsz += align_size (rleBufferSize);
+    scratchsz += align_size (packedDcSize);
+    for (int i = 0; i < NUM_COMPRESSOR_SCHEMES; ++i)
+        scratchsz += align_size (me->_planarUncBufferSize[i]);
+    scratchsz += align_size (3 * 64 * sizeof (float));
+    scratchsz += align_size (3 * 64 * sizeof (uint16_t));
+    scratchsz += align_size (3 * maxBlocksX * 64 * sizeof (uint16_t));
+    scratchsz += align_size (tmpHalfSize * sizeof (uint16_t));
+    scratchsz += align_size (me->_hufSpareSize);
+
+    if (me->_encode)
+    {
+        buf   = &(me->_encode->scratch_buffer_1);
+        bufsz = &(me->_encode->scratch_alloc_size_1);
+        rv    = internal_encode_alloc_buffer (
+            me->_encode, EXR_TRANSCODE_BUFFER_SCRATCH1, buf, bufsz, scratchsz);
+    }
+    else
+    {
+        buf   = &(me->_decode->scratch_buffer_1);
+        bufsz = &(me->_decode->scratch_alloc_size_1);
+        rv    = internal_decode_alloc_buffer (
+            me->_decode, EXR_TRANSCODE_BUFFER_SCRATCH1, buf, bufsz, scratchsz);
+    }
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    cur                 = align_ptr (*buf);
+    me->_packedAcBuffer = carve_buffer (&cur, packedAcSize);
+    me->_packedDcBuffer = carve_buffer (&cur, packedDcSize);
+    me->_rleBuffer      = carve_buffer (&cur, rleBufferSize);
+    me->_zipScratch     = carve_buffer (&cur, packedDcSize);
+    for (int i = 0; i < NUM_COMPRESSOR_SCHEMES; ++i)
+        me->_planarUncBuffer[i] =
+            carve_buffer (&cur, me->_planarUncBufferSize[i]);
+    me->_dctData = (float*) carve_buffer (&cur, 3 * 64 * sizeof (float));
+    me->_halfZigData =
+        (uint16_t*) carve_buffer (&cur, 3 * 64 * sizeof (uint16_t));
+    me->_rowBlock = (uint16_t*) carve_buffer (
+        &cur, 3 * maxBlocksX * 64 * sizeof (uint16_t));
+    me->_tmpHalfBuffer =
+        (uint16_t*) carve_buffer (&cur, tmpHalfSize * sizeof (uint16_t));
+    me->_hufSpare = carve_buffer (&cur, me->_hufSpareSize);
+
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+/*
+ * Setup some buffer pointers, determine channel sizes, things
+ * like that.
+ */
+
+static void
+DwaCompressor_setupChannelData (DwaCompressor* me)
+{
+    uint8_t* planarUncBuffer[NUM_COMPRESSOR_SCHEMES];
+
+    for (int i = 0; i < NUM_COMPRESSOR_SCHEMES; ++i)
+        planarUncBuffer[i] = me->_planarUncBuffer[i];
+
+    for (int c = 0; c < me->_numChannels; ++c)
+    {
+        ChannelData* cd  = me->_channelData + c;
+        uint64_t     pix = (uint64_t) cd->width * (uint64_t) cd->height;
+
+        cd->planarUncBuffer    = planarUncBuffer[cd->compression];
+        cd->planarUncBufferEnd = cd->planarUncBuffer;
+
+        cd->planarUncRle[0]    = cd->planarUncBuffer;
+        cd->planarUncRleEnd[0] = cd->planarUncRle[0];
+
+        for (int byte = 1; byte < cd->chan->bytes_per_element; ++byte)
+        {
+            cd->planarUncRle[byte]    = cd->planarUncRle[byte - 1] + pix;
+            cd->planarUncRleEnd[byte] = cd->planarUncRle[byte];
+        }
+
+        if (cd->compression != LOSSY_DCT)
+            planarUncBuffer[cd->compression] += cd->planarUncSize;
+    }
+}
+
+/**************************************/
+
+/*
+ * Determine the start of each row in the (packed or unpacked)
+ * buffer. Channels are interleaved by scanline.
+ */
+
+static exr_result_t
+DwaCompressor_setupRowPtrs (DwaCompressor* me, uint8_t* base, uint64_t sz)
+{
+    uint8_t* dataPtr = base;
+    uint64_t total   = 0;
+
+    for (int c = 0; c < me->_numChannels; ++c)
+    {
+        ChannelData* cd = me->_channelData + c;
+        total += cd->planarUncSize;
+    }
+    if (total > sz) return EXR_ERR_CORRUPT_CHUNK;
+
+    for (int c = 0; c < me->_numChannels; ++c)
+        me->_channelData[c].rowsEnd = me->_channelData[c].rows;
+
+    for (int y = me->_min[1]; y <= me->_max[1]; ++y)
+    {
+        for (int c = 0; c < me->_numChannels; ++c)
+        {
+            ChannelData* cd = me->_channelData + c;
+            int          ys = cd->chan->y_samples;
+
+            if (ys > 1 && (y % ys) != 0) continue;
+
+            *(cd->rowsEnd)++ = dataPtr;
+            dataPtr +=
+                (uint64_t) cd->width * (uint64_t) cd->chan->bytes_per_element;
+        }
+    }
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+/*
+ * Lossy DCT encoding / decoding of either one channel, or three
+ * channels which are color space converted as a group.
+ */
+
+typedef struct _LossyDctChannel
+{
+    uint8_t**        rows;
+    exr_pixel_type_t type;
+    uint16_t*        dcComp;
+    float*           dctData;
+    uint16_t*        halfZigBlock;
+    uint16_t*        rowBlock;
+} LossyDctChannel;
+
+static void
+DwaCompressor_setupLossyDct (
+    DwaCompressor* me, LossyDctChannel* ldc, const int* chanIdx, int numComp)
+{
+    int numBlocksX = num_blocks (me->_channelData[chanIdx[0]].width);
+
+    for (int comp = 0; comp < numComp; ++comp)
+    {
+        const ChannelData* cd = me->_channelData + chanIdx[comp];
+
+        ldc[comp].rows         = cd->rows;
+        ldc[comp].type         = (exr_pixel_type_t) cd->chan->data_type;
+        ldc[comp].dcComp       = NULL;
+        ldc[comp].dctData      = me->_dctData + comp * 64;
+        ldc[comp].halfZigBlock = me->_halfZigData + comp * 64;
+        ldc[comp].rowBlock = me->_rowBlock + (size_t) comp * numBlocksX * 64;
+    }
+}
+
+/**************************************/
+
+/*
+ * Reorder from zig-zag order to normal ordering
+ */
+
+static void
+toZigZag (uint16_t* dst, const uint16_t* src)
+{
+    static const int remap[] = {
+        0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+        12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+    };
+
+    for (int i = 0; i < 64; ++i)
+        dst[i] = src[remap[i]];
+}
+
+/*
+ * Precomputing the bit count runs faster than using
+ * the builtin instruction, at least in one case..
+ *
+ * Precomputing 8-bits is no slower than 16-bits,
+ * and saves a fair bit of overhead..
+ */
+
+static int
+countSetBits (uint16_t src)
+{
+    static const uint16_t numBitsSet[256] = {
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, 2, 3,
+        3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4,
+        3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 1, 2,
+        2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5,
+        3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5,
+        5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 1, 2, 2, 3,
+        2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4,
+        4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
+        3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 2, 3, 3, 4, 3, 4,
+        4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6,
+        5, 6, 6, 7, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 4, 5,
+        5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8
+    };
+
+    return numBitsSet[src & 0xff] + numBitsSet[src >> 8];
+}
+
+/*
+ * Take a DCT coefficient, as well as an acceptable error. Search
+ * nearby values within the error tolerance, that have fewer
+ * bits set.
+ *
+ * The list of candidates has been pre-computed and sorted
+ * in order of increasing numbers of bits set. This way, we
+ * can stop searching as soon as we find a candidate that
+ * is within the error tolerance.
+ */
+
+static uint16_t
+quantize (uint16_t src, float errorTolerance)
+{
+    float           srcFloat   = half_to_float (src);
+    int             numSetBits = countSetBits (src);
+    const uint16_t* closest    = closestData + closestDataOffset[src];
+
+    for (int targetNumSetBits = numSetBits - 1; targetNumSetBits >= 0;
+         --targetNumSetBits)
+    {
+        uint16_t tmp = *closest;
+
+        if (fabsf (half_to_float (tmp) - srcFloat) < errorTolerance)
+            return tmp;
+
+        closest++;
+    }
+
+    return src;
+}
+
+/*
+ * RLE the zig-zag of the AC components + copy over
+ * into another tmp buffer
+ *
+ * Try to do a simple RLE scheme to reduce run's of 0's. This
+ * differs from the jpeg EOB case, since EOB just indicates that
+ * the rest of the block is zero. In our case, we have lots of
+ * NaN symbols, which shouldn't be allowed to occur in DCT
+ * coefficents - so we'll use them for encoding runs.
+ *
+ * If the high byte is 0xff, then we have a run of 0's, of length
+ * given by the low byte. For example, 0xff03 would be a run
+ * of 3 0's, starting at the current location.
+ *
+ * block is our block of 64 coefficients
+ * acPtr a pointer to back the RLE'd values into.
+ *
+ * Returns the number of values written
+ */
+
+static uint64_t
+rleAc (const uint16_t* block, uint16_t** acPtr)
+{
+    int       dctComp   = 1;
+    uint16_t  rleSymbol = 0x0;
+    uint16_t* out       = *acPtr;
+
+    while (dctComp < 64)
+    {
+        int runLen = 1;
+
+        /*
+         * If we don't have a 0, output verbatim
+         */
+        if (block[dctComp] != rleSymbol)
+        {
+            *out++ = block[dctComp];
+            dctComp += runLen;
+            continue;
+        }
+
+        /*
+         * We're sitting on a 0, so see how big the run is.
+         */
+        while ((dctComp + runLen < 64) &&
+               (block[dctComp + runLen] == rleSymbol))
+        {
+            runLen++;
+        }
+
+        /*
+         * If the run len is too small, just output verbatim
+         * otherwise output our run token
+         *
+         * Using 0xff00 for "end of block"
+         */
+        if (runLen == 1) { *out++ = block[dctComp]; }
+        else if (runLen + dctComp == 64)
+        {
+            /* Signal EOB */
+            *out++ = 0xff00;
+        }
+        else
+        {
+            /* Signal normal run */
+            *out++ = (uint16_t) (0xff00 | runLen);
+        }
+
+        /*
+         * Advance by runLen
+         */
+        dctComp += runLen;
+    }
+
+    {
+        uint64_t count = (uint64_t) (out - *acPtr);
+        *acPtr         = out;
+        return count;
+    }
+}
+
+/**************************************/
+
+/*
+ * Given three channels of source data, encoding by first applying
+ * a color space conversion to a YCbCr space.  Otherwise, if we only
+ * have one channel, just encode it as is.
+ */
+
+static exr_result_t
+LossyDctEncoder_execute (
+    DwaCompressor*   me,
+    LossyDctChannel* chans,
+    int              numComp,
+    const uint16_t*  toNonlinear,
+    int              width,
+    int              height,
+    uint16_t**       packedAc,
+    uint16_t**       packedDc,
+    uint64_t*        numAcComp,
+    uint64_t*        numDcComp)
+{
+    static const int jpegQuantTableY[] = {
+        16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,
+        58, 60, 55, 14, 13,  16,  24,  40,  57, 69, 56, 14, 17,
+        22, 29, 51, 87, 80,  62,  18,  22,  37, 56, 68, 109, 103,
+        77, 24, 35, 55, 64,  81,  104, 113, 92, 49, 64, 78,  87,
+        103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99
+    };
+    static const int jpegQuantTableYMin = 10;
+
+    static const int jpegQuantTableCbCr[] = {
+        17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+        24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99
+    };
+    static const int jpegQuantTableCbCrMin = 17;
+
+    float     quantBaseError = me->_dwaCompressionLevel / 100000.f;
+    float     quantTableY[64];
+    float     quantTableCbCr[64];
+    uint16_t  halfZigCoef[64];
+    uint16_t  halfCoef[64];
+    int       numBlocksX = num_blocks (width);
+    int       numBlocksY = num_blocks (height);
+    uint16_t* currAcComp = *packedAc;
+    uint16_t* tmpHalfBufferPtr;
+    uint64_t  numAc = 0, numDc = 0;
+
+    /*
+     * Here, we take the generic JPEG quantization tables and
+     * normalize them by the smallest component in each table.
+     * This gives us a relationship amongst the DCT components,
+     * in terms of how sensitive each component is to
+     * error.
+     *
+     * A higher normalized value means we can quantize more,
+     * and a small normalized value means we can quantize less.
+     *
+     * Eventually, we will want an acceptable quantization
+     * error range for each component. We find this by
+     * multiplying some user-specified level (quantBaseError)
+     * by the normalized table (quantTableY, quantTableCbCr) to
+     * find the acceptable quantization error range.
+     */
+    for (int idx = 0; idx < 64; ++idx)
+    {
+        quantTableY[idx] =
+            (float) (jpegQuantTableY[idx]) / (float) (jpegQuantTableYMin);
+
+        quantTableCbCr[idx] =
+            (float) (jpegQuantTableCbCr[idx]) / (float) (jpegQuantTableCbCrMin);
+    }
+
+    if (numComp != 1 && numComp != 3) return EXR_ERR_INVALID_ARGUMENT;
+
+    /*
+     * Run over all the float scanlines, quantizing,
+     * and re-assigning the row pointers. We need to translate
+     * FLOAT XDR to HALF XDR.
+     */
+    tmpHalfBufferPtr = me->_tmpHalfBuffer;
+    for (int comp = 0; comp < numComp; ++comp)
+    {
+        if (chans[comp].type != EXR_PIXEL_FLOAT) continue;
+
+        for (int y = 0; y < height; ++y)
+        {
+            const uint8_t* srcXdr = chans[comp].rows[y];
+
+            for (int x = 0; x < width; ++x)
+            {
+                union
+                {
+                    uint32_t i;
+                    float    f;
+                } v;
+                float src;
+
+                v.i = one_to_native32 (unaligned_load32 (srcXdr + x * 4));
+
+                /*
+                 * Clamp to half ranges, instead of just casting. This
+                 * avoids introducing Infs which end up getting zeroed later
+                 */
+                src = (v.f < DWA_HALF_MAX) ? v.f : DWA_HALF_MAX;
+                src = (src < -DWA_HALF_MAX) ? -DWA_HALF_MAX : src;
+
+                tmpHalfBufferPtr[x] = one_from_native16 (float_to_half (src));
+            }
+
+            chans[comp].rows[y] = (uint8_t*) tmpHalfBufferPtr;
+            tmpHalfBufferPtr += width;
+        }
+    }
+
+    /*
+     * Pack DC components together by common plane, so we can get
+     * a little more out of differencing them. We'll always have
+     * one component per block, so we can computed offsets.
+     */
+    chans[0].dcComp = *packedDc;
+    for (int comp = 1; comp < numComp; ++comp)
+        chans[comp].dcComp = chans[comp - 1].dcComp + numBlocksX * numBlocksY;
+
+    for (int blocky = 0; blocky < numBlocksY; ++blocky)
+    {
+        for (int blockx = 0; blockx < numBlocksX; ++blockx)
+        {
+            for (int comp = 0; comp < numComp; ++comp)
+            {
+                float* dctData = chans[comp].dctData;
+
+                /*
+                 * Break the source into 8x8 blocks. If we don't
+                 * fit at the edges, mirror.
+                 *
+                 * Also, convert from linear to nonlinear representation.
+                 * Our source is assumed to be XDR, and we need to convert
+                 * to NATIVE prior to converting to float.
+                 */
+                for (int y = 0; y < 8; ++y)
+                {
+                    for (int x = 0; x < 8; ++x)
+                    {
+                        int      vx = 8 * blockx + x;
+                        int      vy = 8 * blocky + y;
+                        uint16_t h;
+
+                        if (vx >= width) vx = width - (vx - (width - 1));
+
+                        if (vx < 0) vx = width - 1;
+
+                        if (vy >= height) vy = height - (vy - (height - 1));
+
+                        if (vy < 0) vy = height - 1;
+
+                        h = one_to_native16 (
+                            ((const uint16_t*) (chans[comp].rows[vy]))[vx]);
+
+                        if (toNonlinear) h = toNonlinear[h];
+
+                        dctData[y * 8 + x] = half_to_float (h);
+                    }
+                }
+            }
+
+            /*
+             * Color space conversion
+             */
+            if (numComp == 3)
+            {
+                csc709Forward64 (
+                    chans[0].dctData, chans[1].dctData, chans[2].dctData);
+            }
+
+            for (int comp = 0; comp < numComp; ++comp)
+            {
+                float*       dctData = chans[comp].dctData;
+                const float* qtable  = (comp == 0) ? quantTableY
+                                                   : quantTableCbCr;
+
+                /*
+                 * Forward DCT
+                 */
+                dctForward8x8 (dctData);
+
+                /*
+                 * Quantize to half, and zigzag
+                 */
+                for (int i = 0; i < 64; ++i)
+                {
+                    halfCoef[i] = quantize (
+                        float_to_half (dctData[i]), quantBaseError * qtable[i]);
+                }
+
+                toZigZag (halfZigCoef, halfCoef);
+
+                /*
+                 * Convert from NATIVE back to XDR, before we write out
+                 */
+                for (int i = 0; i < 64; ++i)
+                    halfZigCoef[i] = one_from_native16 (halfZigCoef[i]);
+
+                /*
+                 * Save the DC component separately, to be compressed on
+                 * its own.
+                 */
+                *(chans[comp].dcComp)++ = halfZigCoef[0];
+                ++numDc;
+
+                /*
+                 * Then RLE the AC components (which will record the count
+                 * of the resulting number of items)
+                 */
+                numAc += rleAc (halfZigCoef, &currAcComp);
+            }
+        }
+    }
+
+    *packedAc = currAcComp;
+    *packedDc += numDc;
+    *numAcComp += numAc;
+    *numDcComp += numDc;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+/*
+ * Un-RLE the packed AC components into
+ * a half buffer. The half block should
+ * be the full 8x8 block (in zig-zag order
+ * still), not the first AC component.
+ *
+ * currAcComp is advanced as bytes are decoded.
+ *
+ * This returns the index of the last non-zero
+ * value in the buffer - with the index into zig zag
+ * order data. If we return 0, we have DC only data.
+ *
+ * This is assuminging that halfZigBlock is zero'ed
+ * prior to calling
+ */
+
+static exr_result_t
+LossyDctDecoder_unRleAc (
+    int*             lastNonZero,
+    const uint16_t** currAcComp,
+    const uint16_t*  packedAcEnd,
+    uint16_t*        halfZigBlock)
+{
+    const uint16_t* acComp  = *currAcComp;
+    int             dctComp = 1;
+    int             lnz     = 0;
+
+    /*
+     * Un-RLE the RLE'd blocks. If we find an item whose
+     * high byte is 0xff, then insert the number of 0's
+     * as indicated by the low byte.
+     *
+     * Otherwise, just copy the number verbaitm.
+     */
+    while (dctComp < 64)
+    {
+        uint16_t val;
+
+        if (acComp >= packedAcEnd) return EXR_ERR_CORRUPT_CHUNK;
+
+        val = *acComp++;
+        if (val == 0xff00)
+        {
+            /* End of block */
+            dctComp = 64;
+        }
+        else if ((val >> 8) == 0xff)
+        {
+            /*
+             * Run detected! Insert 0's.
+             *
+             * Since the block has been zeroed, just advance the ptr
+             */
+            dctComp += val & 0xff;
+        }
+        else
+        {
+            /* Not a run, just copy over the value */
+            lnz                   = dctComp;
+            halfZigBlock[dctComp] = val;
+            dctComp++;
+        }
+    }
+
+    *lastNonZero = lnz;
+    *currAcComp  = acComp;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+static exr_result_t
+LossyDctDecoder_execute (
+    DwaCompressor*   me,
+    LossyDctChannel* chans,
+    int              numComp,
+    const uint16_t*  toLinear,
+    int              width,
+    int              height,
+    const uint16_t** packedAc,
+    const uint16_t*  packedAcEnd,
+    const uint16_t** packedDc,
+    const uint16_t*  packedDcEnd)
+{
+    exr_result_t    rv;
+    int             lastNonZero    = 0;
+    int             numBlocksX     = num_blocks (width);
+    int             numBlocksY     = num_blocks (height);
+    int             leftoverX      = width - (numBlocksX - 1) * 8;
+    int             leftoverY      = height - (numBlocksY - 1) * 8;
+    int             numFullBlocksX = width / 8;
+    const uint16_t* currAcComp     = *packedAc;
+    const uint16_t* dcComp[3];
+    uint64_t        numDc = 0;
+
+    if (numComp != 1 && numComp != 3) return EXR_ERR_INVALID_ARGUMENT;
+
+    if (!toLinear) toLinear = dwaCompressorNoOp;
+
+    /*
+     * Pack DC components together by common plane, so we can get
+     * a little more out of differencing them. We'll always have
+     * one component per block, so we can computed offsets.
+     */
+    dcComp[0] = *packedDc;
+    for (int comp = 1; comp < numComp; ++comp)
+        dcComp[comp] = dcComp[comp - 1] + numBlocksX * numBlocksY;
+
+    if (numBlocksX > 0 && numBlocksY > 0 &&
+        (dcComp[numComp - 1] + numBlocksX * numBlocksY) > packedDcEnd)
+        return EXR_ERR_CORRUPT_CHUNK;
+
+    for (int blocky = 0; blocky < numBlocksY; ++blocky)
+    {
+        int maxY = 8;
+        int maxX = 8;
+
+        if (blocky == numBlocksY - 1) maxY = leftoverY;
+
+        for (int blockx = 0; blockx < numBlocksX; ++blockx)
+        {
+            /*
+             * If we can detect that the block is constant values
+             * (all components only have DC values, and all AC is 0),
+             * we can do everything only on 1 value, instead of all
+             * 64.
+             *
+             * This won't really help for regular images, but it is
+             * meant more for layers with large swaths of black
+             */
+            int blockIsConstant = 1;
+
+            if (blockx == numBlocksX - 1) maxX = leftoverX;
+
+            for (int comp = 0; comp < numComp; ++comp)
+            {
+                uint16_t* halfZigBlock = chans[comp].halfZigBlock;
+                float*    dctData      = chans[comp].dctData;
+
+                /*
+                 * DC component is stored separately
+                 */
+                memset (halfZigBlock, 0, 64 * sizeof (uint16_t));
+                halfZigBlock[0] = *(dcComp[comp])++;
+                ++numDc;
+
+                /*
+                 * UnRLE the AC. This will modify currAcComp
+                 */
+                rv = LossyDctDecoder_unRleAc (
+                    &lastNonZero, &currAcComp, packedAcEnd, halfZigBlock);
+                if (rv != EXR_ERR_SUCCESS) return rv;
+
+                /*
+                 * Convert from XDR to NATIVE
+                 */
+                priv_to_native16 (halfZigBlock, 64);
+
+                if (lastNonZero == 0)
+                {
+                    /*
+                     * DC only case - AC components are all 0
+                     */
+                    dctData[0] = half_to_float (halfZigBlock[0]);
+
+                    dctInverse8x8DcOnly (dctData);
+                }
+                else
+                {
+                    /*
+                     * We have some AC components that are non-zero.
+                     * Can't use the 'constant block' optimization
+                     */
+                    blockIsConstant = 0;
+
+                    /*
+                     * Un-Zig zag
+                     */
+                    me->_funcs.fromHalfZigZag (halfZigBlock, dctData);
+
+                    /*
+                     * Zig-Zag indices in normal layout are as follows:
+                     *
+                     * 0   1   5   6   14  15  27  28
+                     * 2   4   7   13  16  26  29  42
+                     * 3   8   12  17  25  30  41  43
+                     * 9   11  18  24  31  40  44  53
+                     * 10  19  23  32  39  45  52  54
+                     * 20  22  33  38  46  51  55  60
+                     * 21  34  37  47  50  56  59  61
+                     * 35  36  48  49  57  58  62  63
+                     *
+                     * If lastNonZero is less than the first item on
+                     * each row, we know that the whole row is zero and
+                     * can be skipped in the row-oriented part of the
+                     * iDCT.
+                     *
+                     * The unrolled logic here is:
+                     *
+                     *    if lastNonZero < rowStartIdx[i],
+                     *    zeroedRows = rowsEmpty[i]
+                     *
+                     * where:
+                     *
+                     *    const int rowStartIdx[] = {2, 3, 9, 10, 20, 21, 35};
+                     *    const int rowsEmpty[]   = {7, 6, 5,  4,  3,  2,  1};
+                     */
+                    if (lastNonZero < 2)
+                        me->_funcs.dctInverse8x8 (dctData, 7);
+                    else if (lastNonZero < 3)
+                        me->_funcs.dctInverse8x8 (dctData, 6);
+                    else if (lastNonZero < 9)
+                        me->_funcs.dctInverse8x8 (dctData, 5);
+                    else if (lastNonZero < 10)
+                        me->_funcs.dctInverse8x8 (dctData, 4);
+                    else if (lastNonZero < 20)
+                        me->_funcs.dctInverse8x8 (dctData, 3);
+                    else if (lastNonZero < 21)
+                        me->_funcs.dctInverse8x8 (dctData, 2);
+                    else if (lastNonZero < 35)
+                        me->_funcs.dctInverse8x8 (dctData, 1);
+                    else
+                        me->_funcs.dctInverse8x8 (dctData, 0);
+                }
+            }
+
+            /*
+             * Perform the CSC
+             */
+            if (numComp == 3)
+            {
+                if (!blockIsConstant)
+                {
+                    csc709Inverse64 (
+                        chans[0].dctData, chans[1].dctData, chans[2].dctData);
+                }
+                else
+                {
+                    csc709Inverse (
+                        chans[0].dctData, chans[1].dctData, chans[2].dctData);
+                }
+            }
+
+            /*
+             * Float -> Half conversion.
+             *
+             * If the block has a constant value, just convert the first pixel.
+             */
+            for (int comp = 0; comp < numComp; ++comp)
+            {
+                uint16_t* dst = chans[comp].rowBlock + blockx * 64;
+
+                if (!blockIsConstant)
+                {
+                    me->_funcs.convertFloatToHalf64 (dst, chans[comp].dctData);
+                }
+                else
+                {
+                    uint16_t h = float_to_half (chans[comp].dctData[0]);
+
+                    for (int i = 0; i < 64; ++i)
+                        dst[i] = h;
+                }
+            }
+        }
+
+        /*
+         * At this point, we have half-float nonlinear value blocked
+         * in rowBlock[][]. We need to unblock the data, transfer
+         * back to linear, and write the results in the row pointers.
+         */
+        for (int comp = 0; comp < numComp; ++comp)
+        {
+            const uint16_t* rowBlock = chans[comp].rowBlock;
+
+            for (int y = 8 * blocky; y < 8 * blocky + maxY; ++y)
+            {
+                uint16_t* dst = (uint16_t*) chans[comp].rows[y];
+
+                for (int blockx = 0; blockx < numFullBlocksX; ++blockx)
+                {
+                    const uint16_t* src =
+                        rowBlock + blockx * 64 + ((y & 0x7) * 8);
+
+                    dst[0] = one_from_native16 (toLinear[src[0]]);
+                    dst[1] = one_from_native16 (toLinear[src[1]]);
+                    dst[2] = one_from_native16 (toLinear[src[2]]);
+                    dst[3] = one_from_native16 (toLinear[src[3]]);
+
+                    dst[4] = one_from_native16 (toLinear[src[4]]);
+                    dst[5] = one_from_native16 (toLinear[src[5]]);
+                    dst[6] = one_from_native16 (toLinear[src[6]]);
+                    dst[7] = one_from_native16 (toLinear[src[7]]);
+
+                    dst += 8;
+                }
+
+                /*
+                 * If we have partial X blocks, deal with all those now
+                 */
+                if (numFullBlocksX != numBlocksX)
+                {
+                    const uint16_t* src =
+                        rowBlock + numFullBlocksX * 64 + ((y & 0x7) * 8);
+
+                    for (int x = 0; x < maxX; ++x)
+                        *dst++ = one_from_native16 (toLinear[*src++]);
+                }
+            }
+        }
+    }
+
+    /*
+     * Walk over all the channels that are of type FLOAT.
+     * Convert from HALF XDR back to FLOAT XDR. This is done
+     * in place, walking backwards across each row.
+     */
+    for (int comp = 0; comp < numComp; ++comp)
+    {
+        if (chans[comp].type != EXR_PIXEL_FLOAT) continue;
+
+        for (int y = 0; y < height; ++y)
+        {
+            uint8_t* row = chans[comp].rows[y];
+
+            for (int x = width - 1; x >= 0; --x)
+            {
+                union
+                {
+                    uint32_t i;
+                    float    f;
+                } v;
+
+                v.f = half_to_float (
+                    one_to_native16 (unaligned_load16 (row + x * 2)));
+                unaligned_store32 (row + x * 4, one_from_native32 (v.i));
+            }
+        }
+    }
+
+    *packedAc = currAcComp;
+    *packedDc += numDc;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+static exr_result_t
+DwaCompressor_construct (
+    DwaCompressor*         me,
+    int                    acCompression,
+    exr_encode_pipeline_t* encode,
+    exr_decode_pipeline_t* decode)
+{
+    memset (me, 0, sizeof (DwaCompressor));
+
+    me->_encode              = encode;
+    me->_decode              = decode;
+    me->_acCompression       = acCompression;
+    me->_dwaCompressionLevel = 45.f;
+
+    initializeFuncs (&(me->_funcs));
+
+    if (encode)
+    {
+        exr_attribute_t* dwaLevel = NULL;
+        exr_result_t     rv;
+
+        EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (
+            encode->context, encode->part_index);
+
+        /*
+         * Check the header for a quality attribute
+         */
+        rv = exr_attr_list_find_by_name (
+            EXR_CONST_CAST (exr_context_t, encode->context),
+            EXR_CONST_CAST (exr_attribute_list_t*, &(part->attributes)),
+            "dwaCompressionLevel",
+            &dwaLevel);
+        if (rv == EXR_ERR_SUCCESS && dwaLevel &&
+            dwaLevel->type == EXR_ATTR_FLOAT)
+            me->_dwaCompressionLevel = dwaLevel->f;
+    }
+
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+static exr_result_t
+DwaCompressor_compress (DwaCompressor* me)
+{
+    exr_result_t           rv;
+    exr_encode_pipeline_t* encode = me->_encode;
+    uint8_t*               outPtr;
+    uint8_t*               outDataPtr;
+    uint8_t*               writePtr;
+    uint64_t               outBufferSize   = 0;
+    uint64_t               channelRuleSize = 0;
+    int                    numRelevantRules;
+    uint64_t               sizes[NUM_SIZES_SINGLE];
+    uint16_t*              packedAcEnd;
+    uint16_t*              packedDcEnd;
+    LossyDctChannel        ldc[3];
+    int                    fileVersion = 2;
+
+    /*
+     * Starting with version 2, we write the channel
+     * classification rules into the file
+     */
+    me->_channelRules    = sDefaultChannelRules;
+    me->_numChannelRules = NUM_DEFAULT_RULES;
+
+    rv = DwaCompressor_initializeChannels (me, NUM_DEFAULT_RULES);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    rv = DwaCompressor_initializeBuffers (me, &outBufferSize);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    numRelevantRules =
+        DwaCompressor_relevantChannelRules (me, me->_parsedRules);
+
+    channelRuleSize = sizeof (uint16_t);
+    for (int i = 0; i < numRelevantRules; ++i)
+        channelRuleSize += Classifier_size (me->_parsedRules + i);
+
+    outBufferSize += channelRuleSize;
+
+    rv = internal_encode_alloc_buffer (
+        encode,
+        EXR_TRANSCODE_BUFFER_COMPRESSED,
+        &(encode->compressed_buffer),
+        &(encode->compressed_alloc_size),
+        outBufferSize);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    outPtr     = encode->compressed_buffer;
+    outDataPtr = outPtr + DWA_HEADER_BYTES + channelRuleSize;
+
+    /*
+     * Zero all the numbers in the chunk header
+     */
+    memset (sizes, 0, sizeof (sizes));
+
+    /*
+     * Setup the AC compression strategy and the version in the data block,
+     * then write the relevant channel classification rules
+     */
+    sizes[VERSION]        = (uint64_t) fileVersion;
+    sizes[AC_COMPRESSION] = (uint64_t) me->_acCompression;
+
+    DwaCompressor_setupChannelData (me);
+
+    writePtr = outPtr + DWA_HEADER_BYTES;
+    unaligned_store16 (writePtr, one_from_native16 ((uint16_t) channelRuleSize));
+    writePtr += sizeof (uint16_t);
+    for (int i = 0; i < numRelevantRules; ++i)
+        Classifier_write (me->_parsedRules + i, &writePtr);
+
+    rv = DwaCompressor_setupRowPtrs (
+        me, encode->packed_buffer, encode->packed_bytes);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    packedAcEnd = (uint16_t*) me->_packedAcBuffer;
+    packedDcEnd = (uint16_t*) me->_packedDcBuffer;
+
+    /*
+     * Make a pass over all our CSC sets and try to encode them first
+     */
+    for (int csc = 0; csc < me->_numCscSets; ++csc)
+    {
+        const CscChannelSet* cset = me->_cscSets + csc;
+        const ChannelData*   cd   = me->_channelData + cset->idx[0];
+
+        DwaCompressor_setupLossyDct (me, ldc, cset->idx, 3);
+
+        rv = LossyDctEncoder_execute (
+            me,
+            ldc,
+            3,
+            dwaCompressorToNonlinear,
+            cd->width,
+            cd->height,
+            &packedAcEnd,
+            &packedDcEnd,
+            sizes + AC_UNCOMPRESSED_COUNT,
+            sizes + DC_UNCOMPRESSED_COUNT);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+
+        me->_channelData[cset->idx[0]].compression = -LOSSY_DCT;
+        me->_channelData[cset->idx[1]].compression = -LOSSY_DCT;
+        me->_channelData[cset->idx[2]].compression = -LOSSY_DCT;
+    }
+
+    for (int chan = 0; chan < me->_numChannels; ++chan)
+    {
+        ChannelData* cd  = me->_channelData + chan;
+        int          bpe = cd->chan->bytes_per_element;
+
+        switch (cd->compression)
+        {
+            case -LOSSY_DCT:
+                /* already encoded as part of a CSC set */
+                cd->compression = LOSSY_DCT;
+                break;
+
+            case LOSSY_DCT:
+                /*
+                 * For LOSSY_DCT, treat this just like the CSC'd case,
+                 * but only operate on one channel
+                 */
+                DwaCompressor_setupLossyDct (me, ldc, &chan, 1);
+
+                rv = LossyDctEncoder_execute (
+                    me,
+                    ldc,
+                    1,
+                    cd->chan->p_linear ? NULL : dwaCompressorToNonlinear,
+                    cd->width,
+                    cd->height,
+                    &packedAcEnd,
+                    &packedDcEnd,
+                    sizes + AC_UNCOMPRESSED_COUNT,
+                    sizes + DC_UNCOMPRESSED_COUNT);
+                if (rv != EXR_ERR_SUCCESS) return rv;
+                break;
+
+            case RLE:
+                /*
+                 * For RLE, bash the bytes up so that the first bytes of each
+                 * pixel are contingous, as are the second bytes, and so on.
+                 */
+                for (int y = 0; y < cd->height; ++y)
+                {
+                    const uint8_t* row = cd->rows[y];
+
+                    for (int x = 0; x < cd->width; ++x)
+                    {
+                        for (int byte = 0; byte < bpe; ++byte)
+                            *(cd->planarUncRleEnd[byte])++ = *row++;
+                    }
+
+                    sizes[RLE_RAW_SIZE] += (uint64_t) cd->width * (uint64_t) bpe;
+                }
+                break;
+
+            case UNKNOWN: {
+                /*
+                 * Otherwise, just copy data over verbatim
+                 */
+                uint64_t scanlineSize = (uint64_t) cd->width * (uint64_t) bpe;
+
+                for (int y = 0; y < cd->height; ++y)
+                {
+                    memcpy (cd->planarUncBufferEnd, cd->rows[y], scanlineSize);
+
+                    cd->planarUncBufferEnd += scanlineSize;
+                }
+
+                sizes[UNKNOWN_UNCOMPRESSED_SIZE] += cd->planarUncSize;
+                break;
+            }
+
+            default: return EXR_ERR_INVALID_ARGUMENT;
+        }
+    }
+
+    /*
+     * Pack the Unknown data into the output buffer first. Instead of
+     * just copying it uncompressed, try zlib compression at least.
+     */
+    if (sizes[UNKNOWN_UNCOMPRESSED_SIZE] > 0)
+    {
+        uLongf inSize  = (uLongf) sizes[UNKNOWN_UNCOMPRESSED_SIZE];
+        uLongf outSize = compressBound (inSize);
+
+        if (Z_OK != compress2 (
+                        (Bytef*) outDataPtr,
+                        &outSize,
+                        (const Bytef*) me->_planarUncBuffer[UNKNOWN],
+                        inSize,
+                        9))
+        {
+            return EXR_ERR_CORRUPT_CHUNK;
+        }
+
+        outDataPtr += outSize;
+        sizes[UNKNOWN_COMPRESSED_SIZE] = outSize;
+    }
+
+    /*
+     * Now, pack all the Lossy DCT coefficients into our output
+     * buffer, with Huffman encoding.
+     *
+     * Also, record the compressed size and the number of
+     * uncompressed componentns we have.
+     */
+    if (sizes[AC_UNCOMPRESSED_COUNT] > 0)
+    {
+        switch (me->_acCompression)
+        {
+            case STATIC_HUFFMAN:
+                rv = internal_huf_compress (
+                    sizes + AC_COMPRESSED_SIZE,
+                    outDataPtr,
+                    outBufferSize - (uint64_t) (outDataPtr - outPtr),
+                    (const uint16_t*) me->_packedAcBuffer,
+                    sizes[AC_UNCOMPRESSED_COUNT],
+                    me->_hufSpare,
+                    me->_hufSpareSize);
+                if (rv != EXR_ERR_SUCCESS) return rv;
+                break;
+
+            case DEFLATE: {
+                uLongf destLen = compressBound (
+                    (uLong) (sizes[AC_UNCOMPRESSED_COUNT] * sizeof (uint16_t)));
+
+                if (Z_OK != compress2 (
+                                (Bytef*) outDataPtr,
+                                &destLen,
+                                (const Bytef*) me->_packedAcBuffer,
+                                (uLong) (sizes[AC_UNCOMPRESSED_COUNT] *
+                                         sizeof (uint16_t)),
+                                9))
+                {
+                    return EXR_ERR_CORRUPT_CHUNK;
+                }
+
+                sizes[AC_COMPRESSED_SIZE] = destLen;
+                break;
+            }
+
+            default: return EXR_ERR_INVALID_ARGUMENT;
+        }
+
+        outDataPtr += sizes[AC_COMPRESSED_SIZE];
+    }
+
+    /*
+     * Handle the DC components separately
+     */
+    if (sizes[DC_UNCOMPRESSED_COUNT] > 0)
+    {
+        rv = internal_zip_compress (
+            me->_encode->context,
+            sizes + DC_COMPRESSED_SIZE,
+            outDataPtr,
+            outBufferSize - (uint64_t) (outDataPtr - outPtr),
+            me->_packedDcBuffer,
+            sizes[DC_UNCOMPRESSED_COUNT] * sizeof (uint16_t),
+            me->_zipScratch,
+            me->_zipScratchSize,
+            -1);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+
+        outDataPtr += sizes[DC_COMPRESSED_SIZE];
+    }
+
+    /*
+     * If we have RLE data, first RLE encode it and set the uncompressed
+     * size. Then, deflate the results and set the compressed size.
+     */
+    if (sizes[RLE_RAW_SIZE] > 0)
+    {
+        uLongf dstLen;
+
+        sizes[RLE_UNCOMPRESSED_SIZE] = internal_rle_compress (
+            me->_rleBuffer,
+            me->_rleBufferSize,
+            me->_planarUncBuffer[RLE],
+            sizes[RLE_RAW_SIZE]);
+
+        dstLen = compressBound ((uLong) sizes[RLE_UNCOMPRESSED_SIZE]);
+
+        if (Z_OK != compress2 (
+                        (Bytef*) outDataPtr,
+                        &dstLen,
+                        (const Bytef*) me->_rleBuffer,
+                        (uLong) sizes[RLE_UNCOMPRESSED_SIZE],
+                        9))
+        {
+            return EXR_ERR_CORRUPT_CHUNK;
+        }
+
+        sizes[RLE_COMPRESSED_SIZE] = dstLen;
+        outDataPtr += sizes[RLE_COMPRESSED_SIZE];
+    }
+
+    /*
+     * Flip the counters to XDR format
+     */
+    for (int i = 0; i < NUM_SIZES_SINGLE; ++i)
+    {
+        uint64_t v = one_from_native64 (sizes[i]);
+        memcpy (outPtr + i * sizeof (uint64_t), &v, sizeof (uint64_t));
+    }
+
+    /*
+     * We're done - compute the number of bytes we packed. If we
+     * didn't manage to make things smaller, store the raw data.
+     */
+    encode->compressed_bytes = (uint64_t) (outDataPtr - outPtr);
+    if (encode->compressed_bytes >= encode->packed_bytes)
+    {
+        memcpy (
+            encode->compressed_buffer,
+            encode->packed_buffer,
+            encode->packed_bytes);
+        encode->compressed_bytes = encode->packed_bytes;
+    }
+
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+static exr_result_t
+DwaCompressor_uncompress (
+    DwaCompressor* me,
+    const uint8_t* inPtr,
+    uint64_t       iSize,
+    void*          uncompressed_data,
+    uint64_t       uncompressed_size)
+{
+    exr_result_t    rv;
+    uint64_t        headerSize = DWA_HEADER_BYTES;
+    uint64_t        sizes[NUM_SIZES_SINGLE];
+    uint64_t        version, unknownUncompressedSize, unknownCompressedSize;
+    uint64_t        acCompressedSize, dcCompressedSize, rleCompressedSize;
+    uint64_t        rleUncompressedSize, rleRawSize;
+    uint64_t        totalAcUncompressedCount, totalDcUncompressedCount;
+    uint64_t        acCompression, compressedSize;
+    uint64_t        outBufferSize  = 0;
+    uint64_t        numParsedRules = 0;
+    uint16_t        ruleSize       = 0;
+    const uint8_t*  dataPtr;
+    const uint8_t*  compressedUnknownBuf;
+    const uint8_t*  compressedAcBuf;
+    const uint8_t*  compressedDcBuf;
+    const uint8_t*  compressedRleBuf;
+    const uint16_t* packedAcBufferEnd;
+    const uint16_t* packedAcEnd;
+    const uint16_t* packedDcBufferEnd;
+    const uint16_t* packedDcEnd;
+    LossyDctChannel ldc[3];
+
+    if (iSize < headerSize) return EXR_ERR_CORRUPT_CHUNK;
+
+    /*
+     * Flip the counters from XDR to NATIVE
+     */
+    for (int i = 0; i < NUM_SIZES_SINGLE; ++i)
+    {
+        uint64_t v;
+        memcpy (&v, inPtr + i * sizeof (uint64_t), sizeof (uint64_t));
+        sizes[i] = one_to_native64 (v);
+    }
+
+    /*
+     * Unwind all the counter info
+     */
+    version                  = sizes[VERSION];
+    unknownUncompressedSize  = sizes[UNKNOWN_UNCOMPRESSED_SIZE];
+    unknownCompressedSize    = sizes[UNKNOWN_COMPRESSED_SIZE];
+    acCompressedSize         = sizes[AC_COMPRESSED_SIZE];
+    dcCompressedSize         = sizes[DC_COMPRESSED_SIZE];
+    rleCompressedSize        = sizes[RLE_COMPRESSED_SIZE];
+    rleUncompressedSize      = sizes[RLE_UNCOMPRESSED_SIZE];
+    rleRawSize               = sizes[RLE_RAW_SIZE];
+    totalAcUncompressedCount = sizes[AC_UNCOMPRESSED_COUNT];
+    totalDcUncompressedCount = sizes[DC_UNCOMPRESSED_COUNT];
+    acCompression            = sizes[AC_COMPRESSION];
+
+    compressedSize = unknownCompressedSize + acCompressedSize +
+                     dcCompressedSize + rleCompressedSize;
+
+    dataPtr = inPtr + headerSize;
+
+    /* Both the sum and individual sizes are checked in case of overflow. */
+    if (iSize < (headerSize + compressedSize) ||
+        iSize < unknownCompressedSize || iSize < acCompressedSize ||
+        iSize < dcCompressedSize || iSize < rleCompressedSize)
+    {
+        return EXR_ERR_CORRUPT_CHUNK;
+    }
+
+    if ((int64_t) unknownUncompressedSize < 0 ||
+        (int64_t) unknownCompressedSize < 0 ||
+        (int64_t) acCompressedSize < 0 || (int64_t) dcCompressedSize < 0 ||
+        (int64_t) rleCompressedSize < 0 || (int64_t) rleUncompressedSize < 0 ||
+        (int64_t) rleRawSize < 0 || (int64_t) totalAcUncompressedCount < 0 ||
+        (int64_t) totalDcUncompressedCount < 0)
+    {
+        return EXR_ERR_CORRUPT_CHUNK;
+    }
+
+    /*
+     * Sanity check that the version is something we expect. Right now,
+     * we can decode version 0, 1, and 2. v1 adds 'end of block' symbols
+     * to the AC RLE. v2 adds channel classification rules at the
+     * start of the data block.
+     */
+    if (version > 2) return EXR_ERR_CORRUPT_CHUNK;
+
+    if (version >= 2)
+    {
+        ruleSize = one_to_native16 (unaligned_load16 (dataPtr));
+
+        if (ruleSize < sizeof (uint16_t)) return EXR_ERR_CORRUPT_CHUNK;
+
+        headerSize += ruleSize;
+        if (iSize < headerSize + compressedSize) return EXR_ERR_CORRUPT_CHUNK;
+
+        dataPtr += sizeof (uint16_t);
+        ruleSize -= sizeof (uint16_t);
+        /* each rule is at least 3 bytes */
+        numParsedRules = ruleSize / 3;
+    }
+
+    me->_acCompression = (int) acCompression;
+
+    rv = DwaCompressor_initializeChannels (me, numParsedRules);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    if (version < 2)
+    {
+        me->_channelRules    = sLegacyChannelRules;
+        me->_numChannelRules = NUM_LEGACY_RULES;
+    }
+    else
+    {
+        int nRules = 0;
+
+        while (ruleSize > 0)
+        {
+            const uint8_t* ruleStart = dataPtr;
+
+            rv = Classifier_read (me->_parsedRules + nRules, &dataPtr, ruleSize);
+            if (rv != EXR_ERR_SUCCESS) return rv;
+
+            ruleSize -= (uint16_t) (dataPtr - ruleStart);
+            ++nRules;
+        }
+
+        me->_channelRules    = me->_parsedRules;
+        me->_numChannelRules = nRules;
+    }
+
+    rv = DwaCompressor_initializeBuffers (me, &outBufferSize);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    /*
+     * UNKNOWN data is packed first, followed by the
+     * Huffman-compressed AC, then the DC values,
+     * and then the zlib compressed RLE data.
+     */
+    compressedUnknownBuf = dataPtr;
+    compressedAcBuf      = compressedUnknownBuf + unknownCompressedSize;
+    compressedDcBuf      = compressedAcBuf + acCompressedSize;
+    compressedRleBuf     = compressedDcBuf + dcCompressedSize;
+
+    DwaCompressor_setupChannelData (me);
+
+    /*
+     * Uncompress the UNKNOWN data into _planarUncBuffer[UNKNOWN]
+     */
+    if (unknownCompressedSize > 0)
+    {
+        uLongf outSize = (uLongf) unknownUncompressedSize;
+
+        if (unknownUncompressedSize > me->_planarUncBufferSize[UNKNOWN])
+            return EXR_ERR_CORRUPT_CHUNK;
+
+        if (Z_OK != uncompress (
+                        (Bytef*) me->_planarUncBuffer[UNKNOWN],
+                        &outSize,
+                        (const Bytef*) compressedUnknownBuf,
+                        (uLong) unknownCompressedSize) ||
+            outSize != unknownUncompressedSize)
+        {
+            return EXR_ERR_CORRUPT_CHUNK;
+        }
+    }
+    else
+        unknownUncompressedSize = 0;
+
+    /*
+     * Uncompress the AC data into _packedAcBuffer
+     */
+    if (acCompressedSize > 0)
+    {
+        if (!me->_packedAcBuffer || totalAcUncompressedCount * sizeof (uint16_t) >
+                                        me->_packedAcBufferSize)
+        {
+            return EXR_ERR_CORRUPT_CHUNK;
+        }
+
+        /*
+         * Don't trust the user to get it right, look in the file.
+         */
+        switch (acCompression)
+        {
+            case STATIC_HUFFMAN:
+                if (me->_hufSpareSize == 0) return EXR_ERR_CORRUPT_CHUNK;
+                internal_exr_huf_invalidate_decode_tables (
+                    me->_hufSpare, me->_hufSpareSize);
+                rv = internal_huf_decompress (
+                    compressedAcBuf,
+                    acCompressedSize,
+                    (uint16_t*) me->_packedAcBuffer,
+                    totalAcUncompressedCount,
+                    me->_hufSpare,
+                    me->_hufSpareSize);
+                if (rv != EXR_ERR_SUCCESS) return rv;
+                break;
+
+            case DEFLATE: {
+                uLongf destLen =
+                    (uLongf) (totalAcUncompressedCount * sizeof (uint16_t));
+
+                if (Z_OK != uncompress (
+                                (Bytef*) me->_packedAcBuffer,
+                                &destLen,
+                                (const Bytef*) compressedAcBuf,
+                                (uLong) acCompressedSize))
+                {
+                    return EXR_ERR_CORRUPT_CHUNK;
+                }
+
+                if (totalAcUncompressedCount * sizeof (uint16_t) != destLen)
+                    return EXR_ERR_CORRUPT_CHUNK;
+                break;
+            }
+
+            default: return EXR_ERR_CORRUPT_CHUNK;
+        }
+    }
+    else
+        totalAcUncompressedCount = 0;
+
+    /*
+     * Uncompress the DC data into _packedDcBuffer
+     */
+    if (dcCompressedSize > 0)
+    {
+        if (totalDcUncompressedCount * sizeof (uint16_t) >
+            me->_packedDcBufferSize)
+        {
+            return EXR_ERR_CORRUPT_CHUNK;
+        }
+
+        rv = internal_zip_decompress (
+            me->_decode->context,
+            compressedDcBuf,
+            dcCompressedSize,
+            me->_packedDcBuffer,
+            totalDcUncompressedCount * sizeof (uint16_t),
+            me->_zipScratch,
+            me->_zipScratchSize);
+        if (rv != EXR_ERR_SUCCESS) return EXR_ERR_CORRUPT_CHUNK;
+    }
+    else
+    {
+        /* if the compressed size is 0, then the uncompressed size must also be zero */
+        if (totalDcUncompressedCount != 0) return EXR_ERR_CORRUPT_CHUNK;
+    }
+
+    /*
+     * Uncompress the RLE data into _rleBuffer, then unRLE the results
+     * into _planarUncBuffer[RLE]
+     */
+    if (rleRawSize > 0)
+    {
+        uLongf dstLen = (uLongf) rleUncompressedSize;
+
+        if (rleUncompressedSize > me->_rleBufferSize ||
+            rleRawSize > me->_planarUncBufferSize[RLE])
+        {
+            return EXR_ERR_CORRUPT_CHUNK;
+        }
+
+        if (Z_OK != uncompress (
+                        (Bytef*) me->_rleBuffer,
+                        &dstLen,
+                        (const Bytef*) compressedRleBuf,
+                        (uLong) rleCompressedSize))
+        {
+            return EXR_ERR_CORRUPT_CHUNK;
+        }
+
+        if (dstLen != rleUncompressedSize) return EXR_ERR_CORRUPT_CHUNK;
+
+        if (internal_rle_decompress (
+                me->_planarUncBuffer[RLE],
+                rleRawSize,
+                me->_rleBuffer,
+                rleUncompressedSize) != rleRawSize)
+        {
+            return EXR_ERR_CORRUPT_CHUNK;
+        }
+    }
+
+    /*
+     * Determine the start of each row in the output buffer
+     */
+    rv = DwaCompressor_setupRowPtrs (me, uncompressed_data, uncompressed_size);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    packedAcBufferEnd = (const uint16_t*) me->_packedAcBuffer;
+    packedAcEnd       = packedAcBufferEnd + totalAcUncompressedCount;
+    packedDcBufferEnd = (const uint16_t*) me->_packedDcBuffer;
+    packedDcEnd       = packedDcBufferEnd + totalDcUncompressedCount;
+
+    /*
+     * Setup to decode each block of 3 channels that need to
+     * be handled together
+     */
+    for (int csc = 0; csc < me->_numCscSets; ++csc)
+    {
+        const CscChannelSet* cset = me->_cscSets + csc;
+        ChannelData*         rChan = me->_channelData + cset->idx[0];
+        ChannelData*         gChan = me->_channelData + cset->idx[1];
+        ChannelData*         bChan = me->_channelData + cset->idx[2];
+
+        if (rChan->compression != LOSSY_DCT ||
+            gChan->compression != LOSSY_DCT || bChan->compression != LOSSY_DCT)
+        {
+            return EXR_ERR_CORRUPT_CHUNK;
+        }
+
+        DwaCompressor_setupLossyDct (me, ldc, cset->idx, 3);
+
+        rv = LossyDctDecoder_execute (
+            me,
+            ldc,
+            3,
+            dwaCompressorToLinear,
+            rChan->width,
+            rChan->height,
+            &packedAcBufferEnd,
+            packedAcEnd,
+            &packedDcBufferEnd,
+            packedDcEnd);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+
+        rChan->compression = -LOSSY_DCT;
+        gChan->compression = -LOSSY_DCT;
+        bChan->compression = -LOSSY_DCT;
+    }
+
+    /*
+     * Setup to handle the remaining channels by themselves
+     */
+    for (int chan = 0; chan < me->_numChannels; ++chan)
+    {
+        ChannelData* cd        = me->_channelData + chan;
+        int          pixelSize = cd->chan->bytes_per_element;
+
+        switch (cd->compression)
+        {
+            case -LOSSY_DCT:
+                /* already decoded as part of a CSC set */
+                cd->compression = LOSSY_DCT;
+                break;
+
+            case LOSSY_DCT:
+                /*
+                 * Setup a single-channel lossy DCT decoder pointing
+                 * at the output buffer
+                 */
+                DwaCompressor_setupLossyDct (me, ldc, &chan, 1);
+
+                rv = LossyDctDecoder_execute (
+                    me,
+                    ldc,
+                    1,
+                    cd->chan->p_linear ? NULL : dwaCompressorToLinear,
+                    cd->width,
+                    cd->height,
+                    &packedAcBufferEnd,
+                    packedAcEnd,
+                    &packedDcBufferEnd,
+                    packedDcEnd);
+                if (rv != EXR_ERR_SUCCESS) return rv;
+                break;
+
+            case RLE:
+                /*
+                 * For the RLE case, the data has been un-RLE'd into
+                 * planarUncRleEnd[], but is still split out by bytes.
+                 * We need to rearrange the bytes back into the correct
+                 * order in the output buffer;
+                 */
+                if (cd->planarUncRle[0] + cd->planarUncSize >
+                    me->_planarUncBuffer[RLE] + rleRawSize)
+                    return EXR_ERR_CORRUPT_CHUNK;
+
+                for (int y = 0; y < cd->height; ++y)
+                {
+                    uint8_t* dst = cd->rows[y];
+
+                    if (pixelSize == 2)
+                    {
+                        interleaveByte2 (
+                            dst,
+                            cd->planarUncRleEnd[0],
+                            cd->planarUncRleEnd[1],
+                            cd->width);
+
+                        cd->planarUncRleEnd[0] += cd->width;
+                        cd->planarUncRleEnd[1] += cd->width;
+                    }
+                    else
+                    {
+                        for (int x = 0; x < cd->width; ++x)
+                        {
+                            for (int byte = 0; byte < pixelSize; ++byte)
+                                *dst++ = *(cd->planarUncRleEnd[byte])++;
+                        }
+                    }
+                }
+                break;
+
+            case UNKNOWN: {
+                /*
+                 * In the UNKNOWN case, data is already in planarUncBufferEnd
+                 * and just needs to copied over to the output buffer
+                 */
+                uint64_t dstScanlineSize =
+                    (uint64_t) cd->width * (uint64_t) pixelSize;
+
+                for (int y = 0; y < cd->height; ++y)
+                {
+                    /*
+                     * sanity check for buffer data lying within range
+                     */
+                    if (cd->planarUncBufferEnd + dstScanlineSize >
+                        me->_planarUncBuffer[UNKNOWN] + unknownUncompressedSize)
+                    {
+                        return EXR_ERR_CORRUPT_CHUNK;
+                    }
+
+                    memcpy (cd->rows[y], cd->planarUncBufferEnd, dstScanlineSize);
+
+                    cd->planarUncBufferEnd += dstScanlineSize;
+                }
+                break;
+            }
+
+            default: return EXR_ERR_CORRUPT_CHUNK;
+        }
+    }
+
+    return EXR_ERR_SUCCESS;
+}
 
 /**************************************/
 
+static exr_result_t
+apply_dwa_impl (exr_encode_pipeline_t* encode, int acCompression)
+{
+    exr_result_t  rv;
+    DwaCompressor dwa;
+
+    rv = DwaCompressor_construct (&dwa, acCompression, encode, NULL);
+    if (rv == EXR_ERR_SUCCESS) rv = DwaCompressor_compress (&dwa);
+    return rv;
+}
+
 exr_result_t
 internal_exr_apply_dwaa (exr_encode_pipeline_t* encode)
 {
     EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (
         encode->context, encode->part_index);
-    return pctxt->report_error (
-        pctxt,
-        EXR_ERR_FEATURE_NOT_IMPLEMENTED,
-        "DWA/A compression not yet implemented in C");
+
+    /* tiled DWAA parts deflate the AC coefficients, matching the C++ library */
+    return apply_dwa_impl (
+        encode,
+        (part->storage_mode == EXR_STORAGE_TILED) ? DEFLATE : STATIC_HUFFMAN);
 }
 
 /**************************************/
@@ -29,12 +2548,31 @@ internal_exr_apply_dwaa (exr_encode_pipeline_t* encode)
 exr_result_t
 internal_exr_apply_dwab (exr_encode_pipeline_t* encode)
 {
-    EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (
-        encode->context, encode->part_index);
-    return pctxt->report_error (
-        pctxt,
-        EXR_ERR_FEATURE_NOT_IMPLEMENTED,
-        "DWA/B compression not yet implemented in C");
+    return apply_dwa_impl (encode, STATIC_HUFFMAN);
+}
+
+/**************************************/
+
+static exr_result_t
+undo_dwa_impl (
+    exr_decode_pipeline_t* decode,
+    const void*            compressed_data,
+    uint64_t               comp_buf_size,
+    void*                  uncompressed_data,
+    uint64_t               uncompressed_size)
+{
+    exr_result_t  rv;
+    DwaCompressor dwa;
+
+    rv = DwaCompressor_construct (&dwa, STATIC_HUFFMAN, NULL, decode);
+    if (rv == EXR_ERR_SUCCESS)
+        rv = DwaCompressor_uncompress (
+            &dwa,
+            compressed_data,
+            comp_buf_size,
+            uncompressed_data,
+            uncompressed_size);
+    return rv;
 }
 
 exr_result_t
@@ -45,18 +2583,16 @@ internal_exr_undo_dwaa (
     void*                  uncompressed_data,
     uint64_t               uncompressed_size)
 {
-    (void)compressed_data;
-    (void)comp_buf_size;
-    (void)uncompressed_data;
-    (void)uncompressed_size;
-    EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (
-        decode->context, decode->part_index);
-    return pctxt->report_error (
-        pctxt,
-        EXR_ERR_FEATURE_NOT_IMPLEMENTED,
-        "DWA/A decompression not yet implemented in C");
+    return undo_dwa_impl (
+        decode,
+        compressed_data,
+        comp_buf_size,
+        uncompressed_data,
+        uncompressed_size);
 }
 
+/**************************************/
+
 exr_result_t
 internal_exr_undo_dwab (
     exr_decode_pipeline_t* decode,
@@ -65,14 +2601,10 @@ internal_exr_undo_dwab (
     void*                  uncompressed_data,
     uint64_t               uncompressed_size)
 {
-    (void)compressed_data;
-    (void)comp_buf_size;
-    (void)uncompressed_data;
-    (void)uncompressed_size;
-    EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (
-        decode->context, decode->part_index);
-    return pctxt->report_error (
-        pctxt,
-        EXR_ERR_FEATURE_NOT_IMPLEMENTED,
-        "DWA/B decompression not yet implemented in C");
+    return undo_dwa_impl (
+        decode,
+        compressed_data,
+        comp_buf_size,
+        uncompressed_data,
+        uncompressed_size);
 }
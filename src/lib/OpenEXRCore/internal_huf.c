@@ -5,24 +5,77 @@
 
 #include "internal_huf.h"
 
-#include "internal_memory.h"
-
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define HUF_ENCBITS 16
-#define HUF_DECBITS 14
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
 
+#define HUF_ENCBITS 16
 #define HUF_ENCSIZE ((1 << HUF_ENCBITS) + 1)
-#define HUF_DECSIZE (1 << HUF_DECBITS)
-#define HUF_DECMASK (HUF_DECSIZE - 1)
+
+/* the packed table stores code lengths in 6 bits, 59 - 63 are runs */
+#define HUF_MAXCODELEN 58
+
+/* largest packed table, 6 bits for each symbol */
+#define HUF_MAXTABLEBYTES ((HUF_ENCSIZE * 6 + 7) / 8)
+
+/*
+ * Codes up to HUF_LOOKUPBITS long are decoded with a single table
+ * access, which resolves as many as HUF_LOOKUPSYMS symbols at once
+ */
+#define HUF_LOOKUPBITS 12
+#define HUF_LOOKUPSIZE (1 << HUF_LOOKUPBITS)
+#define HUF_LOOKUPMASK (HUF_LOOKUPSIZE - 1)
+#define HUF_LOOKUPSYMS 3
+
+/* HufDecEntry count values which are not a number of symbols */
+#define HUF_ENTRY_RLE 0xfe
+#define HUF_ENTRY_LONG 0xff
+
+/*
+ * Marks valid decoding tables in the spare buffer. The low 6 bits are
+ * all set, so this never matches the first code table entry
+ * internal_huf_compress leaves at the same place in a shared buffer.
+ */
+#define HUF_DECMAGIC 0x4855464445433f3fULL
+
+typedef struct _HufDecEntry
+{
+    uint16_t sym[HUF_LOOKUPSYMS];
+    uint8_t  len;   // bits used by all the symbols
+    uint8_t  count; // number of symbols, or HUF_ENTRY_RLE / HUF_ENTRY_LONG
+} HufDecEntry;
 
 typedef struct _HufDec
 {
-    int32_t   len;
-    uint32_t  lit;
-    uint32_t* p;
+    //
+    // The packed table the decoding tables were built from, chunks
+    // often repeat the table of the previous chunk
+    //
+
+    uint64_t magic;
+    uint32_t im;
+    uint32_t iM;
+    uint64_t tableBytes;
+
+    //
+    // Canonical codes longer than HUF_LOOKUPBITS, by code length
+    //
+
+    int      longMax;
+    uint64_t rleId;
+    uint64_t longStart[HUF_MAXCODELEN + 1];
+    uint64_t longCount[HUF_MAXCODELEN + 1];
+    uint64_t longOffset[HUF_MAXCODELEN + 1];
+
+    HufDecEntry table[HUF_LOOKUPSIZE]; // up to HUF_LOOKUPSYMS symbols
+    uint16_t    idToSymbol[HUF_ENCSIZE];
+    uint8_t     codeLen[HUF_ENCSIZE];
+    uint8_t     packedTable[HUF_MAXTABLEBYTES];
 } HufDec;
 
 /**************************************/
@@ -63,25 +116,62 @@ outputBits (int nBits, uint64_t bits, uint64_t* c, int* lc, uint8_t** outptr)
     *outptr = out;
 }
 
-static inline uint64_t
-getBits (uint32_t nBits, uint64_t* c, uint32_t* lc, const uint8_t** inptr)
+
+//
+// ENCODING TABLE BUILDING & (UN)PACKING
+//
+
+// index of the lowest set bit, v is not 0
+static inline uint32_t
+hufCtz64 (uint64_t v)
 {
-    const uint8_t* in = *inptr;
-    while (*lc < nBits)
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t) __builtin_ctzll (v);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long r;
+    _BitScanForward64 (&r, v);
+    return (uint32_t) r;
+#else
+    uint32_t r = 0;
+    while (!(v & 1))
     {
-        *c = (*c << 8) | (uint64_t) (*in++);
-        *lc += 8;
+        v >>= 1;
+        ++r;
     }
-
-    *inptr = in;
-    *lc -= nBits;
-    return (*c >> *lc) & ((1 << nBits) - 1);
+    return r;
+#endif
 }
 
 //
-// ENCODING TABLE BUILDING & (UN)PACKING
+// Bit k is set for every non-zero hcode[i + k], for the up to 8 of
+// those that are in [i, iM]. Going through the set bits avoids a
+// hard to predict branch on every symbol.
 //
 
+static inline uint64_t
+hufUsedMask (const uint64_t* hcode, uint32_t i, uint32_t iM)
+{
+    uint64_t m = 0;
+
+    if (i + 8 <= iM + 1)
+    {
+        hcode += i;
+        m = ((uint64_t) (hcode[0] != 0)) | ((uint64_t) (hcode[1] != 0) << 1) |
+            ((uint64_t) (hcode[2] != 0) << 2) |
+            ((uint64_t) (hcode[3] != 0) << 3) |
+            ((uint64_t) (hcode[4] != 0) << 4) |
+            ((uint64_t) (hcode[5] != 0) << 5) |
+            ((uint64_t) (hcode[6] != 0) << 6) |
+            ((uint64_t) (hcode[7] != 0) << 7);
+    }
+    else
+    {
+        for (uint32_t k = 0; i + k <= iM; ++k)
+            m |= ((uint64_t) (hcode[i + k] != 0)) << k;
+    }
+    return m;
+}
+
 //
 // Build a "canonical" Huffman code table:
 //	- for each (uncompressed) symbol, hcode contains the length
@@ -95,11 +185,12 @@ getBits (uint32_t nBits, uint64_t* c, uint32_t* lc, const uint8_t** inptr)
 //	- because the canonical code table can be constructed from
 //	  symbol lengths alone, the code table can be transmitted
 //	  without sending the actual code values
+//	- only entries im through iM are used, the others are zero
 //	- see http://www.compressconsult.com/huffman/
 //
 
 static void
-hufCanonicalCodeTable (uint64_t* hcode)
+hufCanonicalCodeTable (uint64_t* hcode, uint32_t im, uint32_t iM)
 {
     uint64_t n[59];
 
@@ -112,8 +203,11 @@ hufCanonicalCodeTable (uint64_t* hcode)
     for (int i = 0; i <= 58; ++i)
         n[i] = 0;
 
-    for (int i = 0; i < HUF_ENCSIZE; ++i)
-        n[hcode[i]] += 1;
+    for (uint32_t b = im; b <= iM; b += 8)
+    {
+        for (uint64_t m = hufUsedMask (hcode, b, iM); m; m &= m - 1)
+            n[hcode[b + hufCtz64 (m)]] += 1;
+    }
 
     //
     // For each i from 58 through 1, compute the
@@ -137,11 +231,15 @@ hufCanonicalCodeTable (uint64_t* hcode)
     // l and the code in hcode[i].
     //
 
-    for (int i = 0; i < HUF_ENCSIZE; ++i)
+    for (uint32_t b = im; b <= iM; b += 8)
     {
-        uint64_t l = hcode[i];
+        for (uint64_t m = hufUsedMask (hcode, b, iM); m; m &= m - 1)
+        {
+            uint32_t i = b + hufCtz64 (m);
+            uint64_t l = hcode[i];
 
-        if (l > 0) hcode[i] = l | (n[l]++ << 6);
+            hcode[i] = l | (n[l]++ << 6);
+        }
     }
 }
 
@@ -153,107 +251,63 @@ hufCanonicalCodeTable (uint64_t* hcode)
 //	- original frequencies are destroyed;
 //	- encoding tables are used by hufEncode() and hufBuildDecTable();
 //
-// NB: The following code "(*a == *b) && (a > b))" was added to ensure
-//     elements in the heap with the same value are sorted by index.
-//     This is to ensure, the STL make_heap()/pop_heap()/push_heap() methods
-//     produced a resultant sorted heap that is identical across OSes.
+// The nodes are taken from the heap in order of frequency, and for
+// equal frequencies in order of symbol, where a merged node is known
+// by the symbol of the second (more frequent) node. This is the order
+// the C++ library uses, so both produce the same codes.
+//
+// The heap entries hold the frequency and the symbol in one integer,
+// so that comparisons do not have to go back to frq.
 //
 
-static inline int
-FHeapCompare (uint64_t* a, uint64_t* b)
-{
-    return ((*a > *b) || ((*a == *b) && (a > b)));
-}
+#define HUF_HEAPSYMBITS 17
+#define HUF_HEAPSYMMASK ((1 << HUF_HEAPSYMBITS) - 1)
 
-static inline void
-intern_push_heap (
-    uint64_t** first, size_t holeIndex, size_t topIndex, uint64_t* value)
-{
-    size_t parent = (holeIndex - 1) / 2;
-    while (holeIndex > topIndex && FHeapCompare (*(first + parent), value))
-    {
-        *(first + holeIndex) = *(first + parent);
-        holeIndex            = parent;
-        parent               = (holeIndex - 1) / 2;
-    }
-    *(first + holeIndex) = value;
-}
+//
+// Restores the heap below entry i. The hole is first moved down to
+// the bottom along the smaller children, then the entry moves back
+// up to its place: it was at the end of the heap and usually
+// belongs near the bottom, and this way most comparisons are easy
+// to predict. The keys are all different, so this does not change
+// the order things come out.
+//
 
 static inline void
-adjust_heap (uint64_t** first, size_t holeIndex, size_t len, uint64_t* value)
+hufHeapDown (uint64_t* heap, uint32_t n, uint32_t i)
 {
-    const size_t topIndex    = holeIndex;
-    size_t       secondChild = holeIndex;
-
-    while (secondChild < (len - 1) / 2)
-    {
-        secondChild = 2 * (secondChild + 1);
-        if (FHeapCompare (*(first + secondChild), *(first + (secondChild - 1))))
-            --secondChild;
-        *(first + holeIndex) = *(first + secondChild);
-        holeIndex            = secondChild;
-    }
+    uint64_t v     = heap[i];
+    uint32_t start = i;
+    uint32_t c;
 
-    if ((len & 1) == 0 && secondChild == (len - 2) / 2)
+    while ((c = 2 * i + 2) < n)
     {
-        secondChild          = 2 * (secondChild + 1);
-        *(first + holeIndex) = *(first + (secondChild - 1));
-        holeIndex            = secondChild - 1;
+        c -= (uint32_t) (heap[c - 1] < heap[c]);
+        heap[i] = heap[c];
+        i       = c;
     }
 
-    intern_push_heap (first, holeIndex, topIndex, value);
-}
-
-static inline void
-push_heap (uint64_t** first, uint64_t** last)
-{
-    uint64_t* value = *(last - 1);
-    intern_push_heap (first, (size_t) (last - first) - 1, 0, value);
-}
-
-static inline void
-intern_pop_heap (uint64_t** first, uint64_t** last, uint64_t** result)
-{
-    uint64_t* value = *result;
-    *result         = *first;
-    adjust_heap (first, 0, (size_t) (last - first), value);
-}
-
-static inline void
-pop_heap (uint64_t** first, uint64_t** last)
-{
-    if (last - first > 1)
+    if (c == n)
     {
-        --last;
-        intern_pop_heap (first, last, last);
+        heap[i] = heap[c - 1];
+        i       = c - 1;
     }
-}
 
-static void
-make_heap (uint64_t** first, uint64_t len)
-{
-    size_t parent;
-
-    if (len < 2) return;
-    parent = (len - 2) / 2;
-
-    while (1)
+    while (i > start && v < heap[(i - 1) / 2])
     {
-        uint64_t* value = *(first + parent);
-        adjust_heap (first, parent, len, value);
-        if (parent == 0) return;
-        --parent;
+        heap[i] = heap[(i - 1) / 2];
+        i       = (i - 1) / 2;
     }
+    heap[i] = v;
 }
 
 static void
 hufBuildEncTable (
-    uint64_t*  frq,
-    uint32_t*  im,
-    uint32_t*  iM,
-    uint32_t*  hlink,
-    uint64_t** fHeap,
-    uint64_t*  scode)
+    uint64_t* frq,
+    uint32_t* im,
+    uint32_t* iM,
+    uint32_t* node,
+    uint64_t* heap,
+    uint32_t* parent)
 {
     //
     // This function assumes that when it is called, array frq
@@ -269,27 +323,29 @@ hufBuildEncTable (
     //     frq[im] != 0, and frq[i] == 0 for all i < im
     //     frq[iM] != 0, and frq[i] == 0 for all i > iM
     //
-    // 2) Fills array fHeap with pointers to all non-zero
-    //    entries in frq.
+    // 2) Fills the heap with all non-zero entries in frq.
     //
-    // 3) Initializes array hlink such that hlink[i] == i
-    //    for all array entries.
+    // 3) Initializes array node such that node[i] == i for
+    //    those entries.
     //
 
+    uint32_t nf   = 0;
+    uint32_t next = HUF_ENCSIZE;
+
     *im = 0;
 
     while (!frq[*im])
         (*im)++;
 
-    uint32_t nf = 0;
-
-    for (uint32_t i = *im; i < HUF_ENCSIZE; i++)
+    for (uint32_t b = *im; b < HUF_ENCSIZE; b += 8)
     {
-        hlink[i] = i;
-
-        if (frq[i])
+        for (uint64_t m = hufUsedMask (frq, b, HUF_ENCSIZE - 1); m;
+             m &= m - 1)
         {
-            fHeap[nf] = &frq[i];
+            uint32_t i = b + hufCtz64 (m);
+
+            heap[nf] = (frq[i] << HUF_HEAPSYMBITS) | i;
+            node[i]  = i;
             ++nf;
             *iM = i;
         }
@@ -297,19 +353,18 @@ hufBuildEncTable (
 
     //
     // Add a pseudo-symbol, with a frequency count of 1, to frq;
-    // adjust the fHeap and hlink array accordingly.  Function
+    // adjust the heap and node array accordingly.  Function
     // hufEncode() uses the pseudo-symbol for run-length encoding.
     //
 
     (*iM)++;
-    frq[*iM]  = 1;
-    fHeap[nf] = &frq[*iM];
+    frq[*iM]   = 1;
+    heap[nf]   = ((uint64_t) 1 << HUF_HEAPSYMBITS) | *iM;
+    node[*iM]  = *iM;
     ++nf;
 
     //
-    // Build an array, scode, such that scode[i] contains the number
-    // of bits assigned to symbol i.  Conceptually this is done by
-    // constructing a tree whose leaves are the symbols with non-zero
+    // Build the tree whose leaves are the symbols with non-zero
     // frequency:
     //
     //     Make a heap that contains all symbols with a non-zero frequency,
@@ -326,90 +381,61 @@ hufBuildEncTable (
     // leaf node, the distance between the root and the leaf is the length
     // of the code for the corresponding symbol.
     //
-    // The loop below doesn't actually build the tree; instead we compute
-    // the distances of the leaves from the root on the fly.  When a new
-    // node is added to the heap, then that node's descendants are linked
-    // into a single linear list that starts at the new node, and the code
-    // lengths of the descendants (that is, their distance from the root
-    // of the tree) are incremented by one.
+    // Leaves are numbered by their symbol, and the inner nodes from
+    // HUF_ENCSIZE on, in the order they are created. parent[] links
+    // every node to the one above it.
     //
 
-    make_heap (fHeap, nf);
-
-    memset (scode, 0, sizeof (uint64_t) * HUF_ENCSIZE);
+    for (uint32_t i = nf / 2; i > 0; --i)
+        hufHeapDown (heap, nf, i - 1);
 
     while (nf > 1)
     {
-        //
-        // Find the indices, mm and m, of the two smallest non-zero frq
-        // values in fHeap, add the smallest frq to the second-smallest
-        // frq, and remove the smallest frq value from fHeap.
-        //
+        uint64_t lo = heap[0];
 
-        uint32_t mm = (uint32_t) (fHeap[0] - frq);
-        pop_heap (&fHeap[0], &fHeap[nf]);
-        --nf;
+        heap[0] = heap[--nf];
+        hufHeapDown (heap, nf, 0);
 
-        uint32_t m = (uint32_t) (fHeap[0] - frq);
-        pop_heap (&fHeap[0], &fHeap[nf]);
+        uint64_t hi = heap[0];
+        uint32_t mm = (uint32_t) (lo & HUF_HEAPSYMMASK);
+        uint32_t m  = (uint32_t) (hi & HUF_HEAPSYMMASK);
 
-        frq[m] += frq[mm];
-        push_heap (&fHeap[0], &fHeap[nf]);
+        parent[node[mm]] = next;
+        parent[node[m]]  = next;
+        node[m]          = next++;
 
-        //
-        // The entries in scode are linked into lists with the
-        // entries in hlink serving as "next" pointers and with
-        // the end of a list marked by hlink[j] == j.
-        //
-        // Traverse the lists that start at scode[m] and scode[mm].
-        // For each element visited, increment the length of the
-        // corresponding code by one bit. (If we visit scode[j]
-        // during the traversal, then the code for symbol j becomes
-        // one bit longer.)
-        //
-        // Merge the lists that start at scode[m] and scode[mm]
-        // into a single list that starts at scode[m].
-        //
-
-        //
-        // Add a bit to all codes in the first list.
-        //
-
-        for (uint32_t j = m;; j = hlink[j])
-        {
-            scode[j]++;
-
-            if (hlink[j] == j)
-            {
-                //
-                // Merge the two lists.
-                //
+        heap[0] = (((lo >> HUF_HEAPSYMBITS) + (hi >> HUF_HEAPSYMBITS))
+                   << HUF_HEAPSYMBITS) |
+                  m;
+        hufHeapDown (heap, nf, 0);
+    }
 
-                hlink[j] = mm;
-                break;
-            }
-        }
+    //
+    // Inner nodes always come before their parent, so walking them
+    // back from the root turns parent[] into the depth of each inner
+    // node. A leaf is one deeper than its parent.
+    //
 
-        //
-        // Add a bit to all codes in the second list
-        //
+    parent[--next] = 0;
+    while (next-- > HUF_ENCSIZE)
+        parent[next] = parent[parent[next]] + 1;
 
-        for (uint32_t j = mm;; j = hlink[j])
+    for (uint32_t b = *im; b <= *iM; b += 8)
+    {
+        for (uint64_t m = hufUsedMask (frq, b, *iM); m; m &= m - 1)
         {
-            scode[j]++;
+            uint32_t i = b + hufCtz64 (m);
 
-            if (hlink[j] == j) break;
+            frq[i] = parent[parent[i]] + 1;
         }
     }
 
     //
     // Build a canonical Huffman code table, replacing the code
-    // lengths in scode with (code, code length) pairs.  Copy the
-    // code table from scode into frq.
+    // lengths in frq with (code, code length) pairs.
     //
 
-    hufCanonicalCodeTable (scode);
-    memcpy (frq, scode, sizeof (uint64_t) * HUF_ENCSIZE);
+    hufCanonicalCodeTable (frq, *im, *iM);
 }
 
 //
@@ -483,7 +509,8 @@ hufPackEncTable (
 }
 
 //
-// Unpack an encoding table packed by hufPackEncTable():
+// Unpack the code lengths of an encoding table packed by
+// hufPackEncTable():
 //
 
 static exr_result_t
@@ -492,51 +519,58 @@ hufUnpackEncTable (
     uint64_t        ni,    // i : input size (in bytes)
     uint32_t        im,    // i : min hcode index
     uint32_t        iM,    // i : max hcode index
-    uint64_t*       hcode)       //  o: encoding table [HUF_ENCSIZE]
+    uint8_t*        hlen)        //  o: code lengths [HUF_ENCSIZE]
 {
-    memset (hcode, 0, sizeof (uint64_t) * HUF_ENCSIZE);
-
     const uint8_t* p  = *pcode;
+    const uint8_t* pe = p + ni;
     uint64_t       c  = 0;
     uint32_t       lc = 0;
 
     for (; im <= iM; im++)
     {
-        if ((((uintptr_t) p) - ((uintptr_t) *pcode)) > ni)
-            return EXR_ERR_OUT_OF_MEMORY;
+        while (lc < 6)
+        {
+            if (p >= pe) return EXR_ERR_CORRUPT_CHUNK;
+            c = (c << 8) | (uint64_t) (*p++);
+            lc += 8;
+        }
 
-        uint64_t l = hcode[im] = getBits (6, &c, &lc, &p); // code length
+        lc -= 6;
+        uint32_t l = (uint32_t) (c >> lc) & 63; // code length
 
-        if (l == (uint64_t) LONG_ZEROCODE_RUN)
+        if (l == LONG_ZEROCODE_RUN)
         {
-            if ((((uintptr_t) p) - ((uintptr_t) *pcode)) > ni)
-                return EXR_ERR_OUT_OF_MEMORY;
+            if (lc < 8)
+            {
+                if (p >= pe) return EXR_ERR_CORRUPT_CHUNK;
+                c = (c << 8) | (uint64_t) (*p++);
+                lc += 8;
+            }
 
-            uint64_t zerun = getBits (8, &c, &lc, &p) + SHORTEST_LONG_RUN;
+            lc -= 8;
+            uint32_t zerun = ((uint32_t) (c >> lc) & 0xff) + SHORTEST_LONG_RUN;
 
             if (im + zerun > iM + 1) return EXR_ERR_CORRUPT_CHUNK;
 
-            while (zerun--)
-                hcode[im++] = 0;
-
-            im--;
+            memset (hlen + im, 0, zerun);
+            im += zerun - 1;
         }
-        else if (l >= (uint64_t) SHORT_ZEROCODE_RUN)
+        else if (l >= SHORT_ZEROCODE_RUN)
         {
-            uint64_t zerun = l - SHORT_ZEROCODE_RUN + 2;
+            uint32_t zerun = l - SHORT_ZEROCODE_RUN + 2;
 
             if (im + zerun > iM + 1) return EXR_ERR_CORRUPT_CHUNK;
 
-            while (zerun--)
-                hcode[im++] = 0;
-
-            im--;
+            memset (hlen + im, 0, zerun);
+            im += zerun - 1;
+        }
+        else
+        {
+            hlen[im] = (uint8_t) l;
         }
     }
 
     *pcode = p;
-
-    hufCanonicalCodeTable (hcode);
     return EXR_ERR_SUCCESS;
 }
 
@@ -545,129 +579,181 @@ hufUnpackEncTable (
 //
 
 //
-// Clear a newly allocated decoding table so that it contains only zeroes.
+// Build the decoding tables from the code lengths in hd->codeLen:
+//	- the canonical codes are recomputed the same way as in
+//	  hufCanonicalCodeTable();
+//	- codes up to HUF_LOOKUPBITS long fill every entry of the
+//	  lookup table they are a prefix of. Once all are in, entries
+//	  with room left are extended with the codes that follow, up to
+//	  HUF_LOOKUPSYMS symbols per entry;
+//	- longer codes are numbered in order of length and code, and
+//	  decoded by comparing the start of the input with the first
+//	  code of each length (see Moffat & Turpin, "On the
+//	  Implementation of Minimum Redundancy Prefix Codes").
 //
 
-static void
-hufClearDecTable (HufDec* hdecod)
-{
-    memset (hdecod, 0, sizeof (HufDec) * HUF_DECSIZE);
-}
-
 //
-// Build a decoding hash table based on the encoding table hcode:
-//	- short codes (<= HUF_DECBITS) are resolved with a single table access;
-//	- long code entry allocations are not optimized, because long codes are
-//	  unfrequent;
-//	- decoding tables are used by hufDecode();
+// Bit 8 * k + 7 is set for every non-zero length among hlen[i + k],
+// for the up to 8 of those that are in [i, iM]. Going through the
+// set bits avoids a hard to predict branch on every symbol.
 //
 
+static inline uint64_t
+hufCodeMask (const uint8_t* hlen, uint32_t i, uint32_t iM)
+{
+    uint64_t w = 0;
+
+    if (i + 8 <= iM + 1)
+    {
+        hlen += i;
+        w = ((uint64_t) (hlen[0])) | ((uint64_t) (hlen[1]) << 8) |
+            ((uint64_t) (hlen[2]) << 16) | ((uint64_t) (hlen[3]) << 24) |
+            ((uint64_t) (hlen[4]) << 32) | ((uint64_t) (hlen[5]) << 40) |
+            ((uint64_t) (hlen[6]) << 48) | ((uint64_t) (hlen[7]) << 56);
+    }
+    else
+    {
+        for (uint32_t k = 0; i + k <= iM; ++k)
+            w |= ((uint64_t) (hlen[i + k])) << (8 * k);
+    }
+
+    // lengths are below 0x80, adding 0x7f carries into the top
+    // bit of a byte exactly when it is not 0
+    return (w + 0x7f7f7f7f7f7f7f7fULL) & 0x8080808080808080ULL;
+}
+
 static exr_result_t
-hufBuildDecTable (
-    const uint64_t* hcode, uint32_t im, uint32_t iM, HufDec* hdecod)
+hufBuildDecTable (HufDec* hd, uint32_t im, uint32_t iM)
 {
-    //
-    // Init hashtable & loop on all codes.
-    // Assumes that hufClearDecTable(hdecod) has already been called.
-    //
+    const uint8_t* hlen = hd->codeLen;
+    uint64_t       n[HUF_MAXCODELEN + 1];
+    uint64_t       code[HUF_MAXCODELEN + 1];
+    uint64_t       c  = 0;
+    uint64_t       id = 0;
 
-    for (; im <= iM; im++)
+    for (int l = 0; l <= HUF_MAXCODELEN; ++l)
+        n[l] = 0;
+
+    for (uint32_t i = im; i <= iM; i += 8)
     {
-        uint64_t c = hufCode (hcode[im]);
-        int      l = hufLength (hcode[im]);
+        for (uint64_t m = hufCodeMask (hlen, i, iM); m; m &= m - 1)
+            n[hlen[i + (hufCtz64 (m) >> 3)]] += 1;
+    }
 
-        if (c >> l)
-        {
-            //
-            // Error: c is supposed to be an l-bit code,
-            // but c contains a value that is greater
-            // than the largest l-bit number.
-            //
+    for (int l = HUF_MAXCODELEN; l > 0; --l)
+    {
+        uint64_t nc = ((c + n[l]) >> 1);
+        code[l]     = c;
+        c           = nc;
+    }
 
-            return EXR_ERR_CORRUPT_CHUNK;
-        }
+    hd->longMax = 0;
+    hd->rleId   = UINT64_MAX;
+    for (int l = HUF_LOOKUPBITS + 1; l <= HUF_MAXCODELEN; ++l)
+    {
+        hd->longStart[l]  = code[l];
+        hd->longCount[l]  = n[l];
+        hd->longOffset[l] = id;
+        id += n[l];
 
-        if (l > HUF_DECBITS)
-        {
-            //
-            // Long code: add a secondary entry
-            //
+        if (n[l]) hd->longMax = l;
+    }
 
-            HufDec* pl = hdecod + (c >> (l - HUF_DECBITS));
+    memset (hd->table, 0, sizeof (hd->table));
 
-            if (pl->len)
+    for (uint32_t b = im; b <= iM; b += 8)
+    {
+        for (uint64_t m = hufCodeMask (hlen, b, iM); m; m &= m - 1)
+        {
+            uint32_t i  = b + (hufCtz64 (m) >> 3);
+            int      l  = hlen[i];
+            uint64_t cd = code[l]++;
+
+            if (cd >> l)
             {
                 //
-                // Error: a short code has already
-                // been stored in table entry *pl.
+                // Error: c is supposed to be an l-bit code,
+                // but c contains a value that is greater
+                // than the largest l-bit number.
                 //
 
                 return EXR_ERR_CORRUPT_CHUNK;
             }
 
-            pl->lit++;
-
-            if (pl->p)
+            if (l <= HUF_LOOKUPBITS)
             {
-                uint32_t* p = pl->p;
-                pl->p       = (uint32_t*) internal_exr_alloc (
-                    sizeof (uint32_t) * pl->lit);
+                HufDecEntry* e = hd->table + (cd << (HUF_LOOKUPBITS - l));
+
+                for (uint64_t j = (uint64_t) 1 << (HUF_LOOKUPBITS - l); j > 0;
+                     --j, ++e)
+                {
+                    //
+                    // Error: a short code or a long code has
+                    // already been stored in table entry *e.
+                    //
 
-                for (uint32_t i = 0; i < pl->lit - 1; ++i)
-                    pl->p[i] = p[i];
+                    if (e->count) return EXR_ERR_CORRUPT_CHUNK;
 
-                internal_exr_free (p);
+                    e->sym[0] = (uint16_t) i;
+                    e->len    = (uint8_t) l;
+                    e->count  = (i == iM) ? HUF_ENTRY_RLE : 1;
+                }
             }
             else
             {
-                pl->p = (uint32_t*) internal_exr_alloc (sizeof (uint32_t));
-            }
-
-            pl->p[pl->lit - 1] = im;
-        }
-        else if (l)
-        {
-            //
-            // Short code: init all primary entries
-            //
-
-            HufDec* pl = hdecod + (c << (HUF_DECBITS - l));
+                HufDecEntry* e = hd->table + (cd >> (l - HUF_LOOKUPBITS));
+                uint64_t     cid = hd->longOffset[l] + (cd - hd->longStart[l]);
 
-            for (uint64_t i = 1 << (HUF_DECBITS - l); i > 0; i--, pl++)
-            {
-                if (pl->len || pl->p)
-                {
-                    //
-                    // Error: a short code or a long code has
-                    // already been stored in table entry *pl.
-                    //
+                //
+                // Error: a short code has already
+                // been stored in table entry *e.
+                //
 
+                if (e->count && e->count != HUF_ENTRY_LONG)
                     return EXR_ERR_CORRUPT_CHUNK;
-                }
 
-                pl->len = (int32_t) l;
-                pl->lit = im;
+                // len is the shortest long code under this prefix,
+                // where the search for the code length starts
+                if (!e->count || l < e->len) e->len = (uint8_t) l;
+                e->count = HUF_ENTRY_LONG;
+
+                // the run-length symbol may be 65536, keep it by id
+                hd->idToSymbol[cid] = (uint16_t) i;
+                if (i == iM) hd->rleId = cid;
             }
         }
     }
-    return EXR_ERR_SUCCESS;
-}
 
-//
-// Free the long code entries of a decoding table built by hufBuildDecTable()
-//
+    //
+    // The entries are extended in place, only the first symbol of
+    // the ones that follow is used, and its length is in hlen
+    //
 
-static void
-hufFreeDecTable (HufDec* hdecod) // io: Decoding table
-{
-    for (int i = 0; i < HUF_DECSIZE; i++)
+    for (int i = 0; i < HUF_LOOKUPSIZE; ++i)
     {
-        if (hdecod[i].p)
+        HufDecEntry* e = hd->table + i;
+
+        if (e->count == 1)
         {
-            internal_exr_free (hdecod[i].p);
-            hdecod[i].p = NULL;
+            int len = e->len;
+
+            while (e->count < HUF_LOOKUPSYMS && len < HUF_LOOKUPBITS)
+            {
+                const HufDecEntry* s =
+                    hd->table + ((i << len) & HUF_LOOKUPMASK);
+
+                if (s->count - 1u >= (unsigned) HUF_LOOKUPSYMS ||
+                    len + hlen[s->sym[0]] > HUF_LOOKUPBITS)
+                    break;
+
+                e->sym[e->count++] = s->sym[0];
+                len += hlen[s->sym[0]];
+            }
+            e->len = (uint8_t) len;
         }
     }
+
+    return EXR_ERR_SUCCESS;
 }
 
 //
@@ -785,156 +871,290 @@ hufEncode (
 //
 
 //
-// In order to force the compiler to inline them,
-// getChar() and getCode() are implemented as macros
-// instead of "inline" functions.
+// The input is read 64 bits at a time, most significant bit first,
+// into a left-justified bit buffer. Past the end of the input, the
+// stream continues with zeroes, and the position of the reader tells
+// whether those were used.
+//
+
+typedef struct _HufBitReader
+{
+    const uint8_t* in;
+    uint64_t       size;  // input size (in bytes)
+    uint64_t       off;   // next byte to load
+    uint64_t       bits;  // next bits of the input, msb first
+    int            nbits; // number of valid bits in bits
+} HufBitReader;
+
+static inline uint64_t
+hufLoad64 (const uint8_t* in, uint64_t size, uint64_t off)
+{
+    uint64_t v = 0;
+
+    if (off + 8 <= size)
+    {
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) &&                            \
+    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+        memcpy (&v, in + off, sizeof (uint64_t));
+        return __builtin_bswap64 (v);
+#elif defined(_MSC_VER)
+        memcpy (&v, in + off, sizeof (uint64_t));
+        return _byteswap_uint64 (v);
+#else
+        in += off;
+        return ((uint64_t) (in[0]) << 56) | ((uint64_t) (in[1]) << 48) |
+               ((uint64_t) (in[2]) << 40) | ((uint64_t) (in[3]) << 32) |
+               ((uint64_t) (in[4]) << 24) | ((uint64_t) (in[5]) << 16) |
+               ((uint64_t) (in[6]) << 8) | ((uint64_t) (in[7]));
+#endif
+    }
+
+    for (int i = 0; i < 8 && off + (uint64_t) i < size; ++i)
+        v |= ((uint64_t) (in[off + (uint64_t) i])) << (56 - 8 * i);
+    return v;
+}
+
+//
+// Tops the buffer up to at least 56 valid bits. The bits below
+// those are also correct, which lets a long code use all 64.
 //
 
-#define getChar(c, lc, in)                                                     \
-    c = (c << 8) | (uint64_t) (*in++);                                         \
-    lc += 8
-
-#define getCode(po, rlc, c, lc, in, out, ob, oe)                               \
-    {                                                                          \
-        if (po == rlc)                                                         \
-        {                                                                      \
-            if (lc < 8) { getChar (c, lc, in); }                               \
-                                                                               \
-            lc -= 8;                                                           \
-                                                                               \
-            uint8_t cs = (uint8_t) (c >> lc);                                  \
-                                                                               \
-            if (out + cs > oe)                                                 \
-                return EXR_ERR_CORRUPT_CHUNK;                                  \
-            else if (out - 1 < ob)                                             \
-                return EXR_ERR_OUT_OF_MEMORY;                                  \
-                                                                               \
-            uint16_t s = out[-1];                                              \
-                                                                               \
-            while (cs-- > 0)                                                   \
-                *out++ = s;                                                    \
-        }                                                                      \
-        else if (out < oe)                                                     \
-        {                                                                      \
-            *out++ = (uint16_t) po;                                            \
-        }                                                                      \
-        else                                                                   \
-        {                                                                      \
-            return EXR_ERR_CORRUPT_CHUNK;                                      \
-        }                                                                      \
+static inline void
+hufRefill (HufBitReader* br)
+{
+    int nb = (63 - br->nbits) >> 3;
+
+    br->bits |= hufLoad64 (br->in, br->size, br->off) >> br->nbits;
+    br->off += (uint64_t) nb;
+    br->nbits += nb * 8;
+}
+
+static inline uint64_t
+hufBitPos (const HufBitReader* br)
+{
+    return br->off * 8 - (uint64_t) br->nbits;
+}
+
+static inline void
+hufSkipBits (HufBitReader* br, int nBits)
+{
+    if (nBits <= br->nbits)
+    {
+        br->bits <<= nBits;
+        br->nbits -= nBits;
+    }
+    else
+    {
+        uint64_t pos = hufBitPos (br) + (uint64_t) nBits;
+
+        br->off   = pos >> 3;
+        br->bits  = 0;
+        br->nbits = 0;
+        hufRefill (br);
+        br->bits <<= (pos & 7);
+        br->nbits -= (int) (pos & 7);
     }
+}
 
 //
-// Decode (uncompress) ni bits based on encoding & decoding tables:
+// Decode a long code or a run, which the lookup
+// table does not turn into symbols directly
 //
 
 static exr_result_t
-hufDecode (
-    const uint64_t* hcode,  // i : encoding table
-    const HufDec*   hdecod, // i : decoding table
-    const uint8_t*  in,     // i : compressed input buffer
-    uint64_t        ni,     // i : input size (in bits)
-    uint32_t        rlc,    // i : run-length code
-    uint64_t        no,     // i : expected output size (in bytes)
-    uint16_t*       out)
+hufDecodeSpecial (
+    const HufDec*      hd,
+    const HufDecEntry* e,
+    HufBitReader*      br,
+    const uint16_t*    ob,
+    uint16_t**         pout,
+    const uint16_t*    oe)
 {
-    uint64_t       c    = 0;
-    int            lc   = 0;
-    uint16_t*      outb = out;
-    uint16_t*      oe   = out + no;
-    const uint8_t* ie   = in + (ni + 7) / 8; // input byte size
+    uint16_t* out = *pout;
 
-    //
-    // Loop on input bytes
-    //
-
-    while (in < ie)
+    if (e->count == HUF_ENTRY_LONG)
     {
-        getChar (c, lc, in);
+        uint64_t w, cd, id;
+        int      l;
 
         //
-        // Access decoding table
+        // Search long code: the first length whose first code is at
+        // most the next l bits of the input. Codes shorter than the
+        // ones under the prefix of the input all sort after it.
         //
 
-        while (lc >= HUF_DECBITS)
+        hufRefill (br);
+        w = br->bits;
+
+        for (l = e->len; l <= hd->longMax; ++l)
         {
-            const HufDec pl = hdecod[(c >> (lc - HUF_DECBITS)) & HUF_DECMASK];
+            if (hd->longCount[l] && (w >> (64 - l)) >= hd->longStart[l])
+                break;
+        }
 
-            if (pl.len)
-            {
-                //
-                // Get short code
-                //
+        if (l > hd->longMax) return EXR_ERR_CORRUPT_CHUNK;
 
-                if (pl.len > lc) return EXR_ERR_CORRUPT_CHUNK;
+        cd = (w >> (64 - l)) - hd->longStart[l];
+        if (cd >= hd->longCount[l]) return EXR_ERR_CORRUPT_CHUNK;
 
-                lc -= pl.len;
-                getCode (pl.lit, rlc, c, lc, in, out, outb, oe)
-            }
-            else
-            {
-                uint32_t j;
+        hufSkipBits (br, l);
 
-                if (!pl.p) return EXR_ERR_CORRUPT_CHUNK; // wrong code
+        id = hd->longOffset[l] + cd;
+        if (id != hd->rleId)
+        {
+            if (out >= oe) return EXR_ERR_CORRUPT_CHUNK;
+            *out++ = hd->idToSymbol[id];
+            *pout  = out;
+            return EXR_ERR_SUCCESS;
+        }
+    }
+    else if (e->count == HUF_ENTRY_RLE) { hufSkipBits (br, e->len); }
+    else
+    {
+        // wrong code
+        return EXR_ERR_CORRUPT_CHUNK;
+    }
 
-                //
-                // Search long code
-                //
+    //
+    // Run-length code, the next 8 bits are the
+    // number of copies of the previous symbol
+    //
 
-                for (j = 0; j < pl.lit; j++)
-                {
-                    int l = hufLength (hcode[pl.p[j]]);
-
-                    while (lc < l && in < ie) // get more bits
-                    {
-                        getChar (c, lc, in);
-                    }
-
-                    if (lc >= l)
-                    {
-                        if (hufCode (hcode[pl.p[j]]) ==
-                            ((c >> (lc - l)) & (((uint64_t) (1) << l) - 1)))
-                        {
-                            //
-                            // Found : get long code
-                            //
-
-                            lc -= l;
-                            getCode (
-                                pl.p[j], rlc, c, lc, in, out, outb, oe) break;
-                        }
-                    }
-                }
+    if (br->nbits < 8) hufRefill (br);
+
+    uint8_t cs = (uint8_t) (br->bits >> 56);
+    hufSkipBits (br, 8);
+
+    if (out == ob || cs == 0 || cs > (uint64_t) (oe - out))
+        return EXR_ERR_CORRUPT_CHUNK;
+
+    uint16_t s = out[-1];
+
+    while (cs-- > 0)
+        *out++ = s;
+
+    *pout = out;
+    return EXR_ERR_SUCCESS;
+}
+
+//
+// Decode (uncompress) ni bits based on the decoding tables:
+//
+
+static exr_result_t
+hufDecode (
+    const HufDec*  hd,  // i : decoding tables
+    const uint8_t* in,  // i : compressed input buffer
+    uint64_t       ni,  // i : input size (in bits)
+    uint64_t       no,  // i : expected output size (in values)
+    uint16_t*      out) //  o: decompressed output buffer
+{
+    const HufDecEntry* table = hd->table;
+    uint16_t*          ob    = out;
+    uint16_t*          oe    = out + no;
+    HufBitReader       br;
+    exr_result_t       rv;
+
+    br.in    = in;
+    br.size  = (ni + 7) / 8;
+    br.off   = 0;
+    br.bits  = 0;
+    br.nbits = 0;
 
-                if (j == pl.lit) return EXR_ERR_CORRUPT_CHUNK;
+    //
+    // Every lookup may write HUF_LOOKUPSYMS values. While there is
+    // room for two lookups and 8 more bytes of input, top the bits
+    // up without a branch, and take all symbols of two entries
+    //
+
+    while (oe - out >= 2 * HUF_LOOKUPSYMS && br.off + 8 <= br.size)
+    {
+        const HufDecEntry* e;
+
+        br.bits |= hufLoad64 (in, br.size, br.off) >> br.nbits;
+        br.off += (uint64_t) ((63 - br.nbits) >> 3);
+        br.nbits |= 56;
+
+        e = table + (br.bits >> (64 - HUF_LOOKUPBITS));
+        if (e->count - 1u < (unsigned) HUF_LOOKUPSYMS)
+        {
+            out[0] = e->sym[0];
+            out[1] = e->sym[1];
+            out[2] = e->sym[2];
+            out += e->count;
+            br.bits <<= e->len;
+            br.nbits -= e->len;
+
+            e = table + (br.bits >> (64 - HUF_LOOKUPBITS));
+            if (e->count - 1u < (unsigned) HUF_LOOKUPSYMS)
+            {
+                out[0] = e->sym[0];
+                out[1] = e->sym[1];
+                out[2] = e->sym[2];
+                out += e->count;
+                br.bits <<= e->len;
+                br.nbits -= e->len;
+                continue;
             }
         }
+
+        rv = hufDecodeSpecial (hd, e, &br, ob, &out, oe);
+        if (rv != EXR_ERR_SUCCESS) return rv;
+    }
+
+    while (oe - out >= HUF_LOOKUPSYMS)
+    {
+        if (br.nbits < HUF_LOOKUPBITS + 8) hufRefill (&br);
+
+        const HufDecEntry* e = table + (br.bits >> (64 - HUF_LOOKUPBITS));
+
+        if (e->count - 1u < (unsigned) HUF_LOOKUPSYMS)
+        {
+            out[0] = e->sym[0];
+            out[1] = e->sym[1];
+            out[2] = e->sym[2];
+            out += e->count;
+            br.bits <<= e->len;
+            br.nbits -= e->len;
+        }
+        else
+        {
+            rv = hufDecodeSpecial (hd, e, &br, ob, &out, oe);
+            if (rv != EXR_ERR_SUCCESS) return rv;
+        }
     }
 
     //
-    // Get remaining (short) codes
+    // Get the last few values one at a time
     //
 
-    uint64_t i = (8 - ni) & 7;
-    c >>= i;
-    lc -= i;
-
-    while (lc > 0)
+    while (out < oe)
     {
-        const HufDec pl = hdecod[(c << (HUF_DECBITS - lc)) & HUF_DECMASK];
+        if (br.nbits < HUF_LOOKUPBITS + 8) hufRefill (&br);
 
-        if (pl.len)
+        const HufDecEntry* e = table + (br.bits >> (64 - HUF_LOOKUPBITS));
+
+        if (e->count - 1u < (unsigned) HUF_LOOKUPSYMS)
         {
-            if (pl.len > lc) return EXR_ERR_CORRUPT_CHUNK;
-            lc -= pl.len;
-            getCode (pl.lit, rlc, c, lc, in, out, outb, oe)
+            int len = hd->codeLen[e->sym[0]];
+
+            *out++ = e->sym[0];
+            br.bits <<= len;
+            br.nbits -= len;
         }
         else
-            return EXR_ERR_CORRUPT_CHUNK;
+        {
+            rv = hufDecodeSpecial (hd, e, &br, ob, &out, oe);
+            if (rv != EXR_ERR_SUCCESS) return rv;
+        }
     }
 
-    if ((((uintptr_t) out) - ((uintptr_t) outb)) != no)
-        return EXR_ERR_OUT_OF_MEMORY;
+    //
+    // The codes must use up the input exactly
+    //
+
+    if (hufBitPos (&br) != ni) return EXR_ERR_CORRUPT_CHUNK;
+
     return EXR_ERR_SUCCESS;
 }
 
@@ -969,22 +1189,23 @@ uint64_t
 internal_exr_huf_compress_spare_bytes (void)
 {
     uint64_t ret = 0;
-    ret += HUF_ENCSIZE * sizeof (uint64_t);  // freq
-    ret += HUF_ENCSIZE * sizeof (int);       // hlink
-    ret += HUF_ENCSIZE * sizeof (uint64_t*); // fheap
-    ret += HUF_ENCSIZE * sizeof (uint64_t);  // scode
+    ret += HUF_ENCSIZE * sizeof (uint64_t);     // freq
+    ret += HUF_ENCSIZE * sizeof (uint64_t);     // heap
+    ret += 2 * HUF_ENCSIZE * sizeof (uint32_t); // parent
+    ret += HUF_ENCSIZE * sizeof (uint32_t);     // node
     return ret;
 }
 
 uint64_t
 internal_exr_huf_decompress_spare_bytes (void)
 {
-    uint64_t ret = 0;
-    ret += HUF_ENCSIZE * sizeof (uint64_t); // freq
-    ret += HUF_DECSIZE * sizeof (HufDec);   // hdec
-    //    ret += HUF_ENCSIZE * sizeof (uint64_t*); // fheap
-    //    ret += HUF_ENCSIZE * sizeof (uint64_t);  // scode
-    return ret;
+    return sizeof (HufDec);
+}
+
+void
+internal_exr_huf_invalidate_decode_tables (void* spare, uint64_t sparebytes)
+{
+    if (spare && sparebytes >= sizeof (HufDec)) ((HufDec*) spare)->magic = 0;
 }
 
 exr_result_t
@@ -997,17 +1218,17 @@ internal_huf_compress (
     void*           spare,
     uint64_t        sparebytes)
 {
-    uint64_t*  freq;
-    uint32_t*  hlink;
-    uint64_t** fHeap;
-    uint64_t*  scode;
-    uint32_t   im = 0;
-    uint32_t   iM = 0;
-    uint32_t   tableLength, nBits, dataLength;
-    uint8_t*   dataStart;
-    uint8_t*   compressed = (uint8_t*) out;
-    uint8_t*   tableStart = compressed + 20;
-    uint8_t*   tableEnd   = tableStart;
+    uint64_t* freq;
+    uint64_t* heap;
+    uint32_t* parent;
+    uint32_t* node;
+    uint32_t  im = 0;
+    uint32_t  iM = 0;
+    uint32_t  tableLength, nBits, dataLength;
+    uint8_t*  dataStart;
+    uint8_t*  compressed = (uint8_t*) out;
+    uint8_t*  tableStart = compressed + 20;
+    uint8_t*  tableEnd   = tableStart;
 
     if (nRaw == 0)
     {
@@ -1019,14 +1240,18 @@ internal_huf_compress (
     if (sparebytes != internal_exr_huf_compress_spare_bytes ())
         return EXR_ERR_INVALID_ARGUMENT;
 
-    freq  = (uint64_t*) spare;
-    scode = freq + HUF_ENCSIZE;
-    fHeap = (uint64_t**) (scode + HUF_ENCSIZE);
-    hlink = (uint32_t*) (fHeap + HUF_ENCSIZE);
+    // frequencies share a heap entry with the symbol
+    if (nRaw >= ((uint64_t) 1 << (63 - HUF_HEAPSYMBITS)))
+        return EXR_ERR_INVALID_ARGUMENT;
+
+    freq   = (uint64_t*) spare;
+    heap   = freq + HUF_ENCSIZE;
+    parent = (uint32_t*) (heap + HUF_ENCSIZE);
+    node   = parent + 2 * HUF_ENCSIZE;
 
     countFrequencies (freq, raw, nRaw);
 
-    hufBuildEncTable (freq, &im, &iM, hlink, fHeap, scode);
+    hufBuildEncTable (freq, &im, &iM, node, heap, parent);
 
     hufPackEncTable (freq, im, iM, &tableEnd);
 
@@ -1059,8 +1284,9 @@ internal_huf_decompress (
     uint64_t       sparebytes)
 {
     uint32_t       im, iM, nBits;
-    uint64_t       nBytes;
+    uint64_t       nBytes, nLeft;
     const uint8_t* ptr;
+    HufDec*        hdec;
     exr_result_t   rv;
 
     //
@@ -1081,48 +1307,49 @@ internal_huf_decompress (
     nBits = readUInt (compressed + 12);
     // uint32_t future = readUInt (compressed + 16);
 
-    if (im >= HUF_ENCSIZE || iM >= HUF_ENCSIZE) return EXR_ERR_CORRUPT_CHUNK;
-
-    ptr = compressed + 20;
+    if (im >= HUF_ENCSIZE || iM >= HUF_ENCSIZE || im > iM)
+        return EXR_ERR_CORRUPT_CHUNK;
 
-    nBytes = (((uint64_t) (nBits) + 7)) / 8;
-    if (ptr + nBytes > compressed + nCompressed) return EXR_ERR_OUT_OF_MEMORY;
+    ptr   = compressed + 20;
+    nLeft = nCompressed - 20;
+    hdec  = (HufDec*) spare;
 
     //
-    // Fast decoder needs at least 2x64-bits of compressed data, and
-    // needs to be run-able on this platform. Otherwise, fall back
-    // to the original decoder
+    // Reuse the decoding tables of the previous call
+    // when the packed table is the same
     //
-#if 0
-    if (FastHufDecoder::enabled () && nBits > 128)
-    {
-        FastHufDecoder fhd (ptr, nCompressed - (ptr - compressed), im, iM, iM);
 
-        // must be nBytes remaining in buffer
-        if (ptr - compressed + nBytes > static_cast<uint64_t> (nCompressed))
-        {
-            notEnoughData ();
-            return;
-        }
-
-        rv = fhd.decode (ptr, nBits, raw, nRaw);
+    if (hdec->magic == HUF_DECMAGIC && hdec->im == im && hdec->iM == iM &&
+        hdec->tableBytes <= nLeft &&
+        0 == memcmp (hdec->packedTable, ptr, hdec->tableBytes))
+    {
+        ptr += hdec->tableBytes;
     }
     else
-#endif
     {
-        uint64_t* freq  = (uint64_t*) spare;
-        HufDec*   hdec  = (HufDec*) (freq + HUF_ENCSIZE);
-        uint64_t  nLeft = nCompressed - 20;
+        const uint8_t* tableStart = ptr;
 
-        hufClearDecTable (hdec);
-        hufUnpackEncTable (&ptr, nLeft, im, iM, freq);
+        hdec->magic = 0;
 
-        if (nBits > 8 * nLeft) return EXR_ERR_CORRUPT_CHUNK;
+        rv = hufUnpackEncTable (&ptr, nLeft, im, iM, hdec->codeLen);
+        if (rv != EXR_ERR_SUCCESS) return rv;
 
-        rv = hufBuildDecTable (freq, im, iM, hdec);
-        hufDecode (freq, hdec, ptr, nBits, iM, nRaw, raw);
+        rv = hufBuildDecTable (hdec, im, iM);
+        if (rv != EXR_ERR_SUCCESS) return rv;
 
-        hufFreeDecTable (hdec);
+        hdec->im         = im;
+        hdec->iM         = iM;
+        hdec->tableBytes = (uint64_t) (ptr - tableStart);
+        if (hdec->tableBytes <= HUF_MAXTABLEBYTES)
+        {
+            memcpy (hdec->packedTable, tableStart, hdec->tableBytes);
+            hdec->magic = HUF_DECMAGIC;
+        }
     }
-    return rv;
+
+    nLeft  = nCompressed - (uint64_t) (ptr - compressed);
+    nBytes = (((uint64_t) (nBits) + 7)) / 8;
+    if (nBytes > nLeft) return EXR_ERR_CORRUPT_CHUNK;
+
+    return hufDecode (hdec, ptr, nBits, nRaw, raw);
 }
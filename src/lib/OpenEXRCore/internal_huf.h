@@ -11,6 +11,15 @@
 uint64_t internal_exr_huf_compress_spare_bytes (void);
 uint64_t internal_exr_huf_decompress_spare_bytes (void);
 
+/*
+ * internal_huf_decompress keeps its decoding tables in the spare
+ * buffer, and reuses them when the next chunk has the same code
+ * table. Call this when the spare buffer is new, or its contents may
+ * have been changed by anything else.
+ */
+void internal_exr_huf_invalidate_decode_tables (
+    void* spare, uint64_t sparebytes);
+
 exr_result_t internal_huf_compress (
     uint64_t*       encbytes,
     void*           out,
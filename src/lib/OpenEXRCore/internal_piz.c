@@ -7,6 +7,7 @@
 #include "internal_decompress.h"
 
 #include "internal_coding.h"
+#include "internal_cpuid.h"
 #include "internal_huf.h"
 #include "internal_xdr.h"
 
@@ -168,13 +169,393 @@ wdec16 (uint16_t l, uint16_t h, uint16_t* a, uint16_t* b)
 
 /**************************************/
 
+//
+// One level of the transform on a 2x2 block, whose top left value is
+// at t[0] and bottom left value at b[0], with the right column s
+// values further along the rows.
+//
+
+static inline void
+wenc_2x2 (uint16_t* t, uint16_t* b, int s, int w14)
+{
+    uint16_t i00, i01, i10, i11;
+
+    if (w14)
+    {
+        wenc14 (t[0], t[s], &i00, &i01);
+        wenc14 (b[0], b[s], &i10, &i11);
+        wenc14 (i00, i10, t, b);
+        wenc14 (i01, i11, t + s, b + s);
+    }
+    else
+    {
+        wenc16 (t[0], t[s], &i00, &i01);
+        wenc16 (b[0], b[s], &i10, &i11);
+        wenc16 (i00, i10, t, b);
+        wenc16 (i01, i11, t + s, b + s);
+    }
+}
+
+static inline void
+wdec_2x2 (uint16_t* t, uint16_t* b, int s, int w14)
+{
+    uint16_t i00, i01, i10, i11;
+
+    if (w14)
+    {
+        wdec14 (t[0], b[0], &i00, &i10);
+        wdec14 (t[s], b[s], &i01, &i11);
+        wdec14 (i00, i01, t, t + s);
+        wdec14 (i10, i11, b, b + s);
+    }
+    else
+    {
+        wdec16 (t[0], b[0], &i00, &i10);
+        wdec16 (t[s], b[s], &i01, &i11);
+        wdec16 (i00, i01, t, t + s);
+        wdec16 (i10, i11, b, b + s);
+    }
+}
+
+#if defined(IMF_HAVE_SSE2) || defined(IMF_HAVE_NEON)
+#    define EXR_WAV_SIMD 1
+
+//
+// SIMD versions of the basis functions, on 8 values at a time, giving
+// the same results as the scalar ones (see ImfWav.cpp). When the
+// blocks of a row are at most 2 values apart, 16 values of a row are
+// split into a vector of the left and one of the right columns of the
+// blocks. With s == 2 the values in between the blocks are put back
+// unchanged.
+//
+
+#    if defined(IMF_HAVE_SSE2)
+
+typedef __m128i wav_vec_t;
+
+static inline void
+wenc14_v (wav_vec_t a, wav_vec_t b, wav_vec_t* l, wav_vec_t* h)
+{
+    wav_vec_t one = _mm_set1_epi16 (1);
+
+    *l = _mm_add_epi16 (
+        _mm_add_epi16 (_mm_srai_epi16 (a, 1), _mm_srai_epi16 (b, 1)),
+        _mm_and_si128 (_mm_and_si128 (a, b), one));
+    *h = _mm_sub_epi16 (a, b);
+}
+
+static inline void
+wdec14_v (wav_vec_t l, wav_vec_t h, wav_vec_t* a, wav_vec_t* b)
+{
+    wav_vec_t one = _mm_set1_epi16 (1);
+    wav_vec_t ai  = _mm_add_epi16 (
+        _mm_add_epi16 (l, _mm_and_si128 (h, one)), _mm_srai_epi16 (h, 1));
+
+    *a = ai;
+    *b = _mm_sub_epi16 (ai, h);
+}
+
+static inline void
+wenc16_v (wav_vec_t a, wav_vec_t b, wav_vec_t* l, wav_vec_t* h)
+{
+    wav_vec_t one  = _mm_set1_epi16 (1);
+    wav_vec_t sign = _mm_set1_epi16 ((short) 0x8000);
+    wav_vec_t ao   = _mm_xor_si128 (a, sign);
+    wav_vec_t m    = _mm_add_epi16 (
+        _mm_add_epi16 (_mm_srli_epi16 (ao, 1), _mm_srli_epi16 (b, 1)),
+        _mm_and_si128 (_mm_and_si128 (ao, b), one));
+    /* ao < b as unsigned values */
+    wav_vec_t neg = _mm_cmplt_epi16 (a, _mm_xor_si128 (b, sign));
+
+    *l = _mm_xor_si128 (m, _mm_and_si128 (neg, sign));
+    *h = _mm_sub_epi16 (ao, b);
+}
+
+static inline void
+wdec16_v (wav_vec_t m, wav_vec_t d, wav_vec_t* a, wav_vec_t* b)
+{
+    wav_vec_t bb = _mm_sub_epi16 (m, _mm_srli_epi16 (d, 1));
+
+    *a = _mm_xor_si128 (
+        _mm_add_epi16 (d, bb), _mm_set1_epi16 ((short) 0x8000));
+    *b = bb;
+}
+
+static inline void
+wav_split (const uint16_t* p, int s, wav_vec_t* l, wav_vec_t* r)
+{
+    wav_vec_t v0 = _mm_loadu_si128 ((const __m128i*) p);
+    wav_vec_t v1 = _mm_loadu_si128 ((const __m128i*) (p + 8));
+
+    if (s == 1)
+    {
+        *l = _mm_packs_epi32 (
+            _mm_srai_epi32 (_mm_slli_epi32 (v0, 16), 16),
+            _mm_srai_epi32 (_mm_slli_epi32 (v1, 16), 16));
+        *r = _mm_packs_epi32 (_mm_srai_epi32 (v0, 16), _mm_srai_epi32 (v1, 16));
+    }
+    else
+    {
+        v0 = _mm_shuffle_epi32 (v0, _MM_SHUFFLE (3, 1, 2, 0));
+        v1 = _mm_shuffle_epi32 (v1, _MM_SHUFFLE (3, 1, 2, 0));
+        *l = _mm_unpacklo_epi64 (v0, v1);
+        *r = _mm_unpackhi_epi64 (v0, v1);
+    }
+}
+
+static inline void
+wav_merge (uint16_t* p, int s, wav_vec_t l, wav_vec_t r)
+{
+    wav_vec_t v0, v1;
+
+    if (s == 1)
+    {
+        v0 = _mm_unpacklo_epi16 (l, r);
+        v1 = _mm_unpackhi_epi16 (l, r);
+    }
+    else
+    {
+        wav_vec_t lo = _mm_set1_epi32 (0xffff);
+
+        v0 = _mm_or_si128 (
+            _mm_and_si128 (_mm_unpacklo_epi32 (l, r), lo),
+            _mm_andnot_si128 (lo, _mm_loadu_si128 ((const __m128i*) p)));
+        v1 = _mm_or_si128 (
+            _mm_and_si128 (_mm_unpackhi_epi32 (l, r), lo),
+            _mm_andnot_si128 (lo, _mm_loadu_si128 ((const __m128i*) (p + 8))));
+    }
+
+    _mm_storeu_si128 ((__m128i*) p, v0);
+    _mm_storeu_si128 ((__m128i*) (p + 8), v1);
+}
+
+#    else /* IMF_HAVE_NEON */
+
+typedef uint16x8_t wav_vec_t;
+
+static inline void
+wenc14_v (wav_vec_t a, wav_vec_t b, wav_vec_t* l, wav_vec_t* h)
+{
+    *l = vreinterpretq_u16_s16 (
+        vhaddq_s16 (vreinterpretq_s16_u16 (a), vreinterpretq_s16_u16 (b)));
+    *h = vsubq_u16 (a, b);
+}
+
+static inline void
+wdec14_v (wav_vec_t l, wav_vec_t h, wav_vec_t* a, wav_vec_t* b)
+{
+    wav_vec_t hh =
+        vreinterpretq_u16_s16 (vshrq_n_s16 (vreinterpretq_s16_u16 (h), 1));
+    wav_vec_t ai = vaddq_u16 (vaddq_u16 (l, vandq_u16 (h, vdupq_n_u16 (1))), hh);
+
+    *a = ai;
+    *b = vsubq_u16 (ai, h);
+}
+
+static inline void
+wenc16_v (wav_vec_t a, wav_vec_t b, wav_vec_t* l, wav_vec_t* h)
+{
+    wav_vec_t sign = vdupq_n_u16 (0x8000);
+    wav_vec_t ao   = veorq_u16 (a, sign);
+    wav_vec_t m    = vhaddq_u16 (ao, b);
+
+    *l = veorq_u16 (m, vandq_u16 (vcltq_u16 (ao, b), sign));
+    *h = vsubq_u16 (ao, b);
+}
+
+static inline void
+wdec16_v (wav_vec_t m, wav_vec_t d, wav_vec_t* a, wav_vec_t* b)
+{
+    wav_vec_t bb = vsubq_u16 (m, vshrq_n_u16 (d, 1));
+
+    *a = veorq_u16 (vaddq_u16 (d, bb), vdupq_n_u16 (0x8000));
+    *b = bb;
+}
+
+static inline void
+wav_split (const uint16_t* p, int s, wav_vec_t* l, wav_vec_t* r)
+{
+    wav_vec_t v0 = vld1q_u16 (p);
+    wav_vec_t v1 = vld1q_u16 (p + 8);
+
+    if (s == 1)
+    {
+        uint16x8x2_t u = vuzpq_u16 (v0, v1);
+        *l             = u.val[0];
+        *r             = u.val[1];
+    }
+    else
+    {
+        uint32x4x2_t u =
+            vuzpq_u32 (vreinterpretq_u32_u16 (v0), vreinterpretq_u32_u16 (v1));
+        *l = vreinterpretq_u16_u32 (u.val[0]);
+        *r = vreinterpretq_u16_u32 (u.val[1]);
+    }
+}
+
+static inline void
+wav_merge (uint16_t* p, int s, wav_vec_t l, wav_vec_t r)
+{
+    wav_vec_t v0, v1;
+
+    if (s == 1)
+    {
+        uint16x8x2_t z = vzipq_u16 (l, r);
+        v0             = z.val[0];
+        v1             = z.val[1];
+    }
+    else
+    {
+        uint32x4x2_t z =
+            vzipq_u32 (vreinterpretq_u32_u16 (l), vreinterpretq_u32_u16 (r));
+        wav_vec_t lo = vreinterpretq_u16_u32 (vdupq_n_u32 (0xffff));
+
+        v0 = vbslq_u16 (lo, vreinterpretq_u16_u32 (z.val[0]), vld1q_u16 (p));
+        v1 = vbslq_u16 (
+            lo, vreinterpretq_u16_u32 (z.val[1]), vld1q_u16 (p + 8));
+    }
+
+    vst1q_u16 (p, v0);
+    vst1q_u16 (p + 8, v1);
+}
+
+#    endif
+
+//
+// Number of blocks at the start of the rows the SIMD code can do:
+// the 16 values it loads from a row must not go past the right value
+// of the last block, which is one short of the end of the blocks
+// when s == 2.
+//
+
+static inline int
+wav_simd_blocks (int s, int nb)
+{
+    if (s > 2) return 0;
+
+    return ((2 * s * nb - s + 1) / 16) * (8 / s);
+}
+
+static int
+wenc_rows_simd (uint16_t* t, uint16_t* b, int s, int nb, int w14)
+{
+    int n = wav_simd_blocks (s, nb);
+
+    for (int k = 0; k < n; k += 8 / s)
+    {
+        uint16_t* tk = t + 2 * s * k;
+        uint16_t* bk = b + 2 * s * k;
+        wav_vec_t t0, t1, b0, b1, i00, i01, i10, i11;
+
+        wav_split (tk, s, &t0, &t1);
+        wav_split (bk, s, &b0, &b1);
+
+        if (w14)
+        {
+            wenc14_v (t0, t1, &i00, &i01);
+            wenc14_v (b0, b1, &i10, &i11);
+            wenc14_v (i00, i10, &t0, &b0);
+            wenc14_v (i01, i11, &t1, &b1);
+        }
+        else
+        {
+            wenc16_v (t0, t1, &i00, &i01);
+            wenc16_v (b0, b1, &i10, &i11);
+            wenc16_v (i00, i10, &t0, &b0);
+            wenc16_v (i01, i11, &t1, &b1);
+        }
+
+        wav_merge (tk, s, t0, t1);
+        wav_merge (bk, s, b0, b1);
+    }
+
+    return n;
+}
+
+static int
+wdec_rows_simd (uint16_t* t, uint16_t* b, int s, int nb, int w14)
+{
+    int n = wav_simd_blocks (s, nb);
+
+    for (int k = 0; k < n; k += 8 / s)
+    {
+        uint16_t* tk = t + 2 * s * k;
+        uint16_t* bk = b + 2 * s * k;
+        wav_vec_t t0, t1, b0, b1, i00, i01, i10, i11;
+
+        wav_split (tk, s, &t0, &t1);
+        wav_split (bk, s, &b0, &b1);
+
+        if (w14)
+        {
+            wdec14_v (t0, b0, &i00, &i10);
+            wdec14_v (t1, b1, &i01, &i11);
+            wdec14_v (i00, i01, &t0, &t1);
+            wdec14_v (i10, i11, &b0, &b1);
+        }
+        else
+        {
+            wdec16_v (t0, b0, &i00, &i10);
+            wdec16_v (t1, b1, &i01, &i11);
+            wdec16_v (i00, i01, &t0, &t1);
+            wdec16_v (i10, i11, &b0, &b1);
+        }
+
+        wav_merge (tk, s, t0, t1);
+        wav_merge (bk, s, b0, b1);
+    }
+
+    return n;
+}
+
+#endif /* IMF_HAVE_SSE2 || IMF_HAVE_NEON */
+
+//
+// One level of the transform on the nb blocks of a pair of rows.
+// The SIMD code needs the rows not to overlap, and the blocks to be
+// at most 2 values apart.
+//
+
+static inline void
+wenc_rows (uint16_t* t, uint16_t* b, int s, int nb, int w14, int simd)
+{
+    int k = 0;
+
+#ifdef EXR_WAV_SIMD
+    if (simd) k = wenc_rows_simd (t, b, s, nb, w14);
+#else
+    (void) simd;
+#endif
+
+    for (; k < nb; ++k)
+        wenc_2x2 (t + 2 * s * k, b + 2 * s * k, s, w14);
+}
+
+static inline void
+wdec_rows (uint16_t* t, uint16_t* b, int s, int nb, int w14, int simd)
+{
+    int k = 0;
+
+#ifdef EXR_WAV_SIMD
+    if (simd) k = wdec_rows_simd (t, b, s, nb, w14);
+#else
+    (void) simd;
+#endif
+
+    for (; k < nb; ++k)
+        wdec_2x2 (t + 2 * s * k, b + 2 * s * k, s, w14);
+}
+
+/**************************************/
+
 static void
 wav_2D_encode (uint16_t* in, int nx, int ox, int ny, int oy, uint16_t mx)
 {
-    int w14 = (mx < (1 << 14)) ? 1 : 0;
-    int n   = (nx > ny) ? ny : nx;
-    int p   = 1; // == 1 <<  level
-    int p2  = 2; // == 1 << (level+1)
+    int w14  = (mx < (1 << 14)) ? 1 : 0;
+    int simd = (ox == 1 || ox == 2) && oy >= nx * ox;
+    int n    = (nx > ny) ? ny : nx;
+    int p    = 1; // == 1 <<  level
+    int p2   = 2; // == 1 << (level+1)
 
     //
     // Hierachical loop on smaller dimension n
@@ -188,7 +569,7 @@ wav_2D_encode (uint16_t* in, int nx, int ox, int ny, int oy, uint16_t mx)
         int       oy2 = oy * p2;
         int       ox1 = ox * p;
         int       ox2 = ox * p2;
-        uint16_t  i00, i01, i10, i11;
+        int       nb  = nx / p2;
 
         //
         // Y loop
@@ -197,37 +578,13 @@ wav_2D_encode (uint16_t* in, int nx, int ox, int ny, int oy, uint16_t mx)
         for (; py <= ey; py += oy2)
         {
             uint16_t* px = py;
-            uint16_t* ex = py + ox * (nx - p2);
 
             //
-            // X loop
+            // X loop, all the blocks of this pair of rows
             //
 
-            for (; px <= ex; px += ox2)
-            {
-                uint16_t* p01 = px + ox1;
-                uint16_t* p10 = px + oy1;
-                uint16_t* p11 = p10 + ox1;
-
-                //
-                // 2D wavelet encoding
-                //
-
-                if (w14)
-                {
-                    wenc14 (*px, *p01, &i00, &i01);
-                    wenc14 (*p10, *p11, &i10, &i11);
-                    wenc14 (i00, i10, px, p10);
-                    wenc14 (i01, i11, p01, p11);
-                }
-                else
-                {
-                    wenc16 (*px, *p01, &i00, &i01);
-                    wenc16 (*p10, *p11, &i10, &i11);
-                    wenc16 (i00, i10, px, p10);
-                    wenc16 (i01, i11, p01, p11);
-                }
-            }
+            wenc_rows (px, px + oy1, ox1, nb, w14, simd);
+            px += ox2 * nb;
 
             //
             // Encode (1D) odd column (still in Y loop)
@@ -284,9 +641,10 @@ wav_2D_decode (
     int       oy, // i : y offset
     uint16_t  mx)  // i : maximum in[x][y] value
 {
-    int w14 = (mx < (1 << 14)) ? 1 : 0;
-    int n   = (nx > ny) ? ny : nx;
-    int p   = 1;
+    int w14  = (mx < (1 << 14)) ? 1 : 0;
+    int simd = (ox == 1 || ox == 2) && oy >= nx * ox;
+    int n    = (nx > ny) ? ny : nx;
+    int p    = 1;
     int p2;
 
     //
@@ -312,7 +670,8 @@ wav_2D_decode (
         int       oy2 = oy * p2;
         int       ox1 = ox * p;
         int       ox2 = ox * p2;
-        uint16_t  i00, i01, i10, i11;
+        int       nb  = nx / p2;
+        uint16_t  i00;
 
         //
         // Y loop
@@ -321,37 +680,13 @@ wav_2D_decode (
         for (; py <= ey; py += oy2)
         {
             uint16_t* px = py;
-            uint16_t* ex = py + ox * (nx - p2);
 
             //
-            // X loop
+            // X loop, all the blocks of this pair of rows
             //
 
-            for (; px <= ex; px += ox2)
-            {
-                uint16_t* p01 = px + ox1;
-                uint16_t* p10 = px + oy1;
-                uint16_t* p11 = p10 + ox1;
-
-                //
-                // 2D wavelet decoding
-                //
-
-                if (w14)
-                {
-                    wdec14 (*px, *p10, &i00, &i10);
-                    wdec14 (*p01, *p11, &i01, &i11);
-                    wdec14 (i00, i01, px, p01);
-                    wdec14 (i10, i11, p10, p11);
-                }
-                else
-                {
-                    wdec16 (*px, *p10, &i00, &i10);
-                    wdec16 (*p01, *p11, &i01, &i11);
-                    wdec16 (i00, i01, px, p01);
-                    wdec16 (i10, i11, p10, p11);
-                }
-            }
+            wdec_rows (px, px + oy1, ox1, nb, w14, simd);
+            px += ox2 * nb;
 
             //
             // Decode (1D) odd column (still in Y loop)
@@ -563,6 +898,8 @@ internal_exr_undo_piz (
     uint8_t*       bitmap;
     uint16_t*      lut;
     uint8_t*       hufspare;
+    void*          prevspare;
+    size_t         prevsparesz;
     size_t         hufSpareBytes = internal_exr_huf_decompress_spare_bytes ();
     uint16_t       minNonZero, maxNonZero, maxValue;
     uint16_t*      wavbuf;
@@ -576,7 +913,9 @@ internal_exr_undo_piz (
         outsz);
     if (rv != EXR_ERR_SUCCESS) return rv;
 
-    rv = internal_decode_alloc_buffer (
+    prevspare   = decode->scratch_buffer_2;
+    prevsparesz = decode->scratch_alloc_size_2;
+    rv          = internal_decode_alloc_buffer (
         decode,
         EXR_TRANSCODE_BUFFER_SCRATCH2,
         &(decode->scratch_buffer_2),
@@ -586,6 +925,10 @@ internal_exr_undo_piz (
     if (rv != EXR_ERR_SUCCESS) return rv;
 
     hufspare = decode->scratch_buffer_2;
+    /* the huffman tables of the last chunk are only there if the
+     * buffer is the one this pipeline used before */
+    if (hufspare != prevspare || decode->scratch_alloc_size_2 != prevsparesz)
+        internal_exr_huf_invalidate_decode_tables (hufspare, hufSpareBytes);
     lut      = (uint16_t*) (hufspare + hufSpareBytes);
     bitmap   = (uint8_t*) (lut + USHORT_RANGE);
 
@@ -5,10 +5,12 @@
 
 /* implementation for unix-like file io routines (used in context.c) */
 #include <IlmThreadConfig.h>
+#include <OpenEXRConfigInternal.h>
 
 #include <errno.h>
 
 #include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -16,6 +18,9 @@
 #ifdef ILMTHREAD_THREADING_ENABLED
 #    include <pthread.h>
 #endif
+#ifdef OPENEXR_IMF_HAVE_POSIX_AIO
+#    include <aio.h>
+#endif
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,12 +36,16 @@
 #if CAN_USE_PREAD
 struct _internal_exr_filehandle
 {
-    int fd;
+    int      fd;
+    void*    map;
+    uint64_t map_size;
 };
 #else
 struct _internal_exr_filehandle
 {
     int             fd;
+    void*           map;
+    uint64_t        map_size;
 #    ifdef ILMTHREAD_THREADING_ENABLED
     pthread_mutex_t mutex;
 #    endif
@@ -52,6 +61,7 @@ default_shutdown (exr_const_context_t c, void* userdata, int failed)
     struct _internal_exr_filehandle* fh = userdata;
     if (fh)
     {
+        if (fh->map) munmap (fh->map, (size_t) fh->map_size);
         if (fh->fd >= 0) close (fh->fd);
 #if !CAN_USE_PREAD
 #    ifdef ILMTHREAD_THREADING_ENABLED
@@ -209,6 +219,296 @@ default_read_func (
 
 /**************************************/
 
+static int64_t
+mmap_read_func (
+    exr_const_context_t         ctxt,
+    void*                       userdata,
+    void*                       buffer,
+    uint64_t                    sz,
+    uint64_t                    offset,
+    exr_stream_error_func_ptr_t error_cb)
+{
+    struct _internal_exr_filehandle* fh = userdata;
+    uint64_t                         avail;
+
+    if (!fh || !fh->map)
+    {
+        if (error_cb)
+            error_cb (
+                ctxt, EXR_ERR_INVALID_ARGUMENT, "Invalid file mapping pointer");
+        return -1;
+    }
+
+    /* match the short read semantic of read at end of file */
+    if (offset >= fh->map_size) return 0;
+
+    avail = fh->map_size - offset;
+    if (sz > avail) sz = avail;
+
+    memcpy (buffer, ((const uint8_t*) fh->map) + offset, (size_t) sz);
+    return (int64_t) sz;
+}
+
+/**************************************/
+
+static void
+mmap_advise_func (
+    const struct _internal_exr_context* file,
+    uint64_t                            offset,
+    uint64_t                            size,
+    enum _INTERNAL_EXR_ACCESS_HINT      hint)
+{
+#if defined(POSIX_MADV_SEQUENTIAL) && defined(POSIX_MADV_RANDOM)
+    static uint64_t pagesize = 0;
+    uint64_t        start, end;
+
+    if (!file->mapped_data || offset >= file->mapped_size) return;
+
+    if (pagesize == 0)
+    {
+        long ps  = sysconf (_SC_PAGESIZE);
+        pagesize = (ps > 0) ? (uint64_t) ps : 4096;
+    }
+
+    /* advice must start on a page boundary */
+    start = offset - (offset % pagesize);
+    end   = (size > file->mapped_size - offset) ? file->mapped_size
+                                                : offset + size;
+
+    posix_madvise (
+        EXR_CONST_CAST (void*, file->mapped_data + start),
+        (size_t) (end - start),
+        (hint == EXR_ACCESS_SEQUENTIAL) ? POSIX_MADV_SEQUENTIAL
+                                        : POSIX_MADV_RANDOM);
+#else
+    (void) file;
+    (void) offset;
+    (void) size;
+    (void) hint;
+#endif
+}
+
+/**************************************/
+
+static void
+default_try_mmap_file (struct _internal_exr_context* file)
+{
+    struct _internal_exr_filehandle* fh = file->user_data;
+    struct stat                      sbuf;
+    void*                            map;
+
+    if (fstat (fh->fd, &sbuf) != 0 || sbuf.st_size <= 0) return;
+    if (sizeof (size_t) < sizeof (uint64_t) &&
+        (uint64_t) sbuf.st_size >= (uint64_t) SIZE_MAX)
+        return;
+
+    /* a private writable mapping allows the decode pipeline to hand the
+     * mapped data to routines which may modify the packed buffer
+     * in place without affecting the file */
+    map = mmap (
+        NULL,
+        (size_t) sbuf.st_size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE,
+        fh->fd,
+        0);
+    if (map == MAP_FAILED) return;
+
+    fh->map      = map;
+    fh->map_size = (uint64_t) sbuf.st_size;
+
+    file->read_fn     = &mmap_read_func;
+    file->advise_fn   = &mmap_advise_func;
+    file->mapped_data = (const uint8_t*) map;
+    file->mapped_size = fh->map_size;
+}
+
+/**************************************/
+
+#ifdef OPENEXR_IMF_HAVE_POSIX_AIO
+
+/* the maximum number of requests handed to a single aio_suspend */
+#    define AIO_SUSPEND_MAX 64
+
+static exr_result_t
+aio_read_async_func (
+    exr_const_context_t         ctxt,
+    void*                       userdata,
+    exr_async_read_request_t*   request,
+    exr_stream_error_func_ptr_t error_cb)
+{
+    const struct _internal_exr_context* pctxt = EXR_CCTXT (ctxt);
+    struct _internal_exr_filehandle*    fh    = userdata;
+    struct aiocb*                       cb;
+
+    if (!fh || fh->fd < 0 || !request)
+    {
+        if (error_cb)
+            error_cb (
+                ctxt, EXR_ERR_INVALID_ARGUMENT, "Invalid file handle pointer");
+        return EXR_ERR_INVALID_ARGUMENT;
+    }
+
+    if (sizeof (size_t) == 4 && request->size >= (uint64_t) UINT32_MAX)
+    {
+        if (error_cb)
+            error_cb (
+                ctxt,
+                EXR_ERR_INVALID_ARGUMENT,
+                "read request size too large for architecture");
+        return EXR_ERR_INVALID_ARGUMENT;
+    }
+
+    cb = pctxt->alloc_fn (sizeof (struct aiocb));
+    if (!cb) return EXR_ERR_OUT_OF_MEMORY;
+
+    memset (cb, 0, sizeof (struct aiocb));
+    cb->aio_fildes                = fh->fd;
+    cb->aio_buf                   = request->buffer;
+    cb->aio_nbytes                = (size_t) request->size;
+    cb->aio_offset                = (off_t) request->offset;
+    cb->aio_sigevent.sigev_notify = SIGEV_NONE;
+
+    if (aio_read (cb) != 0)
+    {
+        int err = errno;
+        pctxt->free_fn (cb);
+        if (error_cb)
+            error_cb (
+                ctxt,
+                EXR_ERR_READ_IO,
+                "Unable to submit read of %" PRIu64 " bytes: %s",
+                request->size,
+                strerror (err));
+        return EXR_ERR_READ_IO;
+    }
+
+    request->nread         = -1;
+    request->provider_data = cb;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+static void
+aio_cancel_requests (
+    const struct _internal_exr_context* pctxt,
+    exr_async_read_request_t* const*    requests,
+    int                                 count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        struct aiocb* cb = requests[i]->provider_data;
+        if (!cb) continue;
+
+        /* the buffer may not be released until the request is done */
+        if (aio_cancel (cb->aio_fildes, cb) == AIO_NOTCANCELED)
+        {
+            const struct aiocb* list[1] = { cb };
+            while (aio_error (cb) == EINPROGRESS)
+                aio_suspend (list, 1, NULL);
+        }
+        aio_return (cb);
+        pctxt->free_fn (cb);
+        requests[i]->provider_data = NULL;
+    }
+}
+
+/**************************************/
+
+static exr_result_t
+aio_wait_async_func (
+    exr_const_context_t              ctxt,
+    void*                            userdata,
+    exr_async_read_request_t* const* requests,
+    int                              count,
+    int*                             completed,
+    exr_stream_error_func_ptr_t      error_cb)
+{
+    const struct _internal_exr_context* pctxt = EXR_CCTXT (ctxt);
+    const struct aiocb*                 list[AIO_SUSPEND_MAX];
+    int                                 nlist;
+
+    (void) userdata;
+    if (!requests || count <= 0 || !completed)
+    {
+        if (error_cb)
+            error_cb (
+                ctxt, EXR_ERR_INVALID_ARGUMENT, "No outstanding read requests");
+        return EXR_ERR_INVALID_ARGUMENT;
+    }
+
+    for (;;)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            struct aiocb* cb = requests[i]->provider_data;
+            int           err;
+            ssize_t       nread;
+
+            if (!cb) continue;
+            err = aio_error (cb);
+            if (err == EINPROGRESS) continue;
+
+            nread = aio_return (cb);
+            if (err != 0)
+            {
+                if (error_cb)
+                    error_cb (
+                        ctxt,
+                        EXR_ERR_READ_IO,
+                        "Unable to read %" PRIu64 " bytes: %s",
+                        requests[i]->size,
+                        strerror (err));
+                nread = -1;
+            }
+
+            pctxt->free_fn (cb);
+            requests[i]->provider_data = NULL;
+            requests[i]->nread         = (int64_t) nread;
+            *completed                 = i;
+            return EXR_ERR_SUCCESS;
+        }
+
+        /* nothing has finished yet, block until something in (the
+         * first portion of) the list does */
+        nlist = 0;
+        for (int i = 0; i < count && nlist < AIO_SUSPEND_MAX; ++i)
+        {
+            if (requests[i]->provider_data)
+                list[nlist++] = requests[i]->provider_data;
+        }
+
+        if (nlist == 0)
+        {
+            if (error_cb)
+                error_cb (
+                    ctxt,
+                    EXR_ERR_INVALID_ARGUMENT,
+                    "Read requests were not submitted");
+            return EXR_ERR_INVALID_ARGUMENT;
+        }
+
+        if (aio_suspend (list, nlist, NULL) != 0 && errno != EINTR &&
+            errno != EAGAIN)
+        {
+            int err = errno;
+            aio_cancel_requests (pctxt, requests, count);
+            if (error_cb)
+                error_cb (
+                    ctxt,
+                    EXR_ERR_READ_IO,
+                    "Unable to wait for read requests: %s",
+                    strerror (err));
+            return EXR_ERR_READ_IO;
+        }
+    }
+}
+
+#endif /* OPENEXR_IMF_HAVE_POSIX_AIO */
+
+/**************************************/
+
 static int64_t
 default_write_func (
     exr_const_context_t         ctxt,
@@ -329,7 +629,9 @@ default_init_read_file (struct _internal_exr_context* file)
     int                              fd;
     struct _internal_exr_filehandle* fh = file->user_data;
 
-    fh->fd = -1;
+    fh->fd       = -1;
+    fh->map      = NULL;
+    fh->map_size = 0;
 #if !CAN_USE_PREAD
 #    ifdef ILMTHREAD_THREADING_ENABLED
     fd = pthread_mutex_init (&(fh->mutex), NULL);
@@ -354,6 +656,20 @@ default_init_read_file (struct _internal_exr_context* file)
             strerror (errno));
 
     fh->fd = fd;
+
+    /* failure to map is not an error, we just fall back to reading */
+    if ((file->flags & EXR_CONTEXT_FLAG_MEMORY_MAP_READ))
+        default_try_mmap_file (file);
+
+#ifdef OPENEXR_IMF_HAVE_POSIX_AIO
+    /* no benefit to queueing reads if the file is mapped */
+    if (!file->mapped_data)
+    {
+        file->read_async_fn = &aio_read_async_func;
+        file->wait_async_fn = &aio_wait_async_func;
+    }
+#endif
+
     return EXR_ERR_SUCCESS;
 }
 
@@ -380,6 +696,8 @@ default_init_write_file (struct _internal_exr_context* file)
 #endif
 
     fh->fd           = -1;
+    fh->map          = NULL;
+    fh->map_size     = 0;
     file->destroy_fn = &default_shutdown;
     file->write_fn   = &default_write_func;
 
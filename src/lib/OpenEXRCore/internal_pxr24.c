@@ -7,10 +7,10 @@
 #include "internal_decompress.h"
 
 #include "internal_coding.h"
+#include "internal_cpuid.h"
 #include "internal_xdr.h"
 
 #include <string.h>
-#include <zlib.h>
 
 /**************************************/
 
@@ -86,13 +86,569 @@ float_to_float24 (float f)
 
 /**************************************/
 
+/*
+ * Splitting one row of a channel into byte planes and merging them
+ * back. The loops at the end of each function are the reference
+ * versions and handle the pixels left over by the SSE2 / NEON
+ * kernels, which are chosen at compile time. The kernels treat the
+ * little-endian pixel data as vectors of 16 or 32-bit words, which is
+ * why the NEON ones are limited to little-endian AArch64.
+ */
+
+#if defined(IMF_HAVE_SSE2)
+
+/*
+ * float_to_float24 for four floats at a time. The finite and infinite
+ * cases share the rounded and truncated values, a NAN needs the one
+ * extra bit if its 15 leftmost significand bits are all zero.
+ */
+static inline __m128i
+float_to_float24_sse2 (__m128i f)
+{
+    __m128i em = _mm_and_si128 (f, _mm_set1_epi32 (0x7fffffff));
+    __m128i t  = _mm_srli_epi32 (em, 8);
+    __m128i r  = _mm_srli_epi32 (
+        _mm_add_epi32 (em, _mm_and_si128 (em, _mm_set1_epi32 (0x80))), 8);
+    __m128i overflow = _mm_cmpgt_epi32 (r, _mm_set1_epi32 (0x7f7fff));
+    __m128i nan      = _mm_and_si128 (
+        _mm_cmpgt_epi32 (em, _mm_set1_epi32 (0x7f800000)),
+        _mm_cmplt_epi32 (em, _mm_set1_epi32 (0x7f800100)));
+
+    r = _mm_or_si128 (
+        _mm_and_si128 (overflow, t), _mm_andnot_si128 (overflow, r));
+    r = _mm_or_si128 (r, _mm_and_si128 (nan, _mm_set1_epi32 (1)));
+    return _mm_or_si128 (
+        r,
+        _mm_srli_epi32 (_mm_andnot_si128 (_mm_set1_epi32 (0x7fffffff), f), 8));
+}
+
+/* bits [shift, shift + 8) of sixteen 32-bit differences */
+static inline __m128i
+byte_plane_sse2 (const __m128i d[4], int shift)
+{
+    const __m128i mask = _mm_set1_epi32 (0xff);
+    __m128i       a    = _mm_packs_epi32 (
+        _mm_and_si128 (_mm_srli_epi32 (d[0], shift), mask),
+        _mm_and_si128 (_mm_srli_epi32 (d[1], shift), mask));
+    __m128i b = _mm_packs_epi32 (
+        _mm_and_si128 (_mm_srli_epi32 (d[2], shift), mask),
+        _mm_and_si128 (_mm_srli_epi32 (d[3], shift), mask));
+    return _mm_packus_epi16 (a, b);
+}
+
+/* difference to the left neighbor, the last lane of prev for lane 0 */
+static inline __m128i
+delta32_sse2 (__m128i p, __m128i prev)
+{
+    return _mm_sub_epi32 (
+        p, _mm_or_si128 (_mm_slli_si128 (p, 4), _mm_srli_si128 (prev, 12)));
+}
+
+/* running sum of four differences, starting at the last lane of carry */
+static inline __m128i
+prefix_sum32_sse2 (__m128i d, __m128i carry)
+{
+    d = _mm_add_epi32 (d, _mm_slli_si128 (d, 4));
+    d = _mm_add_epi32 (d, _mm_slli_si128 (d, 8));
+    return _mm_add_epi32 (
+        d, _mm_shuffle_epi32 (carry, _MM_SHUFFLE (3, 3, 3, 3)));
+}
+
+/* rebuilds and stores eight 32-bit values from their high and low halves */
+static inline __m128i
+merge_words_sse2 (__m128i hi, __m128i lo, __m128i carry, uint8_t* out)
+{
+    __m128i x0 = prefix_sum32_sse2 (_mm_unpacklo_epi16 (lo, hi), carry);
+    __m128i x1 = prefix_sum32_sse2 (_mm_unpackhi_epi16 (lo, hi), x0);
+
+    _mm_storeu_si128 ((__m128i*) out, x0);
+    _mm_storeu_si128 ((__m128i*) (out + 16), x1);
+    return x1;
+}
+
+#endif /* IMF_HAVE_SSE2 */
+
+/**************************************/
+
+#if defined(IMF_HAVE_NEON_AARCH64)
+
+static inline uint32x4_t
+float_to_float24_neon (uint32x4_t f)
+{
+    uint32x4_t em = vandq_u32 (f, vdupq_n_u32 (0x7fffffff));
+    uint32x4_t t  = vshrq_n_u32 (em, 8);
+    uint32x4_t r  = vshrq_n_u32 (
+        vaddq_u32 (em, vandq_u32 (em, vdupq_n_u32 (0x80))), 8);
+    uint32x4_t nan = vandq_u32 (
+        vcgtq_u32 (em, vdupq_n_u32 (0x7f800000)),
+        vcltq_u32 (em, vdupq_n_u32 (0x7f800100)));
+
+    r = vbslq_u32 (vcgtq_u32 (r, vdupq_n_u32 (0x7f7fff)), t, r);
+    r = vorrq_u32 (r, vandq_u32 (nan, vdupq_n_u32 (1)));
+    return vorrq_u32 (
+        r, vshrq_n_u32 (vandq_u32 (f, vdupq_n_u32 (0x80000000)), 8));
+}
+
+static inline uint8x8_t
+byte_plane_neon (uint32x4_t d0, uint32x4_t d1, int shift)
+{
+    int32x4_t s = vdupq_n_s32 (-shift);
+
+    return vmovn_u16 (vcombine_u16 (
+        vmovn_u32 (vshlq_u32 (d0, s)), vmovn_u32 (vshlq_u32 (d1, s))));
+}
+
+static inline uint32x4_t
+prefix_sum32_neon (uint32x4_t d, uint32x4_t carry)
+{
+    const uint32x4_t zero = vdupq_n_u32 (0);
+
+    d = vaddq_u32 (d, vextq_u32 (zero, d, 3));
+    d = vaddq_u32 (d, vextq_u32 (zero, d, 2));
+    return vaddq_u32 (d, vdupq_laneq_u32 (carry, 3));
+}
+
+static inline uint32x4_t
+merge_words_neon (uint16x8_t hi, uint16x8_t lo, uint32x4_t carry, uint8_t* out)
+{
+    uint32x4_t x0 = prefix_sum32_neon (
+        vorrq_u32 (
+            vshll_n_u16 (vget_low_u16 (hi), 16),
+            vmovl_u16 (vget_low_u16 (lo))),
+        carry);
+    uint32x4_t x1 = prefix_sum32_neon (
+        vorrq_u32 (
+            vshll_n_u16 (vget_high_u16 (hi), 16),
+            vmovl_u16 (vget_high_u16 (lo))),
+        x0);
+
+    vst1q_u8 (out, vreinterpretq_u8_u32 (x0));
+    vst1q_u8 (out + 16, vreinterpretq_u8_u32 (x1));
+    return x1;
+}
+
+#endif /* IMF_HAVE_NEON_AARCH64 */
+
+/**************************************/
+
+static void
+split_uint (const uint8_t* in, int w, uint8_t* out)
+{
+    uint8_t* ptr[4];
+    uint32_t prevPixel = 0;
+    int      x         = 0;
+
+    ptr[0] = out;
+    ptr[1] = ptr[0] + w;
+    ptr[2] = ptr[1] + w;
+    ptr[3] = ptr[2] + w;
+
+#if defined(IMF_HAVE_SSE2)
+    {
+        __m128i prev = _mm_setzero_si128 ();
+
+        for (; x + 16 <= w; x += 16, in += 64)
+        {
+            __m128i d[4];
+
+            for (int k = 0; k < 4; ++k)
+            {
+                __m128i p = _mm_loadu_si128 ((const __m128i*) in + k);
+                d[k]      = delta32_sse2 (p, prev);
+                prev      = p;
+            }
+            _mm_storeu_si128 ((__m128i*) (ptr[0] + x), byte_plane_sse2 (d, 24));
+            _mm_storeu_si128 ((__m128i*) (ptr[1] + x), byte_plane_sse2 (d, 16));
+            _mm_storeu_si128 ((__m128i*) (ptr[2] + x), byte_plane_sse2 (d, 8));
+            _mm_storeu_si128 ((__m128i*) (ptr[3] + x), byte_plane_sse2 (d, 0));
+        }
+        prevPixel = (uint32_t) _mm_cvtsi128_si32 (_mm_srli_si128 (prev, 12));
+    }
+#elif defined(IMF_HAVE_NEON_AARCH64)
+    {
+        uint32x4_t prev = vdupq_n_u32 (0);
+
+        for (; x + 8 <= w; x += 8, in += 32)
+        {
+            uint32x4_t p0 = vreinterpretq_u32_u8 (vld1q_u8 (in));
+            uint32x4_t p1 = vreinterpretq_u32_u8 (vld1q_u8 (in + 16));
+            uint32x4_t d0 = vsubq_u32 (p0, vextq_u32 (prev, p0, 3));
+            uint32x4_t d1 = vsubq_u32 (p1, vextq_u32 (p0, p1, 3));
+            prev          = p1;
+
+            vst1_u8 (ptr[0] + x, byte_plane_neon (d0, d1, 24));
+            vst1_u8 (ptr[1] + x, byte_plane_neon (d0, d1, 16));
+            vst1_u8 (ptr[2] + x, byte_plane_neon (d0, d1, 8));
+            vst1_u8 (ptr[3] + x, byte_plane_neon (d0, d1, 0));
+        }
+        prevPixel = vgetq_lane_u32 (prev, 3);
+    }
+#endif
+
+    for (; x < w; ++x)
+    {
+        uint32_t pixel = unaligned_load32 (in);
+        uint32_t diff  = pixel - prevPixel;
+        prevPixel      = pixel;
+
+        in += 4;
+        ptr[0][x] = (uint8_t) (diff >> 24);
+        ptr[1][x] = (uint8_t) (diff >> 16);
+        ptr[2][x] = (uint8_t) (diff >> 8);
+        ptr[3][x] = (uint8_t) (diff);
+    }
+}
+
+static void
+split_half (const uint8_t* in, int w, uint8_t* out)
+{
+    uint8_t* ptr[2];
+    uint32_t prevPixel = 0;
+    int      x         = 0;
+
+    ptr[0] = out;
+    ptr[1] = ptr[0] + w;
+
+#if defined(IMF_HAVE_SSE2)
+    {
+        const __m128i mask = _mm_set1_epi16 (0xff);
+        __m128i       prev = _mm_setzero_si128 ();
+
+        for (; x + 16 <= w; x += 16, in += 32)
+        {
+            __m128i p0 = _mm_loadu_si128 ((const __m128i*) in);
+            __m128i p1 = _mm_loadu_si128 ((const __m128i*) in + 1);
+            __m128i d0 = _mm_sub_epi16 (
+                p0,
+                _mm_or_si128 (
+                    _mm_slli_si128 (p0, 2), _mm_srli_si128 (prev, 14)));
+            __m128i d1 = _mm_sub_epi16 (
+                p1,
+                _mm_or_si128 (_mm_slli_si128 (p1, 2), _mm_srli_si128 (p0, 14)));
+            prev = p1;
+
+            _mm_storeu_si128 (
+                (__m128i*) (ptr[0] + x),
+                _mm_packus_epi16 (_mm_srli_epi16 (d0, 8), _mm_srli_epi16 (d1, 8)));
+            _mm_storeu_si128 (
+                (__m128i*) (ptr[1] + x),
+                _mm_packus_epi16 (
+                    _mm_and_si128 (d0, mask), _mm_and_si128 (d1, mask)));
+        }
+        prevPixel = (uint32_t) _mm_extract_epi16 (prev, 7);
+    }
+#elif defined(IMF_HAVE_NEON_AARCH64)
+    {
+        uint16x8_t prev = vdupq_n_u16 (0);
+
+        for (; x + 8 <= w; x += 8, in += 16)
+        {
+            uint16x8_t p = vreinterpretq_u16_u8 (vld1q_u8 (in));
+            uint16x8_t d = vsubq_u16 (p, vextq_u16 (prev, p, 7));
+            prev         = p;
+
+            vst1_u8 (ptr[0] + x, vshrn_n_u16 (d, 8));
+            vst1_u8 (ptr[1] + x, vmovn_u16 (d));
+        }
+        prevPixel = vgetq_lane_u16 (prev, 7);
+    }
+#endif
+
+    for (; x < w; ++x)
+    {
+        uint32_t pixel = (uint32_t) unaligned_load16 (in);
+        uint32_t diff  = pixel - prevPixel;
+        prevPixel      = pixel;
+
+        in += 2;
+        ptr[0][x] = (uint8_t) (diff >> 8);
+        ptr[1][x] = (uint8_t) (diff);
+    }
+}
+
+static void
+split_float (const uint8_t* in, int w, uint8_t* out)
+{
+    uint8_t* ptr[3];
+    uint32_t prevPixel = 0;
+    int      x         = 0;
+
+    ptr[0] = out;
+    ptr[1] = ptr[0] + w;
+    ptr[2] = ptr[1] + w;
+
+#if defined(IMF_HAVE_SSE2)
+    {
+        __m128i prev = _mm_setzero_si128 ();
+
+        for (; x + 16 <= w; x += 16, in += 64)
+        {
+            __m128i d[4];
+
+            for (int k = 0; k < 4; ++k)
+            {
+                __m128i p = float_to_float24_sse2 (
+                    _mm_loadu_si128 ((const __m128i*) in + k));
+                d[k] = delta32_sse2 (p, prev);
+                prev = p;
+            }
+            _mm_storeu_si128 ((__m128i*) (ptr[0] + x), byte_plane_sse2 (d, 16));
+            _mm_storeu_si128 ((__m128i*) (ptr[1] + x), byte_plane_sse2 (d, 8));
+            _mm_storeu_si128 ((__m128i*) (ptr[2] + x), byte_plane_sse2 (d, 0));
+        }
+        prevPixel = (uint32_t) _mm_cvtsi128_si32 (_mm_srli_si128 (prev, 12));
+    }
+#elif defined(IMF_HAVE_NEON_AARCH64)
+    {
+        uint32x4_t prev = vdupq_n_u32 (0);
+
+        for (; x + 8 <= w; x += 8, in += 32)
+        {
+            uint32x4_t p0 =
+                float_to_float24_neon (vreinterpretq_u32_u8 (vld1q_u8 (in)));
+            uint32x4_t p1 = float_to_float24_neon (
+                vreinterpretq_u32_u8 (vld1q_u8 (in + 16)));
+            uint32x4_t d0 = vsubq_u32 (p0, vextq_u32 (prev, p0, 3));
+            uint32x4_t d1 = vsubq_u32 (p1, vextq_u32 (p0, p1, 3));
+            prev          = p1;
+
+            vst1_u8 (ptr[0] + x, byte_plane_neon (d0, d1, 16));
+            vst1_u8 (ptr[1] + x, byte_plane_neon (d0, d1, 8));
+            vst1_u8 (ptr[2] + x, byte_plane_neon (d0, d1, 0));
+        }
+        prevPixel = vgetq_lane_u32 (prev, 3);
+    }
+#endif
+
+    for (; x < w; ++x)
+    {
+        union
+        {
+            uint32_t i;
+            float    f;
+        } v;
+        uint32_t pixel24, diff;
+        v.i       = unaligned_load32 (in);
+        pixel24   = float_to_float24 (v.f);
+        diff      = pixel24 - prevPixel;
+        prevPixel = pixel24;
+
+        in += 4;
+        ptr[0][x] = (uint8_t) (diff >> 16);
+        ptr[1][x] = (uint8_t) (diff >> 8);
+        ptr[2][x] = (uint8_t) (diff);
+    }
+}
+
+/**************************************/
+
+static void
+merge_uint (const uint8_t* in, int w, uint8_t* out)
+{
+    const uint8_t* ptr[4];
+    uint32_t       pixel = 0;
+    int            x     = 0;
+
+    ptr[0] = in;
+    ptr[1] = ptr[0] + w;
+    ptr[2] = ptr[1] + w;
+    ptr[3] = ptr[2] + w;
+
+#if defined(IMF_HAVE_SSE2)
+    {
+        __m128i carry = _mm_setzero_si128 ();
+
+        for (; x + 16 <= w; x += 16, out += 64)
+        {
+            __m128i b0 = _mm_loadu_si128 ((const __m128i*) (ptr[0] + x));
+            __m128i b1 = _mm_loadu_si128 ((const __m128i*) (ptr[1] + x));
+            __m128i b2 = _mm_loadu_si128 ((const __m128i*) (ptr[2] + x));
+            __m128i b3 = _mm_loadu_si128 ((const __m128i*) (ptr[3] + x));
+
+            carry = merge_words_sse2 (
+                _mm_unpacklo_epi8 (b1, b0), _mm_unpacklo_epi8 (b3, b2), carry, out);
+            carry = merge_words_sse2 (
+                _mm_unpackhi_epi8 (b1, b0),
+                _mm_unpackhi_epi8 (b3, b2),
+                carry,
+                out + 32);
+        }
+        pixel = (uint32_t) _mm_cvtsi128_si32 (_mm_srli_si128 (carry, 12));
+    }
+#elif defined(IMF_HAVE_NEON_AARCH64)
+    {
+        uint32x4_t carry = vdupq_n_u32 (0);
+
+        for (; x + 8 <= w; x += 8, out += 32)
+        {
+            uint16x8_t hi = vorrq_u16 (
+                vshll_n_u8 (vld1_u8 (ptr[0] + x), 8),
+                vmovl_u8 (vld1_u8 (ptr[1] + x)));
+            uint16x8_t lo = vorrq_u16 (
+                vshll_n_u8 (vld1_u8 (ptr[2] + x), 8),
+                vmovl_u8 (vld1_u8 (ptr[3] + x)));
+
+            carry = merge_words_neon (hi, lo, carry, out);
+        }
+        pixel = vgetq_lane_u32 (carry, 3);
+    }
+#endif
+
+    for (; x < w; ++x)
+    {
+        uint32_t diff =
+            (((uint32_t) (ptr[0][x]) << 24) | ((uint32_t) (ptr[1][x]) << 16) |
+             ((uint32_t) (ptr[2][x]) << 8) | ((uint32_t) (ptr[3][x])));
+        pixel += diff;
+        unaligned_store32 (out, pixel);
+        out += 4;
+    }
+}
+
+static void
+merge_half (const uint8_t* in, int w, uint8_t* out)
+{
+    const uint8_t* ptr[2];
+    uint32_t       pixel = 0;
+    int            x     = 0;
+
+    ptr[0] = in;
+    ptr[1] = ptr[0] + w;
+
+#if defined(IMF_HAVE_SSE2)
+    {
+        __m128i carry = _mm_setzero_si128 ();
+
+        for (; x + 16 <= w; x += 16, out += 32)
+        {
+            __m128i b0 = _mm_loadu_si128 ((const __m128i*) (ptr[0] + x));
+            __m128i b1 = _mm_loadu_si128 ((const __m128i*) (ptr[1] + x));
+            __m128i v[2];
+
+            v[0] = _mm_unpacklo_epi8 (b1, b0);
+            v[1] = _mm_unpackhi_epi8 (b1, b0);
+            for (int k = 0; k < 2; ++k)
+            {
+                __m128i d = v[k];
+
+                d = _mm_add_epi16 (d, _mm_slli_si128 (d, 2));
+                d = _mm_add_epi16 (d, _mm_slli_si128 (d, 4));
+                d = _mm_add_epi16 (d, _mm_slli_si128 (d, 8));
+                d = _mm_add_epi16 (d, carry);
+                _mm_storeu_si128 ((__m128i*) out + k, d);
+
+                carry = _mm_shufflehi_epi16 (d, _MM_SHUFFLE (3, 3, 3, 3));
+                carry = _mm_unpackhi_epi64 (carry, carry);
+            }
+        }
+        pixel = (uint32_t) _mm_extract_epi16 (carry, 7);
+    }
+#elif defined(IMF_HAVE_NEON_AARCH64)
+    {
+        const uint16x8_t zero  = vdupq_n_u16 (0);
+        uint16x8_t       carry = zero;
+
+        for (; x + 8 <= w; x += 8, out += 16)
+        {
+            uint16x8_t d = vorrq_u16 (
+                vshll_n_u8 (vld1_u8 (ptr[0] + x), 8),
+                vmovl_u8 (vld1_u8 (ptr[1] + x)));
+
+            d = vaddq_u16 (d, vextq_u16 (zero, d, 7));
+            d = vaddq_u16 (d, vextq_u16 (zero, d, 6));
+            d = vaddq_u16 (d, vextq_u16 (zero, d, 4));
+            d = vaddq_u16 (d, carry);
+            vst1q_u8 (out, vreinterpretq_u8_u16 (d));
+            carry = vdupq_laneq_u16 (d, 7);
+        }
+        pixel = vgetq_lane_u16 (carry, 7);
+    }
+#endif
+
+    for (; x < w; ++x)
+    {
+        uint32_t diff =
+            (((uint32_t) (ptr[0][x]) << 8) | ((uint32_t) (ptr[1][x])));
+        pixel += diff;
+        unaligned_store16 (out, (uint16_t) pixel);
+        out += 2;
+    }
+}
+
+static void
+merge_float (const uint8_t* in, int w, uint8_t* out)
+{
+    const uint8_t* ptr[3];
+    uint32_t       pixel = 0;
+    int            x     = 0;
+
+    ptr[0] = in;
+    ptr[1] = ptr[0] + w;
+    ptr[2] = ptr[1] + w;
+
+#if defined(IMF_HAVE_SSE2)
+    {
+        const __m128i zero  = _mm_setzero_si128 ();
+        __m128i       carry = zero;
+
+        for (; x + 16 <= w; x += 16, out += 64)
+        {
+            __m128i b0 = _mm_loadu_si128 ((const __m128i*) (ptr[0] + x));
+            __m128i b1 = _mm_loadu_si128 ((const __m128i*) (ptr[1] + x));
+            __m128i b2 = _mm_loadu_si128 ((const __m128i*) (ptr[2] + x));
+
+            carry = merge_words_sse2 (
+                _mm_unpacklo_epi8 (b1, b0),
+                _mm_unpacklo_epi8 (zero, b2),
+                carry,
+                out);
+            carry = merge_words_sse2 (
+                _mm_unpackhi_epi8 (b1, b0),
+                _mm_unpackhi_epi8 (zero, b2),
+                carry,
+                out + 32);
+        }
+        pixel = (uint32_t) _mm_cvtsi128_si32 (_mm_srli_si128 (carry, 12));
+    }
+#elif defined(IMF_HAVE_NEON_AARCH64)
+    {
+        uint32x4_t carry = vdupq_n_u32 (0);
+
+        for (; x + 8 <= w; x += 8, out += 32)
+        {
+            uint16x8_t hi = vorrq_u16 (
+                vshll_n_u8 (vld1_u8 (ptr[0] + x), 8),
+                vmovl_u8 (vld1_u8 (ptr[1] + x)));
+            uint16x8_t lo = vshll_n_u8 (vld1_u8 (ptr[2] + x), 8);
+
+            carry = merge_words_neon (hi, lo, carry, out);
+        }
+        pixel = vgetq_lane_u32 (carry, 3);
+    }
+#endif
+
+    for (; x < w; ++x)
+    {
+        uint32_t diff =
+            (((uint32_t) (ptr[0][x]) << 24) | ((uint32_t) (ptr[1][x]) << 16) |
+             ((uint32_t) (ptr[2][x]) << 8));
+        pixel += diff;
+        unaligned_store32 (out, pixel);
+        out += 4;
+    }
+}
+
+/**************************************/
+
 static exr_result_t
 apply_pxr24_impl (exr_encode_pipeline_t* encode)
 {
     uint8_t*       out       = encode->scratch_buffer_1;
     uint64_t       nOut      = 0;
     const uint8_t* lastIn    = encode->packed_buffer;
-    uLongf         compbufsz = encode->compressed_alloc_size;
+    uint64_t       compbufsz = 0;
+    int            level;
+    exr_result_t   rv;
 
     for (int y = 0; y < encode->chunk.height; ++y)
     {
@@ -110,120 +666,53 @@ apply_pxr24_impl (exr_encode_pipeline_t* encode)
 
             switch (curc->data_type)
             {
-                case EXR_PIXEL_UINT: {
-                    uint8_t*        ptr[4];
-                    uint32_t        prevPixel = 0;
-                    const uint32_t* din       = (const uint32_t*) (lastIn);
-
+                case EXR_PIXEL_UINT:
                     nBytes *= sizeof (uint32_t);
                     if (nOut + nBytes > encode->scratch_alloc_size_1)
                         return EXR_ERR_OUT_OF_MEMORY;
+                    split_uint (lastIn, w, out);
                     nOut += nBytes;
                     lastIn += nBytes;
-
-                    ptr[0] = out;
-                    out += w;
-                    ptr[1] = out;
-                    out += w;
-                    ptr[2] = out;
-                    out += w;
-                    ptr[3] = out;
-                    out += w;
-
-                    for (int x = 0; x < w; ++x)
-                    {
-                        uint32_t pixel = unaligned_load32 (din);
-                        uint32_t diff  = pixel - prevPixel;
-                        prevPixel      = pixel;
-
-                        ++din;
-                        *(ptr[0]++) = (uint8_t) (diff >> 24);
-                        *(ptr[1]++) = (uint8_t) (diff >> 16);
-                        *(ptr[2]++) = (uint8_t) (diff >> 8);
-                        *(ptr[3]++) = (uint8_t) (diff);
-                    }
+                    out += nBytes;
                     break;
-                }
-                case EXR_PIXEL_HALF: {
-                    uint8_t*        ptr[2];
-                    uint32_t        prevPixel = 0;
-                    const uint16_t* din       = (const uint16_t*) (lastIn);
-
+                case EXR_PIXEL_HALF:
                     nBytes *= sizeof (uint16_t);
                     if (nOut + nBytes > encode->scratch_alloc_size_1)
                         return EXR_ERR_OUT_OF_MEMORY;
+                    split_half (lastIn, w, out);
                     nOut += nBytes;
                     lastIn += nBytes;
-
-                    ptr[0] = out;
-                    out += w;
-                    ptr[1] = out;
-                    out += w;
-
-                    for (int x = 0; x < w; ++x)
-                    {
-                        uint32_t pixel = (uint32_t) unaligned_load16 (din);
-                        uint32_t diff  = pixel - prevPixel;
-                        prevPixel      = pixel;
-
-                        ++din;
-                        *(ptr[0]++) = (uint8_t) (diff >> 8);
-                        *(ptr[1]++) = (uint8_t) (diff);
-                    }
+                    out += nBytes;
                     break;
-                }
-                case EXR_PIXEL_FLOAT: {
-                    uint8_t*     ptr[3];
-                    uint32_t     prevPixel = 0;
-                    const float* din       = (const float*) (lastIn);
-
+                case EXR_PIXEL_FLOAT:
                     nBytes *= 3;
                     if (nOut + nBytes > encode->scratch_alloc_size_1)
                         return EXR_ERR_OUT_OF_MEMORY;
+                    split_float (lastIn, w, out);
                     nOut += nBytes;
                     lastIn += w * 4;
-
-                    ptr[0] = out;
-                    out += w;
-                    ptr[1] = out;
-                    out += w;
-                    ptr[2] = out;
-                    out += w;
-
-                    for (int x = 0; x < w; ++x)
-                    {
-                        union
-                        {
-                            uint32_t i;
-                            float    f;
-                        } v;
-                        uint32_t pixel24, diff;
-                        v.i       = unaligned_load32 (din);
-                        pixel24   = float_to_float24 (v.f);
-                        diff      = pixel24 - prevPixel;
-                        prevPixel = pixel24;
-
-                        ++din;
-                        *(ptr[0]++) = (uint8_t) (diff >> 16);
-                        *(ptr[1]++) = (uint8_t) (diff >> 8);
-                        *(ptr[2]++) = (uint8_t) (diff);
-                    }
+                    out += nBytes;
                     break;
-                }
                 default: return EXR_ERR_INVALID_ARGUMENT;
             }
         }
     }
 
-    if (Z_OK != compress (
-                    (Bytef*) encode->compressed_buffer,
-                    &compbufsz,
-                    (const Bytef*) encode->scratch_buffer_1,
-                    nOut))
-    {
-        return EXR_ERR_CORRUPT_CHUNK;
-    }
-    if (compbufsz > encode->packed_bytes)
+    rv = internal_exr_zip_compression_level (
+        encode->context, encode->part_index, &level);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    rv = internal_exr_deflate (
+        encode->context,
+        level,
+        encode->compressed_buffer,
+        encode->compressed_alloc_size,
+        encode->scratch_buffer_1,
+        nOut,
+        &compbufsz);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    if (compbufsz >= encode->packed_bytes)
     {
         memcpy (
             encode->compressed_buffer,
@@ -262,8 +751,8 @@ undo_pxr24_impl (
     void*                  scratch_data,
     uint64_t               scratch_size)
 {
-    uLongf         outSize = (uLongf) uncompressed_size;
-    int            rstat;
+    uint64_t       outSize = 0;
+    exr_result_t   rv;
     uint8_t*       out    = uncompressed_data;
     uint64_t       nOut   = 0;
     uint64_t       nDec   = 0;
@@ -271,13 +760,15 @@ undo_pxr24_impl (
 
     if (scratch_size < uncompressed_size) return EXR_ERR_INVALID_ARGUMENT;
 
-    rstat = uncompress (
-        (Bytef*) scratch_data,
-        &outSize,
-        (const Bytef*) compressed_data,
-        (uLong) comp_buf_size);
+    rv = internal_exr_inflate (
+        decode->context,
+        scratch_data,
+        uncompressed_size,
+        compressed_data,
+        comp_buf_size,
+        &outSize);
 
-    if (rstat != Z_OK) return EXR_ERR_CORRUPT_CHUNK;
+    if (rv != EXR_ERR_SUCCESS) return rv;
 
     for (int y = 0; y < decode->chunk.height; ++y)
     {
@@ -298,88 +789,25 @@ undo_pxr24_impl (
 
             switch (curc->data_type)
             {
-                case EXR_PIXEL_UINT: {
-                    const uint8_t* ptr[4];
-                    uint32_t       pixel = 0;
-                    uint32_t*      dout  = (uint32_t*) (out);
-
-                    ptr[0] = lastIn;
-                    lastIn += w;
-                    ptr[1] = lastIn;
-                    lastIn += w;
-                    ptr[2] = lastIn;
-                    lastIn += w;
-                    ptr[3] = lastIn;
-                    lastIn += w;
-
+                case EXR_PIXEL_UINT:
                     if (nDec + nBytes > outSize) return EXR_ERR_CORRUPT_CHUNK;
-
-                    for (int x = 0; x < w; ++x)
-                    {
-                        uint32_t diff =
-                            (((uint32_t) (*(ptr[0]++)) << 24) |
-                             ((uint32_t) (*(ptr[1]++)) << 16) |
-                             ((uint32_t) (*(ptr[2]++)) << 8) |
-                             ((uint32_t) (*(ptr[3]++))));
-                        pixel += diff;
-                        unaligned_store32 (dout, pixel);
-                        ++dout;
-                    }
+                    merge_uint (lastIn, w, out);
+                    lastIn += w * 4;
                     nDec += nBytes;
                     break;
-                }
-                case EXR_PIXEL_HALF: {
-                    const uint8_t* ptr[2];
-                    uint32_t       pixel = 0;
-                    uint16_t*      dout  = (uint16_t*) (out);
-
-                    ptr[0] = lastIn;
-                    lastIn += w;
-                    ptr[1] = lastIn;
-                    lastIn += w;
-
+                case EXR_PIXEL_HALF:
                     if (nDec + nBytes > outSize) return EXR_ERR_CORRUPT_CHUNK;
-
-                    for (int x = 0; x < w; ++x)
-                    {
-                        uint32_t diff =
-                            (((uint32_t) (*(ptr[0]++)) << 8) |
-                             ((uint32_t) (*(ptr[1]++))));
-                        pixel += diff;
-                        unaligned_store16 (dout, (uint16_t) pixel);
-                        ++dout;
-                    }
+                    merge_half (lastIn, w, out);
+                    lastIn += w * 2;
                     nDec += nBytes;
                     break;
-                }
-                case EXR_PIXEL_FLOAT: {
-                    const uint8_t* ptr[3];
-                    uint32_t       pixel = 0;
-                    uint32_t*      dout  = (uint32_t*) (out);
-
-                    ptr[0] = lastIn;
-                    lastIn += w;
-                    ptr[1] = lastIn;
-                    lastIn += w;
-                    ptr[2] = lastIn;
-                    lastIn += w;
-
+                case EXR_PIXEL_FLOAT:
                     if (nDec + (uint64_t) (w * 3) > outSize)
                         return EXR_ERR_CORRUPT_CHUNK;
-
-                    for (int x = 0; x < w; ++x)
-                    {
-                        uint32_t diff =
-                            (((uint32_t) (*(ptr[0]++)) << 24) |
-                             ((uint32_t) (*(ptr[1]++)) << 16) |
-                             ((uint32_t) (*(ptr[2]++)) << 8));
-                        pixel += diff;
-                        unaligned_store32 (dout, pixel);
-                        ++dout;
-                    }
+                    merge_float (lastIn, w, out);
+                    lastIn += w * 3;
                     nDec += (uint64_t) (w * 3);
                     break;
-                }
                 default: return EXR_ERR_INVALID_ARGUMENT;
             }
             out += nBytes;
@@ -64,30 +64,6 @@ internal_rle_compress (
 
 /**************************************/
 
-static void
-reorder_and_predict (void* scratch, const void* packed, uint64_t packedbytes)
-{
-    int8_t*       t1   = scratch;
-    int8_t*       t2   = t1 + (packedbytes + 1) / 2;
-    const int8_t* in   = packed;
-    const int8_t* stop = in + packedbytes;
-    while (in < stop)
-    {
-        *(t1++) = *(in++);
-        if (in < stop) *(t2++) = *(in++);
-    }
-
-    t1    = scratch;
-    stop  = t1 + packedbytes;
-    int p = *(t1++);
-    while (t1 < stop)
-    {
-        int d = (int) (*t1) - p + (128 + 256);
-        p     = *t1;
-        *t1++ = (int8_t) (d);
-    }
-}
-
 exr_result_t
 internal_exr_apply_rle (exr_encode_pipeline_t* encode)
 {
@@ -104,7 +80,8 @@ internal_exr_apply_rle (exr_encode_pipeline_t* encode)
         srcb);
     if (rv != EXR_ERR_SUCCESS) return rv;
 
-    reorder_and_predict (encode->scratch_buffer_1, encode->packed_buffer, srcb);
+    internal_zip_deconstruct_bytes (
+        encode->scratch_buffer_1, encode->packed_buffer, srcb);
 
     outb = internal_rle_compress (
         encode->compressed_buffer,
@@ -165,31 +142,6 @@ internal_rle_decompress (
     return outbytes;
 }
 
-static void
-unpredict_and_reorder (void* out, void* scratch, uint64_t packedbytes)
-{
-    int8_t*       t1   = scratch;
-    int8_t*       t2   = t1 + (packedbytes + 1) / 2;
-    int8_t*       s    = out;
-    const int8_t* stop = t1 + packedbytes;
-
-    ++t1;
-    while (t1 < stop)
-    {
-        int d = (int) (t1[-1]) + (int) (t1[0]) - 128;
-        t1[0] = (int8_t)d;
-        ++t1;
-    }
-
-    t1   = scratch;
-    stop = s + packedbytes;
-    while (s < stop)
-    {
-        *(s++) = *(t1++);
-        if (s < stop) *(s++) = *(t2++);
-    }
-}
-
 exr_result_t
 internal_exr_undo_rle (
     exr_decode_pipeline_t* decode,
@@ -212,6 +164,6 @@ internal_exr_undo_rle (
         internal_rle_decompress (decode->scratch_buffer_1, outsz, src, packsz);
     if (unpackb != outsz) return EXR_ERR_CORRUPT_CHUNK;
 
-    unpredict_and_reorder (out, decode->scratch_buffer_1, outsz);
+    internal_zip_reconstruct_bytes (out, decode->scratch_buffer_1, outsz);
     return EXR_ERR_SUCCESS;
 }
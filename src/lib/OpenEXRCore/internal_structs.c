@@ -11,9 +11,14 @@
 #include <IlmThreadConfig.h>
 
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
+#ifdef OPENEXR_IMF_HAVE_LIBDEFLATE
+#    include <libdeflate.h>
+#endif
+
 #ifdef ILMTHREAD_THREADING_ENABLED
 #    ifdef _WIN32
 #        include <synchapi.h>
@@ -394,10 +399,23 @@ internal_exr_alloc_context (
         ret->destroy_fn = initializers->destroy_fn;
         ret->read_fn    = initializers->read_fn;
         ret->write_fn   = initializers->write_fn;
+        /* fields added to the initializer over time are only valid if
+         * the caller was compiled against a struct containing them */
+        if (initializers->size >=
+            offsetof (exr_context_initializer_t, flags) + sizeof (int))
+            ret->flags = initializers->flags;
+        if (initializers->size >= sizeof (exr_context_initializer_t) &&
+            initializers->read_fn && initializers->read_async_fn &&
+            initializers->wait_async_fn)
+        {
+            ret->read_async_fn = initializers->read_async_fn;
+            ret->wait_async_fn = initializers->wait_async_fn;
+        }
 
 #ifdef ILMTHREAD_THREADING_ENABLED
 #    ifdef _WIN32
         InitializeCriticalSection (&(ret->mutex));
+        InitializeCriticalSection (&(ret->buffer_pool.mutex));
 #    else
         rv = pthread_mutex_init (&(ret->mutex), NULL);
         if (rv != 0)
@@ -407,6 +425,14 @@ internal_exr_alloc_context (
             *out = NULL;
             return EXR_ERR_OUT_OF_MEMORY;
         }
+        rv = pthread_mutex_init (&(ret->buffer_pool.mutex), NULL);
+        if (rv != 0)
+        {
+            pthread_mutex_destroy (&(ret->mutex));
+            (initializers->free_fn) (memptr);
+            *out = NULL;
+            return EXR_ERR_OUT_OF_MEMORY;
+        }
 #    endif
 #endif
 
@@ -452,10 +478,13 @@ internal_exr_destroy_context (struct _internal_exr_context* ctxt)
     exr_attr_string_destroy ((exr_context_t) ctxt, &(ctxt->tmp_filename));
     exr_attr_list_destroy ((exr_context_t) ctxt, &(ctxt->custom_handlers));
     internal_exr_destroy_parts (ctxt);
+    internal_exr_pool_trim (ctxt);
 #ifdef ILMTHREAD_THREADING_ENABLED
 #    ifdef _WIN32
+    DeleteCriticalSection (&(ctxt->buffer_pool.mutex));
     DeleteCriticalSection (&(ctxt->mutex));
 #    else
+    pthread_mutex_destroy (&(ctxt->buffer_pool.mutex));
     pthread_mutex_destroy (&(ctxt->mutex));
 #    endif
 #endif
@@ -465,6 +494,258 @@ internal_exr_destroy_context (struct _internal_exr_context* ctxt)
 
 /**************************************/
 
+static inline struct _internal_exr_buffer_pool*
+lock_pool (const struct _internal_exr_context* ctxt)
+{
+    struct _internal_exr_buffer_pool* pool = EXR_CONST_CAST (
+        struct _internal_exr_buffer_pool*, &(ctxt->buffer_pool));
+#ifdef ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    EnterCriticalSection (&(pool->mutex));
+#    else
+    pthread_mutex_lock (&(pool->mutex));
+#    endif
+#endif
+    return pool;
+}
+
+static inline void
+unlock_pool (struct _internal_exr_buffer_pool* pool)
+{
+#ifdef ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    LeaveCriticalSection (&(pool->mutex));
+#    else
+    pthread_mutex_unlock (&(pool->mutex));
+#    endif
+#else
+    (void) pool;
+#endif
+}
+
+static inline void
+remove_pooled (struct _internal_exr_buffer_pool* pool, int idx)
+{
+    pool->stats.pooled_bytes -= pool->sizes[idx];
+    --(pool->stats.pooled_buffers);
+    --(pool->count);
+    pool->buffers[idx] = pool->buffers[pool->count];
+    pool->sizes[idx]   = pool->sizes[pool->count];
+}
+
+void*
+internal_exr_pool_acquire (
+    const struct _internal_exr_context* ctxt, size_t bytes, size_t* actual)
+{
+    struct _internal_exr_buffer_pool* pool = lock_pool (ctxt);
+    void*                             ret  = NULL;
+    int                               best = -1;
+
+    /* smallest one that fits, so large buffers stay available for
+     * the large requests, and none much larger than needed */
+    for (int i = 0; i < pool->count; ++i)
+    {
+        if (pool->sizes[i] >= bytes &&
+            pool->sizes[i] / EXR_BUFFER_POOL_MAX_SLACK <= bytes &&
+            (best < 0 || pool->sizes[i] < pool->sizes[best]))
+            best = i;
+    }
+
+    if (best >= 0)
+    {
+        ret     = pool->buffers[best];
+        *actual = pool->sizes[best];
+        remove_pooled (pool, best);
+        ++(pool->stats.reuses);
+        unlock_pool (pool);
+        return ret;
+    }
+
+    ++(pool->stats.allocations);
+    unlock_pool (pool);
+
+    ret = ctxt->alloc_fn (bytes);
+    if (ret) *actual = bytes;
+    return ret;
+}
+
+void
+internal_exr_pool_release (
+    const struct _internal_exr_context* ctxt, void* buf, size_t bytes)
+{
+    struct _internal_exr_buffer_pool* pool = lock_pool (ctxt);
+    void*                             tofree[EXR_BUFFER_POOL_SIZE + 1];
+    int                               nfree        = 0;
+    int                               nsmaller     = 0;
+    uint64_t                          smallerbytes = 0;
+
+    ++(pool->stats.releases);
+
+    /* when full, or over the byte budget, favor keeping the larger
+     * buffers: make room by dropping pooled buffers smaller than this
+     * one, if that is enough, otherwise drop this one */
+    for (int i = 0; i < pool->count; ++i)
+    {
+        if (pool->sizes[i] < bytes)
+        {
+            ++nsmaller;
+            smallerbytes += pool->sizes[i];
+        }
+    }
+
+    if ((uint64_t) bytes <= EXR_BUFFER_POOL_MAX_BYTES &&
+        pool->count - nsmaller < EXR_BUFFER_POOL_SIZE &&
+        pool->stats.pooled_bytes - smallerbytes + bytes <=
+            EXR_BUFFER_POOL_MAX_BYTES)
+    {
+        while (pool->count == EXR_BUFFER_POOL_SIZE ||
+               pool->stats.pooled_bytes + bytes > EXR_BUFFER_POOL_MAX_BYTES)
+        {
+            int smallest = 0;
+            for (int i = 1; i < pool->count; ++i)
+                if (pool->sizes[i] < pool->sizes[smallest]) smallest = i;
+
+            tofree[nfree++] = pool->buffers[smallest];
+            remove_pooled (pool, smallest);
+        }
+
+        pool->buffers[pool->count] = buf;
+        pool->sizes[pool->count]   = bytes;
+        ++(pool->count);
+        ++(pool->stats.pooled_buffers);
+        pool->stats.pooled_bytes += bytes;
+    }
+    else
+        tofree[nfree++] = buf;
+
+    pool->stats.frees += (uint64_t) nfree;
+    unlock_pool (pool);
+
+    for (int i = 0; i < nfree; ++i)
+        ctxt->free_fn (tofree[i]);
+}
+
+void
+internal_exr_pool_trim (const struct _internal_exr_context* ctxt)
+{
+    struct _internal_exr_buffer_pool* pool = lock_pool (ctxt);
+
+    for (int i = 0; i < pool->count; ++i)
+        ctxt->free_fn (pool->buffers[i]);
+    pool->stats.frees += (uint64_t) pool->count;
+    pool->stats.pooled_buffers = 0;
+    pool->stats.pooled_bytes   = 0;
+    pool->count                = 0;
+
+#ifdef OPENEXR_IMF_HAVE_LIBDEFLATE
+    for (int i = 0; i < pool->compressor_count; ++i)
+        libdeflate_free_compressor (pool->compressors[i]);
+    for (int i = 0; i < pool->decompressor_count; ++i)
+        libdeflate_free_decompressor (pool->decompressors[i]);
+    pool->compressor_count   = 0;
+    pool->decompressor_count = 0;
+#endif
+    unlock_pool (pool);
+}
+
+#ifdef OPENEXR_IMF_HAVE_LIBDEFLATE
+
+struct libdeflate_compressor*
+internal_exr_pool_acquire_compressor (
+    const struct _internal_exr_context* ctxt, int level)
+{
+    if (ctxt)
+    {
+        struct _internal_exr_buffer_pool* pool = lock_pool (ctxt);
+
+        for (int i = 0; i < pool->compressor_count; ++i)
+        {
+            if (pool->compressor_levels[i] == level)
+            {
+                struct libdeflate_compressor* comp = pool->compressors[i];
+
+                --(pool->compressor_count);
+                pool->compressors[i] = pool->compressors[pool->compressor_count];
+                pool->compressor_levels[i] =
+                    pool->compressor_levels[pool->compressor_count];
+                unlock_pool (pool);
+                return comp;
+            }
+        }
+        unlock_pool (pool);
+    }
+
+    return libdeflate_alloc_compressor (level);
+}
+
+void
+internal_exr_pool_release_compressor (
+    const struct _internal_exr_context* ctxt,
+    struct libdeflate_compressor*       comp,
+    int                                 level)
+{
+    if (ctxt)
+    {
+        struct _internal_exr_buffer_pool* pool = lock_pool (ctxt);
+
+        if (pool->compressor_count < EXR_DEFLATE_POOL_SIZE)
+        {
+            pool->compressors[pool->compressor_count]       = comp;
+            pool->compressor_levels[pool->compressor_count] = level;
+            ++(pool->compressor_count);
+            comp = NULL;
+        }
+        unlock_pool (pool);
+    }
+
+    if (comp) libdeflate_free_compressor (comp);
+}
+
+struct libdeflate_decompressor*
+internal_exr_pool_acquire_decompressor (
+    const struct _internal_exr_context* ctxt)
+{
+    if (ctxt)
+    {
+        struct _internal_exr_buffer_pool* pool = lock_pool (ctxt);
+
+        if (pool->decompressor_count > 0)
+        {
+            struct libdeflate_decompressor* decomp =
+                pool->decompressors[--(pool->decompressor_count)];
+            unlock_pool (pool);
+            return decomp;
+        }
+        unlock_pool (pool);
+    }
+
+    return libdeflate_alloc_decompressor ();
+}
+
+void
+internal_exr_pool_release_decompressor (
+    const struct _internal_exr_context* ctxt,
+    struct libdeflate_decompressor*     decomp)
+{
+    if (ctxt)
+    {
+        struct _internal_exr_buffer_pool* pool = lock_pool (ctxt);
+
+        if (pool->decompressor_count < EXR_DEFLATE_POOL_SIZE)
+        {
+            pool->decompressors[(pool->decompressor_count)++] = decomp;
+            decomp                                            = NULL;
+        }
+        unlock_pool (pool);
+    }
+
+    if (decomp) libdeflate_free_decompressor (decomp);
+}
+
+#endif /* OPENEXR_IMF_HAVE_LIBDEFLATE */
+
+/**************************************/
+
 void
 internal_exr_update_default_handlers (exr_context_initializer_t* inits)
 {
@@ -474,3 +755,13 @@ internal_exr_update_default_handlers (exr_context_initializer_t* inits)
     if (!inits->alloc_fn) inits->alloc_fn = &internal_exr_alloc;
     if (!inits->free_fn) inits->free_fn = &internal_exr_free;
 }
+
+void
+internal_exr_pool_stats (
+    const struct _internal_exr_context* ctxt, exr_buffer_pool_stats_t* stats)
+{
+    struct _internal_exr_buffer_pool* pool = lock_pool (ctxt);
+
+    *stats = pool->stats;
+    unlock_pool (pool);
+}
@@ -9,6 +9,7 @@
 #include "internal_attr.h"
 
 #include <IlmThreadConfig.h>
+#include <OpenEXRConfigInternal.h>
 
 #ifdef ILMTHREAD_THREADING_ENABLED
 #    ifdef _WIN32
@@ -104,12 +105,66 @@ struct _internal_exr_part
     atomic_uintptr_t chunk_table;
 };
 
+/* number of freed pipeline buffers a context holds on to */
+#define EXR_BUFFER_POOL_SIZE 32
+/* total size of the freed pipeline buffers a context holds on to */
+#define EXR_BUFFER_POOL_MAX_BYTES ((uint64_t) 64 * 1024 * 1024)
+/* a pooled buffer is only handed out for requests of at least
+ * 1 / EXR_BUFFER_POOL_MAX_SLACK its size, so small requests do not
+ * tie up the large buffers */
+#define EXR_BUFFER_POOL_MAX_SLACK 4
+
+#ifdef OPENEXR_IMF_HAVE_LIBDEFLATE
+/* number of idle libdeflate compressors and decompressors a context
+ * holds on to, each */
+#    define EXR_DEFLATE_POOL_SIZE 8
+
+struct libdeflate_compressor;
+struct libdeflate_decompressor;
+#endif
+
+struct _internal_exr_buffer_pool
+{
+    void*  buffers[EXR_BUFFER_POOL_SIZE];
+    size_t sizes[EXR_BUFFER_POOL_SIZE];
+    int    count;
+
+    exr_buffer_pool_stats_t stats;
+
+#ifdef OPENEXR_IMF_HAVE_LIBDEFLATE
+    /* idle libdeflate objects, these are expensive to create (the
+     * compressors in particular) so are kept instead of being
+     * allocated for each chunk */
+    struct libdeflate_compressor*   compressors[EXR_DEFLATE_POOL_SIZE];
+    int                             compressor_levels[EXR_DEFLATE_POOL_SIZE];
+    int                             compressor_count;
+    struct libdeflate_decompressor* decompressors[EXR_DEFLATE_POOL_SIZE];
+    int                             decompressor_count;
+#endif
+
+    /* separate from the context mutex, which is held by the encode
+     * pipeline while it allocates */
+#ifdef ILMTHREAD_THREADING_ENABLED
+#    ifdef _WIN32
+    CRITICAL_SECTION mutex;
+#    else
+    pthread_mutex_t mutex;
+#    endif
+#endif
+};
+
 enum _INTERNAL_EXR_READ_MODE
 {
     EXR_MUST_READ_ALL    = 0,
     EXR_ALLOW_SHORT_READ = 1
 };
 
+enum _INTERNAL_EXR_ACCESS_HINT
+{
+    EXR_ACCESS_SEQUENTIAL = 0,
+    EXR_ACCESS_RANDOM     = 1
+};
+
 enum _INTERNAL_EXR_CONTEXT_MODE
 {
     EXR_CONTEXT_READ          = 0,
@@ -173,6 +228,24 @@ struct _internal_exr_context
     int64_t             file_size;
     exr_read_func_ptr_t read_fn;
 
+    /* flags passed in the initializer */
+    int flags;
+
+    /* when the default file implementation has memory mapped the
+     * file, this is the mapped region, and advise_fn may be used
+     * to provide the OS with access hints */
+    const uint8_t* mapped_data;
+    uint64_t       mapped_size;
+    void (*advise_fn) (
+        const struct _internal_exr_context* file,
+        uint64_t                            offset,
+        uint64_t                            size,
+        enum _INTERNAL_EXR_ACCESS_HINT      hint);
+
+    /* optional asynchronous read routines, both or neither are set */
+    exr_read_async_func_ptr_t read_async_fn;
+    exr_wait_async_func_ptr_t wait_async_fn;
+
     exr_write_func_ptr_t write_fn;
     /* used when writing under a mutex, is there a better way? */
     uint64_t output_file_offset;
@@ -190,6 +263,10 @@ struct _internal_exr_context
 
     exr_attribute_list_t custom_handlers;
 
+    /* buffers released by encode / decode pipelines, available for
+     * reuse by later pipelines */
+    struct _internal_exr_buffer_pool buffer_pool;
+
     /* mostly needed for writing, but used during read to ensure
      * custom attribute handlers are safe */
 #ifdef ILMTHREAD_THREADING_ENABLED
@@ -339,4 +416,34 @@ exr_result_t internal_exr_alloc_context (
     size_t                           extra_data);
 void internal_exr_destroy_context (struct _internal_exr_context* ctxt);
 
+/* returns a buffer of at least bytes, from the pool if one fits,
+ * storing the real size of the buffer in actual (unchanged on
+ * failure) */
+void* internal_exr_pool_acquire (
+    const struct _internal_exr_context* ctxt, size_t bytes, size_t* actual);
+/* hands a buffer from internal_exr_pool_acquire back for reuse */
+void internal_exr_pool_release (
+    const struct _internal_exr_context* ctxt, void* buf, size_t bytes);
+void internal_exr_pool_trim (const struct _internal_exr_context* ctxt);
+
+#ifdef OPENEXR_IMF_HAVE_LIBDEFLATE
+/* returns an idle libdeflate compressor for level (0 - 9) if the
+ * context has one, or a new one, NULL on allocation failure. ctxt may
+ * be NULL, in which case nothing is cached */
+struct libdeflate_compressor* internal_exr_pool_acquire_compressor (
+    const struct _internal_exr_context* ctxt, int level);
+/* hands a compressor back, freeing it if the context has enough */
+void internal_exr_pool_release_compressor (
+    const struct _internal_exr_context* ctxt,
+    struct libdeflate_compressor*       comp,
+    int                                 level);
+struct libdeflate_decompressor* internal_exr_pool_acquire_decompressor (
+    const struct _internal_exr_context* ctxt);
+void internal_exr_pool_release_decompressor (
+    const struct _internal_exr_context* ctxt,
+    struct libdeflate_decompressor*     decomp);
+#endif
+void internal_exr_pool_stats (
+    const struct _internal_exr_context* ctxt, exr_buffer_pool_stats_t* stats);
+
 #endif /* OPENEXR_PRIVATE_STRUCTS_H */
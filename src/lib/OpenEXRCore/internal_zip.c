@@ -9,183 +9,541 @@
 #include "internal_coding.h"
 #include "internal_structs.h"
 
+#include "internal_cpuid.h"
+
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <zlib.h>
 
-#if defined __SSE2__ || (_MSC_VER >= 1300 && !_M_CEE_PURE)
-#    define IMF_HAVE_SSE2 1
-#    include <emmintrin.h>
-#    include <mmintrin.h>
+#ifdef OPENEXR_IMF_HAVE_LIBDEFLATE
+#    include <libdeflate.h>
 #endif
-#if defined __SSE4_1__
-#    define IMF_HAVE_SSE4_1 1
-#    include <smmintrin.h>
+
+/**************************************/
+
+exr_result_t
+internal_exr_deflate (
+    exr_const_context_t ctxt,
+    int                 level,
+    void*               out,
+    uint64_t            outbytes,
+    const void*         src,
+    uint64_t            srcbytes,
+    uint64_t*           actual_out)
+{
+#ifdef OPENEXR_IMF_HAVE_LIBDEFLATE
+    struct libdeflate_compressor* comp;
+    size_t                        n;
+
+    /* libdeflate has no notion of a default level, 6 matches zlib */
+    if (level < 0) level = 6;
+
+    comp = internal_exr_pool_acquire_compressor (EXR_CCTXT (ctxt), level);
+    if (!comp) return EXR_ERR_OUT_OF_MEMORY;
+
+    n = libdeflate_zlib_compress (
+        comp, src, (size_t) srcbytes, out, (size_t) outbytes);
+    internal_exr_pool_release_compressor (EXR_CCTXT (ctxt), comp, level);
+    if (n == 0) return EXR_ERR_CORRUPT_CHUNK;
+
+    *actual_out = (uint64_t) n;
+#else
+    uLongf n = (uLongf) outbytes;
+
+    (void) ctxt;
+
+    if (Z_OK != compress2 (
+                    (Bytef*) out,
+                    &n,
+                    (const Bytef*) src,
+                    (uLong) srcbytes,
+                    level))
+        return EXR_ERR_CORRUPT_CHUNK;
+
+    *actual_out = (uint64_t) n;
 #endif
+    return EXR_ERR_SUCCESS;
+}
 
 /**************************************/
 
-#ifdef IMF_HAVE_SSE4_1
+exr_result_t
+internal_exr_inflate (
+    exr_const_context_t ctxt,
+    void*               out,
+    uint64_t            outbytes,
+    const void*         src,
+    uint64_t            srcbytes,
+    uint64_t*           actual_out)
+{
+#ifdef OPENEXR_IMF_HAVE_LIBDEFLATE
+    struct libdeflate_decompressor* decomp;
+    enum libdeflate_result          res;
+    size_t                          n = 0;
+
+    decomp = internal_exr_pool_acquire_decompressor (EXR_CCTXT (ctxt));
+    if (!decomp) return EXR_ERR_OUT_OF_MEMORY;
+
+    res = libdeflate_zlib_decompress (
+        decomp, src, (size_t) srcbytes, out, (size_t) outbytes, &n);
+    internal_exr_pool_release_decompressor (EXR_CCTXT (ctxt), decomp);
+    if (res != LIBDEFLATE_SUCCESS) return EXR_ERR_CORRUPT_CHUNK;
+
+    *actual_out = (uint64_t) n;
+#else
+    uLongf n = (uLongf) outbytes;
+
+    (void) ctxt;
+
+    if (Z_OK !=
+        uncompress ((Bytef*) out, &n, (const Bytef*) src, (uLong) srcbytes))
+        return EXR_ERR_CORRUPT_CHUNK;
+
+    *actual_out = (uint64_t) n;
+#endif
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+exr_result_t
+internal_exr_zip_compression_level (
+    exr_const_context_t ctxt, int part_index, int* level)
+{
+    exr_attribute_t* zipLevel = NULL;
+    exr_result_t     rv;
+
+    EXR_PROMOTE_CONST_CONTEXT_AND_PART_OR_ERROR_NO_LOCK (ctxt, part_index);
+
+    *level = -1;
+    rv     = exr_attr_list_find_by_name (
+        EXR_CONST_CAST (exr_context_t, ctxt),
+        EXR_CONST_CAST (exr_attribute_list_t*, &(part->attributes)),
+        "zipCompressionLevel",
+        &zipLevel);
+    if (rv == EXR_ERR_SUCCESS && zipLevel && zipLevel->type == EXR_ATTR_INT &&
+        zipLevel->i >= -1 && zipLevel->i <= 9)
+        *level = zipLevel->i;
+
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
+/*
+ * The byte reordering and delta predictor shared by the ZIP and RLE
+ * codecs. The scalar tails below are also the reference versions, the
+ * SSE2 / NEON kernels are chosen at compile time and the AVX2 kernels
+ * at runtime (see internal_cpuid.h).
+ *
+ * The encoder splits the even and odd bytes into two halves of the
+ * scratch buffer, then replaces each byte (but the first) with the
+ * difference to its predecessor, offset by 128. The decoder is the
+ * inverse, where the prediction becomes a prefix sum.
+ */
+
+static inline void
+split_bytes_tail (
+    uint8_t*       t1,
+    uint8_t*       t2,
+    const uint8_t* in,
+    uint64_t       k,
+    uint64_t       count)
+{
+    uint64_t pairs = count / 2;
+
+    for (; k < pairs; ++k)
+    {
+        t1[k] = in[2 * k];
+        t2[k] = in[2 * k + 1];
+    }
+    if (count & 1) t1[pairs] = in[count - 1];
+}
+
+/* encodes buf[start, count) in place, back to front, start >= 1 */
+static inline void
+delta_encode_tail (uint8_t* buf, uint64_t start, uint64_t count)
+{
+    for (uint64_t i = count; i-- > start;)
+        buf[i] = (uint8_t) ((int) buf[i] - (int) buf[i - 1] + (128 + 256));
+}
+
+/* decodes buf[start, count) in place, start >= 1 */
+static inline void
+delta_decode_tail (uint8_t* buf, uint64_t start, uint64_t count)
+{
+    for (uint64_t i = start; i < count; ++i)
+        buf[i] = (uint8_t) ((int) buf[i - 1] + (int) buf[i] - 128);
+}
+
+static inline void
+interleave_tail (
+    uint8_t*       out,
+    const uint8_t* t1,
+    const uint8_t* t2,
+    uint64_t       k,
+    uint64_t       count)
+{
+    uint64_t pairs = count / 2;
+
+    for (; k < pairs; ++k)
+    {
+        out[2 * k]     = t1[k];
+        out[2 * k + 1] = t2[k];
+    }
+    if (count & 1) out[count - 1] = t1[pairs];
+}
+
+/**************************************/
+
+#if defined(IMF_HAVE_SSE2)
+
+static void
+deconstruct_sse2 (uint8_t* scratch, const uint8_t* in, uint64_t count)
+{
+    uint8_t*      t1     = scratch;
+    uint8_t*      t2     = scratch + (count + 1) / 2;
+    uint64_t      pairs  = count / 2;
+    uint64_t      nb     = (count - 1) / 16;
+    uint64_t      k      = 0;
+    const __m128i lomask = _mm_set1_epi16 (0x00ff);
+    const __m128i bias   = _mm_set1_epi8 ((char) 0x80);
+
+    for (; k + 16 <= pairs; k += 16)
+    {
+        __m128i a = _mm_loadu_si128 ((const __m128i*) (in + 2 * k));
+        __m128i b = _mm_loadu_si128 ((const __m128i*) (in + 2 * k + 16));
+
+        _mm_storeu_si128 (
+            (__m128i*) (t1 + k),
+            _mm_packus_epi16 (
+                _mm_and_si128 (a, lomask), _mm_and_si128 (b, lomask)));
+        _mm_storeu_si128 (
+            (__m128i*) (t2 + k),
+            _mm_packus_epi16 (_mm_srli_epi16 (a, 8), _mm_srli_epi16 (b, 8)));
+    }
+    split_bytes_tail (t1, t2, in, k, count);
+
+    /* back to front so the previous byte is still the original */
+    delta_encode_tail (scratch, 1 + nb * 16, count);
+    while (nb-- > 0)
+    {
+        uint8_t* p   = scratch + 1 + nb * 16;
+        __m128i  cur = _mm_loadu_si128 ((const __m128i*) p);
+        __m128i  prv = _mm_loadu_si128 ((const __m128i*) (p - 1));
+
+        _mm_storeu_si128 (
+            (__m128i*) p, _mm_add_epi8 (_mm_sub_epi8 (cur, prv), bias));
+    }
+}
+
 static void
-reconstruct (uint8_t* buf, uint64_t outSize)
+reconstruct_sse2 (uint8_t* out, uint8_t* scratch, uint64_t count)
 {
-    static const uint64_t bytesPerChunk = sizeof (__m128i);
-    const uint64_t        vOutSize      = outSize / bytesPerChunk;
-    const __m128i         c             = _mm_set1_epi8 (-128);
-    const __m128i         shuffleMask   = _mm_set1_epi8 (15);
-    __m128i *             vBuf, vPrev;
-    uint8_t               prev;
-
-    /*
-     * The first element doesn't have its high bit flipped during compression,
-     * so it must not be flipped here.  To make the SIMD loop nice and
-     * uniform, we pre-flip the bit so that the loop will unflip it again.
-     */
-    buf[0] += -128;
-    vBuf  = (__m128i*) buf;
-    vPrev = _mm_setzero_si128 ();
-
-    for (uint64_t i = 0; i < vOutSize; ++i)
+    const uint8_t* t1    = scratch;
+    const uint8_t* t2    = scratch + (count + 1) / 2;
+    uint64_t       pairs = count / 2;
+    uint64_t       nb    = (count - 1) / 16;
+    uint64_t       k     = 0;
+    uint8_t*       p     = scratch + 1;
+    const __m128i  bias  = _mm_set1_epi8 ((char) 0x80);
+    __m128i        prev  = _mm_set1_epi8 ((char) scratch[0]);
+
+    for (uint64_t b = 0; b < nb; ++b, p += 16)
     {
-        __m128i d = _mm_add_epi8 (_mm_loadu_si128 (vBuf), c);
+        __m128i d = _mm_add_epi8 (_mm_loadu_si128 ((const __m128i*) p), bias);
 
-        /* Compute the prefix sum of elements. */
+        /* prefix sum within the register, then add the carry in */
         d = _mm_add_epi8 (d, _mm_slli_si128 (d, 1));
         d = _mm_add_epi8 (d, _mm_slli_si128 (d, 2));
         d = _mm_add_epi8 (d, _mm_slli_si128 (d, 4));
         d = _mm_add_epi8 (d, _mm_slli_si128 (d, 8));
-        d = _mm_add_epi8 (d, vPrev);
+        d = _mm_add_epi8 (d, prev);
+        _mm_storeu_si128 ((__m128i*) p, d);
+
+        /* broadcast the last byte, SSE2 has no byte shuffle */
+        prev = _mm_unpackhi_epi8 (d, d);
+        prev = _mm_shufflehi_epi16 (prev, 0xff);
+        prev = _mm_shuffle_epi32 (prev, 0xff);
+    }
+    delta_decode_tail (scratch, 1 + nb * 16, count);
 
-        _mm_storeu_si128 (vBuf++, d);
+    for (; k + 16 <= pairs; k += 16)
+    {
+        __m128i a = _mm_loadu_si128 ((const __m128i*) (t1 + k));
+        __m128i b = _mm_loadu_si128 ((const __m128i*) (t2 + k));
 
-        // Broadcast the high byte in our result to all lanes of the prev
-        // value for the next iteration.
-        vPrev = _mm_shuffle_epi8 (d, shuffleMask);
+        _mm_storeu_si128 ((__m128i*) (out + 2 * k), _mm_unpacklo_epi8 (a, b));
+        _mm_storeu_si128 (
+            (__m128i*) (out + 2 * k + 16), _mm_unpackhi_epi8 (a, b));
     }
+    interleave_tail (out, t1, t2, k, count);
+}
 
-    prev = _mm_extract_epi8 (vPrev, 15);
-    for (uint64_t i = vOutSize * bytesPerChunk; i < outSize; ++i)
+#endif /* IMF_HAVE_SSE2 */
+
+/**************************************/
+
+#if defined(EXR_HAVE_AVX2_TARGET)
+
+EXR_TARGET_AVX2 static void
+deconstruct_avx2 (uint8_t* scratch, const uint8_t* in, uint64_t count)
+{
+    uint8_t*      t1     = scratch;
+    uint8_t*      t2     = scratch + (count + 1) / 2;
+    uint64_t      pairs  = count / 2;
+    uint64_t      nb     = (count - 1) / 32;
+    uint64_t      k      = 0;
+    const __m256i lomask = _mm256_set1_epi16 (0x00ff);
+    const __m256i bias   = _mm256_set1_epi8 ((char) 0x80);
+
+    for (; k + 32 <= pairs; k += 32)
+    {
+        __m256i a = _mm256_loadu_si256 ((const __m256i*) (in + 2 * k));
+        __m256i b = _mm256_loadu_si256 ((const __m256i*) (in + 2 * k + 32));
+        __m256i e = _mm256_packus_epi16 (
+            _mm256_and_si256 (a, lomask), _mm256_and_si256 (b, lomask));
+        __m256i o = _mm256_packus_epi16 (
+            _mm256_srli_epi16 (a, 8), _mm256_srli_epi16 (b, 8));
+
+        /* packus works per 128 bit lane, put the quadwords back in order */
+        _mm256_storeu_si256 (
+            (__m256i*) (t1 + k), _mm256_permute4x64_epi64 (e, 0xd8));
+        _mm256_storeu_si256 (
+            (__m256i*) (t2 + k), _mm256_permute4x64_epi64 (o, 0xd8));
+    }
+    split_bytes_tail (t1, t2, in, k, count);
+
+    delta_encode_tail (scratch, 1 + nb * 32, count);
+    while (nb-- > 0)
     {
-        uint8_t d = prev + buf[i] - 128;
-        buf[i]    = d;
-        prev      = d;
+        uint8_t* p   = scratch + 1 + nb * 32;
+        __m256i  cur = _mm256_loadu_si256 ((const __m256i*) p);
+        __m256i  prv = _mm256_loadu_si256 ((const __m256i*) (p - 1));
+
+        _mm256_storeu_si256 (
+            (__m256i*) p, _mm256_add_epi8 (_mm256_sub_epi8 (cur, prv), bias));
     }
 }
-#else
-static void
-reconstruct (uint8_t* buf, uint64_t sz)
+
+EXR_TARGET_AVX2 static void
+reconstruct_avx2 (uint8_t* out, uint8_t* scratch, uint64_t count)
 {
-    uint8_t* t    = buf + 1;
-    uint8_t* stop = buf + sz;
-    while (t < stop)
+    const uint8_t* t1    = scratch;
+    const uint8_t* t2    = scratch + (count + 1) / 2;
+    uint64_t       pairs = count / 2;
+    uint64_t       nb    = (count - 1) / 32;
+    uint64_t       k     = 0;
+    uint8_t*       p     = scratch + 1;
+    const __m256i  bias  = _mm256_set1_epi8 ((char) 0x80);
+    const __m256i  last  = _mm256_set1_epi8 (15);
+    __m256i        prev  = _mm256_set1_epi8 ((char) scratch[0]);
+
+    for (uint64_t b = 0; b < nb; ++b, p += 32)
     {
-        int d = (int) (t[-1]) + (int) (t[0]) - 128;
-        t[0]  = (uint8_t) d;
-        ++t;
+        __m256i d =
+            _mm256_add_epi8 (_mm256_loadu_si256 ((const __m256i*) p), bias);
+        __m256i c;
+
+        d = _mm256_add_epi8 (d, _mm256_slli_si256 (d, 1));
+        d = _mm256_add_epi8 (d, _mm256_slli_si256 (d, 2));
+        d = _mm256_add_epi8 (d, _mm256_slli_si256 (d, 4));
+        d = _mm256_add_epi8 (d, _mm256_slli_si256 (d, 8));
+
+        /* carry the total of the low lane into the high lane */
+        c = _mm256_shuffle_epi8 (d, last);
+        d = _mm256_add_epi8 (d, _mm256_permute2x128_si256 (c, c, 0x08));
+        d = _mm256_add_epi8 (d, prev);
+        _mm256_storeu_si256 ((__m256i*) p, d);
+
+        c    = _mm256_shuffle_epi8 (d, last);
+        prev = _mm256_permute2x128_si256 (c, c, 0x11);
     }
+    delta_decode_tail (scratch, 1 + nb * 32, count);
+
+    for (; k + 32 <= pairs; k += 32)
+    {
+        __m256i a  = _mm256_loadu_si256 ((const __m256i*) (t1 + k));
+        __m256i b  = _mm256_loadu_si256 ((const __m256i*) (t2 + k));
+        __m256i lo = _mm256_unpacklo_epi8 (a, b);
+        __m256i hi = _mm256_unpackhi_epi8 (a, b);
+
+        _mm256_storeu_si256 (
+            (__m256i*) (out + 2 * k), _mm256_permute2x128_si256 (lo, hi, 0x20));
+        _mm256_storeu_si256 (
+            (__m256i*) (out + 2 * k + 32),
+            _mm256_permute2x128_si256 (lo, hi, 0x31));
+    }
+    interleave_tail (out, t1, t2, k, count);
+}
+
+/*
+ * Only ever transitions from -1 to the same answer, so racing threads
+ * are harmless.
+ */
+static int
+has_avx2 (void)
+{
+    static int avx2 = -1;
+    if (avx2 < 0) avx2 = check_for_x86_avx2 ();
+    return avx2;
 }
-#endif
+
+#endif /* EXR_HAVE_AVX2_TARGET */
 
 /**************************************/
 
-#ifdef IMF_HAVE_SSE2
+#if defined(IMF_HAVE_NEON)
+
 static void
-interleave (uint8_t* out, const uint8_t* source, uint64_t outSize)
+deconstruct_neon (uint8_t* scratch, const uint8_t* in, uint64_t count)
 {
-    static const uint64_t bytesPerChunk = 2 * sizeof (__m128i);
-    const uint64_t        vOutSize      = outSize / bytesPerChunk;
-    const __m128i*        v1            = (const __m128i*) source;
-    const __m128i*        v2   = (const __m128i*) (source + (outSize + 1) / 2);
-    __m128i*              vOut = (__m128i*) out;
-    const uint8_t *       t1, *t2;
-    uint8_t*              sOut;
-
-    for (uint64_t i = 0; i < vOutSize; ++i)
+    uint8_t*         t1    = scratch;
+    uint8_t*         t2    = scratch + (count + 1) / 2;
+    uint64_t         pairs = count / 2;
+    uint64_t         nb    = (count - 1) / 16;
+    uint64_t         k     = 0;
+    const uint8x16_t bias  = vdupq_n_u8 (0x80);
+
+    for (; k + 16 <= pairs; k += 16)
     {
-        __m128i a  = _mm_loadu_si128 (v1++);
-        __m128i b  = _mm_loadu_si128 (v2++);
-        __m128i lo = _mm_unpacklo_epi8 (a, b);
-        __m128i hi = _mm_unpackhi_epi8 (a, b);
-
-        _mm_storeu_si128 (vOut++, lo);
-        _mm_storeu_si128 (vOut++, hi);
+        uint8x16x2_t v = vld2q_u8 (in + 2 * k);
+        vst1q_u8 (t1 + k, v.val[0]);
+        vst1q_u8 (t2 + k, v.val[1]);
     }
+    split_bytes_tail (t1, t2, in, k, count);
 
-    t1   = (const uint8_t*) v1;
-    t2   = (const uint8_t*) v2;
-    sOut = (uint8_t*) vOut;
+    delta_encode_tail (scratch, 1 + nb * 16, count);
+    while (nb-- > 0)
+    {
+        uint8_t*   p   = scratch + 1 + nb * 16;
+        uint8x16_t cur = vld1q_u8 (p);
+        uint8x16_t prv = vld1q_u8 (p - 1);
 
-    for (uint64_t i = vOutSize * bytesPerChunk; i < outSize; ++i)
-        *(sOut++) = (i % 2 == 0) ? *(t1++) : *(t2++);
+        vst1q_u8 (p, vaddq_u8 (vsubq_u8 (cur, prv), bias));
+    }
 }
 
-#else
-
 static void
-interleave (uint8_t* out, const uint8_t* source, uint64_t outSize)
+reconstruct_neon (uint8_t* out, uint8_t* scratch, uint64_t count)
 {
-    const char* t1   = source;
-    const char* t2   = source + (outSize + 1) / 2;
-    char*       s    = out;
-    char* const stop = s + outSize;
+    const uint8_t*   t1    = scratch;
+    const uint8_t*   t2    = scratch + (count + 1) / 2;
+    uint64_t         pairs = count / 2;
+    uint64_t         nb    = (count - 1) / 16;
+    uint64_t         k     = 0;
+    uint8_t*         p     = scratch + 1;
+    const uint8x16_t zero  = vdupq_n_u8 (0);
+    const uint8x16_t bias  = vdupq_n_u8 (0x80);
+    uint8x16_t       prev  = vdupq_n_u8 (scratch[0]);
+
+    for (uint64_t b = 0; b < nb; ++b, p += 16)
+    {
+        uint8x16_t d = vaddq_u8 (vld1q_u8 (p), bias);
+
+        d = vaddq_u8 (d, vextq_u8 (zero, d, 15));
+        d = vaddq_u8 (d, vextq_u8 (zero, d, 14));
+        d = vaddq_u8 (d, vextq_u8 (zero, d, 12));
+        d = vaddq_u8 (d, vextq_u8 (zero, d, 8));
+        d = vaddq_u8 (d, prev);
+        vst1q_u8 (p, d);
 
-    while (true)
+        prev = vdupq_n_u8 (vgetq_lane_u8 (d, 15));
+    }
+    delta_decode_tail (scratch, 1 + nb * 16, count);
+
+    for (; k + 16 <= pairs; k += 16)
     {
-        if (s < stop)
-            *(s++) = *(t1++);
-        else
-            break;
-
-        if (s < stop)
-            *(s++) = *(t2++);
-        else
-            break;
+        uint8x16x2_t v;
+        v.val[0] = vld1q_u8 (t1 + k);
+        v.val[1] = vld1q_u8 (t2 + k);
+        vst2q_u8 (out + 2 * k, v);
     }
+    interleave_tail (out, t1, t2, k, count);
 }
 
-#endif
+#endif /* IMF_HAVE_NEON */
 
 /**************************************/
 
-static exr_result_t
-undo_zip_impl (
-    const void* compressed_data,
-    uint64_t    comp_buf_size,
-    void*       uncompressed_data,
-    uint64_t    uncompressed_size,
-    void*       scratch_data,
-    uint64_t    scratch_size)
+void
+internal_zip_deconstruct_bytes (
+    uint8_t* scratch, const uint8_t* source, uint64_t count)
 {
-    uLongf outSize = (uLongf) uncompressed_size;
-    int    rstat;
-
-    if (scratch_size < uncompressed_size) return EXR_ERR_INVALID_ARGUMENT;
+    if (count == 0) return;
 
-    rstat = uncompress (
-        (Bytef*) scratch_data,
-        &outSize,
-        (const Bytef*) compressed_data,
-        (uLong) comp_buf_size);
-    if (rstat == Z_OK)
+#if defined(EXR_HAVE_AVX2_TARGET)
+    if (has_avx2 ())
     {
-        if (outSize == uncompressed_size)
-        {
-            reconstruct (scratch_data, outSize);
-            interleave (uncompressed_data, scratch_data, outSize);
-            rstat = EXR_ERR_SUCCESS;
-        }
-        else
-        {
-            rstat = EXR_ERR_CORRUPT_CHUNK;
-        }
+        deconstruct_avx2 (scratch, source, count);
+        return;
     }
-    else
+#endif
+#if defined(IMF_HAVE_SSE2)
+    deconstruct_sse2 (scratch, source, count);
+#elif defined(IMF_HAVE_NEON)
+    deconstruct_neon (scratch, source, count);
+#else
+    split_bytes_tail (
+        scratch, scratch + (count + 1) / 2, source, 0, count);
+    delta_encode_tail (scratch, 1, count);
+#endif
+}
+
+/**************************************/
+
+void
+internal_zip_reconstruct_bytes (
+    uint8_t* out, uint8_t* scratch, uint64_t count)
+{
+    if (count == 0) return;
+
+#if defined(EXR_HAVE_AVX2_TARGET)
+    if (has_avx2 ())
     {
-        rstat = EXR_ERR_CORRUPT_CHUNK;
+        reconstruct_avx2 (out, scratch, count);
+        return;
     }
+#endif
+#if defined(IMF_HAVE_SSE2)
+    reconstruct_sse2 (out, scratch, count);
+#elif defined(IMF_HAVE_NEON)
+    reconstruct_neon (out, scratch, count);
+#else
+    delta_decode_tail (scratch, 1, count);
+    interleave_tail (out, scratch, scratch + (count + 1) / 2, 0, count);
+#endif
+}
+/**************************************/
+
+exr_result_t
+internal_zip_decompress (
+    exr_const_context_t ctxt,
+    const void*         compressed_data,
+    uint64_t            comp_buf_size,
+    void*               uncompressed_data,
+    uint64_t            uncompressed_size,
+    void*               scratch_data,
+    uint64_t            scratch_size)
+{
+    uint64_t     outSize = 0;
+    exr_result_t rv;
+
+    if (scratch_size < uncompressed_size) return EXR_ERR_INVALID_ARGUMENT;
+
+    rv = internal_exr_inflate (
+        ctxt,
+        scratch_data,
+        uncompressed_size,
+        compressed_data,
+        comp_buf_size,
+        &outSize);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+    if (outSize != uncompressed_size) return EXR_ERR_CORRUPT_CHUNK;
 
-    return (exr_result_t) rstat;
+    internal_zip_reconstruct_bytes (uncompressed_data, scratch_data, outSize);
+    return EXR_ERR_SUCCESS;
 }
 
 /**************************************/
@@ -206,7 +564,8 @@ internal_exr_undo_zip (
         &(decode->scratch_alloc_size_1),
         uncompressed_size);
     if (rv != EXR_ERR_SUCCESS) return rv;
-    return undo_zip_impl (
+    return internal_zip_decompress (
+        decode->context,
         compressed_data,
         comp_buf_size,
         uncompressed_data,
@@ -217,45 +576,58 @@ internal_exr_undo_zip (
 
 /**************************************/
 
+exr_result_t
+internal_zip_compress (
+    exr_const_context_t ctxt,
+    uint64_t*           compressed_size,
+    void*               compressed_data,
+    uint64_t            comp_buf_size,
+    const void*         raw_data,
+    uint64_t            raw_size,
+    void*               scratch_data,
+    uint64_t            scratch_size,
+    int                 level)
+{
+    if (scratch_size < raw_size) return EXR_ERR_INVALID_ARGUMENT;
+
+    internal_zip_deconstruct_bytes (scratch_data, raw_data, raw_size);
+
+    return internal_exr_deflate (
+        ctxt,
+        level,
+        compressed_data,
+        comp_buf_size,
+        scratch_data,
+        raw_size,
+        compressed_size);
+}
+
+/**************************************/
+
 static exr_result_t
 apply_zip_impl (exr_encode_pipeline_t* encode)
 {
-    uint8_t*       t1   = encode->scratch_buffer_1;
-    uint8_t*       t2   = t1 + (encode->packed_bytes + 1) / 2;
-    const uint8_t* raw  = encode->packed_buffer;
-    const uint8_t* stop = raw + encode->packed_bytes;
-    int            p;
-    uLongf         compbufsz = encode->compressed_alloc_size;
-
-    /* reorder */
-    while (raw < stop)
-    {
-        *(t1++) = *(raw++);
-        if (raw < stop) *(t2++) = *(raw++);
-    }
+    exr_result_t rv;
+    uint64_t     compbufsz;
+    int          level;
 
-    /* reorder */
-    t1 = encode->scratch_buffer_1;
-    t2 = t1 + encode->packed_bytes;
-    t1++;
-    p = (int) t1[-1];
-    while (t1 < t2)
-    {
-        int d = (int) (t1[0]) - p + (128 + 256);
-        p     = (int) t1[0];
-        t1[0] = (uint8_t) d;
-        ++t1;
-    }
+    rv = internal_exr_zip_compression_level (
+        encode->context, encode->part_index, &level);
+    if (rv != EXR_ERR_SUCCESS) return rv;
 
-    if (Z_OK != compress (
-                    (Bytef*) encode->compressed_buffer,
-                    &compbufsz,
-                    (const Bytef*) encode->scratch_buffer_1,
-                    encode->packed_bytes))
-    {
-        return EXR_ERR_CORRUPT_CHUNK;
-    }
-    if (compbufsz > encode->packed_bytes)
+    rv = internal_zip_compress (
+        encode->context,
+        &compbufsz,
+        encode->compressed_buffer,
+        encode->compressed_alloc_size,
+        encode->packed_buffer,
+        encode->packed_bytes,
+        encode->scratch_buffer_1,
+        encode->scratch_alloc_size_1,
+        level);
+    if (rv != EXR_ERR_SUCCESS) return rv;
+
+    if (compbufsz >= encode->packed_bytes)
     {
         memcpy (
             encode->compressed_buffer,
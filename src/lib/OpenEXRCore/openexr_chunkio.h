@@ -72,6 +72,43 @@ exr_result_t exr_read_chunk (
     const exr_chunk_info_t* cinfo,
     void*                   packed_data);
 
+/** Read the packed data blocks for a set of chunks
+ *
+ * This is equivalent to calling @sa exr_read_chunk for each of the
+ * @param count entries in @param cinfos, reading into the matching
+ * buffer in @param packed_data, but chunks which are adjacent in the
+ * file are merged into a single, larger read. This significantly
+ * reduces the number of read requests when reading many small chunks
+ * (i.e. ZIPS or RLE compressed scanlines), which is especially
+ * important for network filesystems.
+ *
+ * The chunks do not need to be sorted, but as with @sa exr_read_chunk
+ * each buffer must be large enough to hold the packed_size bytes of the
+ * corresponding chunk.
+ */
+EXR_EXPORT
+exr_result_t exr_read_chunks (
+    exr_const_context_t     ctxt,
+    int                     part_index,
+    int                     count,
+    const exr_chunk_info_t* cinfos,
+    void* const*            packed_data);
+
+/** Retrieve a pointer to the packed data block for a chunk without copying
+ *
+ * This is only available when the context was started with @sa
+ * EXR_CONTEXT_FLAG_MEMORY_MAP_READ and the file was able to be memory
+ * mapped, otherwise EXR_ERR_NOT_OPEN_READ is returned and @sa
+ * exr_read_chunk should be used instead. The returned pointer is
+ * valid until the context is finished, and must not be written to.
+ */
+EXR_EXPORT
+exr_result_t exr_read_chunk_mapped (
+    exr_const_context_t     ctxt,
+    int                     part_index,
+    const exr_chunk_info_t* cinfo,
+    const void**            packed_data);
+
 /**
  * Read chunk for deep data.
  *
@@ -163,6 +163,68 @@ typedef int64_t (*exr_write_func_ptr_t) (
     uint64_t                    offset,
     exr_stream_error_func_ptr_t error_cb);
 
+/** @brief Request for an asynchronous read of a custom stream
+ *
+ * The buffer, size and offset are filled in by the library prior to
+ * calling the @sa exr_read_async_func_ptr_t. When the request
+ * completes, the provider fills in nread with the number of bytes
+ * read (or -1 upon error), with semantics similar to the return value
+ * of @sa exr_read_func_ptr_t.
+ *
+ * The provider_data member is reserved for the provider to track the
+ * request while it is outstanding.
+ */
+typedef struct _exr_async_read_request
+{
+    void*    buffer;
+    uint64_t size;
+    uint64_t offset;
+    int64_t  nread;
+    void*    provider_data;
+} exr_async_read_request_t;
+
+/** @brief Asynchronous read submission custom function pointer
+ *
+ * Used to start a read from a custom input without waiting for the
+ * data to arrive, such that the library can decompress data which has
+ * arrived while other reads are outstanding. Expects similar semantics
+ * to aio_read or ReadFileEx under win32.
+ *
+ * Should return EXR_ERR_SUCCESS if the request has been queued. The
+ * request structure and buffer will remain valid until the request is
+ * reported as completed by the @sa exr_wait_async_func_ptr_t.
+ *
+ * The same thread-safety requirements apply as for @sa
+ * exr_read_func_ptr_t, although the requests from a single call to
+ * @sa exr_decoding_read_chunks_async are all submitted and completed
+ * from the calling thread.
+ */
+typedef exr_result_t (*exr_read_async_func_ptr_t) (
+    exr_const_context_t         ctxt,
+    void*                       userdata,
+    exr_async_read_request_t*   request,
+    exr_stream_error_func_ptr_t error_cb);
+
+/** @brief Asynchronous read completion custom function pointer
+ *
+ * Waits until at least one of the count outstanding requests
+ * previously submitted with the @sa exr_read_async_func_ptr_t has
+ * completed, fills in nread for it, and places the index of the
+ * request in the requests array into completed. The provider is then
+ * done with that request, and any provider_data it holds should be
+ * released.
+ *
+ * If an error is returned, the library will stop waiting on the
+ * remaining requests, so the provider should have cancelled them.
+ */
+typedef exr_result_t (*exr_wait_async_func_ptr_t) (
+    exr_const_context_t              ctxt,
+    void*                            userdata,
+    exr_async_read_request_t* const* requests,
+    int                              count,
+    int*                             completed,
+    exr_stream_error_func_ptr_t      error_cb);
+
 /** @brief struct used to pass function pointers into the context
  * initialization routines.
  *
@@ -287,12 +349,57 @@ typedef struct _exr_context_initializer
      * allowed by the context is. @sa exr_set_maximum_tile_size to
      * understand how this interacts with global defaults */
     int max_tile_height;
+
+    /** @brief bit-wise or of the EXR_CONTEXT_FLAG_* values below to
+     * control optional behavior of the context.
+     *
+     * Only consulted when the @sa size member indicates the caller
+     * was compiled against a version of this struct containing it.
+     */
+    int flags;
+
+    /** @brief optional custom asynchronous read submission routine.
+     *
+     * This is only used along with a custom @sa read_fn, and @sa
+     * wait_async_fn must be provided as well. When reading normal
+     * filesystem files with the internal implementation, the platform
+     * asynchronous I/O facility is used where available.
+     *
+     * If not provided, @sa exr_decoding_read_chunks_async will issue
+     * the reads synchronously with @sa read_fn instead.
+     *
+     * @sa exr_read_async_func_ptr_t
+     */
+    exr_read_async_func_ptr_t read_async_fn;
+
+    /** @brief custom routine to wait for the completion of reads
+     * submitted with @sa read_async_fn.
+     *
+     * @sa exr_wait_async_func_ptr_t
+     */
+    exr_wait_async_func_ptr_t wait_async_fn;
 } exr_context_initializer_t;
 
+/** @brief Request that files opened for read using the internal file
+ * implementation are memory mapped, instead of read with a seek / read
+ * pair per request.
+ *
+ * When a file is memory mapped, the default decode pipeline will point
+ * the packed buffer directly at the mapped file data instead of
+ * allocating a buffer and copying each chunk, and @sa
+ * exr_read_chunk_mapped is available to retrieve the same pointer.
+ *
+ * This is ignored if a custom @sa read_fn is provided, or if the
+ * platform or file does not support memory mapping, in which case
+ * the normal read routines are used.
+ */
+#define EXR_CONTEXT_FLAG_MEMORY_MAP_READ (1 << 0)
+
 /** @brief simple macro to initialize the context initializer with default values */
 #define EXR_DEFAULT_CONTEXT_INITIALIZER                                        \
     {                                                                          \
-        sizeof (exr_context_initializer_t), 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 \
+        sizeof (exr_context_initializer_t), 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,   \
+            0, 0, 0, 0                                                         \
     }
 
 /** @} */ /* context function pointer declarations */
@@ -420,6 +527,49 @@ exr_get_file_name (exr_const_context_t ctxt, const char** name);
 EXR_EXPORT exr_result_t
 exr_get_user_data (exr_const_context_t ctxt, void** userdata);
 
+/** @brief Counters describing the reuse of the buffers used by the
+ * encode and decode pipelines.
+ *
+ * When a pipeline uses the default allocation (no custom alloc_fn /
+ * free_fn in the pipeline), the buffers it frees are held by the
+ * context, and handed to later pipelines needing a buffer of that
+ * size or somewhat smaller, so repeated initialize / destroy cycles
+ * do not go back to the allocator each time. The pool holds a
+ * bounded number and total size of buffers, beyond that the smallest
+ * are freed. The pooled buffers are freed when the context is
+ * finished, or by @sa exr_trim_buffer_pool.
+ */
+typedef struct
+{
+    /** buffers allocated because no pooled buffer was large enough */
+    uint64_t allocations;
+    /** requests satisfied with a pooled buffer */
+    uint64_t reuses;
+    /** buffers handed back to the pool by a pipeline */
+    uint64_t releases;
+    /** buffers freed because the pool was full, or it was trimmed */
+    uint64_t frees;
+    /** number of buffers currently held by the pool */
+    uint64_t pooled_buffers;
+    /** total size of the buffers currently held by the pool */
+    uint64_t pooled_bytes;
+} exr_buffer_pool_stats_t;
+
+/** @brief Retrieves the buffer pool counters for the context.
+ *
+ * This is safe to call while other threads are running pipelines,
+ * the counters are a snapshot of the state at the time of the call.
+ */
+EXR_EXPORT exr_result_t exr_get_buffer_pool_stats (
+    exr_const_context_t ctxt, exr_buffer_pool_stats_t* stats);
+
+/** @brief Frees any buffers currently held by the context buffer pool.
+ *
+ * Buffers in use by pipelines are unaffected, and will be pooled
+ * again as they are freed.
+ */
+EXR_EXPORT exr_result_t exr_trim_buffer_pool (exr_const_context_t ctxt);
+
 /** Any opaque attribute data entry of the specified type is tagged
  * with these functions enabling downstream users to unpack (or pack)
  * the data.
@@ -276,6 +276,70 @@ exr_result_t exr_decoding_update (
     const exr_chunk_info_t* cinfo,
     exr_decode_pipeline_t*  decode);
 
+/** Read the packed data for a set of decode pipelines at once
+ *
+ * Each pipeline must have been initialized (or updated) with the chunk
+ * it is to decode, and have had the default routines chosen. The
+ * packed data for all of them is read using @sa exr_read_chunks, such
+ * that adjacent chunks are merged into larger reads, and the
+ * subsequent @sa exr_decoding_run for each pipeline will skip the read
+ * step and only decompress and unpack. The pipelines can then be run
+ * in parallel.
+ *
+ * Pipelines with a custom read_fn, or which read uncompressed data
+ * directly into the destination, are left to read their own data.
+ */
+EXR_EXPORT
+exr_result_t exr_decoding_read_chunks (
+    exr_const_context_t           ctxt,
+    int                           part_index,
+    int                           count,
+    exr_decode_pipeline_t* const* decoders);
+
+/** Function called by @sa exr_decoding_read_chunks_async as the data
+ * for each decode pipeline becomes available.
+ *
+ * The @param rv argument indicates whether the read succeeded. If it
+ * did, the pipeline is ready for @sa exr_decoding_run, which would
+ * typically be dispatched to a worker thread. Returning anything other
+ * than EXR_ERR_SUCCESS stops any further reads from being started, and
+ * the value is returned from @sa exr_decoding_read_chunks_async
+ */
+typedef exr_result_t (*exr_decoding_ready_func_ptr_t) (
+    exr_decode_pipeline_t* decode, exr_result_t rv, void* userdata);
+
+/** Read the packed data for a set of decode pipelines asynchronously
+ *
+ * Similar to @sa exr_decoding_read_chunks, but instead of waiting for
+ * all of the data to be read, a bounded number of reads are kept
+ * outstanding using the asynchronous read routines of the context,
+ * and @param ready_fn is called (from the calling thread) as each
+ * completes, in whatever order that happens, such that decompression
+ * of the chunks which have arrived can overlap the remaining reads.
+ *
+ * When reading normal filesystem files, the internal implementation
+ * uses POSIX asynchronous I/O where available. For custom streams, the
+ * @sa read_async_fn and @sa wait_async_fn members of the context
+ * initializer provide the same.
+ *
+ * Pipelines which can not have their data read ahead (deep data,
+ * memory mapped files, a custom read_fn, or when there are no
+ * asynchronous read routines) are immediately passed to @param
+ * ready_fn, and will read their own data when run.
+ *
+ * This does not return until every pipeline has been passed to @param
+ * ready_fn (or an error stops it early), although those pipelines may
+ * still be running elsewhere.
+ */
+EXR_EXPORT
+exr_result_t exr_decoding_read_chunks_async (
+    exr_const_context_t           ctxt,
+    int                           part_index,
+    int                           count,
+    exr_decode_pipeline_t* const* decoders,
+    exr_decoding_ready_func_ptr_t ready_fn,
+    void*                         ready_userdata);
+
 /** Execute the decoding pipeline */
 EXR_EXPORT
 exr_result_t exr_decoding_run (
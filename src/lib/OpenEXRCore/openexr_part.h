@@ -312,6 +312,22 @@ EXR_EXPORT exr_result_t exr_get_compression (
 EXR_EXPORT exr_result_t exr_set_compression (
     exr_context_t ctxt, int part_index, exr_compression_t ctype);
 
+/** @brief Retrieves the zlib compression level used when writing the
+ * specified part with ZIP, ZIPS or PXR24 compression.
+ *
+ * This is stored in the optional zipCompressionLevel attribute, when
+ * that is not present @p level is set to -1, the zlib default.
+ */
+EXR_EXPORT exr_result_t exr_get_zip_compression_level (
+    exr_const_context_t ctxt, int part_index, int* level);
+/** @brief Sets the zlib compression level (0 - 9, or -1 for the
+ * default) used when writing the specified part with ZIP, ZIPS or
+ * PXR24 compression. Lower levels are faster, but produce larger
+ * files.
+ */
+EXR_EXPORT exr_result_t exr_set_zip_compression_level (
+    exr_context_t ctxt, int part_index, int level);
+
 /** @brief Retrieves the data window for the specified part. */
 EXR_EXPORT exr_result_t exr_get_data_window (
     exr_const_context_t ctxt, int part_index, exr_attr_box2i_t* out);
@@ -49,6 +49,7 @@ worldToNDC
 deepImageState
 originalDataWindow
 dwaCompressionLevel
+zipCompressionLevel
 */
 
 /** @} */
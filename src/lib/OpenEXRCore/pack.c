@@ -6,8 +6,12 @@
 #include "openexr_encode.h"
 
 #include "internal_coding.h"
+#include "internal_convert.h"
+#include "internal_cpuid.h"
 #include "internal_xdr.h"
 
+#include <string.h>
+
 /**************************************/
 
 static exr_result_t
@@ -17,6 +21,84 @@ default_pack_deep (exr_encode_pipeline_t* encode)
     return EXR_ERR_INVALID_ARGUMENT;
 }
 
+/**************************************/
+
+/*
+ * The type conversions go through the (vector) buffer conversions,
+ * gathering strided input into a small block first. Those produce
+ * native byte order, swapped in place afterwards on big endian hosts.
+ */
+#define PACK_CONVERT_BLOCK 64
+
+#if EXR_HOST_IS_NOT_LITTLE_ENDIAN
+#    define PACK_SWAP_OUTPUT(outtype)                                          \
+        for (int x = 0; x < w; ++x)                                            \
+        {                                                                      \
+            uint8_t* o = dst + (size_t) x * sizeof (outtype);                  \
+            if (sizeof (outtype) == 2)                                         \
+            {                                                                  \
+                uint16_t v;                                                    \
+                memcpy (&v, o, sizeof (v));                                    \
+                unaligned_store16 (o, v);                                      \
+            }                                                                  \
+            else                                                               \
+            {                                                                  \
+                uint32_t v;                                                    \
+                memcpy (&v, o, sizeof (v));                                    \
+                unaligned_store32 (o, v);                                      \
+            }                                                                  \
+        }
+#else
+#    define PACK_SWAP_OUTPUT(outtype)
+#endif
+
+#define PACK_CONVERT_FUNC(name, intype, outtype, convfn)                       \
+    static void name (uint8_t* dst, const uint8_t* cdata, int pixinc, int w)   \
+    {                                                                          \
+        outtype* out = (outtype*) dst;                                         \
+        if (pixinc == (int) sizeof (intype))                                   \
+            convfn (out, (const intype*) cdata, (uint64_t) w);                 \
+        else                                                                   \
+        {                                                                      \
+            intype tmp[PACK_CONVERT_BLOCK];                                    \
+            for (int x = 0; x < w; x += PACK_CONVERT_BLOCK)                    \
+            {                                                                  \
+                int n = w - x;                                                 \
+                if (n > PACK_CONVERT_BLOCK) n = PACK_CONVERT_BLOCK;            \
+                for (int i = 0; i < n; ++i)                                    \
+                {                                                              \
+                    tmp[i] = *((const intype*) cdata);                         \
+                    cdata += pixinc;                                           \
+                }                                                              \
+                convfn (out + x, tmp, (uint64_t) n);                           \
+            }                                                                  \
+        }                                                                      \
+        PACK_SWAP_OUTPUT (outtype)                                             \
+    }
+
+PACK_CONVERT_FUNC (
+    pack_float_to_half,
+    float,
+    uint16_t,
+    internal_exr_float_to_half_buffer)
+PACK_CONVERT_FUNC (
+    pack_uint_to_half,
+    uint32_t,
+    uint16_t,
+    internal_exr_uint_to_half_buffer)
+PACK_CONVERT_FUNC (
+    pack_half_to_float,
+    uint16_t,
+    float,
+    internal_exr_half_to_float_buffer)
+PACK_CONVERT_FUNC (
+    pack_half_to_uint,
+    uint16_t,
+    uint32_t,
+    internal_exr_half_to_uint_buffer)
+
+/**************************************/
+
 static exr_result_t
 default_pack (exr_encode_pipeline_t* encode)
 {
@@ -71,48 +153,24 @@ default_pack (exr_encode_pipeline_t* encode)
                             }
                             break;
                         }
-                        case EXR_PIXEL_FLOAT: {
-                            uint16_t* dst = (uint16_t*) dstbuffer;
-                            for (int x = 0; x < w; ++x)
-                            {
-                                uint16_t cval =
-                                    float_to_half (*((const float*) cdata));
-                                unaligned_store16( dst, cval );
-                                ++dst;
-                                cdata += pixincrement;
-                            }
+                        case EXR_PIXEL_FLOAT:
+                            pack_float_to_half (
+                                dstbuffer, cdata, pixincrement, w);
                             break;
-                        }
-                        case EXR_PIXEL_UINT: {
-                            uint16_t* dst = (uint16_t*) dstbuffer;
-                            for (int x = 0; x < w; ++x)
-                            {
-                                uint16_t cval =
-                                    uint_to_half (*((const uint32_t*) cdata));
-                                unaligned_store16( dst, cval );
-                                ++dst;
-                                cdata += pixincrement;
-                            }
+                        case EXR_PIXEL_UINT:
+                            pack_uint_to_half (
+                                dstbuffer, cdata, pixincrement, w);
                             break;
-                        }
                         default: return EXR_ERR_INVALID_ARGUMENT;
                     }
                     break;
                 case EXR_PIXEL_FLOAT:
                     switch (encc->user_data_type)
                     {
-                        case EXR_PIXEL_HALF: {
-                            uint32_t* dst = (uint32_t*) dstbuffer;
-                            for (int x = 0; x < w; ++x)
-                            {
-                                uint32_t fint = half_to_float_int (
-                                    *((const uint16_t*) cdata));
-                                unaligned_store32( dst, fint );
-                                ++dst;
-                                cdata += pixincrement;
-                            }
+                        case EXR_PIXEL_HALF:
+                            pack_half_to_float (
+                                dstbuffer, cdata, pixincrement, w);
                             break;
-                        }
                         case EXR_PIXEL_FLOAT: {
                             uint32_t* dst = (uint32_t*) dstbuffer;
                             for (int x = 0; x < w; ++x)
@@ -141,17 +199,10 @@ default_pack (exr_encode_pipeline_t* encode)
                 case EXR_PIXEL_UINT:
                     switch (encc->user_data_type)
                     {
-                        case EXR_PIXEL_HALF: {
-                            uint32_t* dst = (uint32_t*) dstbuffer;
-                            for (int x = 0; x < w; ++x)
-                            {
-                                uint16_t tmp = *((const uint16_t*) cdata);
-                                unaligned_store32( dst, half_to_uint(tmp) );
-                                ++dst;
-                                cdata += pixincrement;
-                            }
+                        case EXR_PIXEL_HALF:
+                            pack_half_to_uint (
+                                dstbuffer, cdata, pixincrement, w);
                             break;
-                        }
                         case EXR_PIXEL_FLOAT: {
                             uint32_t* dst = (uint32_t*) dstbuffer;
                             for (int x = 0; x < w; ++x)
@@ -188,11 +239,354 @@ default_pack (exr_encode_pipeline_t* encode)
     return EXR_ERR_SUCCESS;
 }
 
+/**************************************/
+
+/*
+ * The specialized routines below are the counterparts of the
+ * interleaved / planar unpackers, and are only used on little endian
+ * hosts, where the native values can be stored as is. In all of
+ * them, every channel is present, unsampled and of the same size.
+ *
+ * The row kernels split a line of interleaved pixels into one output
+ * row per channel, out[p] receiving the channel at position p in the
+ * pixel.
+ */
+
+typedef void (*pack_row_fn) (
+    uint8_t* const* out, const uint8_t* in, int nchans, int w);
+
+static void
+deinterleave_16bit (uint8_t* const* out, const uint8_t* in, int nchans, int w)
+{
+    const uint16_t* src = (const uint16_t*) in;
+    uint16_t*       o0  = (uint16_t*) out[0];
+    uint16_t*       o1  = (uint16_t*) out[1];
+    uint16_t*       o2  = (uint16_t*) out[2];
+    int             x   = 0;
+
+    if (nchans == 4)
+    {
+        uint16_t* o3 = (uint16_t*) out[3];
+#if defined(IMF_HAVE_SSE2)
+        for (; x + 8 <= w; x += 8)
+        {
+            const __m128i* v  = (const __m128i*) (src + x * 4);
+            __m128i        a  = _mm_loadu_si128 (v);
+            __m128i        b  = _mm_loadu_si128 (v + 1);
+            __m128i        c  = _mm_loadu_si128 (v + 2);
+            __m128i        d  = _mm_loadu_si128 (v + 3);
+            __m128i        t0 = _mm_unpacklo_epi16 (a, b);
+            __m128i        t1 = _mm_unpackhi_epi16 (a, b);
+            __m128i        t2 = _mm_unpacklo_epi16 (c, d);
+            __m128i        t3 = _mm_unpackhi_epi16 (c, d);
+            /* s0 / s2 hold channels 0 and 1, s1 / s3 channels 2 and 3 */
+            __m128i s0 = _mm_unpacklo_epi16 (t0, t1);
+            __m128i s1 = _mm_unpackhi_epi16 (t0, t1);
+            __m128i s2 = _mm_unpacklo_epi16 (t2, t3);
+            __m128i s3 = _mm_unpackhi_epi16 (t2, t3);
+
+            _mm_storeu_si128 ((__m128i*) (o0 + x), _mm_unpacklo_epi64 (s0, s2));
+            _mm_storeu_si128 ((__m128i*) (o1 + x), _mm_unpackhi_epi64 (s0, s2));
+            _mm_storeu_si128 ((__m128i*) (o2 + x), _mm_unpacklo_epi64 (s1, s3));
+            _mm_storeu_si128 ((__m128i*) (o3 + x), _mm_unpackhi_epi64 (s1, s3));
+        }
+#elif defined(IMF_HAVE_NEON)
+        for (; x + 8 <= w; x += 8)
+        {
+            uint16x8x4_t v = vld4q_u16 (src + x * 4);
+            vst1q_u16 (o0 + x, v.val[0]);
+            vst1q_u16 (o1 + x, v.val[1]);
+            vst1q_u16 (o2 + x, v.val[2]);
+            vst1q_u16 (o3 + x, v.val[3]);
+        }
+#endif
+        for (; x < w; ++x)
+        {
+            o0[x] = src[x * 4];
+            o1[x] = src[x * 4 + 1];
+            o2[x] = src[x * 4 + 2];
+            o3[x] = src[x * 4 + 3];
+        }
+    }
+    else
+    {
+#if defined(IMF_HAVE_NEON)
+        for (; x + 8 <= w; x += 8)
+        {
+            uint16x8x3_t v = vld3q_u16 (src + x * 3);
+            vst1q_u16 (o0 + x, v.val[0]);
+            vst1q_u16 (o1 + x, v.val[1]);
+            vst1q_u16 (o2 + x, v.val[2]);
+        }
+#endif
+        for (; x < w; ++x)
+        {
+            o0[x] = src[x * 3];
+            o1[x] = src[x * 3 + 1];
+            o2[x] = src[x * 3 + 2];
+        }
+    }
+}
+
+static void
+deinterleave_32bit (uint8_t* const* out, const uint8_t* in, int nchans, int w)
+{
+    const uint32_t* src = (const uint32_t*) in;
+    uint32_t*       o0  = (uint32_t*) out[0];
+    uint32_t*       o1  = (uint32_t*) out[1];
+    uint32_t*       o2  = (uint32_t*) out[2];
+    int             x   = 0;
+
+    if (nchans == 4)
+    {
+        uint32_t* o3 = (uint32_t*) out[3];
+#if defined(IMF_HAVE_SSE2)
+        /* the shuffles in the transpose do not touch the bits */
+        for (; x + 4 <= w; x += 4)
+        {
+            const float* v = (const float*) (src + x * 4);
+            __m128       a = _mm_loadu_ps (v);
+            __m128       b = _mm_loadu_ps (v + 4);
+            __m128       c = _mm_loadu_ps (v + 8);
+            __m128       d = _mm_loadu_ps (v + 12);
+
+            _MM_TRANSPOSE4_PS (a, b, c, d);
+
+            _mm_storeu_ps ((float*) (o0 + x), a);
+            _mm_storeu_ps ((float*) (o1 + x), b);
+            _mm_storeu_ps ((float*) (o2 + x), c);
+            _mm_storeu_ps ((float*) (o3 + x), d);
+        }
+#elif defined(IMF_HAVE_NEON)
+        for (; x + 4 <= w; x += 4)
+        {
+            uint32x4x4_t v = vld4q_u32 (src + x * 4);
+            vst1q_u32 (o0 + x, v.val[0]);
+            vst1q_u32 (o1 + x, v.val[1]);
+            vst1q_u32 (o2 + x, v.val[2]);
+            vst1q_u32 (o3 + x, v.val[3]);
+        }
+#endif
+        for (; x < w; ++x)
+        {
+            o0[x] = src[x * 4];
+            o1[x] = src[x * 4 + 1];
+            o2[x] = src[x * 4 + 2];
+            o3[x] = src[x * 4 + 3];
+        }
+    }
+    else
+    {
+#if defined(IMF_HAVE_NEON)
+        for (; x + 4 <= w; x += 4)
+        {
+            uint32x4x3_t v = vld3q_u32 (src + x * 3);
+            vst1q_u32 (o0 + x, v.val[0]);
+            vst1q_u32 (o1 + x, v.val[1]);
+            vst1q_u32 (o2 + x, v.val[2]);
+        }
+#endif
+        for (; x < w; ++x)
+        {
+            o0[x] = src[x * 3];
+            o1[x] = src[x * 3 + 1];
+            o2[x] = src[x * 3 + 2];
+        }
+    }
+}
+
+/*
+ * splits a block of floats into a planar scratch, converting each
+ * channel of the block with the vector conversion from there
+ */
+static void
+deinterleave_float_to_half (
+    uint8_t* const* out, const uint8_t* in, int nchans, int w)
+{
+    uint32_t tmp[4][PACK_CONVERT_BLOCK];
+    uint8_t* tmpp[4] = { (uint8_t*) tmp[0],
+                         (uint8_t*) tmp[1],
+                         (uint8_t*) tmp[2],
+                         (uint8_t*) tmp[3] };
+
+    for (int x = 0; x < w; x += PACK_CONVERT_BLOCK)
+    {
+        int n = w - x;
+        if (n > PACK_CONVERT_BLOCK) n = PACK_CONVERT_BLOCK;
+
+        deinterleave_32bit (tmpp, in + (size_t) x * nchans * 4, nchans, n);
+
+        for (int p = 0; p < nchans; ++p)
+            internal_exr_float_to_half_buffer (
+                ((uint16_t*) out[p]) + x, (const float*) tmp[p], (uint64_t) n);
+    }
+}
+
+/**************************************/
+
+static inline exr_result_t
+pack_interleaved (
+    exr_encode_pipeline_t* encode, int rev, int outbpc, pack_row_fn rowfn)
+{
+    /* we know we're packing all the channels and there is no subsampling */
+    int            nchans = encode->channel_count;
+    int            w      = encode->channels[0].width;
+    int            h      = encode->chunk.height;
+    int            linc   = encode->channels[0].user_line_stride;
+    size_t         rowsz  = (size_t) w * (size_t) outbpc;
+    const uint8_t* in;
+    uint8_t*       dst = encode->packed_buffer;
+    uint8_t*       out[4];
+
+    /* the reversed layout starts with the last channel */
+    in = encode->channels[rev ? nchans - 1 : 0].encode_from_ptr;
+
+    for (int y = 0; y < h; ++y)
+    {
+        for (int p = 0; p < nchans; ++p)
+            out[p] = dst + (size_t) (rev ? nchans - 1 - p : p) * rowsz;
+
+        rowfn (out, in, nchans, w);
+
+        dst += (size_t) nchans * rowsz;
+        in += linc;
+    }
+
+    encode->packed_bytes = (uint64_t) h * (uint64_t) nchans * rowsz;
+    return EXR_ERR_SUCCESS;
+}
+
+static exr_result_t
+pack_16bit_interleave (exr_encode_pipeline_t* encode)
+{
+    return pack_interleaved (encode, 0, 2, &deinterleave_16bit);
+}
+
+static exr_result_t
+pack_16bit_interleave_rev (exr_encode_pipeline_t* encode)
+{
+    return pack_interleaved (encode, 1, 2, &deinterleave_16bit);
+}
+
+static exr_result_t
+pack_32bit_interleave (exr_encode_pipeline_t* encode)
+{
+    return pack_interleaved (encode, 0, 4, &deinterleave_32bit);
+}
+
+static exr_result_t
+pack_32bit_interleave_rev (exr_encode_pipeline_t* encode)
+{
+    return pack_interleaved (encode, 1, 4, &deinterleave_32bit);
+}
+
+static exr_result_t
+pack_float_to_half_interleave (exr_encode_pipeline_t* encode)
+{
+    return pack_interleaved (encode, 0, 2, &deinterleave_float_to_half);
+}
+
+static exr_result_t
+pack_float_to_half_interleave_rev (exr_encode_pipeline_t* encode)
+{
+    return pack_interleaved (encode, 1, 2, &deinterleave_float_to_half);
+}
+
+/**************************************/
+
+static exr_result_t
+pack_planar (exr_encode_pipeline_t* encode)
+{
+    /* no conversion and each channel contiguous, just copy the rows */
+    uint8_t* dstbuffer    = encode->packed_buffer;
+    uint64_t packed_bytes = 0;
+
+    for (int y = 0; y < encode->chunk.height; ++y)
+    {
+        for (int c = 0; c < encode->channel_count; ++c)
+        {
+            const exr_coding_channel_info_t* encc = (encode->channels + c);
+            size_t chan_bytes =
+                (size_t) encc->width * (size_t) encc->bytes_per_element;
+
+            memcpy (
+                dstbuffer,
+                encc->encode_from_ptr +
+                    (uint64_t) y * (uint64_t) encc->user_line_stride,
+                chan_bytes);
+            dstbuffer += chan_bytes;
+            packed_bytes += chan_bytes;
+        }
+    }
+
+    encode->packed_bytes = packed_bytes;
+    return EXR_ERR_SUCCESS;
+}
+
+/**************************************/
+
 internal_exr_pack_fn
-internal_exr_match_encode (exr_encode_pipeline_t* encode, int isdeep)
+internal_exr_match_encode (
+    exr_encode_pipeline_t* encode,
+    int                    isdeep,
+    int                    chanstopack,
+    int                    sametype,
+    int                    sameintype,
+    int                    samebpc,
+    int                    sameinbpc,
+    int                    hassampling,
+    int                    hastypechange,
+    int                    sameininc,
+    int                    simpinterleave,
+    int                    simpinterleaverev)
 {
-    (void)encode;
+    internal_exr_init_convert_funcs ();
     if (isdeep) return &default_pack_deep;
 
+#if EXR_HOST_IS_NOT_LITTLE_ENDIAN
+    (void) chanstopack;
+    (void) sametype;
+    (void) sameintype;
+    (void) samebpc;
+    (void) sameinbpc;
+    (void) hassampling;
+    (void) hastypechange;
+    (void) sameininc;
+    (void) simpinterleave;
+    (void) simpinterleaverev;
+    return &default_pack;
+#else
+    if (hassampling || chanstopack != encode->channel_count || samebpc <= 0 ||
+        sameinbpc <= 0)
+        return &default_pack;
+
+    if (hastypechange > 0)
+    {
+        /* the opposite of the common half to float unpack */
+        if (sametype == (int) EXR_PIXEL_HALF &&
+            sameintype == (int) EXR_PIXEL_FLOAT &&
+            (encode->channel_count == 3 || encode->channel_count == 4))
+        {
+            if (simpinterleave > 0) return &pack_float_to_half_interleave;
+            if (simpinterleaverev > 0)
+                return &pack_float_to_half_interleave_rev;
+        }
+
+        return &default_pack;
+    }
+
+    if (encode->channel_count == 3 || encode->channel_count == 4)
+    {
+        if (simpinterleave > 0)
+            return samebpc == 2 ? &pack_16bit_interleave
+                                : &pack_32bit_interleave;
+        if (simpinterleaverev > 0)
+            return samebpc == 2 ? &pack_16bit_interleave_rev
+                                : &pack_32bit_interleave_rev;
+    }
+
+    if (sameininc == samebpc) return &pack_planar;
+
     return &default_pack;
+#endif
 }
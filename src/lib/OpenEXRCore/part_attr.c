@@ -707,6 +707,48 @@ exr_set_compression (
 
 /**************************************/
 
+exr_result_t
+exr_get_zip_compression_level (
+    exr_const_context_t ctxt, int part_index, int* level)
+{
+    int32_t      l  = -1;
+    exr_result_t rv = EXR_ERR_SUCCESS;
+
+    if (!ctxt) return EXR_ERR_MISSING_CONTEXT_ARG;
+    if (!level)
+        return EXR_CTXT (ctxt)->report_error (
+            EXR_CTXT (ctxt),
+            EXR_ERR_INVALID_ARGUMENT,
+            "NULL output for 'zipCompressionLevel'");
+
+    rv = exr_attr_get_int (ctxt, part_index, "zipCompressionLevel", &l);
+    if (rv == EXR_ERR_NO_ATTR_BY_NAME)
+    {
+        l  = -1;
+        rv = EXR_ERR_SUCCESS;
+    }
+    if (rv == EXR_ERR_SUCCESS) *level = l;
+    return rv;
+}
+
+/**************************************/
+
+exr_result_t
+exr_set_zip_compression_level (exr_context_t ctxt, int part_index, int level)
+{
+    if (!ctxt) return EXR_ERR_MISSING_CONTEXT_ARG;
+    if (level < -1 || level > 9)
+        return EXR_CTXT (ctxt)->print_error (
+            EXR_CTXT (ctxt),
+            EXR_ERR_INVALID_ARGUMENT,
+            "Invalid zip compression level %d, expect -1 (default) or 0 - 9",
+            level);
+
+    return exr_attr_set_int (ctxt, part_index, "zipCompressionLevel", level);
+}
+
+/**************************************/
+
 exr_result_t
 exr_get_data_window (
     exr_const_context_t ctxt, int part_index, exr_attr_box2i_t* out)
@@ -4,222 +4,58 @@
 */
 
 #include "internal_coding.h"
+#include "internal_convert.h"
 #include "internal_xdr.h"
 
 #include "openexr_attr.h"
 
 #include <string.h>
 
-#if defined(__x86_64__) || defined(_M_X64)
-#    ifndef _WIN32
-#        include <cpuid.h>
-#    endif
-#endif
-
 /**************************************/
 
-#ifndef __F16C__
-static inline void
-half_to_float4 (float* out, const uint16_t* src)
-{
-    out[0] = half_to_float (src[0]);
-    out[1] = half_to_float (src[1]);
-    out[2] = half_to_float (src[2]);
-    out[3] = half_to_float (src[3]);
-}
-
-static inline void
-half_to_float8 (float* out, const uint16_t* src)
-{
-    half_to_float4 (out, src);
-    half_to_float4 (out + 4, src + 4);
-}
-#endif
-
-#if (defined(__x86_64__) || defined(_M_X64)) &&                                \
-    (defined(__F16C__) || defined(__GNUC__) || defined(__clang__))
-
-#    if defined(__F16C__)
 static inline void
 half_to_float_buffer (float* out, const uint16_t* in, int w)
-#    elif defined(__GNUC__) || defined(__clang__)
-__attribute__ ((target ("f16c"))) static void
-half_to_float_buffer_f16c (float* out, const uint16_t* in, int w)
-#    endif
 {
-    while (w >= 8)
-    {
-        _mm256_storeu_ps (
-            out, _mm256_cvtph_ps (_mm_loadu_si128 ((const __m128i*) in)));
-        out += 8;
-        in += 8;
-        w -= 8;
-    }
-    // gcc < 9 does not have loadu_si64
-#    if defined(__clang__) || (__GNUC__ >= 9)
-    switch (w)
-    {
-        case 7:
-            _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in)));
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            out[6] = half_to_float (in[6]);
-            break;
-        case 6:
-            _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in)));
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            break;
-        case 5:
-            _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in)));
-            out[4] = half_to_float (in[4]);
-            break;
-        case 4: _mm_storeu_ps (out, _mm_cvtph_ps (_mm_loadu_si64 (in))); break;
-        case 3:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            out[2] = half_to_float (in[2]);
-            break;
-        case 2:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            break;
-        case 1: out[0] = half_to_float (in[0]); break;
-    }
-#    else
-    while (w > 0)
-    {
-        *out++ = half_to_float (*in++);
-        --w;
-    }
-#    endif
-}
-
-#    ifndef __F16C__
-static void
-half_to_float_buffer_impl (float* out, const uint16_t* in, int w)
-{
-    while (w >= 8)
-    {
-        half_to_float8 (out, in);
-        out += 8;
-        in += 8;
-        w -= 8;
-    }
-    switch (w)
-    {
-        case 7:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            out[6] = half_to_float (in[6]);
-            break;
-        case 6:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            break;
-        case 5:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            break;
-        case 4: half_to_float4 (out, in); break;
-        case 3:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            out[2] = half_to_float (in[2]);
-            break;
-        case 2:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            break;
-        case 1: out[0] = half_to_float (in[0]); break;
-    }
-}
-
-static void (*half_to_float_buffer) (float*, const uint16_t*, int) =
-    &half_to_float_buffer_impl;
-
-static void
-choose_half_to_float_impl ()
-{
-#        ifdef _WIN32
-    int regs[4];
-
-    __cpuid (regs, 0);
-    if (regs[0] >= 1) { __cpuidex (regs, 1, 0); }
-#        else
-    unsigned int regs[4];
-    __get_cpuid (0, &regs[0], &regs[1], &regs[2], &regs[3]);
-    if (regs[0] >= 1)
-    {
-        __get_cpuid (1, &regs[0], &regs[1], &regs[2], &regs[3]);
-    }
-#        endif
-    /* F16C is indicated by bit 29 */
-    if (regs[0] & (1 << 29)) half_to_float_buffer = &half_to_float_buffer_f16c;
+#if EXR_HOST_IS_NOT_LITTLE_ENDIAN
+    for (int x = 0; x < w; ++x)
+        out[x] = half_to_float (one_to_native16 (in[x]));
+#else
+    internal_exr_half_to_float_buffer (out, in, (uint64_t) w);
+#endif
 }
-#    else
-/* when we explicitly compile against f16, force it in */
-static void
-choose_half_to_float_impl ()
-{}
-
-#    endif /* F16C */
 
-#else
+/*
+ * Interleaves a row of planar half channels into floats. The halves
+ * are converted a block at a time into a planar scratch so that goes
+ * through the vector conversion, leaving only copies to interleave.
+ */
+#define HALF_TO_FLOAT_BLOCK 64
 
 static inline void
-half_to_float_buffer (float* out, const uint16_t* in, int w)
+half_to_float_interleave (
+    float* out, const uint16_t* const* in, int nchans, int w)
 {
-#    if EXR_HOST_IS_NOT_LITTLE_ENDIAN
+#if EXR_HOST_IS_NOT_LITTLE_ENDIAN
     for (int x = 0; x < w; ++x)
-        out[x] = half_to_float (one_to_native16 (in[x]));
-#    else
-    while (w >= 8)
-    {
-        half_to_float8 (out, in);
-        out += 8;
-        in += 8;
-        w -= 8;
-    }
-    switch (w)
+        for (int c = 0; c < nchans; ++c)
+            *out++ = half_to_float (one_to_native16 (in[c][x]));
+#else
+    float tmp[4][HALF_TO_FLOAT_BLOCK];
+
+    for (int x = 0; x < w; x += HALF_TO_FLOAT_BLOCK)
     {
-        case 7:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            out[6] = half_to_float (in[6]);
-            break;
-        case 6:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            out[5] = half_to_float (in[5]);
-            break;
-        case 5:
-            half_to_float4 (out, in);
-            out[4] = half_to_float (in[4]);
-            break;
-        case 4: half_to_float4 (out, in); break;
-        case 3:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            out[2] = half_to_float (in[2]);
-            break;
-        case 2:
-            out[0] = half_to_float (in[0]);
-            out[1] = half_to_float (in[1]);
-            break;
-        case 1: out[0] = half_to_float (in[0]); break;
-    }
-#    endif
-}
+        int n = w - x;
+        if (n > HALF_TO_FLOAT_BLOCK) n = HALF_TO_FLOAT_BLOCK;
 
-static void
-choose_half_to_float_impl ()
-{}
+        for (int c = 0; c < nchans; ++c)
+            internal_exr_half_to_float_buffer (tmp[c], in[c] + x, (uint64_t) n);
 
+        for (int i = 0; i < n; ++i)
+            for (int c = 0; c < nchans; ++c)
+                *out++ = tmp[c][i];
+    }
 #endif
+}
 
 /**************************************/
 
@@ -329,12 +165,9 @@ unpack_half_to_float_3chan_interleave (exr_decode_pipeline_t* decode)
         in2 = in1 + w;
 
         srcbuffer += w * 6; // 3 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
         {
-            out[0] = half_to_float (one_to_native16 (in0[x]));
-            out[1] = half_to_float (one_to_native16 (in1[x]));
-            out[2] = half_to_float (one_to_native16 (in2[x]));
-            out += 3;
+            const uint16_t* ins[3] = { in0, in1, in2 };
+            half_to_float_interleave (out, ins, 3, w);
         }
         out0 += linc0;
     }
@@ -369,12 +202,9 @@ unpack_half_to_float_3chan_interleave_rev (exr_decode_pipeline_t* decode)
         in2 = in1 + w;
 
         srcbuffer += w * 6; // 3 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
         {
-            out[0] = half_to_float (one_to_native16 (in2[x]));
-            out[1] = half_to_float (one_to_native16 (in1[x]));
-            out[2] = half_to_float (one_to_native16 (in0[x]));
-            out += 3;
+            const uint16_t* ins[3] = { in2, in1, in0 };
+            half_to_float_interleave (out, ins, 3, w);
         }
         out0 += linc0;
     }
@@ -412,7 +242,7 @@ unpack_16bit_3chan_planar (exr_decode_pipeline_t* decode)
     {
         in0 = (const uint16_t*) srcbuffer;
         in1 = in0 + w;
-        in2 = in1 + 1;
+        in2 = in1 + w;
         srcbuffer += w * 6; // 3 * sizeof(uint16_t), avoid type conversion
                             /* specialise to memcpy if we can */
 #if EXR_HOST_IS_NOT_LITTLE_ENDIAN
@@ -466,7 +296,7 @@ unpack_half_to_float_3chan_planar (exr_decode_pipeline_t* decode)
     {
         in0 = (const uint16_t*) srcbuffer;
         in1 = in0 + w;
-        in2 = in1 + 1;
+        in2 = in1 + w;
         srcbuffer += w * 6; // 3 * sizeof(uint16_t), avoid type conversion
                             /* specialise to memcpy if we can */
         half_to_float_buffer ((float*) out0, in0, w);
@@ -661,13 +491,9 @@ unpack_half_to_float_4chan_interleave (exr_decode_pipeline_t* decode)
         in3        = in2 + w;
 
         srcbuffer += w * 8; // 4 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
         {
-            out[0] = half_to_float (one_to_native16 (in3[x]));
-            out[1] = half_to_float (one_to_native16 (in2[x]));
-            out[2] = half_to_float (one_to_native16 (in1[x]));
-            out[3] = half_to_float (one_to_native16 (in0[x]));
-            out += 4;
+            const uint16_t* ins[4] = { in0, in1, in2, in3 };
+            half_to_float_interleave (out, ins, 4, w);
         }
         out0 += linc0;
     }
@@ -702,13 +528,9 @@ unpack_half_to_float_4chan_interleave_rev (exr_decode_pipeline_t* decode)
         in3        = in2 + w;
 
         srcbuffer += w * 8; // 4 * sizeof(uint16_t), avoid type conversion
-        for (int x = 0; x < w; ++x)
         {
-            out[0] = half_to_float (one_to_native16 (in0[x]));
-            out[1] = half_to_float (one_to_native16 (in1[x]));
-            out[2] = half_to_float (one_to_native16 (in2[x]));
-            out[3] = half_to_float (one_to_native16 (in3[x]));
-            out += 4;
+            const uint16_t* ins[4] = { in3, in2, in1, in0 };
+            half_to_float_interleave (out, ins, 4, w);
         }
         out0 += linc0;
     }
@@ -996,6 +818,17 @@ unpack_32bit (exr_decode_pipeline_t* decode)
     return EXR_ERR_SUCCESS;
 }
 
+/*
+ * the half conversions can go through the (vector) buffer versions
+ * when the destination is contiguous, they expect native byte order
+ */
+#if EXR_HOST_IS_NOT_LITTLE_ENDIAN
+#    define UNPACK_CAN_CONVERT_BUFFER(ubpc, type) 0
+#else
+#    define UNPACK_CAN_CONVERT_BUFFER(ubpc, type)                             \
+        (((size_t) (ubpc)) == sizeof (type))
+#endif
+
 #define UNPACK_SAMPLES(samps)                                                  \
     switch (decc->data_type)                                                   \
     {                                                                          \
@@ -1014,6 +847,14 @@ unpack_32bit (exr_decode_pipeline_t* decode)
                 }                                                              \
                 case EXR_PIXEL_FLOAT: {                                        \
                     const uint16_t* src = (const uint16_t*) srcbuffer;         \
+                    if ((samps) > 0 &&                                         \
+                        UNPACK_CAN_CONVERT_BUFFER (ubpc, float))               \
+                    {                                                          \
+                        internal_exr_half_to_float_buffer (                    \
+                            (float*) cdata, src, (uint64_t) samps);            \
+                        cdata += ((size_t) samps) * sizeof (float);            \
+                        break;                                                 \
+                    }                                                          \
                     for (int s = 0; s < samps; ++s)                            \
                     {                                                          \
                         uint16_t cval = unaligned_load16 (src);                \
@@ -1025,6 +866,14 @@ unpack_32bit (exr_decode_pipeline_t* decode)
                 }                                                              \
                 case EXR_PIXEL_UINT: {                                         \
                     const uint16_t* src = (const uint16_t*) srcbuffer;         \
+                    if ((samps) > 0 &&                                         \
+                        UNPACK_CAN_CONVERT_BUFFER (ubpc, uint32_t))            \
+                    {                                                          \
+                        internal_exr_half_to_uint_buffer (                     \
+                            (uint32_t*) cdata, src, (uint64_t) samps);         \
+                        cdata += ((size_t) samps) * sizeof (uint32_t);         \
+                        break;                                                 \
+                    }                                                          \
                     for (int s = 0; s < samps; ++s)                            \
                     {                                                          \
                         uint16_t cval = unaligned_load16 (src);                \
@@ -1319,12 +1168,7 @@ internal_exr_match_decode (
     int                    simpinterleaverev,
     int                    simplineoff)
 {
-    static int init_cpu_check = 1;
-    if (init_cpu_check)
-    {
-        choose_half_to_float_impl ();
-        init_cpu_check = 0;
-    }
+    internal_exr_init_convert_funcs ();
 
     if (isdeep)
     {
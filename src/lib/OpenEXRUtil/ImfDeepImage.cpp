@@ -21,7 +21,8 @@ OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
 
 
 DeepImage::DeepImage ():
-    Image ()
+    Image (),
+    _storageMode (DEEP_STORAGE_LISTS)
 {
     resize (Box2i (V2i (0, 0), V2i (-1, -1)), ONE_LEVEL, ROUND_DOWN);
 }
@@ -32,7 +33,21 @@ DeepImage::DeepImage
      LevelMode levelMode,
      LevelRoundingMode levelRoundingMode)
 :
-    Image ()
+    Image (),
+    _storageMode (DEEP_STORAGE_LISTS)
+{
+    resize (dataWindow, levelMode, levelRoundingMode);
+}
+
+
+DeepImage::DeepImage
+    (const Box2i &dataWindow,
+     DeepStorageMode storageMode,
+     LevelMode levelMode,
+     LevelRoundingMode levelRoundingMode)
+:
+    Image (),
+    _storageMode (storageMode)
 {
     resize (dataWindow, levelMode, levelRoundingMode);
 }
@@ -72,6 +87,31 @@ DeepImage::level (int lx, int ly) const
 }
 
 
+DeepStorageMode
+DeepImage::storageMode () const
+{
+    return _storageMode;
+}
+
+
+void
+DeepImage::setStorageMode (DeepStorageMode storageMode)
+{
+    _storageMode = storageMode;
+
+    for (int y = 0; y < numYLevels(); ++y)
+    {
+        for (int x = 0; x < numXLevels(); ++x)
+        {
+            if (levelMode() == MIPMAP_LEVELS && x != y)
+                continue;
+
+            level (x, y).setStorageMode (storageMode);
+        }
+    }
+}
+
+
 DeepImageLevel *
 DeepImage::newLevel (int lx, int ly, const Box2i &dataWindow)
 {
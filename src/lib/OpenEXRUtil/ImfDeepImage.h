@@ -41,9 +41,37 @@ class IMFUTIL_EXPORT_TYPE DeepImage : public Image
                LevelMode levelMode = ONE_LEVEL,
                LevelRoundingMode levelRoundingMode = ROUND_DOWN);
 
+    //
+    // Construct an image whose samples are stored according to
+    // storageMode.  Constructing an image with DEEP_STORAGE_COMPACT
+    // avoids allocating per-pixel sample list pointers that would
+    // immediately be discarded by setStorageMode().
+    //
+
+    IMFUTIL_EXPORT
+  	DeepImage(const IMATH_NAMESPACE::Box2i &dataWindow,
+               DeepStorageMode storageMode,
+               LevelMode levelMode = ONE_LEVEL,
+               LevelRoundingMode levelRoundingMode = ROUND_DOWN);
+
   	IMFUTIL_EXPORT virtual ~DeepImage();
 
 
+    //
+    // Sample storage mode (see the comments for DeepStorageMode in
+    // ImfSampleCountChannel.h).  The storage mode applies to all levels
+    // of the image, including levels that are created later by resize().
+    //
+    // setStorageMode(m) rearranges the samples in all existing levels;
+    // the samples themselves are preserved.  If this runs out of memory,
+    // the image is resized to zero by zero pixels and an exception is
+    // thrown.
+    //
+
+    IMFUTIL_EXPORT DeepStorageMode     storageMode () const;
+    IMFUTIL_EXPORT void                setStorageMode (DeepStorageMode storageMode);
+
+
     //
     // Accessing image levels by level number
     //
@@ -59,6 +87,10 @@ class IMFUTIL_EXPORT_TYPE DeepImage : public Image
     IMFUTIL_EXPORT
   	virtual DeepImageLevel *
         newLevel (int lx, int ly, const IMATH_NAMESPACE::Box2i &dataWindow);
+
+  private:
+
+    DeepStorageMode _storageMode;
 };
 
 
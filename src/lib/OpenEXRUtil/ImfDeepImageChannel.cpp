@@ -20,14 +20,167 @@ IMATH_INTERNAL_NAMESPACE_HEADER_EXIT
 
 #include "ImfDeepImageChannel.h"
 #include "ImfDeepImageLevel.h"
+#include <ImfThreading.h>
+#include <IlmThreadPool.h>
 #include <Iex.h>
+#include <algorithm>
 
 using namespace IMATH_NAMESPACE;
 using namespace IEX_NAMESPACE;
 using namespace std;
 
+using ILMTHREAD_NAMESPACE::Task;
+using ILMTHREAD_NAMESPACE::TaskGroup;
+using ILMTHREAD_NAMESPACE::ThreadPool;
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
 
+namespace {
+
+//
+// Moving or initializing the sample lists of a large level is split
+// into ranges of pixels, which are processed in parallel on the global
+// thread pool.  Each range contains at least minPixelsPerTask pixels.
+//
+
+const size_t minPixelsPerTask = 1 << 16;
+
+
+template <class F>
+class PixelRangeTask: public Task
+{
+  public:
+
+    PixelRangeTask (TaskGroup *group, const F &f, size_t begin, size_t end):
+        Task (group),
+        _f (f),
+        _begin (begin),
+        _end (end)
+    {
+        // empty
+    }
+
+    virtual void
+    execute ()
+    {
+        _f (_begin, _end);
+    }
+
+  private:
+
+    F       _f;
+    size_t  _begin;
+    size_t  _end;
+};
+
+
+template <class F>
+void
+forEachPixelRange (size_t numPixels, const F &f)
+{
+    //
+    // Call f(begin,end) for consecutive ranges of pixels that
+    // together cover pixels 0 through numPixels-1.  Returns
+    // after all calls have completed.
+    //
+
+    size_t numTasks = min (size_t (max (globalThreadCount(), 0)),
+                           numPixels / minPixelsPerTask);
+
+    if (numTasks < 2)
+    {
+        f (0, numPixels);
+        return;
+    }
+
+    TaskGroup taskGroup;
+
+    for (size_t t = 0; t < numTasks; ++t)
+    {
+        ThreadPool::addGlobalTask
+            (new PixelRangeTask<F> (&taskGroup,
+                                    f,
+                                    numPixels * t / numTasks,
+                                    numPixels * (t + 1) / numTasks));
+    }
+
+    //
+    // The TaskGroup destructor waits for all tasks to complete.
+    //
+}
+
+
+template <class T>
+struct MoveSampleLists
+{
+    //
+    // Copy the sample lists for a range of pixels from an old to a
+    // new sample buffer; see
+    // TypedDeepImageChannel::moveSampleListsToNewBuffer().
+    //
+
+    const unsigned int *    oldNumSamples;
+    const size_t *          oldSampleListPositions;
+    const unsigned int *    newNumSamples;
+    const size_t *          newSampleListPositions;
+    const T *               oldSampleBuffer;
+    T *                     newSampleBuffer;
+    T **                    sampleListPointers;     // 0 if there are none
+
+    void
+    operator () (size_t begin, size_t end) const
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const T * oldSampleList = oldSampleBuffer + oldSampleListPositions[i];
+            T * newSampleList = newSampleBuffer + newSampleListPositions[i];
+
+            unsigned int n = min (oldNumSamples[i], newNumSamples[i]);
+
+            for (unsigned int j = 0; j < n; ++j)
+                newSampleList[j] = oldSampleList[j];
+
+            for (unsigned int j = n; j < newNumSamples[i]; ++j)
+                newSampleList[j] = T (0);
+
+            if (sampleListPointers)
+                sampleListPointers[i] = newSampleList;
+        }
+    }
+};
+
+
+template <class T>
+struct InitializeSampleLists
+{
+    //
+    // Construct zero-filled sample lists for a range of pixels;
+    // see TypedDeepImageChannel::initializeSampleLists().
+    //
+
+    const unsigned int *    numSamples;
+    const size_t *          sampleListPositions;
+    T *                     sampleBuffer;
+    T **                    sampleListPointers;     // 0 if there are none
+
+    void
+    operator () (size_t begin, size_t end) const
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            T * sampleList = sampleBuffer + sampleListPositions[i];
+
+            for (unsigned int j = 0; j < numSamples[i]; ++j)
+                sampleList[j] = T (0);
+
+            if (sampleListPointers)
+                sampleListPointers[i] = sampleList;
+        }
+    }
+};
+
+} // namespace
+
 
 DeepImageChannel::DeepImageChannel
     (DeepImageLevel &level,
@@ -88,7 +241,8 @@ TypedDeepImageChannel<T>::TypedDeepImageChannel
     DeepImageChannel (level, pLinear),
     _sampleListPointers (0),
     _base (0),
-    _sampleBuffer (0)
+    _sampleBuffer (0),
+    _positionsBase (0)
 {
     resize();
 }
@@ -106,6 +260,13 @@ template <class T>
 DeepSlice
 TypedDeepImageChannel<T>::slice () const
 {
+    if (_sampleListPointers == 0)
+    {
+        THROW (LogicExc, "Cannot construct a frame buffer slice for all "
+                         "rows of a deep image channel whose samples are "
+                         "stored with DEEP_STORAGE_COMPACT.");
+    }
+
     return DeepSlice (pixelType(),                  // type
                       (char *) _base,               // base
                       sizeof (T*),                  // xStride
@@ -114,6 +275,46 @@ TypedDeepImageChannel<T>::slice () const
                       xSampling(),
                       ySampling());
 }
+
+
+template <class T>
+DeepSlice
+TypedDeepImageChannel<T>::sliceRows
+    (int r1,
+     int r2,
+     vector<char *> &p) const
+{
+    if (r1 < 0 || r2 >= pixelsPerColumn() || r1 > r2)
+    {
+        THROW (ArgExc, "Invalid row range " << r1 << " to " << r2 << " "
+                       "for a deep image channel with " <<
+                       pixelsPerColumn() << " rows.");
+    }
+
+    size_t begin = size_t (r1) * pixelsPerRow();
+    size_t end = size_t (r2 + 1) * pixelsPerRow();
+
+    const size_t * sampleListPositions = sampleCounts().sampleListPositions();
+
+    p.resize (end - begin);
+
+    for (size_t i = begin; i < end; ++i)
+        p[i - begin] = (char *) (_sampleBuffer + sampleListPositions[i]);
+
+    char ** base = p.data() -
+                   (level().dataWindow().min.y + r1) * pixelsPerRow() -
+                   level().dataWindow().min.x;
+
+    return DeepSlice (pixelType(),                      // type
+                      (char *) base,                    // base
+                      sizeof (char *),                  // xStride
+                      pixelsPerRow() * sizeof (char *), // yStride
+                      sizeof (T),                       // sampleStride
+                      xSampling(),
+                      ySampling());
+}
+
+
 template <class T>
 void
 TypedDeepImageChannel<T>::setSamplesToZero
@@ -195,6 +396,38 @@ TypedDeepImageChannel<T>::moveSamplesToNewBuffer
     (const unsigned int * oldNumSamples,
      const unsigned int * newNumSamples,
      const size_t * newSampleListPositions)
+{
+    //
+    // Like moveSampleListsToNewBuffer(), but the old sample lists
+    // are located through the channel's per-pixel sample list pointers.
+    //
+
+    if (_sampleListPointers == 0)
+    {
+        THROW (LogicExc, "Cannot locate the sample lists of a deep image "
+                         "channel whose samples are stored with "
+                         "DEEP_STORAGE_COMPACT.");
+    }
+
+    vector<size_t> oldSampleListPositions (numPixels());
+
+    for (size_t i = 0; i < numPixels(); ++i)
+        oldSampleListPositions[i] = _sampleListPointers[i] - _sampleBuffer;
+
+    moveSampleListsToNewBuffer (oldNumSamples,
+                                oldSampleListPositions.data(),
+                                newNumSamples,
+                                newSampleListPositions);
+}
+
+
+template <class T>
+void
+TypedDeepImageChannel<T>::moveSampleListsToNewBuffer
+    (const unsigned int * oldNumSamples,
+     const size_t * oldSampleListPositions,
+     const unsigned int * newNumSamples,
+     const size_t * newSampleListPositions)
 {
     //
     // Allocate a new sample buffer for this channel.
@@ -204,6 +437,9 @@ TypedDeepImageChannel<T>::moveSamplesToNewBuffer
     // oldNumSamples            Number of samples in each sample list in the
     //                          old sample buffer.
     //
+    // oldSampleListPositions   The positions of the old sample lists in the
+    //                          old sample buffer.
+    //
     // newNumSamples            Number of samples in each sample list in
     //                          the new sample buffer.  If the new number
     //                          of samples is larger than the old number of
@@ -216,33 +452,39 @@ TypedDeepImageChannel<T>::moveSamplesToNewBuffer
     // newSampleListPositions   The positions of the new sample lists in the
     //                          new sample buffer.
     //
+    // The new sample buffer is laid out according to the current storage
+    // mode of the sample count channel; with DEEP_STORAGE_COMPACT, the
+    // array of per-pixel sample list pointers is deleted.
+    //
 
-    T * oldSampleBuffer = _sampleBuffer;
-    _sampleBuffer = new T [sampleCounts().sampleBufferSize()];
-
-    for (size_t i = 0; i < numPixels(); ++i)
+    if (sampleCounts().storageMode() == DEEP_STORAGE_COMPACT)
     {
-        T * oldSampleList = _sampleListPointers[i];
-        T * newSampleList = _sampleBuffer + newSampleListPositions[i];
+        delete [] _sampleListPointers;
+        _sampleListPointers = 0;
+    }
+    else if (_sampleListPointers == 0)
+    {
+        _sampleListPointers = new T * [numPixels()];
+    }
 
-        if (oldNumSamples[i] > newNumSamples[i])
-        {
-            for (unsigned int j = 0; j < newNumSamples[i]; ++j)
-                newSampleList[j] = oldSampleList[j];
-        }
-        else
-        {
-            for (unsigned int j = 0; j < oldNumSamples[i]; ++j)
-                newSampleList[j] = oldSampleList[j];
+    T * newSampleBuffer = new T [sampleCounts().sampleBufferSize()];
 
-            for (unsigned int j = oldNumSamples[i]; j < newNumSamples[i]; ++j)
-                newSampleList[j] = 0;
-        }
+    MoveSampleLists<T> move;
 
-        _sampleListPointers[i] = newSampleList;
-    }
+    move.oldNumSamples = oldNumSamples;
+    move.oldSampleListPositions = oldSampleListPositions;
+    move.newNumSamples = newNumSamples;
+    move.newSampleListPositions = newSampleListPositions;
+    move.oldSampleBuffer = _sampleBuffer;
+    move.newSampleBuffer = newSampleBuffer;
+    move.sampleListPointers = _sampleListPointers;
+
+    forEachPixelRange (numPixels(), move);
+
+    delete [] _sampleBuffer;
+    _sampleBuffer = newSampleBuffer;
 
-    delete [] oldSampleBuffer;
+    resetBasePointer();
 }
 
 
@@ -260,20 +502,28 @@ TypedDeepImageChannel<T>::initializeSampleLists ()
     _sampleBuffer = 0;          // set to 0 to prevent double deletion
                                 // in case of an exception
 
-    const unsigned int * numSamples = sampleCounts().numSamples();
-    const size_t * sampleListPositions = sampleCounts().sampleListPositions();
+    if (sampleCounts().storageMode() == DEEP_STORAGE_COMPACT)
+    {
+        delete [] _sampleListPointers;
+        _sampleListPointers = 0;
+    }
+    else if (_sampleListPointers == 0)
+    {
+        _sampleListPointers = new T * [numPixels()];
+    }
 
     _sampleBuffer = new T [sampleCounts().sampleBufferSize()];
-    
+
     resetBasePointer();
 
-    for (size_t i = 0; i < numPixels(); ++i)
-    {
-        _sampleListPointers[i] = _sampleBuffer + sampleListPositions[i];
+    InitializeSampleLists<T> init;
 
-        for (unsigned int j = 0; j < numSamples[i]; ++j)
-            _sampleListPointers[i][j] = T (0);
-    }
+    init.numSamples = sampleCounts().numSamples();
+    init.sampleListPositions = sampleCounts().sampleListPositions();
+    init.sampleBuffer = _sampleBuffer;
+    init.sampleListPointers = _sampleListPointers;
+
+    forEachPixelRange (numPixels(), init);
 }
 
 template <class T>
@@ -284,7 +534,6 @@ TypedDeepImageChannel<T>::resize ()
 
     delete [] _sampleListPointers;
     _sampleListPointers = 0;
-    _sampleListPointers = new T * [numPixels()];
     initializeSampleLists();
 }
 
@@ -293,9 +542,20 @@ template <class T>
 void
 TypedDeepImageChannel<T>::resetBasePointer ()
 {
-    _base = _sampleListPointers -
-            level().dataWindow().min.y * pixelsPerRow() -
-            level().dataWindow().min.x;
+    if (_sampleListPointers)
+    {
+        _base = _sampleListPointers -
+                level().dataWindow().min.y * pixelsPerRow() -
+                level().dataWindow().min.x;
+    }
+    else
+    {
+        _base = 0;
+    }
+
+    _positionsBase = sampleCounts().sampleListPositions() -
+                     level().dataWindow().min.y * pixelsPerRow() -
+                     level().dataWindow().min.x;
 }
 
 
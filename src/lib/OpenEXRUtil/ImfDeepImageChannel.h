@@ -25,6 +25,8 @@
 
 #include "ImfDeepFrameBuffer.h"
 
+#include <vector>
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
 
 class DeepImageLevel;
@@ -49,6 +51,11 @@ class IMFUTIL_EXPORT_TYPE DeepImageChannel: public ImageChannel
     // Construct an OpenEXR frame buffer slice for this channel.
     // This function is needed reading an image from an OpenEXR
     // file and for saving an image in an OpenEXR file.
+    //
+    // slice() refers to the channel's per-pixel sample list pointers,
+    // which do not exist if the level's samples are stored with
+    // DEEP_STORAGE_COMPACT; in that case, slice() throws an
+    // Iex::LogicExc exception.  Use sliceRows() instead.
     // 
 
     virtual DeepSlice           slice () const = 0;
@@ -102,6 +109,33 @@ class IMFUTIL_EXPORT_TYPE DeepImageChannel: public ImageChannel
     IMFUTIL_EXPORT virtual void resize ();
 
     virtual void resetBasePointer () = 0;
+
+    //
+    // Virtual functions added after the ones above, so that the
+    // existing vtable entries keep their positions.
+    //
+
+    virtual void moveSampleListsToNewBuffer
+                        (const unsigned int * oldNumSamples,
+                         const size_t * oldSampleListPositions,
+                         const unsigned int * newNumSamples,
+                         const size_t * newSampleListPositions) = 0;
+
+  public:
+
+    //
+    // Construct an OpenEXR frame buffer slice for rows r1 through r2
+    // of this channel.  Unlike slice(), sliceRows() works with either
+    // storage mode: it stores pointers to the sample lists of the
+    // pixels in those rows in array p, and returns a slice that refers
+    // to p.  The slice remains valid until p is modified or destroyed,
+    // or until the sample counts of the level change.
+    //
+
+    virtual DeepSlice           sliceRows
+                                    (int r1,
+                                     int r2,
+                                     std::vector<char *> &p) const = 0;
 };
 
 
@@ -125,6 +159,10 @@ class IMFUTIL_EXPORT_TEMPLATE_TYPE TypedDeepImageChannel: public DeepImageChanne
 
     virtual DeepSlice   slice () const;
 
+    virtual DeepSlice   sliceRows (int r1,
+                                   int r2,
+                                   std::vector<char *> &p) const;
+
 
     //
     // Access to the pixel at pixel space location (x, y), without bounds
@@ -134,6 +172,10 @@ class IMFUTIL_EXPORT_TEMPLATE_TYPE TypedDeepImageChannel: public DeepImageChanne
     // The pixel contains a pointer to an array of samples to type T.  The
     // number of samples in this array is sampleCounts().at(x,y).
     //
+    // operator() and at() look the pixel up in the channel's per-pixel
+    // sample list pointers, and they can be used only if the level's
+    // samples are stored with DEEP_STORAGE_LISTS.
+    //
 
     T *                 operator () (int x, int y);
     const T *           operator () (int x, int y) const;
@@ -157,10 +199,24 @@ class IMFUTIL_EXPORT_TEMPLATE_TYPE TypedDeepImageChannel: public DeepImageChanne
     // contains pixelsPerRow() values.  The number of samples in
     // row(r)[i] is sampleCounts().row(r)[i].
     //
+    // Like operator(), row() can be used only if the level's samples
+    // are stored with DEEP_STORAGE_LISTS.
+    //
 
     T * const *         row (int r);
     const T * const *   row (int r) const;
 
+
+    //
+    // Access to the pixel at pixel space location (x, y), without bounds
+    // checking, for either storage mode.  sampleList() finds the pixel's
+    // sample list through its position in the channel's sample buffer,
+    // and it does not need the per-pixel sample list pointers.
+    //
+
+    T *                 sampleList (int x, int y);
+    const T *           sampleList (int x, int y) const;
+
   private:
     
     friend class DeepImageLevel;
@@ -203,8 +259,16 @@ class IMFUTIL_EXPORT_TEMPLATE_TYPE TypedDeepImageChannel: public DeepImageChanne
     IMFUTIL_HIDDEN
     virtual void resetBasePointer ();
 
+    IMFUTIL_HIDDEN
+    virtual void moveSampleListsToNewBuffer
+                            (const unsigned int * oldNumSamples,
+                             const size_t * oldSampleListPositions,
+                             const unsigned int * newNumSamples,
+                             const size_t * newSampleListPositions);
+
     T **    _sampleListPointers;    // Array of pointers to per-pixel
-                                    //sample lists
+                                    // sample lists, or 0 for
+                                    // DEEP_STORAGE_COMPACT
 
     T **    _base;                  // Base pointer for faster access
                                     // to entries in _sampleListPointers
@@ -212,6 +276,10 @@ class IMFUTIL_EXPORT_TEMPLATE_TYPE TypedDeepImageChannel: public DeepImageChanne
     T *     _sampleBuffer;          // Contiguous memory block that
                                     // contains all sample lists for
                                     // this channel
+
+    const size_t * _positionsBase;  // Base pointer for faster access
+                                    // to the sample list positions in
+                                    // the sample count channel
 };
 
 
@@ -276,6 +344,22 @@ TypedDeepImageChannel<T>::row (int r) const
     return _base + r * pixelsPerRow();
 }
 
+
+template <class T>
+inline T *
+TypedDeepImageChannel<T>::sampleList (int x, int y)
+{
+    return _sampleBuffer + _positionsBase[y * pixelsPerRow() + x];
+}
+
+
+template <class T>
+inline const T *
+TypedDeepImageChannel<T>::sampleList (int x, int y) const
+{
+    return _sampleBuffer + _positionsBase[y * pixelsPerRow() + x];
+}
+
 #ifndef COMPILING_IMF_DEEP_IMAGE_CHANNEL
 extern template class IMFUTIL_EXPORT_EXTERN_TEMPLATE TypedDeepImageChannel<half>;
 extern template class IMFUTIL_EXPORT_EXTERN_TEMPLATE TypedDeepImageChannel<float>;
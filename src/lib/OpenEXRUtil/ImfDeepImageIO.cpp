@@ -10,6 +10,7 @@
 //----------------------------------------------------------------------------
 
 #include "ImfDeepImageIO.h"
+#include "ImfLevelReader.h"
 #include <ImfDeepScanLineInputFile.h>
 #include <ImfDeepScanLineOutputFile.h>
 #include <ImfDeepTiledInputFile.h>
@@ -20,6 +21,8 @@
 #include <ImfTestFile.h>
 #include <ImfPartType.h>
 #include <Iex.h>
+#include <algorithm>
+#include <vector>
 #include <cstring>
 #include <cassert>
 
@@ -29,6 +32,52 @@ using namespace std;
 
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
 
+namespace {
+
+//
+// Deep image levels with DEEP_STORAGE_COMPACT have no per-pixel sample
+// list pointers to which a frame buffer for the whole level could refer.
+// Such levels are read and written in bands of rows instead, using a
+// frame buffer that refers to temporary sample list pointers for only
+// the rows in one band.
+//
+
+const int rowsPerBand = 64;
+
+
+void
+insertBandSlices
+    (DeepFrameBuffer &fb,
+     const DeepImageLevel &level,
+     int y1,
+     int y2,
+     vector < vector <char *> > &sampleListPointers)
+{
+    //
+    // Insert slices for the sample counts and for all deep channels of
+    // the level into frame buffer fb.  The channel slices cover only
+    // scan lines y1 through y2.
+    //
+
+    size_t numChannels = 0;
+
+    for (DeepImageLevel::ConstIterator i = level.begin(); i != level.end(); ++i)
+        ++numChannels;
+
+    sampleListPointers.resize (numChannels);
+
+    fb.insertSampleCountSlice (level.sampleCounts().slice());
+
+    int r1 = y1 - level.dataWindow().min.y;
+    int r2 = y2 - level.dataWindow().min.y;
+    size_t j = 0;
+
+    for (DeepImageLevel::ConstIterator i = level.begin(); i != level.end(); ++i)
+        fb.insert (i.name(), i.channel().sliceRows (r1, r2, sampleListPointers[j++]));
+}
+
+} // namespace
+
 
 void
 saveDeepImage
@@ -138,19 +187,51 @@ saveDeepScanLineImage
     newHdr.compression() = ZIPS_COMPRESSION;
 
     const DeepImageLevel &level = img.level();
-    DeepFrameBuffer fb;
-
-    fb.insertSampleCountSlice (level.sampleCounts().slice());
 
     for (DeepImageLevel::ConstIterator i = level.begin(); i != level.end(); ++i)
-    {
         newHdr.channels().insert (i.name(), i.channel().channel());
-        fb.insert (i.name(), i.channel().slice());
-    }
 
     DeepScanLineOutputFile out (fileName.c_str(), newHdr);
-    out.setFrameBuffer (fb);
-    out.writePixels (newHdr.dataWindow().max.y - newHdr.dataWindow().min.y + 1);
+
+    int numLines = newHdr.dataWindow().max.y - newHdr.dataWindow().min.y + 1;
+
+    if (level.sampleCounts().storageMode() == DEEP_STORAGE_LISTS)
+    {
+        DeepFrameBuffer fb;
+
+        fb.insertSampleCountSlice (level.sampleCounts().slice());
+
+        for (DeepImageLevel::ConstIterator i = level.begin();
+             i != level.end();
+             ++i)
+        {
+            fb.insert (i.name(), i.channel().slice());
+        }
+
+        out.setFrameBuffer (fb);
+        out.writePixels (numLines);
+    }
+    else
+    {
+        vector < vector <char *> > sampleListPointers;
+
+        while (numLines > 0)
+        {
+            int n = min (numLines, rowsPerBand);
+            int y = out.currentScanLine();
+
+            DeepFrameBuffer fb;
+
+            if (newHdr.lineOrder() == DECREASING_Y)
+                insertBandSlices (fb, level, y - n + 1, y, sampleListPointers);
+            else
+                insertBandSlices (fb, level, y, y + n - 1, sampleListPointers);
+
+            out.setFrameBuffer (fb);
+            out.writePixels (n);
+            numLines -= n;
+        }
+    }
 }
 
 
@@ -183,23 +264,64 @@ loadDeepScanLineImage
     img.resize (in.header().dataWindow(), ONE_LEVEL, ROUND_DOWN);
 
     DeepImageLevel &level = img.level();
-    DeepFrameBuffer fb;
+    const Box2i &dw = level.dataWindow();
 
-    fb.insertSampleCountSlice (level.sampleCounts().slice());
+    if (level.sampleCounts().storageMode() == DEEP_STORAGE_LISTS)
+    {
+        DeepFrameBuffer fb;
 
-    for (DeepImageLevel::ConstIterator i = level.begin(); i != level.end(); ++i)
-        fb.insert (i.name(), i.channel().slice());
+        fb.insertSampleCountSlice (level.sampleCounts().slice());
 
-    in.setFrameBuffer (fb);
+        for (DeepImageLevel::ConstIterator i = level.begin();
+             i != level.end();
+             ++i)
+        {
+            fb.insert (i.name(), i.channel().slice());
+        }
 
-    {
-        SampleCountChannel::Edit edit (level.sampleCounts());
+        in.setFrameBuffer (fb);
+
+        {
+            SampleCountChannel::Edit edit (level.sampleCounts());
+
+            in.readPixelSampleCounts (dw.min.y, dw.max.y);
+        }
 
-        in.readPixelSampleCounts
-            (level.dataWindow().min.y, level.dataWindow().max.y);
+        in.readPixels (dw.min.y, dw.max.y);
     }
+    else
+    {
+        DeepFrameBuffer fb;
+
+        fb.insertSampleCountSlice (level.sampleCounts().slice());
+        in.setFrameBuffer (fb);
+
+        {
+            SampleCountChannel::Edit edit (level.sampleCounts());
+
+            in.readPixelSampleCounts (dw.min.y, dw.max.y);
+        }
 
-    in.readPixels (level.dataWindow().min.y, level.dataWindow().max.y);
+        vector < vector <char *> > sampleListPointers;
+
+        for (int y1 = dw.min.y; y1 <= dw.max.y; y1 += rowsPerBand)
+        {
+            int y2 = min (y1 + rowsPerBand - 1, dw.max.y);
+
+            DeepFrameBuffer bandFb;
+            insertBandSlices (bandFb, level, y1, y2, sampleListPointers);
+
+            //
+            // Setting a new frame buffer makes the file forget the
+            // sample counts; reading them again stores the same values
+            // that are already in the sample count channel.
+            //
+
+            in.setFrameBuffer (bandFb);
+            in.readPixelSampleCounts (y1, y2);
+            in.readPixels (y1, y2);
+        }
+    }
 
     for (Header::ConstIterator i = in.header().begin();
          i != in.header().end();
@@ -227,15 +349,47 @@ void
 saveLevel (DeepTiledOutputFile &out, const DeepImage &img, int x, int y)
 {
     const DeepImageLevel &level = img.level (x, y);
-    DeepFrameBuffer fb;
 
-    fb.insertSampleCountSlice (level.sampleCounts().slice());
+    if (level.sampleCounts().storageMode() == DEEP_STORAGE_LISTS)
+    {
+        DeepFrameBuffer fb;
 
-    for (DeepImageLevel::ConstIterator i = level.begin(); i != level.end(); ++i)
-        fb.insert (i.name(), i.channel().slice());
+        fb.insertSampleCountSlice (level.sampleCounts().slice());
+
+        for (DeepImageLevel::ConstIterator i = level.begin();
+             i != level.end();
+             ++i)
+        {
+            fb.insert (i.name(), i.channel().slice());
+        }
+
+        out.setFrameBuffer (fb);
+        out.writeTiles (0, out.numXTiles (x) - 1, 0, out.numYTiles (y) - 1, x, y);
+    }
+    else
+    {
+        //
+        // Write one row of tiles at a time.
+        //
+
+        vector < vector <char *> > sampleListPointers;
+
+        for (int dy = 0; dy < out.numYTiles (y); ++dy)
+        {
+            Box2i tileRange = out.dataWindowForTile (0, dy, x, y);
+
+            DeepFrameBuffer fb;
 
-    out.setFrameBuffer (fb);
-    out.writeTiles (0, out.numXTiles (x) - 1, 0, out.numYTiles (y) - 1, x, y);
+            insertBandSlices (fb,
+                              level,
+                              tileRange.min.y,
+                              tileRange.max.y,
+                              sampleListPointers);
+
+            out.setFrameBuffer (fb);
+            out.writeTiles (0, out.numXTiles (x) - 1, dy, dy, x, y);
+        }
+    }
 }
 
 } // namespace
@@ -336,28 +490,114 @@ saveDeepTiledImage
 namespace {
 
 void
-loadLevel (DeepTiledInputFile &in, DeepImage &img, int x, int y)
+loadSampleCounts (DeepTiledInputFile &in, DeepImage &img, int x, int y)
 {
     DeepImageLevel &level = img.level (x, y);
     DeepFrameBuffer fb;
 
     fb.insertSampleCountSlice (level.sampleCounts().slice());
+    in.setFrameBuffer (fb);
 
-    for (DeepImageLevel::ConstIterator i = level.begin(); i != level.end(); ++i)
-        fb.insert (i.name(), i.channel().slice());
+    SampleCountChannel::Edit edit (level.sampleCounts());
 
-    in.setFrameBuffer (fb);
+    in.readPixelSampleCounts
+        (0, in.numXTiles (x) - 1, 0, in.numYTiles (y) - 1, x, y);
+}
+
+
+void
+loadSamples (DeepTiledInputFile &in, DeepImage &img, int x, int y)
+{
+    DeepImageLevel &level = img.level (x, y);
 
+    if (level.sampleCounts().storageMode() == DEEP_STORAGE_LISTS)
     {
-        SampleCountChannel::Edit edit (level.sampleCounts());
+        DeepFrameBuffer fb;
+
+        fb.insertSampleCountSlice (level.sampleCounts().slice());
+
+        for (DeepImageLevel::ConstIterator i = level.begin();
+             i != level.end();
+             ++i)
+        {
+            fb.insert (i.name(), i.channel().slice());
+        }
 
-        in.readPixelSampleCounts
-            (0, in.numXTiles (x) - 1, 0, in.numYTiles (y) - 1, x, y);
+        in.setFrameBuffer (fb);
+        in.readTiles (0, in.numXTiles (x) - 1, 0, in.numYTiles (y) - 1, x, y);
     }
+    else
+    {
+        //
+        // Read one row of tiles at a time.
+        //
 
-    in.readTiles (0, in.numXTiles (x) - 1, 0, in.numYTiles (y) - 1, x, y);
+        vector < vector <char *> > sampleListPointers;
+
+        for (int dy = 0; dy < in.numYTiles (y); ++dy)
+        {
+            Box2i tileRange = in.dataWindowForTile (0, dy, x, y);
+
+            DeepFrameBuffer fb;
+
+            insertBandSlices (fb,
+                              level,
+                              tileRange.min.y,
+                              tileRange.max.y,
+                              sampleListPointers);
+
+            in.setFrameBuffer (fb);
+            in.readTiles (0, in.numXTiles (x) - 1, dy, dy, x, y);
+        }
+    }
 }
 
+
+class TiledLevelReader: public LevelReader
+{
+  public:
+
+    //
+    // Reads the samples of the levels of a deep image.  Reader number 0
+    // uses file object in; the other readers open the file fileName
+    // again, the first time they are called.
+    //
+
+    TiledLevelReader (const string &fileName,
+                      DeepTiledInputFile &in,
+                      DeepImage &img,
+                      int numReaders)
+    :
+        _fileName (fileName),
+        _img (img),
+        _files (numReaders, 0)
+    {
+        _files[0] = &in;
+    }
+
+    virtual
+    ~TiledLevelReader ()
+    {
+        for (size_t r = 1; r < _files.size(); ++r)
+            delete _files[r];
+    }
+
+    virtual void
+    readLevel (int r, int lx, int ly)
+    {
+        if (_files[r] == 0)
+            _files[r] = new DeepTiledInputFile (_fileName.c_str());
+
+        loadSamples (*_files[r], _img, lx, ly);
+    }
+
+  private:
+
+    const string &                  _fileName;
+    DeepImage &                     _img;
+    vector <DeepTiledInputFile *>   _files;
+};
+
 } // namespace
 
 
@@ -380,18 +620,25 @@ loadDeepTiledImage
                 in.header().tileDescription().mode,
                 in.header().tileDescription().roundingMode);
 
+    //
+    // Read the sample counts and allocate memory for the samples level by
+    // level, in this thread: if allocation fails, the image is resized,
+    // which must not happen while other threads are reading samples.
+    // Then read the samples of all levels.
+    //
+
     switch (img.levelMode())
     {
       case ONE_LEVEL:
 
-        loadLevel (in, img, 0, 0);
+        loadSampleCounts (in, img, 0, 0);
 
         break;
 
       case MIPMAP_LEVELS:
 
         for (int x = 0; x < img.numLevels(); ++x)
-            loadLevel (in, img, x, x);
+            loadSampleCounts (in, img, x, x);
 
         break;
 
@@ -399,7 +646,7 @@ loadDeepTiledImage
 
         for (int y = 0; y < img.numYLevels(); ++y)
             for (int x = 0; x < img.numXLevels(); ++x)
-                loadLevel (in, img, x, y);
+                loadSampleCounts (in, img, x, y);
 
         break;
 
@@ -408,6 +655,11 @@ loadDeepTiledImage
         assert (false);
     }
 
+    int numReaders = numLevelReaders (img);
+    TiledLevelReader reader (fileName, in, img, numReaders);
+
+    readLevels (img, numReaders, reader);
+
     for (Header::ConstIterator i = in.header().begin();
          i != in.header().end();
          ++i)
@@ -85,16 +85,18 @@ DeepImageLevel::moveSampleList
 
 
 void
-DeepImageLevel::moveSamplesToNewBuffer
+DeepImageLevel::moveSampleListsToNewBuffer
     (const unsigned int * oldNumSamples,
+     const size_t * oldSampleListPositions,
      const unsigned int * newNumSamples,
      const size_t * newSampleListPositions)
 {
     for (ChannelMap::iterator j = _channels.begin(); j != _channels.end(); ++j)
     {
-        j->second->moveSamplesToNewBuffer (oldNumSamples,
-                                           newNumSamples,
-                                           newSampleListPositions);
+        j->second->moveSampleListsToNewBuffer (oldNumSamples,
+                                               oldSampleListPositions,
+                                               newNumSamples,
+                                               newSampleListPositions);
     }
 }
 
@@ -107,6 +109,13 @@ DeepImageLevel::initializeSampleLists ()
 }
 
 
+void
+DeepImageLevel::setStorageMode (DeepStorageMode storageMode)
+{
+    _sampleCounts.setStorageMode (storageMode);
+}
+
+
 void			
 DeepImageLevel::resize (const Box2i& dataWindow)
 {
@@ -149,13 +149,18 @@ class IMFUTIL_EXPORT_TYPE DeepImageLevel : public ImageLevel
                                  size_t newSampleListPosition);
 
     IMF_HIDDEN
-    void         moveSamplesToNewBuffer (const unsigned int * oldNumSamples,
-                                         const unsigned int * newNumSamples,
-                                         const size_t * newSampleListPositions);
+    void         moveSampleListsToNewBuffer
+                                (const unsigned int * oldNumSamples,
+                                 const size_t * oldSampleListPositions,
+                                 const unsigned int * newNumSamples,
+                                 const size_t * newSampleListPositions);
 
     IMF_HIDDEN
     void         initializeSampleLists ();
 
+    IMF_HIDDEN
+    void         setStorageMode (DeepStorageMode storageMode);
+
     IMF_HIDDEN
     virtual void resize (const IMATH_NAMESPACE::Box2i& dataWindow);
 
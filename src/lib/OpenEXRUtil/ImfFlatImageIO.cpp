@@ -10,6 +10,7 @@
 //----------------------------------------------------------------------------
 
 #include "ImfFlatImageIO.h"
+#include "ImfLevelReader.h"
 #include <ImfInputFile.h>
 #include <ImfOutputFile.h>
 #include <ImfTiledInputFile.h>
@@ -18,6 +19,7 @@
 #include <ImfChannelList.h>
 #include <ImfTestFile.h>
 #include <Iex.h>
+#include <vector>
 #include <cstring>
 #include <cassert>
 
@@ -308,6 +310,52 @@ loadLevel (TiledInputFile &in, FlatImage &img, int x, int y)
     in.readTiles (0, in.numXTiles (x) - 1, 0, in.numYTiles (y) - 1, x, y);
 }
 
+
+class TiledLevelReader: public LevelReader
+{
+  public:
+
+    //
+    // Reads the levels of a flat image.  Reader number 0 uses file
+    // object in; the other readers open the file fileName again,
+    // the first time they are called.
+    //
+
+    TiledLevelReader (const string &fileName,
+                      TiledInputFile &in,
+                      FlatImage &img,
+                      int numReaders)
+    :
+        _fileName (fileName),
+        _img (img),
+        _files (numReaders, 0)
+    {
+        _files[0] = &in;
+    }
+
+    virtual
+    ~TiledLevelReader ()
+    {
+        for (size_t r = 1; r < _files.size(); ++r)
+            delete _files[r];
+    }
+
+    virtual void
+    readLevel (int r, int lx, int ly)
+    {
+        if (_files[r] == 0)
+            _files[r] = new TiledInputFile (_fileName.c_str());
+
+        loadLevel (*_files[r], _img, lx, ly);
+    }
+
+  private:
+
+    const string &              _fileName;
+    FlatImage &                 _img;
+    vector <TiledInputFile *>   _files;
+};
+
 } // namespace
 
 
@@ -330,33 +378,10 @@ loadFlatTiledImage
                 in.header().tileDescription().mode,
                 in.header().tileDescription().roundingMode);
 
-    switch (img.levelMode())
-    {
-      case ONE_LEVEL:
-
-        loadLevel (in, img, 0, 0);
-
-        break;
-
-      case MIPMAP_LEVELS:
+    int numReaders = numLevelReaders (img);
+    TiledLevelReader reader (fileName, in, img, numReaders);
 
-        for (int x = 0; x < img.numLevels(); ++x)
-            loadLevel (in, img, x, x);
-
-        break;
-
-      case RIPMAP_LEVELS:
-
-        for (int y = 0; y < img.numYLevels(); ++y)
-            for (int x = 0; x < img.numXLevels(); ++x)
-                loadLevel (in, img, x, y);
-
-        break;
-
-      default:
-
-        assert (false);
-    }
+    readLevels (img, numReaders, reader);
 
     for (Header::ConstIterator i = in.header().begin();
          i != in.header().end();
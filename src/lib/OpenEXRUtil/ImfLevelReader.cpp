@@ -0,0 +1,242 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+//----------------------------------------------------------------------------
+//
+//      class LevelReader, function readLevels()
+//
+//----------------------------------------------------------------------------
+
+#include "ImfLevelReader.h"
+#include "ImfImage.h"
+#include <ImfThreading.h>
+#include <IlmThreadPool.h>
+#include <Iex.h>
+#include <algorithm>
+#include <exception>
+#include <vector>
+#if ILMTHREAD_THREADING_ENABLED
+#    include <mutex>
+#endif
+
+using namespace IMATH_NAMESPACE;
+using namespace IEX_NAMESPACE;
+using namespace std;
+
+using ILMTHREAD_NAMESPACE::Task;
+using ILMTHREAD_NAMESPACE::TaskGroup;
+using ILMTHREAD_NAMESPACE::ThreadPool;
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+namespace {
+
+//
+// A few concurrent levels are enough to keep the global thread pool
+// busy while one level's last tiles are decoded; each additional
+// reader opens another file and allocates another set of tile buffers.
+//
+
+const int maxLevelReaders = 4;
+
+
+struct LevelNumber
+{
+    int     lx;
+    int     ly;
+    size_t  numPixels;
+};
+
+
+bool
+isLarger (const LevelNumber &l1, const LevelNumber &l2)
+{
+    return l1.numPixels > l2.numPixels;
+}
+
+
+vector<LevelNumber>
+levelNumbers (const Image &img)
+{
+    vector<LevelNumber> levels;
+
+    for (int ly = 0; ly < img.numYLevels(); ++ly)
+    {
+        for (int lx = 0; lx < img.numXLevels(); ++lx)
+        {
+            if (img.levelMode() == MIPMAP_LEVELS && lx != ly)
+                continue;
+
+            LevelNumber l;
+
+            l.lx = lx;
+            l.ly = ly;
+            l.numPixels = size_t (img.levelWidth (lx)) * img.levelHeight (ly);
+
+            levels.push_back (l);
+        }
+    }
+
+    return levels;
+}
+
+
+struct LevelQueue
+#if ILMTHREAD_THREADING_ENABLED
+    : public std::mutex
+#endif
+{
+    vector<LevelNumber>     levels;
+    size_t                  next;
+    bool                    failed;
+
+    LevelQueue (): next (0), failed (false) {}
+
+    bool
+    pop (LevelNumber &l)
+    {
+#if ILMTHREAD_THREADING_ENABLED
+        std::lock_guard<std::mutex> lock (*this);
+#endif
+        if (failed || next >= levels.size())
+            return false;
+
+        l = levels[next++];
+        return true;
+    }
+
+    void
+    fail ()
+    {
+#if ILMTHREAD_THREADING_ENABLED
+        std::lock_guard<std::mutex> lock (*this);
+#endif
+        failed = true;
+    }
+};
+
+
+void
+runReader (LevelReader &reader, int r, LevelQueue &queue, exception_ptr &error)
+{
+    //
+    // Read levels until the queue is empty.  Exceptions are stored
+    // in error, and re-thrown by readLevels() in the calling thread.
+    //
+
+    try
+    {
+        LevelNumber l;
+
+        while (queue.pop (l))
+            reader.readLevel (r, l.lx, l.ly);
+    }
+    catch (...)
+    {
+        error = current_exception();
+        queue.fail();
+    }
+}
+
+
+class LevelReaderTask: public Task
+{
+  public:
+
+    LevelReaderTask (TaskGroup *group,
+                     LevelReader &reader,
+                     int r,
+                     LevelQueue &queue,
+                     exception_ptr &error)
+    :
+        Task (group),
+        _reader (reader),
+        _r (r),
+        _queue (queue),
+        _error (error)
+    {
+        // empty
+    }
+
+    virtual void
+    execute ()
+    {
+        runReader (_reader, _r, _queue, _error);
+    }
+
+  private:
+
+    LevelReader &       _reader;
+    int                 _r;
+    LevelQueue &        _queue;
+    exception_ptr &     _error;
+};
+
+} // namespace
+
+
+LevelReader::~LevelReader ()
+{
+    // empty
+}
+
+
+int
+numLevelReaders (const Image &img)
+{
+    if (globalThreadCount() < 2)
+        return 1;
+
+    int numLevels = int (levelNumbers (img).size());
+
+    return max (1, min (numLevels, maxLevelReaders));
+}
+
+
+void
+readLevels (const Image &img, int numReaders, LevelReader &reader)
+{
+    LevelQueue queue;
+
+    queue.levels = levelNumbers (img);
+    stable_sort (queue.levels.begin(), queue.levels.end(), isLarger);
+
+    numReaders = max (1, min (numReaders, int (queue.levels.size())));
+    vector<exception_ptr> errors (numReaders);
+
+    if (numReaders > 1)
+    {
+        ThreadPool pool (numReaders - 1);
+
+        //
+        // The TaskGroup destructor waits until all readers have finished;
+        // it must run before the thread pool's destructor.
+        //
+
+        TaskGroup taskGroup;
+
+        for (int r = 1; r < numReaders; ++r)
+        {
+            pool.addTask (new LevelReaderTask (&taskGroup,
+                                               reader,
+                                               r,
+                                               queue,
+                                               errors[r]));
+        }
+
+        runReader (reader, 0, queue, errors[0]);
+    }
+    else
+    {
+        runReader (reader, 0, queue, errors[0]);
+    }
+
+    for (int r = 0; r < numReaders; ++r)
+        if (errors[r])
+            rethrow_exception (errors[r]);
+}
+
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -0,0 +1,74 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifndef INCLUDED_IMF_LEVEL_READER_H
+#define INCLUDED_IMF_LEVEL_READER_H
+
+//----------------------------------------------------------------------------
+//
+//      class LevelReader, function readLevels()
+//
+//      Support for loading all levels of a multi-resolution image at the
+//      same time.  This header is internal to the OpenEXRUtil library.
+//
+//      TiledInputFile::readTiles() decodes the tiles of one level in
+//      parallel, but it returns only after the last tile has been decoded.
+//      When the levels of a mipmap or ripmap are read one after another,
+//      the global thread pool idles while each level's last few tiles are
+//      decoded, and the smallest levels have too few tiles to keep more
+//      than one thread busy at all.  readLevels() reads several levels at
+//      once instead, with one input file object per concurrent level, so
+//      that the tiles of all those levels are decoded at the same time.
+//      The tiles are still decoded directly into the image level's
+//      channels.
+//
+//----------------------------------------------------------------------------
+
+#include "ImfUtilExport.h"
+#include "ImfNamespace.h"
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
+
+class Image;
+
+
+class LevelReader
+{
+  public:
+
+    virtual ~LevelReader ();
+
+    //
+    // Read image level (lx, ly), using the file object that belongs to
+    // reader number r, where 0 <= r < numReaders.  Calls with the same
+    // reader number never overlap; calls with different reader numbers
+    // run concurrently.  Reader number 0 runs in the thread that called
+    // readLevels().
+    //
+
+    virtual void    readLevel (int r, int lx, int ly) = 0;
+};
+
+
+//
+// numLevelReaders(img) returns the number of readers that readLevels()
+// should use for image img: 1 if img has only one level or if there are
+// no threads in the global thread pool, and a small number otherwise.
+//
+// readLevels(img,n,reader) calls reader.readLevel() once for each level
+// of img.  Larger levels are read before smaller ones.  Readers 1 through
+// n-1 run in a private thread pool: readLevel() typically waits for tasks
+// in the global thread pool, and must therefore not run in that pool.
+// If readLevel() throws an exception, no new levels are started, and
+// readLevels() re-throws the exception once all readers have finished.
+//
+
+int     numLevelReaders (const Image &img);
+void    readLevels (const Image &img, int numReaders, LevelReader &reader);
+
+
+OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_EXIT
+
+#endif
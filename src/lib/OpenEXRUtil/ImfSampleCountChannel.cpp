@@ -11,8 +11,9 @@
 
 #include "ImfSampleCountChannel.h"
 #include "ImfDeepImageLevel.h"
-#include "ImfImage.h"
+#include "ImfDeepImage.h"
 #include <Iex.h>
+#include <algorithm>
 
 using namespace IMATH_NAMESPACE;
 using namespace IEX_NAMESPACE;
@@ -64,7 +65,9 @@ SampleCountChannel::SampleCountChannel (DeepImageLevel& level):
     _sampleListPositions (0),
     _totalNumSamples (0),
     _totalSamplesOccupied (0),
-    _sampleBufferSize (0)
+    _sampleBufferSize (0),
+    _oldNumSamples (0),
+    _storageMode (DEEP_STORAGE_LISTS)
 {
     resize();
 }
@@ -75,6 +78,7 @@ SampleCountChannel::~SampleCountChannel ()
     delete [] _numSamples;
     delete [] _sampleListSizes;
     delete [] _sampleListPositions;
+    delete [] _oldNumSamples;
 }
 
 
@@ -134,96 +138,74 @@ SampleCountChannel::set (int x, int y, unsigned int newNumSamples)
         return;
     }
 
-    if (newNumSamples <= _sampleListSizes[i])
+    if (_storageMode == DEEP_STORAGE_LISTS)
     {
-        //
-        // The number of samples for the pixel becomes larger, but the new
-        // number of samples still fits into the space that has been allocated
-        // for the sample list.  Set the new samples at the end of the list to
-        // zero.
-        //
-
-        deepLevel().setSamplesToZero (i,
-                                      _numSamples[i],
-                                      newNumSamples);
-
-        _totalNumSamples += newNumSamples - _numSamples[i];
-        _numSamples[i] = newNumSamples;
-        return;
-    }
+        if (newNumSamples <= _sampleListSizes[i])
+        {
+            //
+            // The number of samples for the pixel becomes larger, but the
+            // new number of samples still fits into the space that has been
+            // allocated for the sample list.  Set the new samples at the end
+            // of the list to zero.
+            //
+
+            deepLevel().setSamplesToZero (i,
+                                          _numSamples[i],
+                                          newNumSamples);
+
+            _totalNumSamples += newNumSamples - _numSamples[i];
+            _numSamples[i] = newNumSamples;
+            return;
+        }
 
-    int newSampleListSize = roundListSizeUp (newNumSamples);
+        int newSampleListSize = roundListSizeUp (newNumSamples);
 
-    if (_totalSamplesOccupied + newSampleListSize <= _sampleBufferSize)
-    {
-        //
-        // The number of samples in the pixel no longer fits into the
-        // space that has been allocated for the sample list, but there
-        // is space available at the end of the sample buffer.  Allocate
-        // space for a new list at the end of the sample buffer, and move
-        // the sample list from its old location to its new, larger place.
-        //
+        if (_totalSamplesOccupied + newSampleListSize <= _sampleBufferSize)
+        {
+            //
+            // The number of samples in the pixel no longer fits into the
+            // space that has been allocated for the sample list, but there
+            // is space available at the end of the sample buffer.  Allocate
+            // space for a new list at the end of the sample buffer, and move
+            // the sample list from its old location to its new, larger place.
+            //
 
-        deepLevel().moveSampleList
-            (i, _numSamples[i], newNumSamples, _totalSamplesOccupied);
+            deepLevel().moveSampleList
+                (i, _numSamples[i], newNumSamples, _totalSamplesOccupied);
 
-        _sampleListPositions[i] = _totalSamplesOccupied;
-        _totalSamplesOccupied += newSampleListSize;
-        _totalNumSamples += newNumSamples - _numSamples[i];
-        _numSamples[i] = newNumSamples;
-        return;
+            _sampleListPositions[i] = _totalSamplesOccupied;
+            _sampleListSizes[i] = newSampleListSize;
+            _totalSamplesOccupied += newSampleListSize;
+            _totalNumSamples += newNumSamples - _numSamples[i];
+            _numSamples[i] = newNumSamples;
+            return;
+        }
     }
 
     //
     // The new number of samples no longer fits into the space that has
     // been allocated for the sample list, and there is not enough room
-    // at the end of the sample buffer for a new, larger sample list.
-    // Allocate an entirely new sample buffer, and move all existing
-    // sample lists into it.
+    // at the end of the sample buffer for a new, larger sample list
+    // (with DEEP_STORAGE_COMPACT, there is never any room).  Allocate
+    // an entirely new sample buffer, and move all existing sample lists
+    // into it.
     //
 
     unsigned int * oldNumSamples = 0;
-    size_t * oldSampleListPositions = 0;
 
     try
     {
-        _totalNumSamples += newNumSamples - _numSamples[i];
-
-        oldNumSamples = _numSamples;
-        _numSamples = new unsigned int [numPixels()];
-
-        resetBasePointer();
-
-        oldSampleListPositions = _sampleListPositions;
-        _sampleListPositions = new size_t [numPixels()];
-
-        _totalSamplesOccupied = 0;
-
-        for (size_t j = 0; j < numPixels(); ++j)
-        {
-            if (j == i)
-                _numSamples[j] = newNumSamples;
-            else
-                _numSamples[j] = oldNumSamples[j];
-
-            _sampleListPositions[j] = _totalSamplesOccupied;
-            _sampleListSizes[j] = roundListSizeUp (_numSamples[j]);
-            _totalSamplesOccupied += _sampleListSizes[j];
-        }
+        oldNumSamples = new unsigned int [numPixels()];
+        copy (_numSamples, _numSamples + numPixels(), oldNumSamples);
 
-        _sampleBufferSize = roundBufferSizeUp (_totalSamplesOccupied);
-
-        deepLevel().moveSamplesToNewBuffer (oldNumSamples,
-                                            _numSamples,
-                                            _sampleListPositions);
+        _numSamples[i] = newNumSamples;
+        reallocateSamples (oldNumSamples);
 
         delete [] oldNumSamples;
-        delete [] oldSampleListPositions;
     }
     catch (...)
     {
         delete [] oldNumSamples;
-        delete [] oldSampleListPositions;
 
         level().image().resize (Box2i (V2i (0, 0), V2i (-1, -1)));
         throw;
@@ -235,7 +217,27 @@ void
 SampleCountChannel::set (int r, unsigned int newNumSamples[])
 {
     int x = level().dataWindow().min.x;
-    int y = r + level().dataWindow().min.x;
+    int y = r + level().dataWindow().min.y;
+
+    if (_storageMode == DEEP_STORAGE_COMPACT)
+    {
+        //
+        // Reallocate the samples once for the whole row,
+        // rather than once for every pixel that grows.
+        //
+
+        if (pixelsPerRow() > 0)
+            boundsCheck (x, y);
+
+        unsigned int * numSamples = beginBulkEdit();
+
+        copy (newNumSamples,
+              newNumSamples + pixelsPerRow(),
+              numSamples + size_t (r) * pixelsPerRow());
+
+        endBulkEdit();
+        return;
+    }
 
     for (int i = 0; i < pixelsPerRow(); ++i, ++x)
         set (x, y, newNumSamples[i]);
@@ -248,15 +250,9 @@ SampleCountChannel::clear ()
     try
     {
         for (size_t i = 0; i < numPixels(); ++i)
-        {
             _numSamples[i] = 0;
-            _sampleListSizes[i] = 0;
-            _sampleListPositions[i] = 0;
-        }
 
-        _totalNumSamples = 0;
-        _totalSamplesOccupied = 0;
-        _sampleBufferSize = roundBufferSizeUp (_totalSamplesOccupied);
+        computeSampleListPositions();
 
         deepLevel().initializeSampleLists();
     }
@@ -280,23 +276,47 @@ SampleCountChannel::endEdit ()
 {
     try
     {
-        _totalNumSamples = 0;
-        _totalSamplesOccupied = 0;
+        computeSampleListPositions();
 
-        for (size_t i = 0; i < numPixels(); ++i)
-        {
-            _sampleListSizes[i] = roundListSizeUp (_numSamples[i]);
-            _sampleListPositions[i] = _totalSamplesOccupied;
-            _totalNumSamples += _numSamples[i];
-            _totalSamplesOccupied += _sampleListSizes[i];
-        }
+        deepLevel().initializeSampleLists();
+    }
+    catch (...)
+    {
+        level().image().resize (Box2i (V2i (0, 0), V2i (-1, -1)));
+        throw;
+    }
+}
 
-        _sampleBufferSize = roundBufferSizeUp (_totalSamplesOccupied);
 
-        deepLevel().initializeSampleLists();
+unsigned int *
+SampleCountChannel::beginBulkEdit ()
+{
+    if (_oldNumSamples)
+        throw LogicExc ("Bulk edit of deep sample counts is already active.");
+
+    _oldNumSamples = new unsigned int [numPixels()];
+    copy (_numSamples, _numSamples + numPixels(), _oldNumSamples);
+
+    return _numSamples;
+}
+
+
+void
+SampleCountChannel::endBulkEdit ()
+{
+    unsigned int * oldNumSamples = _oldNumSamples;
+    _oldNumSamples = 0;
+
+    try
+    {
+        reallocateSamples (oldNumSamples);
+
+        delete [] oldNumSamples;
     }
     catch (...)
     {
+        delete [] oldNumSamples;
+
         level().image().resize (Box2i (V2i (0, 0), V2i (-1, -1)));
         throw;
     }
@@ -311,28 +331,27 @@ SampleCountChannel::resize ()
     delete [] _numSamples;
     delete [] _sampleListSizes;
     delete [] _sampleListPositions;
+    delete [] _oldNumSamples;
 
     _numSamples = 0;            // set to 0 to prevent double
     _sampleListSizes = 0;       // deletion in case of an exception
     _sampleListPositions = 0;
+    _oldNumSamples = 0;
+
+    _storageMode = deepLevel().deepImage().storageMode();
 
     _numSamples = new unsigned int [numPixels()];
-    _sampleListSizes = new unsigned int [numPixels()];
     _sampleListPositions = new size_t [numPixels()];
 
+    if (_storageMode == DEEP_STORAGE_LISTS)
+        _sampleListSizes = new unsigned int [numPixels()];
+
     resetBasePointer();
 
     for (size_t i = 0; i < numPixels(); ++i)
-    {
         _numSamples[i] = 0;
-        _sampleListSizes[i] = 0;
-        _sampleListPositions[i] = 0;
-    }
 
-    _totalNumSamples = 0;
-    _totalSamplesOccupied = 0;
-
-    _sampleBufferSize = roundBufferSizeUp (_totalSamplesOccupied);
+    computeSampleListPositions();
 }
 
 
@@ -345,4 +364,112 @@ SampleCountChannel::resetBasePointer ()
 }
 
 
+void
+SampleCountChannel::setStorageMode (DeepStorageMode storageMode)
+{
+    //
+    // Switch to a new storage mode, and rearrange the samples
+    // in the deep channels accordingly.
+    //
+
+    if (storageMode == _storageMode)
+        return;
+
+    try
+    {
+        _storageMode = storageMode;
+        reallocateSamples (_numSamples);
+    }
+    catch (...)
+    {
+        level().image().resize (Box2i (V2i (0, 0), V2i (-1, -1)));
+        throw;
+    }
+}
+
+
+void
+SampleCountChannel::computeSampleListPositions ()
+{
+    //
+    // Lay out the sample lists for the current sample counts:
+    // compute the position of each pixel's sample list within
+    // the sample buffer, and the size of the sample buffer.
+    //
+
+    _totalNumSamples = 0;
+    _totalSamplesOccupied = 0;
+
+    if (_storageMode == DEEP_STORAGE_LISTS)
+    {
+        for (size_t i = 0; i < numPixels(); ++i)
+        {
+            _sampleListSizes[i] = roundListSizeUp (_numSamples[i]);
+            _sampleListPositions[i] = _totalSamplesOccupied;
+            _totalNumSamples += _numSamples[i];
+            _totalSamplesOccupied += _sampleListSizes[i];
+        }
+
+        _sampleBufferSize = roundBufferSizeUp (_totalSamplesOccupied);
+    }
+    else
+    {
+        for (size_t i = 0; i < numPixels(); ++i)
+        {
+            _sampleListPositions[i] = _totalNumSamples;
+            _totalNumSamples += _numSamples[i];
+        }
+
+        _totalSamplesOccupied = _totalNumSamples;
+        _sampleBufferSize = _totalNumSamples;
+    }
+}
+
+
+void
+SampleCountChannel::reallocateSamples (const unsigned int * oldNumSamples)
+{
+    //
+    // Lay out new sample lists according to the current sample counts
+    // and storage mode, and move the samples of all deep channels there.
+    // On entry, oldNumSamples and _sampleListPositions describe where
+    // the samples are currently stored.
+    //
+    // If this function throws, the caller must clean up by resizing
+    // the image.
+    //
+
+    size_t * oldSampleListPositions = _sampleListPositions;
+    _sampleListPositions = 0;
+
+    try
+    {
+        _sampleListPositions = new size_t [numPixels()];
+
+        if (_storageMode == DEEP_STORAGE_LISTS && _sampleListSizes == 0)
+            _sampleListSizes = new unsigned int [numPixels()];
+
+        computeSampleListPositions();
+
+        deepLevel().moveSampleListsToNewBuffer (oldNumSamples,
+                                                oldSampleListPositions,
+                                                _numSamples,
+                                                _sampleListPositions);
+
+        if (_storageMode == DEEP_STORAGE_COMPACT)
+        {
+            delete [] _sampleListSizes;
+            _sampleListSizes = 0;
+        }
+
+        delete [] oldSampleListPositions;
+    }
+    catch (...)
+    {
+        delete [] oldSampleListPositions;
+        throw;
+    }
+}
+
+
 OPENEXR_IMF_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -22,6 +22,34 @@ OPENEXR_IMF_INTERNAL_NAMESPACE_HEADER_ENTER
 
 class DeepImageLevel;
 
+//
+// Storage modes for the samples of a deep image:
+//
+// DEEP_STORAGE_LISTS       Each pixel's sample list is allocated with room
+//                          to grow, and each deep channel keeps an array of
+//                          per-pixel pointers to its sample lists.  Changing
+//                          the number of samples in a single pixel is cheap.
+//
+// DEEP_STORAGE_COMPACT     The sample lists of all pixels are packed back to
+//                          back, in row-major order, without any unused
+//                          space.  The position of a pixel's sample list is
+//                          the sum of the sample counts of all preceding
+//                          pixels.  Deep channels keep no per-pixel pointers,
+//                          which saves a lot of memory for large images, but
+//                          increasing the number of samples in a pixel moves
+//                          all samples in the level.  (Decreasing it leaves
+//                          unused space until the samples are moved again.)
+//                          When changing many sample counts, use
+//                          SampleCountChannel::BulkEdit.
+//
+
+enum DeepStorageMode
+{
+    DEEP_STORAGE_LISTS,
+    DEEP_STORAGE_COMPACT
+};
+
+
 //
 // Sample count channel for a deep image level:
 //
@@ -125,6 +153,9 @@ class IMFUTIL_EXPORT_TYPE SampleCountChannel : public ImageChannel
     // Memory allocation for the sample lists is not particularly clever;
     // repeatedly increasing and decreasing the number of samples in the
     // pixels of a level is likely to result in serious memory fragmentation.
+    // With DEEP_STORAGE_COMPACT, increasing the number of samples in a pixel
+    // reallocates the samples of all pixels; set(r,m) does this only once
+    // for the entire row.
     //
     // Setting the number of samples for one or more pixels may cause the
     // program to run out of memory.  If this happens, the image is resized
@@ -214,8 +245,83 @@ class IMFUTIL_EXPORT_TYPE SampleCountChannel : public ImageChannel
     };
 
 
+    //
+    // Changing many sample counts at once, keeping the existing samples:
+    //
+    //  beginBulkEdit() returns a pointer to the array of sample counts,
+    //                  just like beginEdit(), but the samples in the deep
+    //                  channels are not freed.
+    //
+    //                  After beginBulkEdit() returns, application code may
+    //                  change any number of values in the sample count
+    //                  array.  Until endBulkEdit() is called, application
+    //                  code must neither access the samples in the deep
+    //                  channels nor call set(), clear() or beginEdit().
+    //
+    //  endBulkEdit()   moves the samples of all deep channels into new
+    //                  memory, laid out according to the new sample counts.
+    //                  As with set(), the samples that fit into a pixel's new
+    //                  sample list are kept, and new samples are set to zero.
+    //                  Unlike a sequence of set() calls, this reallocates
+    //                  the samples only once; for large levels, the samples
+    //                  are moved in parallel, on the global thread pool.
+    //
+    // Each call to beginBulkEdit() must be followed by a corresponding
+    // endBulkEdit() call; a temporary BulkEdit object does this
+    // automatically.  If endBulkEdit() runs out of memory, the image is
+    // resized to zero by zero pixels and an exception is thrown.
+    //
+
+    IMFUTIL_EXPORT
+	unsigned int *      beginBulkEdit();
+    IMFUTIL_EXPORT
+	void                endBulkEdit();
+
+    class BulkEdit
+    {
+      public:
+
+        //
+        // Constructor calls level->beginBulkEdit(),
+        // destructor calls level->endBulkEdit().
+        //
+
+         IMFUTIL_EXPORT
+         BulkEdit (SampleCountChannel& level);
+         IMFUTIL_EXPORT
+        ~BulkEdit ();
+
+        BulkEdit (const BulkEdit& other) = delete;
+        BulkEdit& operator = (const BulkEdit& other) = delete;
+        BulkEdit (BulkEdit&& other) = delete;
+        BulkEdit& operator = (BulkEdit&& other) = delete;
+
+        //
+        // Access to the writable sample count array.
+        //
+
+        IMFUTIL_EXPORT
+        unsigned int *          sampleCounts () const;
+
+      private:
+
+        SampleCountChannel &    _channel;
+        unsigned int *          _sampleCounts;
+    };
+
+
+    //
+    // The storage mode for the samples in this level.  The storage mode
+    // is chosen for the whole image, see DeepImage::setStorageMode().
+    //
+
+    IMFUTIL_EXPORT
+    DeepStorageMode         storageMode () const;
+
+
     //
     // Functions that support the implementation of deep image channels.
+    // With DEEP_STORAGE_COMPACT, sampleListSizes() returns 0.
     //
 
     IMFUTIL_EXPORT
@@ -244,13 +350,20 @@ class IMFUTIL_EXPORT_TYPE SampleCountChannel : public ImageChannel
 
     void                resetBasePointer ();
 
+    void                setStorageMode (DeepStorageMode storageMode);
+
+    void                computeSampleListPositions ();
+
+    void                reallocateSamples (const unsigned int *oldNumSamples);
+
     unsigned int *  _numSamples;            // Array of per-pixel sample counts
                                            
     unsigned int *  _base;                  // Base pointer for faster access
                                             // to entries in _numSamples
 
     unsigned int *  _sampleListSizes;       // Array of allocated sizes of
-                                            // per-pixel sample lists
+                                            // per-pixel sample lists, or 0
+                                            // for DEEP_STORAGE_COMPACT
 
     size_t *        _sampleListPositions;   // Array of positions of per-pixel
                                             // sample lists within sample list
@@ -265,6 +378,11 @@ class IMFUTIL_EXPORT_TYPE SampleCountChannel : public ImageChannel
                                             // lists or lost to fragmentation
 
     size_t          _sampleBufferSize;      // Size of the sample list buffer.
+
+    unsigned int *  _oldNumSamples;         // Copy of _numSamples taken by
+                                            // beginBulkEdit()
+
+    DeepStorageMode _storageMode;           // Sample storage mode
 };
 
 
@@ -296,6 +414,36 @@ SampleCountChannel::Edit::sampleCounts () const
 }
 
 
+inline
+SampleCountChannel::BulkEdit::BulkEdit (SampleCountChannel &channel):
+    _channel (channel),
+    _sampleCounts (channel.beginBulkEdit())
+{
+    // empty
+}
+
+
+inline
+SampleCountChannel::BulkEdit::~BulkEdit ()
+{
+    _channel.endBulkEdit();
+}
+
+
+inline unsigned int *
+SampleCountChannel::BulkEdit::sampleCounts () const
+{
+    return _sampleCounts;
+}
+
+
+inline DeepStorageMode
+SampleCountChannel::storageMode () const
+{
+    return _storageMode;
+}
+
+
 inline const unsigned int *
 SampleCountChannel::numSamples () const
 {
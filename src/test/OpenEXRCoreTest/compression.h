@@ -18,6 +18,7 @@ void testB44Compression( const std::string &tempdir );
 void testB44ACompression( const std::string &tempdir );
 void testDWAACompression( const std::string &tempdir );
 void testDWABCompression( const std::string &tempdir );
+void testZipCompressionLevel( const std::string &tempdir );
 
 void testDeepNoCompression( const std::string &tempdir );
 void testDeepZIPCompression( const std::string &tempdir );
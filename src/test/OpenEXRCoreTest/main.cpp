@@ -172,6 +172,10 @@ main (int argc, char *argv[])
     TEST( testReadMultiPart, "core_read" );
     TEST( testReadDeep, "core_read" );
     TEST( testReadUnpack, "core_read" );
+    TEST( testReadMapped, "core_read" );
+    TEST( testReadChunks, "core_read" );
+    TEST( testReadAsync, "core_read" );
+    TEST( testReadBufferPool, "core_read" );
 
     TEST( testWriteBadArgs, "core_write" );
     TEST( testWriteBadFiles, "core_write" );
@@ -185,6 +189,7 @@ main (int argc, char *argv[])
     TEST( testWriteScans, "core_write" );
     TEST( testWriteTiles, "core_write" );
     TEST( testWriteMultiPart, "core_write" );
+    TEST( testWriteLayouts, "core_write" );
     TEST( testWriteDeep, "core_write" );
 
     TEST( testHUF, "core_compression" );
@@ -198,6 +203,7 @@ main (int argc, char *argv[])
     TEST( testB44ACompression, "core_compression" );
     TEST( testDWAACompression, "core_compression" );
     TEST( testDWABCompression, "core_compression" );
+    TEST( testZipCompressionLevel, "core_compression" );
 
     TEST( testDeepNoCompression, "core_compression" );
     TEST( testDeepZIPCompression, "core_compression" );
@@ -8,21 +8,43 @@
 #include <string.h>
 #include <time.h>
 
+#include <algorithm>
 #include <chrono>
 #include <set>
 #include <string>
 #include <vector>
 
 #include <IlmThreadPool.h>
+#include <ImathRandom.h>
 #include <ImfChannelList.h>
 #include <ImfCompressor.h>
 #include <ImfFrameBuffer.h>
 #include <ImfHeader.h>
+#include <ImfHuf.h>
 #include <ImfInputPart.h>
 #include <ImfMultiPartInputFile.h>
 #include <ImfThreading.h>
+#include <half.h>
 #include <openexr.h>
 
+#if defined(OPENEXR_ENABLE_API_VISIBILITY)
+#    include "../../lib/OpenEXRCore/internal_huf.c"
+
+void*
+internal_exr_alloc (size_t bytes)
+{
+    return malloc (bytes);
+}
+void
+internal_exr_free (void* p)
+{
+    if (p) free (p);
+}
+
+#else
+#    include "../../lib/OpenEXRCore/internal_huf.h"
+#endif
+
 using namespace OPENEXR_IMF_NAMESPACE;
 using namespace ILMTHREAD_NAMESPACE;
 
@@ -394,11 +416,345 @@ readImf (
     }
 }
 
+////////////////////////////////////////
+// write side
+
+static void
+write_pixels_core (
+    exr_context_t    f,
+    int              w,
+    int              h,
+    exr_pixel_type_t usertype,
+    const uint8_t*   rgba,
+    uint64_t&        pixCount)
+{
+    int32_t               linesperchunk = 0;
+    int                   bpc           = usertype == EXR_PIXEL_HALF ? 2 : 4;
+    size_t                linebytes     = size_t (w) * 4 * size_t (bpc);
+    exr_chunk_info_t      cinfo         = { 0 };
+    exr_encode_pipeline_t encoder;
+
+    if (EXR_ERR_SUCCESS != exr_get_scanlines_per_chunk (f, 0, &linesperchunk))
+        throw std::logic_error ("Unable to get scanlines per chunk for part 0");
+
+    for (int y = 0; y < h; y += linesperchunk)
+    {
+        exr_result_t rv = exr_write_scanline_chunk_info (f, 0, y, &cinfo);
+        if (rv != EXR_ERR_SUCCESS)
+            throw std::runtime_error ("unable to init scanline block info");
+
+        if (y == 0)
+            rv = exr_encoding_initialize (f, 0, &cinfo, &encoder);
+        else
+            rv = exr_encoding_update (f, 0, &cinfo, &encoder);
+        if (rv != EXR_ERR_SUCCESS)
+            throw std::runtime_error ("unable to init encoding pipeline");
+
+        // channels are sorted A, B, G, R, source pixels are RGBA
+        const uint8_t* lineptr = rgba + size_t (y) * linebytes;
+        for (int c = 0; c < encoder.channel_count; ++c)
+        {
+            exr_coding_channel_info_t& inc = encoder.channels[c];
+            inc.encode_from_ptr = lineptr + size_t (3 - c) * size_t (bpc);
+            inc.user_pixel_stride      = 4 * bpc;
+            inc.user_line_stride       = int32_t (linebytes);
+            inc.user_bytes_per_element = bpc;
+            inc.user_data_type         = usertype;
+        }
+
+        if (y == 0)
+        {
+            rv = exr_encoding_choose_default_routines (f, 0, &encoder);
+            if (rv != EXR_ERR_SUCCESS)
+                throw std::runtime_error ("unable to choose default routines");
+        }
+        rv = exr_encoding_run (f, 0, &encoder);
+        if (rv != EXR_ERR_SUCCESS)
+            throw std::runtime_error ("unable to run encoding pipeline");
+        pixCount += uint64_t (cinfo.height) * uint64_t (w);
+    }
+    exr_encoding_destroy (f, &encoder);
+}
+
+static void
+writeCore (
+    const std::string& fn,
+    exr_compression_t  comp,
+    exr_pixel_type_t   filetype,
+    exr_pixel_type_t   usertype,
+    int                w,
+    int                h,
+    const uint8_t*     rgba,
+    uint64_t&          dataTimeAccum,
+    uint64_t&          pixCount)
+{
+    static const char* chans[] = { "A", "B", "G", "R" };
+
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    int                       partidx;
+
+    cinit.error_handler_fn = &error_handler_new;
+
+    if (EXR_ERR_SUCCESS !=
+        exr_start_write (&f, fn.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit))
+        throw std::runtime_error ("unable to open file for write");
+
+    exr_add_part (f, "beauty", EXR_STORAGE_SCANLINE, &partidx);
+    exr_initialize_required_attr_simple (f, partidx, w, h, comp);
+    for (int c = 0; c < 4; ++c)
+        exr_add_channel (
+            f, partidx, chans[c], filetype, EXR_PERCEPTUALLY_LOGARITHMIC, 1, 1);
+    if (EXR_ERR_SUCCESS != exr_write_header (f))
+    {
+        exr_finish (&f);
+        throw std::runtime_error ("unable to write header");
+    }
+
+    auto dstart = std::chrono::steady_clock::now ();
+    try
+    {
+        write_pixels_core (f, w, h, usertype, rgba, pixCount);
+    }
+    catch (...)
+    {
+        exr_finish (&f);
+        throw;
+    }
+    auto dend = std::chrono::steady_clock::now ();
+    exr_finish (&f);
+
+    dataTimeAccum +=
+        std::chrono::duration_cast<std::chrono::nanoseconds> (dend - dstart)
+            .count ();
+}
+
+static int
+writePerf (const std::string& fn)
+{
+    struct Config
+    {
+        const char*       name;
+        exr_compression_t comp;
+        exr_pixel_type_t  filetype;
+        exr_pixel_type_t  usertype;
+    };
+    static const Config configs[] = {
+        { "half from half, none",
+          EXR_COMPRESSION_NONE,
+          EXR_PIXEL_HALF,
+          EXR_PIXEL_HALF },
+        { "half from float, none",
+          EXR_COMPRESSION_NONE,
+          EXR_PIXEL_HALF,
+          EXR_PIXEL_FLOAT },
+        { "float from float, none",
+          EXR_COMPRESSION_NONE,
+          EXR_PIXEL_FLOAT,
+          EXR_PIXEL_FLOAT },
+        { "half from half, zip",
+          EXR_COMPRESSION_ZIP,
+          EXR_PIXEL_HALF,
+          EXR_PIXEL_HALF },
+        { "half from float, zip",
+          EXR_COMPRESSION_ZIP,
+          EXR_PIXEL_HALF,
+          EXR_PIXEL_FLOAT },
+        { "float from float, zip",
+          EXR_COMPRESSION_ZIP,
+          EXR_PIXEL_FLOAT,
+          EXR_PIXEL_FLOAT }
+    };
+    constexpr int w     = 1920;
+    constexpr int h     = 1080;
+    constexpr int count = 20;
+
+    // a smooth-ish gradient with some noise, so the zip runs are
+    // representative of a render rather than all runs of zeros
+    std::vector<float>    fpix (size_t (w) * size_t (h) * 4);
+    std::vector<uint16_t> hpix (fpix.size ());
+    srand (1);
+    for (size_t i = 0; i < fpix.size (); ++i)
+    {
+        size_t px = i / 4;
+        float  v  = float (px % w) / float (w) + float (px / w) / float (h);
+        v += float (rand () % 1000) / 100000.f;
+        fpix[i] = (i % 4) == 3 ? 1.f : v;
+        hpix[i] = half (fpix[i]).bits ();
+    }
+
+    std::cout << "Stats for writing " << w << "x" << h << " RGBA " << count
+              << " times\n\n";
+    for (auto& cfg: configs)
+    {
+        uint64_t dataNanos = 0, pixCount = 0;
+        const uint8_t* src = cfg.usertype == EXR_PIXEL_HALF
+                                 ? (const uint8_t*) hpix.data ()
+                                 : (const uint8_t*) fpix.data ();
+        try
+        {
+            for (int c = 0; c < count; ++c)
+                writeCore (
+                    fn,
+                    cfg.comp,
+                    cfg.filetype,
+                    cfg.usertype,
+                    w,
+                    h,
+                    src,
+                    dataNanos,
+                    pixCount);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "ERROR: " << e.what () << std::endl;
+            remove (fn.c_str ());
+            return 1;
+        }
+        std::cout << " " << std::setw (24) << std::left << std::setfill (' ')
+                  << cfg.name << " " << std::setw (12) << std::left
+                  << double (dataNanos) / double (count) << " ns/image "
+                  << double (pixCount) * 1000.0 / double (dataNanos)
+                  << " Mpix/s\n";
+    }
+    remove (fn.c_str ());
+    return 0;
+}
+
+static double
+hufMBps (size_t bytes, std::chrono::steady_clock::duration d)
+{
+    double s = std::chrono::duration<double> (d).count ();
+    return s > 0.0 ? (double) bytes / (1024.0 * 1024.0) / s : 0.0;
+}
+
+static int
+hufPerf ()
+{
+    typedef std::chrono::steady_clock clock;
+
+    // the output of the piz wavelet is mostly small values around
+    // zero with a long tail, build a few chunks like that, plus one
+    // with a flat distribution as the worst case for the decoder
+    constexpr int      nChunks   = 8;
+    constexpr uint64_t chunkVals = 32 * 1024;
+    constexpr uint64_t chunkOut  = chunkVals * 3 + 65536;
+    constexpr int      reps      = 50;
+
+    uint64_t esize = internal_exr_huf_compress_spare_bytes ();
+    uint64_t dsize = internal_exr_huf_decompress_spare_bytes ();
+
+    std::vector<uint8_t>  hspare (std::max (esize, dsize));
+    std::vector<uint16_t> raw (nChunks * chunkVals);
+    std::vector<uint16_t> decoded (chunkVals);
+    std::vector<uint8_t>  encoded (nChunks * chunkOut);
+    std::vector<char>     cppencoded (chunkOut);
+    std::vector<uint64_t> ebytes (nChunks);
+
+    IMATH_NAMESPACE::Rand48 r (42);
+    for (int c = 0; c < nChunks; ++c)
+    {
+        uint16_t* v = raw.data () + c * chunkVals;
+        for (uint64_t i = 0; i < chunkVals; ++i)
+        {
+            if (c == nChunks - 1)
+                v[i] = (uint16_t) r.nexti ();
+            else
+            {
+                double mag = r.nextf () * r.nextf () * r.nextf () * (64 << c);
+                int    sv  = r.nextb () ? (int) mag : -(int) mag;
+                v[i]       = (uint16_t) sv;
+            }
+        }
+    }
+
+    auto encode = [&] (int c) {
+        if (EXR_ERR_SUCCESS != internal_huf_compress (
+                                   &ebytes[c],
+                                   encoded.data () + c * chunkOut,
+                                   chunkOut,
+                                   raw.data () + c * chunkVals,
+                                   chunkVals,
+                                   hspare.data (),
+                                   esize))
+            throw std::runtime_error ("unable to huffman encode");
+    };
+    auto decode = [&] (int c) {
+        if (EXR_ERR_SUCCESS != internal_huf_decompress (
+                                   encoded.data () + c * chunkOut,
+                                   ebytes[c],
+                                   decoded.data (),
+                                   chunkVals,
+                                   hspare.data (),
+                                   dsize))
+            throw std::runtime_error ("unable to huffman decode");
+    };
+
+    clock::duration coreEnc{}, coreDec{}, coreDecSame{}, cppEnc{}, cppDec{};
+
+    try
+    {
+        for (int rep = 0; rep < reps; ++rep)
+        {
+            auto start = clock::now ();
+            for (int c = 0; c < nChunks; ++c)
+                encode (c);
+            coreEnc += clock::now () - start;
+
+            // alternate chunks so every decode has to build its tables
+            start = clock::now ();
+            for (int c = 0; c < nChunks; ++c)
+                decode (c);
+            coreDec += clock::now () - start;
+
+            // the same chunk again and again reuses the tables
+            start = clock::now ();
+            for (int c = 0; c < nChunks; ++c)
+                decode (0);
+            coreDecSame += clock::now () - start;
+
+            start = clock::now ();
+            for (int c = 0; c < nChunks; ++c)
+                hufCompress (
+                    raw.data () + c * chunkVals,
+                    chunkVals,
+                    cppencoded.data ());
+            cppEnc += clock::now () - start;
+
+            start = clock::now ();
+            for (int c = 0; c < nChunks; ++c)
+                hufUncompress (
+                    (const char*) encoded.data () + c * chunkOut,
+                    (int) ebytes[c],
+                    decoded.data (),
+                    chunkVals);
+            cppDec += clock::now () - start;
+        }
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "ERROR: " << e.what () << std::endl;
+        return 1;
+    }
+
+    size_t total = (size_t) reps * nChunks * chunkVals * sizeof (uint16_t);
+    std::cout << "Huffman throughput (MB/s of 16 bit values):\n"
+              << std::fixed << std::setprecision (1) << " core encode "
+              << hufMBps (total, coreEnc) << ", c++ encode "
+              << hufMBps (total, cppEnc) << "\n"
+              << " core decode " << hufMBps (total, coreDec)
+              << ", same chunk " << hufMBps (total, coreDecSame)
+              << ", c++ decode " << hufMBps (total, cppDec) << std::endl;
+    return 0;
+}
+
 static int
 usageAndExit (const char* argv0, int ec)
 {
     std::cerr << "Usage: " << argv0 << "[--imf|--core] <file1> [<file2>...]"
               << std::endl;
+    std::cerr << "       " << argv0 << " --write <scratchfile>" << std::endl;
+    std::cerr << "       " << argv0 << " --huf" << std::endl;
     return ec;
 }
 
@@ -414,6 +770,13 @@ main (int argc, char* argv[])
         {
             return usageAndExit (argv[0], 0);
         }
+        else if (!strcmp (argv[a], "--write"))
+        {
+            if (a + 1 >= argc) return usageAndExit (argv[0], 1);
+            return writePerf (argv[a + 1]);
+        }
+        else if (!strcmp (argv[a], "--huf"))
+            return hufPerf ();
         else if (!strcmp (argv[a], "--imf"))
         {
             imfOnly = true;
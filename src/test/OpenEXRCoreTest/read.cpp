@@ -15,6 +15,7 @@
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 static void
 err_cb (exr_const_context_t f, int code, const char* msg)
@@ -578,3 +579,601 @@ testReadUnpack (const std::string& tempdir)
 
     exr_finish (&f);
 }
+
+static void
+decodeAllScanlines (
+    exr_context_t f, std::vector<uint8_t>& pixels, bool expectMapped)
+{
+    exr_attr_box2i_t dw;
+    int32_t          ccount, lpc;
+    EXRCORE_TEST_RVAL (exr_get_data_window (f, 0, &dw));
+    EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &ccount));
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, 0, &lpc));
+
+    exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
+    pixels.clear ();
+    for (int y = dw.min.y; y <= dw.max.y; y += lpc)
+    {
+        exr_chunk_info_t cinfo;
+        EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, y, &cinfo));
+        if (y == dw.min.y)
+        {
+            EXRCORE_TEST_RVAL (
+                exr_decoding_initialize (f, 0, &cinfo, &decoder));
+        }
+        else
+        {
+            EXRCORE_TEST_RVAL (exr_decoding_update (f, 0, &cinfo, &decoder));
+        }
+
+        size_t off = pixels.size ();
+        size_t tot = 0;
+        for (int c = 0; c < decoder.channel_count; ++c)
+            tot += (size_t) decoder.channels[c].width *
+                   (size_t) decoder.channels[c].height *
+                   (size_t) decoder.channels[c].bytes_per_element;
+        pixels.resize (off + tot);
+        for (int c = 0; c < decoder.channel_count; ++c)
+        {
+            exr_coding_channel_info_t& ch = decoder.channels[c];
+            ch.decode_to_ptr              = pixels.data () + off;
+            ch.user_pixel_stride          = ch.bytes_per_element;
+            ch.user_line_stride           = ch.width * ch.bytes_per_element;
+            off += (size_t) ch.width * (size_t) ch.height *
+                   (size_t) ch.bytes_per_element;
+        }
+
+        if (y == dw.min.y)
+        {
+            EXRCORE_TEST_RVAL (
+                exr_decoding_choose_default_routines (f, 0, &decoder));
+        }
+        EXRCORE_TEST_RVAL (exr_decoding_run (f, 0, &decoder));
+
+        // a mapped file should not need a packed buffer allocation
+        if (expectMapped && decoder.packed_buffer)
+            EXRCORE_TEST (decoder.packed_alloc_size == 0);
+    }
+    EXRCORE_TEST_RVAL (exr_decoding_destroy (f, &decoder));
+}
+
+void
+testReadMapped (const std::string& tempdir)
+{
+    const char* files[] = { "comp_none.exr", "comp_zip.exr", "comp_piz.exr" };
+
+    for (const char* file: files)
+    {
+        exr_context_t             f, mf;
+        std::string               fn    = ILM_IMF_TEST_IMAGEDIR;
+        exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+        cinit.error_handler_fn          = &err_cb;
+
+        fn += file;
+        EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+        cinit.flags = EXR_CONTEXT_FLAG_MEMORY_MAP_READ;
+        EXRCORE_TEST_RVAL (exr_start_read (&mf, fn.c_str (), &cinit));
+
+        exr_attr_box2i_t dw;
+        exr_chunk_info_t cinfo;
+        const void*      mapped = NULL;
+        EXRCORE_TEST_RVAL (exr_get_data_window (f, 0, &dw));
+        EXRCORE_TEST_RVAL (
+            exr_read_scanline_chunk_info (f, 0, dw.min.y, &cinfo));
+
+        EXRCORE_TEST_RVAL_FAIL (
+            EXR_ERR_NOT_OPEN_READ,
+            exr_read_chunk_mapped (f, 0, &cinfo, &mapped));
+        EXRCORE_TEST (mapped == NULL);
+        EXRCORE_TEST_RVAL_FAIL (
+            EXR_ERR_INVALID_ARGUMENT,
+            exr_read_chunk_mapped (mf, 0, &cinfo, NULL));
+
+        std::vector<uint8_t> packed (cinfo.packed_size);
+        EXRCORE_TEST_RVAL (exr_read_chunk (f, 0, &cinfo, packed.data ()));
+        EXRCORE_TEST_RVAL (exr_read_chunk_mapped (mf, 0, &cinfo, &mapped));
+        EXRCORE_TEST (mapped != NULL);
+        EXRCORE_TEST (0 == memcmp (mapped, packed.data (), packed.size ()));
+
+        std::vector<uint8_t> readpix, mappix;
+        decodeAllScanlines (f, readpix, false);
+        decodeAllScanlines (mf, mappix, true);
+        EXRCORE_TEST (readpix.size () == mappix.size ());
+        EXRCORE_TEST (readpix == mappix);
+
+        exr_finish (&f);
+        exr_finish (&mf);
+    }
+}
+
+struct CountingStream
+{
+    FILE* fp;
+    int   reads;
+};
+
+static int64_t
+countingreadstream (
+    exr_const_context_t         f,
+    void*                       userdata,
+    void*                       buffer,
+    uint64_t                    sz,
+    uint64_t                    offset,
+    exr_stream_error_func_ptr_t errcb)
+{
+    CountingStream* cs = static_cast<CountingStream*> (userdata);
+    ++cs->reads;
+    if (fseek (cs->fp, (long) offset, SEEK_SET) != 0) return -1;
+    return (int64_t) fread (buffer, 1, sz, cs->fp);
+}
+
+void
+testReadChunks (const std::string& tempdir)
+{
+    exr_context_t             f;
+    std::string               fn    = ILM_IMF_TEST_IMAGEDIR;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &err_cb;
+
+    fn += "comp_zips.exr";
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+
+    exr_attr_box2i_t dw;
+    int32_t          ccount, lpc;
+    EXRCORE_TEST_RVAL (exr_get_data_window (f, 0, &dw));
+    EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &ccount));
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, 0, &lpc));
+    EXRCORE_TEST (ccount > 1);
+
+    // read in reverse order to exercise the sort
+    std::vector<exr_chunk_info_t>     cinfos (ccount);
+    std::vector<std::vector<uint8_t>> single (ccount), batched (ccount);
+    std::vector<void*>                bufs (ccount);
+    for (int c = 0; c < ccount; ++c)
+    {
+        int               y     = dw.min.y + (ccount - 1 - c) * lpc;
+        exr_chunk_info_t& cinfo = cinfos[c];
+        EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, y, &cinfo));
+        single[c].resize (cinfo.packed_size);
+        batched[c].resize (cinfo.packed_size, 0xEE);
+        bufs[c] = batched[c].data ();
+        EXRCORE_TEST_RVAL (exr_read_chunk (f, 0, &cinfo, single[c].data ()));
+    }
+
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_INVALID_ARGUMENT,
+        exr_read_chunks (f, 0, ccount, NULL, bufs.data ()));
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_INVALID_ARGUMENT,
+        exr_read_chunks (f, 0, ccount, cinfos.data (), NULL));
+    EXRCORE_TEST_RVAL (exr_read_chunks (f, 0, 0, NULL, NULL));
+
+    EXRCORE_TEST_RVAL (
+        exr_read_chunks (f, 0, ccount, cinfos.data (), bufs.data ()));
+    for (int c = 0; c < ccount; ++c)
+        EXRCORE_TEST (single[c] == batched[c]);
+
+    // the adjacent chunks should be merged into far fewer reads
+    {
+        exr_context_t  cf;
+        CountingStream cs = { fopen (fn.c_str (), "rb"), 0 };
+        EXRCORE_TEST (cs.fp != NULL);
+        exr_context_initializer_t cinit2 = EXR_DEFAULT_CONTEXT_INITIALIZER;
+        cinit2.error_handler_fn          = &err_cb;
+        cinit2.user_data                 = &cs;
+        cinit2.read_fn                   = &countingreadstream;
+        EXRCORE_TEST_RVAL (exr_start_read (&cf, fn.c_str (), &cinit2));
+
+        for (int c = 0; c < ccount; ++c)
+            memset (bufs[c], 0xEE, batched[c].size ());
+        // ensure the chunk table is loaded prior to counting
+        exr_chunk_info_t tmpinfo;
+        EXRCORE_TEST_RVAL (
+            exr_read_scanline_chunk_info (cf, 0, dw.min.y, &tmpinfo));
+        cs.reads = 0;
+        EXRCORE_TEST_RVAL (
+            exr_read_chunks (cf, 0, ccount, cinfos.data (), bufs.data ()));
+        EXRCORE_TEST (cs.reads > 0 && cs.reads < ccount / 4);
+        for (int c = 0; c < ccount; ++c)
+            EXRCORE_TEST (single[c] == batched[c]);
+
+        exr_finish (&cf);
+        fclose (cs.fp);
+    }
+
+    // now decode using batches of pipelines
+    std::vector<uint8_t> expected, actual;
+    decodeAllScanlines (f, expected, false);
+
+    const int                           batch = 7;
+    std::vector<exr_decode_pipeline_t>  decoders (batch);
+    std::vector<exr_decode_pipeline_t*> dptrs (batch);
+    for (int b = 0; b < batch; ++b)
+    {
+        decoders[b] = EXR_DECODE_PIPELINE_INITIALIZER;
+        dptrs[b]    = &decoders[b];
+    }
+
+    for (int y = dw.min.y; y <= dw.max.y; y += batch * lpc)
+    {
+        int n = 0;
+        for (int b = 0; b < batch; ++b)
+        {
+            int cy = y + b * lpc;
+            if (cy > dw.max.y) break;
+
+            exr_chunk_info_t cinfo;
+            EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, cy, &cinfo));
+            if (decoders[b].context == NULL)
+            {
+                EXRCORE_TEST_RVAL (
+                    exr_decoding_initialize (f, 0, &cinfo, &decoders[b]));
+            }
+            else
+            {
+                EXRCORE_TEST_RVAL (
+                    exr_decoding_update (f, 0, &cinfo, &decoders[b]));
+            }
+
+            size_t off = actual.size ();
+            for (int c = 0; c < decoders[b].channel_count; ++c)
+            {
+                exr_coding_channel_info_t& ch = decoders[b].channels[c];
+                off += (size_t) ch.width * (size_t) ch.height *
+                       (size_t) ch.bytes_per_element;
+            }
+            actual.resize (off);
+            ++n;
+        }
+
+        // assign output pointers once all resizes are done
+        size_t off = actual.size ();
+        for (int b = n - 1; b >= 0; --b)
+        {
+            for (int c = decoders[b].channel_count - 1; c >= 0; --c)
+            {
+                exr_coding_channel_info_t& ch = decoders[b].channels[c];
+                off -= (size_t) ch.width * (size_t) ch.height *
+                       (size_t) ch.bytes_per_element;
+                ch.decode_to_ptr     = actual.data () + off;
+                ch.user_pixel_stride = ch.bytes_per_element;
+                ch.user_line_stride  = ch.width * ch.bytes_per_element;
+            }
+            if (decoders[b].read_fn == NULL)
+            {
+                EXRCORE_TEST_RVAL (
+                    exr_decoding_choose_default_routines (f, 0, &decoders[b]));
+            }
+        }
+
+        EXRCORE_TEST_RVAL (exr_decoding_read_chunks (f, 0, n, dptrs.data ()));
+        for (int b = 0; b < n; ++b)
+            EXRCORE_TEST_RVAL (exr_decoding_run (f, 0, &decoders[b]));
+    }
+    EXRCORE_TEST (expected == actual);
+
+    for (int b = 0; b < batch; ++b)
+    {
+        if (decoders[b].context)
+            EXRCORE_TEST_RVAL (exr_decoding_destroy (f, &decoders[b]));
+    }
+
+    exr_finish (&f);
+}
+
+static void
+initChunkDecoders (
+    exr_context_t                       f,
+    std::vector<exr_decode_pipeline_t>& decoders,
+    std::vector<uint8_t>&               pixels)
+{
+    exr_attr_box2i_t dw;
+    int32_t          ccount, lpc;
+    EXRCORE_TEST_RVAL (exr_get_data_window (f, 0, &dw));
+    EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &ccount));
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, 0, &lpc));
+
+    decoders.assign (ccount, EXR_DECODE_PIPELINE_INITIALIZER);
+    size_t tot = 0;
+    for (int c = 0; c < ccount; ++c)
+    {
+        exr_chunk_info_t cinfo;
+        EXRCORE_TEST_RVAL (
+            exr_read_scanline_chunk_info (f, 0, dw.min.y + c * lpc, &cinfo));
+        EXRCORE_TEST_RVAL (exr_decoding_initialize (f, 0, &cinfo, &decoders[c]));
+        for (int ch = 0; ch < decoders[c].channel_count; ++ch)
+            tot += (size_t) decoders[c].channels[ch].width *
+                   (size_t) decoders[c].channels[ch].height *
+                   (size_t) decoders[c].channels[ch].bytes_per_element;
+    }
+
+    pixels.assign (tot, 0);
+    size_t off = 0;
+    for (int c = 0; c < ccount; ++c)
+    {
+        for (int ch = 0; ch < decoders[c].channel_count; ++ch)
+        {
+            exr_coding_channel_info_t& ci = decoders[c].channels[ch];
+            ci.decode_to_ptr              = pixels.data () + off;
+            ci.user_pixel_stride          = ci.bytes_per_element;
+            ci.user_line_stride           = ci.width * ci.bytes_per_element;
+            off += (size_t) ci.width * (size_t) ci.height *
+                   (size_t) ci.bytes_per_element;
+        }
+        EXRCORE_TEST_RVAL (
+            exr_decoding_choose_default_routines (f, 0, &decoders[c]));
+    }
+}
+
+struct AsyncReadyState
+{
+    exr_context_t f;
+    int           ready;
+    int           stopAfter;
+};
+
+static exr_result_t
+asyncready (exr_decode_pipeline_t* decode, exr_result_t rv, void* userdata)
+{
+    AsyncReadyState* st = static_cast<AsyncReadyState*> (userdata);
+    EXRCORE_TEST_RVAL (rv);
+    ++st->ready;
+    if (st->stopAfter > 0 && st->ready >= st->stopAfter)
+        return EXR_ERR_INCORRECT_CHUNK;
+    // would normally be handed off to a worker thread
+    return exr_decoding_run (st->f, 0, decode);
+}
+
+static void
+decodeAllAsync (exr_context_t f, std::vector<uint8_t>& pixels)
+{
+    std::vector<exr_decode_pipeline_t>  decoders;
+    std::vector<exr_decode_pipeline_t*> dptrs;
+    AsyncReadyState                     st = { f, 0, 0 };
+
+    initChunkDecoders (f, decoders, pixels);
+    for (auto& d: decoders)
+        dptrs.push_back (&d);
+
+    EXRCORE_TEST_RVAL (exr_decoding_read_chunks_async (
+        f, 0, (int) dptrs.size (), dptrs.data (), &asyncready, &st));
+    EXRCORE_TEST (st.ready == (int) dptrs.size ());
+
+    for (auto& d: decoders)
+        EXRCORE_TEST_RVAL (exr_decoding_destroy (f, &d));
+}
+
+struct DeferredStream
+{
+    FILE* fp;
+    int   submitted;
+    int   completed;
+};
+
+static int64_t
+deferredreadstream (
+    exr_const_context_t         f,
+    void*                       userdata,
+    void*                       buffer,
+    uint64_t                    sz,
+    uint64_t                    offset,
+    exr_stream_error_func_ptr_t errcb)
+{
+    DeferredStream* ds = static_cast<DeferredStream*> (userdata);
+    if (fseek (ds->fp, (long) offset, SEEK_SET) != 0) return -1;
+    return (int64_t) fread (buffer, 1, sz, ds->fp);
+}
+
+static exr_result_t
+deferredsubmit (
+    exr_const_context_t         f,
+    void*                       userdata,
+    exr_async_read_request_t*   req,
+    exr_stream_error_func_ptr_t errcb)
+{
+    DeferredStream* ds = static_cast<DeferredStream*> (userdata);
+    ++ds->submitted;
+    req->provider_data = ds;
+    return EXR_ERR_SUCCESS;
+}
+
+// completes the most recently submitted request first, to make sure
+// the completion order does not matter
+static exr_result_t
+deferredwait (
+    exr_const_context_t              f,
+    void*                            userdata,
+    exr_async_read_request_t* const* reqs,
+    int                              count,
+    int*                             completed,
+    exr_stream_error_func_ptr_t      errcb)
+{
+    DeferredStream*           ds  = static_cast<DeferredStream*> (userdata);
+    exr_async_read_request_t* req = reqs[count - 1];
+    EXRCORE_TEST (req->provider_data == ds);
+    ++ds->completed;
+    req->provider_data = NULL;
+    if (fseek (ds->fp, (long) req->offset, SEEK_SET) != 0)
+        req->nread = -1;
+    else
+        req->nread = (int64_t) fread (req->buffer, 1, req->size, ds->fp);
+    *completed = count - 1;
+    return EXR_ERR_SUCCESS;
+}
+
+void
+testReadAsync (const std::string& tempdir)
+{
+    exr_context_t             f;
+    std::string               fn    = ILM_IMF_TEST_IMAGEDIR;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &err_cb;
+
+    fn += "comp_zips.exr";
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+
+    int32_t ccount;
+    EXRCORE_TEST_RVAL (exr_get_chunk_count (f, 0, &ccount));
+
+    std::vector<uint8_t> expected, actual;
+    decodeAllScanlines (f, expected, false);
+
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_INVALID_ARGUMENT,
+        exr_decoding_read_chunks_async (f, 0, 1, NULL, &asyncready, NULL));
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_INVALID_ARGUMENT,
+        exr_decoding_read_chunks_async (f, 0, 0, NULL, NULL, NULL));
+    EXRCORE_TEST_RVAL (
+        exr_decoding_read_chunks_async (f, 0, 0, NULL, &asyncready, NULL));
+
+    // the internal file implementation
+    decodeAllAsync (f, actual);
+    EXRCORE_TEST (expected == actual);
+
+    // an error from the ready function stops it early
+    {
+        std::vector<exr_decode_pipeline_t>  decoders;
+        std::vector<exr_decode_pipeline_t*> dptrs;
+        AsyncReadyState                     st = { f, 0, 3 };
+
+        initChunkDecoders (f, decoders, actual);
+        for (auto& d: decoders)
+            dptrs.push_back (&d);
+        EXRCORE_TEST_RVAL_FAIL (
+            EXR_ERR_INCORRECT_CHUNK,
+            exr_decoding_read_chunks_async (
+                f, 0, (int) dptrs.size (), dptrs.data (), &asyncready, &st));
+        EXRCORE_TEST (st.ready == 3);
+        for (auto& d: decoders)
+            EXRCORE_TEST_RVAL (exr_decoding_destroy (f, &d));
+    }
+
+    // a custom stream with asynchronous routines
+    {
+        exr_context_t  cf;
+        DeferredStream ds = { fopen (fn.c_str (), "rb"), 0, 0 };
+        EXRCORE_TEST (ds.fp != NULL);
+        exr_context_initializer_t cinit2 = EXR_DEFAULT_CONTEXT_INITIALIZER;
+        cinit2.error_handler_fn          = &err_cb;
+        cinit2.user_data                 = &ds;
+        cinit2.read_fn                   = &deferredreadstream;
+        cinit2.read_async_fn             = &deferredsubmit;
+        cinit2.wait_async_fn             = &deferredwait;
+        EXRCORE_TEST_RVAL (exr_start_read (&cf, fn.c_str (), &cinit2));
+
+        decodeAllAsync (cf, actual);
+        EXRCORE_TEST (expected == actual);
+        EXRCORE_TEST (ds.submitted == ccount);
+        EXRCORE_TEST (ds.completed == ccount);
+
+        exr_finish (&cf);
+        fclose (ds.fp);
+    }
+
+    // without asynchronous routines, each pipeline reads its own data
+    {
+        exr_context_t  cf;
+        CountingStream cs = { fopen (fn.c_str (), "rb"), 0 };
+        EXRCORE_TEST (cs.fp != NULL);
+        exr_context_initializer_t cinit2 = EXR_DEFAULT_CONTEXT_INITIALIZER;
+        cinit2.error_handler_fn          = &err_cb;
+        cinit2.user_data                 = &cs;
+        cinit2.read_fn                   = &countingreadstream;
+        EXRCORE_TEST_RVAL (exr_start_read (&cf, fn.c_str (), &cinit2));
+
+        decodeAllAsync (cf, actual);
+        EXRCORE_TEST (expected == actual);
+
+        exr_finish (&cf);
+        fclose (cs.fp);
+    }
+
+    exr_finish (&f);
+}
+
+static void*
+decodeAlloc (enum transcoding_pipeline_buffer_id, size_t sz)
+{
+    return malloc (sz);
+}
+
+static void
+decodeFree (enum transcoding_pipeline_buffer_id, void* p)
+{
+    free (p);
+}
+
+void
+testReadBufferPool (const std::string& tempdir)
+{
+    exr_context_t             f;
+    std::string               fn    = ILM_IMF_TEST_IMAGEDIR;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &err_cb;
+
+    fn += "comp_zips.exr";
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+
+    exr_buffer_pool_stats_t st, st2;
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_MISSING_CONTEXT_ARG, exr_get_buffer_pool_stats (NULL, &st));
+    EXRCORE_TEST_RVAL_FAIL (
+        EXR_ERR_INVALID_ARGUMENT, exr_get_buffer_pool_stats (f, NULL));
+    EXRCORE_TEST_RVAL (exr_get_buffer_pool_stats (f, &st));
+    EXRCORE_TEST (st.allocations == 0 && st.reuses == 0);
+    EXRCORE_TEST (st.pooled_buffers == 0);
+
+    std::vector<uint8_t> expected, actual;
+    decodeAllScanlines (f, expected, false);
+    EXRCORE_TEST_RVAL (exr_get_buffer_pool_stats (f, &st));
+    EXRCORE_TEST (st.allocations > 0);
+    EXRCORE_TEST (st.releases > 0);
+    EXRCORE_TEST (st.pooled_buffers > 0 && st.pooled_bytes > 0);
+
+    // a second pass over the same chunks is served entirely from the
+    // buffers the first one handed back
+    decodeAllScanlines (f, actual, false);
+    EXRCORE_TEST (expected == actual);
+    EXRCORE_TEST_RVAL (exr_get_buffer_pool_stats (f, &st2));
+    EXRCORE_TEST (st2.allocations == st.allocations);
+    EXRCORE_TEST (st2.reuses > st.reuses);
+
+    EXRCORE_TEST_RVAL (exr_trim_buffer_pool (f));
+    EXRCORE_TEST_RVAL (exr_get_buffer_pool_stats (f, &st));
+    EXRCORE_TEST (st.pooled_buffers == 0 && st.pooled_bytes == 0);
+    EXRCORE_TEST (st.frees >= st2.pooled_buffers);
+
+    // custom pipeline allocators bypass the pool
+    {
+        exr_chunk_info_t      cinfo;
+        exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
+        exr_attr_box2i_t      dw;
+        EXRCORE_TEST_RVAL (exr_get_data_window (f, 0, &dw));
+        EXRCORE_TEST_RVAL (
+            exr_read_scanline_chunk_info (f, 0, dw.min.y, &cinfo));
+        EXRCORE_TEST_RVAL (exr_decoding_initialize (f, 0, &cinfo, &decoder));
+        decoder.alloc_fn = &decodeAlloc;
+        decoder.free_fn  = &decodeFree;
+        size_t off       = 0;
+        for (int c = 0; c < decoder.channel_count; ++c)
+        {
+            exr_coding_channel_info_t& ch = decoder.channels[c];
+            ch.decode_to_ptr              = actual.data () + off;
+            ch.user_pixel_stride          = ch.bytes_per_element;
+            ch.user_line_stride           = ch.width * ch.bytes_per_element;
+            off += (size_t) ch.width * (size_t) ch.height *
+                   (size_t) ch.bytes_per_element;
+        }
+        EXRCORE_TEST_RVAL (
+            exr_decoding_choose_default_routines (f, 0, &decoder));
+        EXRCORE_TEST_RVAL (exr_decoding_run (f, 0, &decoder));
+        EXRCORE_TEST_RVAL (exr_decoding_destroy (f, &decoder));
+        EXRCORE_TEST_RVAL (exr_get_buffer_pool_stats (f, &st2));
+        EXRCORE_TEST (st2.allocations == st.allocations);
+        EXRCORE_TEST (st2.reuses == st.reuses);
+        EXRCORE_TEST (st2.pooled_buffers == 0);
+    }
+
+    exr_finish (&f);
+}
@@ -21,5 +21,9 @@ void testReadTiles( const std::string &tempdir );
 void testReadMultiPart( const std::string &tempdir );
 
 void testReadUnpack( const std::string &tempdir );
+void testReadMapped( const std::string &tempdir );
+void testReadChunks( const std::string &tempdir );
+void testReadAsync( const std::string &tempdir );
+void testReadBufferPool( const std::string &tempdir );
 
 #endif // OPENEXR_CORE_TEST_READ_H
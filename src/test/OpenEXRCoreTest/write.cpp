@@ -15,6 +15,9 @@
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <vector>
+
+#include <half.h>
 
 static void
 err_cb (exr_const_context_t f, exr_result_t code, const char* msg)
@@ -1204,6 +1207,426 @@ testWriteTiles (const std::string& tempdir)
     remove (outfn.c_str ());
 }
 
+////////////////////////////////////////
+
+// The encoder picks a specialized packer for interleaved (in the file's
+// channel order or reversed) and planar source data, and the decoder an
+// unpacker for the same layouts, so write and read back every layout
+// with 3 and 4 channels of each type, with and without compression.
+
+enum DataLayout
+{
+    LAYOUT_INTERLEAVED,
+    LAYOUT_INTERLEAVED_REV,
+    LAYOUT_PLANAR
+};
+
+static const char* const layoutNames[] = {
+    "interleaved", "interleaved reversed", "planar"};
+
+static uint32_t
+nextRandom (uint32_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// a random value as stored in the file, no infinities or nans
+static uint32_t
+randomFileValue (uint32_t& state, exr_pixel_type_t filetype)
+{
+    uint32_t r = nextRandom (state);
+    if (filetype == EXR_PIXEL_HALF)
+    {
+        r >>= 16;
+        if ((r & 0x7c00) == 0x7c00) r &= 0xbfff;
+    }
+    else if (filetype == EXR_PIXEL_FLOAT)
+    {
+        if ((r & 0x7f800000) == 0x7f800000) r &= 0xbfffffff;
+    }
+    return r;
+}
+
+// the bits of a file value in user type, converting half to float
+static uint32_t
+userValue (uint32_t v, exr_pixel_type_t filetype, exr_pixel_type_t usertype)
+{
+    if (filetype == EXR_PIXEL_HALF && usertype == EXR_PIXEL_FLOAT)
+    {
+        half     h;
+        float    f;
+        uint32_t bits;
+        h.setBits ((uint16_t) v);
+        f = (float) h;
+        memcpy (&bits, &f, sizeof (bits));
+        return bits;
+    }
+    return v;
+}
+
+static int
+bytesPerElement (exr_pixel_type_t t)
+{
+    return t == EXR_PIXEL_HALF ? 2 : 4;
+}
+
+// where row y of channel c starts in an image of w x h pixels with nc
+// channels arranged as layout
+static size_t
+layoutOffset (
+    DataLayout layout,
+    int        c,
+    int        nc,
+    int        w,
+    int        h,
+    int        y,
+    int        bpc,
+    int32_t*   pixelstride,
+    int32_t*   linestride)
+{
+    if (layout == LAYOUT_PLANAR)
+    {
+        *pixelstride = bpc;
+        *linestride  = w * bpc;
+        return (size_t (c) * size_t (h) + size_t (y)) * size_t (w) *
+               size_t (bpc);
+    }
+
+    int k        = layout == LAYOUT_INTERLEAVED ? c : nc - 1 - c;
+    *pixelstride = nc * bpc;
+    *linestride  = w * nc * bpc;
+    return (size_t (y) * size_t (w) * size_t (nc) + size_t (k)) * size_t (bpc);
+}
+
+static void
+storeValue (uint8_t* p, uint32_t v, int bpc)
+{
+    if (bpc == 2)
+    {
+        uint16_t s = (uint16_t) v;
+        memcpy (p, &s, 2);
+    }
+    else
+        memcpy (p, &v, 4);
+}
+
+static uint32_t
+loadValue (const uint8_t* p, int bpc)
+{
+    if (bpc == 2)
+    {
+        uint16_t s;
+        memcpy (&s, p, 2);
+        return s;
+    }
+    uint32_t v;
+    memcpy (&v, p, 4);
+    return v;
+}
+
+static void
+writeLayout (
+    const std::string&           fn,
+    exr_compression_t            comp,
+    int                          nc,
+    int                          w,
+    int                          h,
+    exr_pixel_type_t             filetype,
+    exr_pixel_type_t             usertype,
+    DataLayout                   layout,
+    const std::vector<uint8_t>& src)
+{
+    static const char* chans[] = {"A", "B", "G", "R"};
+
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    int                       partidx;
+    int32_t                   scansperchunk;
+    int                       ubpc = bytesPerElement (usertype);
+    exr_chunk_info_t          cinfo;
+    exr_encode_pipeline_t     encoder;
+
+    cinit.error_handler_fn = &err_cb;
+
+    EXRCORE_TEST_RVAL (
+        exr_start_write (&f, fn.c_str (), EXR_WRITE_FILE_DIRECTLY, &cinit));
+    EXRCORE_TEST_RVAL (
+        exr_add_part (f, "layout", EXR_STORAGE_SCANLINE, &partidx));
+    EXRCORE_TEST_RVAL (
+        exr_initialize_required_attr_simple (f, partidx, w, h, comp));
+    for (int c = 4 - nc; c < 4; ++c)
+    {
+        EXRCORE_TEST_RVAL (exr_add_channel (
+            f, partidx, chans[c], filetype, EXR_PERCEPTUALLY_LOGARITHMIC, 1, 1));
+    }
+    EXRCORE_TEST_RVAL (exr_write_header (f));
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, 0, &scansperchunk));
+
+    for (int y = 0; y < h; y += scansperchunk)
+    {
+        EXRCORE_TEST_RVAL (exr_write_scanline_chunk_info (f, 0, y, &cinfo));
+        if (y == 0)
+        {
+            EXRCORE_TEST_RVAL (
+                exr_encoding_initialize (f, 0, &cinfo, &encoder));
+        }
+        else
+        {
+            EXRCORE_TEST_RVAL (exr_encoding_update (f, 0, &cinfo, &encoder));
+        }
+
+        EXRCORE_TEST (encoder.channel_count == nc);
+        for (int c = 0; c < nc; ++c)
+        {
+            exr_coding_channel_info_t& encc = encoder.channels[c];
+            EXRCORE_TEST (!strcmp (encc.channel_name, chans[4 - nc + c]));
+
+            encc.encode_from_ptr = src.data () + layoutOffset (
+                                                     layout,
+                                                     c,
+                                                     nc,
+                                                     w,
+                                                     h,
+                                                     y,
+                                                     ubpc,
+                                                     &encc.user_pixel_stride,
+                                                     &encc.user_line_stride);
+            encc.user_bytes_per_element = (int16_t) ubpc;
+            encc.user_data_type         = (uint16_t) usertype;
+        }
+
+        if (y == 0)
+        {
+            EXRCORE_TEST_RVAL (
+                exr_encoding_choose_default_routines (f, 0, &encoder));
+        }
+        EXRCORE_TEST_RVAL (exr_encoding_run (f, 0, &encoder));
+    }
+    EXRCORE_TEST_RVAL (exr_encoding_destroy (f, &encoder));
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+}
+
+static void
+readLayout (
+    const std::string&     fn,
+    int                    nc,
+    int                    w,
+    int                    h,
+    exr_pixel_type_t       usertype,
+    DataLayout             layout,
+    std::vector<uint8_t>& dst)
+{
+    exr_context_t             f;
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    int32_t                   scansperchunk;
+    int                       ubpc = bytesPerElement (usertype);
+    exr_chunk_info_t          cinfo;
+    exr_decode_pipeline_t     decoder;
+
+    cinit.error_handler_fn = &err_cb;
+
+    dst.assign (size_t (nc) * size_t (w) * size_t (h) * size_t (ubpc), 0);
+
+    EXRCORE_TEST_RVAL (exr_start_read (&f, fn.c_str (), &cinit));
+    EXRCORE_TEST_RVAL (exr_get_scanlines_per_chunk (f, 0, &scansperchunk));
+
+    for (int y = 0; y < h; y += scansperchunk)
+    {
+        EXRCORE_TEST_RVAL (exr_read_scanline_chunk_info (f, 0, y, &cinfo));
+        if (y == 0)
+        {
+            EXRCORE_TEST_RVAL (
+                exr_decoding_initialize (f, 0, &cinfo, &decoder));
+        }
+        else
+        {
+            EXRCORE_TEST_RVAL (exr_decoding_update (f, 0, &cinfo, &decoder));
+        }
+
+        EXRCORE_TEST (decoder.channel_count == nc);
+        for (int c = 0; c < nc; ++c)
+        {
+            exr_coding_channel_info_t& decc = decoder.channels[c];
+
+            decc.decode_to_ptr = dst.data () + layoutOffset (
+                                                   layout,
+                                                   c,
+                                                   nc,
+                                                   w,
+                                                   h,
+                                                   y,
+                                                   ubpc,
+                                                   &decc.user_pixel_stride,
+                                                   &decc.user_line_stride);
+            decc.user_bytes_per_element = (int16_t) ubpc;
+            decc.user_data_type         = (uint16_t) usertype;
+        }
+
+        if (y == 0)
+        {
+            EXRCORE_TEST_RVAL (
+                exr_decoding_choose_default_routines (f, 0, &decoder));
+        }
+        EXRCORE_TEST_RVAL (exr_decoding_run (f, 0, &decoder));
+    }
+    EXRCORE_TEST_RVAL (exr_decoding_destroy (f, &decoder));
+    EXRCORE_TEST_RVAL (exr_finish (&f));
+}
+
+// checks data read as usertype / layout against the file values
+static void
+compareLayout (
+    const std::vector<uint32_t>& filevals,
+    const std::vector<uint8_t>&  data,
+    int                          nc,
+    int                          w,
+    int                          h,
+    exr_pixel_type_t             filetype,
+    exr_pixel_type_t             usertype,
+    DataLayout                   layout)
+{
+    int ubpc = bytesPerElement (usertype);
+
+    for (int c = 0; c < nc; ++c)
+    {
+        for (int y = 0; y < h; ++y)
+        {
+            int32_t ps, ls;
+            size_t  off =
+                layoutOffset (layout, c, nc, w, h, y, ubpc, &ps, &ls);
+            for (int x = 0; x < w; ++x)
+            {
+                uint32_t expect = userValue (
+                    filevals[(size_t (c) * size_t (h) + size_t (y)) *
+                                 size_t (w) +
+                             size_t (x)],
+                    filetype,
+                    usertype);
+                uint32_t got = loadValue (data.data () + off, ubpc);
+                EXRCORE_TEST_LOCATION (got == expect, x, y);
+                off += size_t (ps);
+            }
+        }
+    }
+}
+
+void
+testWriteLayouts (const std::string& tempdir)
+{
+    struct TypePair
+    {
+        exr_pixel_type_t filetype;
+        exr_pixel_type_t usertype;
+    };
+    static const TypePair types[] = {
+        {EXR_PIXEL_HALF, EXR_PIXEL_HALF},
+        {EXR_PIXEL_FLOAT, EXR_PIXEL_FLOAT},
+        {EXR_PIXEL_UINT, EXR_PIXEL_UINT},
+        {EXR_PIXEL_HALF, EXR_PIXEL_FLOAT}};
+    static const exr_compression_t comps[] = {
+        EXR_COMPRESSION_NONE, EXR_COMPRESSION_ZIP};
+    static const DataLayout layouts[] = {
+        LAYOUT_INTERLEAVED, LAYOUT_INTERLEAVED_REV, LAYOUT_PLANAR};
+
+    // not a multiple of the vector widths or of the lines per chunk
+    const int   w  = 29;
+    const int   h  = 37;
+    std::string fn = tempdir + "layouts.exr";
+    uint32_t    state = 0x12345678;
+
+    for (const TypePair& tp: types)
+    {
+        for (int nc = 3; nc <= 4; ++nc)
+        {
+            std::vector<uint32_t> filevals (
+                size_t (nc) * size_t (w) * size_t (h));
+            for (uint32_t& v: filevals)
+                v = randomFileValue (state, tp.filetype);
+
+            for (exr_compression_t comp: comps)
+            {
+                for (DataLayout layout: layouts)
+                {
+                    std::cout << "  " << nc << " channels, file type "
+                              << tp.filetype << " from " << tp.usertype
+                              << ", " << layoutNames[layout]
+                              << ", compression " << comp << std::endl;
+
+                    int                  ubpc = bytesPerElement (tp.usertype);
+                    std::vector<uint8_t> src (
+                        size_t (nc) * size_t (w) * size_t (h) * size_t (ubpc));
+
+                    for (int c = 0; c < nc; ++c)
+                    {
+                        for (int y = 0; y < h; ++y)
+                        {
+                            int32_t ps, ls;
+                            size_t  off = layoutOffset (
+                                layout, c, nc, w, h, y, ubpc, &ps, &ls);
+                            for (int x = 0; x < w; ++x)
+                            {
+                                storeValue (
+                                    src.data () + off,
+                                    userValue (
+                                        filevals
+                                            [(size_t (c) * size_t (h) +
+                                              size_t (y)) *
+                                                 size_t (w) +
+                                             size_t (x)],
+                                        tp.filetype,
+                                        tp.usertype),
+                                    ubpc);
+                                off += size_t (ps);
+                            }
+                        }
+                    }
+
+                    writeLayout (
+                        fn,
+                        comp,
+                        nc,
+                        w,
+                        h,
+                        tp.filetype,
+                        tp.usertype,
+                        layout,
+                        src);
+
+                    // the values as stored in the file
+                    std::vector<uint8_t> dst;
+                    readLayout (fn, nc, w, h, tp.filetype, LAYOUT_PLANAR, dst);
+                    compareLayout (
+                        filevals,
+                        dst,
+                        nc,
+                        w,
+                        h,
+                        tp.filetype,
+                        tp.filetype,
+                        LAYOUT_PLANAR);
+
+                    // and converted back to the layout written from
+                    readLayout (fn, nc, w, h, tp.usertype, layout, dst);
+                    compareLayout (
+                        filevals,
+                        dst,
+                        nc,
+                        w,
+                        h,
+                        tp.filetype,
+                        tp.usertype,
+                        layout);
+
+                    remove (fn.c_str ());
+                }
+            }
+        }
+    }
+}
+
 void
 testWriteMultiPart (const std::string& tempdir)
 {
@@ -0,0 +1,225 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright Contributors to the OpenEXR Project.
+
+//
+// Throughput benchmark for the DWA encoder: times the forward DCT
+// kernels against the scalar version, then writes a synthetic image
+// with DWAA and DWAB compression to memory
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <ImfChannelList.h>
+#include <ImfDwaCompressorSimd.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfOutputFile.h>
+#include <ImfStdIO.h>
+#include <ImfSystemSpecific.h>
+#include <ImfThreading.h>
+#include <half.h>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+
+typedef void (*DctFunc) (float*);
+
+static double
+timeDct (DctFunc f, const SimdAlignedBuffer64f& in, int count)
+{
+    SimdAlignedBuffer64f block;
+    volatile float       sink = 0.f;
+
+    auto start = std::chrono::steady_clock::now ();
+    for (int c = 0; c < count; ++c)
+    {
+        block = in;
+        f (block._buffer);
+        sink = sink + block._buffer[c & 63];
+    }
+    return std::chrono::duration<double, std::milli> (
+               std::chrono::steady_clock::now () - start)
+        .count ();
+}
+
+static void
+report (const char* name, double mb, double ms, double baseMs)
+{
+    std::cout << " " << std::setw (12) << std::left << name << std::setw (12)
+              << std::right << std::fixed << std::setprecision (2) << ms
+              << std::setw (12) << mb / (ms / 1000.0) << std::setw (10)
+              << baseMs / ms << "x\n";
+}
+
+static double
+timeWrite (
+    const Header&      header,
+    const FrameBuffer& frameBuffer,
+    int                height,
+    int                count,
+    size_t&            fileSize)
+{
+    double ms = 0.0;
+    for (int c = 0; c < count; ++c)
+    {
+        StdOSStream os;
+        auto        start = std::chrono::steady_clock::now ();
+        {
+            OutputFile out (os, header);
+            out.setFrameBuffer (frameBuffer);
+            out.writePixels (height);
+        }
+        ms += std::chrono::duration<double, std::milli> (
+                  std::chrono::steady_clock::now () - start)
+                  .count ();
+        fileSize = os.str ().size ();
+    }
+    return ms;
+}
+
+int
+main (int argc, char* argv[])
+{
+    int width   = 1920;
+    int height  = 1080;
+    int count   = 5;
+    int threads = 0;
+
+    for (int a = 1; a < argc; ++a)
+    {
+        if (!strcmp (argv[a], "--size") && a + 2 < argc)
+        {
+            width  = atoi (argv[++a]);
+            height = atoi (argv[++a]);
+        }
+        else if (!strcmp (argv[a], "--count") && a + 1 < argc)
+            count = atoi (argv[++a]);
+        else if (!strcmp (argv[a], "--threads") && a + 1 < argc)
+            threads = atoi (argv[++a]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--size <w> <h>] [--count <n>] [--threads <n>]"
+                      << std::endl;
+            return (!strcmp (argv[a], "-h") || !strcmp (argv[a], "--help"))
+                       ? 0
+                       : 1;
+        }
+    }
+    if (width < 1) width = 1;
+    if (height < 1) height = 1;
+    if (count < 1) count = 1;
+
+    // selects the SIMD implementations
+    staticInitialize ();
+    setGlobalThreadCount (threads);
+
+    CpuId cpuId;
+    std::cout << "DWA encode, " << width << "x" << height << " x " << count
+              << ", " << threads << " threads (sse2 " << cpuId.sse2
+              << ", avx2 " << cpuId.avx2 << ", f16c " << cpuId.f16c
+              << ")\n\n";
+
+    //
+    // Forward DCT kernels
+    //
+
+    SimdAlignedBuffer64f block;
+    srand (1);
+    for (int i = 0; i < 64; ++i)
+        block._buffer[i] = float (rand () % 1000) / 1000.f;
+
+    int    blocks  = 2000000;
+    double blockMb = double (blocks) * 64 * sizeof (float) / (1024 * 1024);
+
+    std::cout << " Kernel         Time (ms)       MB/s   Speedup\n";
+    double base = timeDct (dctForward8x8_scalar, block, blocks);
+    report ("dct", blockMb, base, base);
+    if (cpuId.sse2)
+        report ("dct sse2", blockMb,
+                timeDct (dctForward8x8_sse2, block, blocks), base);
+#ifdef IMF_HAVE_AVX2_TARGET
+    if (cpuId.avx2)
+        report ("dct avx", blockMb,
+                timeDct (dctForward8x8_avx, block, blocks), base);
+#endif
+#ifdef IMF_HAVE_NEON
+    report ("dct neon", blockMb,
+            timeDct (dctForward8x8_neon, block, blocks), base);
+#endif
+
+    //
+    // Whole image encode, a smooth RGB image with some
+    // noise, as half, plus a float depth channel
+    //
+
+    std::vector<half>  rgb (size_t (width) * height * 3);
+    std::vector<float> depth (size_t (width) * height);
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            size_t i = size_t (y) * width + x;
+            float  v = 0.5f + 0.4f * sinf (x * 0.013f) * cosf (y * 0.021f);
+            float  n = float (rand () % 1000) / 50000.f;
+
+            rgb[3 * i + 0] = v + n;
+            rgb[3 * i + 1] = 0.8f * v + 0.1f * sinf (x * 0.1f) + n;
+            rgb[3 * i + 2] = 0.6f * v + n;
+            depth[i]       = 10.f + 5.f * v;
+        }
+    }
+
+    FrameBuffer frameBuffer;
+    frameBuffer.insert (
+        "R", Slice (HALF, (char*) &rgb[0], 3 * sizeof (half),
+                    3 * sizeof (half) * width));
+    frameBuffer.insert (
+        "G", Slice (HALF, (char*) &rgb[1], 3 * sizeof (half),
+                    3 * sizeof (half) * width));
+    frameBuffer.insert (
+        "B", Slice (HALF, (char*) &rgb[2], 3 * sizeof (half),
+                    3 * sizeof (half) * width));
+    frameBuffer.insert (
+        "Z", Slice (FLOAT, (char*) &depth[0], sizeof (float),
+                    sizeof (float) * width));
+
+    double imageMb =
+        double (width) * height * (3 * sizeof (half) + sizeof (float)) /
+        (1024 * 1024);
+
+    std::cout << "\n Compression    Time (ms)       MB/s     Ratio\n";
+
+    Compression comps[] = {DWAA_COMPRESSION, DWAB_COMPRESSION};
+    const char* names[] = {"dwaa", "dwab"};
+
+    for (int c = 0; c < 2; ++c)
+    {
+        Header header (width, height);
+        header.compression () = comps[c];
+        header.channels ().insert ("R", Channel (HALF));
+        header.channels ().insert ("G", Channel (HALF));
+        header.channels ().insert ("B", Channel (HALF));
+        header.channels ().insert ("Z", Channel (FLOAT));
+
+        size_t fileSize = 0;
+        double ms = timeWrite (header, frameBuffer, height, count, fileSize);
+
+        std::cout << " " << std::setw (12) << std::left << names[c]
+                  << std::setw (12) << std::right << std::fixed
+                  << std::setprecision (2) << ms / count << std::setw (12)
+                  << imageMb * count / (ms / 1000.0) << std::setw (10)
+                  << imageMb * 1024 * 1024 / double (fileSize) << "\n";
+    }
+
+    return 0;
+}
@@ -13,6 +13,7 @@
 #include "testXdr.h"
 #include "testMagic.h"
 #include "testHuf.h"
+#include "testZipPredictor.h"
 #include "testWav.h"
 #include "testChannels.h"
 #include "testAttributes.h"
@@ -48,10 +49,13 @@
 #include "testDeepScanLineBasic.h"
 #include "testCopyDeepScanLine.h"
 #include "testDeepScanLineMultipleRead.h"
+#include "testDeepScanLineSinglePass.h"
 #include "testDeepScanLineHuge.h"
 #include "testDeepTiledBasic.h"
 #include "testCopyDeepTiled.h"
 #include "testCompositeDeepScanLine.h"
+#include "testCompositeDeepTiled.h"
+#include "testDeepCompositing.h"
 #include "testMultiPartFileMixingBasic.h"
 #include "testInputPart.h"
 #include "testBackwardCompatibility.h"
@@ -64,9 +68,15 @@
 #include "testPartHelper.h"
 #include "testDwaCompressorSimd.h"
 #include "testRle.h"
+#include "testB44Blocks.h"
 #include "testB44ExpLogTable.h"
+#include "testPxr24Planes.h"
 #include "testDwaLookups.h"
 #include "testIDManifest.h"
+#include "testThreadPool.h"
+#include "testTileCache.h"
+#include "testReadAt.h"
+#include "testWriteBehind.h"
 
 #include "tmpDir.h"
 #include "ImathRandom.h"
@@ -179,6 +189,7 @@ main (int argc, char *argv[])
     TEST (testMagic, "core");
     TEST (testXdr, "core");
     TEST (testHuf, "core");
+    TEST (testZipPredictor, "core");
     TEST (testWav, "core");
     TEST (testRgba, "basic");
     TEST (testLargeDataWindowOffsets, "basic");
@@ -198,8 +209,11 @@ main (int argc, char *argv[])
     TEST (testTiledCopyPixels, "basic");
     TEST (testTiledCompression, "basic");
     TEST (testTiledLineOrder, "basic");
+    TEST (testTileCache, "basic");
     TEST (testScanLineApi, "basic");
     TEST (testExistingStreams, "core");
+    TEST (testReadAt, "core");
+    TEST (testWriteBehind, "core");
     TEST (testStandardAttributes, "core");
     TEST (testOptimized, "basic");
     TEST (testOptimizedInterleavePatterns, "basic");
@@ -211,9 +225,12 @@ main (int argc, char *argv[])
     TEST (testDeepScanLineBasic, "deep");
     TEST (testCopyDeepScanLine, "deep");
     TEST (testDeepScanLineMultipleRead, "deep");
+    TEST (testDeepScanLineSinglePass, "deep");
     TEST (testDeepTiledBasic, "deep");
     TEST (testCopyDeepTiled, "deep");
     TEST (testCompositeDeepScanLine, "deep");
+    TEST (testCompositeDeepTiled, "deep");
+    TEST (testDeepCompositing, "deep");
     TEST (testMultiPartFileMixingBasic, "multi");
     TEST (testInputPart, "multi");
     TEST (testPartHelper, "multi");
@@ -228,9 +245,12 @@ main (int argc, char *argv[])
     TEST (testFutureProofing, "core");
     TEST (testDwaCompressorSimd, "basic");
     TEST (testRle, "core");
+    TEST (testB44Blocks, "core");
     TEST (testB44ExpLogTable, "core");
+    TEST (testPxr24Planes, "core");
     TEST (testDwaLookups, "core");
     TEST (testIDManifest, "core");
+    TEST (testThreadPool, "core");
 
     // NB: If you add a test here, make sure to enumerate it in the
     // CMakeLists.txt so it runs as part of the test suite
@@ -0,0 +1,371 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <ImfB44Compressor.h>
+#include "ImathRandom.h"
+#include <iostream>
+#include <exception>
+#include <string.h>
+#include <assert.h>
+#include <vector>
+
+//
+// Checks the SIMD B44 block kernels against the original one block
+// at a time pack() and unpack functions, for runs of blocks of all
+// lengths around the vector widths, with flat, 14-byte and mixed
+// blocks and all kinds of half values.
+//
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+
+
+namespace {
+
+int
+refShiftAndRound (int x, int shift)
+{
+    x <<= 1;
+    int a = (1 << shift) - 1;
+    shift += 1;
+    int b = (x >> shift) & 1;
+    return (x + a + b) >> shift;
+}
+
+
+int
+refPack (const unsigned short s[16],
+	 unsigned char b[14],
+	 bool optFlatFields,
+	 bool exactMax)
+{
+    unsigned short t[16];
+
+    for (int i = 0; i < 16; ++i)
+    {
+	if ((s[i] & 0x7c00) == 0x7c00)
+	    t[i] = 0x8000;
+	else if (s[i] & 0x8000)
+	    t[i] = ~s[i];
+	else
+	    t[i] = s[i] | 0x8000;
+    }
+
+    unsigned short tMax = 0;
+
+    for (int i = 0; i < 16; ++i)
+	if (tMax < t[i])
+	    tMax = t[i];
+
+    int shift = -1;
+    int d[16];
+    int r[15];
+    int rMin;
+    int rMax;
+
+    const int bias = 0x20;
+
+    do
+    {
+	shift += 1;
+
+	for (int i = 0; i < 16; ++i)
+	    d[i] = refShiftAndRound (tMax - t[i], shift);
+
+	r[ 0] = d[ 0] - d[ 4] + bias;
+	r[ 1] = d[ 4] - d[ 8] + bias;
+	r[ 2] = d[ 8] - d[12] + bias;
+
+	r[ 3] = d[ 0] - d[ 1] + bias;
+	r[ 4] = d[ 4] - d[ 5] + bias;
+	r[ 5] = d[ 8] - d[ 9] + bias;
+	r[ 6] = d[12] - d[13] + bias;
+
+	r[ 7] = d[ 1] - d[ 2] + bias;
+	r[ 8] = d[ 5] - d[ 6] + bias;
+	r[ 9] = d[ 9] - d[10] + bias;
+	r[10] = d[13] - d[14] + bias;
+
+	r[11] = d[ 2] - d[ 3] + bias;
+	r[12] = d[ 6] - d[ 7] + bias;
+	r[13] = d[10] - d[11] + bias;
+	r[14] = d[14] - d[15] + bias;
+
+	rMin = r[0];
+	rMax = r[0];
+
+	for (int i = 1; i < 15; ++i)
+	{
+	    if (rMin > r[i])
+		rMin = r[i];
+
+	    if (rMax < r[i])
+		rMax = r[i];
+	}
+    }
+    while (rMin < 0 || rMax > 0x3f);
+
+    if (rMin == bias && rMax == bias && optFlatFields)
+    {
+	b[0] = (t[0] >> 8);
+	b[1] = (unsigned char) t[0];
+	b[2] = 0xfc;
+
+	return 3;
+    }
+
+    if (exactMax)
+	t[0] = tMax - (d[0] << shift);
+
+    b[ 0] = (t[0] >> 8);
+    b[ 1] = (unsigned char) t[0];
+
+    b[ 2] = (unsigned char) ((shift << 2) | (r[ 0] >> 4));
+    b[ 3] = (unsigned char) ((r[ 0] << 4) | (r[ 1] >> 2));
+    b[ 4] = (unsigned char) ((r[ 1] << 6) |  r[ 2]      );
+
+    b[ 5] = (unsigned char) ((r[ 3] << 2) | (r[ 4] >> 4));
+    b[ 6] = (unsigned char) ((r[ 4] << 4) | (r[ 5] >> 2));
+    b[ 7] = (unsigned char) ((r[ 5] << 6) |  r[ 6]      );
+
+    b[ 8] = (unsigned char) ((r[ 7] << 2) | (r[ 8] >> 4));
+    b[ 9] = (unsigned char) ((r[ 8] << 4) | (r[ 9] >> 2));
+    b[10] = (unsigned char) ((r[ 9] << 6) |  r[10]      );
+
+    b[11] = (unsigned char) ((r[11] << 2) | (r[12] >> 4));
+    b[12] = (unsigned char) ((r[12] << 4) | (r[13] >> 2));
+    b[13] = (unsigned char) ((r[13] << 6) |  r[14]      );
+
+    return 14;
+}
+
+
+void
+refUnpack14 (const unsigned char b[14], unsigned short s[16])
+{
+    s[ 0] = (b[0] << 8) | b[1];
+
+    unsigned short shift = (b[ 2] >> 2);
+    unsigned short bias = (0x20u << shift);
+
+    s[ 4] = s[ 0] + ((((b[ 2] << 4) | (b[ 3] >> 4)) & 0x3fu) << shift) - bias;
+    s[ 8] = s[ 4] + ((((b[ 3] << 2) | (b[ 4] >> 6)) & 0x3fu) << shift) - bias;
+    s[12] = s[ 8] +   ((b[ 4]                       & 0x3fu) << shift) - bias;
+
+    s[ 1] = s[ 0] +   ((unsigned int) (b[ 5] >> 2)           << shift) - bias;
+    s[ 5] = s[ 4] + ((((b[ 5] << 4) | (b[ 6] >> 4)) & 0x3fu) << shift) - bias;
+    s[ 9] = s[ 8] + ((((b[ 6] << 2) | (b[ 7] >> 6)) & 0x3fu) << shift) - bias;
+    s[13] = s[12] +   ((b[ 7]                       & 0x3fu) << shift) - bias;
+
+    s[ 2] = s[ 1] +   ((unsigned int)(b[ 8] >> 2)            << shift) - bias;
+    s[ 6] = s[ 5] + ((((b[ 8] << 4) | (b[ 9] >> 4)) & 0x3fu) << shift) - bias;
+    s[10] = s[ 9] + ((((b[ 9] << 2) | (b[10] >> 6)) & 0x3fu) << shift) - bias;
+    s[14] = s[13] +   ((b[10]                       & 0x3fu) << shift) - bias;
+
+    s[ 3] = s[ 2] +   ((unsigned int)(b[11] >> 2)            << shift) - bias;
+    s[ 7] = s[ 6] + ((((b[11] << 4) | (b[12] >> 4)) & 0x3fu) << shift) - bias;
+    s[11] = s[10] + ((((b[12] << 2) | (b[13] >> 6)) & 0x3fu) << shift) - bias;
+    s[15] = s[14] +   ((b[13]                       & 0x3fu) << shift) - bias;
+
+    for (int i = 0; i < 16; ++i)
+    {
+	if (s[i] & 0x8000)
+	    s[i] &= 0x7fff;
+	else
+	    s[i] = ~s[i];
+    }
+}
+
+
+void
+refUnpack3 (const unsigned char b[3], unsigned short s[16])
+{
+    s[0] = (b[0] << 8) | b[1];
+
+    if (s[0] & 0x8000)
+	s[0] &= 0x7fff;
+    else
+	s[0] = ~s[0];
+
+    for (int i = 1; i < 16; ++i)
+	s[i] = s[0];
+}
+
+
+//
+// Fill a block with one of several kinds of pixel data
+//
+
+void
+fillBlock (unsigned short s[16], int kind, IMATH_NAMESPACE::Rand48 &rand48)
+{
+    unsigned short base = rand48.nexti();
+
+    for (int i = 0; i < 16; ++i)
+    {
+	switch (kind)
+	{
+	  case 0:	// random bits, including NaNs and infinities
+	    s[i] = rand48.nexti();
+	    break;
+
+	  case 1:	// flat
+	    s[i] = base;
+	    break;
+
+	  case 2:	// small differences
+	    s[i] = base + rand48.nexti() % 64 - 32;
+	    break;
+
+	  case 3:	// a few infinities and NaNs among ordinary values
+	    s[i] = (rand48.nexti() % 6 == 0)?
+		       (0x7c00 | (rand48.nexti() & 0x83ff)):
+		       (0x3c00 + rand48.nexti() % 256);
+	    break;
+
+	  case 4:	// zeroes and denormals of both signs
+	    s[i] = (rand48.nexti() % 2? 0x8000: 0) | rand48.nexti() % 1024;
+	    break;
+
+	  case 5:	// extremes
+	    s[i] = (rand48.nexti() % 2)? 0x7bff: 0xfbff;
+	    break;
+
+	  default:	// ramps
+	    s[i] = base + i * (rand48.nexti() % 300);
+	    break;
+	}
+    }
+}
+
+
+void
+checkBlocks (int nBlocks,
+	     IMATH_NAMESPACE::Rand48 &rand48,
+	     bool optFlatFields,
+	     bool exactMax)
+{
+    //
+    // Four rows of nBlocks blocks, followed by a few guard values
+    // to catch overruns.
+    //
+
+    const int guard = 4;
+    const unsigned short guardValue = 0x5a5a;
+    int width = 4 * nBlocks;
+
+    vector<unsigned short> pixels (4 * (width + guard), guardValue);
+    vector<unsigned short> decoded (4 * (width + guard), guardValue);
+    vector<unsigned char> ref (14 * nBlocks + guard, 0x5a);
+    vector<unsigned char> out (14 * nBlocks + guard, 0x5a);
+
+    const unsigned short *rows[4];
+    unsigned short *decodedRows[4];
+
+    for (int r = 0; r < 4; ++r)
+    {
+	rows[r] = &pixels[r * (width + guard)];
+	decodedRows[r] = &decoded[r * (width + guard)];
+    }
+
+    int kind = rand48.nexti() % 8;
+    int refSize = 0;
+
+    for (int i = 0; i < nBlocks; ++i)
+    {
+	unsigned short s[16];
+	fillBlock (s, kind < 7? kind: rand48.nexti() % 7, rand48);
+
+	for (int r = 0; r < 4; ++r)
+	    memcpy (&pixels[r * (width + guard) + 4 * i], &s[4 * r],
+		    4 * sizeof (unsigned short));
+
+	refSize += refPack (s, &ref[refSize], optFlatFields, exactMax);
+    }
+
+    int outSize = B44Compressor::packBlocks (rows, nBlocks, &out[0],
+					     optFlatFields, exactMax);
+
+    assert (outSize == refSize);
+    assert (memcmp (&ref[0], &out[0], ref.size()) == 0);
+
+    //
+    // Uncompress the reference data, with exactly enough input
+    // and with one byte too few.
+    //
+
+    int inSize = B44Compressor::unpackBlocks (&ref[0], refSize, nBlocks,
+					      decodedRows);
+    assert (inSize == refSize);
+
+    for (int i = 0, b = 0; i < nBlocks; ++i)
+    {
+	unsigned short s[16];
+
+	if (ref[b + 2] >= (13 << 2))
+	{
+	    refUnpack3 (&ref[b], s);
+	    b += 3;
+	}
+	else
+	{
+	    refUnpack14 (&ref[b], s);
+	    b += 14;
+	}
+
+	for (int r = 0; r < 4; ++r)
+	    assert (memcmp (decodedRows[r] + 4 * i, &s[4 * r],
+			    4 * sizeof (unsigned short)) == 0);
+    }
+
+    for (int r = 0; r < 4; ++r)
+	for (int g = 0; g < guard; ++g)
+	    assert (decodedRows[r][width + g] == guardValue);
+
+    if (nBlocks > 0)
+    {
+	assert (B44Compressor::unpackBlocks (&ref[0], refSize - 1, nBlocks,
+					     decodedRows) == -1);
+    }
+}
+
+} // namespace
+
+
+void
+testB44Blocks (const std::string&)
+{
+    try
+    {
+	cout << "Testing B44 block packing and unpacking" << endl;
+
+	IMATH_NAMESPACE::Rand48 rand48 (0);
+
+	for (int i = 0; i < 200; ++i)
+	{
+	    for (int nBlocks = 0; nBlocks <= 9; ++nBlocks)
+	    {
+		checkBlocks (nBlocks, rand48, false, false);
+		checkBlocks (nBlocks, rand48, false, true);
+		checkBlocks (nBlocks, rand48, true, false);
+		checkBlocks (nBlocks, rand48, true, true);
+	    }
+	}
+
+	checkBlocks (480, rand48, true, true);
+	checkBlocks (481, rand48, true, false);
+
+	cout << "ok\n" << endl;
+    }
+    catch (const std::exception &e)
+    {
+	cerr << "ERROR -- caught exception: " << e.what() << endl;
+	assert (false);
+    }
+}
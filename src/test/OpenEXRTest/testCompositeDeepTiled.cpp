@@ -0,0 +1,538 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <ImfCompositeDeepTiled.h>
+#include <ImfCompositeDeepScanLine.h>
+#include <ImfDeepTiledOutputFile.h>
+#include <ImfDeepTiledInputFile.h>
+#include <ImfDeepTiledOutputPart.h>
+#include <ImfDeepTiledInputPart.h>
+#include <ImfDeepScanLineOutputFile.h>
+#include <ImfDeepScanLineInputFile.h>
+#include <ImfMultiPartOutputFile.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfDeepFrameBuffer.h>
+#include <ImfFrameBuffer.h>
+#include <ImfChannelList.h>
+#include <ImfHeader.h>
+#include <ImfPartType.h>
+#include <ImfThreading.h>
+#include "ImathRandom.h"
+#include <Iex.h>
+#include <half.h>
+#include <iostream>
+#include <sstream>
+#include <exception>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <vector>
+
+//
+// Writes the same random deep images as deep tiled files or parts and
+// as deep scan line files, composites them with CompositeDeepTiled and
+// with CompositeDeepScanLine, and checks that the results are identical,
+// for all levels of MIPMAP files, with and without ZBack, with and without
+// threads, and when the tiles are read one at a time in reverse order.
+//
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace IMATH_NAMESPACE;
+using namespace std;
+
+
+namespace {
+
+const int numChannels = 5;
+const char *channelNames[numChannels] = {"Z", "ZBack", "A", "R", "G"};
+
+
+struct DeepImage
+{
+    Box2i			dataWindow;
+    vector<unsigned int>	counts;		// per pixel
+    vector<vector<float> >	samples;	// per channel, pixel after pixel
+    vector<vector<float *> >	pointers;	// per channel, per pixel
+
+    void
+    generate (const Box2i &dw, Rand48 &rand48)
+    {
+	dataWindow = dw;
+	size_t numPixels = size_t (dw.size().x + 1) * (dw.size().y + 1);
+
+	counts.resize (numPixels);
+	size_t total = 0;
+
+	for (size_t i = 0; i < numPixels; ++i)
+	{
+	    counts[i] = rand48.nexti() % 5;
+	    total += counts[i];
+	}
+
+	samples.assign (numChannels, vector<float> (total + 1));
+	pointers.assign (numChannels, vector<float *> (numPixels));
+
+	for (size_t s = 0; s < total; ++s)
+	{
+	    samples[0][s] = float (rand48.nexti() % 8);
+	    samples[1][s] = samples[0][s] + float (rand48.nextf (0, 2));
+	    samples[2][s] = float (rand48.nextf (0, 1));
+	    samples[3][s] = float (rand48.nextf (0, 1));
+	    samples[4][s] = float (rand48.nextf (0, 1));
+	}
+
+	for (int c = 0; c < numChannels; ++c)
+	{
+	    size_t offset = 0;
+
+	    for (size_t i = 0; i < numPixels; ++i)
+	    {
+		pointers[c][i] = &samples[c][offset];
+		offset += counts[i];
+	    }
+	}
+    }
+
+    DeepFrameBuffer
+    frameBuffer (bool zback)
+    {
+	int width = dataWindow.size().x + 1;
+	ptrdiff_t origin = dataWindow.min.x + ptrdiff_t (dataWindow.min.y) * width;
+
+	DeepFrameBuffer fb;
+
+	fb.insertSampleCountSlice (Slice (UINT,
+					  (char *) (&counts[0] - origin),
+					  sizeof (unsigned int),
+					  sizeof (unsigned int) * width));
+
+	for (int c = 0; c < numChannels; ++c)
+	{
+	    if (c == 1 && !zback)
+		continue;
+
+	    fb.insert (channelNames[c],
+		       DeepSlice (FLOAT,
+				  (char *) (&pointers[c][0] - origin),
+				  sizeof (float *),
+				  sizeof (float *) * width,
+				  sizeof (float)));
+	}
+
+	return fb;
+    }
+};
+
+
+Header
+makeHeader (const Box2i &dataWindow, bool zback)
+{
+    Header header (dataWindow, dataWindow);
+    header.compression() = ZIPS_COMPRESSION;
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+	if (c != 1 || zback)
+	    header.channels().insert (channelNames[c], Channel (FLOAT));
+    }
+
+    return header;
+}
+
+
+//
+// composited output: Z, A and R as FLOAT, G as HALF
+//
+
+struct Output
+{
+    Box2i			dataWindow;
+    vector<vector<float> >	floats;
+    vector<half>		halves;
+    FrameBuffer			frameBuffer;
+
+    Output (const Box2i &dw):
+	dataWindow (dw),
+	floats (3, vector<float> (size_t (dw.size().x + 1) * (dw.size().y + 1), -1.0f)),
+	halves (floats[0].size(), half (-1.0f))
+    {
+	int width = dw.size().x + 1;
+	ptrdiff_t origin = dw.min.x + ptrdiff_t (dw.min.y) * width;
+	const char *names[] = {"Z", "A", "R"};
+
+	for (int c = 0; c < 3; ++c)
+	{
+	    frameBuffer.insert (names[c],
+				Slice (FLOAT,
+				       (char *) (&floats[c][0] - origin),
+				       sizeof (float),
+				       sizeof (float) * width));
+	}
+
+	frameBuffer.insert ("G",
+			    Slice (HALF,
+				   (char *) (&halves[0] - origin),
+				   sizeof (half),
+				   sizeof (half) * width));
+    }
+
+    bool
+    operator == (const Output &other) const
+    {
+	for (int c = 0; c < 3; ++c)
+	{
+	    if (memcmp (&floats[c][0], &other.floats[c][0],
+			floats[c].size() * sizeof (float)))
+		return false;
+	}
+
+	return memcmp (&halves[0], &other.halves[0],
+		       halves.size() * sizeof (half)) == 0;
+    }
+};
+
+
+string
+fileName (const string &tempDir, const char *kind, int i)
+{
+    ostringstream s;
+    s << tempDir << "imf_test_composite_deep_tiled_" << kind << i << ".exr";
+    return s.str();
+}
+
+
+void
+testSources (const string &tempDir,
+	     int numSources,
+	     bool zback,
+	     bool useParts,
+	     Rand48 &rand48)
+{
+    cout << "   sources " << numSources
+	 << (zback ? ", ZBack" : "")
+	 << (useParts ? ", parts" : ", files") << endl;
+
+    const Box2i dataWindow (V2i (-3, 2), V2i (33, 24));
+    const TileDescription tileDesc (7, 5, MIPMAP_LEVELS, ROUND_DOWN);
+
+    Header header = makeHeader (dataWindow, zback);
+    header.setTileDescription (tileDesc);
+    header.setType (DEEPTILE);
+
+    //
+    // random images for all levels of all sources
+    //
+
+    int numLevels;
+    vector<Box2i> levelWindows;
+
+    {
+	DeepTiledOutputFile file (fileName (tempDir, "tiled", 0).c_str(), header);
+	numLevels = file.numLevels();
+
+	for (int l = 0; l < numLevels; ++l)
+	    levelWindows.push_back (file.dataWindowForLevel (l));
+    }
+
+    vector<vector<DeepImage> > images (numSources, vector<DeepImage> (numLevels));
+
+    for (int i = 0; i < numSources; ++i)
+	for (int l = 0; l < numLevels; ++l)
+	    images[i][l].generate (levelWindows[l], rand48);
+
+    //
+    // write them as tiled files or parts, and one scan line file per level
+    //
+
+    if (useParts)
+    {
+	vector<Header> headers (numSources, header);
+
+	for (int i = 0; i < numSources; ++i)
+	{
+	    ostringstream name;
+	    name << "part" << i;
+	    headers[i].setName (name.str());
+	}
+
+	MultiPartOutputFile file (fileName (tempDir, "parts", 0).c_str(),
+				  &headers[0], numSources);
+
+	for (int i = 0; i < numSources; ++i)
+	{
+	    DeepTiledOutputPart part (file, i);
+
+	    for (int l = 0; l < numLevels; ++l)
+	    {
+		part.setFrameBuffer (images[i][l].frameBuffer (zback));
+		part.writeTiles (0, part.numXTiles (l) - 1,
+				 0, part.numYTiles (l) - 1, l);
+	    }
+	}
+    }
+    else
+    {
+	for (int i = 0; i < numSources; ++i)
+	{
+	    DeepTiledOutputFile file (fileName (tempDir, "tiled", i).c_str(), header);
+
+	    for (int l = 0; l < numLevels; ++l)
+	    {
+		file.setFrameBuffer (images[i][l].frameBuffer (zback));
+		file.writeTiles (0, file.numXTiles (l) - 1,
+				 0, file.numYTiles (l) - 1, l);
+	    }
+	}
+    }
+
+    //
+    // open the tiled sources
+    //
+
+    vector<DeepTiledInputFile *> files;
+    vector<DeepTiledInputPart *> parts;
+    MultiPartInputFile *multiPart = 0;
+    CompositeDeepTiled tiled;
+
+    if (useParts)
+    {
+	multiPart = new MultiPartInputFile (fileName (tempDir, "parts", 0).c_str());
+
+	for (int i = 0; i < numSources; ++i)
+	{
+	    parts.push_back (new DeepTiledInputPart (*multiPart, i));
+	    tiled.addSource (parts.back());
+	}
+    }
+    else
+    {
+	for (int i = 0; i < numSources; ++i)
+	{
+	    files.push_back (new DeepTiledInputFile (fileName (tempDir, "tiled", i).c_str()));
+	    tiled.addSource (files.back());
+	}
+    }
+
+    assert (tiled.sources() == numSources);
+    assert (tiled.dataWindow() == dataWindow);
+    assert (tiled.tileDescription() == tileDesc);
+
+    for (int l = 0; l < numLevels; ++l)
+    {
+	const Box2i &dw = levelWindows[l];
+
+	//
+	// reference: the same samples, composited by CompositeDeepScanLine
+	//
+
+	Header scanLineHeader = makeHeader (dw, zback);
+	scanLineHeader.setType (DEEPSCANLINE);
+	vector<DeepScanLineInputFile *> scanLineFiles;
+	CompositeDeepScanLine scanLine;
+
+	for (int i = 0; i < numSources; ++i)
+	{
+	    string name = fileName (tempDir, "scanline", i);
+
+	    {
+		DeepScanLineOutputFile file (name.c_str(), scanLineHeader);
+		file.setFrameBuffer (images[i][l].frameBuffer (zback));
+		file.writePixels (dw.size().y + 1);
+	    }
+
+	    scanLineFiles.push_back (new DeepScanLineInputFile (name.c_str()));
+	    scanLine.addSource (scanLineFiles.back());
+	}
+
+	Output expected (dw);
+	scanLine.setFrameBuffer (expected.frameBuffer);
+	scanLine.readPixels (dw.min.y, dw.max.y);
+
+	int numXTiles = useParts ? parts[0]->numXTiles (l) : files[0]->numXTiles (l);
+	int numYTiles = useParts ? parts[0]->numYTiles (l) : files[0]->numYTiles (l);
+
+	//
+	// all tiles at once
+	//
+
+	Output all (dw);
+	tiled.setFrameBuffer (all.frameBuffer);
+	tiled.readTiles (0, numXTiles - 1, 0, numYTiles - 1, l);
+	assert (all == expected);
+
+	//
+	// one tile at a time, in reverse order, and with a
+	// reversed range
+	//
+
+	Output single (dw);
+	tiled.setFrameBuffer (single.frameBuffer);
+
+	for (int dy = numYTiles - 1; dy >= 0; --dy)
+	    for (int dx = numXTiles - 1; dx >= 0; --dx)
+		tiled.readTile (dx, dy, l);
+
+	assert (single == expected);
+
+	Output reversed (dw);
+	tiled.setFrameBuffer (reversed.frameBuffer);
+	tiled.readTiles (numXTiles - 1, 0, numYTiles - 1, 0, l, l);
+	assert (reversed == expected);
+
+	//
+	// tiles outside the level
+	//
+
+	try
+	{
+	    tiled.readTile (numXTiles, 0, l);
+	    assert (false);
+	}
+	catch (const IEX_NAMESPACE::ArgExc &)
+	{
+	    // expected
+	}
+
+	for (size_t i = 0; i < scanLineFiles.size(); ++i)
+	{
+	    delete scanLineFiles[i];
+	    remove (fileName (tempDir, "scanline", i).c_str());
+	}
+    }
+
+    try
+    {
+	tiled.readTile (0, 0, numLevels);
+	assert (false);
+    }
+    catch (const IEX_NAMESPACE::ArgExc &)
+    {
+	// expected
+    }
+
+    for (size_t i = 0; i < files.size(); ++i)
+	delete files[i];
+
+    for (size_t i = 0; i < parts.size(); ++i)
+	delete parts[i];
+
+    delete multiPart;
+
+    for (int i = 0; i < numSources; ++i)
+	remove (fileName (tempDir, "tiled", i).c_str());
+
+    remove (fileName (tempDir, "parts", 0).c_str());
+}
+
+
+void
+testMismatch (const string &tempDir)
+{
+    cout << "   mismatched sources" << endl;
+
+    const Box2i dataWindow (V2i (0, 0), V2i (15, 15));
+    string names[3];
+
+    for (int i = 0; i < 3; ++i)
+    {
+	Header header = makeHeader (dataWindow, false);
+	header.setType (DEEPTILE);
+
+	if (i == 2)
+	{
+	    header.dataWindow() = Box2i (V2i (0, 0), V2i (15, 14));
+	    header.displayWindow() = header.dataWindow();
+	}
+
+	header.setTileDescription (TileDescription (i == 1 ? 4 : 8, 8));
+
+	names[i] = fileName (tempDir, "mismatch", i);
+	DeepTiledOutputFile file (names[i].c_str(), header);
+    }
+
+    DeepTiledInputFile first (names[0].c_str());
+    DeepTiledInputFile otherTiles (names[1].c_str());
+    DeepTiledInputFile otherWindow (names[2].c_str());
+
+    CompositeDeepTiled tiled;
+
+    try
+    {
+	tiled.readTile (0, 0);
+	assert (false);
+    }
+    catch (const IEX_NAMESPACE::ArgExc &)
+    {
+	// expected: no sources
+    }
+
+    tiled.addSource (&first);
+
+    try
+    {
+	tiled.addSource (&otherTiles);
+	assert (false);
+    }
+    catch (const IEX_NAMESPACE::ArgExc &)
+    {
+	// expected
+    }
+
+    try
+    {
+	tiled.addSource (&otherWindow);
+	assert (false);
+    }
+    catch (const IEX_NAMESPACE::ArgExc &)
+    {
+	// expected
+    }
+
+    assert (tiled.sources() == 1);
+
+    for (int i = 0; i < 3; ++i)
+	remove (names[i].c_str());
+}
+
+} // namespace
+
+
+void
+testCompositeDeepTiled (const std::string &tempDir)
+{
+    try
+    {
+	cout << "Testing tiled deep compositing" << endl;
+
+	Rand48 rand48 (0);
+	int numThreads = globalThreadCount();
+
+	for (int threads = 0; threads <= 4; threads += 4)
+	{
+	    cout << "  threads " << threads << endl;
+	    setGlobalThreadCount (threads);
+
+	    testSources (tempDir, 1, false, false, rand48);
+	    testSources (tempDir, 3, true, false, rand48);
+	    testSources (tempDir, 3, false, true, rand48);
+	    testSources (tempDir, 2, true, true, rand48);
+	}
+
+	setGlobalThreadCount (numThreads);
+
+	testMismatch (tempDir);
+
+	cout << "ok\n" << endl;
+    }
+    catch (const std::exception &e)
+    {
+	cerr << "ERROR -- caught exception: " << e.what() << endl;
+	assert (false);
+    }
+}
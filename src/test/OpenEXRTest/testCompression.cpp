@@ -18,11 +18,14 @@
 #include <ImfHeader.h>
 #include <ImathRandom.h>
 #include <ImfCompressor.h>
+#include <ImfStandardAttributes.h>
+#include <Iex.h>
 #include <half.h>
 #include "compareFloat.h"
 
 #include <stdio.h>
 #include <assert.h>
+#include <fstream>
 #include <limits>
 #include <algorithm>
 
@@ -504,6 +507,127 @@ writeRead (const std::string &tempDir,
     }
 }
 
+
+//
+// Write the half channel with the zlib based compressors at the
+// fastest and the smallest zipCompressionLevel; both must read back
+// unchanged, and level 0 (store only) must produce a larger file.
+//
+
+void
+writeReadZipLevels (const std::string &tempDir,
+                    pixelArray& array,
+                    int w,
+                    int h)
+{
+    std::string filename = tempDir + "imf_test_zip_level.exr";
+
+    const Compression comps[] =
+        { ZIP_COMPRESSION, ZIPS_COMPRESSION, PXR24_COMPRESSION };
+    const int levels[] = { 0, 9 };
+
+    for (Compression comp: comps)
+    {
+        std::streamoff fileSize[2];
+
+        for (int l = 0; l < 2; ++l)
+        {
+            cout << "compression " << comp
+                 << ", zipCompressionLevel " << levels[l] << endl;
+
+            Header hdr (w, h);
+            hdr.compression () = comp;
+            hdr.channels ().insert ("H", Channel (HALF));
+            addZipCompressionLevel (hdr, levels[l]);
+
+            {
+                FrameBuffer fb;
+                fb.insert ("H", Slice (HALF,
+                                       (char *) &array.h[0][0],
+                                       sizeof (half),
+                                       sizeof (half) * w));
+
+                OutputFile out (filename.c_str(), hdr);
+                out.setFrameBuffer (fb);
+                out.writePixels (h);
+            }
+
+            {
+                Array2D<half> h2 (h, w);
+                FrameBuffer fb;
+                fb.insert ("H", Slice (HALF,
+                                       (char *) &h2[0][0],
+                                       sizeof (half),
+                                       sizeof (half) * w));
+
+                InputFile in (filename.c_str());
+                assert (hasZipCompressionLevel (in.header()));
+                assert (zipCompressionLevel (in.header()) == levels[l]);
+                in.setFrameBuffer (fb);
+                in.readPixels (0, h - 1);
+
+                for (int y = 0; y < h; ++y)
+                    for (int x = 0; x < w; ++x)
+                        assert (h2[y][x].bits() == array.h[y][x].bits());
+            }
+
+            {
+                ifstream f (filename.c_str(), ios::binary | ios::ate);
+                fileSize[l] = f.tellg ();
+            }
+
+            remove (filename.c_str());
+        }
+
+        assert (fileSize[0] > fileSize[1]);
+    }
+
+    //
+    // Levels outside of zlib's range are ignored, both when writing
+    // and when reading, so such files stay readable
+    //
+
+    for (Compression comp: comps)
+    {
+        Header hdr (w, h);
+        hdr.compression () = comp;
+        hdr.channels ().insert ("H", Channel (HALF));
+        addZipCompressionLevel (hdr, 10);
+
+        {
+            FrameBuffer fb;
+            fb.insert ("H", Slice (HALF,
+                                   (char *) &array.h[0][0],
+                                   sizeof (half),
+                                   sizeof (half) * w));
+
+            OutputFile out (filename.c_str(), hdr);
+            out.setFrameBuffer (fb);
+            out.writePixels (h);
+        }
+
+        {
+            Array2D<half> h2 (h, w);
+            FrameBuffer fb;
+            fb.insert ("H", Slice (HALF,
+                                   (char *) &h2[0][0],
+                                   sizeof (half),
+                                   sizeof (half) * w));
+
+            InputFile in (filename.c_str());
+            assert (zipCompressionLevel (in.header()) == 10);
+            in.setFrameBuffer (fb);
+            in.readPixels (0, h - 1);
+
+            for (int y = 0; y < h; ++y)
+                for (int x = 0; x < w; ++x)
+                    assert (h2[y][x].bits() == array.h[y][x].bits());
+        }
+
+        remove (filename.c_str());
+    }
+}
+
 } // namespace
 
 
@@ -539,6 +663,7 @@ testCompression (const std::string &tempDir)
 
 	fillPixels3 (array, W, H);
 	writeRead (tempDir, array, W, H, DX, DY);
+	writeReadZipLevels (tempDir, array, W, H);
 
 	fillPixels4 (array, W, H);
 	writeRead (tempDir, array, W, H, DX, DY);
@@ -0,0 +1,211 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <ImfDeepCompositing.h>
+#include <ImfDeepCompositingPixels.h>
+#include "ImathRandom.h"
+#include <iostream>
+#include <exception>
+#include <string.h>
+#include <assert.h>
+#include <limits>
+#include <vector>
+
+//
+// Checks compositeDeepPixels() against DeepCompositing::composite_pixel():
+// the results for a run of pixels must be identical to compositing each
+// pixel separately, with and without ZBack, for pixels with many equal
+// depths, with opaque samples and NaN depths, and for sample counts on
+// both sides of the switch from rank sorting to std::sort.  A class derived
+// from DeepCompositing that overrides sort() must still be called per pixel.
+//
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+
+
+namespace {
+
+//
+// sorts samples from back to front
+//
+
+class ReverseCompositing : public DeepCompositing
+{
+  public:
+
+    virtual void sort (int order[],
+                       const float* inputs[],
+                       const char* channel_names[],
+                       int num_channels,
+                       int num_samples,
+                       int sources)
+    {
+	DeepCompositing::sort (order, inputs, channel_names,
+			       num_channels, num_samples, sources);
+
+	for (int i = 0; i < num_samples / 2; ++i)
+	    std::swap (order[i], order[num_samples - 1 - i]);
+    }
+};
+
+
+float
+randomDepth (IMATH_NAMESPACE::Rand48 &rand48)
+{
+    //
+    // few distinct values, so that many samples have the same depth;
+    // include both zeros, and an occasional NaN
+    //
+
+    int r = rand48.nexti() % 256;
+
+    if (r == 0)
+	return numeric_limits<float>::quiet_NaN();
+
+    switch (r % 4)
+    {
+      case 0:  return float (rand48.nexti() % 4);
+      case 1:  return (rand48.nexti() % 2) ? 0.0f : -0.0f;
+      default: return float (rand48.nextf (-10, 10));
+    }
+}
+
+
+void
+checkRun (DeepCompositing &comp,
+	  int numChannels,
+	  bool zback,
+	  int numPixels,
+	  int maxSamples,
+	  IMATH_NAMESPACE::Rand48 &rand48)
+{
+    vector<unsigned int> numSamples (numPixels);
+    vector<unsigned int> sources (numPixels);
+    size_t total = 0;
+
+    for (int p = 0; p < numPixels; ++p)
+    {
+	numSamples[p] = rand48.nexti() % (maxSamples + 1);
+	sources[p] = numSamples[p] ? 1 + rand48.nexti() % 3 : 0;
+	total += numSamples[p];
+    }
+
+    vector<vector<float> > samples (numChannels, vector<float> (total + 1));
+
+    for (size_t s = 0; s < total; ++s)
+    {
+	samples[0][s] = randomDepth (rand48);
+	samples[1][s] = samples[0][s] + float (rand48.nexti() % 2);
+
+	//
+	// mostly translucent samples, some of them opaque
+	//
+
+	samples[2][s] = (rand48.nexti() % 8 == 0) ?
+			    1.0f : float (rand48.nextf (0, 0.3));
+
+	//
+	// infinite values must not leak in from behind opaque samples
+	//
+
+	for (int c = 3; c < numChannels; ++c)
+	{
+	    samples[c][s] = (rand48.nexti() % 64 == 0) ?
+				numeric_limits<float>::infinity() :
+				float (rand48.nextf (-1, 4));
+	}
+    }
+
+    const char *allNames[] = {"Z", "ZBack", "A", "R", "G", "B", "X", "Y", "W"};
+    vector<const char *> names (allNames, allNames + numChannels);
+    vector<const float *> inputs (numChannels);
+
+    for (int c = 0; c < numChannels; ++c)
+	inputs[c] = &samples[c][0];
+
+    if (!zback)
+    {
+	names[1] = names[0];
+	inputs[1] = inputs[0];
+    }
+
+    vector<vector<float> > results (numChannels, vector<float> (numPixels));
+    vector<float *> outputs (numChannels);
+
+    for (int c = 0; c < numChannels; ++c)
+	outputs[c] = &results[c][0];
+
+    compositeDeepPixels (&comp, &outputs[0], &inputs[0], &names[0],
+			 numChannels, numPixels, &numSamples[0], &sources[0]);
+
+    vector<float> expected (numChannels);
+    vector<const float *> pixelInputs (numChannels);
+    size_t first = 0;
+
+    for (int p = 0; p < numPixels; ++p)
+    {
+	for (int c = 0; c < numChannels; ++c)
+	    pixelInputs[c] = inputs[c] + first;
+
+	comp.composite_pixel (&expected[0], &pixelInputs[0], &names[0],
+			      numChannels, numSamples[p], sources[p]);
+
+	for (int c = 0; c < numChannels; ++c)
+	{
+	    assert (memcmp (&results[c][p], &expected[c], sizeof (float)) == 0);
+	}
+
+	first += numSamples[p];
+    }
+}
+
+
+void
+checkCompositing (DeepCompositing &comp, IMATH_NAMESPACE::Rand48 &rand48)
+{
+    for (int numChannels = 3; numChannels <= 9; ++numChannels)
+    {
+	for (int z = 0; z < 2; ++z)
+	{
+	    checkRun (comp, numChannels, z != 0, 0, 4, rand48);
+	    checkRun (comp, numChannels, z != 0, 200, 4, rand48);
+	    checkRun (comp, numChannels, z != 0, 100, 20, rand48);
+	    checkRun (comp, numChannels, z != 0, 30, 100, rand48);
+	    checkRun (comp, numChannels, z != 0, 5, 300, rand48);
+	}
+    }
+}
+
+} // namespace
+
+
+void
+testDeepCompositing (const std::string&)
+{
+    try
+    {
+	cout << "Testing batched deep compositing" << endl;
+
+	IMATH_NAMESPACE::Rand48 rand48 (0);
+
+	DeepCompositing comp;
+	checkCompositing (comp, rand48);
+
+	ReverseCompositing reverse;
+	checkCompositing (reverse, rand48);
+
+	cout << "ok\n" << endl;
+    }
+    catch (const std::exception &e)
+    {
+	cerr << "ERROR -- caught exception: " << e.what() << endl;
+	assert (false);
+    }
+}
@@ -0,0 +1,612 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <ImfDeepScanLineOutputFile.h>
+#include <ImfDeepScanLineInputFile.h>
+#include <ImfDeepScanLineOutputPart.h>
+#include <ImfDeepScanLineInputPart.h>
+#include <ImfDeepSampleAllocator.h>
+#include <ImfMultiPartOutputFile.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfDeepFrameBuffer.h>
+#include <ImfChannelList.h>
+#include <ImfHeader.h>
+#include <ImfPartType.h>
+#include <ImfThreading.h>
+#include "ImathRandom.h"
+#include <Iex.h>
+#include <half.h>
+#include <iostream>
+#include <exception>
+#include <climits>
+#include <stdio.h>
+#include <assert.h>
+#include <vector>
+
+//
+// Writes random deep scan line images, reads them back with the
+// single-pass readPixels(s1,s2,allocator), and checks the sample counts
+// and samples against the data that were written and against the
+// two-pass readPixelSampleCounts() and readPixels(), for all deep
+// compression types, both line orders, files and parts, partial
+// scan line ranges, and with and without threads.
+//
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace IMATH_NAMESPACE;
+using namespace std;
+
+
+namespace {
+
+const unsigned int untouched = 0xdeadbeef;
+
+
+struct DeepImage
+{
+    Box2i			dataWindow;
+    vector<unsigned int>	counts;		// per pixel
+    vector<vector<float> >	z;		// per pixel
+    vector<vector<half> >	a;		// per pixel
+    vector<vector<unsigned int> > id;		// per pixel
+
+    int width () const  {return dataWindow.max.x - dataWindow.min.x + 1;}
+    int height () const {return dataWindow.max.y - dataWindow.min.y + 1;}
+
+    int
+    index (int x, int y) const
+    {
+	return (y - dataWindow.min.y) * width() + (x - dataWindow.min.x);
+    }
+};
+
+
+void
+makeImage (DeepImage &image, Rand48 &rand48)
+{
+    image.dataWindow = Box2i (V2i (-3, 5), V2i (33, 57));
+
+    int n = image.width() * image.height();
+
+    image.counts.resize (n);
+    image.z.resize (n);
+    image.a.resize (n);
+    image.id.resize (n);
+
+    for (int i = 0; i < n; ++i)
+    {
+	unsigned int count = rand48.nexti() % 6;
+
+	image.counts[i] = count;
+	image.z[i].resize (count);
+	image.a[i].resize (count);
+	image.id[i].resize (count);
+
+	for (unsigned int s = 0; s < count; ++s)
+	{
+	    image.z[i][s] = float (rand48.nextf (0.0, 100.0));
+	    image.a[i][s] = half (float (rand48.nextf (0.0, 1.0)));
+	    image.id[i][s] = rand48.nexti();
+	}
+    }
+}
+
+
+Header
+makeHeader (const DeepImage &image, Compression compression, LineOrder order)
+{
+    Header header (image.dataWindow, image.dataWindow);
+    header.channels().insert ("Z", Channel (FLOAT));
+    header.channels().insert ("A", Channel (HALF));
+    header.channels().insert ("id", Channel (UINT));
+    header.compression() = compression;
+    header.lineOrder() = order;
+    header.setType (DEEPSCANLINE);
+    return header;
+}
+
+
+//
+// Frame buffer that points directly into a DeepImage
+//
+
+struct ImagePointers
+{
+    vector<float *>		z;
+    vector<half *>		a;
+    vector<unsigned int *>	id;
+};
+
+
+DeepFrameBuffer
+imageFrameBuffer (DeepImage &image, ImagePointers &p)
+{
+    int n = image.width() * image.height();
+
+    p.z.resize (n);
+    p.a.resize (n);
+    p.id.resize (n);
+
+    for (int i = 0; i < n; ++i)
+    {
+	p.z[i] = image.z[i].empty()? 0: &image.z[i][0];
+	p.a[i] = image.a[i].empty()? 0: &image.a[i][0];
+	p.id[i] = image.id[i].empty()? 0: &image.id[i][0];
+    }
+
+    int width = image.width();
+    int offset = image.dataWindow.min.y * width + image.dataWindow.min.x;
+
+    DeepFrameBuffer fb;
+
+    fb.insertSampleCountSlice (Slice (UINT,
+				      (char *) (&image.counts[0] - offset),
+				      sizeof (unsigned int),
+				      sizeof (unsigned int) * width));
+    fb.insert ("Z", DeepSlice (FLOAT,
+			       (char *) (&p.z[0] - offset),
+			       sizeof (float *),
+			       sizeof (float *) * width,
+			       sizeof (float)));
+    fb.insert ("A", DeepSlice (HALF,
+			       (char *) (&p.a[0] - offset),
+			       sizeof (half *),
+			       sizeof (half *) * width,
+			       sizeof (half)));
+    fb.insert ("id", DeepSlice (UINT,
+				(char *) (&p.id[0] - offset),
+				sizeof (unsigned int *),
+				sizeof (unsigned int *) * width,
+				sizeof (unsigned int)));
+    return fb;
+}
+
+
+//
+// Reader-side image: sample counts, and the samples of each scan
+// line stored contiguously, channel after channel, allocated by
+// LineAllocator::allocate().
+//
+
+struct ReadImage
+{
+    Box2i			dataWindow;
+    vector<unsigned int>	counts;
+    vector<float *>		zPointers;
+    vector<half *>		aPointers;
+    vector<unsigned int *>	idPointers;
+    vector<vector<char> >	lineSamples;	// per scan line
+    vector<int>			allocations;	// per scan line
+
+    void
+    resize (const Box2i &dw)
+    {
+	dataWindow = dw;
+	int width = dw.max.x - dw.min.x + 1;
+	int height = dw.max.y - dw.min.y + 1;
+	counts.assign (width * height, untouched);
+	zPointers.assign (width * height, 0);
+	aPointers.assign (width * height, 0);
+	idPointers.assign (width * height, 0);
+	lineSamples.assign (height, vector<char>());
+	allocations.assign (height, 0);
+    }
+
+    int width () const {return dataWindow.max.x - dataWindow.min.x + 1;}
+
+    DeepFrameBuffer
+    frameBuffer ()
+    {
+	int offset = dataWindow.min.y * width() + dataWindow.min.x;
+	int w = width();
+
+	DeepFrameBuffer fb;
+
+	fb.insertSampleCountSlice (Slice (UINT,
+					  (char *) (&counts[0] - offset),
+					  sizeof (unsigned int),
+					  sizeof (unsigned int) * w));
+	fb.insert ("Z", DeepSlice (FLOAT,
+				   (char *) (&zPointers[0] - offset),
+				   sizeof (float *),
+				   sizeof (float *) * w,
+				   sizeof (float)));
+	fb.insert ("A", DeepSlice (HALF,
+				   (char *) (&aPointers[0] - offset),
+				   sizeof (half *),
+				   sizeof (half *) * w,
+				   sizeof (half)));
+	fb.insert ("id", DeepSlice (UINT,
+				    (char *) (&idPointers[0] - offset),
+				    sizeof (unsigned int *),
+				    sizeof (unsigned int *) * w,
+				    sizeof (unsigned int)));
+	return fb;
+    }
+
+    void
+    allocateLine (int y)
+    {
+	int w = width();
+	int row = (y - dataWindow.min.y) * w;
+
+	size_t total = 0;
+
+	for (int x = 0; x < w; ++x)
+	{
+	    assert (counts[row + x] != untouched);
+	    total += counts[row + x];
+	}
+
+	vector<char> &buffer = lineSamples[y - dataWindow.min.y];
+	buffer.resize (total * (sizeof (float) + sizeof (half) +
+				sizeof (unsigned int)) + 1);
+
+	float *z = (float *) &buffer[0];
+	unsigned int *id = (unsigned int *) (z + total);
+	half *a = (half *) (id + total);
+
+	for (int x = 0; x < w; ++x)
+	{
+	    zPointers[row + x] = z;
+	    idPointers[row + x] = id;
+	    aPointers[row + x] = a;
+	    z += counts[row + x];
+	    id += counts[row + x];
+	    a += counts[row + x];
+	}
+
+	allocations[y - dataWindow.min.y] += 1;
+    }
+};
+
+
+class LineAllocator : public DeepSampleAllocator
+{
+  public:
+
+    LineAllocator (ReadImage &image): _image (image), _throwAt (INT_MIN) {}
+
+    virtual void
+    allocate (const DeepFrameBuffer &frameBuffer, int scanLine1, int scanLine2)
+    {
+	assert (scanLine1 <= scanLine2);
+
+	//
+	// The frame buffer is the reader's current frame buffer.
+	//
+
+	assert (frameBuffer.getSampleCountSlice().base ==
+		_image.frameBuffer().getSampleCountSlice().base);
+
+	for (int y = scanLine1; y <= scanLine2; ++y)
+	{
+	    if (y == _throwAt)
+		throw IEX_NAMESPACE::ArgExc ("allocation failed");
+
+	    _image.allocateLine (y);
+	}
+    }
+
+    void throwAt (int y) {_throwAt = y;}
+
+  private:
+
+    ReadImage &		_image;
+    int			_throwAt;
+};
+
+
+void
+compare (const DeepImage &image, const ReadImage &read, int y1, int y2)
+{
+    const Box2i &dw = image.dataWindow;
+
+    for (int y = dw.min.y; y <= dw.max.y; ++y)
+    {
+	bool inRange = (y >= y1 && y <= y2);
+
+	assert (read.allocations[y - dw.min.y] == (inRange? 1: 0));
+
+	for (int x = dw.min.x; x <= dw.max.x; ++x)
+	{
+	    int i = image.index (x, y);
+
+	    if (!inRange)
+	    {
+		//
+		// The sample counts of scan lines outside the
+		// range must not have been written, even if they
+		// share a chunk with a scan line in the range.
+		//
+
+		assert (read.counts[i] == untouched);
+		continue;
+	    }
+
+	    assert (read.counts[i] == image.counts[i]);
+
+	    for (unsigned int s = 0; s < image.counts[i]; ++s)
+	    {
+		assert (read.zPointers[i][s] == image.z[i][s]);
+		assert (read.aPointers[i][s].bits() == image.a[i][s].bits());
+		assert (read.idPointers[i][s] == image.id[i][s]);
+	    }
+	}
+    }
+}
+
+
+//
+// Read scan lines y1 to y2 with the two-pass API, into
+// memory allocated in one piece, and check that the
+// result matches the single-pass read.
+//
+
+template <class In>
+void
+compareTwoPass (In &in, const ReadImage &single, int y1, int y2)
+{
+    ReadImage twoPass;
+    twoPass.resize (single.dataWindow);
+
+    in.setFrameBuffer (twoPass.frameBuffer());
+    in.readPixelSampleCounts (y1, y2);
+
+    for (int y = y1; y <= y2; ++y)
+	twoPass.allocateLine (y);
+
+    in.readPixels (y1, y2);
+
+    int w = single.width();
+
+    for (int y = y1; y <= y2; ++y)
+    {
+	for (int x = 0; x < w; ++x)
+	{
+	    int i = (y - single.dataWindow.min.y) * w + x;
+
+	    assert (twoPass.counts[i] == single.counts[i]);
+
+	    for (unsigned int s = 0; s < single.counts[i]; ++s)
+	    {
+		assert (twoPass.zPointers[i][s] == single.zPointers[i][s]);
+		assert (twoPass.aPointers[i][s].bits() ==
+			single.aPointers[i][s].bits());
+		assert (twoPass.idPointers[i][s] == single.idPointers[i][s]);
+	    }
+	}
+    }
+}
+
+
+template <class In>
+void
+readAndCompare (In &in, const DeepImage &image, int y1, int y2)
+{
+    ReadImage read;
+    read.resize (image.dataWindow);
+
+    in.setFrameBuffer (read.frameBuffer());
+
+    LineAllocator allocator (read);
+    in.readPixels (y1, y2, allocator);
+
+    compare (image, read, min (y1, y2), max (y1, y2));
+    compareTwoPass (in, read, min (y1, y2), max (y1, y2));
+}
+
+
+template <class In>
+void
+readRanges (In &in, const DeepImage &image)
+{
+    const Box2i &dw = image.dataWindow;
+
+    //
+    // Whole image, a range that does not start or end on a chunk
+    // boundary, given in reverse, and a single scan line.
+    //
+
+    readAndCompare (in, image, dw.min.y, dw.max.y);
+    readAndCompare (in, image, dw.max.y - 3, dw.min.y + 7);
+    readAndCompare (in, image, dw.min.y + 20, dw.min.y + 20);
+}
+
+
+void
+testFile (const std::string &tempDir,
+	  const DeepImage &srcImage,
+	  Compression compression,
+	  LineOrder order)
+{
+    std::string fn = tempDir + "imf_test_deep_single_pass.exr";
+    DeepImage image = srcImage;
+
+    {
+	ImagePointers p;
+	Header header = makeHeader (image, compression, order);
+	remove (fn.c_str());
+	DeepScanLineOutputFile out (fn.c_str(), header);
+	out.setFrameBuffer (imageFrameBuffer (image, p));
+	out.writePixels (image.height());
+    }
+
+    {
+	DeepScanLineInputFile in (fn.c_str());
+	readRanges (in, image);
+    }
+
+    remove (fn.c_str());
+}
+
+
+void
+testPart (const std::string &tempDir, const DeepImage &image)
+{
+    std::string fn = tempDir + "imf_test_deep_single_pass_multipart.exr";
+
+    vector<Header> headers;
+    headers.push_back (makeHeader (image, ZIPS_COMPRESSION, INCREASING_Y));
+    headers.push_back (makeHeader (image, RLE_COMPRESSION, DECREASING_Y));
+    headers[0].setName ("zips");
+    headers[1].setName ("rle");
+
+    {
+	DeepImage copy = image;
+	ImagePointers p;
+	remove (fn.c_str());
+	MultiPartOutputFile out (fn.c_str(), &headers[0], int (headers.size()));
+
+	for (int i = 0; i < int (headers.size()); ++i)
+	{
+	    DeepScanLineOutputPart part (out, i);
+	    part.setFrameBuffer (imageFrameBuffer (copy, p));
+	    part.writePixels (copy.height());
+	}
+    }
+
+    {
+	MultiPartInputFile in (fn.c_str());
+
+	for (int i = 0; i < int (headers.size()); ++i)
+	{
+	    DeepScanLineInputPart part (in, i);
+	    readRanges (part, image);
+	}
+    }
+
+    remove (fn.c_str());
+}
+
+
+void
+testErrors (const std::string &tempDir, const DeepImage &srcImage)
+{
+    std::string fn = tempDir + "imf_test_deep_single_pass_errors.exr";
+    DeepImage image = srcImage;
+
+    {
+	ImagePointers p;
+	Header header = makeHeader (image, ZIPS_COMPRESSION, INCREASING_Y);
+	remove (fn.c_str());
+	DeepScanLineOutputFile out (fn.c_str(), header);
+	out.setFrameBuffer (imageFrameBuffer (image, p));
+	out.writePixels (image.height());
+    }
+
+    const Box2i &dw = image.dataWindow;
+
+    {
+	DeepScanLineInputFile in (fn.c_str());
+	ReadImage read;
+	read.resize (dw);
+	LineAllocator allocator (read);
+
+	//
+	// No frame buffer
+	//
+
+	try
+	{
+	    in.readPixels (dw.min.y, dw.max.y, allocator);
+	    assert (false);
+	}
+	catch (const IEX_NAMESPACE::ArgExc &)
+	{
+	    // expected
+	}
+
+	in.setFrameBuffer (read.frameBuffer());
+
+	//
+	// Scan lines outside the data window
+	//
+
+	try
+	{
+	    in.readPixels (dw.min.y - 1, dw.max.y, allocator);
+	    assert (false);
+	}
+	catch (const IEX_NAMESPACE::ArgExc &)
+	{
+	    // expected
+	}
+
+	//
+	// An exception thrown by the allocator is passed on
+	// to the caller, and the file remains usable.
+	//
+
+	allocator.throwAt (dw.min.y + 10);
+
+	try
+	{
+	    in.readPixels (dw.min.y, dw.max.y, allocator);
+	    assert (false);
+	}
+	catch (const IEX_NAMESPACE::BaseExc &)
+	{
+	    // expected
+	}
+
+	readAndCompare (in, image, dw.min.y, dw.max.y);
+    }
+
+    remove (fn.c_str());
+}
+
+} // namespace
+
+
+void
+testDeepScanLineSinglePass (const std::string &tempDir)
+{
+    try
+    {
+	cout << "Testing single-pass deep scan line reads" << endl;
+
+	Rand48 rand48 (0);
+	DeepImage image;
+	makeImage (image, rand48);
+
+	const Compression compressions[] =
+	{
+	    NO_COMPRESSION,
+	    RLE_COMPRESSION,
+	    ZIPS_COMPRESSION
+	};
+
+	int numThreads = globalThreadCount();
+
+	for (int threads = 0; threads <= 4; threads += 4)
+	{
+	    cout << "  threads " << threads << endl;
+	    setGlobalThreadCount (threads);
+
+	    for (size_t i = 0; i < sizeof (compressions) / sizeof (*compressions); ++i)
+	    {
+		testFile (tempDir, image, compressions[i], INCREASING_Y);
+		testFile (tempDir, image, compressions[i], DECREASING_Y);
+	    }
+
+	    testPart (tempDir, image);
+	    testErrors (tempDir, image);
+	}
+
+	setGlobalThreadCount (numThreads);
+
+	cout << "ok\n" << endl;
+    }
+    catch (const std::exception &e)
+    {
+	cerr << "ERROR -- caught exception: " << e.what() << endl;
+	assert (false);
+    }
+}
@@ -246,7 +246,7 @@ testDct()
             orig._buffer[i] = test._buffer[i] = rand48.nextf();
         }
 
-        dctForward8x8(test._buffer);
+        dctForward8x8_scalar(test._buffer);
         dctInverse8x8_scalar<0>(test._buffer);
 
         compareBufferRelative(orig, test, .02, 1e-3);
@@ -322,6 +322,55 @@ testDct()
         INVERSE_DCT_SCALAR_TEST_N(dctInverse8x8_avx, 6, "2x8")
         INVERSE_DCT_SCALAR_TEST_N(dctInverse8x8_avx, 7, "1x8")
     }
+
+    if (cpuid.neon) 
+    {
+        cout << "      Inverse, NEON: " << endl;
+        INVERSE_DCT_SCALAR_TEST_N(dctInverse8x8_neon, 0, "8x8")
+        INVERSE_DCT_SCALAR_TEST_N(dctInverse8x8_neon, 1, "7x8")
+        INVERSE_DCT_SCALAR_TEST_N(dctInverse8x8_neon, 2, "6x8")
+        INVERSE_DCT_SCALAR_TEST_N(dctInverse8x8_neon, 3, "5x8")
+        INVERSE_DCT_SCALAR_TEST_N(dctInverse8x8_neon, 4, "4x8")
+        INVERSE_DCT_SCALAR_TEST_N(dctInverse8x8_neon, 5, "3x8")
+        INVERSE_DCT_SCALAR_TEST_N(dctInverse8x8_neon, 6, "2x8")
+        INVERSE_DCT_SCALAR_TEST_N(dctInverse8x8_neon, 7, "1x8")
+    }
+
+#define FORWARD_DCT_TEST(_func, _ref, _relErr, _absErr)            \
+    for (int iter=0; iter<numIter; ++iter)                         \
+    {                                                              \
+        for (int i=0; i<64; ++i)                                   \
+        {                                                          \
+            orig._buffer[i] = test._buffer[i] = rand48.nextf();    \
+        }                                                          \
+        _ref(orig._buffer);                                        \
+        _func(test._buffer);                                       \
+        compareBufferRelative(orig, test, _relErr, _absErr);       \
+    }
+
+    if (cpuid.sse2) 
+    {
+        cout << "      Forward, SSE2: " << endl;
+        FORWARD_DCT_TEST(dctForward8x8_sse2, dctForward8x8_scalar, .01, 1e-5)
+    }
+
+#ifdef IMF_HAVE_AVX2_TARGET
+    if (cpuid.avx2) 
+    {
+        //
+        // The AVX version does the same arithmetic as the SSE2
+        // version, so the results should match it exactly
+        //
+
+        cout << "      Forward, AVX: " << endl;
+        FORWARD_DCT_TEST(dctForward8x8_avx, dctForward8x8_sse2, 0, 0)
+    }
+#endif
+
+#ifdef IMF_HAVE_NEON
+    cout << "      Forward, NEON: " << endl;
+    FORWARD_DCT_TEST(dctForward8x8_neon, dctForward8x8_scalar, .01, 1e-5)
+#endif
 }
 
 //
@@ -400,6 +449,39 @@ testFloatToHalf()
             }
         }
     }
+
+    if (cpuid.neon)
+    {
+        cout << "      convertFloatToHalf64_neon()" << endl;
+        for (int iter=0; iter<numIter; ++iter)
+        {
+            for (int i=0; i<64; ++i)
+            {
+                if (i < 32)
+                {
+                    src._buffer[i] = (float)140000*(rand48.nextf()-.5);
+                } 
+                else
+                {
+                    src._buffer[i] = (float)(rand48.nextf()-.5);
+                }
+                dst._buffer[i] = 0;
+            }
+
+            convertFloatToHalf64_neon(dst._buffer, src._buffer);
+
+            for (int i=0; i<64; ++i)
+            {
+                half value = (half)src._buffer[i];
+                if (value.bits() != dst._buffer[i])
+                {
+                    cout << src._buffer[i] << " -> " << dst._buffer[i] 
+                                     << " expected " << value.bits() << endl;
+                    assert(false);
+                }
+            }
+        }
+    }
 }
 
 //
@@ -484,6 +566,46 @@ testFromHalfZigZag()
             }
         } // iter
     } // f16c
+
+    if (cpuid.neon)
+    {
+        const int             numIter = 1000000;
+        Rand48                rand48(0);
+        half                  h;
+        SimdAlignedBuffer64f  dstNeon;
+
+        cout << "      fromHalfZigZag_neon()" << endl;
+
+        for (int iter=0; iter<numIter; ++iter)
+        {
+            for (int i=0; i<64; ++i)
+            {
+                if (i < 32)
+                {
+                    h = (half)(140000.*(rand48.nextf() - .5));
+                }
+                else 
+                {
+                    h = (half)(rand48.nextf() - .5);
+                }
+                src._buffer[i] = h.bits();
+            }
+
+            fromHalfZigZag_scalar(src._buffer, dst._buffer);
+            fromHalfZigZag_neon(src._buffer, dstNeon._buffer);
+
+            for (int i=0; i<64; ++i)
+            {
+                if ( fabsf(dst._buffer[i] - dstNeon._buffer[i]) > 1e-5 )
+                {
+                    cout << "At index " << i << ": ";
+                    cout << "expecting " << dst._buffer[i] << "; got "
+                         << dstNeon._buffer[i] << endl;
+                    assert(false);
+                }
+            }
+        } // iter
+    } // neon
 }
 
 
@@ -0,0 +1,271 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <ImfPxr24Compressor.h>
+#include "ImathRandom.h"
+#include <iostream>
+#include <exception>
+#include <string.h>
+#include <assert.h>
+#include <vector>
+
+//
+// Checks the SIMD PXR24 byte plane kernels against the original one
+// pixel at a time loops, for rows of all lengths around the vector
+// widths, with unaligned buffers, and with float values close to the
+// rounding, overflow, infinity and NAN cases of the 24-bit conversion.
+//
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+
+
+namespace {
+
+unsigned int
+refFloatToFloat24 (unsigned int f)
+{
+    unsigned int s = f & 0x80000000;
+    unsigned int e = f & 0x7f800000;
+    unsigned int m = f & 0x007fffff;
+    unsigned int i;
+
+    if (e == 0x7f800000)
+    {
+	if (m)
+	{
+	    m >>= 8;
+	    i = (e >> 8) | m | (m == 0);
+	}
+	else
+	{
+	    i = e >> 8;
+	}
+    }
+    else
+    {
+	i = ((e | m) + (m & 0x00000080)) >> 8;
+
+	if (i >= 0x7f8000)
+	    i = (e | m) >> 8;
+    }
+
+    return (s >> 8) | i;
+}
+
+
+int
+numPlanes (PixelType type)
+{
+    return type == UINT ? 4 : (type == HALF ? 2 : 3);
+}
+
+
+int
+valueSize (PixelType type)
+{
+    return type == HALF ? 2 : 4;
+}
+
+
+void
+refSplit (PixelType type, const char *in, int n, unsigned char *out)
+{
+    int np = numPlanes (type);
+    unsigned int previousPixel = 0;
+
+    for (int j = 0; j < n; ++j)
+    {
+	unsigned int pixel;
+
+	if (type == HALF)
+	{
+	    unsigned short h;
+	    memcpy (&h, in + 2 * j, 2);
+	    pixel = h;
+	}
+	else
+	{
+	    memcpy (&pixel, in + 4 * j, 4);
+
+	    if (type == FLOAT)
+		pixel = refFloatToFloat24 (pixel);
+	}
+
+	unsigned int diff = pixel - previousPixel;
+	previousPixel = pixel;
+
+	for (int p = 0; p < np; ++p)
+	    out[p * n + j] = diff >> (8 * (np - 1 - p));
+    }
+}
+
+
+void
+refMerge (PixelType type, const unsigned char *in, int n, char *out)
+{
+    int np = numPlanes (type);
+    int shift = (type == FLOAT) ? 8 : 0;
+    unsigned int pixel = 0;
+
+    for (int j = 0; j < n; ++j)
+    {
+	unsigned int diff = 0;
+
+	for (int p = 0; p < np; ++p)
+	    diff = (diff << 8) | in[p * n + j];
+
+	pixel += diff << shift;
+
+	if (type == HALF)
+	{
+	    unsigned short h = pixel;
+	    memcpy (out + 2 * j, &h, 2);
+	}
+	else
+	{
+	    memcpy (out + 4 * j, &pixel, 4);
+	}
+    }
+}
+
+
+unsigned int
+randomValue (IMATH_NAMESPACE::Rand48 &rand48, int kind, unsigned int previous)
+{
+    static const unsigned int special[] =
+    {
+	0x00000000, 0x80000000, 0x00000001, 0x0000007f, 0x00000080,
+	0x3f7fff7f, 0x3f7fff80, 0x7f7fff7f, 0x7f7fff80, 0x7f7fffff,
+	0xff7fff80, 0x7f800000, 0xff800000, 0x7f800001, 0x7f8000ff,
+	0x7f800100, 0xff8000ff, 0x7fc00000, 0xffffffff
+    };
+
+    switch (kind)
+    {
+      case 0:
+	return rand48.nexti();
+
+      case 1:
+	return special[rand48.nexti() % (sizeof (special) / sizeof (special[0]))];
+
+      case 2:
+	return previous + rand48.nexti() % 512 - 256;
+
+      default:
+	return previous;
+    }
+}
+
+
+void
+checkRow (PixelType type, int n, IMATH_NAMESPACE::Rand48 &rand48)
+{
+    const int guard = 32;
+    const unsigned char g = 0xa5;
+
+    int offset = rand48.nexti() % 4;
+    int inBytes = n * valueSize (type);
+    int planeBytes = n * numPlanes (type);
+
+    vector<char> in (inBytes + 4);
+    vector<unsigned char> planes (offset + planeBytes + guard, g);
+    vector<unsigned char> refPlanes (planeBytes + 1);
+    vector<char> out (offset + inBytes + guard, char (g));
+    vector<char> refOut (inBytes + 1);
+
+    int kind = rand48.nexti() % 4;
+    unsigned int value = rand48.nexti();
+
+    for (int j = 0; j < n; ++j)
+    {
+	value = randomValue (rand48, kind == 3 ? rand48.nexti() % 3 : kind, value);
+
+	if (type == HALF)
+	{
+	    unsigned short h = value;
+	    memcpy (&in[offset + 2 * j], &h, 2);
+	}
+	else
+	{
+	    memcpy (&in[offset + 4 * j], &value, 4);
+	}
+    }
+
+    //
+    // Split and compare against the reference.
+    //
+
+    Pxr24Compressor::splitPlanes (type, &in[offset], n, &planes[offset]);
+    refSplit (type, &in[offset], n, &refPlanes[0]);
+
+    for (int i = 0; i < planeBytes; ++i)
+	assert (planes[offset + i] == refPlanes[i]);
+
+    for (int i = 0; i < guard; ++i)
+	assert (planes[offset + planeBytes + i] == g);
+
+    //
+    // Merge the planes back, and merge random planes, which
+    // exercise the wraparound of the running sums.
+    //
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+	if (pass == 1)
+	{
+	    for (int i = 0; i < planeBytes; ++i)
+		planes[offset + i] = refPlanes[i] = rand48.nexti();
+	}
+
+	Pxr24Compressor::mergePlanes (type, &planes[offset], n, &out[offset]);
+	refMerge (type, &refPlanes[0], n, &refOut[0]);
+
+	for (int i = 0; i < inBytes; ++i)
+	    assert (out[offset + i] == refOut[i]);
+
+	for (int i = 0; i < guard; ++i)
+	    assert ((unsigned char) out[offset + inBytes + i] == g);
+
+	if (pass == 0 && type != FLOAT)
+	    assert (memcmp (&out[offset], &in[offset], inBytes) == 0);
+    }
+}
+
+} // namespace
+
+
+void
+testPxr24Planes (const std::string&)
+{
+    try
+    {
+	cout << "Testing PXR24 byte plane splitting and merging" << endl;
+
+	IMATH_NAMESPACE::Rand48 rand48 (0);
+	PixelType types[] = {UINT, HALF, FLOAT};
+
+	for (int t = 0; t < 3; ++t)
+	{
+	    for (int i = 0; i < 50; ++i)
+		for (int n = 0; n <= 40; ++n)
+		    checkRow (types[t], n, rand48);
+
+	    checkRow (types[t], 1920, rand48);
+	    checkRow (types[t], 1921, rand48);
+	}
+
+	cout << "ok\n" << endl;
+    }
+    catch (const std::exception &e)
+    {
+	cerr << "ERROR -- caught exception: " << e.what() << endl;
+	assert (false);
+    }
+}
@@ -0,0 +1,481 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <ImfRgbaFile.h>
+#include <ImfTiledRgbaFile.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfMultiPartOutputFile.h>
+#include <ImfInputPart.h>
+#include <ImfOutputPart.h>
+#include <ImfTiledInputPart.h>
+#include <ImfTiledOutputPart.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfPartType.h>
+#include <ImfStdIO.h>
+#include <ImfArray.h>
+#include "Iex.h"
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <assert.h>
+
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+using namespace IMATH_NAMESPACE;
+
+
+namespace {
+
+const int W = 157;
+const int H = 131;
+
+#ifndef _WIN32
+typedef PosixIFStream FileIStream;
+#else
+typedef StdIFStream FileIStream;
+#endif
+
+
+//
+// A stream that forwards to another stream, and counts how often
+// read() and readAt() are called.  Positional reads can be turned
+// off, to compare the readers' locked and lock-free paths.
+//
+
+class CountingIStream: public IStream
+{
+  public:
+
+    CountingIStream (IStream &is, bool allowReadAt):
+	IStream (is.fileName()),
+	reads (0),
+	readAts (0),
+	_is (is),
+	_allowReadAt (allowReadAt)
+    {
+	// empty
+    }
+
+    virtual bool
+    read (char c[], int n)
+    {
+	++reads;
+	return _is.read (c, n);
+    }
+
+    virtual uint64_t	tellg ()		{return _is.tellg();}
+    virtual void	seekg (uint64_t pos)	{_is.seekg (pos);}
+    virtual void	clear ()		{_is.clear();}
+
+    virtual bool
+    supportsReadAt () const
+    {
+	return _allowReadAt && _is.supportsReadAt();
+    }
+
+    virtual void
+    readAt (uint64_t p, char c[], int n)
+    {
+	++readAts;
+	_is.readAt (p, c, n);
+    }
+
+    std::atomic<int>	reads;
+    std::atomic<int>	readAts;
+
+  private:
+
+    IStream &		_is;
+    bool		_allowReadAt;
+};
+
+
+void
+fillPixels (Array2D<Rgba> &pixels, int w, int h, int seed)
+{
+    for (int y = 0; y < h; ++y)
+    {
+	for (int x = 0; x < w; ++x)
+	{
+	    Rgba &p = pixels[y][x];
+
+	    p.r = (x * 7 + y + seed) % 17 / 16.0f;
+	    p.g = (x + y * 5 + seed) % 13 / 12.0f;
+	    p.b = (x * y + seed) % 11 / 10.0f;
+	    p.a = 1;
+	}
+    }
+}
+
+
+void
+comparePixels (const Array2D<Rgba> &a, const Array2D<Rgba> &b, int w, int h)
+{
+    for (int y = 0; y < h; ++y)
+    {
+	for (int x = 0; x < w; ++x)
+	{
+	    assert (a[y][x].r == b[y][x].r);
+	    assert (a[y][x].g == b[y][x].g);
+	    assert (a[y][x].b == b[y][x].b);
+	    assert (a[y][x].a == b[y][x].a);
+	}
+    }
+}
+
+
+void
+testPosixIFStream (const std::string &tempDir)
+{
+#ifndef _WIN32
+    cout << "PosixIFStream" << endl;
+
+    std::string fileName = tempDir + "imf_test_read_at.bin";
+
+    {
+	ofstream os (fileName.c_str(), ios_base::binary);
+
+	for (int i = 0; i < 1000; ++i)
+	    os.put (char (i * 3));
+    }
+
+    PosixIFStream is (fileName.c_str());
+    assert (is.supportsReadAt());
+
+    char c[16];
+
+    assert (is.read (c, 10));
+    assert (is.tellg() == 10);
+
+    for (int i = 0; i < 10; ++i)
+	assert (c[i] == char (i * 3));
+
+    //
+    // readAt() neither uses nor moves the reading position.
+    //
+
+    is.readAt (500, c, 16);
+    assert (is.tellg() == 10);
+
+    for (int i = 0; i < 16; ++i)
+	assert (c[i] == char ((500 + i) * 3));
+
+    assert (is.read (c, 1));
+    assert (c[0] == char (10 * 3));
+
+    //
+    // Reading the last byte returns false, and
+    // reading past the end of the file throws.
+    //
+
+    is.seekg (990);
+    assert (!is.read (c, 10));
+    assert (is.tellg() == 1000);
+
+    bool caught = false;
+
+    try
+    {
+	is.readAt (995, c, 10);
+    }
+    catch (const IEX_NAMESPACE::InputExc &)
+    {
+	caught = true;
+    }
+
+    assert (caught);
+
+    //
+    // Offsets that do not fit in a file offset are rejected.
+    //
+
+    caught = false;
+
+    try
+    {
+	is.readAt (~uint64_t (0) - 4, c, 10);
+    }
+    catch (const IEX_NAMESPACE::InputExc &)
+    {
+	caught = true;
+    }
+
+    assert (caught);
+
+    remove (fileName.c_str());
+#endif
+}
+
+
+void
+testStdIFStream (const std::string &tempDir)
+{
+    cout << "StdIFStream" << endl;
+
+    std::string fileName = tempDir + "imf_test_read_at.bin";
+
+    {
+	ofstream os (fileName.c_str(), ios_base::binary);
+
+	for (int i = 0; i < 100; ++i)
+	    os.put (char (i));
+    }
+
+    {
+	//
+	// std::ifstream has no positional reads, so
+	// neither does StdIFStream.
+	//
+
+	StdIFStream is (fileName.c_str());
+	assert (!is.supportsReadAt());
+
+	bool caught = false;
+
+	try
+	{
+	    char c[4];
+	    is.readAt (50, c, 4);
+	}
+	catch (const IEX_NAMESPACE::InputExc &)
+	{
+	    caught = true;
+	}
+
+	assert (caught);
+    }
+
+    remove (fileName.c_str());
+}
+
+
+void
+writeFiles (const std::string &tempDir, const Array2D<Rgba> &p1,
+	    const Array2D<Rgba> &p2)
+{
+    std::string scanLineName = tempDir + "imf_test_read_at_scanline.exr";
+    std::string tiledName = tempDir + "imf_test_read_at_tiled.exr";
+    std::string multiPartName = tempDir + "imf_test_read_at_multipart.exr";
+
+    {
+	Header hdr (W, H);
+	hdr.compression() = ZIP_COMPRESSION;
+	RgbaOutputFile out (scanLineName.c_str(), hdr, WRITE_RGBA);
+	out.setFrameBuffer (&p1[0][0], 1, W);
+	out.writePixels (H);
+    }
+
+    {
+	Header hdr (W, H);
+	hdr.compression() = PIZ_COMPRESSION;
+	TiledRgbaOutputFile out (tiledName.c_str(), hdr, WRITE_RGBA,
+				 16, 16, MIPMAP_LEVELS, ROUND_DOWN);
+	out.setFrameBuffer (&p1[0][0], 1, W);
+	out.writeTiles (0, out.numXTiles() - 1, 0, out.numYTiles() - 1);
+    }
+
+    {
+	vector<Header> headers;
+
+	for (int i = 0; i < 4; ++i)
+	{
+	    Header hdr (W, H);
+	    hdr.compression() = ZIP_COMPRESSION;
+	    hdr.channels().insert ("R", Channel (HALF));
+	    hdr.channels().insert ("G", Channel (HALF));
+	    hdr.channels().insert ("B", Channel (HALF));
+	    hdr.channels().insert ("A", Channel (HALF));
+	    hdr.setName (string ("part") + char ('0' + i));
+
+	    if (i & 1)
+	    {
+		hdr.setType (TILEDIMAGE);
+		hdr.setTileDescription (TileDescription (32, 16));
+	    }
+	    else
+	    {
+		hdr.setType (SCANLINEIMAGE);
+	    }
+
+	    headers.push_back (hdr);
+	}
+
+	MultiPartOutputFile out (multiPartName.c_str(), &headers[0], 4);
+
+	for (int i = 0; i < 4; ++i)
+	{
+	    const Array2D<Rgba> &p = (i & 2)? p2: p1;
+	    char *base = (char *) &p[0][0];
+
+	    FrameBuffer fb;
+	    fb.insert ("R", Slice (HALF, base + 0, sizeof (Rgba), sizeof (Rgba) * W));
+	    fb.insert ("G", Slice (HALF, base + 2, sizeof (Rgba), sizeof (Rgba) * W));
+	    fb.insert ("B", Slice (HALF, base + 4, sizeof (Rgba), sizeof (Rgba) * W));
+	    fb.insert ("A", Slice (HALF, base + 6, sizeof (Rgba), sizeof (Rgba) * W));
+
+	    if (i & 1)
+	    {
+		TiledOutputPart part (out, i);
+		part.setFrameBuffer (fb);
+		part.writeTiles (0, part.numXTiles() - 1, 0, part.numYTiles() - 1);
+	    }
+	    else
+	    {
+		OutputPart part (out, i);
+		part.setFrameBuffer (fb);
+		part.writePixels (H);
+	    }
+	}
+    }
+}
+
+
+void
+readPart (MultiPartInputFile &in, int i, Array2D<Rgba> &p)
+{
+    char *base = (char *) &p[0][0];
+
+    FrameBuffer fb;
+    fb.insert ("R", Slice (HALF, base + 0, sizeof (Rgba), sizeof (Rgba) * W));
+    fb.insert ("G", Slice (HALF, base + 2, sizeof (Rgba), sizeof (Rgba) * W));
+    fb.insert ("B", Slice (HALF, base + 4, sizeof (Rgba), sizeof (Rgba) * W));
+    fb.insert ("A", Slice (HALF, base + 6, sizeof (Rgba), sizeof (Rgba) * W));
+
+    if (i & 1)
+    {
+	TiledInputPart part (in, i);
+	part.setFrameBuffer (fb);
+	part.readTiles (0, part.numXTiles() - 1, 0, part.numYTiles() - 1);
+    }
+    else
+    {
+	InputPart part (in, i);
+	part.setFrameBuffer (fb);
+	part.readPixels (0, H - 1);
+    }
+}
+
+
+void
+readFiles (const std::string &tempDir, const Array2D<Rgba> &p1,
+	   const Array2D<Rgba> &p2, bool allowReadAt)
+{
+    cout << "reading files, positional reads " <<
+	    (allowReadAt? "on": "off") << endl;
+
+    std::string scanLineName = tempDir + "imf_test_read_at_scanline.exr";
+    std::string tiledName = tempDir + "imf_test_read_at_tiled.exr";
+    std::string multiPartName = tempDir + "imf_test_read_at_multipart.exr";
+
+    Array2D<Rgba> p (H, W);
+
+    {
+	FileIStream file (scanLineName.c_str());
+	CountingIStream is (file, allowReadAt);
+	RgbaInputFile in (is);
+
+	in.setFrameBuffer (&p[0][0], 1, W);
+	is.reads = 0;
+	in.readPixels (0, H - 1);
+	comparePixels (p, p1, W, H);
+
+	if (is.supportsReadAt())
+	    assert (is.reads == 0 && is.readAts > 0);
+	else
+	    assert (is.reads > 0 && is.readAts == 0);
+    }
+
+    {
+	FileIStream file (tiledName.c_str());
+	CountingIStream is (file, allowReadAt);
+	TiledRgbaInputFile in (is);
+
+	in.setFrameBuffer (&p[0][0], 1, W);
+	is.reads = 0;
+	in.readTiles (0, in.numXTiles() - 1, 0, in.numYTiles() - 1);
+	comparePixels (p, p1, W, H);
+
+	if (is.supportsReadAt())
+	    assert (is.reads == 0 && is.readAts > 0);
+	else
+	    assert (is.reads > 0 && is.readAts == 0);
+    }
+
+    {
+	//
+	// Read the parts of a multi-part file in
+	// several threads at once.
+	//
+
+	FileIStream file (multiPartName.c_str());
+	CountingIStream is (file, allowReadAt);
+	MultiPartInputFile in (is);
+
+	Array2D<Rgba> q[4];
+	vector<std::thread> threads;
+
+	for (int i = 0; i < 4; ++i)
+	{
+	    q[i].resizeErase (H, W);
+	    threads.push_back (std::thread (readPart, std::ref (in), i,
+					    std::ref (q[i])));
+	}
+
+	for (size_t i = 0; i < threads.size(); ++i)
+	    threads[i].join();
+
+	for (int i = 0; i < 4; ++i)
+	    comparePixels (q[i], (i & 2)? p2: p1, W, H);
+
+	if (is.supportsReadAt())
+	    assert (is.readAts > 0);
+	else
+	    assert (is.readAts == 0);
+    }
+}
+
+} // namespace
+
+
+void
+testReadAt (const std::string &tempDir)
+{
+    try
+    {
+	cout << "Testing positional reads" << endl;
+
+	testPosixIFStream (tempDir);
+	testStdIFStream (tempDir);
+
+	Array2D<Rgba> p1 (H, W);
+	Array2D<Rgba> p2 (H, W);
+	fillPixels (p1, W, H, 0);
+	fillPixels (p2, W, H, 5);
+
+	writeFiles (tempDir, p1, p2);
+	readFiles (tempDir, p1, p2, true);
+	readFiles (tempDir, p1, p2, false);
+
+	remove ((tempDir + "imf_test_read_at_scanline.exr").c_str());
+	remove ((tempDir + "imf_test_read_at_tiled.exr").c_str());
+	remove ((tempDir + "imf_test_read_at_multipart.exr").c_str());
+
+	cout << "ok\n" << endl;
+    }
+    catch (const std::exception &e)
+    {
+	cerr << "ERROR -- caught exception: " << e.what() << endl;
+	assert (false);
+    }
+}
@@ -0,0 +1,168 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <IlmThreadConfig.h>
+#include <IlmThreadPool.h>
+
+#include <assert.h>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace ILMTHREAD_NAMESPACE;
+using namespace std;
+
+namespace {
+
+class CountTask : public Task
+{
+  public:
+
+    CountTask (TaskGroup *group, atomic<int> &count)
+        : Task (group), _count (count)
+    {
+    }
+
+    void execute () override
+    {
+        ++_count;
+    }
+
+  private:
+
+    atomic<int> &_count;
+};
+
+//
+// Adds more tasks to the same group from within a worker, so they
+// end up in the queue of that worker (or are stolen from it)
+//
+class SpawnTask : public Task
+{
+  public:
+
+    SpawnTask (TaskGroup *group, ThreadPool &pool, atomic<int> &count,
+               int depth)
+        : Task (group), _pool (pool), _count (count), _depth (depth)
+    {
+    }
+
+    void execute () override
+    {
+        ++_count;
+        if (_depth > 0)
+        {
+            for (int i = 0; i < 4; ++i)
+                _pool.addTask (
+                    new SpawnTask (_group, _pool, _count, _depth - 1));
+        }
+    }
+
+  private:
+
+    ThreadPool  &_pool;
+    atomic<int> &_count;
+    int          _depth;
+};
+
+
+void
+runTasks (ThreadPool &pool, int numTasks)
+{
+    atomic<int> count (0);
+    {
+        TaskGroup group;
+        for (int i = 0; i < numTasks; ++i)
+            pool.addTask (new CountTask (&group, count));
+    }
+    assert (count == numTasks);
+}
+
+
+void
+runNestedTasks (ThreadPool &pool)
+{
+    // 1 + 4 + 16 + 64 + 256 tasks
+    atomic<int> count (0);
+    {
+        TaskGroup group;
+        pool.addTask (new SpawnTask (&group, pool, count, 4));
+    }
+    assert (count == 341);
+}
+
+} // namespace
+
+
+void
+testThreadPool (const string&)
+{
+    cout << "Testing thread pool" << endl;
+
+    try
+    {
+        for (int nthreads: { 0, 1, 3, 8 })
+        {
+            cout << "   " << nthreads << " threads" << endl;
+
+            ThreadPool pool (nthreads);
+#if ILMTHREAD_THREADING_ENABLED
+            assert (pool.numThreads () == nthreads);
+#endif
+
+            runTasks (pool, 1);
+            runTasks (pool, 10000);
+            runNestedTasks (pool);
+        }
+
+        cout << "   changing thread count" << endl;
+
+        ThreadPool pool (2);
+        runTasks (pool, 1000);
+        pool.setNumThreads (6);
+#if ILMTHREAD_THREADING_ENABLED
+        assert (pool.numThreads () == 6);
+#endif
+        runTasks (pool, 1000);
+        runNestedTasks (pool);
+        pool.setNumThreads (1);
+#if ILMTHREAD_THREADING_ENABLED
+        assert (pool.numThreads () == 1);
+#endif
+        runTasks (pool, 1000);
+        pool.setNumThreads (0);
+        assert (pool.numThreads () == 0);
+        runTasks (pool, 1000);
+        pool.setNumThreads (4);
+        runNestedTasks (pool);
+
+#if ILMTHREAD_THREADING_ENABLED
+        cout << "   adding threads while adding tasks" << endl;
+
+        ThreadPool growing (1);
+        thread adder ([&growing] {
+            for (int i = 0; i < 20; ++i)
+                runTasks (growing, 1000);
+        });
+        for (int nthreads = 2; nthreads <= 16; ++nthreads)
+            growing.setNumThreads (nthreads);
+        adder.join ();
+        assert (growing.numThreads () == 16);
+        runNestedTasks (growing);
+#endif
+    }
+    catch (const exception &e)
+    {
+        cout << "unexpected exception: " << e.what () << endl;
+        assert (false);
+    }
+
+    cout << "ok\n" << endl;
+}
@@ -0,0 +1,377 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <ImfTiledOutputFile.h>
+#include <ImfTiledInputFile.h>
+#include <ImfTiledInputPart.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfTileCache.h>
+#include <ImfArray.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfThreading.h>
+#include <half.h>
+
+#include <vector>
+#include <stdio.h>
+#include <math.h>
+#include <assert.h>
+
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+using namespace IMATH_NAMESPACE;
+
+
+namespace {
+
+const int W = 117;
+const int H = 95;
+const int TX = 16;
+const int TY = 16;
+
+
+//
+// The pixels of all levels of a mipmapped file with
+// a HALF channel, "H", and a FLOAT channel, "F".
+//
+
+struct Levels
+{
+    vector< Array2D<half> * >	h;
+    vector< Array2D<float> * >	hf;	// "H", converted to FLOAT
+    vector< Array2D<float> * >	f;
+
+    ~Levels ()
+    {
+	for (size_t i = 0; i < h.size(); ++i)
+	{
+	    delete h[i];
+	    delete hf[i];
+	    delete f[i];
+	}
+    }
+};
+
+
+void
+writeFile (const char fileName[], Compression comp)
+{
+    Header hdr (W, H);
+    hdr.compression() = comp;
+    hdr.channels().insert ("H", Channel (HALF));
+    hdr.channels().insert ("F", Channel (FLOAT));
+    hdr.setTileDescription (TileDescription (TX, TY, MIPMAP_LEVELS));
+
+    remove (fileName);
+    TiledOutputFile out (fileName, hdr);
+
+    for (int l = 0; l < out.numLevels(); ++l)
+    {
+	int w = out.levelWidth (l);
+	int h = out.levelHeight (l);
+
+	Array2D<half> ph (h, w);
+	Array2D<float> pf (h, w);
+
+	for (int y = 0; y < h; ++y)
+	{
+	    for (int x = 0; x < w; ++x)
+	    {
+		ph[y][x] = sin (x * 0.3 + l) + cos (y * 0.2);
+		pf[y][x] = x * 1000 + y + l * 0.25f;
+	    }
+	}
+
+	FrameBuffer fb;
+
+	fb.insert ("H", Slice (HALF,
+			       (char *) &ph[0][0],
+			       sizeof (ph[0][0]),
+			       sizeof (ph[0][0]) * w));
+
+	fb.insert ("F", Slice (FLOAT,
+			       (char *) &pf[0][0],
+			       sizeof (pf[0][0]),
+			       sizeof (pf[0][0]) * w));
+
+	out.setFrameBuffer (fb);
+	out.writeTiles (0, out.numXTiles (l) - 1, 0, out.numYTiles (l) - 1, l);
+    }
+}
+
+
+int
+numTiles (TiledInputFile &in)
+{
+    int n = 0;
+
+    for (int l = 0; l < in.numLevels(); ++l)
+	n += in.numXTiles (l) * in.numYTiles (l);
+
+    return n;
+}
+
+
+template <class File>
+void
+readLevels (File &in, Levels &levels)
+{
+    for (int l = 0; l < in.numLevels(); ++l)
+    {
+	int w = in.levelWidth (l);
+	int h = in.levelHeight (l);
+
+	levels.h.push_back (new Array2D<half> (h, w));
+	levels.hf.push_back (new Array2D<float> (h, w));
+	levels.f.push_back (new Array2D<float> (h, w));
+
+	Array2D<half> &ph = *levels.h.back();
+	Array2D<float> &phf = *levels.hf.back();
+	Array2D<float> &pf = *levels.f.back();
+
+	//
+	// Read each level twice, once with "H" as HALF and once
+	// with "H" converted to FLOAT, so that the second read
+	// finds the tiles of the level in the cache, if there is one.
+	//
+
+	FrameBuffer fb;
+
+	fb.insert ("H", Slice (HALF,
+			       (char *) &ph[0][0],
+			       sizeof (ph[0][0]),
+			       sizeof (ph[0][0]) * w));
+
+	fb.insert ("F", Slice (FLOAT,
+			       (char *) &pf[0][0],
+			       sizeof (pf[0][0]),
+			       sizeof (pf[0][0]) * w));
+
+	in.setFrameBuffer (fb);
+	in.readTiles (0, in.numXTiles (l) - 1, 0, in.numYTiles (l) - 1, l);
+
+	FrameBuffer fbf;
+
+	fbf.insert ("H", Slice (FLOAT,
+				(char *) &phf[0][0],
+				sizeof (phf[0][0]),
+				sizeof (phf[0][0]) * w));
+
+	in.setFrameBuffer (fbf);
+
+	for (int dy = 0; dy < in.numYTiles (l); ++dy)
+	    for (int dx = 0; dx < in.numXTiles (l); ++dx)
+		in.readTile (dx, dy, l);
+    }
+}
+
+
+void
+compareLevels (const Levels &a, const Levels &b)
+{
+    assert (a.h.size() == b.h.size());
+
+    for (size_t l = 0; l < a.h.size(); ++l)
+    {
+	const Array2D<half> &ah = *a.h[l];
+	const Array2D<half> &bh = *b.h[l];
+
+	for (long y = 0; y < ah.height(); ++y)
+	{
+	    for (long x = 0; x < ah.width(); ++x)
+	    {
+		assert (ah[y][x].bits() == bh[y][x].bits());
+		assert ((*a.hf[l])[y][x] == float (ah[y][x]));
+		assert ((*b.hf[l])[y][x] == float (bh[y][x]));
+		assert ((*a.f[l])[y][x] == (*b.f[l])[y][x]);
+	    }
+	}
+    }
+}
+
+
+void
+testCompression (const std::string &tempDir, Compression comp)
+{
+    cout << "compression " << comp << endl;
+
+    std::string fileName = tempDir + "imf_test_tile_cache.exr";
+    writeFile (fileName.c_str(), comp);
+
+    //
+    // Read the file without a cache.
+    //
+
+    Levels ref;
+
+    {
+	TiledInputFile in (fileName.c_str());
+	assert (in.tileCache() == 0);
+	readLevels (in, ref);
+    }
+
+    //
+    // Read the file with a cache that is big enough for all tiles:
+    // each tile is a miss the first time it is read, and a hit from
+    // then on.
+    //
+
+    TileCache cache (64 << 20);
+
+    {
+	TiledInputFile in (fileName.c_str());
+	in.setTileCache (&cache);
+	assert (in.tileCache() == &cache);
+
+	int n = numTiles (in);
+
+	Levels levels;
+	readLevels (in, levels);
+	compareLevels (ref, levels);
+
+	TileCache::Statistics s = cache.statistics();
+	assert (s.misses == uint64_t (n));
+	assert (s.hits == uint64_t (n));
+	assert (s.evictions == 0);
+	assert (s.numTiles == size_t (n));
+	assert (s.bytes > 0 && s.bytes <= cache.maxBytes());
+
+	Levels levels2;
+	readLevels (in, levels2);
+	compareLevels (ref, levels2);
+
+	s = cache.statistics();
+	assert (s.misses == uint64_t (n));
+	assert (s.hits == uint64_t (3 * n));
+
+	//
+	// A second file shares the cache, but not the tiles
+	// of the first file.  Destroying it, or switching
+	// its cache off, removes its tiles from the cache.
+	//
+
+	size_t bytes = s.bytes;
+
+	{
+	    TiledInputFile in2 (fileName.c_str());
+	    in2.setTileCache (&cache);
+
+	    Levels levels3;
+	    readLevels (in2, levels3);
+	    compareLevels (ref, levels3);
+
+	    s = cache.statistics();
+	    assert (s.misses == uint64_t (2 * n));
+	    assert (s.numTiles == size_t (2 * n));
+	    assert (s.bytes == 2 * bytes);
+	}
+
+	s = cache.statistics();
+	assert (s.numTiles == size_t (n));
+	assert (s.bytes == bytes);
+
+	{
+	    MultiPartInputFile mpf (fileName.c_str());
+	    TiledInputPart part (mpf, 0);
+	    part.setTileCache (&cache);
+	    assert (part.tileCache() == &cache);
+
+	    Levels levels4;
+	    readLevels (part, levels4);
+	    compareLevels (ref, levels4);
+	    assert (cache.statistics().numTiles == size_t (2 * n));
+
+	    part.setTileCache (0);
+	    assert (part.tileCache() == 0);
+	    assert (cache.statistics().numTiles == size_t (n));
+	}
+
+	//
+	// Shrink the cache to a few tiles.  Reading evicts the least
+	// recently used tiles, but returns the same pixels.
+	//
+
+	cache.resetStatistics();
+	cache.setMaxBytes (bytes / n * 5);
+
+	s = cache.statistics();
+	assert (s.bytes <= cache.maxBytes());
+	assert (s.evictions > 0);
+
+	Levels levels5;
+	readLevels (in, levels5);
+	compareLevels (ref, levels5);
+
+	s = cache.statistics();
+	assert (s.bytes <= cache.maxBytes());
+	assert (s.hits + s.misses == uint64_t (2 * n));
+	assert (s.misses > 0);
+
+	//
+	// Tiles that are bigger than the budget are not cached.
+	//
+
+	cache.clear();
+	cache.setMaxBytes (1);
+
+	Levels levels6;
+	readLevels (in, levels6);
+	compareLevels (ref, levels6);
+
+	s = cache.statistics();
+	assert (s.numTiles == 0);
+	assert (s.bytes == 0);
+
+	cache.setMaxBytes (64 << 20);
+    }
+
+    //
+    // The file removed its tiles from the cache when it was destroyed.
+    //
+
+    assert (cache.statistics().numTiles == 0);
+
+    remove (fileName.c_str());
+}
+
+} // namespace
+
+
+void
+testTileCache (const std::string &tempDir)
+{
+    try
+    {
+	cout << "Testing the tile cache" << endl;
+
+	int numThreads = globalThreadCount();
+
+	for (int threads = 0; threads <= 4; threads += 4)
+	{
+	    cout << threads << " threads" << endl;
+	    setGlobalThreadCount (threads);
+
+	    testCompression (tempDir, NO_COMPRESSION);
+	    testCompression (tempDir, ZIP_COMPRESSION);
+	    testCompression (tempDir, PIZ_COMPRESSION);
+	    testCompression (tempDir, PXR24_COMPRESSION);
+	}
+
+	setGlobalThreadCount (numThreads);
+
+	cout << "ok\n" << endl;
+    }
+    catch (const std::exception &e)
+    {
+	cerr << "ERROR -- caught exception: " << e.what() << endl;
+	assert (false);
+    }
+}
@@ -150,6 +150,103 @@ maxValue (const Array2D <unsigned short> &a, int nx, int ny)
 }
 
 
+//
+// Reference versions of the basis functions and of the encoder,
+// one 2x2 block at a time, to check that the optimized wav2Encode()
+// still produces exactly the same coefficients.
+//
+
+void
+refEnc14 (unsigned short a, unsigned short b,
+	  unsigned short &l, unsigned short &h)
+{
+    short as = a;
+    short bs = b;
+
+    l = (short) ((as + bs) >> 1);
+    h = (short) (as - bs);
+}
+
+
+void
+refEnc16 (unsigned short a, unsigned short b,
+	  unsigned short &l, unsigned short &h)
+{
+    int ao = (a + 0x8000) & 0xffff;
+    int m  = (ao + b) >> 1;
+    int d  = ao - b;
+
+    if (d < 0)
+	m = (m + 0x8000) & 0xffff;
+
+    l = m;
+    h = d & 0xffff;
+}
+
+
+void
+refEnc (unsigned short a, unsigned short b,
+	unsigned short &l, unsigned short &h, bool w14)
+{
+    if (w14)
+	refEnc14 (a, b, l, h);
+    else
+	refEnc16 (a, b, l, h);
+}
+
+
+void
+refEncode (unsigned short *in, int nx, int ox, int ny, int oy,
+	   unsigned short mx)
+{
+    bool w14 = (mx < (1 << 14));
+    int n = (nx > ny)? ny: nx;
+
+    for (int p = 1, p2 = 2; p2 <= n; p = p2, p2 <<= 1)
+    {
+	int y = 0;
+
+	for (; y + p2 <= ny; y += p2)
+	{
+	    int x = 0;
+
+	    for (; x + p2 <= nx; x += p2)
+	    {
+		unsigned short *p00 = in + y * oy + x * ox;
+		unsigned short *p01 = p00 + ox * p;
+		unsigned short *p10 = p00 + oy * p;
+		unsigned short *p11 = p10 + ox * p;
+		unsigned short i00,i01,i10,i11;
+
+		refEnc (*p00, *p01, i00, i01, w14);
+		refEnc (*p10, *p11, i10, i11, w14);
+		refEnc (i00, i10, *p00, *p10, w14);
+		refEnc (i01, i11, *p01, *p11, w14);
+	    }
+
+	    if (nx & p)
+	    {
+		unsigned short *p00 = in + y * oy + x * ox;
+		unsigned short *p10 = p00 + oy * p;
+
+		refEnc (*p00, *p10, *p00, *p10, w14);
+	    }
+	}
+
+	if (ny & p)
+	{
+	    for (int x = 0; x + p2 <= nx; x += p2)
+	    {
+		unsigned short *p00 = in + y * oy + x * ox;
+		unsigned short *p01 = p00 + ox * p;
+
+		refEnc (*p00, *p01, *p00, *p01, w14);
+	    }
+	}
+    }
+}
+
+
 void
 wavEncodeDecode (Array2D <unsigned short> &a,
 		 const Array2D <unsigned short> &b,
@@ -160,7 +257,18 @@ wavEncodeDecode (Array2D <unsigned short> &a,
 
     //cout << "encoding " << flush;
 
+    Array2D <unsigned short> r (ny, nx);
+
+    for (int y = 0; y < ny; ++y)
+	for (int x = 0; x < nx; ++x)
+	    r[y][x] = a[y][x];
+
     wav2Encode (&a[0][0], nx, 1, ny, nx, mx);
+    refEncode (&r[0][0], nx, 1, ny, nx, mx);
+
+    for (int y = 0; y < ny; ++y)
+	for (int x = 0; x < nx; ++x)
+	    assert (a[y][x] == r[y][x]);
 
     //cout << "decoding " << flush;
 
@@ -232,6 +340,48 @@ test (int nx, int ny)
     wavEncodeDecode (a, b, nx, ny);
 }
 
+
+//
+// Two channels interleaved in one buffer, the way the PIZ
+// compressor transforms the two halves of 32-bit values
+//
+
+void
+testInterleaved (int nx, int ny)
+{
+    cout << nx << " x " << ny << " interleaved" << endl;
+
+    Array2D<unsigned short> a (ny, 2 * nx);
+    Array2D<unsigned short> b (ny, 2 * nx);
+    Array2D<unsigned short> r (ny, 2 * nx);
+
+    IMATH_NAMESPACE::Rand48 rand48 (0);
+
+    for (int mask = 0x3fff; mask <= 0xffff; mask = (mask << 2) | 3)
+    {
+	for (int y = 0; y < ny; ++y)
+	    for (int x = 0; x < 2 * nx; ++x)
+		a[y][x] = b[y][x] = r[y][x] = rand48.nexti() & mask;
+
+	for (int c = 0; c < 2; ++c)
+	{
+	    wav2Encode (&a[0][c], nx, 2, ny, 2 * nx, mask);
+	    refEncode (&r[0][c], nx, 2, ny, 2 * nx, mask);
+	}
+
+	for (int y = 0; y < ny; ++y)
+	    for (int x = 0; x < 2 * nx; ++x)
+		assert (a[y][x] == r[y][x]);
+
+	for (int c = 0; c < 2; ++c)
+	    wav2Decode (&a[0][c], nx, 2, ny, 2 * nx, mask);
+
+	for (int y = 0; y < ny; ++y)
+	    for (int x = 0; x < 2 * nx; ++x)
+		assert (a[y][x] == b[y][x]);
+    }
+}
+
 } // namespace
 
 
@@ -252,6 +402,13 @@ testWav (const std::string&)
 	test (1024, 1024);
 	test (997, 997);
 
+	testInterleaved (1, 1);
+	testInterleaved (2, 2);
+	testInterleaved (33, 17);
+	testInterleaved (1024, 16);
+	testInterleaved (997, 37);
+	testInterleaved (37, 997);
+
 	cout << "ok\n" << endl;
     }
     catch (const std::exception &e)
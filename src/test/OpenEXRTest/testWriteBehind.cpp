@@ -0,0 +1,533 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <ImfOutputFile.h>
+#include <ImfInputFile.h>
+#include <ImfTiledOutputFile.h>
+#include <ImfTiledInputFile.h>
+#include <ImfMultiPartOutputFile.h>
+#include <ImfMultiPartInputFile.h>
+#include <ImfOutputPart.h>
+#include <ImfInputPart.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfPartType.h>
+#include <ImfStdIO.h>
+#include <ImfArray.h>
+#include <ImfThreading.h>
+#include "Iex.h"
+#include <half.h>
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <assert.h>
+
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+using namespace IMATH_NAMESPACE;
+
+
+namespace {
+
+const int W = 143;
+const int H = 119;
+const int TX = 16;
+const int TY = 16;
+
+
+//
+// An in-memory stream that fails once more than a given
+// number of bytes have been written to it.
+//
+
+class FailingOStream: public OStream
+{
+  public:
+
+    FailingOStream (uint64_t limit):
+	OStream ("failing stream"),
+	_limit (limit)
+    {
+	// empty
+    }
+
+    virtual void
+    write (const char c[], int n)
+    {
+	if (_os.tellp() + n > _limit)
+	    throw IEX_NAMESPACE::IoExc ("Disk full.");
+
+	_os.write (c, n);
+    }
+
+    virtual uint64_t	tellp ()		{return _os.tellp();}
+    virtual void	seekp (uint64_t pos)	{_os.seekp (pos);}
+
+  private:
+
+    StdOSStream		_os;
+    uint64_t		_limit;
+};
+
+
+struct Image
+{
+    Array2D<half>	h;
+    Array2D<float>	f;
+
+    Image (int w, int h, int seed);
+
+    void		insert (FrameBuffer &fb);
+};
+
+
+Image::Image (int width, int height, int seed):
+    h (height, width),
+    f (height, width)
+{
+    for (int y = 0; y < height; ++y)
+    {
+	for (int x = 0; x < width; ++x)
+	{
+	    h[y][x] = (x * 7 + y * 3 + seed) % 101 / 100.0f;
+	    f[y][x] = x * 1000 + y + seed * 0.25f;
+	}
+    }
+}
+
+
+void
+Image::insert (FrameBuffer &fb)
+{
+    fb.insert ("H", Slice (HALF,
+			   (char *) &h[0][0],
+			   sizeof (h[0][0]),
+			   sizeof (h[0][0]) * h.width()));
+
+    fb.insert ("F", Slice (FLOAT,
+			   (char *) &f[0][0],
+			   sizeof (f[0][0]),
+			   sizeof (f[0][0]) * f.width()));
+}
+
+
+void
+compareImages (const Image &a, const Image &b)
+{
+    assert (a.h.height() == b.h.height() && a.h.width() == b.h.width());
+
+    for (long y = 0; y < a.h.height(); ++y)
+    {
+	for (long x = 0; x < a.h.width(); ++x)
+	{
+	    assert (a.h[y][x].bits() == b.h[y][x].bits());
+	    assert (a.f[y][x] == b.f[y][x]);
+	}
+    }
+}
+
+
+Header
+makeHeader (Compression comp, LineOrder order)
+{
+    Header hdr (W, H);
+    hdr.compression() = comp;
+    hdr.lineOrder() = order;
+    hdr.channels().insert ("H", Channel (HALF));
+    hdr.channels().insert ("F", Channel (FLOAT));
+    return hdr;
+}
+
+
+string
+writeScanLines (const Header &hdr, Image &img, size_t maxBytes)
+{
+    StdOSStream os;
+
+    {
+	OutputFile out (os, hdr);
+	assert (out.writeBehind() == 0);
+	assert (out.pendingWriteBytes() == 0);
+
+	out.setWriteBehind (maxBytes);
+	assert (out.writeBehind() == maxBytes);
+
+	FrameBuffer fb;
+	img.insert (fb);
+	out.setFrameBuffer (fb);
+
+	//
+	// Write a few scan lines at a time, and turn write-behind
+	// off and on again half way through the image.
+	//
+
+	for (int n = 0; n < H; n += 7)
+	{
+	    if (maxBytes > 0 && n == 56)
+	    {
+		out.setWriteBehind (0);
+		assert (out.writeBehind() == 0);
+		assert (out.pendingWriteBytes() == 0);
+		out.setWriteBehind (maxBytes);
+	    }
+
+	    out.writePixels (min (7, H - n));
+	}
+
+	out.flush();
+	assert (out.pendingWriteBytes() == 0);
+    }
+
+    return os.str();
+}
+
+
+void
+readScanLines (const string &data, Image &img)
+{
+    StdISStream is;
+    is.str (data);
+
+    InputFile in (is);
+    assert (in.isComplete());
+
+    FrameBuffer fb;
+    img.insert (fb);
+    in.setFrameBuffer (fb);
+    in.readPixels (0, H - 1);
+}
+
+
+void
+testScanLines (Compression comp, LineOrder order)
+{
+    cout << "scan lines, compression " << comp << ", "
+	    "line order " << order << endl;
+
+    Header hdr = makeHeader (comp, order);
+    Image img (W, H, 3);
+
+    //
+    // With write-behind, the file contains exactly the
+    // same bytes as without, whatever the queue's limit.
+    //
+
+    string ref = writeScanLines (hdr, img, 0);
+
+    size_t limits[] = {1, 4096, 64 << 20};
+
+    for (size_t i = 0; i < sizeof (limits) / sizeof (limits[0]); ++i)
+	assert (writeScanLines (hdr, img, limits[i]) == ref);
+
+    Image img2 (W, H, 0);
+    readScanLines (ref, img2);
+    compareImages (img, img2);
+}
+
+
+string
+writeTiles (const Header &hdr, size_t maxBytes, bool reverse)
+{
+    StdOSStream os;
+
+    {
+	TiledOutputFile out (os, hdr);
+	out.setWriteBehind (maxBytes);
+
+	for (int l = 0; l < out.numLevels(); ++l)
+	{
+	    Image img (out.levelWidth (l), out.levelHeight (l), l);
+
+	    FrameBuffer fb;
+	    img.insert (fb);
+	    out.setFrameBuffer (fb);
+
+	    //
+	    // Writing the tiles of a level in reverse order makes the
+	    // file hold tiles back until the tiles before them are written.
+	    //
+
+	    if (reverse)
+	    {
+		for (int dy = out.numYTiles (l) - 1; dy >= 0; --dy)
+		    for (int dx = out.numXTiles (l) - 1; dx >= 0; --dx)
+			out.writeTile (dx, dy, l);
+	    }
+	    else
+	    {
+		out.writeTiles (0, out.numXTiles (l) - 1,
+				0, out.numYTiles (l) - 1, l);
+	    }
+	}
+
+	//
+	// The tiles are queued or in the file; writing
+	// one of them again is an error.
+	//
+
+	try
+	{
+	    out.writeTile (0, 0, 0);
+	    assert (false);
+	}
+	catch (const IEX_NAMESPACE::ArgExc &)
+	{
+	    // expected
+	}
+
+	out.flush();
+	assert (out.pendingWriteBytes() == 0);
+    }
+
+    return os.str();
+}
+
+
+void
+testTiles (Compression comp, LineOrder order)
+{
+    cout << "tiles, compression " << comp << ", "
+	    "line order " << order << endl;
+
+    Header hdr = makeHeader (comp, order);
+    hdr.setTileDescription (TileDescription (TX, TY, MIPMAP_LEVELS));
+
+    string ref = writeTiles (hdr, 0, false);
+
+    for (int reverse = 0; reverse <= 1; ++reverse)
+    {
+	string data = writeTiles (hdr, 4096, reverse);
+
+	//
+	// With RANDOM_Y, the tiles are stored in the order in which
+	// they are written, and writing them in a different order
+	// produces a different, but equivalent file.
+	//
+
+	if (order != RANDOM_Y || !reverse)
+	    assert (data == ref);
+
+	StdISStream is;
+	is.str (data);
+	TiledInputFile in (is);
+	assert (in.isComplete());
+
+	for (int l = 0; l < in.numLevels(); ++l)
+	{
+	    Image img (in.levelWidth (l), in.levelHeight (l), l);
+	    Image img2 (in.levelWidth (l), in.levelHeight (l), 0);
+
+	    FrameBuffer fb;
+	    img2.insert (fb);
+	    in.setFrameBuffer (fb);
+	    in.readTiles (0, in.numXTiles (l) - 1, 0, in.numYTiles (l) - 1, l);
+
+	    compareImages (img, img2);
+	}
+    }
+}
+
+
+void
+testMultiPart (const std::string &tempDir)
+{
+    cout << "multi-part file" << endl;
+
+    std::string fileName = tempDir + "imf_test_write_behind.exr";
+
+    vector<Header> headers;
+
+    for (int i = 0; i < 3; ++i)
+    {
+	Header hdr = makeHeader (ZIP_COMPRESSION, INCREASING_Y);
+	hdr.setName ("part" + to_string (i));
+	hdr.setType (SCANLINEIMAGE);
+	headers.push_back (hdr);
+    }
+
+    vector<Image *> images;
+
+    for (int i = 0; i < 3; ++i)
+	images.push_back (new Image (W, H, i * 10));
+
+    {
+	MultiPartOutputFile out (fileName.c_str(), &headers[0], 3);
+
+	vector<OutputPart> parts;
+
+	for (int i = 0; i < 3; ++i)
+	{
+	    parts.push_back (OutputPart (out, i));
+	    parts[i].setWriteBehind (1 << 14);
+	    assert (parts[i].writeBehind() == 1 << 14);
+
+	    FrameBuffer fb;
+	    images[i]->insert (fb);
+	    parts[i].setFrameBuffer (fb);
+	}
+
+	//
+	// Interleave the scan lines of the parts; the parts' write-behind
+	// tasks share the file.  The last part is not flushed explicitly.
+	//
+
+	for (int n = 0; n < H; n += 5)
+	    for (int i = 0; i < 3; ++i)
+		parts[i].writePixels (min (5, H - n));
+
+	parts[0].flush();
+	parts[1].flush();
+	assert (parts[0].pendingWriteBytes() == 0);
+    }
+
+    {
+	MultiPartInputFile in (fileName.c_str());
+
+	for (int i = 0; i < 3; ++i)
+	{
+	    InputPart part (in, i);
+	    Image img (W, H, 0);
+
+	    FrameBuffer fb;
+	    img.insert (fb);
+	    part.setFrameBuffer (fb);
+	    part.readPixels (0, H - 1);
+
+	    compareImages (*images[i], img);
+	}
+    }
+
+    for (int i = 0; i < 3; ++i)
+	delete images[i];
+
+    remove (fileName.c_str());
+}
+
+
+void
+testWriteError ()
+{
+    cout << "write errors" << endl;
+
+    Header hdr = makeHeader (NO_COMPRESSION, INCREASING_Y);
+    Image img (W, H, 1);
+
+    //
+    // The stream fails after the header and a few scan lines.
+    //
+
+    FailingOStream os (4096);
+
+    {
+	OutputFile out (os, hdr);
+	out.setWriteBehind (1 << 20);
+
+	FrameBuffer fb;
+	img.insert (fb);
+	out.setFrameBuffer (fb);
+
+	//
+	// Depending on how far the write-behind task got, the error
+	// is reported by writePixels() or by flush(), and then again
+	// by every subsequent flush().
+	//
+
+	try
+	{
+	    out.writePixels (H / 2);
+	    out.writePixels (H - H / 2);
+	    out.flush();
+	    assert (false);
+	}
+	catch (const IEX_NAMESPACE::IoExc &e)
+	{
+	    assert (string (e.what()).find ("Disk full.") != string::npos);
+	}
+
+	try
+	{
+	    out.flush();
+	    assert (false);
+	}
+	catch (const IEX_NAMESPACE::IoExc &)
+	{
+	    // expected
+	}
+
+	//
+	// The destructor does not throw.
+	//
+    }
+
+    Header thdr = hdr;
+    thdr.setTileDescription (TileDescription (TX, TY, ONE_LEVEL));
+
+    FailingOStream tos (4096);
+
+    {
+	TiledOutputFile out (tos, thdr);
+	out.setWriteBehind (1 << 20);
+
+	FrameBuffer fb;
+	img.insert (fb);
+	out.setFrameBuffer (fb);
+
+	try
+	{
+	    out.writeTiles (0, out.numXTiles() - 1, 0, out.numYTiles() - 1);
+	    out.flush();
+	    assert (false);
+	}
+	catch (const IEX_NAMESPACE::IoExc &e)
+	{
+	    assert (string (e.what()).find ("Disk full.") != string::npos);
+	}
+    }
+}
+
+} // namespace
+
+
+void
+testWriteBehind (const std::string &tempDir)
+{
+    try
+    {
+	cout << "Testing write-behind for scan line and tiled output" << endl;
+
+	int numThreads = globalThreadCount();
+
+	for (int threads = 0; threads <= 4; threads += 4)
+	{
+	    cout << threads << " threads" << endl;
+	    setGlobalThreadCount (threads);
+
+	    testScanLines (NO_COMPRESSION, INCREASING_Y);
+	    testScanLines (ZIP_COMPRESSION, INCREASING_Y);
+	    testScanLines (PIZ_COMPRESSION, DECREASING_Y);
+	    testTiles (NO_COMPRESSION, INCREASING_Y);
+	    testTiles (ZIP_COMPRESSION, DECREASING_Y);
+	    testTiles (PIZ_COMPRESSION, RANDOM_Y);
+	    testMultiPart (tempDir);
+	    testWriteError();
+	}
+
+	setGlobalThreadCount (numThreads);
+
+	cout << "ok\n" << endl;
+    }
+    catch (const std::exception &e)
+    {
+	cerr << "ERROR -- caught exception: " << e.what() << endl;
+	assert (false);
+    }
+}
@@ -0,0 +1,126 @@
+//
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright (c) Contributors to the OpenEXR Project.
+//
+
+#ifdef NDEBUG
+#    undef NDEBUG
+#endif
+
+#include <ImfZip.h>
+#include "ImathRandom.h"
+#include <iostream>
+#include <exception>
+#include <string.h>
+#include <assert.h>
+#include <vector>
+
+//
+// Checks the SIMD byte reordering / predictor used by the ZIP and RLE
+// compressors against the original scalar loops, for sizes around all
+// of the vector widths and odd lengths.
+//
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace std;
+
+
+namespace {
+
+void
+referenceReorderAndPredict (const char *raw, size_t size, char *out)
+{
+    char *t1 = out;
+    char *t2 = out + (size + 1) / 2;
+    const char *stop = raw + size;
+
+    while (true)
+    {
+        if (raw < stop)
+            *(t1++) = *(raw++);
+        else
+            break;
+
+        if (raw < stop)
+            *(t2++) = *(raw++);
+        else
+            break;
+    }
+
+    unsigned char *t = (unsigned char *) out + 1;
+    unsigned char *tstop = (unsigned char *) out + size;
+    int p = t[-1];
+
+    while (t < tstop)
+    {
+        int d = int (t[0]) - p + (128 + 256);
+        p = t[0];
+        t[0] = d;
+        ++t;
+    }
+}
+
+
+void
+checkSize (size_t size, IMATH_NAMESPACE::Rand48 &rand48, bool smooth)
+{
+    //
+    // One byte of slack at the end of each buffer, to catch overruns.
+    //
+
+    vector<char> raw (size + 1), ref (size + 1), tmp (size + 1), out (size + 1);
+
+    int v = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (smooth)
+            v += rand48.nexti() % 5 - 2;
+        else
+            v = rand48.nexti();
+
+        raw[i] = (char) v;
+    }
+
+    raw[size] = ref[size] = tmp[size] = out[size] = 0x5a;
+
+    referenceReorderAndPredict (raw.data(), size, ref.data());
+    Zip::reorderAndPredict (raw.data(), size, tmp.data());
+
+    assert (memcmp (ref.data(), tmp.data(), size + 1) == 0);
+
+    Zip::reconstructAndInterleave (tmp.data(), size, out.data());
+
+    assert (memcmp (raw.data(), out.data(), size + 1) == 0);
+    assert (tmp[size] == 0x5a);
+}
+
+} // namespace
+
+
+void
+testZipPredictor (const std::string&)
+{
+    try
+    {
+    cout << "Testing zip reordering and predictor" << endl;
+
+        IMATH_NAMESPACE::Rand48 rand48 (0);
+
+        for (size_t size = 0; size <= 300; ++size)
+        {
+            checkSize (size, rand48, false);
+            checkSize (size, rand48, true);
+        }
+
+        checkSize (4095, rand48, false);
+        checkSize (65536, rand48, true);
+        checkSize (1000003, rand48, false);
+
+    cout << "ok\n" << endl;
+    }
+    catch (const std::exception &e)
+    {
+    cerr << "ERROR -- caught exception: " << e.what() << endl;
+    assert (false);
+    }
+}
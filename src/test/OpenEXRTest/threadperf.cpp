@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright Contributors to the OpenEXR Project.
+
+//
+// Measures how InputFile::readPixels scales with the number of
+// threads in the global thread pool, which for small chunks (i.e. ZIPS
+// line buffers) is dominated by how quickly the pool hands out tasks
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <IlmThreadPool.h>
+#include <ImfArray.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfInputFile.h>
+#include <ImfOutputFile.h>
+#include <ImfThreading.h>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+using namespace ILMTHREAD_NAMESPACE;
+
+static void
+writeTestFile (const std::string& fn, int w, int h, Compression comp)
+{
+    Header hdr (w, h);
+    hdr.compression () = comp;
+    hdr.channels ().insert ("R", Channel (HALF));
+    hdr.channels ().insert ("G", Channel (HALF));
+    hdr.channels ().insert ("B", Channel (HALF));
+    hdr.channels ().insert ("A", Channel (HALF));
+
+    Array2D<half> pix (h, w * 4);
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w * 4; ++x)
+            pix[y][x] = half (float ((x * 7 + y * 13) % 1024) / 1024.f);
+
+    FrameBuffer fb;
+    const char* names[] = { "R", "G", "B", "A" };
+    for (int c = 0; c < 4; ++c)
+        fb.insert (
+            names[c],
+            Slice (
+                HALF,
+                (char*) (&pix[0][c]),
+                sizeof (half) * 4,
+                sizeof (half) * 4 * w));
+
+    OutputFile out (fn.c_str (), hdr);
+    out.setFrameBuffer (fb);
+    out.writePixels (h);
+}
+
+static uint64_t
+readFile (const std::string& fn, std::vector<char>& buf)
+{
+    InputFile          in (fn.c_str ());
+    const Header&      hdr = in.header ();
+    const ChannelList& cl  = hdr.channels ();
+    auto&              dw  = hdr.dataWindow ();
+    int64_t            w   = dw.max.x - dw.min.x + 1;
+    int64_t            h   = dw.max.y - dw.min.y + 1;
+    int                bpp = 0;
+
+    for (auto c = cl.begin (); c != cl.end (); ++c)
+        bpp += (c.channel ().type == HALF) ? 2 : 4;
+
+    size_t linebytes = size_t (w) * size_t (bpp);
+    buf.resize (linebytes * size_t (h));
+    char* base = buf.data () - dw.min.x * bpp - dw.min.y * linebytes;
+
+    FrameBuffer fb;
+    int         off = 0;
+    for (auto c = cl.begin (); c != cl.end (); ++c)
+    {
+        fb.insert (
+            c.name (), Slice (c.channel ().type, base + off, bpp, linebytes));
+        off += (c.channel ().type == HALF) ? 2 : 4;
+    }
+
+    in.setFrameBuffer (fb);
+    in.readPixels (dw.min.y, dw.max.y);
+    return uint64_t (w) * uint64_t (h);
+}
+
+static int
+usageAndExit (const char* argv0, int ec)
+{
+    std::cerr << "Usage: " << argv0
+              << " [--threads <max>] [--count <n>] [<file1> ...]\n"
+                 "  with no files, a ZIPS compressed test image is generated"
+              << std::endl;
+    return ec;
+}
+
+int
+main (int argc, char* argv[])
+{
+    std::vector<std::string> files;
+
+    int maxThreads = (int) std::thread::hardware_concurrency ();
+    int count      = 10;
+    for (int a = 1; a < argc; ++a)
+    {
+        if (!strcmp (argv[a], "-h") || !strcmp (argv[a], "--help") ||
+            !strcmp (argv[a], "-?"))
+        {
+            return usageAndExit (argv[0], 0);
+        }
+        else if (!strcmp (argv[a], "--threads") && a + 1 < argc)
+            maxThreads = atoi (argv[++a]);
+        else if (!strcmp (argv[a], "--count") && a + 1 < argc)
+            count = atoi (argv[++a]);
+        else
+            files.push_back (argv[a]);
+    }
+    if (maxThreads < 1) maxThreads = 1;
+    if (count < 1) count = 1;
+
+    std::string tmpfile;
+    if (files.empty ())
+    {
+        tmpfile = "threadperf_zips.exr";
+        try
+        {
+            writeTestFile (tmpfile, 4096, 2048, ZIPS_COMPRESSION);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "ERROR: unable to write " << tmpfile << ": "
+                      << e.what () << std::endl;
+            return 1;
+        }
+        files.push_back (tmpfile);
+    }
+
+    std::vector<int> threadCounts;
+    for (int t = 1; t < maxThreads; t *= 2)
+        threadCounts.push_back (t);
+    threadCounts.push_back (maxThreads);
+
+    std::cout << "readPixels scaling for " << files.size () << " files "
+              << count << " times\n\n"
+              << " Threads  Time (ms)       Mpix/s     Speedup\n";
+
+    std::vector<char> buf;
+    double            baseTime = 0.0;
+    for (int t: threadCounts)
+    {
+        setGlobalThreadCount (t);
+
+        // warm up the file cache and the threads
+        for (auto& f: files)
+            readFile (f, buf);
+
+        uint64_t pixCount = 0;
+        auto     start    = std::chrono::steady_clock::now ();
+        try
+        {
+            for (int c = 0; c < count; ++c)
+                for (auto& f: files)
+                    pixCount += readFile (f, buf);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << "ERROR: " << e.what () << std::endl;
+            return 1;
+        }
+        double ms = std::chrono::duration<double, std::milli> (
+                        std::chrono::steady_clock::now () - start)
+                        .count ();
+        if (baseTime == 0.0) baseTime = ms;
+
+        std::cout << " " << std::setw (7) << std::left << t << "  "
+                  << std::setw (15) << std::fixed << std::setprecision (2)
+                  << ms << " " << std::setw (10)
+                  << double (pixCount) / ms / 1000.0 << " " << baseTime / ms
+                  << "x\n";
+    }
+
+    if (!tmpfile.empty ()) remove (tmpfile.c_str ());
+    return 0;
+}
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: BSD-3-Clause
+// Copyright Contributors to the OpenEXR Project.
+
+//
+// Microbenchmark for the byte reordering and delta predictor which
+// the ZIP and RLE compressors run on every chunk, comparing the
+// original scalar loops with the dispatched SIMD implementation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <ImfHeader.h>
+#include <ImfSystemSpecific.h>
+#include <ImfZip.h>
+
+using namespace OPENEXR_IMF_NAMESPACE;
+
+static void
+scalarReorderAndPredict (const char* raw, size_t size, char* out)
+{
+    char*       t1   = out;
+    char*       t2   = out + (size + 1) / 2;
+    const char* stop = raw + size;
+
+    while (raw < stop)
+    {
+        *(t1++) = *(raw++);
+        if (raw < stop) *(t2++) = *(raw++);
+    }
+
+    unsigned char* t     = (unsigned char*) out + 1;
+    unsigned char* tstop = (unsigned char*) out + size;
+    int            p     = t[-1];
+    while (t < tstop)
+    {
+        int d = int (t[0]) - p + (128 + 256);
+        p     = t[0];
+        t[0]  = (unsigned char) d;
+        ++t;
+    }
+}
+
+static void
+scalarReconstructAndInterleave (char* tmp, size_t size, char* raw)
+{
+    unsigned char* t    = (unsigned char*) tmp + 1;
+    unsigned char* stop = (unsigned char*) tmp + size;
+    while (t < stop)
+    {
+        int d = int (t[-1]) + int (t[0]) - 128;
+        t[0]  = (unsigned char) d;
+        ++t;
+    }
+
+    const char* t1    = tmp;
+    const char* t2    = tmp + (size + 1) / 2;
+    char*       s     = raw;
+    char*       sstop = s + size;
+    while (s < sstop)
+    {
+        *(s++) = *(t1++);
+        if (s < sstop) *(s++) = *(t2++);
+    }
+}
+
+typedef void (*EncodeFunc) (const char*, size_t, char*);
+typedef void (*DecodeFunc) (char*, size_t, char*);
+
+static double
+timeEncode (EncodeFunc f, const std::vector<char>& in, std::vector<char>& out,
+            int count)
+{
+    auto start = std::chrono::steady_clock::now ();
+    for (int c = 0; c < count; ++c)
+        f (in.data (), in.size (), out.data ());
+    return std::chrono::duration<double, std::milli> (
+               std::chrono::steady_clock::now () - start)
+        .count ();
+}
+
+static double
+timeDecode (DecodeFunc f, const std::vector<char>& enc, std::vector<char>& tmp,
+            std::vector<char>& out, int count)
+{
+    double ms = 0.0;
+    for (int c = 0; c < count; ++c)
+    {
+        // the decode is in place, so restore the input each time
+        memcpy (tmp.data (), enc.data (), enc.size ());
+        auto start = std::chrono::steady_clock::now ();
+        f (tmp.data (), tmp.size (), out.data ());
+        ms += std::chrono::duration<double, std::milli> (
+                  std::chrono::steady_clock::now () - start)
+                  .count ();
+    }
+    return ms;
+}
+
+static void
+report (const char* name, size_t bytes, int count, double ms, double baseMs)
+{
+    std::cout << " " << std::setw (12) << std::left << name << std::setw (12)
+              << std::right << std::fixed << std::setprecision (2) << ms
+              << std::setw (12)
+              << double (bytes) * count / (ms * 1000.0) << std::setw (10)
+              << baseMs / ms << "x\n";
+}
+
+int
+main (int argc, char* argv[])
+{
+    size_t size  = 4 * 1024 * 1024;
+    int    count = 50;
+
+    for (int a = 1; a < argc; ++a)
+    {
+        if (!strcmp (argv[a], "--size") && a + 1 < argc)
+            size = size_t (atol (argv[++a]));
+        else if (!strcmp (argv[a], "--count") && a + 1 < argc)
+            count = atoi (argv[++a]);
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--size <bytes>] [--count <n>]" << std::endl;
+            return (!strcmp (argv[a], "-h") || !strcmp (argv[a], "--help"))
+                       ? 0
+                       : 1;
+        }
+    }
+    if (size < 1) size = 1;
+    if (count < 1) count = 1;
+
+    // selects the SIMD implementations
+    staticInitialize ();
+
+    CpuId cpuId;
+    std::cout << "zip reorder / predictor, " << size << " bytes x " << count
+              << " (sse2 " << cpuId.sse2 << ", avx2 " << cpuId.avx2
+              << ")\n\n"
+              << " Kernel         Time (ms)       MB/s   Speedup\n";
+
+    // smooth, half float like data
+    std::vector<char> raw (size), enc (size), tmp (size), out (size);
+    int               v = 0;
+    srand (1);
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (i & 1)
+            raw[i] = char (0x3c + (rand () % 3));
+        else
+            raw[i] = char (v += rand () % 7 - 3);
+    }
+
+    double base = timeEncode (scalarReorderAndPredict, raw, enc, count);
+    report ("encode", size, count, base, base);
+    report ("encode simd", size, count,
+            timeEncode (Zip::reorderAndPredict, raw, enc, count), base);
+
+    base = timeDecode (scalarReconstructAndInterleave, enc, tmp, out, count);
+    report ("decode", size, count, base, base);
+    report ("decode simd", size, count,
+            timeDecode (Zip::reconstructAndInterleave, enc, tmp, out, count),
+            base);
+
+    if (memcmp (raw.data (), out.data (), size))
+    {
+        std::cerr << "ERROR: round trip mismatch" << std::endl;
+        return 1;
+    }
+    return 0;
+}
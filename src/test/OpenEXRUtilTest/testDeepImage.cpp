@@ -10,11 +10,13 @@
 #include <ImfDeepImage.h>
 #include <ImfDeepImageIO.h>
 #include <ImfHeader.h>
+#include <ImfThreading.h>
 #include <ImathRandom.h>
 #include <Iex.h>
 
 #include <cstdio>
 #include <cassert>
+#include <vector>
 
 
 using namespace OPENEXR_IMF_NAMESPACE;
@@ -25,6 +27,35 @@ using namespace std;
 namespace {
 
 
+template <class T>
+T *
+samples (TypedDeepImageChannel<T> &tc, int x, int y)
+{
+    //
+    // Levels stored with DEEP_STORAGE_COMPACT have no per-pixel
+    // sample list pointers for at(); use sampleList() instead.
+    //
+
+    if (tc.sampleCounts().storageMode() == DEEP_STORAGE_COMPACT)
+        return tc.sampleList (x, y);
+
+    assert (tc.sampleList (x, y) == tc.at (x, y));
+    return tc.at (x, y);
+}
+
+
+template <class T>
+const T *
+samples (const TypedDeepImageChannel<T> &tc, int x, int y)
+{
+    if (tc.sampleCounts().storageMode() == DEEP_STORAGE_COMPACT)
+        return tc.sampleList (x, y);
+
+    assert (tc.sampleList (x, y) == tc.at (x, y));
+    return tc.at (x, y);
+}
+
+
 template <class T>
 void
 verifyPixelsAreEqual
@@ -53,8 +84,8 @@ verifyPixelsAreEqual
             if (n1 != n2)
                 throw ArgExc ("different pixel sample counts");
 
-            const T* s1 = tc1.at (x, y);
-            const T* s2 = tc2.at (x + dx, y + dy);
+            const T* s1 = samples (tc1, x, y);
+            const T* s2 = samples (tc2, x + dx, y + dy);
 
             for (int i = 0; i < n1; ++i)
                 if (s1[i] != s2[i])
@@ -231,7 +262,7 @@ fillChannel (Rand48 &random, DeepImageChannel &c)
         for (int x = dataWindow.min.x; x <= dataWindow.max.x; ++x)
         {
             int n = scc.at (x, y);
-            T* s = tc.at (x, y);
+            T* s = samples (tc, x, y);
 
             for (int i = 0; i < n; ++i)
                 s[i] = T (random.nextf (0.0, 100.0));
@@ -417,18 +448,36 @@ testTiledImages (const string &fileName)
     testTiledImage (Box2i (V2i (0, 0), V2i (399, 499)), fileName);
     testTiledImage (Box2i (V2i (-10, -50), V2i (499, 599)), fileName);
     testTiledImage (Box2i (V2i (50, 10), V2i (699, 199)), fileName);
+
+    //
+    // With threads, the levels of multi-resolution files are loaded
+    // concurrently.
+    //
+
+    int numThreads = globalThreadCount();
+    setGlobalThreadCount (4);
+
+    testTiledImage (Box2i (V2i (-10, -50), V2i (499, 599)),
+                    fileName, MIPMAP_LEVELS, ROUND_UP);
+
+    testTiledImage (Box2i (V2i (-10, -50), V2i (499, 599)),
+                    fileName, RIPMAP_LEVELS, ROUND_DOWN);
+
+    setGlobalThreadCount (numThreads);
 }
 
 
 void
-testSetSampleCounts (const Box2i &dataWindow)
+testSetSampleCounts
+    (const Box2i &dataWindow,
+     DeepStorageMode storageMode = DEEP_STORAGE_LISTS)
 {
     cout << "change sample counts, data window = "
             "(" << dataWindow.min.x << ", " << dataWindow.min.y << ") - "
-            "(" << dataWindow.max.x << ", " << dataWindow.max.y << ")" << endl;
+            "(" << dataWindow.max.x << ", " << dataWindow.max.y << "), "
+            "storage mode = " << storageMode << endl;
 
-    DeepImage img;
-    img.resize (dataWindow, ONE_LEVEL, ROUND_DOWN);
+    DeepImage img (dataWindow, storageMode, ONE_LEVEL, ROUND_DOWN);
     img.insertChannel ("F", FLOAT, 1, 1, false);
 
     Rand48 random (0);
@@ -450,25 +499,25 @@ testSetSampleCounts (const Box2i &dataWindow)
         float oldSamples[MAX_SAMPLES];
         
         for (int j = 0; j < oldN; ++j)
-            oldSamples[j] = channel(x, y)[j];
+            oldSamples[j] = samples (channel, x, y)[j];
 
         sampleCounts.set (x, y, newN);
 
         if (newN > oldN)
         {
             for (int j = 0; j < oldN; ++j)
-                assert (channel(x, y)[j] == oldSamples[j]);
+                assert (samples (channel, x, y)[j] == oldSamples[j]);
 
             for (int j = oldN; j < newN; ++j)
             {
-                assert (channel(x, y)[j] == 0);
-                channel(x, y)[j] = random.nextf();
+                assert (samples (channel, x, y)[j] == 0);
+                samples (channel, x, y)[j] = random.nextf();
             }
         }
         else
         {
             for (int j = 0; j < newN; ++j)
-                assert (channel(x, y)[j] == oldSamples[j]);
+                assert (samples (channel, x, y)[j] == oldSamples[j]);
         }
     }
 }
@@ -480,6 +529,278 @@ testSetSampleCounts ()
     testSetSampleCounts (Box2i (V2i (0, 0), V2i (399, 499)));
     testSetSampleCounts (Box2i (V2i (-10, -50), V2i (499, 599)));
     testSetSampleCounts (Box2i (V2i (50, 10), V2i (699, 199)));
+
+    //
+    // With compact storage, every increase of a pixel's sample count
+    // moves all samples; keep the images small.
+    //
+
+    testSetSampleCounts (Box2i (V2i (0, 0), V2i (39, 49)),
+                         DEEP_STORAGE_COMPACT);
+
+    testSetSampleCounts (Box2i (V2i (-10, -50), V2i (29, -1)),
+                         DEEP_STORAGE_COMPACT);
+}
+
+
+void
+testBulkEdit (const Box2i &dataWindow, DeepStorageMode storageMode)
+{
+    cout << "bulk edit of sample counts, data window = "
+            "(" << dataWindow.min.x << ", " << dataWindow.min.y << ") - "
+            "(" << dataWindow.max.x << ", " << dataWindow.max.y << "), "
+            "storage mode = " << storageMode << ", "
+            "threads = " << globalThreadCount() << endl;
+
+    DeepImage img1 (dataWindow, storageMode);
+    img1.insertChannel ("H", HALF, 1, 1, false);
+    img1.insertChannel ("F", FLOAT, 1, 1, false);
+
+    DeepImage img2 (dataWindow, storageMode);
+    img2.insertChannel ("H", HALF, 1, 1, false);
+    img2.insertChannel ("F", FLOAT, 1, 1, false);
+
+    {
+        Rand48 random (2);
+        fillChannels (random, img1);
+    }
+
+    {
+        Rand48 random (2);
+        fillChannels (random, img2);
+    }
+
+    //
+    // Change the sample counts of img2 in a single bulk edit,
+    // and then verify that the samples have been preserved.
+    //
+
+    Rand48 random (3);
+    SampleCountChannel &scc2 = img2.level().sampleCounts();
+
+    {
+        SampleCountChannel::BulkEdit edit (scc2);
+
+        for (size_t i = 0; i < scc2.numPixels(); ++i)
+            edit.sampleCounts()[i] = random.nexti() % 15;
+    }
+
+    const SampleCountChannel &scc1 = img1.level().sampleCounts();
+    const DeepHalfChannel &h1 = img1.level().typedChannel <half> ("H");
+    const DeepHalfChannel &h2 = img2.level().typedChannel <half> ("H");
+    const DeepFloatChannel &f1 = img1.level().typedChannel <float> ("F");
+    const DeepFloatChannel &f2 = img2.level().typedChannel <float> ("F");
+
+    size_t totalNumSamples = 0;
+
+    for (int y = dataWindow.min.y; y <= dataWindow.max.y; ++y)
+    {
+        for (int x = dataWindow.min.x; x <= dataWindow.max.x; ++x)
+        {
+            unsigned int oldN = scc1.at (x, y);
+            unsigned int newN = scc2.at (x, y);
+
+            for (unsigned int j = 0; j < newN; ++j)
+            {
+                if (j < oldN)
+                {
+                    assert (samples (h2, x, y)[j] == samples (h1, x, y)[j]);
+                    assert (samples (f2, x, y)[j] == samples (f1, x, y)[j]);
+                }
+                else
+                {
+                    assert (samples (h2, x, y)[j] == 0);
+                    assert (samples (f2, x, y)[j] == 0);
+                }
+            }
+
+            totalNumSamples += newN;
+        }
+    }
+
+    if (storageMode == DEEP_STORAGE_COMPACT)
+    {
+        assert (scc2.sampleBufferSize() == totalNumSamples);
+        assert (scc2.sampleListSizes() == 0);
+    }
+
+    //
+    // Changing a whole row at once
+    //
+
+    vector <unsigned int> rowCounts (scc2.pixelsPerRow());
+
+    for (size_t i = 0; i < rowCounts.size(); ++i)
+        rowCounts[i] = i % 7;
+
+    int r = scc2.pixelsPerColumn() - 1;
+    scc2.set (r, &rowCounts[0]);
+
+    for (int i = 0; i < scc2.pixelsPerRow(); ++i)
+        assert (scc2.at (dataWindow.min.x + i, dataWindow.min.y + r) == rowCounts[i]);
+}
+
+
+void
+testBulkEdit ()
+{
+    int numThreads = globalThreadCount();
+
+    testBulkEdit (Box2i (V2i (0, 0), V2i (99, 79)), DEEP_STORAGE_LISTS);
+    testBulkEdit (Box2i (V2i (-10, -50), V2i (89, 29)), DEEP_STORAGE_COMPACT);
+
+    //
+    // Large enough to move the samples in parallel
+    //
+
+    setGlobalThreadCount (4);
+
+    testBulkEdit (Box2i (V2i (0, 0), V2i (511, 299)), DEEP_STORAGE_LISTS);
+    testBulkEdit (Box2i (V2i (5, 7), V2i (516, 306)), DEEP_STORAGE_COMPACT);
+
+    setGlobalThreadCount (numThreads);
+}
+
+
+void
+testCompactStorage (const string &fileName)
+{
+    cout << "compact sample storage" << endl;
+
+    Box2i dataWindow (V2i (-10, -50), V2i (189, 149));
+
+    DeepImage img1 (dataWindow, MIPMAP_LEVELS);
+    img1.insertChannel ("H", HALF, 1, 1, false);
+    img1.insertChannel ("UI", UINT, 1, 1, false);
+
+    DeepImage img2 (dataWindow, DEEP_STORAGE_COMPACT, MIPMAP_LEVELS);
+    img2.insertChannel ("H", HALF, 1, 1, false);
+    img2.insertChannel ("UI", UINT, 1, 1, false);
+
+    assert (img1.storageMode() == DEEP_STORAGE_LISTS);
+    assert (img2.storageMode() == DEEP_STORAGE_COMPACT);
+
+    cout << "    generating random pixel values" << endl;
+
+    {
+        Rand48 random (4);
+        fillChannels (random, img1);
+    }
+
+    {
+        Rand48 random (4);
+        fillChannels (random, img2);
+    }
+
+    cout << "    comparing" << endl;
+    verifyImagesAreEqual (img1, img2);
+
+    //
+    // Compact levels have no per-pixel sample list pointers.
+    //
+
+    const DeepImageLevel &level2 = img2.level();
+
+    assert (level2.sampleCounts().storageMode() == DEEP_STORAGE_COMPACT);
+
+    bool caught = false;
+
+    try
+    {
+        level2.channel ("H").slice();
+    }
+    catch (const LogicExc &)
+    {
+        caught = true;
+    }
+
+    assert (caught);
+
+    caught = false;
+
+    try
+    {
+        vector <char *> sampleListPointers;
+        level2.channel ("H").sliceRows (5, 4, sampleListPointers);
+    }
+    catch (const ArgExc &)
+    {
+        caught = true;
+    }
+
+    assert (caught);
+
+    cout << "    converting storage modes" << endl;
+
+    img1.setStorageMode (DEEP_STORAGE_COMPACT);
+    assert (img1.level().sampleCounts().sampleListSizes() == 0);
+    verifyImagesAreEqual (img1, img2);
+
+    img1.setStorageMode (DEEP_STORAGE_LISTS);
+    assert (img1.level().sampleCounts().sampleListSizes() != 0);
+    verifyImagesAreEqual (img1, img2);
+
+    cout << "    shifting pixels" << endl;
+
+    img2.shiftPixels (3, -2);
+    verifyImagesAreEqual (img1, img2, 3, -2);
+    img2.shiftPixels (-3, 2);
+
+    cout << "    saving and loading tiled file" << endl;
+    saveDeepTiledImage (fileName, img2);
+
+    {
+        DeepImage img3 (Box2i (V2i (0, 0), V2i (-1, -1)), DEEP_STORAGE_COMPACT);
+        loadDeepImage (fileName, img3);
+        assert (img3.storageMode() == DEEP_STORAGE_COMPACT);
+        verifyImagesAreEqual (img1, img3);
+    }
+
+    {
+        int numThreads = globalThreadCount();
+        setGlobalThreadCount (4);
+
+        DeepImage img3 (Box2i (V2i (0, 0), V2i (-1, -1)), DEEP_STORAGE_COMPACT);
+        loadDeepImage (fileName, img3);
+        verifyImagesAreEqual (img1, img3);
+
+        setGlobalThreadCount (numThreads);
+    }
+
+    cout << "    saving and loading scan line files" << endl;
+
+    img1.resize (dataWindow, ONE_LEVEL, ROUND_DOWN);
+    img2.resize (dataWindow, ONE_LEVEL, ROUND_DOWN);
+    assert (img2.storageMode() == DEEP_STORAGE_COMPACT);
+
+    {
+        Rand48 random (5);
+        fillChannels (random, img1);
+    }
+
+    {
+        Rand48 random (5);
+        fillChannels (random, img2);
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        Header hdr;
+        hdr.displayWindow() = dataWindow;
+        hdr.lineOrder() = i? DECREASING_Y: INCREASING_Y;
+
+        saveDeepScanLineImage (fileName, hdr, img2);
+
+        DeepImage img3;
+        loadDeepImage (fileName, img3);
+        verifyImagesAreEqual (img1, img3);
+
+        DeepImage img4 (Box2i (V2i (0, 0), V2i (-1, -1)), DEEP_STORAGE_COMPACT);
+        loadDeepImage (fileName, img4);
+        verifyImagesAreEqual (img1, img4);
+    }
+
+    remove (fileName.c_str());
 }
 
 
@@ -722,6 +1043,8 @@ testDeepImage (const string &tempDir)
         testScanLineImages (tempDir + "deepScanLines.exr");
         testTiledImages (tempDir + "deepTiles.exr");
         testSetSampleCounts();
+        testBulkEdit();
+        testCompactStorage (tempDir + "deepCompact.exr");
         testShiftPixels();
         testCropping (tempDir + "deepCropped.exr");
         testRenameChannel();
@@ -10,6 +10,7 @@
 #include <ImfFlatImage.h>
 #include <ImfFlatImageIO.h>
 #include <ImfHeader.h>
+#include <ImfThreading.h>
 #include <ImathRandom.h>
 #include <Iex.h>
 
@@ -380,6 +381,22 @@ testTiledImages (const string &fileName)
     testTiledImage (Box2i (V2i (0, 0), V2i (399, 499)), fileName);
     testTiledImage (Box2i (V2i (-10, -50), V2i (499, 599)), fileName);
     testTiledImage (Box2i (V2i (50, 10), V2i (699, 199)), fileName);
+
+    //
+    // With threads, the levels of multi-resolution files are loaded
+    // concurrently.
+    //
+
+    int numThreads = globalThreadCount();
+    setGlobalThreadCount (4);
+
+    testTiledImage (Box2i (V2i (-10, -50), V2i (499, 599)),
+                    fileName, MIPMAP_LEVELS, ROUND_UP);
+
+    testTiledImage (Box2i (V2i (-10, -50), V2i (499, 599)),
+                    fileName, RIPMAP_LEVELS, ROUND_DOWN);
+
+    setGlobalThreadCount (numThreads);
 }
 
 